@@ -0,0 +1,198 @@
+#ifndef SLICER_BENCHMARK_HPP
+#define SLICER_BENCHMARK_HPP
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <sys/resource.h>
+
+namespace Slicer::Benchmark {
+
+struct Case {
+    std::string name;
+    std::function<void()> run;
+};
+
+inline std::vector<Case>& registry()
+{
+    static std::vector<Case> cases;
+
+    return cases;
+}
+
+struct Registrar {
+    Registrar(const std::string& name, const std::function<void()>& run)
+    {
+        registry().push_back({name, run});
+    }
+};
+
+struct Result {
+    std::string caseName;
+    std::string name;
+    double medianMilliseconds;
+    double bestMilliseconds;
+    int iterations;
+    // Figures worked out by the case, like pages per second
+    std::vector<std::pair<std::string, double>> metrics;
+};
+
+inline std::vector<Result>& results()
+{
+    static std::vector<Result> measured;
+
+    return measured;
+}
+
+// Name of the case main() is running, recorded with each result
+inline std::string& currentCase()
+{
+    static std::string name;
+
+    return name;
+}
+
+// The PDF files to run the cases that open documents over
+inline std::vector<std::string>& corpus()
+{
+    static std::vector<std::string> files;
+
+    return files;
+}
+
+// Runs the function a number of times, and reports the median.
+// The result returned is valid until the next measurement.
+template<typename Function>
+Result& measure(const std::string& name, int iterations, Function&& function)
+{
+    std::vector<double> milliseconds;
+    milliseconds.reserve(static_cast<std::size_t>(iterations));
+
+    for (int i = 0; i < iterations; ++i) {
+        const auto start = std::chrono::steady_clock::now();
+        function();
+        const auto end = std::chrono::steady_clock::now();
+
+        milliseconds.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+    }
+
+    std::sort(milliseconds.begin(), milliseconds.end());
+
+    const double median = milliseconds[milliseconds.size() / 2];
+
+    std::cout << name << ": "
+              << median << " ms median, "
+              << milliseconds.front() << " ms best, "
+              << iterations << " iterations" << std::endl;
+
+    results().push_back({currentCase(), name, median, milliseconds.front(), iterations, {}});
+
+    return results().back();
+}
+
+// Starts measuring the peak resident memory over again. Only on Linux,
+// elsewhere the peak is that of the whole run.
+inline void resetPeakResidentMemory()
+{
+    std::ofstream clearRefs{"/proc/self/clear_refs"};
+    clearRefs << "5";
+}
+
+// Peak resident memory since the last reset, in kilobytes
+inline long peakResidentMemory()
+{
+    std::ifstream status{"/proc/self/status"};
+
+    for (std::string line; std::getline(status, line);) {
+        if (line.rfind("VmHWM:", 0) == 0)
+            return std::stol(line.substr(6));
+    }
+
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+
+    return usage.ru_maxrss;
+}
+
+inline std::string jsonString(const std::string& text)
+{
+    std::string quoted = "\"";
+
+    for (char character : text) {
+        switch (character) {
+        case '"':
+            quoted += "\\\"";
+            break;
+        case '\\':
+            quoted += "\\\\";
+            break;
+        case '\n':
+            quoted += "\\n";
+            break;
+        default:
+            if (static_cast<unsigned char>(character) < 0x20) {
+                std::array<char, 7> escaped{};
+                std::snprintf(escaped.data(), escaped.size(), "\\u%04x", static_cast<unsigned>(character));
+                quoted += escaped.data();
+            }
+            else {
+                quoted += character;
+            }
+        }
+    }
+
+    return quoted + "\"";
+}
+
+// Every result so far, for tracking them across releases
+inline void writeJson(std::ostream& out, const std::vector<std::pair<std::string, std::string>>& context)
+{
+    out << "{\n  \"context\": {";
+
+    for (std::size_t i = 0; i < context.size(); ++i)
+        out << (i == 0 ? "\n" : ",\n") << "    " << jsonString(context[i].first) << ": " << jsonString(context[i].second);
+
+    out << "\n  },\n  \"results\": [";
+
+    for (std::size_t i = 0; i < results().size(); ++i) {
+        const Result& result = results()[i];
+
+        out << (i == 0 ? "\n" : ",\n")
+            << "    {\"case\": " << jsonString(result.caseName)
+            << ", \"name\": " << jsonString(result.name)
+            << ", \"median_ms\": " << result.medianMilliseconds
+            << ", \"best_ms\": " << result.bestMilliseconds
+            << ", \"iterations\": " << result.iterations;
+
+        for (const auto& [metric, value] : result.metrics)
+            out << ", " << jsonString(metric) << ": " << value;
+
+        out << "}";
+    }
+
+    out << "\n  ]\n}" << std::endl;
+}
+
+} // namespace Slicer::Benchmark
+
+#define SLICER_BENCHMARK_CONCAT_IMPL(a, b) a##b
+#define SLICER_BENCHMARK_CONCAT(a, b) SLICER_BENCHMARK_CONCAT_IMPL(a, b)
+
+// Defines a benchmark case that main() runs
+#define SLICER_BENCHMARK(name)                                                                   \
+    static void SLICER_BENCHMARK_CONCAT(slicerBenchmark, __LINE__)();                            \
+    static const Slicer::Benchmark::Registrar SLICER_BENCHMARK_CONCAT(slicerRegistrar, __LINE__) \
+    {                                                                                            \
+        name, &SLICER_BENCHMARK_CONCAT(slicerBenchmark, __LINE__)                                \
+    };                                                                                           \
+    static void SLICER_BENCHMARK_CONCAT(slicerBenchmark, __LINE__)()
+
+#endif // SLICER_BENCHMARK_HPP
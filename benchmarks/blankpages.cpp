@@ -0,0 +1,41 @@
+#include "benchmark.hpp"
+#include <blankpages.hpp>
+#include <gdkmm/pixbuf.h>
+
+using namespace Slicer;
+
+// Roughly the thumbnails BlankPageFinder renders, and one of the sizes the view shows
+static const std::vector<std::pair<int, int>> sizes = {{71, 100}, {283, 400}};
+static const int numberOfPages = 1000;
+
+static Glib::RefPtr<Gdk::Pixbuf> createScanLikePage(int width, int height)
+{
+    auto page = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, true, 8, width, height);
+    page->fill(0xebebe6ff);
+
+    return page;
+}
+
+SLICER_BENCHMARK("Blank page detection")
+{
+    const int iterations = 10;
+
+    std::cout << "Measuring kernel: " << BlankPages::measureImplementation() << std::endl;
+
+    for (const auto& [width, height] : sizes) {
+        const Glib::RefPtr<Gdk::Pixbuf> page = createScanLikePage(width, height);
+        const std::string size = std::to_string(width) + "x" + std::to_string(height);
+
+        Benchmark::Result& scalar = Benchmark::measure("BlankPages::measureScalar, " + size, iterations, [&]() {
+            for (int i = 0; i < numberOfPages; ++i)
+                BlankPages::isBlank(BlankPages::measureScalar(page->get_pixels(), page->get_rowstride(), width, height));
+        });
+        scalar.metrics.emplace_back("pages_per_second", numberOfPages * 1000.0 / scalar.medianMilliseconds);
+
+        Benchmark::Result& vector = Benchmark::measure("BlankPages::measure, " + size, iterations, [&]() {
+            for (int i = 0; i < numberOfPages; ++i)
+                BlankPages::isBlank(BlankPages::measure(page->get_pixels(), page->get_rowstride(), width, height));
+        });
+        vector.metrics.emplace_back("pages_per_second", numberOfPages * 1000.0 / vector.medianMilliseconds);
+    }
+}
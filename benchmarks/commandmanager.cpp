@@ -0,0 +1,54 @@
+#include "benchmark.hpp"
+#include "synthetic.hpp"
+#include <command.hpp>
+#include <commandmanager.hpp>
+#include <numeric>
+
+using namespace Slicer;
+
+// A command executed and undone, the way users try something out and go back
+SLICER_BENCHMARK("Command execution")
+{
+    for (unsigned int numberOfPages : Benchmark::syntheticSizes) {
+        const std::unique_ptr<Document> document = Benchmark::createSyntheticDocument(Benchmark::corpus().front(), numberOfPages);
+        const std::string size = std::to_string(numberOfPages) + " pages";
+        const int iterations = Benchmark::iterationsFor(numberOfPages);
+        const unsigned int middle = numberOfPages / 2;
+        CommandManager commandManager;
+
+        std::vector<unsigned int> everyTenthPage;
+        for (unsigned int i = 0; i < numberOfPages; i += 10)
+            everyTenthPage.push_back(i);
+
+        std::vector<unsigned int> allPages(numberOfPages);
+        std::iota(allPages.begin(), allPages.end(), 0);
+
+        const auto measureCommand = [&](const std::string& name, const std::function<std::shared_ptr<Command>()>& createCommand) {
+            Benchmark::measure(size + ", " + name, iterations, [&]() {
+                commandManager.execute(createCommand());
+                commandManager.undo();
+            });
+        };
+
+        measureCommand("RemovePageCommand in the middle", [&]() {
+            return std::make_shared<RemovePageCommand>(*document, middle);
+        });
+        measureCommand("RemovePagesCommand of every tenth page", [&]() {
+            return std::make_shared<RemovePagesCommand>(*document, everyTenthPage);
+        });
+        measureCommand("RemovePageRangeCommand of 10 in the middle", [&]() {
+            return std::make_shared<RemovePageRangeCommand>(*document, middle, middle + 9);
+        });
+        measureCommand("MovePageCommand of the first page to the end", [&]() {
+            return std::make_shared<MovePageCommand>(*document, 0, numberOfPages - 1);
+        });
+        measureCommand("MovePageRangeCommand of the first 10 to the end", [&]() {
+            return std::make_shared<MovePageRangeCommand>(*document, 0, 9, numberOfPages - 10);
+        });
+        measureCommand("RotatePagesRightCommand of every page", [&]() {
+            return std::make_shared<RotatePagesRightCommand>(*document, allPages);
+        });
+
+        commandManager.reset();
+    }
+}
@@ -0,0 +1,62 @@
+#include "benchmark.hpp"
+#include "synthetic.hpp"
+#include <document.hpp>
+
+using namespace Slicer;
+
+SLICER_BENCHMARK("Document open")
+{
+    const int iterations = 10;
+
+    for (const std::string& filePath : Benchmark::corpus()) {
+        unsigned int numberOfPages = 0;
+
+        Benchmark::Result& result = Benchmark::measure(filePath, iterations, [&]() {
+            const Document document{Gio::File::create_for_path(filePath)};
+            numberOfPages = document.numberOfPages();
+        });
+        result.metrics.emplace_back("pages", numberOfPages);
+    }
+}
+
+static std::vector<unsigned int> everyTenthPage(const Document& document)
+{
+    std::vector<unsigned int> indexes;
+
+    for (unsigned int i = 0; i < document.numberOfPages(); i += 10)
+        indexes.push_back(i);
+
+    return indexes;
+}
+
+// Every operation is measured together with the one undoing it, so that
+// each run starts from the same document
+SLICER_BENCHMARK("Document mutation")
+{
+    for (unsigned int numberOfPages : Benchmark::syntheticSizes) {
+        const std::unique_ptr<Document> document = Benchmark::createSyntheticDocument(Benchmark::corpus().front(), numberOfPages);
+        const std::string size = std::to_string(numberOfPages) + " pages";
+        const int iterations = Benchmark::iterationsFor(numberOfPages);
+        const unsigned int middle = numberOfPages / 2;
+
+        Benchmark::measure(size + ", removePageRange and insertPageRange of 10 in the middle", iterations, [&]() {
+            document->insertPageRange(document->removePageRange(middle, middle + 9), middle);
+        });
+
+        const std::vector<unsigned int> indexes = everyTenthPage(*document);
+
+        Benchmark::measure(size + ", removePages and insertPages of every tenth page", iterations, [&]() {
+            document->insertPages(document->removePages(indexes));
+        });
+
+        Benchmark::measure(size + ", movePageRange of the first 10 to the end and back", iterations, [&]() {
+            document->movePageRange(0, 9, numberOfPages - 10);
+            document->movePageRange(numberOfPages - 10, numberOfPages - 1, 0);
+        });
+
+        Benchmark::measure(size + ", rotatePagesRight and rotatePagesLeft of every tenth page", iterations, [&]() {
+            document->rotatePagesRight(indexes);
+            document->rotatePagesLeft(indexes);
+        });
+    }
+}
@@ -0,0 +1,121 @@
+#include "syntheticpdf.hpp"
+#include <glib.h>
+#include <glibmm/error.h>
+#include <glibmm/fileutils.h>
+#include <glibmm/miscutils.h>
+#include <gtkmm/main.h>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// Writes made up documents, as large as needed, to test and benchmark the
+// application at a scale that the test materials don't reach
+
+using namespace Slicer::Benchmark;
+
+static void printUsage()
+{
+    std::cerr << "Usage: pdfslicer_corpus [--pages N] [--content text|vector|scanned|shared|mixed]\n"
+              << "                        [--mixed-sizes] [--files N] [--seed N] [--image-size PX]\n"
+              << "                        OUTPUT\n"
+              << "  --pages N       pages in every file, up to 100000 (default: 100)\n"
+              << "  --content KIND  what pages are made of (default: text): lines of text,\n"
+              << "                  many curves, a full page JPEG, a small part of one big\n"
+              << "                  resource dictionary all pages share, or all of these\n"
+              << "  --mixed-sizes   pages of several sizes and orientations, instead of A4\n"
+              << "  --files N       write N files into the directory OUTPUT, instead of\n"
+              << "                  one file at OUTPUT, each with a seed of its own\n"
+              << "  --seed N        the same seed makes the same file (default: 1)\n"
+              << "  --image-size PX the longer side of scanned images (default: 1000)" << std::endl;
+}
+
+static void writeFile(const SyntheticPdf::Options& options, const std::string& path)
+{
+    const auto start = std::chrono::steady_clock::now();
+    SyntheticPdf::write(options, path);
+    const auto end = std::chrono::steady_clock::now();
+
+    std::cout << path << ": " << options.numberOfPages << " " << SyntheticPdf::contentName(options.content)
+              << " pages in " << std::chrono::duration<double>(end - start).count() << " s" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    Gtk::Main::init_gtkmm_internals();
+
+    const unsigned int maximumPages = 100000;
+
+    SyntheticPdf::Options options;
+    std::string output;
+    int numberOfFiles = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string argument = argv[i]; //NOLINT
+        const bool hasValue = i + 1 < argc;
+
+        if (argument == "--pages" && hasValue)
+            options.numberOfPages = static_cast<unsigned int>(std::max(1, std::atoi(argv[++i]))); //NOLINT
+        else if (argument == "--content" && hasValue) {
+            const auto content = SyntheticPdf::contentFromName(argv[++i]); //NOLINT
+            if (!content.has_value()) {
+                printUsage();
+                return 1;
+            }
+            options.content = *content;
+        }
+        else if (argument == "--mixed-sizes")
+            options.sizes = SyntheticPdf::Sizes::Mixed;
+        else if (argument == "--files" && hasValue)
+            numberOfFiles = std::max(1, std::atoi(argv[++i])); //NOLINT
+        else if (argument == "--seed" && hasValue)
+            options.seed = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10)); //NOLINT
+        else if (argument == "--image-size" && hasValue)
+            options.imageSize = std::max(16, std::atoi(argv[++i])); //NOLINT
+        else if (argument.rfind("--", 0) == 0 || !output.empty()) {
+            printUsage();
+            return 1;
+        }
+        else
+            output = argument;
+    }
+
+    if (output.empty() || options.numberOfPages > maximumPages) {
+        printUsage();
+        return 1;
+    }
+
+    try {
+        if (numberOfFiles == 0) {
+            writeFile(options, output);
+            return 0;
+        }
+
+        if (g_mkdir_with_parents(output.c_str(), 0755) != 0) {
+            std::cerr << "Couldn't create " << output << std::endl;
+            return 1;
+        }
+
+        const unsigned int firstSeed = options.seed;
+        for (int i = 0; i < numberOfFiles; ++i) {
+            std::ostringstream name;
+            name << "synthetic-" << std::setw(5) << std::setfill('0') << i + 1 << ".pdf";
+
+            options.seed = firstSeed + static_cast<unsigned int>(i);
+            writeFile(options, Glib::build_filename(output, name.str()));
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "pdfslicer_corpus: " << e.what() << std::endl;
+        return 1;
+    }
+    catch (const Glib::Error& e) {
+        std::cerr << "pdfslicer_corpus: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,59 @@
+#include "benchmark.hpp"
+#include <document.hpp>
+#include <pagerenderer.hpp>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+using namespace Slicer;
+
+// Roughly what the page grid does when a document is opened: every page
+// rendered at the default zoom level, by a number of workers taking the next one
+static void renderGrid(const std::vector<Glib::RefPtr<const Page>>& pages, unsigned int numberOfThreads)
+{
+    std::atomic<std::size_t> nextPage = 0;
+    std::vector<std::thread> workers;
+
+    for (unsigned int i = 0; i < numberOfThreads; ++i) {
+        workers.emplace_back([&pages, &nextPage]() {
+            for (std::size_t index = nextPage++; index < pages.size(); index = nextPage++) {
+                auto thumbnail = PageRenderer{pages[index]}.render(200);
+            }
+        });
+    }
+
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+SLICER_BENCHMARK("Full grid render")
+{
+    const int iterations = 5;
+    const unsigned int hardwareThreads = std::max(1U, std::thread::hardware_concurrency());
+
+    std::vector<unsigned int> threadCounts = {1, 2, 4};
+    threadCounts.push_back(hardwareThreads);
+    threadCounts.erase(std::remove_if(threadCounts.begin(),
+                                      threadCounts.end(),
+                                      [hardwareThreads](unsigned int count) { return count > hardwareThreads; }),
+                       threadCounts.end());
+    threadCounts.erase(std::unique(threadCounts.begin(), threadCounts.end()), threadCounts.end());
+
+    for (const std::string& filePath : Benchmark::corpus()) {
+        const Document document{Gio::File::create_for_path(filePath)};
+        // Taken beforehand, since the document's model isn't meant for other threads
+        std::vector<Glib::RefPtr<const Page>> pages;
+
+        for (unsigned int i = 0; i < document.numberOfPages(); ++i)
+            pages.emplace_back(document.getPage(i));
+
+        for (unsigned int numberOfThreads : threadCounts) {
+            const std::string name = filePath + ", " + std::to_string(numberOfThreads) + " threads";
+            auto render = [&]() { renderGrid(pages, numberOfThreads); };
+
+            Benchmark::Result& result = Benchmark::measure(name, iterations, render);
+            result.metrics.emplace_back("threads", numberOfThreads);
+            result.metrics.emplace_back("pages", pages.size());
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#include "benchmark.hpp"
+#include <config.hpp>
+#include <fstream>
+#include <glibmm/miscutils.h>
+#include <gtkmm/main.h>
+#include <poppler/cpp/poppler-version.h>
+#include <thread>
+
+static void printUsage()
+{
+    std::cerr << "Usage: pdfslicer_bench [--filter TEXT] [--json FILE] [PDF...]\n"
+              << "  --filter TEXT  only run cases whose name contains TEXT\n"
+              << "  --json FILE    also write the results to FILE, as JSON\n"
+              << "  PDF...         files for the cases that open documents;\n"
+              << "                 the test materials by default" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    Gtk::Main::init_gtkmm_internals();
+    Slicer::config::createSlicerDirsIfNotExistent();
+
+    std::string filter;
+    std::string jsonPath;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string argument = argv[i]; //NOLINT
+
+        if ((argument == "--filter" || argument == "--json") && i + 1 < argc) {
+            (argument == "--filter" ? filter : jsonPath) = argv[++i]; //NOLINT
+        }
+        else if (argument.rfind("--", 0) == 0) {
+            printUsage();
+            return 1;
+        }
+        else {
+            Slicer::Benchmark::corpus().push_back(argument);
+        }
+    }
+
+    if (Slicer::Benchmark::corpus().empty()) {
+        for (const char* name : {"multipage-1.pdf", "multipage-2.pdf", "multipage-3.pdf"})
+            Slicer::Benchmark::corpus().push_back(Glib::build_filename(Glib::get_current_dir(), name));
+    }
+
+    for (const Slicer::Benchmark::Case& benchmarkCase : Slicer::Benchmark::registry()) {
+        if (benchmarkCase.name.find(filter) != std::string::npos) {
+            Slicer::Benchmark::currentCase() = benchmarkCase.name;
+            benchmarkCase.run();
+        }
+    }
+
+    if (!jsonPath.empty()) {
+        std::ofstream json{jsonPath};
+
+        if (!json) {
+            std::cerr << "Couldn't write " << jsonPath << std::endl;
+            return 1;
+        }
+
+        Slicer::Benchmark::writeJson(json,
+                                     {{"version", Slicer::config::VERSION},
+                                      {"poppler", poppler::version_string()},
+                                      {"hardware_threads", std::to_string(std::thread::hardware_concurrency())}});
+    }
+
+    return 0;
+}
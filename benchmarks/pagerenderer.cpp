@@ -0,0 +1,93 @@
+#include "benchmark.hpp"
+#include <document.hpp>
+#include <pagerenderer.hpp>
+
+using namespace Slicer;
+
+// Same as AppWindow::zoomLevels, which lives in the application
+static const std::vector<int> zoomLevels = {200, 300, 400, 550, 700};
+
+static void renderAllPages(const Document& document, int targetSize, PageRenderer::Quality quality)
+{
+    for (unsigned int i = 0; i < document.numberOfPages(); ++i) {
+        const Glib::RefPtr<const Page> page = document.getPage(i);
+        auto thumbnail = PageRenderer{page}.render(targetSize, quality);
+    }
+}
+
+static double pagesPerSecond(const Document& document, double milliseconds)
+{
+    return milliseconds > 0 ? document.numberOfPages() * 1000.0 / milliseconds : 0;
+}
+
+SLICER_BENCHMARK("Page render throughput")
+{
+    const int iterations = 5;
+
+    for (const std::string& filePath : Benchmark::corpus()) {
+        const Document document{Gio::File::create_for_path(filePath)};
+
+        for (int targetSize : zoomLevels) {
+            const std::string name = filePath + ", " + std::to_string(targetSize) + " px";
+            auto render = [&]() { renderAllPages(document, targetSize, PageRenderer::Quality::Full); };
+
+            Benchmark::Result& result = Benchmark::measure(name, iterations, render);
+            result.metrics.emplace_back("pages", document.numberOfPages());
+            result.metrics.emplace_back("target_size", targetSize);
+            result.metrics.emplace_back("pages_per_second", pagesPerSecond(document, result.medianMilliseconds));
+        }
+    }
+}
+
+// Scanned and vector heavy files render fastest with different settings
+SLICER_BENCHMARK("Page render settings")
+{
+    const int iterations = 5;
+
+    RenderSettings antialiased;
+    antialiased.antialiasing = true;
+
+    RenderSettings hinted;
+    hinted.textHinting = true;
+
+    RenderSettings solidLines;
+    solidLines.lineMode = RenderSettings::LineMode::Solid;
+
+    RenderSettings plain;
+    plain.textAntialiasing = false;
+
+    const std::vector<std::pair<std::string, RenderSettings>> configurations = {
+        {"text antialiasing (default)", RenderSettings{}},
+        {"no antialiasing", plain},
+        {"full antialiasing", antialiased},
+        {"text hinting", hinted},
+        {"solid thin lines", solidLines},
+    };
+
+    const RenderSettings defaults = PageRenderer::renderSettings(PageRenderer::Quality::Full);
+
+    for (const std::string& filePath : Benchmark::corpus()) {
+        const Document document{Gio::File::create_for_path(filePath)};
+
+        for (int targetSize : {200, 1400}) {
+            const std::string prefix = filePath + ", " + std::to_string(targetSize) + " px, ";
+
+            for (const auto& [name, settings] : configurations) {
+                if (settings.lineMode != RenderSettings::LineMode::Default && !RenderContext::supportsLineModes())
+                    continue;
+
+                PageRenderer::setRenderSettings(PageRenderer::Quality::Full, settings);
+
+                Benchmark::measure(prefix + name, iterations, [&]() {
+                    renderAllPages(document, targetSize, PageRenderer::Quality::Full);
+                });
+            }
+
+            Benchmark::measure(prefix + "draft", iterations, [&]() {
+                renderAllPages(document, targetSize, PageRenderer::Quality::Draft);
+            });
+        }
+    }
+
+    PageRenderer::setRenderSettings(PageRenderer::Quality::Full, defaults);
+}
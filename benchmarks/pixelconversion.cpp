@@ -0,0 +1,62 @@
+#include "benchmark.hpp"
+#include <pixelconversion.hpp>
+#include <cairomm/context.h>
+#include <cairomm/surface.h>
+#include <gdkmm/pixbuf.h>
+
+using namespace Slicer;
+
+// Roughly the size of a page at the biggest preview zoom level
+static const int width = 2600;
+static const int height = 3677;
+
+static Cairo::RefPtr<Cairo::ImageSurface> createPageLikeSurface()
+{
+    auto surface = Cairo::ImageSurface::create(Cairo::FORMAT_ARGB32, width, height);
+    auto cr = Cairo::Context::create(surface);
+
+    cr->set_source_rgb(1, 1, 1);
+    cr->paint();
+    cr->set_source_rgb(0.1, 0.1, 0.1);
+
+    for (int line = 0; line < height; line += 40) {
+        cr->rectangle(200, line, width - 400, 12);
+        cr->fill();
+    }
+
+    surface->flush();
+
+    return surface;
+}
+
+SLICER_BENCHMARK("ARGB32 to Pixbuf conversion")
+{
+    const Cairo::RefPtr<Cairo::ImageSurface> surface = createPageLikeSurface();
+    const int iterations = 30;
+
+    std::cout << "Conversion kernel: " << PixelConversion::argb32ToRgbaImplementation() << std::endl;
+
+    Benchmark::measure("gdk_pixbuf_get_from_surface", iterations, [&]() {
+        auto pixbuf = Gdk::Pixbuf::create(surface, 0, 0, width, height);
+    });
+
+    Benchmark::measure("PixelConversion::argb32ToRgbaScalar", iterations, [&]() {
+        auto pixbuf = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, true, 8, width, height);
+        PixelConversion::argb32ToRgbaScalar(surface->get_data(),
+                                            surface->get_stride(),
+                                            pixbuf->get_pixels(),
+                                            pixbuf->get_rowstride(),
+                                            width,
+                                            height);
+    });
+
+    Benchmark::measure("PixelConversion::argb32ToRgba", iterations, [&]() {
+        auto pixbuf = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, true, 8, width, height);
+        PixelConversion::argb32ToRgba(surface->get_data(),
+                                      surface->get_stride(),
+                                      pixbuf->get_pixels(),
+                                      pixbuf->get_rowstride(),
+                                      width,
+                                      height);
+    });
+}
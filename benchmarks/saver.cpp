@@ -0,0 +1,103 @@
+#include "benchmark.hpp"
+#include <pdfsaver.hpp>
+#include <popplerhandles.hpp>
+#include <tempfile.hpp>
+
+using namespace Slicer;
+
+static const std::vector<PdfSaver::WriteProfile> writeProfiles = {PdfSaver::WriteProfile::Default,
+                                                                  PdfSaver::WriteProfile::Smallest,
+                                                                  PdfSaver::WriteProfile::Fastest,
+                                                                  PdfSaver::WriteProfile::FastWebView};
+
+static unsigned int numberOfPages(const std::string& filePath)
+{
+    return static_cast<unsigned int>(PopplerHandles::forCurrentThread(filePath)->pages());
+}
+
+// Saves with every write profile, reporting the wall time, the peak
+// memory taken while saving and the size of the result
+static void measureSaves(const std::string& name, const PdfSaver::SaveData& saveData)
+{
+    const int iterations = 3;
+    const Glib::RefPtr<Gio::File> destination = TempFile::generate();
+
+    for (PdfSaver::WriteProfile profile : writeProfiles) {
+        double writeMilliseconds = 0;
+
+        Benchmark::resetPeakResidentMemory();
+
+        Benchmark::Result& result = Benchmark::measure(name + ", " + PdfSaver::writeProfileName(profile), iterations, [&]() {
+            PdfSaver saver{saveData};
+            saver.setWriteProfile(profile);
+            saver.save(destination);
+            writeMilliseconds = saver.lastWriteDuration().count() * 1000;
+        });
+
+        result.metrics.emplace_back("peak_rss_kb", Benchmark::peakResidentMemory());
+        result.metrics.emplace_back("output_bytes", destination->query_info(G_FILE_ATTRIBUTE_STANDARD_SIZE)->get_size());
+        result.metrics.emplace_back("write_ms", writeMilliseconds);
+        result.metrics.emplace_back("pages", saveData.pages.size());
+    }
+
+    destination->remove();
+}
+
+SLICER_BENCHMARK("Save merged files")
+{
+    for (const std::string& filePath : Benchmark::corpus()) {
+        const unsigned int pagesInFile = numberOfPages(filePath);
+
+        for (unsigned int numberOfFiles : {2U, 4U, 8U}) {
+            PdfSaver::SaveData saveData;
+
+            for (unsigned int file = 0; file < numberOfFiles; ++file) {
+                saveData.files.push_back(Gio::File::create_for_path(filePath));
+
+                for (unsigned int page = 0; page < pagesInFile; ++page)
+                    saveData.pages.push_back({file, page, 0});
+            }
+
+            measureSaves(filePath + " merged " + std::to_string(numberOfFiles) + " times", saveData);
+        }
+    }
+
+    // And the corpus as a whole, the way files get put together in a session
+    if (Benchmark::corpus().size() > 1) {
+        PdfSaver::SaveData saveData;
+
+        for (const std::string& filePath : Benchmark::corpus()) {
+            const auto file = static_cast<unsigned int>(saveData.files.size());
+            saveData.files.push_back(Gio::File::create_for_path(filePath));
+
+            for (unsigned int page = 0; page < numberOfPages(filePath); ++page)
+                saveData.pages.push_back({file, page, 0});
+        }
+
+        measureSaves("The whole corpus merged", saveData);
+    }
+}
+
+SLICER_BENCHMARK("Save with every other page removed")
+{
+    for (const std::string& filePath : Benchmark::corpus()) {
+        PdfSaver::SaveData saveData{{Gio::File::create_for_path(filePath)}, {}};
+
+        for (unsigned int page = 0; page < numberOfPages(filePath); page += 2)
+            saveData.pages.push_back({0, page, 0});
+
+        measureSaves(filePath, saveData);
+    }
+}
+
+SLICER_BENCHMARK("Save with every page rotated")
+{
+    for (const std::string& filePath : Benchmark::corpus()) {
+        PdfSaver::SaveData saveData{{Gio::File::create_for_path(filePath)}, {}};
+
+        for (unsigned int page = 0; page < numberOfPages(filePath); ++page)
+            saveData.pages.push_back({0, page, 90});
+
+        measureSaves(filePath, saveData);
+    }
+}
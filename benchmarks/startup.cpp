@@ -0,0 +1,360 @@
+#include "benchmark.hpp"
+#include <config.hpp>
+#include <glibmm/fileutils.h>
+#include <glibmm/miscutils.h>
+#include <glibmm/spawn.h>
+#include <csignal>
+#include <cstdlib>
+#include <map>
+#include <optional>
+#include <regex>
+#include <thread>
+
+// Launches the application on a headless display, opening a document, and
+// reads the time to each startup milestone from the trace it writes on exit.
+// SLICER_STARTUP_BENCHMARK makes it quit once the document shows a thumbnail.
+
+using namespace Slicer;
+
+static void printUsage()
+{
+    std::cerr << "Usage: pdfslicer_startup_bench [--display broadway|xvfb|current] [--runs N] [--warm]\n"
+              << "                               [--application PATH] [--json FILE] [PDF]\n"
+              << "  --display NAME      where the windows go: a Broadway or Xvfb server\n"
+              << "                      started for the benchmark (default: broadway),\n"
+              << "                      or the display of this session\n"
+              << "  --runs N            launches to take the median of (default: 5)\n"
+              << "  --warm              keep the caches between launches, after a first\n"
+              << "                      one that isn't counted, instead of starting cold\n"
+              << "  --application PATH  the application to launch (default: the one built\n"
+              << "                      along with this benchmark)\n"
+              << "  --json FILE         also write the results to FILE, as JSON\n"
+              << "  PDF                 the document to open; a test material by default" << std::endl;
+}
+
+namespace {
+
+struct Span {
+    std::string name;
+    long long thread;
+    long long begin;
+    long long duration;
+};
+
+// In milliseconds since main() started
+struct Launch {
+    double activation = 0;
+    double firstFrame = 0;
+    double firstThumbnail = 0;
+    // Spawning to exit, including what the process does before main() and on exit
+    double wallTime = 0;
+    // Time spent in each span of the main thread until the first thumbnail
+    std::map<std::string, double> phases;
+};
+
+// The spans as exportChromeTrace() writes them, one event per line
+std::vector<Span> readTrace(const std::string& path, long long& mainThread)
+{
+    static const std::regex eventPattern{R"re(\{"name":"((?:[^"\\]|\\.)*)","ph":"X","pid":1,"tid":(\d+),"ts":(-?\d+),"dur":(\d+)\})re"};
+    static const std::regex threadPattern{R"re(\{"name":"thread_name","ph":"M","pid":1,"tid":(\d+),"args":\{"name":"Main"\}\})re"};
+
+    std::ifstream trace{path};
+    std::vector<Span> spans;
+    mainThread = -1;
+
+    for (std::string line; std::getline(trace, line);) {
+        std::smatch match;
+
+        if (std::regex_search(line, match, eventPattern))
+            spans.push_back({match[1], std::stoll(match[2]), std::stoll(match[3]), std::stoll(match[4])});
+        else if (std::regex_search(line, match, threadPattern))
+            mainThread = std::stoll(match[1]);
+    }
+
+    return spans;
+}
+
+std::optional<Span> findSpan(const std::vector<Span>& spans, const std::string& name)
+{
+    const auto it = std::find_if(spans.begin(), spans.end(), [&name](const Span& span) {
+        return span.name == name;
+    });
+
+    if (it == spans.end())
+        return {};
+
+    return *it;
+}
+
+std::string makeTemporaryDirectory()
+{
+    std::string path = Glib::build_filename(Glib::get_tmp_dir(), "pdfslicer-startup-XXXXXX");
+
+    if (mkdtemp(path.data()) == nullptr)
+        throw std::runtime_error("Couldn't make a temporary directory");
+
+    return path;
+}
+
+void removeDirectory(const std::string& path)
+{
+    Glib::spawn_sync({}, std::vector<std::string>{"rm", "-rf", path}, Glib::SPAWN_SEARCH_PATH);
+}
+
+class DisplayServer {
+public:
+    explicit DisplayServer(const std::string& kind)
+    {
+        if (kind == "current") {
+            for (const std::string name : {"GDK_BACKEND", "BROADWAY_DISPLAY", "DISPLAY"}) {
+                if (const std::string value = Glib::getenv(name); !value.empty())
+                    m_environment.push_back(name + "=" + value);
+            }
+        }
+        else if (kind == "broadway") {
+            start({"broadwayd", ":" + std::to_string(display)});
+            m_environment = {"GDK_BACKEND=broadway", "BROADWAY_DISPLAY=:" + std::to_string(display)};
+        }
+        else if (kind == "xvfb") {
+            start({"Xvfb", ":" + std::to_string(display), "-nolisten", "tcp", "-screen", "0", "1920x1080x24"});
+            m_environment = {"GDK_BACKEND=x11", "DISPLAY=:" + std::to_string(display)};
+        }
+        else {
+            throw std::runtime_error("Unknown display: " + kind);
+        }
+    }
+
+    DisplayServer(const DisplayServer&) = delete;
+    DisplayServer& operator=(const DisplayServer&) = delete;
+    DisplayServer(DisplayServer&&) = delete;
+    DisplayServer& operator=(DisplayServer&& src) = delete;
+
+    ~DisplayServer()
+    {
+        if (m_pid == 0)
+            return;
+
+        kill(m_pid, SIGTERM);
+        Glib::spawn_close_pid(m_pid);
+    }
+
+    const std::vector<std::string>& environment() const { return m_environment; }
+
+private:
+    static constexpr int display = 97;
+    Glib::Pid m_pid = 0;
+    std::vector<std::string> m_environment;
+
+    void start(const std::vector<std::string>& command)
+    {
+        Glib::spawn_async({}, command, Glib::SPAWN_SEARCH_PATH | Glib::SPAWN_STDOUT_TO_DEV_NULL | Glib::SPAWN_STDERR_TO_DEV_NULL, {}, &m_pid);
+
+        // Neither says when it's ready to take clients
+        std::this_thread::sleep_for(std::chrono::milliseconds{500});
+    }
+};
+
+std::vector<std::string> environmentFor(const std::string& directory, const DisplayServer& displayServer)
+{
+    std::vector<std::string> environment;
+    const std::vector<std::string> replaced{"XDG_CONFIG_HOME", "XDG_CACHE_HOME", "SLICER_TRACE", "SLICER_STARTUP_BENCHMARK",
+                                            "GDK_BACKEND", "BROADWAY_DISPLAY", "DISPLAY"};
+
+    for (const std::string& name : Glib::listenv()) {
+        if (std::find(replaced.begin(), replaced.end(), name) == replaced.end())
+            environment.push_back(name + "=" + Glib::getenv(name));
+    }
+
+    const std::string cache = Glib::build_filename(directory, "cache");
+    const std::string config = Glib::build_filename(directory, "config");
+    environment.push_back("XDG_CACHE_HOME=" + cache);
+    environment.push_back("XDG_CONFIG_HOME=" + config);
+    environment.push_back("SLICER_TRACE=" + Glib::build_filename(directory, "trace.json"));
+    environment.push_back("SLICER_STARTUP_BENCHMARK=1");
+
+    const std::vector<std::string>& display = displayServer.environment();
+    environment.insert(environment.end(), display.begin(), display.end());
+
+    return environment;
+}
+
+Launch launch(const std::string& application, const std::string& document, const std::string& directory, const DisplayServer& displayServer)
+{
+    // A bus of its own, so that the launch isn't handed to a running instance
+    std::vector<std::string> command{application, document};
+    if (!Glib::find_program_in_path("dbus-run-session").empty())
+        command.insert(command.begin(), {"dbus-run-session", "--"});
+
+    // The last launch left its session behind, which would open another window
+    removeDirectory(Glib::build_filename(directory, "config"));
+
+    const std::string tracePath = Glib::build_filename(directory, "trace.json");
+    std::remove(tracePath.c_str());
+
+    int status = 0;
+    const auto start = std::chrono::steady_clock::now();
+    Glib::spawn_sync({}, command, environmentFor(directory, displayServer), Glib::SPAWN_SEARCH_PATH | Glib::SPAWN_STDOUT_TO_DEV_NULL, {}, nullptr, nullptr, &status);
+    const auto end = std::chrono::steady_clock::now();
+
+    long long mainThread = -1;
+    const std::vector<Span> spans = readTrace(tracePath, mainThread);
+    const std::optional<Span> activation = findSpan(spans, "Startup::activate");
+    const std::optional<Span> firstFrame = findSpan(spans, "Startup::first frame");
+    const std::optional<Span> firstThumbnail = findSpan(spans, "Open to first thumbnail");
+
+    if (status != 0 || !activation.has_value() || !firstFrame.has_value() || !firstThumbnail.has_value())
+        throw std::runtime_error("The application didn't get to show a thumbnail, exit status " + std::to_string(status));
+
+    // Every startup span begins when main() does
+    const long long launchTime = activation->begin;
+    const long long firstThumbnailEnd = firstThumbnail->begin + firstThumbnail->duration;
+
+    Launch result;
+    result.activation = static_cast<double>(activation->duration) / 1000;
+    result.firstFrame = static_cast<double>(firstFrame->duration) / 1000;
+    result.firstThumbnail = static_cast<double>(firstThumbnailEnd - launchTime) / 1000;
+    result.wallTime = std::chrono::duration<double, std::milli>(end - start).count();
+
+    for (const Span& span : spans) {
+        if (span.thread == mainThread && span.begin >= launchTime && span.begin < firstThumbnailEnd
+            && span.name != "Open to first thumbnail")
+            result.phases[span.name] += static_cast<double>(span.duration) / 1000;
+    }
+
+    return result;
+}
+
+double median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+
+    return values.empty() ? 0 : values[values.size() / 2];
+}
+
+void report(const std::string& name, const std::vector<double>& values)
+{
+    const double best = values.empty() ? 0 : *std::min_element(values.begin(), values.end());
+
+    std::cout << name << ": "
+              << median(values) << " ms median, "
+              << best << " ms best, "
+              << values.size() << " launches" << std::endl;
+
+    Benchmark::results().push_back({Benchmark::currentCase(), name, median(values), best, static_cast<int>(values.size()), {}});
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    std::string displayKind = "broadway";
+    std::string application = SLICER_APPLICATION_PATH;
+    std::string document = Glib::build_filename(Glib::get_current_dir(), "multipage-1.pdf");
+    std::string jsonPath;
+    int runs = 5;
+    bool isWarm = false;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string argument = argv[i]; //NOLINT
+        const bool hasValue = i + 1 < argc;
+
+        if (argument == "--display" && hasValue)
+            displayKind = argv[++i]; //NOLINT
+        else if (argument == "--runs" && hasValue)
+            runs = std::max(1, std::atoi(argv[++i])); //NOLINT
+        else if (argument == "--application" && hasValue)
+            application = argv[++i]; //NOLINT
+        else if (argument == "--json" && hasValue)
+            jsonPath = argv[++i]; //NOLINT
+        else if (argument == "--warm")
+            isWarm = true;
+        else if (argument.rfind("--", 0) == 0) {
+            printUsage();
+            return 1;
+        }
+        else
+            document = Glib::path_is_absolute(argument) ? argument : Glib::build_filename(Glib::get_current_dir(), argument);
+    }
+
+    Benchmark::currentCase() = isWarm ? "Warm startup" : "Cold startup";
+
+    try {
+        const DisplayServer displayServer{displayKind};
+        std::vector<Launch> launches;
+        std::string directory = makeTemporaryDirectory();
+
+        if (isWarm)
+            launch(application, document, directory, displayServer);
+
+        for (int i = 0; i < runs; ++i) {
+            if (!isWarm && i > 0) {
+                removeDirectory(directory);
+                directory = makeTemporaryDirectory();
+            }
+
+            launches.push_back(launch(application, document, directory, displayServer));
+        }
+
+        removeDirectory(directory);
+
+        const auto valuesOf = [&launches](const std::function<double(const Launch&)>& value) {
+            std::vector<double> values;
+            for (const Launch& launch : launches)
+                values.push_back(value(launch));
+
+            return values;
+        };
+
+        report("Launch to activation", valuesOf([](const Launch& launch) { return launch.activation; }));
+        report("Launch to first frame", valuesOf([](const Launch& launch) { return launch.firstFrame; }));
+        report("Launch to first thumbnail", valuesOf([](const Launch& launch) { return launch.firstThumbnail; }));
+        report("Process wall time", valuesOf([](const Launch& launch) { return launch.wallTime; }));
+
+        // Spans nest, so the phases add up to more than the whole
+        std::map<std::string, std::vector<double>> phases;
+        for (const Launch& launch : launches) {
+            for (const auto& [name, milliseconds] : launch.phases)
+                phases[name].push_back(milliseconds);
+        }
+
+        std::vector<std::pair<std::string, double>> breakdown;
+        for (auto& [name, values] : phases) {
+            values.resize(launches.size(), 0);
+            breakdown.emplace_back(name, median(values));
+        }
+
+        std::sort(breakdown.begin(), breakdown.end(), [](const auto& a, const auto& b) {
+            return a.second > b.second;
+        });
+
+        std::cout << "\nMain thread until the first thumbnail, median per span:" << std::endl;
+        for (const auto& [name, milliseconds] : breakdown)
+            std::cout << "  " << name << ": " << milliseconds << " ms" << std::endl;
+
+        Benchmark::results().push_back({Benchmark::currentCase(), "Phases", 0, 0, static_cast<int>(launches.size()), breakdown});
+    }
+    catch (const std::exception& e) {
+        std::cerr << "pdfslicer_startup_bench: " << e.what() << std::endl;
+        return 1;
+    }
+    catch (const Glib::Error& e) {
+        std::cerr << "pdfslicer_startup_bench: " << e.what() << std::endl;
+        return 1;
+    }
+
+    if (!jsonPath.empty()) {
+        std::ofstream json{jsonPath};
+
+        if (!json) {
+            std::cerr << "Couldn't write " << jsonPath << std::endl;
+            return 1;
+        }
+
+        Benchmark::writeJson(json,
+                             {{"version", config::VERSION},
+                              {"display", displayKind},
+                              {"hardware_threads", std::to_string(std::thread::hardware_concurrency())}});
+    }
+
+    return 0;
+}
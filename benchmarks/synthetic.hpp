@@ -0,0 +1,46 @@
+#ifndef SLICER_BENCHMARK_SYNTHETIC_HPP
+#define SLICER_BENCHMARK_SYNTHETIC_HPP
+
+#include <document.hpp>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Slicer::Benchmark {
+
+// Sizes to show how mutations grow with the number of pages
+inline const std::vector<unsigned int> syntheticSizes = {100, 10000, 100000};
+
+// A document with the given number of pages, all loaded from the same file
+// over and over, without opening the file more than once
+inline std::unique_ptr<Document> createSyntheticDocument(const std::string& filePath, unsigned int numberOfPages)
+{
+    auto document = std::make_unique<Document>();
+    const Document::FileLoader loader{Gio::File::create_for_path(filePath)};
+    const unsigned int fileNumber = document->addLoadedFile(loader);
+
+    std::vector<Glib::RefPtr<Page>> pages;
+    pages.reserve(numberOfPages);
+
+    while (pages.size() < numberOfPages) {
+        const auto count = std::min(loader.numberOfPages(), numberOfPages - static_cast<unsigned int>(pages.size()));
+
+        for (const Glib::RefPtr<Page>& page : loader.loadPages(0, count, fileNumber))
+            pages.push_back(page);
+    }
+
+    document->appendPages(pages);
+
+    return document;
+}
+
+// Fewer runs for the larger documents, so that the suite stays quick
+inline int iterationsFor(unsigned int numberOfPages)
+{
+    return numberOfPages >= 100000 ? 3 : numberOfPages >= 10000 ? 10 : 50;
+}
+
+} // namespace Slicer::Benchmark
+
+#endif // SLICER_BENCHMARK_SYNTHETIC_HPP
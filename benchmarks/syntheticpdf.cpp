@@ -0,0 +1,379 @@
+#include "syntheticpdf.hpp"
+#include <gdkmm/pixbuf.h>
+#include <qpdf/DLL.h>
+#include <qpdf/Pipeline.hh>
+#include <qpdf/QPDF.hh>
+#include <qpdf/QPDFPageDocumentHelper.hh>
+#include <qpdf/QPDFWriter.hh>
+#include <qpdf/QUtil.hh>
+#include <algorithm>
+#include <array>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <vector>
+
+namespace Slicer::Benchmark::SyntheticPdf {
+
+namespace {
+
+struct PageSize {
+    int width;
+    int height;
+};
+
+// A4, Letter, A3 and A5, in points
+const std::array<PageSize, 4> pageSizes = {{{595, 842}, {612, 792}, {842, 1191}, {420, 595}}};
+
+const unsigned int imageVariants = 16;
+const int sharedForms = 400;
+const int sharedFonts = 24;
+const int formsPerPage = 6;
+const int textLines = 48;
+const int vectorCurves = 1500;
+
+const std::array<Content, 4> mixedContents = {Content::Text, Content::Vector, Content::Scanned, Content::SharedResources};
+
+// Every page gets its own generator, so that its contents don't depend on
+// the order the writer asks for them
+std::mt19937 generatorFor(const Options& options, unsigned int pageIndex)
+{
+    std::seed_seq seed{options.seed, pageIndex};
+
+    return std::mt19937{seed};
+}
+
+int uniform(std::mt19937& generator, int minimum, int maximum)
+{
+    return std::uniform_int_distribution<int>{minimum, maximum}(generator);
+}
+
+// A JPEG of noise over a gradient, which compresses about as badly as a scan
+std::string encodeJpeg(int width, int height, unsigned int seed)
+{
+    auto pixbuf = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, false, 8, width, height);
+    std::mt19937 generator{seed};
+    const int tint = uniform(generator, 0, 2);
+
+    guint8* pixels = pixbuf->get_pixels();
+    const int stride = pixbuf->get_rowstride();
+
+    for (int y = 0; y < height; ++y) {
+        guint8* row = pixels + y * stride; //NOLINT
+        for (int x = 0; x < width; ++x) {
+            const int paper = 230 - (y * 40) / height + uniform(generator, -12, 12);
+            const bool ink = uniform(generator, 0, 40) == 0;
+            for (int channel = 0; channel < 3; ++channel) {
+                const int value = ink ? uniform(generator, 0, 60) : paper - (channel == tint ? 10 : 0);
+                row[x * 3 + channel] = static_cast<guint8>(std::clamp(value, 0, 255)); //NOLINT
+            }
+        }
+    }
+
+    gchar* buffer = nullptr;
+    gsize size = 0;
+    pixbuf->save_to_buffer(buffer, size, "jpeg", {"quality"}, {"75"});
+    std::string jpeg{buffer, size};
+    g_free(buffer);
+
+    return jpeg;
+}
+
+std::string textContents(std::mt19937& generator, const PageSize& size, unsigned int pageIndex)
+{
+    static const std::array<const char*, 12> words = {"lorem", "ipsum", "dolor", "sit", "amet", "consectetur",
+                                                      "adipiscing", "elit", "sed", "do", "eiusmod", "tempor"};
+
+    std::ostringstream contents;
+    contents << "BT /F1 11 Tf 14 TL 56 " << size.height - 64 << " Td (Page " << pageIndex + 1 << ") Tj\n";
+
+    for (int line = 0; line < textLines; ++line) {
+        contents << "T* (";
+        const int numberOfWords = uniform(generator, 6, 12);
+        for (int word = 0; word < numberOfWords; ++word)
+            contents << (word == 0 ? "" : " ") << words.at(static_cast<unsigned int>(uniform(generator, 0, 11)));
+        contents << ") Tj\n";
+    }
+
+    contents << "ET\n";
+
+    return contents.str();
+}
+
+std::string vectorContents(std::mt19937& generator, const PageSize& size)
+{
+    std::ostringstream contents;
+    contents << "0.4 w\n";
+
+    auto point = [&generator, &size]() {
+        return std::to_string(uniform(generator, 0, size.width)) + " " + std::to_string(uniform(generator, 0, size.height));
+    };
+
+    for (int curve = 0; curve < vectorCurves; ++curve) {
+        if (curve % 50 == 0)
+            contents << uniform(generator, 0, 100) / 100.0 << " " << uniform(generator, 0, 100) / 100.0 << " "
+                     << uniform(generator, 0, 100) / 100.0 << " RG\n";
+
+        contents << point() << " m " << point() << " " << point() << " " << point() << " c S\n";
+    }
+
+    return contents.str();
+}
+
+std::string scannedContents(const PageSize& size)
+{
+    return "q " + std::to_string(size.width) + " 0 0 " + std::to_string(size.height) + " 0 0 cm /Im0 Do Q\n";
+}
+
+std::string sharedResourcesContents(std::mt19937& generator, const PageSize& size)
+{
+    std::ostringstream contents;
+
+    for (int form = 0; form < formsPerPage; ++form)
+        contents << "q 1 0 0 1 " << uniform(generator, 0, size.width - 100) << " " << uniform(generator, 0, size.height - 100)
+                 << " cm /Fm" << uniform(generator, 0, sharedForms - 1) << " Do Q\n";
+
+    contents << "BT /F" << uniform(generator, 0, sharedFonts - 1) << " 10 Tf 56 56 Td (Shared resources) Tj ET\n";
+
+    return contents.str();
+}
+
+// Makes the streams of the file when the writer gets to them, so that only
+// one of them is in memory at a time
+class StreamProvider : public QPDFObjectHandle::StreamDataProvider {
+public:
+    struct PageStream {
+        unsigned int pageIndex;
+        Content content;
+        PageSize size;
+    };
+
+    explicit StreamProvider(const Options& options)
+        : m_options{options}
+    {
+    }
+
+    void addPage(int objectId, const PageStream& page)
+    {
+        m_pages[objectId] = page;
+    }
+
+    void addImage(int objectId, unsigned int variant)
+    {
+        m_images[objectId] = variant;
+    }
+
+    const std::string& image(unsigned int variant)
+    {
+        if (m_jpegs.empty()) {
+            for (unsigned int i = 0; i < imageVariants; ++i)
+                m_jpegs.push_back(encodeJpeg(imageWidth(), imageHeight(), m_options.seed + i));
+        }
+
+        return m_jpegs.at(variant);
+    }
+
+    // Portrait, like most scans; every page stretches it to its own size
+    int imageWidth() const
+    {
+        return std::max(16, m_options.imageSize * 707 / 1000);
+    }
+
+    int imageHeight() const
+    {
+        return std::max(16, m_options.imageSize);
+    }
+
+    void provideStreamData(int objid, int /*generation*/, Pipeline* pipeline) override
+    {
+        std::string data;
+
+        if (const auto image = m_images.find(objid); image != m_images.end()) {
+            data = this->image(image->second);
+        }
+        else {
+            const PageStream& page = m_pages.at(objid);
+            std::mt19937 generator = generatorFor(m_options, page.pageIndex);
+
+            switch (page.content) {
+            case Content::Vector:
+                data = vectorContents(generator, page.size);
+                break;
+            case Content::Scanned:
+                data = scannedContents(page.size);
+                break;
+            case Content::SharedResources:
+                data = sharedResourcesContents(generator, page.size);
+                break;
+            default:
+                data = textContents(generator, page.size, page.pageIndex);
+                break;
+            }
+        }
+
+        pipeline->write(QUtil::unsigned_char_pointer(data), data.size());
+        pipeline->finish();
+    }
+
+private:
+    const Options m_options;
+    std::map<int, PageStream> m_pages;
+    std::map<int, unsigned int> m_images;
+    std::vector<std::string> m_jpegs;
+};
+
+PageSize pageSizeFor(const Options& options, std::mt19937& generator, int& rotation)
+{
+    rotation = 0;
+
+    if (options.sizes == Sizes::Uniform)
+        return pageSizes.front();
+
+    PageSize size = pageSizes.at(static_cast<unsigned int>(uniform(generator, 0, static_cast<int>(pageSizes.size()) - 1)));
+
+    if (uniform(generator, 0, 3) == 0)
+        std::swap(size.width, size.height);
+
+    if (uniform(generator, 0, 7) == 0)
+        rotation = 90 * uniform(generator, 1, 3);
+
+    return size;
+}
+
+QPDFObjectHandle createSharedResources(QPDF& pdf)
+{
+    QPDFObjectHandle fonts = QPDFObjectHandle::newDictionary();
+    for (int i = 0; i < sharedFonts; ++i)
+        fonts.replaceKey("/F" + std::to_string(i),
+                         pdf.makeIndirectObject(QPDFObjectHandle::parse(
+                             i % 2 == 0 ? "<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>"
+                                        : "<< /Type /Font /Subtype /Type1 /BaseFont /Times-Roman >>")));
+
+    QPDFObjectHandle forms = QPDFObjectHandle::newDictionary();
+    std::mt19937 generator{static_cast<unsigned int>(sharedForms)};
+    for (int i = 0; i < sharedForms; ++i) {
+        std::ostringstream contents;
+        contents << "0.5 w " << uniform(generator, 0, 100) / 100.0 << " g 0 0 "
+                 << uniform(generator, 20, 100) << " " << uniform(generator, 20, 100) << " re f\n";
+
+        QPDFObjectHandle form = QPDFObjectHandle::newStream(&pdf, contents.str());
+        form.replaceDict(QPDFObjectHandle::parse("<< /Type /XObject /Subtype /Form /BBox [0 0 100 100] >>"));
+        forms.replaceKey("/Fm" + std::to_string(i), form);
+    }
+
+    QPDFObjectHandle resources = QPDFObjectHandle::newDictionary();
+    resources.replaceKey("/Font", fonts);
+    resources.replaceKey("/XObject", forms);
+
+    return pdf.makeIndirectObject(resources);
+}
+
+} // namespace
+
+std::string contentName(Content content)
+{
+    switch (content) {
+    case Content::Text:
+        return "text";
+    case Content::Vector:
+        return "vector";
+    case Content::Scanned:
+        return "scanned";
+    case Content::SharedResources:
+        return "shared";
+    case Content::Mixed:
+        return "mixed";
+    }
+
+    return "";
+}
+
+std::optional<Content> contentFromName(const std::string& name)
+{
+    for (Content content : {Content::Text, Content::Vector, Content::Scanned, Content::SharedResources, Content::Mixed}) {
+        if (contentName(content) == name)
+            return content;
+    }
+
+    return std::nullopt;
+}
+
+void write(const Options& options, const std::string& path)
+{
+    QPDF pdf;
+    pdf.emptyPDF();
+
+#if defined(QPDF_MAJOR_VERSION) && QPDF_MAJOR_VERSION >= 11
+    auto streams = std::make_shared<StreamProvider>(options);
+    const std::shared_ptr<QPDFObjectHandle::StreamDataProvider> provider = streams;
+#else
+    auto* streams = new StreamProvider{options};
+    const PointerHolder<QPDFObjectHandle::StreamDataProvider> provider{streams};
+#endif
+
+    QPDFObjectHandle textResources = QPDFObjectHandle::parse("<< /Font << >> >>");
+    textResources.getKey("/Font").replaceKey(
+        "/F1", pdf.makeIndirectObject(QPDFObjectHandle::parse("<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>")));
+    textResources = pdf.makeIndirectObject(textResources);
+
+    QPDFObjectHandle sharedResources;
+    if (options.content == Content::SharedResources || options.content == Content::Mixed)
+        sharedResources = createSharedResources(pdf);
+
+    QPDFPageDocumentHelper pages{pdf};
+
+    for (unsigned int pageIndex = 0; pageIndex < options.numberOfPages; ++pageIndex) {
+        std::mt19937 generator = generatorFor(options, pageIndex);
+        int rotation = 0;
+        const PageSize size = pageSizeFor(options, generator, rotation);
+        const Content content = options.content == Content::Mixed ? mixedContents.at(pageIndex % mixedContents.size())
+                                                                  : options.content;
+
+        QPDFObjectHandle page = QPDFObjectHandle::parse("<< /Type /Page >>");
+        page.replaceKey("/MediaBox", QPDFObjectHandle::parse("[0 0 " + std::to_string(size.width) + " "
+                                                             + std::to_string(size.height) + "]"));
+        if (rotation != 0)
+            page.replaceKey("/Rotate", QPDFObjectHandle::newInteger(rotation));
+
+        switch (content) {
+        case Content::Text:
+            page.replaceKey("/Resources", textResources);
+            break;
+        case Content::Scanned: {
+            const auto variant = pageIndex % imageVariants;
+            QPDFObjectHandle image = QPDFObjectHandle::newStream(&pdf);
+            image.replaceDict(QPDFObjectHandle::parse("<< /Type /XObject /Subtype /Image /ColorSpace /DeviceRGB"
+                                                      " /BitsPerComponent 8 >>"));
+            image.getDict().replaceKey("/Width", QPDFObjectHandle::newInteger(streams->imageWidth()));
+            image.getDict().replaceKey("/Height", QPDFObjectHandle::newInteger(streams->imageHeight()));
+            image.replaceStreamData(provider, QPDFObjectHandle::newName("/DCTDecode"), QPDFObjectHandle::newNull());
+            streams->addImage(image.getObjectID(), variant);
+
+            QPDFObjectHandle resources = QPDFObjectHandle::parse("<< /XObject << >> >>");
+            resources.getKey("/XObject").replaceKey("/Im0", image);
+            page.replaceKey("/Resources", resources);
+            break;
+        }
+        case Content::SharedResources:
+            page.replaceKey("/Resources", sharedResources);
+            break;
+        default:
+            page.replaceKey("/Resources", QPDFObjectHandle::newDictionary());
+            break;
+        }
+
+        QPDFObjectHandle contents = QPDFObjectHandle::newStream(&pdf);
+        contents.replaceStreamData(provider, QPDFObjectHandle::newNull(), QPDFObjectHandle::newNull());
+        streams->addPage(contents.getObjectID(), {pageIndex, content, size});
+        page.replaceKey("/Contents", contents);
+
+        pages.addPage(QPDFPageObjectHelper{pdf.makeIndirectObject(page)}, false);
+    }
+
+    QPDFWriter writer{pdf, path.c_str()};
+    writer.setObjectStreamMode(qpdf_o_generate);
+    writer.write();
+}
+
+} // namespace Slicer::Benchmark::SyntheticPdf
@@ -0,0 +1,44 @@
+#ifndef SLICER_BENCHMARK_SYNTHETICPDF_HPP
+#define SLICER_BENCHMARK_SYNTHETICPDF_HPP
+
+#include <optional>
+#include <string>
+
+namespace Slicer::Benchmark::SyntheticPdf {
+
+// Made up PDF files shaped like the ones that are slow in production, of
+// any number of pages. The same options and seed give the same file.
+// Page contents are made while writing, so that memory doesn't grow with
+// the size of the file, only with its number of pages.
+
+enum class Content {
+    Text, // A few dozen lines in one shared font
+    Vector, // Over a thousand stroked curves
+    Scanned, // A JPEG over the whole page, its own for every page
+    SharedResources, // A little of one big resource dictionary every page shares
+    Mixed // All of the above, in turns
+};
+
+enum class Sizes {
+    Uniform, // A4 portrait
+    Mixed // A4, Letter, A3 and A5, some landscape, some with /Rotate
+};
+
+struct Options {
+    unsigned int numberOfPages = 100;
+    Content content = Content::Text;
+    Sizes sizes = Sizes::Uniform;
+    unsigned int seed = 1;
+    // The longer side of scanned images, in pixels
+    int imageSize = 1000;
+};
+
+std::string contentName(Content content);
+std::optional<Content> contentFromName(const std::string& name);
+
+// Throws whatever qpdf or GdkPixbuf throw
+void write(const Options& options, const std::string& path);
+
+} // namespace Slicer::Benchmark::SyntheticPdf
+
+#endif // SLICER_BENCHMARK_SYNTHETICPDF_HPP
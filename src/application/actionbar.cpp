@@ -75,6 +75,12 @@ ActionBar::ActionBar()
     Glib::RefPtr<Gio::Menu> selectMenu = Gio::Menu::create();
     selectMenu->append(_("Select odd pages"), "win.select-odd");
     selectMenu->append(_("Select even pages"), "win.select-even");
+    selectMenu->append(_("Select portrait pages"), "win.select-portrait");
+    selectMenu->append(_("Select landscape pages"), "win.select-landscape");
+    selectMenu->append(_("Select pages…"), "win.select-pages");
+    selectMenu->append(_("Select pages with text…"), "win.select-text");
+    selectMenu->append(_("Select blank pages"), "win.select-blank");
+    selectMenu->append(_("Select duplicate pages"), "win.select-duplicates");
     m_buttonSelectMore.set_menu_model(selectMenu);
     m_buttonSelectMore.set_image_from_icon_name("pan-up-symbolic");
     m_buttonSelectMore.set_tooltip_text(_("More page selecting options…"));
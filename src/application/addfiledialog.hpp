@@ -17,15 +17,22 @@
 #ifndef SLICER_ADDFILEDIALOG_HPP
 #define SLICER_ADDFILEDIALOG_HPP
 
-#include <gtkmm/filechoosernative.h>
+#include "filepreview.hpp"
+#include <gtkmm/filechooserdialog.h>
 #include <optional>
 
 namespace Slicer {
 
-class AddFileDialog : public Gtk::FileChooserNative {
+// Not a native chooser, which can't show the preview of the file picked
+class AddFileDialog : public Gtk::FileChooserDialog {
 public:
     AddFileDialog(Gtk::Window& parent,
+                  TaskRunner& taskRunner,
+                  SharedThumbnails& thumbnails,
                   std::optional<std::string> folderPath = {});
+
+private:
+    FilePreview m_preview;
 };
 
 } // namespace Slicer
@@ -17,26 +17,105 @@
 #include "application.hpp"
 #include <document.hpp>
 #include <giomm/menu.h>
+#include <glibmm/main.h>
 #include <glibmm/miscutils.h>
 #include <glibmm/i18n.h>
 #include <config.hpp>
+#include <logger.hpp>
+#include <pageindex.hpp>
+#include <renderbufferpool.hpp>
+#include <session.hpp>
+#include <snapshotstore.hpp>
+#include <algorithm>
+#include <chrono>
 
 namespace Slicer {
 
-Glib::RefPtr<Application> Application::create()
+Glib::RefPtr<Application> Application::create(Trace::Clock::time_point launchTime)
 {
-    return Glib::RefPtr<Application>{new Application{}};
+    return Glib::RefPtr<Application>{new Application{launchTime}};
 }
 
-Application::Application()
+Application::Application(Trace::Clock::time_point launchTime)
     : Gtk::Application(config::APPLICATION_ID, Gio::APPLICATION_HANDLES_OPEN)
+    , m_taskRunner{m_settingsManager.loadRenderThreads()}
+    , m_launchTime{launchTime}
+    , m_throttlesInBackground{m_settingsManager.loadThrottleInBackground()}
+    , m_isResident{m_settingsManager.loadResident()}
+    , m_residentMemory{m_settingsManager.loadResidentMemory()}
+    , m_thumbnailCacheSize{m_settingsManager.loadThumbnailCacheSize()}
 {
     Glib::set_application_name(config::APPLICATION_NAME);
+    m_startupMetrics = Metrics::snapshot();
+
+    m_taskRunner.setTuning(m_settingsManager.loadTuneRenderThreads(), m_settingsManager.loadMinimumRenderThreads());
+    m_thumbnails.cache().setCapacity(m_thumbnailCacheSize);
+    m_thumbnails.setRenderBudget(m_settingsManager.loadRenderBudget());
+
+    if (const std::size_t diskCacheSize = m_settingsManager.loadDiskThumbnailCacheSize(); diskCacheSize > 0) {
+        const std::string thumbnailsPath = Glib::build_filename(config::getCacheDirPath(), "thumbnails");
+        m_thumbnails.setDiskCache(std::make_shared<DiskThumbnailCache>(thumbnailsPath, diskCacheSize));
+    }
+
+    if (const std::string daemon = m_settingsManager.loadRenderDaemon(); !daemon.empty()) {
+        m_thumbnails.setRenderProcessPool(std::make_shared<RenderProcessPool>(RenderProcessPool::Target::Daemon,
+                                                                              daemon,
+                                                                              static_cast<unsigned>(m_taskRunner.numberOfThreads())));
+    }
+    else if (m_settingsManager.loadRenderProcesses()) {
+        if (const std::string helper = RenderProcessPool::findHelper(); !helper.empty())
+            m_thumbnails.setRenderProcessPool(std::make_shared<RenderProcessPool>(helper,
+                                                                                  static_cast<unsigned>(m_taskRunner.numberOfThreads())));
+        else
+            Logger::logWarning(std::string{"Rendering in this process: "} + RenderProcessPool::helperName + " wasn't found");
+    }
+
+    PageIndex::setDirectory(Glib::build_filename(config::getCacheDirPath(), "page-index"));
+    SnapshotStore::setDirectory(Glib::build_filename(config::getCacheDirPath(), "snapshots"));
+    Session::setDirectory(Glib::build_filename(config::getConfigDirPath(), "session"));
+
+    // Reopening a recent file then doesn't even read its index from disk
+    if (m_isResident)
+        PageIndex::setMemoryBudget(m_residentMemory / residentIndexShare);
+}
+
+Application::~Application()
+{
+#if GLIB_CHECK_VERSION(2, 64, 0)
+    if (m_memoryMonitor != nullptr) {
+        g_signal_handlers_disconnect_by_data(m_memoryMonitor, this);
+        g_object_unref(m_memoryMonitor);
+    }
+#endif
+
+#if GLIB_CHECK_VERSION(2, 70, 0)
+    if (m_powerProfileMonitor != nullptr) {
+        g_signal_handlers_disconnect_by_data(m_powerProfileMonitor, this);
+        g_object_unref(m_powerProfileMonitor);
+    }
+#endif
+
+    m_firstFrameConnection.disconnect();
+    m_startupBenchmarkConnection.disconnect();
+    m_renderPolicyUpdate.disconnect();
+    m_sessionStoreConnection.disconnect();
+
+    if (m_sessionStore.valid())
+        m_sessionStore.wait();
+
+    // What the session was like to use, for reports of it feeling slow
+    if (const std::string latencies = Metrics::describeLatencies(); !latencies.empty())
+        Logger::logInfo("Latencies of the session:\n" + latencies);
 }
 
 void Application::addActions()
 {
     m_newWindowAction = add_action("new-window", sigc::mem_fun(*this, &Application::onNewWindowAction));
+    // Exported on the session bus like every application action, so it can be triggered
+    // from outside with `gapplication action <application id> log-metrics`
+    m_logMetricsAction = add_action("log-metrics", sigc::mem_fun(*this, &Application::onLogMetricsAction));
+    // The way out of resident mode, the same way: `gapplication action <application id> quit`
+    m_quitAction = add_action("quit", sigc::mem_fun(*this, &Application::onQuitAction));
 }
 
 void Application::on_startup()
@@ -46,18 +125,278 @@ void Application::on_startup()
     Gtk::Window::set_default_icon_name(config::APPLICATION_ID);
     addActions();
     addAccels();
+    setupMemoryMonitor();
+    setupPowerProfileMonitor();
+    // Only the primary instance gets here, the one jobs go to
+    m_jobService.registerObject();
+
+    if (!Glib::getenv("SLICER_STARTUP_BENCHMARK").empty())
+        quitAfterFirstThumbnail();
+}
+
+void Application::quitAfterFirstThumbnail()
+{
+    const Trace::Clock::time_point start = Trace::Clock::now();
+
+    m_startupBenchmarkConnection = Glib::signal_timeout().connect([this, start]() {
+        const bool isThumbnailShown = Metrics::histogram(Metrics::Latency::OpenToFirstThumbnail).numberOfSamples() > 0;
+        if (!isThumbnailShown && Trace::Clock::now() - start < startupBenchmarkTimeout)
+            return true;
+
+        if (!isThumbnailShown)
+            Logger::logWarning("No thumbnail was shown for the startup benchmark");
+
+        quit();
+        return false;
+    },
+                                                                  10);
+}
+
+void Application::setupMemoryMonitor()
+{
+#if GLIB_CHECK_VERSION(2, 64, 0)
+    m_memoryMonitor = g_memory_monitor_dup_default();
+    g_signal_connect(m_memoryMonitor, "low-memory-warning", G_CALLBACK(&Application::onLowMemoryWarning), this);
+#endif
+}
+
+#if GLIB_CHECK_VERSION(2, 64, 0)
+void Application::onLowMemoryWarning(GMemoryMonitor*, GMemoryMonitorWarningLevel level, gpointer self)
+{
+    Logger::logWarning("Low memory warning, level " + std::to_string(static_cast<int>(level)));
+
+    static_cast<Application*>(self)->releaseMemory();
+}
+#endif
+
+void Application::setupPowerProfileMonitor()
+{
+#if GLIB_CHECK_VERSION(2, 70, 0)
+    if (!m_throttlesInBackground)
+        return;
+
+    m_powerProfileMonitor = g_power_profile_monitor_dup_default();
+    g_signal_connect(m_powerProfileMonitor,
+                     "notify::power-saver-enabled",
+                     G_CALLBACK(&Application::onPowerSaverChanged),
+                     this);
+#endif
+}
+
+#if GLIB_CHECK_VERSION(2, 70, 0)
+void Application::onPowerSaverChanged(GObject*, GParamSpec*, gpointer self)
+{
+    static_cast<Application*>(self)->queueRenderPolicyUpdate();
+}
+#endif
+
+void Application::queueRenderPolicyUpdate()
+{
+    if (!m_throttlesInBackground || m_renderPolicyUpdate.connected())
+        return;
+
+    m_renderPolicyUpdate = Glib::signal_idle().connect([this]() {
+        updateRenderPolicy();
+
+        return false;
+    });
+}
+
+void Application::updateRenderPolicy()
+{
+    bool isFocused = false;
+    for (Gtk::Window* window : Gtk::Window::list_toplevels())
+        isFocused = isFocused || window->is_active();
+
+    bool isSavingPower = false;
+#if GLIB_CHECK_VERSION(2, 70, 0)
+    isSavingPower = m_powerProfileMonitor != nullptr
+                    && g_power_profile_monitor_get_power_saver_enabled(m_powerProfileMonitor) != FALSE;
+#endif
+
+    // In the background, a quarter of them is enough to finish what's left
+    // without taking the cores from the application in front. Saving power,
+    // half of them at most, and a single one in the background.
+    const int allWorkers = m_taskRunner.numberOfThreads();
+    int workers = isFocused ? allWorkers : std::max(1, allWorkers / 4);
+
+    if (isSavingPower)
+        workers = isFocused ? std::max(1, allWorkers / 2) : 1;
+
+    if (workers == m_taskRunner.maximumActiveWorkers())
+        return;
+
+    Logger::logDebug("Render workers: " + std::to_string(workers) + " of " + std::to_string(allWorkers)
+                     + (isFocused ? "" : ", in the background")
+                     + (isSavingPower ? ", saving power" : ""));
+    m_taskRunner.setActiveWorkers(workers);
+}
+
+void Application::releaseMemory()
+{
+    for (Gtk::Window* window : get_windows()) {
+        if (auto appWindow = dynamic_cast<AppWindow*>(window); appWindow != nullptr)
+            appWindow->releaseMemory();
+    }
+
+    for (const std::shared_ptr<RenderBufferPool>& pool : RenderBufferPool::sharedPools())
+        pool->trim();
 }
 
 void Application::on_activate()
 {
+    recordActivation();
+
+    // Launched again while running, it's for a new window
+    const bool isFirstActivation = m_isFirstActivation;
+    m_isFirstActivation = false;
+
+    // Resident without windows, it's like launching again
+    if ((isFirstActivation || (m_isHeld && !hasWindows())) && restoreSession())
+        return;
+
     createWindow()->present();
 }
 
+bool Application::restoreSession()
+{
+    const Trace::Span span{"Application::restoreSession"};
+    const std::vector<Session::DocumentState> documents = Session::load();
+
+    for (const Session::DocumentState& document : documents) {
+        AppWindow* window = createWindow();
+        window->restoreSession(document);
+        window->present();
+    }
+
+    return !documents.empty();
+}
+
+void Application::queueSessionStore()
+{
+    if (!Session::isEnabled() || m_sessionStoreConnection.connected())
+        return;
+
+    m_sessionStoreConnection = Glib::signal_timeout().connect([this]() {
+        // Tried again later while the last store is still copying
+        if (m_sessionStore.valid() && m_sessionStore.wait_for(std::chrono::seconds{0}) != std::future_status::ready)
+            return true;
+
+        m_sessionStore = std::async(std::launch::async, [documents = sessionStates()]() {
+            Session::store(documents);
+        });
+
+        return false;
+    },
+                                                              sessionStoreDelay);
+}
+
+std::vector<Session::DocumentState> Application::sessionStates(const AppWindow* closedWindow) const
+{
+    std::vector<Session::DocumentState> documents;
+
+    for (const Gtk::Window* window : get_windows()) {
+        const auto appWindow = dynamic_cast<const AppWindow*>(window);
+        if (appWindow == nullptr || appWindow == closedWindow)
+            continue;
+
+        if (std::optional<Session::DocumentState> state = appWindow->sessionState(); state.has_value())
+            documents.push_back(std::move(state.value()));
+    }
+
+    return documents;
+}
+
+void Application::onWindowHidden(AppWindow& window)
+{
+    const std::vector<Gtk::Window*> windows = get_windows();
+    const bool isLastWindow = std::none_of(windows.begin(), windows.end(), [&window](Gtk::Window* other) {
+        return other != &window && dynamic_cast<AppWindow*>(other) != nullptr;
+    });
+
+    if (!isLastWindow) {
+        // Closing one window of several leaves its document out of the session
+        queueSessionStore();
+        return;
+    }
+
+    // Quitting: what this window has is what comes back next time
+    m_sessionStoreConnection.disconnect();
+    if (m_sessionStore.valid())
+        m_sessionStore.wait();
+
+    std::vector<Session::DocumentState> documents;
+    if (std::optional<Session::DocumentState> state = window.sessionState(); state.has_value())
+        documents.push_back(std::move(state.value()));
+
+    Session::store(documents);
+
+    if (m_isResident)
+        stayResident();
+}
+
+void Application::stayResident()
+{
+    if (!m_isHeld) {
+        hold();
+        m_isHeld = true;
+    }
+
+    // Whatever goes past the budget goes first, the least recently used
+    const std::size_t thumbnailMemory = m_residentMemory - m_residentMemory / residentIndexShare;
+    m_thumbnails.cache().setCapacity(std::min(m_thumbnailCacheSize, thumbnailMemory));
+    for (const std::shared_ptr<RenderBufferPool>& pool : RenderBufferPool::sharedPools())
+        pool->trim();
+
+    Logger::logInfo("Staying resident, with " + std::to_string(m_residentMemory / (1024 * 1024)) + " MB of caches");
+}
+
+bool Application::hasWindows() const
+{
+    const std::vector<const Gtk::Window*> windows = get_windows();
+
+    return std::any_of(windows.begin(), windows.end(), [](const Gtk::Window* window) {
+        return dynamic_cast<const AppWindow*>(window) != nullptr;
+    });
+}
+
 void Application::onNewWindowAction()
 {
     createWindow()->present();
 }
 
+void Application::onLogMetricsAction()
+{
+    std::string report = "Metrics since startup:\n" + Metrics::describe(m_startupMetrics, Metrics::snapshot());
+
+    for (Gtk::Window* window : get_windows()) {
+        if (auto appWindow = dynamic_cast<AppWindow*>(window); appWindow != nullptr)
+            report += "\n" + appWindow->resourceReport();
+    }
+
+    report += "\nMemory held, estimated:\n" + Metrics::describeMemory();
+
+    if (const std::string latencies = Metrics::describeLatencies(); !latencies.empty())
+        report += "\nLatencies since startup:\n" + latencies;
+
+    if (const std::string slowestPages = Metrics::describeSlowestPages(); !slowestPages.empty())
+        report += "\nSlowest pages since startup:\n" + slowestPages;
+
+    Logger::logInfo(report);
+}
+
+void Application::onQuitAction()
+{
+    // Open windows are closed as usual, and the application goes with the last one
+    if (m_isHeld) {
+        m_isHeld = false;
+        release();
+    }
+
+    if (!hasWindows())
+        quit();
+}
+
 void Application::addAccels()
 {
     set_accel_for_action("app.new-window", "<Control>n");
@@ -70,6 +409,7 @@ void Application::addAccels()
     set_accel_for_action("win.preview-selected", "KP_Space");
     set_accel_for_action("win.select-all", "<Control>a");
     set_accel_for_action("win.invert-selection", "<Control>i");
+    set_accel_for_action("win.select-pages", "<Control><Shift>a");
     set_accel_for_action("win.cancel-selection", "Escape");
     set_accels_for_action("win.zoom-in",
                           {"<Control>plus", "<Control>KP_Add"});
@@ -77,6 +417,7 @@ void Application::addAccels()
                           {"<Control>minus", "<Control>KP_Subtract"});
     set_accel_for_action("win.reset-zoom", "<Control>0");
     set_accel_for_action("win.close-window", "<Control>q");
+    set_accel_for_action("win.show-metrics", "<Control><Shift>m");
 
     // FIXME: The following actions don't work
     set_accels_for_action("preview.zoom-in",
@@ -96,22 +437,61 @@ void Application::setupAppMenu()
 void Application::on_open(const Application::type_vec_files& files,
                           __attribute__((unused)) const Glib::ustring& hint)
 {
+    recordActivation();
+    m_isFirstActivation = false;
+
     AppWindow* window = createWindow();
-    window->setDocument(std::make_unique<Document>(files));
+    window->openDocuments(files);
     window->present();
 }
 
 AppWindow* Application::createWindow()
 {
-    auto window = new Slicer::AppWindow{m_taskRunner, m_settingsManager}; //NOLINT
+    // Back from being resident
+    m_taskRunner.setTuning(m_settingsManager.loadTuneRenderThreads(), m_settingsManager.loadMinimumRenderThreads());
+    m_thumbnails.cache().setCapacity(m_thumbnailCacheSize);
+
+    auto window = new Slicer::AppWindow{m_taskRunner, m_thumbnails, m_textIndexer, m_settingsManager}; //NOLINT
 
-    window->signal_hide().connect([window]() {
+    window->signal_hide().connect([this, window]() {
+        onWindowHidden(*window);
         delete window; //NOLINT
     });
+    window->sessionChanged.connect(sigc::mem_fun(*this, &Application::queueSessionStore));
 
     add_window(*window);
 
+    window->property_is_active().signal_changed().connect(sigc::mem_fun(*this, &Application::queueRenderPolicyUpdate));
+
+    if (m_launchTime != Trace::Clock::time_point{}) {
+        measureFirstFrame(*window);
+        m_launchTime = {};
+    }
+
     return window;
 }
 
+void Application::recordActivation()
+{
+    // Only the first one: createWindow() forgets the launch time
+    if (m_launchTime != Trace::Clock::time_point{})
+        Trace::record("Startup::activate", m_launchTime, Trace::Clock::now());
+}
+
+void Application::measureFirstFrame(AppWindow& window)
+{
+    m_firstFrameConnection = window.signal_draw().connect(
+        [this, launchTime = m_launchTime](const Cairo::RefPtr<Cairo::Context>&) {
+            const Trace::Clock::time_point now = Trace::Clock::now();
+            const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - launchTime);
+
+            Trace::record("Startup::first frame", launchTime, now);
+            Logger::logInfo("First frame " + std::to_string(elapsed.count()) + " ms after launch");
+
+            m_firstFrameConnection.disconnect();
+            return false;
+        },
+        false);
+}
+
 } // namespace Slicer
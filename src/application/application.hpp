@@ -18,40 +18,108 @@
 #define APPLICATION_HPP
 
 #include "appwindow.hpp"
+#include "jobservice.hpp"
+#include "sharedthumbnails.hpp"
+#include "textindexer.hpp"
+#include <trace.hpp>
 #include <gtkmm/application.h>
 #include <giomm/simpleaction.h>
+#include <gio/gio.h>
+#include <future>
 
 namespace Slicer {
 
 class Application : public Gtk::Application {
 public:
-    static Glib::RefPtr<Application> create();
+    // launchTime is when main started, to measure the time to the first frame
+    static Glib::RefPtr<Application> create(Trace::Clock::time_point launchTime);
 
     Application(const Application&) = delete;
     Application& operator=(const Application&) = delete;
     Application(Application&&) = delete;
     Application& operator=(Application&& src) = delete;
 
-    ~Application() override = default;
+    ~Application() override;
 
 private:
-    TaskRunner m_taskRunner;
     SettingsManager m_settingsManager;
+    TaskRunner m_taskRunner;
+    // Destroyed before the task runner it queues renders in
+    SharedThumbnails m_thumbnails{m_taskRunner};
+    TextIndexer m_textIndexer{m_taskRunner};
+    JobService m_jobService{*this, m_taskRunner};
 
     Glib::RefPtr<Gio::SimpleAction> m_newWindowAction;
-
-    Application();
+    Glib::RefPtr<Gio::SimpleAction> m_logMetricsAction;
+    Metrics::Snapshot m_startupMetrics;
+    Trace::Clock::time_point m_launchTime;
+    sigc::connection m_firstFrameConnection;
+    // With SLICER_STARTUP_BENCHMARK set, the application quits once the
+    // document it was launched with shows a thumbnail, see benchmarks/startup.cpp
+    sigc::connection m_startupBenchmarkConnection;
+    static constexpr std::chrono::seconds startupBenchmarkTimeout{60};
+
+    // The documents of every window are stored shortly after they change,
+    // on a worker thread, one store at a time, and restored on the next launch
+    bool m_isFirstActivation = true;
+    sigc::connection m_sessionStoreConnection;
+    std::future<void> m_sessionStore;
+    static constexpr unsigned int sessionStoreDelay = 2000;
+
+#if GLIB_CHECK_VERSION(2, 64, 0)
+    GMemoryMonitor* m_memoryMonitor = nullptr;
+    static void onLowMemoryWarning(GMemoryMonitor* monitor, GMemoryMonitorWarningLevel level, gpointer self);
+#endif
+
+    // Fewer workers render while no window has the focus, or the system saves power
+    bool m_throttlesInBackground;
+    sigc::connection m_renderPolicyUpdate;
+#if GLIB_CHECK_VERSION(2, 70, 0)
+    GPowerProfileMonitor* m_powerProfileMonitor = nullptr;
+    static void onPowerSaverChanged(GObject* monitor, GParamSpec* property, gpointer self);
+#endif
+
+    // Stays running without windows, if set so: what's cached is there for
+    // the next window, within residentMemory, see SettingsManager::loadResident()
+    bool m_isResident;
+    std::size_t m_residentMemory;
+    bool m_isHeld = false;
+    std::size_t m_thumbnailCacheSize;
+    Glib::RefPtr<Gio::SimpleAction> m_quitAction;
+    // The part of the resident memory for the page indexes of recent files
+    static constexpr std::size_t residentIndexShare = 8;
+
+    explicit Application(Trace::Clock::time_point launchTime);
     AppWindow* createWindow();
+    void measureFirstFrame(AppWindow& window);
+    void recordActivation();
+    void quitAfterFirstThumbnail();
 
     void addActions();
     void addAccels();
     void setupAppMenu();
+    void setupMemoryMonitor();
+    void setupPowerProfileMonitor();
+    // Once focus changes settle, since it goes through several windows at a time
+    void queueRenderPolicyUpdate();
+    void updateRenderPolicy();
+    void releaseMemory();
+    // Opens a window for each document of the last session; false if there's none
+    bool restoreSession();
+    void queueSessionStore();
+    // Of the windows that remain, leaving out closedWindow
+    std::vector<Session::DocumentState> sessionStates(const AppWindow* closedWindow = nullptr) const;
+    void onWindowHidden(AppWindow& window);
+    void stayResident();
+    bool hasWindows() const;
 
     void on_startup() override;
     void on_activate() override;
     void on_open(const Gio::Application::type_vec_files& files,
                  const Glib::ustring& hint) override;
     void onNewWindowAction();
+    void onLogMetricsAction();
+    void onQuitAction();
 };
 
 } // namespace Slicer
@@ -60,6 +60,10 @@ void AppMenu::setupWidgets()
     m_zoomSlider.add_mark(4, Gtk::POS_BOTTOM, "");
     m_zoomSlider.set_size_request(150, -1);
 
+    m_exportImagesButton.set_label(_("Export pages as images…"));
+    gtk_actionable_set_action_name(GTK_ACTIONABLE(m_exportImagesButton.gobj()), "win.export-images"); //NOLINT
+    m_exportImagesButton.get_style_context()->add_class("flat");
+    m_exportImagesButton.get_child()->set_halign(Gtk::ALIGN_START);
     m_newWindowButton.set_label(_("New window"));
     gtk_actionable_set_action_name(GTK_ACTIONABLE(m_newWindowButton.gobj()), "app.new-window"); //NOLINT
     m_newWindowButton.get_style_context()->add_class("flat");
@@ -78,6 +82,7 @@ void AppMenu::setupWidgets()
     m_contentBox.pack_start(m_zoomSeparatorBox);
     m_contentBox.pack_start(m_zoomSlider);
     m_contentBox.pack_start(m_appSeparator, Gtk::PACK_EXPAND_PADDING, 5);
+    m_contentBox.pack_start(m_exportImagesButton);
     m_contentBox.pack_start(m_newWindowButton);
     m_contentBox.pack_start(m_shortcutsButton);
     m_contentBox.pack_start(m_aboutButton);
@@ -17,57 +17,151 @@
 #include "appwindow.hpp"
 #include "aboutdialog.hpp"
 #include "addfiledialog.hpp"
+#include "exportimagesdialog.hpp"
 #include "openfiledialog.hpp"
 #include "savefiledialog.hpp"
 #include "guicommand.hpp"
+#include "selectpagesdialog.hpp"
+#include "selecttextdialog.hpp"
 #include "unsavedchangesdialog.hpp"
+#include <cpuresources.hpp>
+#include <mappedfile.hpp>
+#include <pagerangeexpression.hpp>
 #include <pdfsaver.hpp>
 #include <glibmm/convert.h>
 #include <glibmm/main.h>
+#include <glibmm/miscutils.h>
 #include <glibmm/i18n.h>
 #include <gtkmm/builder.h>
 #include <gtkmm/cssprovider.h>
 #include <gtkmm/messagedialog.h>
+#include <gtkmm/recentmanager.h>
 #include <gtkmm/shortcutswindow.h>
 #include <config.hpp>
 #include <logger.hpp>
+#include <trace.hpp>
+#include <fmt/format.h>
+#include <deque>
+#include <map>
+#include <future>
+#include <numeric>
+
+using namespace fmt::literals;
 
 namespace Slicer {
 
 const std::vector<int> AppWindow::zoomLevels = {200, 300, 400, 550, 700};
 
-AppWindow::AppWindow(TaskRunner& taskRunner, SettingsManager& settingsManager)
+AppWindow::AppWindow(TaskRunner& taskRunner,
+                     SharedThumbnails& thumbnails,
+                     TextIndexer& textIndexer,
+                     SettingsManager& settingsManager)
     : m_taskRunner{taskRunner}
+    , m_thumbnails{thumbnails}
+    , m_textIndexer{textIndexer}
+    , m_pageInspector{taskRunner, thumbnails}
     , m_settingsManager{settingsManager}
     , m_windowState{}
     , m_zoomLevel{zoomLevels, *this}
     , m_headerBar{m_zoomLevel.zoomLevelIndex()}
+    , m_welcomeScreen{taskRunner, thumbnails}
     , m_view{m_taskRunner,
-             std::bind(&AppWindow::onViewMouseWheelUp, this),
-             std::bind(&AppWindow::onViewMouseWheelDown, this)}
+             thumbnails,
+             std::bind(&AppWindow::onViewZoom, this, std::placeholders::_1)}
+    , m_minimap{m_taskRunner}
 {
+    const Trace::Span span{"AppWindow::AppWindow"};
+
     set_size_request(500, 500);
 
     loadPreviousSessionState();
-    loadWidgets();
     addActions();
     setupWidgets();
     setupSignalHandlers();
     loadCustomCSS();
+    updateFrameProfiling();
 
     show_all_children();
 }
 
 AppWindow::~AppWindow()
 {
+    *m_isAlive = false;
+    disconnectFrameClock();
+    if (m_isProfilingFrames)
+        FrameProfiler::shared().release();
+    m_selectedPagesChangedConnection.disconnect();
+    m_metricsUpdateConnection.disconnect();
+    m_textIndexUpdate.disconnect();
+    m_savePreparation.disconnect();
+    cancelOpening();
+    cancelReloading();
     saveCurrentSessionState();
 }
 
-void AppWindow::setDocument(std::unique_ptr<Document> document)
+void AppWindow::releaseMemory()
+{
+    m_view.releaseMemory();
+
+    if (m_document != nullptr)
+        m_document->parsedFileCache()->clear();
+}
+
+std::string AppWindow::resourceReport() const
+{
+    const double thumbnailMegabytes = static_cast<double>(m_view.thumbnailCacheSizeInBytes()) / (1024.0 * 1024.0);
+    const double historyMegabytes = static_cast<double>(m_commandManager.historySizeInBytes()) / (1024.0 * 1024.0);
+
+    return fmt::format("Queued tasks: {}\nRenders in flight: {}\nThumbnails resident: {:.1f} MB\nUndo history: {:.1f} MB",
+                       m_taskRunner.numberOfPendingTasks(),
+                       m_view.numberOfRendersInFlight(),
+                       thumbnailMegabytes,
+                       historyMegabytes);
+}
+
+std::optional<Session::DocumentState> AppWindow::sessionState() const
 {
+    if (m_document == nullptr)
+        return {};
+
+    Session::DocumentState state = m_document->sessionState();
+    if (state.pages.empty())
+        return {};
+
+    return state;
+}
+
+void AppWindow::restoreSession(const Session::DocumentState& state)
+{
+    cancelOpening();
+
+    auto document = std::make_unique<Document>(state);
+    const bool hasSeveralFiles = document->numberOfLiveFiles() > 1;
+    const Glib::RefPtr<Gio::File> firstFile = Gio::File::create_for_uri(state.files.at(state.pages.front().file).originalUri);
+
+    showDocument(std::move(document));
+    m_headerBar.set_title(Glib::filename_display_name(firstFile->get_basename()));
+    m_headerBar.set_subtitle(hasSeveralFiles ? _("Multiple files added") : "");
+    m_view.setShowFileNames(hasSeveralFiles);
+}
+
+void AppWindow::showDocument(std::unique_ptr<Document> document)
+{
+    m_pageInspector.cancel();
+    cancelReloading();
+    m_sourceWatcher.clear();
     m_document = std::move(document);
     m_view.setDocument(*m_document, m_zoomLevel.currentLevel());
     m_view.setShowFileNames(false);
+    m_minimap.setDocument(*m_document);
+
+    // The thumbnails of the document shown before don't count
+    if (m_openStartTime.has_value()) {
+        measureLatency(Metrics::Latency::OpenToFirstThumbnail, *m_openStartTime, [this]() {
+            return m_view.isAnyThumbnailShown();
+        });
+        m_openStartTime.reset();
+    }
 
     m_stack.set_visible_child("editor");
 
@@ -75,12 +169,66 @@ void AppWindow::setDocument(std::unique_ptr<Document> document)
     m_headerBar.enableAddDocumentButton();
     m_headerBar.enableZoomSlider();
     m_saveAction->set_enabled();
+    m_exportImagesAction->set_enabled(!m_exportExecutor.isExporting() && !m_saveExecutor.isSaving());
     m_zoomLevel.enable();
+
+    m_document->pages()->signal_items_changed().connect([this](guint, guint, guint added) {
+        if (added > 0) {
+            queueTextIndexUpdate();
+            queueSavePreparation();
+            m_sourceWatcher.watch(*m_document);
+        }
+
+        sessionChanged.emit();
+    });
+    queueTextIndexUpdate();
+    queueSavePreparation();
+    m_sourceWatcher.watch(*m_document);
+    sessionChanged.emit();
+}
+
+void AppWindow::queueTextIndexUpdate()
+{
+    if (m_textIndexUpdate.connected())
+        return;
+
+    m_textIndexUpdate = Glib::signal_idle().connect([this]() {
+        if (m_document != nullptr)
+            m_textIndexer.index(*m_document);
+
+        return false;
+    },
+                                                    Glib::PRIORITY_LOW);
+}
+
+void AppWindow::queueSavePreparation()
+{
+    if (m_savePreparation.connected())
+        return;
+
+    // Once the thumbnails in view are queued, and behind them on the workers:
+    // the save that comes next then finds its files parsed, see ParsedFileCache
+    m_savePreparation = Glib::signal_idle().connect([this]() {
+        if (m_document == nullptr || m_document->numberOfPages() == 0)
+            return false;
+
+        // The save data keeps the files alive while they're parsed
+        auto task = std::make_shared<Task>(
+            [cache = m_document->parsedFileCache(),
+             saveData = std::make_shared<const PdfSaver::SaveData>(m_document->getSaveData())]() {
+                cache->prepare(*saveData);
+            },
+            []() {});
+        m_taskRunner.queue(task, TaskRunner::Priority::Idle);
+
+        return false;
+    },
+                                                     Glib::PRIORITY_LOW);
 }
 
 bool AppWindow::on_delete_event(GdkEventAny*)
 {
-    if (m_isSavingDocument)
+    if (m_saveExecutor.isSaving() || m_exportExecutor.isExporting())
         return true;
 
     if (m_isDocumentModified) {
@@ -117,6 +265,9 @@ void AppWindow::loadPreviousSessionState()
         maximize();
 
     m_zoomLevel.zoomLevelIndex().set_value(m_settingsManager.loadZoomLevel());
+    m_commandManager.setHistoryLimits(m_settingsManager.loadUndoSteps(),
+                                      m_settingsManager.loadUndoHistorySize());
+    MappedFile::setEnabled(m_settingsManager.loadMemoryMappedFiles());
 }
 
 void AppWindow::saveCurrentSessionState()
@@ -125,15 +276,19 @@ void AppWindow::saveCurrentSessionState()
     m_settingsManager.saveZoomLevel(m_zoomLevel.zoomLevelIndex().get_value());
 }
 
-void AppWindow::loadWidgets()
+Gtk::ShortcutsWindow& AppWindow::shortcutsWindow()
 {
-    Glib::RefPtr<Gtk::Builder> builder = Gtk::Builder::create_from_resource("/pdfslicer/ui/shortcuts.ui");
-    Gtk::ShortcutsWindow* shortcutsWindow;
-    builder->get_widget("shortcuts-pdfslicer", shortcutsWindow);
+    if (m_shortcutsWindow == nullptr) {
+        Glib::RefPtr<Gtk::Builder> builder = Gtk::Builder::create_from_resource("/pdfslicer/ui/shortcuts.ui");
+        Gtk::ShortcutsWindow* shortcutsWindow;
+        builder->get_widget("shortcuts-pdfslicer", shortcutsWindow);
 
-    shortcutsWindow->set_transient_for(*this);
+        shortcutsWindow->set_transient_for(*this);
 
-    m_shortcutsWindow.reset(shortcutsWindow);
+        m_shortcutsWindow.reset(shortcutsWindow);
+    }
+
+    return *m_shortcutsWindow;
 }
 
 void AppWindow::addActions()
@@ -143,6 +298,7 @@ void AppWindow::addActions()
     m_addDocumentAtEndAction = add_action("add-document-at-end", sigc::mem_fun(*this, &AppWindow::onAddDocumentAtEndAction));
     m_addDocumentAfterSelectedAction = add_action("add-document-after-selected", sigc::mem_fun(*this, &AppWindow::onAddDocumentAfterSelectedAction));
     m_saveAction = add_action("save-document", sigc::mem_fun(*this, &AppWindow::onSaveAction));
+    m_exportImagesAction = add_action("export-images", sigc::mem_fun(*this, &AppWindow::onExportImagesAction));
     m_undoAction = add_action("undo", sigc::mem_fun(*this, &AppWindow::onUndoAction));
     m_redoAction = add_action("redo", sigc::mem_fun(*this, &AppWindow::onRedoAction));
     m_removeSelectedAction = add_action("remove-selected", sigc::mem_fun(*this, &AppWindow::onRemoveSelectedPages));
@@ -156,16 +312,24 @@ void AppWindow::addActions()
     m_selectAllAction = add_action("select-all", sigc::mem_fun(*this, &AppWindow::onSelectAll));
     m_selectOddPagesAction = add_action("select-odd", sigc::mem_fun(*this, &AppWindow::onSelectOddPages));
     m_selectEvenPagesAction = add_action("select-even", sigc::mem_fun(*this, &AppWindow::onSelectEvenPages));
+    m_selectPortraitPagesAction = add_action("select-portrait", sigc::mem_fun(*this, &AppWindow::onSelectPortraitPages));
+    m_selectLandscapePagesAction = add_action("select-landscape", sigc::mem_fun(*this, &AppWindow::onSelectLandscapePages));
+    m_selectPagesAction = add_action("select-pages", sigc::mem_fun(*this, &AppWindow::onSelectPages));
+    m_selectTextAction = add_action("select-text", sigc::mem_fun(*this, &AppWindow::onSelectText));
+    m_selectBlankPagesAction = add_action("select-blank", sigc::mem_fun(*this, &AppWindow::onSelectBlankPages));
+    m_selectDuplicatePagesAction = add_action("select-duplicates", sigc::mem_fun(*this, &AppWindow::onSelectDuplicatePages));
     m_invertSelectionAction = add_action("invert-selection", sigc::mem_fun(*this, &AppWindow::onInvertSelection));
     m_cancelSelectionAction = add_action("cancel-selection", sigc::mem_fun(*this, &AppWindow::onCancelSelection));
     m_shortcutsAction = add_action("shortcuts", sigc::mem_fun(*this, &AppWindow::onShortcutsAction));
     m_aboutAction = add_action("about", sigc::mem_fun(*this, &AppWindow::onAboutAction));
     m_closeWindowAction = add_action("close-window", sigc::mem_fun(*this, &AppWindow::onCloseWindowAction));
+    m_showMetricsAction = add_action_bool("show-metrics", sigc::mem_fun(*this, &AppWindow::onShowMetricsAction), false);
 
     m_headerBar.disableAddDocumentButton();
     m_addDocumentAfterSelectedAction->set_enabled(false);
     m_headerBar.disableZoomSlider();
     m_saveAction->set_enabled(false);
+    m_exportImagesAction->set_enabled(false);
     m_undoAction->set_enabled(false);
     m_redoAction->set_enabled(false);
     m_removeSelectedAction->set_enabled(false);
@@ -178,6 +342,12 @@ void AppWindow::addActions()
     m_moveLeftAction->set_enabled(false);
     m_moveRightAction->set_enabled(false);
     m_selectAllAction->set_enabled(false);
+    m_selectPortraitPagesAction->set_enabled(false);
+    m_selectLandscapePagesAction->set_enabled(false);
+    m_selectPagesAction->set_enabled(false);
+    m_selectTextAction->set_enabled(false);
+    m_selectBlankPagesAction->set_enabled(false);
+    m_selectDuplicatePagesAction->set_enabled(false);
     m_invertSelectionAction->set_enabled(false);
     m_cancelSelectionAction->set_enabled(false);
 }
@@ -187,8 +357,17 @@ void AppWindow::setupWidgets()
     set_titlebar(m_headerBar);
 
     m_scroller.add(m_view);
+    m_view.setScrollAdjustment(m_scroller.get_vadjustment());
+    m_view.setPrefetchMargin(m_settingsManager.loadPrefetchMargin());
+    m_view.setZoomLevels(zoomLevels);
+    m_minimap.setScrollAdjustment(m_scroller.get_vadjustment());
+
+    auto pagesBox = Gtk::manage(new Gtk::Box{Gtk::ORIENTATION_HORIZONTAL}); // NOLINT
+    pagesBox->pack_start(m_scroller);
+    pagesBox->pack_start(m_minimap, Gtk::PACK_SHRINK);
+
     auto editorBox = Gtk::manage(new Gtk::Box{Gtk::ORIENTATION_VERTICAL}); // NOLINT
-    editorBox->pack_start(m_scroller);
+    editorBox->pack_start(*pagesBox);
     editorBox->pack_start(m_actionBar, Gtk::PACK_SHRINK);
 
     m_stack.add(m_welcomeScreen, "welcome");
@@ -197,30 +376,54 @@ void AppWindow::setupWidgets()
     m_overlay.add(m_stack);
     m_overlay.add_overlay(m_savingRevealer);
 
+    m_metricsLabel.set_halign(Gtk::ALIGN_END);
+    m_metricsLabel.set_valign(Gtk::ALIGN_START);
+    m_metricsLabel.set_xalign(0);
+    m_metricsLabel.get_style_context()->add_class("metrics-overlay");
+    m_metricsLabel.set_no_show_all();
+    m_overlay.add_overlay(m_metricsLabel);
+    m_overlay.set_overlay_pass_through(m_metricsLabel);
+
     add(m_overlay); // NOLINT
     show_all_children();
 }
 
 void AppWindow::setupSignalHandlers()
 {
+    // A single user action may notify several times (e.g. while a document
+    // is being opened in batches), so the actions are updated once, when idle
     m_view.selectedPagesChanged.connect([this]() {
-        onSelectedPagesChanged();
+        if (m_selectedPagesChangedConnection.connected())
+            return;
+
+        // Timed from the first notification, which is when the user acted
+        m_selectionChangedTime = Trace::Clock::now();
+        m_selectedPagesChangedConnection = Glib::signal_idle().connect([this]() {
+            {
+                const FrameProfiler::Scope scope{FrameProfiler::Work::Selection};
+                onSelectedPagesChanged();
+            }
+
+            if (m_selectionChangedTime.has_value()) {
+                Metrics::record(Metrics::Latency::SelectionHandled, Trace::Clock::now() - *m_selectionChangedTime);
+                m_selectionChangedTime.reset();
+            }
+
+            return false;
+        });
     });
 
-    m_zoomLevel.zoomLevelIndex().signal_changed().connect([this]() {
+    m_zoomLevel.zoomSize().signal_changed().connect([this]() {
         onZoomLevelChanged();
     });
 
-    m_savedDispatcher.connect([this]() {
-        m_savingRevealer.saved();
-        m_saveAction->set_enabled(true);
-        setModified(false);
+    m_sourceWatcher.fileChanged.connect([this](const Glib::RefPtr<Gio::File>& file) {
+        reloadSourceFile(file);
     });
 
-    m_savingFailedDispatcher.connect([this]() {
-        m_savingRevealer.set_reveal_child(false);
-        m_saveAction->set_enabled(true);
-        showSaveFileFailedErrorDialog();
+    m_savingRevealer.cancelClicked.connect([this]() {
+        m_saveExecutor.cancel();
+        m_exportExecutor.cancel();
     });
 
     m_scroller.get_vadjustment()->signal_value_changed().connect([this]() {
@@ -230,11 +433,29 @@ void AppWindow::setupSignalHandlers()
     signal_configure_event().connect(sigc::mem_fun(*this, &AppWindow::onWindowConfigureEvent),
                                      false); // Run before default handler
     signal_window_state_event().connect(sigc::mem_fun(*this, &AppWindow::onWindowStateEvent));
+
+    // The active window's renders go before those of the others. Alone, it
+    // has nothing to go before, and dialogs take the focus often.
+    property_is_active().signal_changed().connect([this]() {
+        if (m_document != nullptr && get_application() && get_application()->get_windows().size() > 1)
+            m_view.rescheduleRenders();
+    });
     m_commandManager.commandExecuted.connect(sigc::mem_fun(*this, &AppWindow::onCommandExecuted));
+    m_welcomeScreen.openRequested.connect([this](const Glib::RefPtr<Gio::File>& file) {
+        openDocuments({file});
+    });
 }
 
 void AppWindow::loadCustomCSS()
 {
+    // The provider is for the whole screen, so once is enough for every window
+    static bool isLoaded = false;
+
+    if (isLoaded)
+        return;
+
+    isLoaded = true;
+
     auto screen = Gdk::Screen::get_default();
     auto provider = Gtk::CssProvider::create();
     provider->load_from_data(R"(
@@ -247,6 +468,24 @@ void AppWindow::loadCustomCSS()
             padding-left: 4px;
             padding-right: 4px;
         }
+
+        .page-cell:selected {
+            background-color: @theme_selected_bg_color;
+            color: @theme_selected_fg_color;
+        }
+
+        .minimap {
+            background-color: @theme_base_color;
+            border-left: 1px solid @borders;
+        }
+
+        .metrics-overlay {
+            font-family: monospace;
+            padding: 6px;
+            margin: 6px;
+            color: white;
+            background-color: rgba(0, 0, 0, 0.7);
+        }
     )");
     Gtk::StyleContext::add_provider_for_screen(screen,
                                                provider,
@@ -265,8 +504,120 @@ void AppWindow::onCloseWindowAction()
 
 void AppWindow::onShortcutsAction()
 {
-    m_shortcutsWindow->present();
-    m_shortcutsWindow->show_all_children();
+    shortcutsWindow().present();
+    shortcutsWindow().show_all_children();
+}
+
+void AppWindow::onShowMetricsAction()
+{
+    bool isShown = false;
+    m_showMetricsAction->get_state(isShown);
+    isShown = !isShown;
+    m_showMetricsAction->change_state(isShown);
+
+    m_metricsUpdateConnection.disconnect();
+
+    if (!isShown) {
+        m_metricsLabel.hide();
+        updateFrameProfiling();
+        return;
+    }
+
+    FrameProfiler::shared().clear();
+    updateFrameProfiling();
+
+    m_lastMetrics = Metrics::snapshot();
+    m_metricsLabel.set_text(resourceReport());
+    m_metricsLabel.show();
+    m_metricsUpdateConnection = Glib::signal_timeout().connect(sigc::mem_fun(*this, &AppWindow::onMetricsUpdate),
+                                                               metricsUpdateInterval);
+}
+
+bool AppWindow::onMetricsUpdate()
+{
+    // Rates are over the last interval, so that they follow what's happening now
+    const Metrics::Snapshot metrics = Metrics::snapshot();
+    std::string text = resourceReport() + "\n" + Metrics::describe(m_lastMetrics, metrics)
+                       + "\n" + Metrics::describeMemory();
+    if (const std::string latencies = Metrics::describeLatencies(); !latencies.empty())
+        text += "\n" + latencies;
+    text += "\n" + FrameProfiler::shared().describe();
+    if (const std::string slowestPages = Metrics::describeSlowestPages(slowestPagesShown); !slowestPages.empty())
+        text += "\nSlowest pages:\n" + slowestPages;
+    m_metricsLabel.set_text(text);
+    m_lastMetrics = metrics;
+
+    return true;
+}
+
+void AppWindow::updateFrameProfiling()
+{
+    bool isMetricsShown = false;
+    m_showMetricsAction->get_state(isMetricsShown);
+
+    const bool isProfiling = isMetricsShown || Trace::isEnabled();
+    if (isProfiling == m_isProfilingFrames)
+        return;
+
+    m_isProfilingFrames = isProfiling;
+
+    if (isProfiling) {
+        FrameProfiler::shared().acquire();
+        connectFrameClock();
+    }
+    else {
+        disconnectFrameClock();
+        FrameProfiler::shared().release();
+    }
+}
+
+void AppWindow::connectFrameClock()
+{
+    // Not there until the window is realized
+    const Glib::RefPtr<Gdk::FrameClock> frameClock = get_frame_clock();
+    if (!frameClock) {
+        signal_realize().connect_notify([this]() {
+            if (m_isProfilingFrames && m_frameClock == nullptr)
+                connectFrameClock();
+        });
+        return;
+    }
+
+    m_frameClock = GDK_FRAME_CLOCK(g_object_ref(frameClock->gobj()));
+    g_signal_connect(m_frameClock, "before-paint", G_CALLBACK(&AppWindow::onBeforePaint), this);
+    g_signal_connect(m_frameClock, "after-paint", G_CALLBACK(&AppWindow::onAfterPaint), this);
+}
+
+void AppWindow::disconnectFrameClock()
+{
+    if (m_frameClock == nullptr)
+        return;
+
+    g_signal_handlers_disconnect_by_data(m_frameClock, this);
+    g_object_unref(m_frameClock);
+    m_frameClock = nullptr;
+}
+
+void AppWindow::onBeforePaint(GdkFrameClock*, gpointer self)
+{
+    static_cast<AppWindow*>(self)->m_paintStart = Trace::Clock::now();
+}
+
+void AppWindow::onAfterPaint(GdkFrameClock* frameClock, gpointer self)
+{
+    auto window = static_cast<AppWindow*>(self);
+    const Trace::Clock::time_point now = Trace::Clock::now();
+    FrameProfiler& profiler = FrameProfiler::shared();
+
+    // The budget follows the refresh rate of the monitor the window is on
+    gint64 refreshInterval = 0;
+    gdk_frame_clock_get_refresh_info(frameClock, gdk_frame_clock_get_frame_time(frameClock), &refreshInterval, nullptr);
+    if (refreshInterval > 0)
+        profiler.setFrameBudget(std::chrono::microseconds{refreshInterval});
+
+    profiler.addWork(FrameProfiler::Work::Paint, now - window->m_paintStart);
+    Trace::record("Frame work: paint", window->m_paintStart, now);
+    profiler.recordFrame(now);
 }
 
 void AppWindow::onSaveAction()
@@ -277,24 +628,44 @@ void AppWindow::onSaveAction()
 bool AppWindow::showSaveFileDialogAndSave(SaveFileIn howToSave)
 {
     Slicer::SaveFileDialog dialog{*this, m_document->lastAddedFileParentPath()};
+    dialog.setWriteProfile(m_settingsManager.loadWriteProfile());
     const int result = dialog.run();
 
     if (result == GTK_RESPONSE_ACCEPT) {
         const Glib::RefPtr<Gio::File>& file = dialog.get_file();
+        const PdfSaver::WriteProfile profile = dialog.writeProfile();
+        m_settingsManager.saveWriteProfile(profile);
 
         if (howToSave == SaveFileIn::Foreground)
-            return saveFileInForeground(file);
+            return saveFileInForeground(file, profile);
         else //NOLINT
-            saveFileInBackground(file);
+            saveFileInBackground(file, profile);
     }
 
     return false;
 }
 
-bool AppWindow::saveFileInForeground(const Glib::RefPtr<Gio::File>& file)
+void AppWindow::saveDocument(const Glib::RefPtr<Gio::File>& file, PdfSaver::WriteProfile profile)
+{
+    PdfSaver saver{m_document->getSaveData(), m_document->parsedFileCache()};
+    saver.setWriteProfile(profile);
+    saver.setResourceCleanup(m_settingsManager.loadResourceCleanup());
+    saver.setImageDownsampling(m_settingsManager.loadImageDownsampling());
+    saver.save(file);
+
+    Logger::logInfo(fmt::format("Document written with the {} profile in {:.3f} s",
+                                PdfSaver::writeProfileName(profile),
+                                saver.lastWriteDuration().count()));
+}
+
+bool AppWindow::saveFileInForeground(const Glib::RefPtr<Gio::File>& file, PdfSaver::WriteProfile profile)
 {
     try {
-        PdfSaver{m_document->getSaveData()}.save(file);
+        const Trace::Clock::time_point start = Trace::Clock::now();
+        saveDocument(file, profile);
+        Metrics::record(Metrics::Latency::Save, Trace::Clock::now() - start);
+        // The save took the spare shell
+        queueSavePreparation();
 
         return true;
     }
@@ -308,32 +679,164 @@ bool AppWindow::saveFileInForeground(const Glib::RefPtr<Gio::File>& file)
     }
 }
 
-void AppWindow::saveFileInBackground(const Glib::RefPtr<Gio::File>& file)
+void AppWindow::saveFileInBackground(const Glib::RefPtr<Gio::File>& file, PdfSaver::WriteProfile profile)
 {
     m_savingRevealer.saving();
     m_saveAction->set_enabled(false);
-    m_isSavingDocument = true;
+    // Both report on the same notification
+    m_exportImagesAction->set_enabled(false);
+    // Opening another document would take away the files being saved from
+    m_openAction->set_enabled(false);
+
+    // The pages are read here, on the main thread: they may change as soon as this returns
+    SaveExecutor::Job job{m_document->getSaveData(),
+                          m_document->parsedFileCache(),
+                          file,
+                          profile,
+                          m_settingsManager.loadResourceCleanup(),
+                          m_settingsManager.loadImageDownsampling()};
+    const unsigned int modificationCount = m_modificationCount;
+    m_saveStartTime = Trace::Clock::now();
+
+    m_saveExecutor.start(
+        std::move(job),
+        [this](const PdfSaver::Progress& progress) {
+            m_savingRevealer.setProgress(progress.fraction, progress.bytesWritten);
+        },
+        [this, modificationCount](SaveExecutor::Outcome outcome) {
+            onSaveFinished(outcome, modificationCount);
+        });
+}
 
-    std::thread thread{[this, file]() {
-        try {
-            PdfSaver{m_document->getSaveData()}.save(file);
-            m_savedDispatcher.emit();
-        }
-        catch (...) {
-            Logger::logError("Saving the document failed");
-            Logger::logError("The destination file was: " + file->get_path());
-            m_savingFailedDispatcher.emit();
-        }
+void AppWindow::onSaveFinished(SaveExecutor::Outcome outcome, unsigned int savedModificationCount)
+{
+    m_saveAction->set_enabled(true);
+    m_exportImagesAction->set_enabled(true);
+    m_openAction->set_enabled(true);
+    // Whatever the outcome, the save may have taken the spare shell
+    queueSavePreparation();
+
+    switch (outcome) {
+    case SaveExecutor::Outcome::Saved:
+        Metrics::record(Metrics::Latency::Save, Trace::Clock::now() - m_saveStartTime);
+        m_savingRevealer.saved();
 
-        m_isSavingDocument = false;
-    }};
+        // What was edited during the save isn't in the file
+        if (m_modificationCount == savedModificationCount)
+            setModified(false);
+        break;
 
-    thread.detach();
+    case SaveExecutor::Outcome::Canceled:
+        m_savingRevealer.set_reveal_child(false);
+        break;
+
+    case SaveExecutor::Outcome::Failed:
+        m_savingRevealer.set_reveal_child(false);
+        showSaveFileFailedErrorDialog();
+        break;
+    }
+}
+
+void AppWindow::measureLatency(Metrics::Latency latency,
+                               std::chrono::steady_clock::time_point start,
+                               const std::function<bool()>& isDone)
+{
+    if (auto it = m_latencyTicks.find(latency); it != m_latencyTicks.end()) {
+        remove_tick_callback(it->second);
+        m_latencyTicks.erase(it);
+    }
+
+    // Checked once a frame, so the time includes the frame the result is drawn on
+    const guint tick = add_tick_callback([this, latency, start, isDone](const Glib::RefPtr<Gdk::FrameClock>&) {
+        const Trace::Clock::duration elapsed = Trace::Clock::now() - start;
+
+        if (isDone())
+            Metrics::record(latency, elapsed);
+        else if (elapsed < latencyTimeout)
+            return true;
+
+        m_latencyTicks.erase(latency);
+
+        return false;
+    });
+
+    m_latencyTicks[latency] = tick;
+}
+
+void AppWindow::onExportImagesAction()
+{
+    ExportImagesDialog dialog{*this, m_document->lastAddedFileParentPath()};
+    if (dialog.run() != GTK_RESPONSE_ACCEPT)
+        return;
+
+    // The selected pages, or all of them when there's no selection
+    std::vector<unsigned int> indexes = m_view.getSelectedChildrenIndexes();
+    if (indexes.empty()) {
+        indexes.resize(m_document->numberOfPages());
+        std::iota(indexes.begin(), indexes.end(), 0);
+    }
+
+    ExportExecutor::Job job;
+    job.folder = dialog.get_file();
+    job.options.format = dialog.format();
+    job.options.dpi = dialog.dpi();
+    for (unsigned int index : indexes) {
+        job.pages.emplace_back(m_document->getPage(index));
+        job.pageNumbers.push_back(index + 1);
+    }
+
+    m_savingRevealer.exporting();
+    m_exportImagesAction->set_enabled(false);
+    m_saveAction->set_enabled(false);
+    // Opening another document would take away the files being rendered from
+    m_openAction->set_enabled(false);
+
+    m_exportExecutor.start(
+        std::move(job),
+        [this](std::size_t numberOfWrittenPages, std::size_t numberOfPages, double fraction) {
+            m_savingRevealer.setExportProgress(numberOfWrittenPages, numberOfPages, fraction);
+        },
+        [this](ExportExecutor::Outcome outcome) {
+            onExportFinished(outcome);
+        });
+}
+
+void AppWindow::onExportFinished(ExportExecutor::Outcome outcome)
+{
+    m_exportImagesAction->set_enabled(true);
+    m_saveAction->set_enabled(true);
+    m_openAction->set_enabled(true);
+    // Whatever the outcome, the save may have taken the spare shell
+    queueSavePreparation();
+
+    switch (outcome) {
+    case ExportExecutor::Outcome::Exported:
+        m_savingRevealer.exported();
+        break;
+
+    case ExportExecutor::Outcome::Canceled:
+        m_savingRevealer.set_reveal_child(false);
+        break;
+
+    case ExportExecutor::Outcome::Failed: {
+        m_savingRevealer.set_reveal_child(false);
+        Gtk::MessageDialog errorDialog{*this,
+                                       _("The pages could not be exported"),
+                                       false,
+                                       Gtk::MESSAGE_ERROR,
+                                       Gtk::BUTTONS_CLOSE,
+                                       true};
+        errorDialog.run();
+        break;
+    }
+    }
 }
 
 void AppWindow::onOpenAction()
 {
     Slicer::OpenFileDialog dialog{*this,
+                                  m_taskRunner,
+                                  m_thumbnails,
                                   m_document != nullptr
                                       ? m_document->lastAddedFileParentPath()
                                       : std::optional<std::string>{}};
@@ -341,7 +844,7 @@ void AppWindow::onOpenAction()
     const int result = dialog.run();
 
     if (result == GTK_RESPONSE_ACCEPT)
-        tryOpenDocument(dialog.get_file());
+        openDocuments({dialog.get_file()});
 }
 
 void AppWindow::showOpenFileFailedErrorDialog()
@@ -388,7 +891,7 @@ void AppWindow::tryAddDocumentsAt(const std::vector<Glib::RefPtr<Gio::File>>& fi
                                                             position,
                                                             m_headerBar,
                                                             m_view);
-        m_commandManager.execute(command);
+        executeCommand(command);
     }
     catch (...) {
         Logger::logError("The files couldn't be added");
@@ -402,7 +905,7 @@ void AppWindow::tryAddDocumentsAt(const std::vector<Glib::RefPtr<Gio::File>>& fi
 
 void AppWindow::onAddDocumentAtBeginningAction()
 {
-    Slicer::AddFileDialog dialog{*this, m_document->lastAddedFileParentPath()};
+    Slicer::AddFileDialog dialog{*this, m_taskRunner, m_thumbnails, m_document->lastAddedFileParentPath()};
 
     const int result = dialog.run();
 
@@ -412,7 +915,7 @@ void AppWindow::onAddDocumentAtBeginningAction()
 
 void AppWindow::onAddDocumentAtEndAction()
 {
-    Slicer::AddFileDialog dialog{*this, m_document->lastAddedFileParentPath()};
+    Slicer::AddFileDialog dialog{*this, m_taskRunner, m_thumbnails, m_document->lastAddedFileParentPath()};
 
     const int result = dialog.run();
 
@@ -422,7 +925,7 @@ void AppWindow::onAddDocumentAtEndAction()
 
 void AppWindow::onAddDocumentAfterSelectedAction()
 {
-    Slicer::AddFileDialog dialog{*this, m_document->lastAddedFileParentPath()};
+    Slicer::AddFileDialog dialog{*this, m_taskRunner, m_thumbnails, m_document->lastAddedFileParentPath()};
 
     const int result = dialog.run();
 
@@ -430,69 +933,391 @@ void AppWindow::onAddDocumentAfterSelectedAction()
         tryAddDocumentsAt(dialog.get_files(), m_view.getSelectedChildIndex() + 1);
 }
 
-void AppWindow::tryOpenDocument(const Glib::RefPtr<Gio::File>& file)
+void AppWindow::openDocuments(const std::vector<Glib::RefPtr<Gio::File>>& files)
 {
-    try {
-        auto document = std::make_unique<Document>(file);
-        setDocument(std::move(document));
-        m_headerBar.set_title(Glib::filename_display_basename(file->get_path()));
-        m_headerBar.set_subtitle("");
+    cancelOpening();
+
+    if (files.empty())
+        return;
+
+    m_openStartTime = Trace::Clock::now();
+
+    auto canceled = std::make_shared<std::atomic<bool>>(false);
+    m_openingCanceled = canceled;
+
+    // Parsing and creating the pages happen on a worker thread. The document
+    // is shown as soon as the first file parses, and pages are added in batches,
+    // so big files show their first pages right away. Any other files are
+    // parsed a few at a time meanwhile, and added in order.
+    std::thread thread{[this, files, canceled]() {
+        auto document = std::make_shared<Document*>(nullptr);
+        const std::size_t numberOfFiles = files.size();
+        const bool hasSeveralFiles = numberOfFiles > 1;
+
+        // Like Document::addFiles()
+        const std::size_t concurrency = CpuResources::availableCores();
+        std::deque<std::future<std::shared_ptr<Document::FileLoader>>> loads;
+        std::size_t numberOfLoadsStarted = 0;
+        const auto loadAhead = [&files, &loads, &numberOfLoadsStarted](std::size_t count) {
+            while (numberOfLoadsStarted < files.size() && loads.size() < count) {
+                loads.push_back(std::async(std::launch::async, [file = files.at(numberOfLoadsStarted)]() {
+                    return std::make_shared<Document::FileLoader>(file);
+                }));
+                ++numberOfLoadsStarted;
+            }
+        };
+
+        for (std::size_t i = 0; i < files.size() && !*canceled; ++i) {
+            const Glib::RefPtr<Gio::File> file = files.at(i);
+            const bool isFirstFile = i == 0;
+            std::shared_ptr<Document::FileLoader> loader;
+
+            // The first file has the disk to itself
+            loadAhead(isFirstFile ? 1 : concurrency);
+            std::future<std::shared_ptr<Document::FileLoader>> load = std::move(loads.front());
+            loads.pop_front();
+
+            try {
+                loader = load.get();
+            }
+            catch (...) {
+                Glib::signal_idle().connect_once([this, file, canceled]() {
+                    if (*canceled)
+                        return;
+
+                    Logger::logError("The file couldn't be opened");
+                    Logger::logError("Filepath: " + file->get_path());
+
+                    showOpenFileFailedErrorDialog();
+                });
+
+                // The others are added to the first one, which isn't there
+                if (isFirstFile)
+                    return;
+
+                continue;
+            }
+
+            // Files are registered on the main thread, which also gives the
+            // pages their file number. None means the document went away.
+            auto fileNumber = std::make_shared<std::promise<std::optional<unsigned int>>>();
+            std::future<std::optional<unsigned int>> registered = fileNumber->get_future();
+            Glib::signal_idle().connect_once([this, file, canceled, loader, document, fileNumber, isFirstFile, hasSeveralFiles, i, numberOfFiles]() {
+                if (*canceled || (!isFirstFile && *document != m_document.get())) {
+                    fileNumber->set_value(std::nullopt);
+                    return;
+                }
+
+                // For the recent documents of the welcome screen, and of the desktop
+                Gtk::RecentManager::get_default()->add_item(file->get_uri());
+
+                if (hasSeveralFiles)
+                    m_headerBar.set_subtitle(fmt::format(_("Opening file {number} of {total}"),
+                                                         "number"_a = i + 1,           //NOLINT
+                                                         "total"_a = numberOfFiles)); //NOLINT
+
+                if (!isFirstFile) {
+                    fileNumber->set_value((*document)->addLoadedFile(*loader));
+                    return;
+                }
+
+                auto newDocument = std::make_unique<Document>();
+                fileNumber->set_value(newDocument->addLoadedFile(*loader));
+                *document = newDocument.get();
+
+                showDocument(std::move(newDocument));
+                m_headerBar.set_title(Glib::filename_display_name(file->get_basename()));
+                m_view.setShowFileNames(hasSeveralFiles);
+                if (!hasSeveralFiles)
+                    m_headerBar.set_subtitle("");
+
+                // Saving now would leave out the pages that aren't loaded yet
+                m_saveAction->set_enabled(false);
+            });
+
+            const std::optional<unsigned int> number = registered.get();
+            if (!number.has_value())
+                return;
+
+            // The others parse while the pages of this one load
+            loadAhead(concurrency);
+
+            const unsigned int numberOfPages = loader->numberOfPages();
+            const unsigned int firstBatchSize = isFirstFile ? 64 : 512;
+            const unsigned int batchSize = 512;
+
+            for (unsigned int first = 0; first < numberOfPages && !*canceled;) {
+                // A remote file may only have its first page in so far
+                const unsigned int count = first == 0 ? std::min(firstBatchSize, loader->numberOfAvailablePages())
+                                                      : batchSize;
+                bool isLastBatch = first + count >= numberOfPages;
+                // Only what's read from the file; the pages are made as they're shown
+                auto rows = std::make_shared<std::vector<PageListModel::Row>>();
+
+                try {
+                    *rows = loader->loadRows(first, count, *number);
+                }
+                catch (...) {
+                    Logger::logError("Some pages of the file couldn't be loaded");
+                    Logger::logError("Filepath: " + file->get_path());
+
+                    rows->clear();
+                    isLastBatch = true;
+                }
+
+                Glib::signal_idle().connect_once([this, canceled, document, rows]() {
+                    if (*canceled || *document == nullptr || *document != m_document.get())
+                        return;
+
+                    (*document)->appendRows(std::move(*rows));
+                });
+
+                if (isLastBatch)
+                    break;
+
+                first += count;
+            }
+        }
+
+        Glib::signal_idle().connect_once([this, canceled, document, hasSeveralFiles]() {
+            if (*canceled || *document == nullptr || *document != m_document.get())
+                return;
+
+            if (hasSeveralFiles)
+                m_headerBar.set_subtitle(_("Multiple files added"));
+
+            m_saveAction->set_enabled();
+        });
+    }};
+
+    thread.detach();
+}
+
+void AppWindow::cancelOpening()
+{
+    if (m_openingCanceled != nullptr)
+        *m_openingCanceled = true;
+
+    m_openingCanceled.reset();
+    m_openStartTime.reset();
+}
+
+void AppWindow::cancelReloading()
+{
+    *m_reloadingCanceled = true;
+    m_reloadingCanceled = std::make_shared<std::atomic<bool>>(false);
+
+    m_reloadingFiles.clear();
+    m_filesToReloadAgain.clear();
+}
+
+void AppWindow::reloadSourceFile(const Glib::RefPtr<Gio::File>& file)
+{
+    if (m_document == nullptr)
+        return;
+
+    const std::string uri = file->get_uri();
+
+    // The one running compares with the version before this change
+    if (m_reloadingFiles.count(uri) > 0) {
+        m_filesToReloadAgain.insert(uri);
+        return;
     }
-    catch (...) {
-        Logger::logError("The file couldn't be opened");
-        Logger::logError("Filepath: " + file->get_path());
 
-        showOpenFileFailedErrorDialog();
+    std::optional<Document::LiveFile> lastVersion;
+    for (const Document::LiveFile& liveFile : m_document->liveFiles()) {
+        if (liveFile.originalFile->equal(file))
+            lastVersion = liveFile;
     }
+
+    if (!lastVersion.has_value())
+        return;
+
+    m_reloadingFiles.insert(uri);
+
+    // Snapshotting and reading the digests happen on a worker thread, like opening
+    std::thread thread{[this, file, uri, lastVersion = lastVersion.value(), canceled = m_reloadingCanceled, document = m_document.get()]() {
+        std::shared_ptr<Document::FileLoader> loader;
+        PageDigest::Changes changes;
+
+        try {
+            loader = std::make_shared<Document::FileLoader>(file);
+
+            // The content hash only samples the file, which an edit in its
+            // middle leaves as it was, so the pages are always compared
+            if (!*canceled) {
+                const PageIndex::Key lastKey{lastVersion.contentHash,
+                                             lastVersion.origin.size,
+                                             lastVersion.origin.modificationTime};
+                std::optional<std::vector<std::uint64_t>> before = PageIndex::loadDigests(lastKey);
+                if (!before.has_value()) {
+                    before = PageDigest::compute(lastVersion.snapshotPath);
+                    PageIndex::storeDigests(lastKey, before.value());
+                }
+
+                const std::vector<std::uint64_t> after = PageDigest::compute(loader->snapshotPath());
+                const SourceFile::Origin origin = loader->origin();
+                PageIndex::storeDigests({loader->contentHash(), origin.size, origin.modificationTime}, after);
+
+                changes = PageDigest::compare(before.value(), after);
+            }
+        }
+        catch (...) {
+            // Most likely caught halfway through being written, and told again once it's done
+            Logger::logWarning("The changed file couldn't be reloaded");
+            Logger::logWarning("Filepath: " + file->get_path());
+
+            loader.reset();
+        }
+
+        Glib::signal_idle().connect_once([this, file, uri, canceled, document, loader, changes]() {
+            if (*canceled || document != m_document.get())
+                return;
+
+            m_reloadingFiles.erase(uri);
+
+            if (loader != nullptr && !changes.isEmpty())
+                applyReload(*loader, changes);
+
+            if (m_filesToReloadAgain.erase(uri) > 0)
+                reloadSourceFile(file);
+        });
+    }};
+
+    thread.detach();
+}
+
+void AppWindow::applyReload(Document::FileLoader& loader, const PageDigest::Changes& changes)
+{
+    const std::vector<Glib::RefPtr<Page>> replacedPages = m_document->reloadFile(loader, changes);
+
+    // Only what the old versions of the pages had cached goes away
+    std::map<std::string, std::vector<unsigned int>> stalePages;
+    for (const Glib::RefPtr<Page>& page : replacedPages)
+        stalePages[page->fileHash()].push_back(page->indexInFile());
+
+    for (const auto& [fileHash, indexesInFile] : stalePages)
+        m_thumbnails.forgetPages(fileHash, indexesInFile);
+
+    // The history refers to pages by their position, which moved
+    if (changes.numberOfAddedPages() > 0 || changes.numberOfRemovedPages() > 0)
+        m_commandManager.reset();
+}
+
+void AppWindow::executeCommand(const std::shared_ptr<Command>& command)
+{
+    runPrepared(command, [this, command]() {
+        m_commandManager.execute(command);
+    });
+}
+
+void AppWindow::runPrepared(const std::shared_ptr<Command>& command, const std::function<void()>& run)
+{
+    // Made against the document as it was before the one being prepared
+    if (m_isCommandPreparing)
+        return;
+
+    if (command == nullptr || !command->isPreparable() || m_document->numberOfPages() < pagesForPreparedCommands) {
+        run();
+        return;
+    }
+
+    m_isCommandPreparing = true;
+    // The command holds on to this document
+    m_openAction->set_enabled(false);
+
+    auto task = std::make_shared<Task>(
+        [command]() {
+            const Trace::Span span{"AppWindow command preparation"};
+            command->prepare();
+        },
+        [this, run, isAlive = m_isAlive]() {
+            if (!*isAlive)
+                return;
+
+            m_isCommandPreparing = false;
+            if (!m_saveExecutor.isSaving() && !m_exportExecutor.isExporting())
+                m_openAction->set_enabled(true);
+
+            run();
+        });
+
+    m_taskRunner.queue(task, TaskRunner::Priority::Interactive);
+}
+
+std::shared_ptr<Command> AppWindow::createRemovePagesCommand(const std::vector<unsigned int>& indexes)
+{
+    if (m_document->numberOfPages() < pagesForPreparedCommands)
+        return std::make_shared<RemovePagesCommand>(*m_document, indexes);
+
+    // Worked out on a sequence, off the main thread
+    return std::make_shared<EditPagesCommand>(*m_document, [indexes](PageSequence& sequence) {
+        sequence.remove(indexes);
+    });
 }
 
 void AppWindow::onUndoAction()
 {
-    m_commandManager.undo();
+    runPrepared(m_commandManager.commandToUndo(), [this]() {
+        m_commandManager.undo();
+    });
 }
 
 void AppWindow::onRedoAction()
 {
-
-    m_commandManager.redo();
+    runPrepared(m_commandManager.commandToRedo(), [this]() {
+        m_commandManager.redo();
+    });
 }
 
 void AppWindow::onRemoveSelectedPages()
 {
-    auto command = std::make_shared<RemovePagesCommand>(*m_document, m_view.getSelectedChildrenIndexes());
-    m_commandManager.execute(command);
+    executeCommand(createRemovePagesCommand(m_view.getSelectedChildrenIndexes()));
 }
 
 void AppWindow::onRemoveUnselectedPages()
 {
-    auto command = std::make_shared<RemovePagesCommand>(*m_document, m_view.getUnselectedChildrenIndexes());
-    m_commandManager.execute(command);
+    executeCommand(createRemovePagesCommand(m_view.getUnselectedChildrenIndexes()));
 }
 
 void AppWindow::onRemovePreviousPages()
 {
+    if (m_document->numberOfPages() >= pagesForPreparedCommands) {
+        std::vector<unsigned int> indexes(m_view.getSelectedChildIndex());
+        std::iota(indexes.begin(), indexes.end(), 0);
+        executeCommand(createRemovePagesCommand(indexes));
+        return;
+    }
+
     auto command = std::make_shared<RemovePageRangeCommand>(*m_document, 0, m_view.getSelectedChildIndex() - 1);
-    m_commandManager.execute(command);
+    executeCommand(command);
 }
 
 void AppWindow::onRemoveNextPages()
 {
+    if (m_document->numberOfPages() >= pagesForPreparedCommands) {
+        std::vector<unsigned int> indexes(m_document->numberOfPages() - m_view.getSelectedChildIndex() - 1);
+        std::iota(indexes.begin(), indexes.end(), m_view.getSelectedChildIndex() + 1);
+        executeCommand(createRemovePagesCommand(indexes));
+        return;
+    }
+
     auto command = std::make_shared<RemovePageRangeCommand>(*m_document,
                                                             m_view.getSelectedChildIndex() + 1,
                                                             m_document->numberOfPages() - 1);
-    m_commandManager.execute(command);
+    executeCommand(command);
 }
 
 void AppWindow::onRotatePagesRight()
 {
     auto command = std::make_shared<RotatePagesRightCommand>(*m_document, m_view.getSelectedChildrenIndexes());
-    m_commandManager.execute(command);
+    executeCommand(command);
 }
 
 void AppWindow::onRotatePagesLeft()
 {
     auto command = std::make_shared<RotatePagesLeftCommand>(*m_document, m_view.getSelectedChildrenIndexes());
-    m_commandManager.execute(command);
+    executeCommand(command);
 }
 
 void AppWindow::onMovePagesLeft()
@@ -505,13 +1330,18 @@ void AppWindow::onMovePagesLeft()
         command = std::make_shared<MovePageCommand>(*m_document,
                                                     indexToMove.front(),
                                                     indexToMove.front() - 1);
-    else
+    else if (m_view.selection().isContiguous())
         command = std::make_shared<MovePageRangeCommand>(*m_document,
                                                          indexToMove.front(),
                                                          indexToMove.back(),
                                                          indexToMove.front() - 1);
+    else
+        // Gathered right before the first one
+        command = std::make_shared<MovePagesCommand>(*m_document,
+                                                     indexToMove,
+                                                     indexToMove.front() - 1);
 
-    m_commandManager.execute(command);
+    executeCommand(command);
 }
 
 void AppWindow::onMovePagesRight()
@@ -524,13 +1354,19 @@ void AppWindow::onMovePagesRight()
         command = std::make_shared<MovePageCommand>(*m_document,
                                                     indexToMove.front(),
                                                     indexToMove.front() + 1);
-    else
+    else if (m_view.selection().isContiguous())
         command = std::make_shared<MovePageRangeCommand>(*m_document,
                                                          indexToMove.front(),
                                                          indexToMove.back(),
                                                          indexToMove.front() + 1);
+    else
+        // Gathered so that the last one ends up right after where it was
+        command = std::make_shared<MovePagesCommand>(*m_document,
+                                                     indexToMove,
+                                                     indexToMove.back() + 2
+                                                         - static_cast<unsigned int>(indexToMove.size()));
 
-    m_commandManager.execute(command);
+    executeCommand(command);
 }
 
 void AppWindow::onSelectAll()
@@ -548,35 +1384,111 @@ void AppWindow::onSelectEvenPages()
     m_view.selectEvenPages();
 }
 
-void AppWindow::onInvertSelection()
+void AppWindow::onSelectPortraitPages()
 {
-    m_view.invertSelection();
+    m_view.selectPagesWithOrientation(PageTable::Orientation::Portrait);
 }
 
-void AppWindow::onCancelSelection()
+void AppWindow::onSelectLandscapePages()
 {
-    m_view.clearSelection();
+    m_view.selectPagesWithOrientation(PageTable::Orientation::Landscape);
 }
 
-bool isVectorContigous(const std::vector<unsigned int>& vector)
+void AppWindow::onSelectPages()
 {
-    for (unsigned int i = 0; i < vector.size(); ++i)
-        if (vector.front() + i != vector.at(i))
-            return false;
+    SelectPagesDialog dialog{*this};
 
-    return true;
+    while (dialog.run() == Gtk::RESPONSE_OK) {
+        try {
+            m_view.selectPages(parsePageSelection(dialog.expression(), m_document->numberOfPages()));
+            break;
+        }
+        catch (const std::runtime_error& e) {
+            dialog.showError(e.what());
+        }
+    }
+
+    dialog.hide();
+}
+
+void AppWindow::onSelectText()
+{
+    SelectTextDialog dialog{*this};
+
+    while (dialog.run() == Gtk::RESPONSE_OK) {
+        if (TextIndex::wordsOf(dialog.text()).empty()) {
+            dialog.showError(_("Type the words the pages should have"));
+            continue;
+        }
+
+        const unsigned int numberOfIndexedPages = m_textIndexer.numberOfIndexedPages(*m_document);
+
+        // Pages that can't be read at all don't keep it from answering
+        if (numberOfIndexedPages < m_document->numberOfPages() && m_textIndexer.isReading()) {
+            dialog.showError(fmt::format(_("Still reading the text of the pages: {indexed} of {total} so far. Try again in a moment."),
+                                         "indexed"_a = numberOfIndexedPages,
+                                         "total"_a = m_document->numberOfPages()));
+            continue;
+        }
+
+        m_view.selectPages(m_textIndexer.find(*m_document, dialog.text()));
+        break;
+    }
+
+    dialog.hide();
+}
+
+void AppWindow::inspectPagesAndSelect(const std::function<SelectionModel()>& select)
+{
+    m_selectBlankPagesAction->set_enabled(false);
+    m_selectDuplicatePagesAction->set_enabled(false);
+
+    m_pageInspector.inspect(*m_document, m_zoomLevel.currentLevel(), [this, select]() {
+        m_selectBlankPagesAction->set_enabled();
+        m_selectDuplicatePagesAction->set_enabled(m_document->numberOfPages() > 1);
+        // Selected, to be looked over and removed in one go
+        m_view.selectPages(select());
+    });
+}
+
+void AppWindow::onSelectBlankPages()
+{
+    inspectPagesAndSelect([this]() { return m_pageInspector.blankPages(*m_document); });
+}
+
+void AppWindow::onSelectDuplicatePages()
+{
+    inspectPagesAndSelect([this]() { return m_pageInspector.duplicatePages(*m_document); });
+}
+
+void AppWindow::onInvertSelection()
+{
+    m_view.invertSelection();
+}
+
+void AppWindow::onCancelSelection()
+{
+    m_view.clearSelection();
 }
 
 void AppWindow::onSelectedPagesChanged()
 {
-    const std::vector<unsigned int> indexSelected = m_view.getSelectedChildrenIndexes();
-    const unsigned long numSelected = indexSelected.size();
+    // Everything asked here is kept up to date by the selection model,
+    // so this doesn't depend on the size of the document
+    const SelectionModel& selection = m_view.selection();
+    const unsigned long numSelected = selection.count();
     const unsigned long numPages = m_document->numberOfPages();
 
     const bool isOddPagesActionEnabled = numPages > 0;
     const bool isEvenPagesActionEnabled = numPages > 1;
     m_selectOddPagesAction->set_enabled(isOddPagesActionEnabled);
     m_selectEvenPagesAction->set_enabled(isEvenPagesActionEnabled);
+    m_selectPortraitPagesAction->set_enabled(isOddPagesActionEnabled);
+    m_selectLandscapePagesAction->set_enabled(isOddPagesActionEnabled);
+    m_selectPagesAction->set_enabled(isOddPagesActionEnabled);
+    m_selectTextAction->set_enabled(isOddPagesActionEnabled);
+    m_selectBlankPagesAction->set_enabled(isOddPagesActionEnabled && !m_pageInspector.isInspecting());
+    m_selectDuplicatePagesAction->set_enabled(isEvenPagesActionEnabled && !m_pageInspector.isInspecting());
 
     if (numSelected == 0) {
         m_removeSelectedAction->set_enabled(false);
@@ -602,24 +1514,24 @@ void AppWindow::onSelectedPagesChanged()
         else
             m_removeUnselectedAction->set_enabled();
 
-        if (indexSelected.front() == 0)
+        if (selection.first() == 0)
             m_moveLeftAction->set_enabled(false);
         else
             m_moveLeftAction->set_enabled();
 
-        if (indexSelected.back() == numPages - 1)
+        if (selection.last() == numPages - 1)
             m_moveRightAction->set_enabled(false);
         else
             m_moveRightAction->set_enabled();
     }
 
     if (numSelected == 1) {
-        if (indexSelected.front() == 0)
+        if (selection.first() == 0)
             m_removePreviousAction->set_enabled(false);
         else
             m_removePreviousAction->set_enabled();
 
-        if (indexSelected.front() == numPages - 1)
+        if (selection.first() == numPages - 1)
             m_removeNextAction->set_enabled(false);
         else
             m_removeNextAction->set_enabled();
@@ -633,11 +1545,6 @@ void AppWindow::onSelectedPagesChanged()
     if (numSelected > 1) {
         m_removePreviousAction->set_enabled(false);
         m_removeNextAction->set_enabled(false);
-
-        if (!isVectorContigous(indexSelected)) {
-            m_moveLeftAction->set_enabled(false);
-            m_moveRightAction->set_enabled(false);
-        }
     }
 
     if (numPages == 0 || numPages == numSelected)
@@ -653,6 +1560,9 @@ void AppWindow::onSelectedPagesChanged()
 
 void AppWindow::onCommandExecuted()
 {
+    ++m_modificationCount;
+    sessionChanged.emit();
+
     if (m_commandManager.canUndo()) {
         m_undoAction->set_enabled();
         setModified(true);
@@ -670,7 +1580,11 @@ void AppWindow::onCommandExecuted()
 
 void AppWindow::onZoomLevelChanged()
 {
+    const Trace::Clock::time_point start = Trace::Clock::now();
     m_view.changePageSize(m_zoomLevel.currentLevel());
+    measureLatency(Metrics::Latency::ZoomToSharpThumbnails, start, [this]() {
+        return m_view.areVisibleThumbnailsSharp();
+    });
 
     queueRestoreScrollPosition();
 }
@@ -706,14 +1620,11 @@ void AppWindow::onScrollLimitChanged()
     m_onScrollLimitChangedConnection.disconnect();
 }
 
-void AppWindow::onViewMouseWheelUp()
-{
-    activate_action("zoom-in");
-}
-
-void AppWindow::onViewMouseWheelDown()
+void AppWindow::onViewZoom(double factor)
 {
-    activate_action("zoom-out");
+    // Like the zoom actions, only with a document open
+    if (m_zoomLevel.isEnabled())
+        m_zoomLevel.zoomBy(factor);
 }
 
 bool AppWindow::onWindowConfigureEvent(GdkEventConfigure*)
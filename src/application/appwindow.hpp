@@ -18,14 +18,23 @@
 #define SLICERWINDOW_HPP
 
 #include "actionbar.hpp"
+#include "exportexecutor.hpp"
+#include "frameprofiler.hpp"
 #include "headerbar.hpp"
+#include "minimap.hpp"
+#include "pageinspector.hpp"
+#include "saveexecutor.hpp"
 #include "savingrevealer.hpp"
 #include "settingsmanager.hpp"
+#include "sharedthumbnails.hpp"
+#include "sourcewatcher.hpp"
 #include "taskrunner.hpp"
+#include "textindexer.hpp"
 #include "view.hpp"
 #include "welcomescreen.hpp"
 #include "zoomlevelwithactions.hpp"
 #include <commandmanager.hpp>
+#include <metrics.hpp>
 #include <gtkmm/applicationwindow.h>
 #include <gtkmm/box.h>
 #include <gtkmm/button.h>
@@ -35,12 +44,16 @@
 #include <gtkmm/scrolledwindow.h>
 #include <gtkmm/stack.h>
 #include <giomm/settings.h>
+#include <map>
+#include <set>
 
 namespace Slicer {
 
 class AppWindow : public Gtk::ApplicationWindow {
 public:
     AppWindow(TaskRunner& taskRunner,
+              SharedThumbnails& thumbnails,
+              TextIndexer& textIndexer,
               SettingsManager& settingsManager);
 
     AppWindow(const AppWindow&) = delete;
@@ -50,7 +63,18 @@ public:
 
     ~AppWindow() override;
 
-    void setDocument(std::unique_ptr<Document> document);
+    // Shows the first file as soon as it parses, while the pages of every file load in the background
+    void openDocuments(const std::vector<Glib::RefPtr<Gio::File>>& files);
+    // Gives back what can be rebuilt later, when the system runs low on memory
+    void releaseMemory();
+    // Queue depth and memory held by this window, for the metrics
+    std::string resourceReport() const;
+    // The document, as Application stores it for the next time, if there's one
+    std::optional<Session::DocumentState> sessionState() const;
+    void restoreSession(const Session::DocumentState& state);
+
+    // Whenever sessionState() may give something else
+    sigc::signal<void> sessionChanged;
 
 protected:
     bool on_delete_event(GdkEventAny*) override;
@@ -65,8 +89,27 @@ private:
 
     std::unique_ptr<Document> m_document;
     bool m_isDocumentModified = false;
-    std::atomic<bool> m_isSavingDocument{false};
+    // Goes up with every command, so that a save can tell the document changed while it ran
+    unsigned int m_modificationCount = 0;
+    // While a command is prepared on a worker, no other edit is taken
+    bool m_isCommandPreparing = false;
+    // Lowered on destruction, so that a command prepared late isn't applied
+    std::shared_ptr<bool> m_isAlive = std::make_shared<bool>(true);
+    // Set to true to abandon the file being opened in the background
+    std::shared_ptr<std::atomic<bool>> m_openingCanceled;
     TaskRunner& m_taskRunner;
+    SharedThumbnails& m_thumbnails;
+    TextIndexer& m_textIndexer;
+    // The pages added in a burst are queued for indexing together, once it's over
+    sigc::connection m_textIndexUpdate;
+    // Likewise for parsing the files ahead of the next save
+    sigc::connection m_savePreparation;
+    PageInspector m_pageInspector;
+    // Files that change on disk are reloaded, one reload per file at a time
+    SourceWatcher m_sourceWatcher;
+    std::shared_ptr<std::atomic<bool>> m_reloadingCanceled = std::make_shared<std::atomic<bool>>(false);
+    std::set<std::string> m_reloadingFiles;
+    std::set<std::string> m_filesToReloadAgain;
 
     SettingsManager& m_settingsManager;
     WindowState m_windowState;
@@ -82,11 +125,31 @@ private:
     Gtk::ScrolledWindow m_scroller;
     double m_scrollPosition = 0;
     View m_view;
+    Minimap m_minimap;
     ActionBar m_actionBar;
 
     SavingRevealer m_savingRevealer;
-    Glib::Dispatcher m_savedDispatcher;
-    Glib::Dispatcher m_savingFailedDispatcher;
+    SaveExecutor m_saveExecutor;
+    ExportExecutor m_exportExecutor;
+
+    // Live counters over the pages, shown on demand to tell where a slow session goes
+    Gtk::Label m_metricsLabel;
+    Metrics::Snapshot m_lastMetrics;
+    sigc::connection m_metricsUpdateConnection;
+    static constexpr unsigned int metricsUpdateInterval = 1000;
+    static constexpr std::size_t slowestPagesShown = 5;
+    // Frames are timed while the metrics are shown, or while tracing, see FrameProfiler
+    bool m_isProfilingFrames = false;
+    GdkFrameClock* m_frameClock = nullptr;
+    Trace::Clock::time_point m_paintStart;
+
+    // How long the user waits on an action, measured until the frame where its result is shown.
+    // One measurement per kind at a time: starting another drops the one before.
+    std::map<Metrics::Latency, guint> m_latencyTicks;
+    std::optional<std::chrono::steady_clock::time_point> m_openStartTime;
+    std::optional<std::chrono::steady_clock::time_point> m_selectionChangedTime;
+    std::chrono::steady_clock::time_point m_saveStartTime;
+    static constexpr std::chrono::seconds latencyTimeout{60};
 
     std::unique_ptr<Gtk::ShortcutsWindow> m_shortcutsWindow;
 
@@ -96,6 +159,7 @@ private:
     Glib::RefPtr<Gio::SimpleAction> m_addDocumentAtEndAction;
     Glib::RefPtr<Gio::SimpleAction> m_addDocumentAfterSelectedAction;
     Glib::RefPtr<Gio::SimpleAction> m_saveAction;
+    Glib::RefPtr<Gio::SimpleAction> m_exportImagesAction;
     Glib::RefPtr<Gio::SimpleAction> m_undoAction;
     Glib::RefPtr<Gio::SimpleAction> m_redoAction;
     Glib::RefPtr<Gio::SimpleAction> m_removeSelectedAction;
@@ -109,23 +173,42 @@ private:
     Glib::RefPtr<Gio::SimpleAction> m_selectAllAction;
     Glib::RefPtr<Gio::SimpleAction> m_selectOddPagesAction;
     Glib::RefPtr<Gio::SimpleAction> m_selectEvenPagesAction;
+    Glib::RefPtr<Gio::SimpleAction> m_selectPortraitPagesAction;
+    Glib::RefPtr<Gio::SimpleAction> m_selectLandscapePagesAction;
+    Glib::RefPtr<Gio::SimpleAction> m_selectPagesAction;
+    Glib::RefPtr<Gio::SimpleAction> m_selectTextAction;
+    Glib::RefPtr<Gio::SimpleAction> m_selectBlankPagesAction;
+    Glib::RefPtr<Gio::SimpleAction> m_selectDuplicatePagesAction;
     Glib::RefPtr<Gio::SimpleAction> m_invertSelectionAction;
     Glib::RefPtr<Gio::SimpleAction> m_cancelSelectionAction;
     Glib::RefPtr<Gio::SimpleAction> m_shortcutsAction;
     Glib::RefPtr<Gio::SimpleAction> m_aboutAction;
     Glib::RefPtr<Gio::SimpleAction> m_closeWindowAction;
+    Glib::RefPtr<Gio::SimpleAction> m_showMetricsAction;
 
     // Functions
     void loadPreviousSessionState();
     void saveCurrentSessionState();
-    void loadWidgets();
+    // Built the first time it's shown, since most sessions never show it
+    Gtk::ShortcutsWindow& shortcutsWindow();
     void addActions();
     void setupWidgets();
     void setupSignalHandlers();
     bool showSaveFileDialogAndSave(SaveFileIn howToSave);
-    bool saveFileInForeground(const Glib::RefPtr<Gio::File>& file);
-    void saveFileInBackground(const Glib::RefPtr<Gio::File>& file);
-    void tryOpenDocument(const Glib::RefPtr<Gio::File>& file);
+    void saveDocument(const Glib::RefPtr<Gio::File>& file, PdfSaver::WriteProfile profile);
+    bool saveFileInForeground(const Glib::RefPtr<Gio::File>& file, PdfSaver::WriteProfile profile);
+    void saveFileInBackground(const Glib::RefPtr<Gio::File>& file, PdfSaver::WriteProfile profile);
+    void onSaveFinished(SaveExecutor::Outcome outcome, unsigned int savedModificationCount);
+    void measureLatency(Metrics::Latency latency,
+                        std::chrono::steady_clock::time_point start,
+                        const std::function<bool()>& isDone);
+    void onExportFinished(ExportExecutor::Outcome outcome);
+    void showDocument(std::unique_ptr<Document> document);
+    void cancelOpening();
+    void cancelReloading();
+    // Brings in the pages that changed since the last version of file
+    void reloadSourceFile(const Glib::RefPtr<Gio::File>& file);
+    void applyReload(Document::FileLoader& loader, const PageDigest::Changes& changes);
     void tryAddDocumentsAt(const std::vector<Glib::RefPtr<Gio::File>>& files,
                            unsigned int position);
     void showOpenFileFailedErrorDialog();
@@ -134,6 +217,10 @@ private:
     void saveScrollPosition();
     void restoreScrollPosition();
     void queueRestoreScrollPosition();
+    void queueTextIndexUpdate();
+    void queueSavePreparation();
+    // Selects what select() gives, once the pages are inspected
+    void inspectPagesAndSelect(const std::function<SelectionModel()>& select);
 
     // Callbacks
     void onOpenAction();
@@ -141,6 +228,12 @@ private:
     void onAddDocumentAtEndAction();
     void onAddDocumentAfterSelectedAction();
     void onSaveAction();
+    void onExportImagesAction();
+    // Commands that can be prepared apart are, on a worker, when the document is this large
+    static constexpr unsigned int pagesForPreparedCommands = 5000;
+    void executeCommand(const std::shared_ptr<Command>& command);
+    void runPrepared(const std::shared_ptr<Command>& command, const std::function<void()>& run);
+    std::shared_ptr<Command> createRemovePagesCommand(const std::vector<unsigned int>& indexes);
     void onUndoAction();
     void onRedoAction();
     void onRemoveSelectedPages();
@@ -154,18 +247,31 @@ private:
     void onSelectAll();
     void onSelectOddPages();
     void onSelectEvenPages();
+    void onSelectPortraitPages();
+    void onSelectLandscapePages();
+    void onSelectPages();
+    void onSelectText();
+    void onSelectBlankPages();
+    void onSelectDuplicatePages();
     void onInvertSelection();
     void onCancelSelection();
     void onAboutAction();
     void onCloseWindowAction();
     void onShortcutsAction();
+    void onShowMetricsAction();
+    bool onMetricsUpdate();
+    void updateFrameProfiling();
+    void connectFrameClock();
+    void disconnectFrameClock();
+    static void onBeforePaint(GdkFrameClock* frameClock, gpointer self);
+    static void onAfterPaint(GdkFrameClock* frameClock, gpointer self);
     void onSelectedPagesChanged();
+    sigc::connection m_selectedPagesChangedConnection;
     void onCommandExecuted();
     void onZoomLevelChanged();
     void onScrollPositionChanged();
     void onScrollLimitChanged();
-    void onViewMouseWheelUp();
-    void onViewMouseWheelDown();
+    void onViewZoom(double factor);
     sigc::connection m_onScrollLimitChangedConnection;
     bool onWindowConfigureEvent(GdkEventConfigure*);
     bool onWindowStateEvent(GdkEventWindowState* state);
@@ -0,0 +1,106 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "completionqueue.hpp"
+#include "frameprofiler.hpp"
+#include <glibmm/main.h>
+#include <algorithm>
+
+namespace Slicer {
+
+std::shared_ptr<CompletionQueue> CompletionQueue::create()
+{
+    return std::shared_ptr<CompletionQueue>{new CompletionQueue}; //NOLINT
+}
+
+CompletionQueue::~CompletionQueue()
+{
+    Node* node = m_head.exchange(nullptr);
+
+    while (node != nullptr) {
+        std::unique_ptr<Node> current{node};
+        node = node->next;
+    }
+}
+
+void CompletionQueue::push(const std::shared_ptr<Task>& task)
+{
+    auto node = new Node{task, m_head.load()}; //NOLINT
+
+    while (!m_head.compare_exchange_weak(node->next, node)) {
+    }
+
+    if (!m_isDeliveryScheduled.exchange(true))
+        scheduleDelivery();
+}
+
+void CompletionQueue::scheduleDelivery()
+{
+    // The callback holds the queue, so pending results never outlive it
+    Glib::signal_idle().connect([self = shared_from_this()]() {
+        return self->deliver();
+    });
+}
+
+bool CompletionQueue::deliver()
+{
+    const FrameProfiler::Scope scope{FrameProfiler::Work::TaskCompletions};
+    takePushed();
+
+    const auto deadline = std::chrono::steady_clock::now() + deliveryBudget;
+
+    while (!m_pending.empty() && std::chrono::steady_clock::now() < deadline) {
+        std::shared_ptr<Task> task = m_pending.front();
+        m_pending.pop_front();
+
+        if (!task->isCanceled())
+            task->postExecute();
+    }
+
+    if (!m_pending.empty())
+        return true;
+
+    m_isDeliveryScheduled = false;
+
+    // Something may have been pushed after the list was taken, but before
+    // the flag was cleared, without scheduling anything
+    if (m_head.load() != nullptr && !m_isDeliveryScheduled.exchange(true))
+        return true;
+
+    return false;
+}
+
+void CompletionQueue::takePushed()
+{
+    Node* node = m_head.exchange(nullptr);
+
+    if (node == nullptr)
+        return;
+
+    const auto firstNew = static_cast<std::ptrdiff_t>(m_pending.size());
+
+    while (node != nullptr) {
+        std::unique_ptr<Node> current{node};
+        m_pending.push_back(std::move(current->task));
+        node = current->next;
+    }
+
+    // The list was newest first
+    std::reverse(m_pending.begin() + firstNew, m_pending.end());
+}
+
+} // namespace Slicer
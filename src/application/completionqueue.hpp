@@ -0,0 +1,68 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef SLICER_COMPLETIONQUEUE_HPP
+#define SLICER_COMPLETIONQUEUE_HPP
+
+#include "task.hpp"
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+
+namespace Slicer {
+
+// Finished tasks are pushed here from any thread without taking a lock.
+// A single idle callback on the main thread runs their postExecute() in
+// batches, giving the frame back after deliveryBudget.
+class CompletionQueue : public std::enable_shared_from_this<CompletionQueue> {
+public:
+    static std::shared_ptr<CompletionQueue> create();
+
+    CompletionQueue(const CompletionQueue&) = delete;
+    CompletionQueue& operator=(const CompletionQueue&) = delete;
+    CompletionQueue(CompletionQueue&&) = delete;
+    CompletionQueue& operator=(CompletionQueue&& src) = delete;
+
+    ~CompletionQueue();
+
+    void push(const std::shared_ptr<Task>& task);
+
+    static constexpr std::chrono::milliseconds deliveryBudget{8};
+
+private:
+    CompletionQueue() = default;
+
+    struct Node {
+        std::shared_ptr<Task> task;
+        Node* next;
+    };
+
+    // Newest first; the main thread takes the whole list at once
+    std::atomic<Node*> m_head = nullptr;
+    std::atomic_bool m_isDeliveryScheduled = false;
+    // Only touched on the main thread, in the order the tasks finished
+    std::deque<std::shared_ptr<Task>> m_pending;
+
+    void scheduleDelivery();
+    bool deliver();
+    void takePushed();
+};
+
+} // namespace Slicer
+
+#endif // SLICER_COMPLETIONQUEUE_HPP
@@ -0,0 +1,129 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "exportexecutor.hpp"
+#include <glibmm/main.h>
+#include <logger.hpp>
+#include <rendercost.hpp>
+#include <fmt/format.h>
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <stdexcept>
+
+namespace Slicer {
+
+ExportExecutor::~ExportExecutor()
+{
+    *m_isAlive = false;
+    cancel();
+
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+std::string ExportExecutor::fileName(unsigned int pageNumber,
+                                     unsigned int largestPageNumber,
+                                     ImageExport::Format format)
+{
+    const auto numberOfDigits = std::to_string(largestPageNumber).size();
+
+    return fmt::format("page-{:0{}}.{}", pageNumber, numberOfDigits, ImageExport::formatName(format));
+}
+
+void ExportExecutor::start(Job job,
+                           const std::function<void(std::size_t, std::size_t)>& onProgress,
+                           const std::function<void(Outcome)>& onFinished)
+{
+    if (m_isExporting)
+        throw std::logic_error("An export is already running");
+
+    // The previous export is done by now; this only cleans up its thread
+    if (m_thread.joinable())
+        m_thread.join();
+
+    m_isExporting = true;
+    m_canceled = std::make_shared<std::atomic<bool>>(false);
+
+    m_thread = std::thread{[this, job = std::move(job), onProgress, onFinished, canceled = m_canceled, isAlive = m_isAlive]() {
+        const auto finish = [this, onFinished, isAlive](Outcome outcome) {
+            Glib::signal_idle().connect_once([this, onFinished, isAlive, outcome]() {
+                if (!*isAlive)
+                    return;
+
+                m_isExporting = false;
+                onFinished(outcome);
+            });
+        };
+
+        const std::size_t numberOfPages = job.pages.size();
+        const unsigned int largestPageNumber = job.pageNumbers.empty()
+                                                   ? 0
+                                                   : *std::max_element(job.pageNumbers.begin(), job.pageNumbers.end());
+        std::vector<std::uint64_t> costs;
+        for (const Glib::RefPtr<const Page>& page : job.pages)
+            costs.push_back(std::uint64_t{page->renderCost()} + RenderCost::perPage);
+        const std::uint64_t totalCost = std::accumulate(costs.begin(), costs.end(), std::uint64_t{0});
+        // Only touched by the thread that wrote an image, one at a time
+        std::size_t numberOfWrittenPages = 0;
+        std::uint64_t writtenCost = 0;
+
+        const auto destinationOfPage = [&job, largestPageNumber](std::size_t index) {
+            return job.folder->get_child(fileName(job.pageNumbers.at(index), largestPageNumber, job.options.format));
+        };
+
+        const auto onPageWritten = [onProgress, isAlive, numberOfPages, &costs, totalCost, &numberOfWrittenPages, &writtenCost](std::size_t index, const Glib::RefPtr<Gio::File>&) {
+            const std::size_t written = ++numberOfWrittenPages;
+            writtenCost += costs.at(index);
+            const double fraction = static_cast<double>(writtenCost) / static_cast<double>(totalCost);
+            Glib::signal_idle().connect_once([onProgress, isAlive, written, numberOfPages, fraction]() {
+                if (*isAlive)
+                    onProgress(written, numberOfPages, fraction);
+            });
+        };
+
+        try {
+            const auto start = std::chrono::steady_clock::now();
+            ImageExport::exportPages(job.pages, destinationOfPage, job.options, onPageWritten, canceled);
+            const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+
+            if (*canceled) {
+                Logger::logInfo("Exporting the pages was canceled");
+                finish(Outcome::Canceled);
+                return;
+            }
+
+            Logger::logInfo(fmt::format("{} pages written as {} images in {:.3f} s",
+                                        numberOfPages,
+                                        ImageExport::formatName(job.options.format),
+                                        duration.count()));
+            finish(Outcome::Exported);
+        }
+        catch (...) {
+            Logger::logError("Exporting the pages failed");
+            Logger::logError("The destination folder was: " + job.folder->get_path());
+            finish(Outcome::Failed);
+        }
+    }};
+}
+
+void ExportExecutor::cancel()
+{
+    if (m_canceled != nullptr)
+        *m_canceled = true;
+}
+
+} // namespace Slicer
@@ -0,0 +1,85 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef EXPORTEXECUTOR_HPP
+#define EXPORTEXECUTOR_HPP
+
+#include <imageexport.hpp>
+#include <giomm/file.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace Slicer {
+
+// Writes pages of a window out as images on a thread of its own, which
+// spreads the rendering and encoding over every core. The pages are kept
+// alive until the export is done, but are rendered as they are when their
+// turn comes. Progress and the outcome come back on the main loop.
+// Destroying the executor cancels the export that's running and waits for
+// it to stop; a canceled export keeps the images written so far.
+class ExportExecutor {
+public:
+    struct Job {
+        std::vector<Glib::RefPtr<const Page>> pages;
+        // The 1-based positions of the pages in the document, which name the files
+        std::vector<unsigned int> pageNumbers;
+        Glib::RefPtr<Gio::File> folder;
+        ImageExport::Options options;
+    };
+
+    enum class Outcome {
+        Exported,
+        Failed,
+        Canceled
+    };
+
+    ExportExecutor() = default;
+
+    ExportExecutor(const ExportExecutor&) = delete;
+    ExportExecutor& operator=(const ExportExecutor&) = delete;
+    ExportExecutor(ExportExecutor&&) = delete;
+    ExportExecutor& operator=(ExportExecutor&& src) = delete;
+
+    ~ExportExecutor();
+
+    // Only one export at a time: check isExporting() first. The fraction done
+    // is weighed by the render cost of the pages written, not by their number.
+    using ProgressFunction = std::function<void(std::size_t numberOfWrittenPages, std::size_t numberOfPages, double fraction)>;
+    void start(Job job,
+               const ProgressFunction& onProgress,
+               const std::function<void(Outcome)>& onFinished);
+    void cancel();
+    bool isExporting() const { return m_isExporting; }
+
+    // "page-007.png" for page 7 of up to 999
+    static std::string fileName(unsigned int pageNumber,
+                                unsigned int largestPageNumber,
+                                ImageExport::Format format);
+
+private:
+    std::thread m_thread;
+    bool m_isExporting = false;
+    std::shared_ptr<std::atomic<bool>> m_canceled;
+    // Lowered on destruction, so that what the thread left for the main loop is dropped
+    std::shared_ptr<bool> m_isAlive = std::make_shared<bool>(true);
+};
+
+} // namespace Slicer
+
+#endif // EXPORTEXECUTOR_HPP
@@ -0,0 +1,71 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "exportimagesdialog.hpp"
+#include <glibmm/i18n.h>
+
+namespace Slicer {
+
+static const Glib::ustring formatChoice = "format";
+static const Glib::ustring dpiChoice = "dpi";
+static const ImageExport::Options defaultOptions;
+
+ExportImagesDialog::ExportImagesDialog(Gtk::Window& parent,
+                                       std::optional<std::string> folderPath)
+    : Gtk::FileChooserNative{_("Export pages to folder"),
+                             parent,
+                             Gtk::FILE_CHOOSER_ACTION_SELECT_FOLDER,
+                             _("Export"),
+                             _("Cancel")}
+{
+    if (folderPath.has_value())
+        set_current_folder(folderPath.value());
+
+    std::vector<Glib::ustring> formats = {ImageExport::formatName(ImageExport::Format::Png),
+                                          ImageExport::formatName(ImageExport::Format::Jpeg)};
+    std::vector<Glib::ustring> formatLabels = {_("PNG"), _("JPEG")};
+    if (ImageExport::canWrite(ImageExport::Format::WebP)) {
+        formats.emplace_back(ImageExport::formatName(ImageExport::Format::WebP));
+        formatLabels.emplace_back(_("WebP"));
+    }
+
+    add_choice(formatChoice, _("Format"), formats, formatLabels);
+    set_choice(formatChoice, ImageExport::formatName(defaultOptions.format));
+
+    add_choice(dpiChoice,
+               _("Resolution"),
+               {"72", "150", "300", "600"},
+               {_("72 dpi"), _("150 dpi"), _("300 dpi"), _("600 dpi")});
+    set_choice(dpiChoice, std::to_string(static_cast<int>(defaultOptions.dpi)));
+}
+
+ImageExport::Format ExportImagesDialog::format() const
+{
+    return ImageExport::formatFromName(get_choice(formatChoice).raw())
+        .value_or(defaultOptions.format);
+}
+
+double ExportImagesDialog::dpi() const
+{
+    try {
+        return std::stod(get_choice(dpiChoice).raw());
+    }
+    catch (...) {
+        return defaultOptions.dpi;
+    }
+}
+
+} // namespace Slicer
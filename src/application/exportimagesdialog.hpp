@@ -0,0 +1,38 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef EXPORTIMAGESDIALOG_HPP
+#define EXPORTIMAGESDIALOG_HPP
+
+#include <imageexport.hpp>
+#include <gtkmm/filechoosernative.h>
+#include <optional>
+
+namespace Slicer {
+
+// Picks the folder the pages are written to, and how they are written
+class ExportImagesDialog : public Gtk::FileChooserNative {
+public:
+    ExportImagesDialog(Gtk::Window& parent,
+                       std::optional<std::string> folderPath = {});
+
+    ImageExport::Format format() const;
+    double dpi() const;
+};
+
+} // namespace Slicer
+
+#endif // EXPORTIMAGESDIALOG_HPP
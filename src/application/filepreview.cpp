@@ -0,0 +1,180 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "filepreview.hpp"
+#include "pipeline.hpp"
+#include <document.hpp>
+#include <pageindex.hpp>
+#include <pagerenderer.hpp>
+#include <popplerhandles.hpp>
+#include <sourcefile.hpp>
+#include <trace.hpp>
+#include <glibmm/miscutils.h>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace Slicer {
+
+FilePreview::FilePreview(TaskRunner& taskRunner, SharedThumbnails& thumbnails)
+    : m_taskRunner{taskRunner}
+    , m_thumbnails{thumbnails}
+{
+    set_size_request(previewSize, previewSize);
+}
+
+FilePreview::~FilePreview()
+{
+    // The tasks on their way would deliver to a widget that's gone
+    cancel();
+}
+
+void FilePreview::cancel()
+{
+    ++*m_generation;
+    m_taskRunner.dropCanceledTasks();
+}
+
+bool FilePreview::showFile(const Glib::RefPtr<Gio::File>& file)
+{
+    cancel();
+    clear();
+
+    if (!file || file->get_path().empty()
+        || file->query_file_type() != Gio::FILE_TYPE_REGULAR)
+        return false;
+
+    const std::shared_ptr<DiskThumbnailCache> diskCache = m_thumbnails.diskCache();
+    Lookup first;
+    first.file = file;
+    first.filePath = file->get_path();
+
+    // Only the ends of the file are read, for the hash the caches know it
+    // by; the first page is rendered only when no cache has it
+    Pipeline<Lookup>{m_taskRunner, TaskRunner::Priority::Interactive, m_generation}
+        .onWorker([diskCache](Lookup& lookup) {
+            lookup.fileHash = Document::contentHashOf(lookup.filePath);
+            const PageIndex::Key indexKey = Document::pageIndexKeyOf(lookup.file, lookup.fileHash);
+            lookup.origin = {indexKey.fileSize, indexKey.modificationTime};
+
+            if (const auto entries = PageIndex::load(indexKey); entries.has_value() && !entries->empty()) {
+                lookup.rotation = entries->front().rotation;
+                lookup.numberOfPages = static_cast<unsigned int>(entries->size());
+            }
+
+            if (diskCache != nullptr && lookup.rotation.has_value())
+                lookup.thumbnail = diskCache->load({lookup.fileHash,
+                                                    0,
+                                                    *lookup.rotation,
+                                                    previewSize,
+                                                    lookup.origin.size,
+                                                    lookup.origin.modificationTime});
+        })
+        .onMainThread([this](Lookup& lookup) {
+            if (lookup.numberOfPages.has_value())
+                numberOfPagesFound.emit(*lookup.numberOfPages);
+
+            if (!lookup.thumbnail)
+                lookup.thumbnail = findCached(lookup);
+
+            if (lookup.thumbnail)
+                set(lookup.thumbnail);
+
+            return !lookup.thumbnail;
+        })
+        .onWorker([diskCache](Lookup& lookup) {
+            render(lookup, diskCache);
+        })
+        .onMainThread([this](Lookup& lookup) {
+            if (!lookup.thumbnail)
+                return;
+
+            m_thumbnails.cache().insert(ThumbnailCache::keyFor(*lookup.page, previewSize), lookup.thumbnail);
+            set(lookup.thumbnail);
+        })
+        .start(std::move(first));
+
+    return true;
+}
+
+Glib::RefPtr<Gdk::Pixbuf> FilePreview::findCached(const Lookup& lookup)
+{
+    // How the first page is turned isn't known without opening the file,
+    // unless it's indexed. One that was turned since is still the page the
+    // user is looking for.
+    const std::vector<int> rotations = lookup.rotation.has_value() ? std::vector<int>{*lookup.rotation}
+                                                                   : std::vector<int>{0, 90, 180, 270};
+    ThumbnailCache& cache = m_thumbnails.cache();
+
+    for (int rotation : rotations) {
+        const ThumbnailCache::Key key{lookup.fileHash,
+                                      0,
+                                      rotation,
+                                      previewSize,
+                                      lookup.origin.size,
+                                      lookup.origin.modificationTime};
+
+        if (Glib::RefPtr<Gdk::Pixbuf> thumbnail = cache.find(key))
+            return thumbnail;
+
+        // Scaled down from a thumbnail of the open document
+        if (Glib::RefPtr<Gdk::Pixbuf> larger = cache.findLarger(key, 4.0)) {
+            const Page::Size size = Page::scaleSize({larger->get_width(), larger->get_height()}, previewSize);
+
+            return larger->scale_simple(size.width, size.height, Gdk::INTERP_BILINEAR);
+        }
+    }
+
+    return {};
+}
+
+void FilePreview::render(Lookup& lookup, const std::shared_ptr<DiskThumbnailCache>& diskCache)
+{
+    const Trace::Span span{"FilePreview::render"};
+
+    try {
+        const std::unique_ptr<poppler::page> ppage = PopplerHandles::createPage(lookup.filePath, 0);
+        if (ppage != nullptr) {
+            // The file stays where it is when the page goes away
+            const std::shared_ptr<SourceFile> sourceFile = SourceFile::borrowed(lookup.file);
+            sourceFile->setOrigin(lookup.origin);
+
+            lookup.page = Glib::RefPtr<Page>{new Page{*ppage,
+                                                      Glib::path_get_basename(lookup.filePath),
+                                                      sourceFile,
+                                                      lookup.fileHash,
+                                                      0,
+                                                      0}};
+
+            const Glib::RefPtr<const Page> renderedPage = lookup.page;
+            lookup.thumbnail = PageRenderer{renderedPage}.renderEmbeddedThumbnail(previewSize).thumbnail;
+            if (!lookup.thumbnail)
+                lookup.thumbnail = PageRenderer{renderedPage}.render(previewSize);
+
+            // For the next time, after a restart too
+            if (lookup.thumbnail && diskCache != nullptr)
+                diskCache->store(DiskThumbnailCache::keyFor(*lookup.page, previewSize), lookup.thumbnail);
+        }
+    }
+    catch (const std::runtime_error&) {
+        // Not a document poppler can read; there's no preview
+    }
+
+    // It may well not be opened after all
+    PopplerHandles::release(lookup.filePath);
+}
+
+} // namespace Slicer
@@ -0,0 +1,84 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef SLICER_FILEPREVIEW_HPP
+#define SLICER_FILEPREVIEW_HPP
+
+#include "sharedthumbnails.hpp"
+#include "taskrunner.hpp"
+#include <page.hpp>
+#include <sourcefile.hpp>
+#include <giomm/file.h>
+#include <gtkmm/image.h>
+#include <atomic>
+#include <memory>
+#include <optional>
+
+namespace Slicer {
+
+// The first page of a file, small, so that telling a file from another
+// doesn't take opening it. Its thumbnail comes from the caches, in memory
+// or on disk, if it was shown before; else only that page is rendered, on
+// a worker, however big the file. Main thread only.
+class FilePreview : public Gtk::Image {
+public:
+    FilePreview(TaskRunner& taskRunner, SharedThumbnails& thumbnails);
+
+    FilePreview(const FilePreview&) = delete;
+    FilePreview& operator=(const FilePreview&) = delete;
+    FilePreview(FilePreview&&) = delete;
+    FilePreview& operator=(FilePreview&& src) = delete;
+
+    ~FilePreview() override;
+
+    // Clears the preview and starts on the one of file. Returns whether
+    // there may be one: only local files are looked at, since reading a
+    // remote one would fetch it.
+    bool showFile(const Glib::RefPtr<Gio::File>& file);
+
+    // How many pages the file has, when its PageIndex tells, without opening it
+    sigc::signal<void, unsigned int> numberOfPagesFound;
+
+    static constexpr int previewSize = 180;
+
+private:
+    // What the stages of a preview find out in turn
+    struct Lookup {
+        Glib::RefPtr<Gio::File> file;
+        std::string filePath;
+        std::string fileHash;
+        SourceFile::Origin origin;
+        // How the first page is turned, and how many there are, if the file is indexed
+        std::optional<int> rotation;
+        std::optional<unsigned int> numberOfPages;
+        Glib::RefPtr<Gdk::Pixbuf> thumbnail;
+        // Only when it has to be rendered
+        Glib::RefPtr<Page> page;
+    };
+
+    TaskRunner& m_taskRunner;
+    SharedThumbnails& m_thumbnails;
+    // Moving it on cancels the preview on its way
+    std::shared_ptr<std::atomic_uint> m_generation = std::make_shared<std::atomic_uint>(0);
+
+    Glib::RefPtr<Gdk::Pixbuf> findCached(const Lookup& lookup);
+    static void render(Lookup& lookup, const std::shared_ptr<DiskThumbnailCache>& diskCache);
+    void cancel();
+};
+
+} // namespace Slicer
+
+#endif // SLICER_FILEPREVIEW_HPP
@@ -0,0 +1,180 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "frameprofiler.hpp"
+#include <trace.hpp>
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+namespace Slicer {
+
+static const std::array<const char*, FrameProfiler::numberOfWorks> workNames{"task completions",
+                                                                             "layout",
+                                                                             "selection",
+                                                                             "paint"};
+
+// Names of the trace spans, which have to outlive the trace
+static const std::array<const char*, FrameProfiler::numberOfWorks> workSpanNames{"Frame work: task completions",
+                                                                                 "Frame work: layout",
+                                                                                 "Frame work: selection",
+                                                                                 "Frame work: paint"};
+
+static double millisecondsOf(FrameProfiler::Clock::duration duration)
+{
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+FrameProfiler& FrameProfiler::shared()
+{
+    static FrameProfiler profiler;
+
+    return profiler;
+}
+
+void FrameProfiler::acquire()
+{
+    ++m_users;
+}
+
+void FrameProfiler::release()
+{
+    if (m_users == 0)
+        return;
+
+    --m_users;
+
+    // What's left would be taken for the work of the next frame seen
+    if (m_users == 0) {
+        m_lastFrameTime.reset();
+        m_pendingWork = {};
+    }
+}
+
+void FrameProfiler::addWork(Work work, Clock::duration duration)
+{
+    if (isEnabled())
+        m_pendingWork.at(static_cast<std::size_t>(work)) += duration;
+}
+
+void FrameProfiler::recordFrame(Clock::time_point time)
+{
+    if (!isEnabled())
+        return;
+
+    const std::optional<Clock::time_point> lastFrameTime = m_lastFrameTime;
+    const WorkDurations work = m_pendingWork;
+    m_lastFrameTime = time;
+    m_pendingWork = {};
+
+    if (!lastFrameTime.has_value() || time - *lastFrameTime > idleGap)
+        return;
+
+    const Clock::duration frameTime = time - *lastFrameTime;
+    m_frames.push_back({frameTime, work});
+    if (m_frames.size() > maximumFrames)
+        m_frames.pop_front();
+
+    if (isOverBudget(frameTime))
+        Trace::record("Frame over budget", *lastFrameTime, time);
+}
+
+bool FrameProfiler::isOverBudget(Clock::duration frameTime) const
+{
+    return std::chrono::duration<double>(frameTime) > std::chrono::duration<double>(m_frameBudget) * overBudgetFactor;
+}
+
+FrameProfiler::Summary FrameProfiler::summary() const
+{
+    Summary summary;
+    summary.numberOfFrames = m_frames.size();
+
+    if (m_frames.empty())
+        return summary;
+
+    std::vector<Clock::duration> frameTimes;
+    frameTimes.reserve(m_frames.size());
+
+    for (const Frame& frame : m_frames) {
+        frameTimes.push_back(frame.frameTime);
+
+        if (!isOverBudget(frame.frameTime))
+            continue;
+
+        ++summary.numberOfFramesOverBudget;
+        for (std::size_t i = 0; i < numberOfWorks; ++i)
+            summary.workOverBudget.at(i) += frame.work.at(i);
+    }
+
+    std::sort(frameTimes.begin(), frameTimes.end());
+    summary.medianFrameTime = frameTimes.at(frameTimes.size() / 2);
+    summary.slowFrameTime = frameTimes.at((frameTimes.size() - 1) * 99 / 100);
+    summary.worstFrameTime = frameTimes.back();
+
+    return summary;
+}
+
+std::string FrameProfiler::describe() const
+{
+    const Summary frames = summary();
+
+    if (frames.numberOfFrames == 0)
+        return "Frames: none yet";
+
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(1)
+         << "Frames: " << frames.numberOfFrames << ", " << frames.numberOfFramesOverBudget << " over budget\n"
+         << "Frame time: p50 " << millisecondsOf(frames.medianFrameTime)
+         << " ms, p99 " << millisecondsOf(frames.slowFrameTime)
+         << " ms, worst " << millisecondsOf(frames.worstFrameTime) << " ms";
+
+    if (frames.numberOfFramesOverBudget == 0)
+        return text.str();
+
+    text << "\nOver budget, spent in:";
+    for (std::size_t i = 0; i < numberOfWorks; ++i)
+        text << " " << workNames.at(i) << " " << millisecondsOf(frames.workOverBudget.at(i)) << " ms";
+
+    return text.str();
+}
+
+void FrameProfiler::clear()
+{
+    m_frames.clear();
+    m_lastFrameTime.reset();
+    m_pendingWork = {};
+}
+
+FrameProfiler::Scope::Scope(Work work)
+    : m_work{work}
+{
+    if (shared().isEnabled() || Trace::isEnabled())
+        m_begin = Clock::now();
+}
+
+FrameProfiler::Scope::~Scope()
+{
+    if (!m_begin.has_value())
+        return;
+
+    const Clock::time_point end = Clock::now();
+    shared().addWork(m_work, end - *m_begin);
+    Trace::record(workSpanNames.at(static_cast<std::size_t>(m_work)), *m_begin, end);
+}
+
+} // namespace Slicer
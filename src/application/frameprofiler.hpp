@@ -0,0 +1,128 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef SLICER_FRAMEPROFILER_HPP
+#define SLICER_FRAMEPROFILER_HPP
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <optional>
+#include <string>
+
+namespace Slicer {
+
+// How long the frames of the page grid take, and what the main thread did
+// in the ones that went over budget. Windows report each frame they paint,
+// and the work done on the main thread in between is added to the next one.
+// A gap longer than idleGap is the grid being idle, not a slow frame.
+// Only used on the main thread.
+class FrameProfiler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Work {
+        TaskCompletions, // postExecute() of finished tasks, see CompletionQueue
+        Layout, // Placing and sizing page widgets, see View
+        Selection, // Updating the window for a new selection
+        Paint, // GTK's own layout and drawing of the frame
+    };
+
+    static constexpr std::size_t numberOfWorks = 4;
+    using WorkDurations = std::array<Clock::duration, numberOfWorks>;
+
+    struct Summary {
+        std::size_t numberOfFrames = 0;
+        std::size_t numberOfFramesOverBudget = 0;
+        Clock::duration medianFrameTime{};
+        Clock::duration slowFrameTime{}; // The 99th percentile
+        Clock::duration worstFrameTime{};
+        // Over all the frames over budget
+        WorkDurations workOverBudget{};
+    };
+
+    // The one the windows and the completion queue share
+    static FrameProfiler& shared();
+
+    FrameProfiler() = default;
+
+    FrameProfiler(const FrameProfiler&) = delete;
+    FrameProfiler& operator=(const FrameProfiler&) = delete;
+    FrameProfiler(FrameProfiler&&) = delete;
+    FrameProfiler& operator=(FrameProfiler&& src) = delete;
+
+    ~FrameProfiler() = default;
+
+    // Records while someone looks, like the metrics overlay or a trace
+    void acquire();
+    void release();
+    bool isEnabled() const { return m_users > 0; }
+
+    void setFrameBudget(Clock::duration budget) { m_frameBudget = budget; }
+    Clock::duration frameBudget() const { return m_frameBudget; }
+
+    void addWork(Work work, Clock::duration duration);
+    void recordFrame(Clock::time_point time);
+
+    // Of the last frames recorded, up to maximumFrames
+    Summary summary() const;
+    // A few lines for the metrics overlay
+    std::string describe() const;
+    void clear();
+
+    // Times the work of the scope it lives in, also as a trace span
+    class Scope {
+    public:
+        explicit Scope(Work work);
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+        Scope(Scope&&) = delete;
+        Scope& operator=(Scope&& src) = delete;
+
+        ~Scope();
+
+    private:
+        Work m_work;
+        std::optional<Clock::time_point> m_begin;
+    };
+
+    static constexpr std::size_t maximumFrames = 600;
+    static constexpr std::chrono::milliseconds idleGap{250};
+    // A frame is over budget once it takes this much longer than the budget,
+    // so that the jitter of the frame clock isn't taken for jank
+    static constexpr double overBudgetFactor = 1.5;
+
+private:
+    struct Frame {
+        Clock::duration frameTime;
+        WorkDurations work;
+    };
+
+    std::size_t m_users = 0;
+    Clock::duration m_frameBudget = std::chrono::microseconds{16667};
+    std::optional<Clock::time_point> m_lastFrameTime;
+    WorkDurations m_pendingWork{};
+    std::deque<Frame> m_frames;
+
+    bool isOverBudget(Clock::duration frameTime) const;
+};
+
+} // namespace Slicer
+
+#endif // SLICER_FRAMEPROFILER_HPP
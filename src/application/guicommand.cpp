@@ -67,7 +67,7 @@ void GuiAddFilesCommand::executeInternal()
 void GuiAddFilesCommand::setSubtitle()
 {
     if (m_oldSubtitle.empty() && m_files.size() == 1) {
-        Glib::ustring filename = Glib::filename_display_basename(m_files.at(0)->get_path());
+        Glib::ustring filename = Glib::filename_display_name(m_files.at(0)->get_basename());
 
         m_headerBar.set_subtitle(fmt::format(_("Added file {fileName}"),
                                              "fileName"_a = filename)); //NOLINT
@@ -16,12 +16,16 @@
 
 #include "interactivepagewidget.hpp"
 #include <glibmm/i18n.h>
+#include <gtkmm/tooltip.h>
 #include <fmt/format.h>
 
 using namespace fmt::literals;
 
 namespace Slicer {
 
+// Between the thumbnail and the labels
+static const int labelsMarginTop = 5;
+
 InteractivePageWidget::InteractivePageWidget(const Glib::RefPtr<const Page>& page,
                                              int targetSize,
                                              bool showFileName)
@@ -37,14 +41,20 @@ void InteractivePageWidget::setSelected(bool selected)
     if (m_isSelected != selected) {
         m_isSelected = selected;
 
+        // Recycled cells must drop the flag, not just add NORMAL to it
         if (selected)
             set_state_flags(Gtk::STATE_FLAG_SELECTED);
         else {
-            set_state_flags(Gtk::STATE_FLAG_NORMAL);
+            unset_state_flags(Gtk::STATE_FLAG_SELECTED);
         }
     }
 }
 
+void InteractivePageWidget::releaseThumbnail()
+{
+    m_pageWidget.releaseThumbnail();
+}
+
 void InteractivePageWidget::setRenderingTask(const std::weak_ptr<Task>& task)
 {
     m_pageWidget.setRenderingTask(task);
@@ -55,33 +65,72 @@ void InteractivePageWidget::cancelRendering()
     m_pageWidget.cancelRendering();
 }
 
+bool InteractivePageWidget::isRenderingNeeded() const
+{
+    return m_pageWidget.isRenderingNeeded();
+}
+
+bool InteractivePageWidget::isThumbnailVisible() const
+{
+    return m_pageWidget.isThumbnailVisible();
+}
+
+bool InteractivePageWidget::isUpToDate() const
+{
+    return m_pageWidget.isUpToDate();
+}
+
 void InteractivePageWidget::setShowFilename(bool showFileName)
 {
     if (m_showFileName == showFileName)
         return;
 
     m_showFileName = showFileName;
+    m_pageWidget.set_margin_bottom(labelsHeight());
+    queue_draw();
+}
+
+int InteractivePageWidget::labelsHeight() const
+{
+    // A line of either is as high, whatever its text, empty or not
+    int width = 0;
+    int lineHeight = 0;
+    m_pageNumberLayout->get_pixel_size(width, lineHeight);
 
-    if (m_showFileName)
-        m_pageLabelBox.pack_end(m_fileNameLabel);
-    else
-        m_pageLabelBox.remove(m_fileNameLabel);
+    return labelsMarginTop + (m_showFileName ? 2 : 1) * lineHeight;
 }
 
-int InteractivePageWidget::sortFunction(const InteractivePageWidget& a,
-                                        const InteractivePageWidget& b)
+Gdk::Rectangle InteractivePageWidget::thumbnailArea() const
 {
-    return Page::sortFunction(a.page(), b.page());
+    // The cell has a window of its own, so this is from its top left corner
+    return m_pageWidget.get_allocation();
 }
 
-void InteractivePageWidget::changeSize(int targetSize)
+Gdk::Rectangle InteractivePageWidget::fileNameArea() const
 {
-    m_pageWidget.changeSize(targetSize);
+    if (!m_showFileName)
+        return {};
+
+    int width = 0;
+    int lineHeight = 0;
+    m_pageNumberLayout->get_pixel_size(width, lineHeight);
+
+    return {0, get_allocated_height() - 2 * lineHeight, get_allocated_width(), lineHeight};
 }
 
-void InteractivePageWidget::renderPage()
+void InteractivePageWidget::setPage(const Glib::RefPtr<const Page>& page)
 {
-    m_pageWidget.renderPage();
+    if (page == this->page())
+        return;
+
+    m_pageWidget.setPage(page);
+    m_areLabelsOutdated = true;
+    queue_draw();
+}
+
+void InteractivePageWidget::changeSize(int targetSize)
+{
+    m_pageWidget.changeSize(targetSize);
 }
 
 void InteractivePageWidget::showSpinner()
@@ -89,9 +138,24 @@ void InteractivePageWidget::showSpinner()
     m_pageWidget.showSpinner();
 }
 
-void InteractivePageWidget::showPage()
+void InteractivePageWidget::showScaledThumbnail()
+{
+    m_pageWidget.showScaledThumbnail();
+}
+
+void InteractivePageWidget::keepScaledThumbnail()
+{
+    m_pageWidget.keepScaledThumbnail();
+}
+
+void InteractivePageWidget::showPage(const Glib::RefPtr<Gdk::Pixbuf>& thumbnail)
+{
+    m_pageWidget.showPage(thumbnail);
+}
+
+void InteractivePageWidget::showPlaceholder(const Glib::RefPtr<Gdk::Pixbuf>& thumbnail)
 {
-    m_pageWidget.showPage();
+    m_pageWidget.showPlaceholder(thumbnail);
 }
 
 const Glib::RefPtr<const Page>& InteractivePageWidget::page() const
@@ -99,47 +163,85 @@ const Glib::RefPtr<const Page>& InteractivePageWidget::page() const
     return m_pageWidget.page();
 }
 
+int InteractivePageWidget::targetSize() const
+{
+    return m_pageWidget.targetSize();
+}
+
+int InteractivePageWidget::renderedSize() const
+{
+    return m_pageWidget.renderedSize();
+}
+
+void InteractivePageWidget::updateLabels()
+{
+    m_fileNameLayout->set_text(page()->fileName());
+    m_pageNumberLayout->set_text(fmt::format(_("Page {pageNumber}"),
+                                             "pageNumber"_a = page()->indexInFile() + 1)); //NOLINT
+    m_areLabelsOutdated = false;
+}
+
 void InteractivePageWidget::setupWidgets()
 {
-    m_previewButton.set_image_from_icon_name("system-search-symbolic");
-    m_previewButton.set_can_focus(false);
-    m_previewButtonRevealer.add(m_previewButton);
-    m_previewButtonRevealer.set_transition_type(Gtk::REVEALER_TRANSITION_TYPE_CROSSFADE);
-    m_previewButtonRevealer.set_halign(Gtk::ALIGN_END);
-    m_previewButtonRevealer.set_valign(Gtk::ALIGN_START);
-    m_previewButtonRevealer.set_margin_top(10);
-    m_previewButtonRevealer.set_margin_right(10);
-
-    m_overlay.set_halign(Gtk::ALIGN_CENTER);
-    m_overlay.set_valign(Gtk::ALIGN_CENTER);
-    m_overlay.add_overlay(m_previewButtonRevealer);
-    m_overlay.add(m_pageWidget);
-
-    m_fileNameLabel.set_label(page()->fileName());
-    m_fileNameLabel.set_tooltip_text(page()->fileName());
-    m_fileNameLabel.set_ellipsize(Pango::ELLIPSIZE_END);
-    m_fileNameLabel.set_max_width_chars(10);
-    m_fileNameLabel.set_visible();
-    m_pageNumberLabel.set_label(fmt::format(_("Page {pageNumber}"),
-                                            "pageNumber"_a = page()->indexInFile() + 1)); //NOLINT
-    m_pageLabelBox.set_orientation(Gtk::ORIENTATION_VERTICAL);
-    m_pageLabelBox.set_margin_top(5);
-    m_pageLabelBox.pack_end(m_pageNumberLabel);
-    if (m_showFileName)
-        m_pageLabelBox.pack_end(m_fileNameLabel);
-
-    m_contentBox.set_orientation(Gtk::ORIENTATION_VERTICAL);
-    m_contentBox.pack_start(m_overlay);
-    m_contentBox.pack_start(m_pageLabelBox, Gtk::PACK_SHRINK);
-    m_eventBox.add(m_contentBox);
-    add(m_eventBox);
-
-    set_margin_start(10);
-    set_margin_end(10);
+    m_fileNameLayout = create_pango_layout("");
+    m_fileNameLayout->set_alignment(Pango::ALIGN_CENTER);
+    m_fileNameLayout->set_ellipsize(Pango::ELLIPSIZE_END);
+    m_pageNumberLayout = create_pango_layout("");
+    m_pageNumberLayout->set_alignment(Pango::ALIGN_CENTER);
+
+    m_pageWidget.set_margin_bottom(labelsHeight());
+    add(m_pageWidget);
+
+    get_style_context()->add_class("page-cell");
+    set_can_focus(true);
+    set_has_tooltip(true);
 
     show_all();
 }
 
+bool InteractivePageWidget::on_draw(const Cairo::RefPtr<Cairo::Context>& cr)
+{
+    const bool isHandled = Gtk::EventBox::on_draw(cr);
+
+    if (m_areLabelsOutdated)
+        updateLabels();
+
+    const Glib::RefPtr<Gtk::StyleContext> style = get_style_context();
+    const int width = get_allocated_width();
+    int bottom = get_allocated_height();
+
+    // From the bottom up: the page number, then the file name over it
+    for (const Glib::RefPtr<Pango::Layout>& layout : {m_pageNumberLayout, m_fileNameLayout}) {
+        if (layout == m_fileNameLayout && !m_showFileName)
+            break;
+
+        layout->set_width(width * PANGO_SCALE);
+
+        int lineWidth = 0;
+        int lineHeight = 0;
+        layout->get_pixel_size(lineWidth, lineHeight);
+        bottom -= lineHeight;
+
+        style->render_layout(cr, 0, bottom, layout);
+    }
+
+    return isHandled;
+}
+
+void InteractivePageWidget::on_style_updated()
+{
+    Gtk::EventBox::on_style_updated();
+
+    // Also while the base class is constructed, before there are layouts
+    if (!m_fileNameLayout)
+        return;
+
+    // The font may have changed with the theme
+    m_fileNameLayout->context_changed();
+    m_pageNumberLayout->context_changed();
+    m_pageWidget.set_margin_bottom(labelsHeight());
+}
+
 void InteractivePageWidget::setupSignalHandlers()
 {
     add_events(Gdk::KEY_RELEASE_MASK);
@@ -161,7 +263,7 @@ void InteractivePageWidget::setupSignalHandlers()
         return false;
     });
 
-    m_eventBox.signal_button_release_event().connect([this](GdkEventButton* eventButton) {
+    signal_button_release_event().connect([this](GdkEventButton* eventButton) {
         if (eventButton->button == 1) {
             if ((eventButton->state & GDK_SHIFT_MASK) != 0) {
                 setSelected(true);
@@ -180,31 +282,28 @@ void InteractivePageWidget::setupSignalHandlers()
         return false;
     });
 
-    m_eventBox.signal_enter_notify_event().connect([this](GdkEventCrossing*) {
-        m_previewButtonRevealer.set_reveal_child(true);
+    signal_enter_notify_event().connect([this](GdkEventCrossing*) {
+        hoverChanged.emit(this, true);
 
         return false;
     });
 
-    m_eventBox.signal_leave_notify_event().connect([this](GdkEventCrossing*) {
-        m_previewButtonRevealer.set_reveal_child(false);
+    signal_leave_notify_event().connect([this](GdkEventCrossing*) {
+        hoverChanged.emit(this, false);
 
         return false;
     });
 
-    m_previewButton.signal_enter_notify_event().connect([this](GdkEventCrossing*) {
-        m_previewButtonRevealer.set_reveal_child(true);
+    // Over the file name, which may not fit
+    signal_query_tooltip().connect([this](int x, int y, bool, const Glib::RefPtr<Gtk::Tooltip>& tooltip) {
+        const Gdk::Rectangle area = fileNameArea();
+        if (!m_showFileName || x < area.get_x() || x >= area.get_x() + area.get_width()
+            || y < area.get_y() || y >= area.get_y() + area.get_height())
+            return false;
 
-        return false;
-    });
-
-    m_previewButton.signal_button_release_event().connect([](GdkEventButton* eventButton) {
-        // If the event was a left click, don't propagate the event further
-        return eventButton->button == 1;
-    });
+        tooltip->set_text(page()->fileName());
 
-    m_previewButton.signal_clicked().connect([this]() {
-        previewRequested.emit(page());
+        return true;
     });
 }
 
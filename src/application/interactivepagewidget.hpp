@@ -18,16 +18,16 @@
 #define INTERACTIVEPAGEWIDGET_HPP
 
 #include "pagewidget.hpp"
-#include <gtkmm/button.h>
 #include <gtkmm/eventbox.h>
-#include <gtkmm/flowboxchild.h>
-#include <gtkmm/label.h>
-#include <gtkmm/overlay.h>
-#include <gtkmm/revealer.h>
+#include <pangomm/layout.h>
 
 namespace Slicer {
 
-class InteractivePageWidget : public Gtk::FlowBoxChild {
+// A cell of the page grid. View recycles these, so the page
+// they show changes as the user scrolls. Kept to as few widgets as it
+// takes, as there may be hundreds: the labels are drawn text, and the
+// preview button is one View moves over the cell under the pointer.
+class InteractivePageWidget : public Gtk::EventBox {
 
 public:
     InteractivePageWidget(const Glib::RefPtr<const Page>& page,
@@ -46,40 +46,55 @@ public:
 
     void setShowFilename(bool showFileName);
 
+    // Height taken by the file name and page number labels
+    int labelsHeight() const;
+    // Where the thumbnail is, from the top left corner of the cell
+    Gdk::Rectangle thumbnailArea() const;
+
     sigc::signal<void, InteractivePageWidget*> selectedChanged;
     sigc::signal<void, InteractivePageWidget*> shiftSelected;
     sigc::signal<void, Glib::RefPtr<const Page>> previewRequested;
-
-    static int sortFunction(const InteractivePageWidget& a,
-                            const InteractivePageWidget& b);
+    // When the pointer enters the cell, and when it leaves
+    sigc::signal<void, InteractivePageWidget*, bool> hoverChanged;
 
     // Interface of Slicer::PageWidget
+    void setPage(const Glib::RefPtr<const Page>& page);
     void changeSize(int targetSize);
-    void renderPage();
     void showSpinner();
-    void showPage();
+    void showPage(const Glib::RefPtr<Gdk::Pixbuf>& thumbnail);
+    void showPlaceholder(const Glib::RefPtr<Gdk::Pixbuf>& thumbnail);
+    void showScaledThumbnail();
+    void releaseThumbnail();
+    void keepScaledThumbnail();
     void setRenderingTask(const std::weak_ptr<Task>& task);
     void cancelRendering();
+    bool isRenderingNeeded() const;
+    bool isThumbnailVisible() const;
+    bool isUpToDate() const;
+    const Glib::RefPtr<const Page>& page() const;
+    int targetSize() const;
+    int renderedSize() const;
+
+protected:
+    bool on_draw(const Cairo::RefPtr<Cairo::Context>& cr) override;
+    void on_style_updated() override;
 
 private:
     bool m_isSelected = false;
     bool m_showFileName = false;
 
-    Gtk::EventBox m_eventBox;
-    Gtk::Box m_contentBox;
-    Gtk::Overlay m_overlay;
     Slicer::PageWidget m_pageWidget;
 
-    Gtk::Button m_previewButton;
-    Gtk::Revealer m_previewButtonRevealer;
-
-    Gtk::Box m_pageLabelBox;
-    Gtk::Label m_fileNameLabel;
-    Gtk::Label m_pageNumberLabel;
+    // Set for the page when they're first drawn, not every time it changes
+    Glib::RefPtr<Pango::Layout> m_fileNameLayout;
+    Glib::RefPtr<Pango::Layout> m_pageNumberLayout;
+    bool m_areLabelsOutdated = true;
 
-    const Glib::RefPtr<const Page>& page() const;
     void setupWidgets();
+    void updateLabels();
     void setupSignalHandlers();
+    // The line the file name is drawn on, empty while it isn't
+    Gdk::Rectangle fileNameArea() const;
 };
 
 } // namespace Slicer
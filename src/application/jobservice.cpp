@@ -0,0 +1,268 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "jobservice.hpp"
+#include <batchmanifest.hpp>
+#include <imageexport.hpp>
+#include <glibmm/main.h>
+#include <glibmm/miscutils.h>
+#include <config.hpp>
+#include <logger.hpp>
+#include <trace.hpp>
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+
+namespace Slicer {
+
+const std::string JobService::interfaceName = config::APPLICATION_ID + ".Jobs";
+
+static const char* const introspectionXml = R"(<node>
+  <interface name="com.github.junrrein.PDFSlicer.Jobs">
+    <method name="RemovePages">
+      <arg type="s" name="input" direction="in"/>
+      <arg type="s" name="pages" direction="in"/>
+      <arg type="s" name="output" direction="in"/>
+      <arg type="u" name="job" direction="out"/>
+    </method>
+    <method name="Merge">
+      <arg type="as" name="inputs" direction="in"/>
+      <arg type="s" name="output" direction="in"/>
+      <arg type="u" name="job" direction="out"/>
+    </method>
+    <method name="Split">
+      <arg type="s" name="input" direction="in"/>
+      <arg type="u" name="pagesPerFile" direction="in"/>
+      <arg type="s" name="output" direction="in"/>
+      <arg type="u" name="job" direction="out"/>
+    </method>
+    <method name="Export">
+      <arg type="s" name="input" direction="in"/>
+      <arg type="s" name="format" direction="in"/>
+      <arg type="u" name="dpi" direction="in"/>
+      <arg type="s" name="output" direction="in"/>
+      <arg type="u" name="job" direction="out"/>
+    </method>
+    <method name="Submit">
+      <arg type="s" name="job" direction="in"/>
+      <arg type="u" name="job" direction="out"/>
+    </method>
+    <signal name="JobFinished">
+      <arg type="u" name="job"/>
+      <arg type="b" name="succeeded"/>
+      <arg type="s" name="error"/>
+      <arg type="as" name="writtenFiles"/>
+    </signal>
+  </interface>
+</node>)";
+
+// Relative paths would be taken from the working directory of this
+// process, not the caller's
+static Glib::RefPtr<Gio::File> fileOf(const Glib::ustring& argument)
+{
+    if (!Glib::path_is_absolute(argument) && argument.find("://") == Glib::ustring::npos)
+        throw std::runtime_error("Expected an absolute path or a URI, got '" + argument + "'");
+
+    return Gio::File::create_for_commandline_arg(argument);
+}
+
+template<typename T>
+static T childOf(const Glib::VariantContainerBase& parameters, std::size_t index)
+{
+    Glib::Variant<T> child;
+    parameters.get_child(child, index);
+
+    return child.get();
+}
+
+JobService::JobService(Gio::Application& application, TaskRunner& taskRunner)
+    : m_application{application}
+    , m_taskRunner{taskRunner}
+{
+}
+
+JobService::~JobService()
+{
+    *m_isAlive = false;
+
+    if (m_registrationId != 0)
+        m_connection->unregister_object(m_registrationId);
+}
+
+void JobService::registerObject()
+{
+    m_connection = m_application.get_dbus_connection();
+    if (!m_connection)
+        return;
+
+    m_objectPath = m_application.get_dbus_object_path();
+
+    try {
+        const Glib::RefPtr<Gio::DBus::NodeInfo> introspection = Gio::DBus::NodeInfo::create_for_xml(introspectionXml);
+        const Gio::DBus::InterfaceVTable vtable{sigc::mem_fun(*this, &JobService::onMethodCall)};
+
+        m_registrationId = m_connection->register_object(m_objectPath,
+                                                         introspection->lookup_interface(interfaceName),
+                                                         vtable);
+    }
+    catch (const Glib::Error& e) {
+        Logger::logWarning("Jobs can't be submitted over D-Bus: " + e.what());
+    }
+}
+
+void JobService::onMethodCall(const Glib::RefPtr<Gio::DBus::Connection>&,
+                              const Glib::ustring&,
+                              const Glib::ustring&,
+                              const Glib::ustring&,
+                              const Glib::ustring& methodName,
+                              const Glib::VariantContainerBase& parameters,
+                              const Glib::RefPtr<Gio::DBus::MethodInvocation>& invocation)
+{
+    try {
+        const guint32 jobNumber = submit(createJob(methodName, parameters));
+
+        invocation->return_value(Glib::VariantContainerBase::create_tuple(Glib::Variant<guint32>::create(jobNumber)));
+    }
+    catch (const Glib::Error& e) {
+        invocation->return_dbus_error(interfaceName + ".InvalidJob", e.what());
+    }
+    catch (const std::exception& e) {
+        invocation->return_dbus_error(interfaceName + ".InvalidJob", e.what());
+    }
+}
+
+BatchJob JobService::createJob(const Glib::ustring& methodName, const Glib::VariantContainerBase& parameters)
+{
+    BatchJob job;
+
+    if (methodName == "RemovePages") {
+        job.inputs.push_back(fileOf(childOf<Glib::ustring>(parameters, 0)));
+        job.operations.push_back({BatchOperation::Type::Remove, childOf<Glib::ustring>(parameters, 1)});
+        job.output = fileOf(childOf<Glib::ustring>(parameters, 2));
+    }
+    else if (methodName == "Merge") {
+        for (const Glib::ustring& input : childOf<std::vector<Glib::ustring>>(parameters, 0))
+            job.inputs.push_back(fileOf(input));
+
+        if (job.inputs.empty())
+            throw std::runtime_error("Nothing to merge");
+
+        job.output = fileOf(childOf<Glib::ustring>(parameters, 1));
+    }
+    else if (methodName == "Split") {
+        job.inputs.push_back(fileOf(childOf<Glib::ustring>(parameters, 0)));
+        job.splitEvery = childOf<guint32>(parameters, 1);
+
+        if (job.splitEvery == 0)
+            throw std::runtime_error("Files of at least one page each are needed to split");
+
+        job.output = fileOf(childOf<Glib::ustring>(parameters, 2));
+    }
+    else if (methodName == "Export") {
+        job.inputs.push_back(fileOf(childOf<Glib::ustring>(parameters, 0)));
+
+        const Glib::ustring formatName = childOf<Glib::ustring>(parameters, 1);
+        const auto format = ImageExport::formatFromName(formatName);
+        if (!format.has_value())
+            throw std::runtime_error("Unknown image format: " + formatName);
+
+        ImageExport::Options options;
+        options.format = format.value();
+        if (const guint32 dpi = childOf<guint32>(parameters, 2); dpi > 0)
+            options.dpi = dpi;
+
+        job.imageExport = options;
+        job.output = fileOf(childOf<Glib::ustring>(parameters, 3));
+    }
+    else if (methodName == "Submit") {
+        job = parseBatchJob(childOf<Glib::ustring>(parameters, 0));
+    }
+    else {
+        throw std::runtime_error("Unknown method: " + methodName);
+    }
+
+    return job;
+}
+
+guint32 JobService::submit(BatchJob job)
+{
+    const guint32 jobNumber = m_nextJob++;
+    auto result = std::make_shared<BatchJobResult>(BatchJobResult{false, {}, {}, {}, {}});
+
+    // Not left to exit halfway, even after the last window closes
+    m_application.hold();
+
+    auto task = std::make_shared<Task>(
+        [job = std::move(job), result]() {
+            const Trace::Span span{"JobService job"};
+            const auto start = std::chrono::steady_clock::now();
+
+            try {
+                result->writtenFiles = runBatchJob(job);
+                result->succeeded = true;
+            }
+            catch (const Glib::Error& e) {
+                result->error = Glib::ustring{e.what()}.raw();
+            }
+            catch (const std::exception& e) {
+                result->error = e.what();
+            }
+
+            result->duration = std::chrono::steady_clock::now() - start;
+        },
+        [this, jobNumber, result, isAlive = m_isAlive]() {
+            if (!*isAlive)
+                return;
+
+            emitJobFinished(jobNumber, *result);
+            m_application.release();
+        });
+
+    // They take long, and only wait behind the thumbnails
+    task->setHeavy(true);
+    m_taskRunner.queue(task, TaskRunner::Priority::Idle);
+
+    return jobNumber;
+}
+
+void JobService::emitJobFinished(guint32 jobNumber, const BatchJobResult& result)
+{
+    if (!result.succeeded)
+        Logger::logWarning("Job " + std::to_string(jobNumber) + " failed: " + result.error);
+
+    std::vector<Glib::ustring> writtenFiles;
+    for (const Glib::RefPtr<Gio::File>& file : result.writtenFiles)
+        writtenFiles.push_back(file->get_path());
+
+    const std::vector<Glib::VariantBase> values{Glib::Variant<guint32>::create(jobNumber),
+                                                Glib::Variant<bool>::create(result.succeeded),
+                                                Glib::Variant<Glib::ustring>::create(result.error),
+                                                Glib::Variant<std::vector<Glib::ustring>>::create(writtenFiles)};
+
+    try {
+        m_connection->emit_signal(m_objectPath,
+                                  interfaceName,
+                                  "JobFinished",
+                                  {},
+                                  Glib::VariantContainerBase::create_tuple(values));
+    }
+    catch (const Glib::Error& e) {
+        Logger::logWarning("The end of job " + std::to_string(jobNumber) + " couldn't be signaled: " + e.what());
+    }
+}
+
+} // namespace Slicer
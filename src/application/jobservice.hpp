@@ -0,0 +1,86 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef SLICER_JOBSERVICE_HPP
+#define SLICER_JOBSERVICE_HPP
+
+#include "taskrunner.hpp"
+#include <batchjob.hpp>
+#include <giomm/application.h>
+#include <giomm/dbusconnection.h>
+#include <giomm/dbusintrospection.h>
+#include <memory>
+
+namespace Slicer {
+
+// Batch jobs submitted over D-Bus to the running instance, so that scripts
+// don't start a process per file. The interface sits on the object path of
+// the application, on its own connection:
+//
+//   RemovePages(s input, s pages, s output) -> u job
+//   Merge(as inputs, s output) -> u job
+//   Split(s input, u pagesPerFile, s output) -> u job
+//   Export(s input, s format, u dpi, s output) -> u job
+//   Submit(s job) -> u job, a job object as in a manifest, see batchmanifest.hpp
+//   signal JobFinished(u job, b succeeded, s error, as writtenFiles)
+//
+// Files are absolute paths or URIs, and pages are page range expressions.
+// Jobs run as idle tasks of the TaskRunner, after every thumbnail, and keep
+// the application running until they finish.
+class JobService {
+public:
+    JobService(Gio::Application& application, TaskRunner& taskRunner);
+
+    JobService(const JobService&) = delete;
+    JobService& operator=(const JobService&) = delete;
+    JobService(JobService&&) = delete;
+    JobService& operator=(JobService&& src) = delete;
+
+    ~JobService();
+
+    // Once the application is registered, on startup. Does nothing without a bus.
+    void registerObject();
+
+    static const std::string interfaceName;
+
+private:
+    Gio::Application& m_application;
+    TaskRunner& m_taskRunner;
+    Glib::RefPtr<Gio::DBus::Connection> m_connection;
+    std::string m_objectPath;
+    guint m_registrationId = 0;
+    guint32 m_nextJob = 1;
+    // Lowered on destruction, so that jobs finishing later don't report
+    std::shared_ptr<bool> m_isAlive = std::make_shared<bool>(true);
+
+    void onMethodCall(const Glib::RefPtr<Gio::DBus::Connection>& connection,
+                      const Glib::ustring& sender,
+                      const Glib::ustring& objectPath,
+                      const Glib::ustring& interfaceName,
+                      const Glib::ustring& methodName,
+                      const Glib::VariantContainerBase& parameters,
+                      const Glib::RefPtr<Gio::DBus::MethodInvocation>& invocation);
+
+    // Throws std::runtime_error if the call doesn't make a job
+    static BatchJob createJob(const Glib::ustring& methodName, const Glib::VariantContainerBase& parameters);
+    guint32 submit(BatchJob job);
+    void emitJobFinished(guint32 jobNumber, const BatchJobResult& result);
+};
+
+} // namespace Slicer
+
+#endif // SLICER_JOBSERVICE_HPP
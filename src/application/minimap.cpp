@@ -0,0 +1,341 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "minimap.hpp"
+#include <pagerenderer.hpp>
+#include <cairomm/context.h>
+#include <glibmm/main.h>
+#include <gtkmm/stylecontext.h>
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <utility>
+
+namespace Slicer {
+
+static std::size_t sizeOf(const Cairo::RefPtr<Cairo::ImageSurface>& surface)
+{
+    return surface ? static_cast<std::size_t>(surface->get_stride()) * static_cast<std::size_t>(surface->get_height()) : 0;
+}
+
+Minimap::Minimap(TaskRunner& taskRunner)
+    : m_taskRunner{taskRunner}
+{
+    set_size_request(stripWidth, -1);
+    add_events(Gdk::BUTTON_PRESS_MASK | Gdk::BUTTON_RELEASE_MASK | Gdk::BUTTON1_MOTION_MASK);
+    get_style_context()->add_class("minimap");
+
+    // Shown once a document is long enough to need it
+    set_no_show_all();
+    hide();
+}
+
+Minimap::~Minimap()
+{
+    // The tasks on their way would deliver to a widget that's gone
+    cancelPass();
+    m_recomposeConnection.disconnect();
+
+    for (sigc::connection& connection : m_documentConnections)
+        connection.disconnect();
+
+    for (sigc::connection& connection : m_adjustmentConnections)
+        connection.disconnect();
+}
+
+void Minimap::setDocument(Document& document)
+{
+    cancelPass();
+
+    for (sigc::connection& connection : m_documentConnections)
+        connection.disconnect();
+
+    m_documentConnections.clear();
+    m_document = &document;
+    m_thumbnails.clear();
+    m_thumbnailsCharge.set(0);
+
+    m_documentConnections.emplace_back(
+        m_document->pages()->signal_items_changed().connect([this](guint, guint, guint) {
+            queueRecompose();
+        }));
+    m_documentConnections.emplace_back(
+        m_document->pagesRotated.connect([this](const std::vector<unsigned int>& positions) {
+            for (unsigned int position : positions) {
+                const auto it = m_thumbnails.find(m_document->pages()->rowAt(position).key());
+
+                if (it != m_thumbnails.end()) {
+                    m_thumbnailsCharge.set(m_thumbnailsCharge.bytes() - sizeOf(it->second));
+                    m_thumbnails.erase(it);
+                }
+            }
+
+            queueRecompose();
+        }));
+    m_documentConnections.emplace_back(
+        m_document->pagesReordered.connect([this](const std::vector<unsigned int>&) {
+            queueRecompose();
+        }));
+
+    queueRecompose();
+}
+
+void Minimap::setScrollAdjustment(const Glib::RefPtr<Gtk::Adjustment>& adjustment)
+{
+    for (sigc::connection& connection : m_adjustmentConnections)
+        connection.disconnect();
+
+    m_adjustmentConnections.clear();
+    m_vadjustment = adjustment;
+
+    if (m_vadjustment) {
+        m_adjustmentConnections.emplace_back(
+            m_vadjustment->signal_value_changed().connect([this]() { queue_draw(); }));
+        m_adjustmentConnections.emplace_back(
+            m_vadjustment->signal_changed().connect([this]() { queue_draw(); }));
+    }
+
+    queue_draw();
+}
+
+void Minimap::cancelPass()
+{
+    ++*m_generation;
+    m_taskRunner.dropCanceledTasks();
+}
+
+void Minimap::queueRecompose()
+{
+    if (m_recomposeConnection.connected())
+        return;
+
+    // A single edit notifies several times, and a document opens in batches
+    m_recomposeConnection = Glib::signal_idle().connect([this]() {
+        recompose();
+
+        return false;
+    });
+}
+
+void Minimap::recompose()
+{
+    m_recomposeConnection.disconnect();
+    cancelPass();
+
+    const unsigned int numberOfPages = m_document == nullptr ? 0 : m_document->numberOfPages();
+    set_visible(numberOfPages >= minimumNumberOfPages);
+
+    if (numberOfPages < minimumNumberOfPages) {
+        m_strip.clear();
+        return;
+    }
+
+    // Without the pages that are gone for good, as far as anyone can tell:
+    // those that were removed stay in for a while, for undoing it
+    if (m_thumbnails.size() > 2 * static_cast<std::size_t>(numberOfPages)) {
+        std::unordered_map<PageListModel::Key, Cairo::RefPtr<Cairo::ImageSurface>> thumbnails;
+
+        for (unsigned int i = 0; i < numberOfPages; ++i) {
+            const PageListModel::Key key = m_document->pages()->rowAt(i).key();
+
+            if (auto it = m_thumbnails.find(key); it != m_thumbnails.end())
+                thumbnails.insert(*it);
+        }
+
+        m_thumbnails = std::move(thumbnails);
+
+        std::size_t bytes = 0;
+        for (const auto& [key, thumbnail] : m_thumbnails)
+            bytes += sizeOf(thumbnail);
+        m_thumbnailsCharge.set(bytes);
+    }
+
+    const int height = static_cast<int>(std::min<unsigned int>(numberOfPages * thumbnailSize * 3 / 2, maximumStripHeight));
+    m_strip = Cairo::ImageSurface::create(Cairo::FORMAT_ARGB32, stripWidth, height);
+    const auto cr = Cairo::Context::create(m_strip);
+
+    for (unsigned int i = 0; i < numberOfPages; ++i) {
+        if (auto it = m_thumbnails.find(m_document->pages()->rowAt(i).key()); it != m_thumbnails.end())
+            drawBand(cr, i, it->second);
+    }
+
+    queue_draw();
+    renderBatch(0);
+}
+
+void Minimap::drawBand(const Cairo::RefPtr<Cairo::Context>& cr,
+                       unsigned int index,
+                       const Cairo::RefPtr<Cairo::ImageSurface>& thumbnail) const
+{
+    if (!thumbnail)
+        return;
+
+    const double numberOfPages = m_document->numberOfPages();
+    const double top = index * m_strip->get_height() / numberOfPages;
+    const double bandHeight = m_strip->get_height() / numberOfPages;
+    // Some room between pages, while there is any
+    const double gap = bandHeight >= 8 ? 2 : 0;
+
+    // Every page takes the same width, so the strip reads like the grid. In
+    // bands too short for a page, it's squashed into stripes of its colors.
+    const double scaleX = static_cast<double>(stripWidth - 4) / thumbnailSize;
+    const double scaleY = std::min(scaleX, (bandHeight - gap) / thumbnail->get_height());
+    const double width = thumbnail->get_width() * scaleX;
+
+    cr->save();
+    cr->translate((stripWidth - width) / 2, top + (bandHeight - thumbnail->get_height() * scaleY) / 2);
+    cr->scale(scaleX, scaleY);
+    cr->set_source(thumbnail, 0, 0);
+    cr->paint();
+    cr->restore();
+}
+
+void Minimap::renderBatch(unsigned int index)
+{
+    if (m_document == nullptr)
+        return;
+
+    const unsigned int numberOfPages = m_document->numberOfPages();
+    std::vector<std::pair<unsigned int, Glib::RefPtr<const Page>>> batch;
+
+    for (; index < numberOfPages && batch.size() < batchSize; ++index) {
+        if (m_thumbnails.count(m_document->pages()->rowAt(index).key()) == 0)
+            batch.emplace_back(index, m_document->getPage(index));
+    }
+
+    if (batch.empty())
+        return;
+
+    auto thumbnails = std::make_shared<std::vector<Cairo::RefPtr<Cairo::ImageSurface>>>();
+
+    auto funcExecute = [batch, thumbnails]() {
+        for (const auto& [position, page] : batch)
+            thumbnails->push_back(PageRenderer{page}.renderToSurface(thumbnailSize));
+    };
+
+    auto funcPostExecute = [this, batch, thumbnails, next = index]() {
+        const auto cr = m_strip ? Cairo::Context::create(m_strip) : Cairo::RefPtr<Cairo::Context>{};
+        const unsigned int pages = m_document->numberOfPages();
+
+        for (std::size_t i = 0; i < batch.size(); ++i) {
+            const auto& [position, page] = batch.at(i);
+            const PageListModel::Key key = page->listKey();
+            const Cairo::RefPtr<Cairo::ImageSurface>& thumbnail = thumbnails->at(i);
+
+            // Kept even when it couldn't be rendered, so it isn't tried again and again
+            if (!m_thumbnails.emplace(key, thumbnail).second)
+                continue;
+
+            m_thumbnailsCharge.set(m_thumbnailsCharge.bytes() + sizeOf(thumbnail));
+
+            // An edit since only moves the page; drawing it again is up to the recompose it queued
+            if (cr && position < pages && m_document->pages()->rowAt(position).key() == key)
+                drawBand(cr, position, thumbnail);
+        }
+
+        queue_draw();
+        renderBatch(next);
+    };
+
+    auto task = std::make_shared<Task>(funcExecute, funcPostExecute);
+    task->setGeneration(m_generation);
+    // One file after the other, on the worker that has it open
+    m_taskRunner.queue(task, TaskRunner::Priority::Background, std::hash<std::string>{}(batch.front().second->filePath()));
+}
+
+bool Minimap::on_draw(const Cairo::RefPtr<Cairo::Context>& cr)
+{
+    const int width = get_allocated_width();
+    const int height = get_allocated_height();
+
+    get_style_context()->render_background(cr, 0, 0, width, height);
+    get_style_context()->render_frame(cr, 0, 0, width, height);
+
+    if (m_strip) {
+        auto pattern = Cairo::SurfacePattern::create(m_strip);
+        pattern->set_filter(Cairo::FILTER_GOOD);
+
+        cr->save();
+        cr->scale(static_cast<double>(width) / m_strip->get_width(), static_cast<double>(height) / m_strip->get_height());
+        cr->set_source(pattern);
+        cr->paint();
+        cr->restore();
+    }
+
+    // The part of the document the view shows
+    if (m_vadjustment && m_vadjustment->get_upper() > 0) {
+        const double upper = m_vadjustment->get_upper();
+        const double top = m_vadjustment->get_value() / upper * height;
+        const double markHeight = std::max(4.0, m_vadjustment->get_page_size() / upper * height);
+        const Gdk::RGBA color = get_style_context()->get_color(get_state_flags());
+
+        cr->rectangle(0.5, top + 0.5, width - 1, markHeight - 1);
+        cr->set_source_rgba(color.get_red(), color.get_green(), color.get_blue(), 0.15);
+        cr->fill_preserve();
+        cr->set_source_rgba(color.get_red(), color.get_green(), color.get_blue(), 0.6);
+        cr->set_line_width(1);
+        cr->stroke();
+    }
+
+    return true;
+}
+
+bool Minimap::on_button_press_event(GdkEventButton* event)
+{
+    if (event->button != GDK_BUTTON_PRIMARY)
+        return false;
+
+    m_isDragging = true;
+    scrollTo(event->y);
+
+    return true;
+}
+
+bool Minimap::on_motion_notify_event(GdkEventMotion* event)
+{
+    if (!m_isDragging)
+        return false;
+
+    scrollTo(event->y);
+
+    return true;
+}
+
+bool Minimap::on_button_release_event(GdkEventButton* event)
+{
+    if (event->button != GDK_BUTTON_PRIMARY)
+        return false;
+
+    m_isDragging = false;
+
+    return true;
+}
+
+void Minimap::scrollTo(double y)
+{
+    if (!m_vadjustment || get_allocated_height() == 0)
+        return;
+
+    // Centered on where the pointer is
+    const double fraction = std::clamp(y / get_allocated_height(), 0.0, 1.0);
+    const double pageSize = m_vadjustment->get_page_size();
+    const double lower = m_vadjustment->get_lower();
+    const double upper = std::max(lower, m_vadjustment->get_upper() - pageSize);
+
+    m_vadjustment->set_value(std::clamp(fraction * m_vadjustment->get_upper() - pageSize / 2, lower, upper));
+}
+
+} // namespace Slicer
@@ -0,0 +1,98 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef SLICER_MINIMAP_HPP
+#define SLICER_MINIMAP_HPP
+
+#include "taskrunner.hpp"
+#include <document.hpp>
+#include <metrics.hpp>
+#include <cairomm/surface.h>
+#include <gtkmm/adjustment.h>
+#include <gtkmm/drawingarea.h>
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace Slicer {
+
+// A strip beside the view with every page of the document, top to bottom,
+// tiny, and a mark over the part the view shows. Clicking or dragging on
+// it scrolls the view there, so the view only renders what's at the
+// destination, not every screen on the way. The tiny renders are made in
+// a single pass in document order, at background priority, and kept by
+// row, so edits only render the pages that are new. With more pages than
+// the strip has pixels, each page is a band of its colors.
+class Minimap : public Gtk::DrawingArea {
+public:
+    explicit Minimap(TaskRunner& taskRunner);
+
+    Minimap(const Minimap&) = delete;
+    Minimap& operator=(const Minimap&) = delete;
+    Minimap(Minimap&&) = delete;
+    Minimap& operator=(Minimap&& src) = delete;
+
+    ~Minimap() override;
+
+    void setDocument(Document& document);
+    // The view's, which the mark follows and clicks move
+    void setScrollAdjustment(const Glib::RefPtr<Gtk::Adjustment>& adjustment);
+
+    // Shorter documents are quick enough to scroll through
+    static constexpr unsigned int minimumNumberOfPages = 50;
+    static constexpr int thumbnailSize = 24;
+    static constexpr int stripWidth = 32;
+    // Of the strip the pages are drawn into once, before it's scaled to the widget
+    static constexpr int maximumStripHeight = 4096;
+    static constexpr unsigned int batchSize = 64;
+
+protected:
+    bool on_draw(const Cairo::RefPtr<Cairo::Context>& cr) override;
+    bool on_button_press_event(GdkEventButton* event) override;
+    bool on_motion_notify_event(GdkEventMotion* event) override;
+    bool on_button_release_event(GdkEventButton* event) override;
+
+private:
+    TaskRunner& m_taskRunner;
+    Document* m_document = nullptr;
+    std::vector<sigc::connection> m_documentConnections;
+    Glib::RefPtr<Gtk::Adjustment> m_vadjustment;
+    std::vector<sigc::connection> m_adjustmentConnections;
+
+    std::unordered_map<PageListModel::Key, Cairo::RefPtr<Cairo::ImageSurface>> m_thumbnails;
+    Metrics::MemoryCharge m_thumbnailsCharge{Metrics::Memory::WidgetThumbnails};
+    // Every page drawn in its band, to be scaled to the widget
+    Cairo::RefPtr<Cairo::ImageSurface> m_strip;
+    sigc::connection m_recomposeConnection;
+    // Moving it on cancels the pass on its way
+    std::shared_ptr<std::atomic_uint> m_generation = std::make_shared<std::atomic_uint>(0);
+    bool m_isDragging = false;
+
+    void queueRecompose();
+    void recompose();
+    void drawBand(const Cairo::RefPtr<Cairo::Context>& cr,
+                  unsigned int index,
+                  const Cairo::RefPtr<Cairo::ImageSurface>& thumbnail) const;
+    // From the first page at or after index that has no thumbnail yet
+    void renderBatch(unsigned int index);
+    void scrollTo(double y);
+    void cancelPass();
+};
+
+} // namespace Slicer
+
+#endif // SLICER_MINIMAP_HPP
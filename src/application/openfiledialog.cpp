@@ -21,16 +21,27 @@
 namespace Slicer {
 
 OpenFileDialog::OpenFileDialog(Gtk::Window& parent,
+                               TaskRunner& taskRunner,
+                               SharedThumbnails& thumbnails,
                                std::optional<std::string> folderPath)
-    : Gtk::FileChooserNative{_("Open document"),
-                             parent,
-                             Gtk::FILE_CHOOSER_ACTION_OPEN,
-                             _("Open"),
-                             _("Cancel")}
+    : Gtk::FileChooserDialog{parent, _("Open document"), Gtk::FILE_CHOOSER_ACTION_OPEN}
+    , m_preview{taskRunner, thumbnails}
 {
     set_select_multiple(false);
+    // Remote files are fetched as they are read, see RemoteFile
+    set_local_only(false);
     add_filter(pdfFilter());
 
+    add_button(_("Cancel"), Gtk::RESPONSE_CANCEL);
+    add_button(_("Open"), Gtk::RESPONSE_ACCEPT);
+    set_default_response(Gtk::RESPONSE_ACCEPT);
+
+    m_preview.show();
+    set_preview_widget(m_preview);
+    signal_update_preview().connect([this]() {
+        set_preview_widget_active(m_preview.showFile(get_preview_file()));
+    });
+
     if (folderPath.has_value())
         set_current_folder(folderPath.value());
 }
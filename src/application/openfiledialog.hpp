@@ -17,15 +17,22 @@
 #ifndef OPENFILEDIALOG_H
 #define OPENFILEDIALOG_H
 
-#include <gtkmm/filechoosernative.h>
+#include "filepreview.hpp"
+#include <gtkmm/filechooserdialog.h>
 #include <optional>
 
 namespace Slicer {
 
-class OpenFileDialog : public Gtk::FileChooserNative {
+// Not a native chooser, which can't show the preview of the file picked
+class OpenFileDialog : public Gtk::FileChooserDialog {
 public:
     OpenFileDialog(Gtk::Window& parent,
+                   TaskRunner& taskRunner,
+                   SharedThumbnails& thumbnails,
                    std::optional<std::string> folderPath = {});
+
+private:
+    FilePreview m_preview;
 };
 
 } // namespace Slicer
@@ -0,0 +1,192 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "pageinspector.hpp"
+#include <blankpages.hpp>
+#include <pagehash.hpp>
+#include <pagerenderer.hpp>
+#include <trace.hpp>
+#include <algorithm>
+#include <optional>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+namespace Slicer {
+
+PageInspector::PageInspector(TaskRunner& taskRunner, SharedThumbnails& thumbnails)
+    : m_taskRunner{taskRunner}
+    , m_thumbnails{thumbnails}
+{
+}
+
+PageInspector::~PageInspector()
+{
+    cancel();
+}
+
+void PageInspector::cancel()
+{
+    ++*m_generation;
+    m_taskRunner.dropCanceledTasks();
+    m_numberOfPendingBatches = 0;
+    m_onFinished = nullptr;
+}
+
+void PageInspector::inspect(const Document& document, int thumbnailSize, const std::function<void()>& onFinished)
+{
+    cancel();
+
+    struct Job {
+        Glib::RefPtr<const Page> page;
+        // Null if the page has to be rendered
+        Glib::RefPtr<const Gdk::Pixbuf> thumbnail;
+        // What the thumbnail is turned by
+        int rotation;
+    };
+    std::vector<Job> jobs;
+    std::set<InspectionKey> queued;
+
+    for (unsigned int i = 0; i < document.numberOfPages(); ++i) {
+        const InspectionKey key = keyOf(document.pages()->rowAt(i));
+
+        // A file added twice has its pages twice in the document. Pages
+        // already inspected aren't even made.
+        if (m_inspections.count(key) != 0 || !queued.insert(key).second)
+            continue;
+
+        const Glib::RefPtr<const Page> page = document.getPage(i);
+
+        jobs.push_back({page,
+                        m_thumbnails.cache().find(ThumbnailCache::keyFor(*page.get(), thumbnailSize)),
+                        page->currentRotation()});
+    }
+
+    if (jobs.empty()) {
+        onFinished();
+        return;
+    }
+
+    m_onFinished = onFinished;
+
+    for (std::size_t first = 0; first < jobs.size(); first += pagesPerTask) {
+        const std::size_t last = std::min(first + pagesPerTask, jobs.size());
+        auto batch = std::make_shared<std::vector<Job>>(jobs.begin() + static_cast<std::ptrdiff_t>(first),
+                                                        jobs.begin() + static_cast<std::ptrdiff_t>(last));
+        auto inspections = std::make_shared<std::vector<std::optional<Inspection>>>(batch->size());
+
+        auto funcExecute = [batch, inspections]() {
+            const Trace::Span span{"PageInspector batch"};
+
+            for (std::size_t i = 0; i < batch->size(); ++i) {
+                const Job& job = batch->at(i);
+                Glib::RefPtr<const Gdk::Pixbuf> thumbnail = job.thumbnail;
+
+                try {
+                    // Scans often carry thumbnails of their own, which take no rasterizing
+                    if (!thumbnail)
+                        thumbnail = PageRenderer{job.page}.renderEmbeddedThumbnail(renderSize).thumbnail;
+                    if (!thumbnail)
+                        thumbnail = PageRenderer{job.page}.render(renderSize);
+                }
+                catch (const std::runtime_error&) {
+                    // The file went away; the page is looked at again the next time
+                    continue;
+                }
+
+                // Hashed upright, so that a page and a turned copy of it look the same.
+                // Gdk measures rotations counterclockwise, so this undoes a clockwise turn.
+                const Glib::RefPtr<const Gdk::Pixbuf> unrotated = job.rotation == 0
+                                                                      ? thumbnail
+                                                                      : thumbnail->rotate_simple(static_cast<Gdk::PixbufRotation>(job.rotation));
+
+                inspections->at(i) = Inspection{BlankPages::isBlank(thumbnail), PageHash::differenceHash(unrotated)};
+            }
+        };
+
+        auto funcPostExecute = [this, batch, inspections]() {
+            for (std::size_t i = 0; i < batch->size(); ++i) {
+                const Glib::RefPtr<const Page>& page = batch->at(i).page;
+
+                if (inspections->at(i).has_value())
+                    m_inspections[keyOf(*page.get())] = *inspections->at(i);
+            }
+
+            if (--m_numberOfPendingBatches == 0) {
+                const std::function<void()> onFinished = std::move(m_onFinished);
+                m_onFinished = nullptr;
+                onFinished();
+            }
+        };
+
+        auto task = std::make_shared<Task>(funcExecute, funcPostExecute);
+        task->setGeneration(m_generation);
+        // Someone is waiting for the answer, but not more than for the pages on screen
+        m_taskRunner.queue(task, TaskRunner::Priority::Visible);
+        ++m_numberOfPendingBatches;
+    }
+}
+
+PageInspector::InspectionKey PageInspector::keyOf(const PageListModel::Row& page)
+{
+    const SourceFile::Origin& origin = page.origin();
+
+    return {page.fileHash(), origin.size, origin.modificationTime, page.indexInFile()};
+}
+
+PageInspector::InspectionKey PageInspector::keyOf(const Page& page)
+{
+    const SourceFile::Origin& origin = page.sourceFile().origin();
+
+    return {page.fileHash(), origin.size, origin.modificationTime, page.indexInFile()};
+}
+
+SelectionModel PageInspector::blankPages(const Document& document) const
+{
+    std::vector<unsigned int> indexes;
+
+    for (unsigned int i = 0; i < document.numberOfPages(); ++i) {
+        if (const auto it = m_inspections.find(keyOf(document.pages()->rowAt(i)));
+            it != m_inspections.end() && it->second.isBlank)
+            indexes.push_back(i);
+    }
+
+    SelectionModel selection{document.numberOfPages()};
+    selection.selectOnly(indexes);
+
+    return selection;
+}
+
+SelectionModel PageInspector::duplicatePages(const Document& document) const
+{
+    std::vector<std::optional<std::uint64_t>> hashes;
+    hashes.reserve(document.numberOfPages());
+
+    // Read by row: pages made for this alone would be gone, hashes and all, right after
+    for (unsigned int i = 0; i < document.numberOfPages(); ++i) {
+        const auto it = m_inspections.find(keyOf(document.pages()->rowAt(i)));
+
+        hashes.push_back(it != m_inspections.end() ? it->second.perceptualHash : std::nullopt);
+    }
+
+    SelectionModel selection{document.numberOfPages()};
+    selection.selectOnly(PageHash::findDuplicates(hashes));
+
+    return selection;
+}
+
+} // namespace Slicer
@@ -0,0 +1,92 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef SLICER_PAGEINSPECTOR_HPP
+#define SLICER_PAGEINSPECTOR_HPP
+
+#include "sharedthumbnails.hpp"
+#include "taskrunner.hpp"
+#include <document.hpp>
+#include <selectionmodel.hpp>
+#include <functional>
+#include <map>
+#include <optional>
+#include <cstdint>
+#include <string>
+#include <tuple>
+
+namespace Slicer {
+
+// Looks at the pages of a window to find those that look blank, such as
+// the separator pages of a scan (see BlankPages), and those that look like
+// another (see PageHash). Cached thumbnails are looked at as they are; the
+// other pages are rendered small on the workers, a batch per task. What
+// each page turned out to be is kept, so asking again is quick.
+// Main thread only.
+class PageInspector {
+public:
+    PageInspector(TaskRunner& taskRunner, SharedThumbnails& thumbnails);
+
+    PageInspector(const PageInspector&) = delete;
+    PageInspector& operator=(const PageInspector&) = delete;
+    PageInspector(PageInspector&&) = delete;
+    PageInspector& operator=(PageInspector&& src) = delete;
+
+    ~PageInspector();
+
+    // Looks at the pages of document not looked at yet, preferring the
+    // thumbnails cached at thumbnailSize, and calls onFinished once they're
+    // done. Asking again before then replaces the previous request.
+    void inspect(const Document& document, int thumbnailSize, const std::function<void()>& onFinished);
+    void cancel();
+    bool isInspecting() const { return m_numberOfPendingBatches > 0; }
+
+    // A selection for document of the pages found blank so far
+    SelectionModel blankPages(const Document& document) const;
+    // A selection for document of the pages that look like one before them,
+    // so that removing it keeps one of each. Fills in the perceptual hash of
+    // the pages of document along the way.
+    SelectionModel duplicatePages(const Document& document) const;
+
+    static constexpr unsigned int pagesPerTask = 32;
+    // Enough to tell a few lines of text from paper, and cheap to render
+    static constexpr int renderSize = 100;
+
+private:
+    struct Inspection {
+        bool isBlank = false;
+        std::optional<std::uint64_t> perceptualHash;
+    };
+
+    // By file contents and page within the file, like the thumbnails: the
+    // content hash, the size and modification time of the source, and the page
+    using InspectionKey = std::tuple<std::string, std::uint64_t, std::uint64_t, unsigned int>;
+
+    static InspectionKey keyOf(const PageListModel::Row& page);
+    static InspectionKey keyOf(const Page& page);
+
+    TaskRunner& m_taskRunner;
+    SharedThumbnails& m_thumbnails;
+    std::map<InspectionKey, Inspection> m_inspections;
+    unsigned int m_numberOfPendingBatches = 0;
+    std::function<void()> m_onFinished;
+    std::shared_ptr<std::atomic_uint> m_generation = std::make_shared<std::atomic_uint>(0);
+};
+
+} // namespace Slicer
+
+#endif // SLICER_PAGEINSPECTOR_HPP
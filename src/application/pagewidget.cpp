@@ -15,7 +15,8 @@
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "pagewidget.hpp"
-#include <pagerenderer.hpp>
+#include <cairomm/context.h>
+#include <gdkmm/general.h>
 
 namespace Slicer {
 
@@ -27,9 +28,23 @@ PageWidget::PageWidget(const Glib::RefPtr<const Page>& page,
     setupWidgets();
 }
 
+void PageWidget::setPage(const Glib::RefPtr<const Page>& page)
+{
+    if (m_page == page)
+        return;
+
+    m_page = page;
+    showSpinner();
+    changeSize(m_targetSize);
+}
+
 void PageWidget::changeSize(int targetSize)
 {
+    // Whatever is queued was rendered for the old size
+    cancelRendering();
+
     m_targetSize = targetSize;
+    m_thumbnailState = ThumbnailState::Outdated;
 
     const Page::Size pageSize = m_page->scaledRotatedSize(m_targetSize);
     set_size_request(pageSize.width, pageSize.height);
@@ -51,11 +66,12 @@ void PageWidget::setupWidgets()
     pack_start(m_spinner, false, true);
 
     show_all();
-}
 
-void PageWidget::renderPage()
-{
-    m_thumbnail.set(PageRenderer{m_page}.render(m_targetSize));
+    // What was set before there was a window to make the surface like
+    signal_realize().connect([this]() {
+        if (isThumbnailVisible() && m_unscaledThumbnail)
+            setThumbnail(m_unscaledThumbnail, m_thumbnailSize);
+    });
 }
 
 void PageWidget::showSpinner()
@@ -65,9 +81,49 @@ void PageWidget::showSpinner()
         m_spinner.start();
         remove(m_thumbnail);
     }
+
+    m_renderedSize = 0;
+    m_unscaledThumbnail.reset();
+    m_windowSurface.clear();
+    m_thumbnailCharge.set(0);
+}
+
+void PageWidget::showPage(const Glib::RefPtr<Gdk::Pixbuf>& thumbnail)
+{
+    setThumbnail(thumbnail, {thumbnail->get_width(), thumbnail->get_height()});
+    showThumbnail();
+    m_renderedSize = m_targetSize;
+    m_unscaledThumbnail = thumbnail;
+}
+
+void PageWidget::showPage(const Cairo::RefPtr<Cairo::Surface>& thumbnail)
+{
+    m_thumbnail.set(thumbnail);
+    showThumbnail();
+    m_renderedSize = m_targetSize;
+    m_unscaledThumbnail.reset();
+    m_windowSurface.clear();
+
+    cairo_surface_t* surface = thumbnail->cobj();
+    if (cairo_surface_get_type(surface) == CAIRO_SURFACE_TYPE_IMAGE)
+        m_thumbnailCharge.set(static_cast<std::size_t>(cairo_image_surface_get_stride(surface))
+                              * static_cast<std::size_t>(cairo_image_surface_get_height(surface)));
+    else
+        m_thumbnailCharge.set(0);
 }
 
-void PageWidget::showPage()
+void PageWidget::showPlaceholder(const Glib::RefPtr<Gdk::Pixbuf>& thumbnail)
+{
+    const ThumbnailState state = m_thumbnailState;
+
+    setThumbnail(thumbnail, m_page->scaledRotatedSize(m_targetSize));
+    showThumbnail();
+    m_thumbnailState = state;
+    m_renderedSize = 0;
+    m_unscaledThumbnail = thumbnail;
+}
+
+void PageWidget::showThumbnail()
 {
     if (!isThumbnailVisible()) {
         m_spinner.stop();
@@ -75,17 +131,112 @@ void PageWidget::showPage()
         m_thumbnail.show();
         m_spinner.hide();
     }
+
+    m_thumbnailState = ThumbnailState::UpToDate;
+}
+
+void PageWidget::showScaledThumbnail()
+{
+    if (!isThumbnailVisible() || !m_unscaledThumbnail) {
+        showSpinner();
+        return;
+    }
+
+    const Page::Size pageSize = m_page->scaledRotatedSize(m_targetSize);
+
+    if (m_windowSurface)
+        stretchWindowSurface(pageSize);
+    else
+        setThumbnail(m_unscaledThumbnail, pageSize);
+}
+
+void PageWidget::setThumbnail(const Glib::RefPtr<Gdk::Pixbuf>& thumbnail, const Page::Size& size)
+{
+    const bool isStretched = thumbnail->get_width() != size.width || thumbnail->get_height() != size.height;
+    Glib::RefPtr<Gdk::Window> window = get_window();
+    m_thumbnailSize = size;
+
+    if (!window) {
+        if (isStretched) {
+            Glib::RefPtr<Gdk::Pixbuf> stretched = thumbnail->scale_simple(size.width, size.height, Gdk::INTERP_BILINEAR);
+            m_thumbnail.set(stretched);
+            m_thumbnailCharge.set(static_cast<std::size_t>(stretched->get_rowstride())
+                                  * static_cast<std::size_t>(stretched->get_height()));
+        }
+        else {
+            m_thumbnail.set(thumbnail);
+            m_thumbnailCharge.set(0);
+        }
+
+        return;
+    }
+
+    Cairo::RefPtr<Cairo::Surface> surface = window->create_similar_surface(Cairo::CONTENT_COLOR_ALPHA,
+                                                                           size.width,
+                                                                           size.height);
+    auto cr = Cairo::Context::create(surface);
+
+    if (isStretched)
+        cr->scale(static_cast<double>(size.width) / thumbnail->get_width(),
+                  static_cast<double>(size.height) / thumbnail->get_height());
+
+    Gdk::Cairo::set_source_pixbuf(cr, thumbnail, 0, 0);
+    cr->paint();
+
+    m_thumbnail.set(surface);
+    m_windowSurface = surface;
+
+    // The window's scale factor, for HiDPI screens
+    double scaleY = 1.0;
+    cairo_surface_get_device_scale(surface->cobj(), &m_windowDeviceScale, &scaleY);
+
+    // Four bytes a pixel, wherever the window keeps them
+    m_thumbnailCharge.set(static_cast<std::size_t>(static_cast<double>(size.width) * size.height * 4
+                                                   * m_windowDeviceScale * scaleY));
+}
+
+void PageWidget::stretchWindowSurface(const Page::Size& size)
+{
+    // Pages keep their aspect, so the width is enough to go by
+    const double scale = m_windowDeviceScale * m_thumbnailSize.width / size.width;
+    cairo_surface_set_device_scale(m_windowSurface->cobj(), scale, scale);
+
+    // Set again for the image to take the new size
+    m_thumbnail.set(m_windowSurface);
+}
+
+void PageWidget::releaseThumbnail()
+{
+    cancelRendering();
+    showSpinner();
+    m_thumbnail.clear();
+    m_thumbnailState = ThumbnailState::Outdated;
+}
+
+void PageWidget::keepScaledThumbnail()
+{
+    if (m_renderedSize != 0 && m_thumbnailState == ThumbnailState::Outdated)
+        m_thumbnailState = ThumbnailState::UpToDate;
 }
 
 void PageWidget::setRenderingTask(const std::weak_ptr<Task>& task)
 {
     m_renderingTask = task;
+    m_thumbnailState = ThumbnailState::Queued;
 }
 
 void PageWidget::cancelRendering()
 {
     if (auto task = m_renderingTask.lock(); task != nullptr)
         task->cancel();
+
+    if (m_thumbnailState == ThumbnailState::Queued)
+        m_thumbnailState = ThumbnailState::Outdated;
+}
+
+bool PageWidget::isRenderingNeeded() const
+{
+    return m_thumbnailState == ThumbnailState::Outdated;
 }
 
 const Glib::RefPtr<const Page>& PageWidget::page() const
@@ -93,9 +244,14 @@ const Glib::RefPtr<const Page>& PageWidget::page() const
     return m_page;
 }
 
-bool PageWidget::isThumbnailVisible()
+bool PageWidget::isThumbnailVisible() const
 {
     return m_thumbnail.get_parent() != nullptr;
 }
 
+bool PageWidget::isUpToDate() const
+{
+    return m_thumbnailState == ThumbnailState::UpToDate && m_renderedSize != 0;
+}
+
 } // namespace Slicer
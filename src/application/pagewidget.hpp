@@ -18,6 +18,7 @@
 #define VIEWCHILD_HPP
 
 #include "task.hpp"
+#include <metrics.hpp>
 #include <page.hpp>
 #include <gtkmm/box.h>
 #include <gtkmm/image.h>
@@ -37,25 +38,69 @@ public:
 
     ~PageWidget() override = default;
 
+    void setPage(const Glib::RefPtr<const Page>& page);
     void changeSize(int targetSize);
-    void renderPage();
     void showSpinner();
-    void showPage();
+    void showPage(const Glib::RefPtr<Gdk::Pixbuf>& thumbnail);
+    void showPage(const Cairo::RefPtr<Cairo::Surface>& thumbnail);
+    // Shows a stand-in while the real thumbnail is still being rendered,
+    // stretched to the current size if it's of another one
+    void showPlaceholder(const Glib::RefPtr<Gdk::Pixbuf>& thumbnail);
+    // Stretches the thumbnail on screen to the current size, as a stand-in
+    // until a proper render arrives. Shows the spinner if there's nothing to stretch.
+    void showScaledThumbnail();
+    // Frees the thumbnail, going back to the spinner until the next render
+    void releaseThumbnail();
+    // Takes the stretched thumbnail on screen as good enough for the current size
+    void keepScaledThumbnail();
     void setRenderingTask(const std::weak_ptr<Task>& task);
     void cancelRendering();
+    bool isRenderingNeeded() const;
+    // Whether there's anything on screen but the spinner, stretched or a placeholder included
+    bool isThumbnailVisible() const;
+    // Whether what's on screen is a render for the current size, or close enough to keep
+    bool isUpToDate() const;
 
     const Glib::RefPtr<const Page>& page() const;
+    int targetSize() const { return m_targetSize; }
+    // The size the thumbnail on screen was rendered for, zero for none or a placeholder
+    int renderedSize() const { return m_renderedSize; }
 
 private:
+    enum class ThumbnailState {
+        Outdated,
+        Queued,
+        UpToDate
+    };
+
     Glib::RefPtr<const Page> m_page;
     int m_targetSize;
+    int m_renderedSize = 0;
+    // What's on screen before any stretching, so that stretching it again
+    // at every step while zooming doesn't blur it more each time
+    Glib::RefPtr<Gdk::Pixbuf> m_unscaledThumbnail;
+    // The size it's stretched to on screen
+    Page::Size m_thumbnailSize{0, 0};
+    // What setThumbnail() made of it, if the widget had a window. Zooming
+    // only changes its device scale, so nothing is drawn or sent again
+    // until the next render arrives.
+    Cairo::RefPtr<Cairo::Surface> m_windowSurface;
+    double m_windowDeviceScale = 1.0;
+    // The pixels of what's on screen that the widget holds on its own, not shared with the cache
+    Metrics::MemoryCharge m_thumbnailCharge{Metrics::Memory::WidgetThumbnails};
     std::weak_ptr<Task> m_renderingTask;
+    ThumbnailState m_thumbnailState = ThumbnailState::Outdated;
 
     Gtk::Spinner m_spinner;
     Gtk::Image m_thumbnail;
 
     void setupWidgets();
-    bool isThumbnailVisible();
+    void showThumbnail();
+    // Sets the thumbnail stretched to size, in a surface like the window's
+    // once the widget has one: drawing it then needs no upload of its
+    // pixels at every redraw, which on X11 stay on the server
+    void setThumbnail(const Glib::RefPtr<Gdk::Pixbuf>& thumbnail, const Page::Size& size);
+    void stretchWindowSurface(const Page::Size& size);
 };
 
 } // namespace Slicer
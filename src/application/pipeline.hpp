@@ -0,0 +1,146 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef SLICER_PIPELINE_HPP
+#define SLICER_PIPELINE_HPP
+
+#include "task.hpp"
+#include "taskrunner.hpp"
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Slicer {
+
+// A chain of stages that hop between the workers and the main thread,
+// written in the order they happen instead of as tasks queued from inside
+// each other's callbacks. Every stage works on the same State, which is
+// only ever touched by one stage at a time. A stage that returns false
+// ends the pipeline there, and moving the generation on cancels it
+// between any two stages. Started from the main thread.
+//
+//     Pipeline<Lookup>{taskRunner, TaskRunner::Priority::Interactive, generation}
+//         .onWorker([](Lookup& lookup) { ... })
+//         .onMainThread([this](Lookup& lookup) { ... })
+//         .start();
+template<typename State>
+class Pipeline {
+public:
+    Pipeline(TaskRunner& taskRunner, TaskRunner::Priority priority, Task::GenerationCounter generation = {})
+        : m_taskRunner{taskRunner}
+        , m_priority{priority}
+        , m_generation{std::move(generation)}
+    {
+    }
+
+    template<typename Function>
+    Pipeline& onWorker(Function&& stage)
+    {
+        m_steps.push_back({toStage(std::forward<Function>(stage)), true});
+        return *this;
+    }
+
+    template<typename Function>
+    Pipeline& onMainThread(Function&& stage)
+    {
+        m_steps.push_back({toStage(std::forward<Function>(stage)), false});
+        return *this;
+    }
+
+    // The stages up to the first worker one run right away
+    void start(State state = {})
+    {
+        auto run = std::make_shared<Run>(Run{m_taskRunner, m_priority, m_generation, m_steps, std::move(state)});
+        advance(run);
+    }
+
+private:
+    using Stage = std::function<bool(State&)>;
+
+    struct Step {
+        Stage stage;
+        bool onWorker;
+    };
+
+    struct Run {
+        TaskRunner& taskRunner;
+        TaskRunner::Priority priority;
+        Task::GenerationCounter generation;
+        std::vector<Step> steps;
+        State state;
+        unsigned int startGeneration = generation != nullptr ? generation->load() : 0;
+        std::size_t next = 0;
+        bool keepsGoing = true;
+
+        [[nodiscard]] bool isCanceled() const
+        {
+            return generation != nullptr && *generation != startGeneration;
+        }
+    };
+
+    TaskRunner& m_taskRunner;
+    TaskRunner::Priority m_priority;
+    Task::GenerationCounter m_generation;
+    std::vector<Step> m_steps;
+
+    template<typename Function>
+    static Stage toStage(Function&& stage)
+    {
+        if constexpr (std::is_same_v<std::invoke_result_t<Function&, State&>, bool>)
+            return std::forward<Function>(stage);
+        else
+            return [stage = std::forward<Function>(stage)](State& state) mutable {
+                stage(state);
+                return true;
+            };
+    }
+
+    // Runs the main thread stages in a row, then hands the next worker one
+    // to a task, whose delivery comes back here. The main thread stages
+    // after it run in that same delivery, so each pair costs a single hop.
+    static void advance(const std::shared_ptr<Run>& run)
+    {
+        // A stage may well have canceled its own pipeline
+        while (run->next < run->steps.size() && !run->steps.at(run->next).onWorker) {
+            if (run->isCanceled() || !run->steps.at(run->next++).stage(run->state))
+                return;
+        }
+
+        if (run->next == run->steps.size() || run->isCanceled())
+            return;
+
+        auto task = std::make_shared<Task>(
+            [run]() {
+                run->keepsGoing = run->steps.at(run->next).stage(run->state);
+            },
+            [run]() {
+                ++run->next;
+                if (run->keepsGoing)
+                    advance(run);
+            });
+
+        if (run->generation != nullptr)
+            task->setGeneration(run->generation);
+
+        run->taskRunner.queue(task, run->priority);
+    }
+};
+
+} // namespace Slicer
+
+#endif // SLICER_PIPELINE_HPP
@@ -30,6 +30,20 @@ PreviewHeaderBar::PreviewHeaderBar()
 
 void PreviewHeaderBar::setupWidgets()
 {
+    m_buttonPreviousPage.set_image_from_icon_name("go-previous-symbolic");
+    m_buttonPreviousPage.set_tooltip_text(_("Previous page"));
+    gtk_actionable_set_action_name(GTK_ACTIONABLE(m_buttonPreviousPage.gobj()), "preview.previous-page"); // NOLINT
+
+    m_buttonNextPage.set_image_from_icon_name("go-next-symbolic");
+    m_buttonNextPage.set_tooltip_text(_("Next page"));
+    gtk_actionable_set_action_name(GTK_ACTIONABLE(m_buttonNextPage.gobj()), "preview.next-page"); // NOLINT
+
+    auto navigationBox = Gtk::manage(new Gtk::Box); //NOLINT
+    navigationBox->get_style_context()->add_class("linked");
+    navigationBox->pack_start(m_buttonPreviousPage);
+    navigationBox->pack_start(m_buttonNextPage);
+    pack_start(*navigationBox);
+
     m_buttonZoomOut.set_image_from_icon_name("zoom-out-symbolic");
     m_buttonZoomOut.set_tooltip_text(_("Zoom out"));
     gtk_actionable_set_action_name(GTK_ACTIONABLE(m_buttonZoomOut.gobj()), "preview.zoom-out"); // NOLINT
@@ -26,6 +26,8 @@ public:
     PreviewHeaderBar();
 
 private:
+    Gtk::Button m_buttonPreviousPage;
+    Gtk::Button m_buttonNextPage;
     Gtk::Button m_buttonZoomOut;
     Gtk::Button m_buttonZoomIn;
 
@@ -18,6 +18,7 @@
 #include <gtkmm/cssprovider.h>
 #include <glibmm/i18n.h>
 #include <fmt/format.h>
+#include <algorithm>
 
 using namespace fmt::literals;
 
@@ -25,31 +26,140 @@ namespace Slicer {
 
 const std::vector<int> PreviewWindow::zoomLevels = {1000, 1400, 1800, 2200, 2600};
 
-PreviewWindow::PreviewWindow(const Glib::RefPtr<const Page>& page, TaskRunner& taskRunner)
-    : m_page{page}
-    , m_taskRunner{taskRunner}
+PreviewWindow::PreviewWindow(TaskRunner& taskRunner)
+    : m_taskRunner{taskRunner}
     , m_actionGroup{Gio::SimpleActionGroup::create()}
     , m_zoomLevel{zoomLevels, *(m_actionGroup.operator->())}
 {
-    m_pageWidget = std::make_shared<PageWidget>(m_page, m_zoomLevel.currentLevel());
-
 	set_size_request(400, 400);
 	set_default_size(900, 600);
 
 	insert_action_group("preview", m_actionGroup);
 
-    setTitle();
 	setupWidgets();
 	setupSignalHandlers();
+    addNavigationActions();
 	loadCustomCSS();
-	renderPage();
 
     show_all_children();
 }
 
 PreviewWindow::~PreviewWindow()
 {
-    m_pageWidget->cancelRendering();
+    clearPageViews();
+}
+
+void PreviewWindow::showPage(const Document& document, const Glib::RefPtr<const Page>& page)
+{
+    if (m_document != &document)
+        clearPageViews();
+
+    m_document = &document;
+    m_page = page;
+
+    if (const std::optional<unsigned int> index = pageIndex(); index.has_value())
+        updatePageViews(index.value());
+}
+
+void PreviewWindow::onPagesChanged()
+{
+    if (!get_visible())
+        return;
+
+    const std::optional<unsigned int> index = pageIndex();
+
+    if (!index.has_value()) {
+        hide();
+        return;
+    }
+
+    // The neighbours may not be the same anymore
+    updatePageViews(index.value());
+}
+
+void PreviewWindow::onPagesRotated()
+{
+    if (!get_visible())
+        return;
+
+    // Every size changes with a rotation, and so do all the tiles
+    clearPageViews();
+    onPagesChanged();
+}
+
+std::optional<unsigned int> PreviewWindow::pageIndex() const
+{
+    if (m_document == nullptr || !m_page)
+        return std::nullopt;
+
+    const unsigned int index = m_page->getDocumentIndex();
+
+    if (index >= m_document->numberOfPages() || m_document->getPage(index) != m_page)
+        return std::nullopt;
+
+    return index;
+}
+
+void PreviewWindow::showPageAt(unsigned int index)
+{
+    m_page = m_document->getPage(index);
+    updatePageViews(index);
+}
+
+void PreviewWindow::updatePageViews(unsigned int index)
+{
+    const unsigned int first = index > 0 ? index - 1 : index;
+    const unsigned int last = std::min(index + 1, m_document->numberOfPages() - 1);
+
+    std::map<const Page*, std::unique_ptr<TiledPageView>> pageViews;
+
+    for (unsigned int i = first; i <= last; ++i) {
+        const Glib::RefPtr<const Page> page = m_document->getPage(i);
+
+        if (auto it = m_pageViews.find(page.get()); it != m_pageViews.end()) {
+            pageViews.emplace(page.get(), std::move(it->second));
+            m_pageViews.erase(it);
+        }
+        else {
+            pageViews.emplace(page.get(),
+                              std::make_unique<TiledPageView>(page, m_taskRunner, m_zoomLevel.currentLevel()));
+        }
+    }
+
+    TiledPageView* pageView = pageViews.at(m_page.get()).get();
+
+    if (pageView != m_pageView) {
+        if (m_pageView != nullptr)
+            m_eventBox.remove();
+
+        m_pageView = pageView;
+        m_eventBox.add(*m_pageView);
+        m_pageView->show();
+
+        // A new page is shown from its top left, which is what the neighbours have ready
+        m_scroller.get_hadjustment()->set_value(0);
+        m_scroller.get_vadjustment()->set_value(0);
+    }
+
+    // Those that aren't neighbours anymore cancel their renders on the way out
+    m_pageViews = std::move(pageViews);
+
+    for (auto& [page, view] : m_pageViews) {
+        if (view.get() != m_pageView)
+            view->prefetch(m_scroller.get_allocated_width(), m_scroller.get_allocated_height());
+    }
+
+    setTitle();
+    updateNavigationActions();
+}
+
+void PreviewWindow::clearPageViews()
+{
+    if (m_pageView != nullptr)
+        m_eventBox.remove();
+
+    m_pageView = nullptr;
+    m_pageViews.clear();
 }
 
 void PreviewWindow::setTitle()
@@ -62,7 +172,6 @@ void PreviewWindow::setupWidgets()
 {
     set_titlebar(m_previewHeaderBar);
 
-    m_eventBox.add(*m_pageWidget);
     m_scroller.add(m_eventBox);
 	m_overlay.add(m_scroller);
 	add(m_overlay); // NOLINT
@@ -73,37 +182,90 @@ void PreviewWindow::setupSignalHandlers()
     m_eventBox.add_events(Gdk::SCROLL_MASK | Gdk::SMOOTH_SCROLL_MASK);
 
     m_eventBox.signal_scroll_event().connect([this](GdkEventScroll* event) {
-        if ((event->state & Gdk::CONTROL_MASK) != 0) {
-            if (event->delta_y < 0) {
-                m_actionGroup->activate_action("zoom-in");
-                return true;
-            }
-
-            if (event->delta_y > 0) {
-                m_actionGroup->activate_action("zoom-out");
-                return true;
-            }
-        }
+        if ((event->state & Gdk::CONTROL_MASK) == 0)
+            return false;
+
+        m_zoomLevel.zoomBy(ZoomLevel::scrollFactor(event));
+        return true;
+    });
+
+    m_zoomGesture = Gtk::GestureZoom::create(m_eventBox);
+    m_zoomGesture->signal_begin().connect([this](GdkEventSequence*) {
+        m_lastGestureScale = 1.0;
+    });
+    m_zoomGesture->signal_scale_changed().connect([this](double scale) {
+        if (scale <= 0 || m_lastGestureScale <= 0)
+            return;
 
-        return false;
+        m_zoomLevel.zoomBy(scale / m_lastGestureScale);
+        m_lastGestureScale = scale;
     });
 
     m_zoomLevel.enable();
 
-    m_zoomLevel.zoomLevelIndex().signal_changed().connect([this]() {
-        m_pageWidget->cancelRendering();
-        m_pageWidget->changeSize(m_zoomLevel.currentLevel());
-        m_pageWidget->showSpinner();
-        renderPage();
+    // The neighbours follow, so they're ready at the zoom they'll be shown at
+    m_zoomLevel.zoomSize().signal_changed().connect([this]() {
+        for (auto& [page, view] : m_pageViews)
+            view->changeSize(m_zoomLevel.currentLevel());
     });
 
+    // Before the scrolled window gets to use them for scrolling
+    signal_key_press_event().connect([this](GdkEventKey* event) {
+        switch (event->keyval) {
+        case GDK_KEY_Page_Up:
+        case GDK_KEY_Left:
+            m_previousPageAction->activate();
+            return true;
+        case GDK_KEY_Page_Down:
+        case GDK_KEY_Right:
+            m_nextPageAction->activate();
+            return true;
+        default:
+            return false;
+        }
+    },
+                                     false);
+
+    // Kept for the next preview, without what it had rendered
 	signal_hide().connect([this]() {
-		delete this;
+		clearPageViews();
 	});
 }
 
+void PreviewWindow::addNavigationActions()
+{
+    m_previousPageAction = m_actionGroup->add_action("previous-page", [this]() {
+        if (const std::optional<unsigned int> index = pageIndex(); index.has_value() && index.value() > 0)
+            showPageAt(index.value() - 1);
+    });
+
+    m_nextPageAction = m_actionGroup->add_action("next-page", [this]() {
+        if (const std::optional<unsigned int> index = pageIndex();
+            index.has_value() && index.value() + 1 < m_document->numberOfPages())
+            showPageAt(index.value() + 1);
+    });
+
+    updateNavigationActions();
+}
+
+void PreviewWindow::updateNavigationActions()
+{
+    const std::optional<unsigned int> index = pageIndex();
+
+    m_previousPageAction->set_enabled(index.has_value() && index.value() > 0);
+    m_nextPageAction->set_enabled(index.has_value() && index.value() + 1 < m_document->numberOfPages());
+}
+
 void PreviewWindow::loadCustomCSS()
 {
+    // The provider is for the whole screen, so once is enough for every window
+    static bool isLoaded = false;
+
+    if (isLoaded)
+        return;
+
+    isLoaded = true;
+
 	auto screen = Gdk::Screen::get_default();
 	auto provider = Gtk::CssProvider::create();
 	provider->load_from_data(R"(
@@ -116,23 +278,4 @@ void PreviewWindow::loadCustomCSS()
                                                GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
 }
 
-void PreviewWindow::renderPage()
-{
-    std::weak_ptr<PageWidget> weakWidget = m_pageWidget;
-
-    auto funcExecute = [weakWidget]() {
-        if (auto widget = weakWidget.lock(); widget != nullptr)
-            widget->renderPage();
-    };
-
-    auto funcPostExecute = [weakWidget]() {
-        if (auto widget = weakWidget.lock(); widget != nullptr)
-            widget->showPage();
-    };
-
-    auto task = std::make_shared<Task>(funcExecute, funcPostExecute);
-    m_pageWidget->setRenderingTask(task);
-    m_taskRunner.queueFront(task);
-}
-
 } // namespace Slicer
@@ -17,9 +17,9 @@
 #ifndef PREVIEWWINDOW_HPP
 #define PREVIEWWINDOW_HPP
 
-#include <page.hpp>
-#include "pagewidget.hpp"
+#include <document.hpp>
 #include "taskrunner.hpp"
+#include "tiledpageview.hpp"
 #include "zoomlevelwithactions.hpp"
 #include "previewheaderbar.hpp"
 #include <glibmm/dispatcher.h>
@@ -27,17 +27,22 @@
 #include <gtkmm/box.h>
 #include <gtkmm/button.h>
 #include <gtkmm/eventbox.h>
+#include <gtkmm/gesturezoom.h>
 #include <gtkmm/image.h>
 #include <gtkmm/overlay.h>
 #include <gtkmm/scrolledwindow.h>
 #include <gtkmm/window.h>
+#include <map>
+#include <memory>
 
 namespace Slicer {
 
+// One per window, shown again for every page previewed. It steps through
+// the pages of the document, and the pages before and after the one shown
+// get rendered at the same zoom while it is looked at.
 class PreviewWindow : public Gtk::Window {
 public:
-    PreviewWindow(const Glib::RefPtr<const Page>& page,
-                  TaskRunner& taskRunner);
+    explicit PreviewWindow(TaskRunner& taskRunner);
 
     PreviewWindow(const PreviewWindow&) = delete;
     PreviewWindow& operator=(const PreviewWindow&) = delete;
@@ -46,9 +51,17 @@ public:
 
     ~PreviewWindow() override;
 
+    // page must be in document, which has to outlive the window or the next call
+    void showPage(const Document& document, const Glib::RefPtr<const Page>& page);
+    // Keeps up with pages of the document that were added, removed or
+    // moved, hiding the window if its page is gone
+    void onPagesChanged();
+    void onPagesRotated();
+
 private:
     static void loadCustomCSS();
 
+    const Document* m_document = nullptr;
     Glib::RefPtr<const Page> m_page;
     TaskRunner& m_taskRunner;
 	Glib::RefPtr<Gio::SimpleActionGroup> m_actionGroup;
@@ -58,13 +71,24 @@ private:
     Gtk::Overlay m_overlay;
     Gtk::ScrolledWindow m_scroller;
     Gtk::EventBox m_eventBox;
-    std::shared_ptr<PageWidget> m_pageWidget;
+    Glib::RefPtr<Gtk::GestureZoom> m_zoomGesture;
+    double m_lastGestureScale = 1.0;
+    // The page shown and its neighbours, all at the current zoom
+    std::map<const Page*, std::unique_ptr<TiledPageView>> m_pageViews;
+    TiledPageView* m_pageView = nullptr;
 	PreviewHeaderBar m_previewHeaderBar;
+    Glib::RefPtr<Gio::SimpleAction> m_previousPageAction;
+    Glib::RefPtr<Gio::SimpleAction> m_nextPageAction;
 
     void setTitle();
 	void setupWidgets();
 	void setupSignalHandlers();
-	void renderPage();
+    void addNavigationActions();
+    std::optional<unsigned int> pageIndex() const;
+    void showPageAt(unsigned int index);
+    void updatePageViews(unsigned int index);
+    void updateNavigationActions();
+    void clearPageViews();
 };
 
 } // namespace Slicer
@@ -0,0 +1,104 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "saveexecutor.hpp"
+#include <glibmm/main.h>
+#include <logger.hpp>
+#include <fmt/format.h>
+#include <stdexcept>
+
+namespace Slicer {
+
+SaveExecutor::~SaveExecutor()
+{
+    *m_isAlive = false;
+    cancel();
+
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+void SaveExecutor::start(Job job,
+                         const std::function<void(const PdfSaver::Progress&)>& onProgress,
+                         const std::function<void(Outcome)>& onFinished)
+{
+    if (m_isSaving)
+        throw std::logic_error("A save is already running");
+
+    // The previous save is done by now; this only cleans up its thread
+    if (m_thread.joinable())
+        m_thread.join();
+
+    m_isSaving = true;
+    m_canceled = std::make_shared<std::atomic<bool>>(false);
+
+    m_thread = std::thread{[this, job = std::move(job), onProgress, onFinished, canceled = m_canceled, isAlive = m_isAlive]() mutable {
+        const auto finish = [this, onFinished, isAlive](Outcome outcome) {
+            Glib::signal_idle().connect_once([this, onFinished, isAlive, outcome]() {
+                if (!*isAlive)
+                    return;
+
+                m_isSaving = false;
+                onFinished(outcome);
+            });
+        };
+
+        double lastReported = -progressStep;
+        PdfSaver::Monitor monitor;
+        monitor.canceled = canceled;
+        monitor.onProgress = [onProgress, isAlive, &lastReported](const PdfSaver::Progress& progress) {
+            if (progress.fraction - lastReported < progressStep && progress.stage != PdfSaver::Progress::Stage::Done)
+                return;
+
+            lastReported = progress.fraction;
+            Glib::signal_idle().connect_once([onProgress, isAlive, progress]() {
+                if (*isAlive)
+                    onProgress(progress);
+            });
+        };
+
+        try {
+            PdfSaver saver{std::move(job.saveData), job.cache, monitor};
+            saver.setWriteProfile(job.writeProfile);
+            saver.setResourceCleanup(job.resourceCleanup);
+            saver.setImageDownsampling(job.imageDownsampling);
+            saver.save(job.destinationFile);
+
+            Logger::logInfo(fmt::format("Document written with the {} profile in {:.3f} s",
+                                        PdfSaver::writeProfileName(job.writeProfile),
+                                        saver.lastWriteDuration().count()));
+            finish(Outcome::Saved);
+        }
+        catch (const PdfSaver::Canceled&) {
+            Logger::logInfo("Saving the document was canceled");
+            finish(Outcome::Canceled);
+        }
+        catch (...) {
+            Logger::logError("Saving the document failed");
+            Logger::logError("The destination file was: " + job.destinationFile->get_path());
+            finish(Outcome::Failed);
+        }
+    }};
+}
+
+void SaveExecutor::cancel()
+{
+    if (m_canceled != nullptr)
+        *m_canceled = true;
+}
+
+} // namespace Slicer
@@ -0,0 +1,81 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef SAVEEXECUTOR_HPP
+#define SAVEEXECUTOR_HPP
+
+#include <pdfsaver.hpp>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+
+namespace Slicer {
+
+// Runs the saves of a window on a thread of its own, one at a time, since
+// saves sharing a parsed file cache must not overlap. A save works on a
+// snapshot of the document taken on the main thread, so the document can
+// keep changing while it goes. Progress and the outcome come back on the main loop.
+// Destroying the executor cancels the save that's running and waits for
+// it to stop; a canceled save leaves the destination untouched.
+class SaveExecutor {
+public:
+    struct Job {
+        PdfSaver::SaveData saveData;
+        std::shared_ptr<PdfSaver::ParsedFileCache> cache;
+        Glib::RefPtr<Gio::File> destinationFile;
+        PdfSaver::WriteProfile writeProfile = PdfSaver::WriteProfile::Default;
+        PdfSaver::ResourceCleanup resourceCleanup = PdfSaver::ResourceCleanup::WhenPagesLeftOut;
+        std::optional<ImageDownsampling::Options> imageDownsampling;
+    };
+
+    enum class Outcome {
+        Saved,
+        Failed,
+        Canceled
+    };
+
+    SaveExecutor() = default;
+
+    SaveExecutor(const SaveExecutor&) = delete;
+    SaveExecutor& operator=(const SaveExecutor&) = delete;
+    SaveExecutor(SaveExecutor&&) = delete;
+    SaveExecutor& operator=(SaveExecutor&& src) = delete;
+
+    ~SaveExecutor();
+
+    // Only one save at a time: check isSaving() first
+    void start(Job job,
+               const std::function<void(const PdfSaver::Progress&)>& onProgress,
+               const std::function<void(Outcome)>& onFinished);
+    void cancel();
+    bool isSaving() const { return m_isSaving; }
+
+private:
+    std::thread m_thread;
+    bool m_isSaving = false;
+    std::shared_ptr<std::atomic<bool>> m_canceled;
+    // Lowered on destruction, so that what the thread left for the main loop is dropped
+    std::shared_ptr<bool> m_isAlive = std::make_shared<bool>(true);
+
+    // Progress is only passed on to the main loop once it moved this much
+    static constexpr double progressStep = 0.01;
+};
+
+} // namespace Slicer
+
+#endif // SAVEEXECUTOR_HPP
@@ -20,6 +20,8 @@
 
 namespace Slicer {
 
+static const Glib::ustring writeProfileChoice = "write-profile";
+
 SaveFileDialog::SaveFileDialog(Gtk::Window& parent,
                                std::optional<std::string> folderPath)
     : Gtk::FileChooserNative{_("Save document as"),
@@ -34,6 +36,26 @@ SaveFileDialog::SaveFileDialog(Gtk::Window& parent,
 
     if (folderPath.has_value())
         set_current_folder(folderPath.value());
+
+    add_choice(writeProfileChoice,
+               _("Optimize for"),
+               {PdfSaver::writeProfileName(PdfSaver::WriteProfile::Default),
+                PdfSaver::writeProfileName(PdfSaver::WriteProfile::Smallest),
+                PdfSaver::writeProfileName(PdfSaver::WriteProfile::Fastest),
+                PdfSaver::writeProfileName(PdfSaver::WriteProfile::FastWebView)},
+               {_("Balance"), _("Smallest file"), _("Fastest save"), _("Fast web view")});
+    setWriteProfile(PdfSaver::WriteProfile::Default);
+}
+
+void SaveFileDialog::setWriteProfile(PdfSaver::WriteProfile profile)
+{
+    set_choice(writeProfileChoice, PdfSaver::writeProfileName(profile));
+}
+
+PdfSaver::WriteProfile SaveFileDialog::writeProfile() const
+{
+    return PdfSaver::writeProfileFromName(get_choice(writeProfileChoice).raw())
+        .value_or(PdfSaver::WriteProfile::Default);
 }
 
 } // namespace Slicer
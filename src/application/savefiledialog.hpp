@@ -17,6 +17,7 @@
 #ifndef SAVEFILEDIALOG_HPP
 #define SAVEFILEDIALOG_HPP
 
+#include <pdfsaver.hpp>
 #include <gtkmm/filechoosernative.h>
 #include <optional>
 
@@ -26,6 +27,9 @@ class SaveFileDialog : public Gtk::FileChooserNative {
 public:
     SaveFileDialog(Gtk::Window& parent,
                    std::optional<std::string> folderPath = {});
+
+    void setWriteProfile(PdfSaver::WriteProfile profile);
+    PdfSaver::WriteProfile writeProfile() const;
 };
 
 } // namespace Slicer
@@ -16,7 +16,11 @@
 
 #include "savingrevealer.hpp"
 #include <glibmm/main.h>
+#include <glibmm/miscutils.h>
 #include <glibmm/i18n.h>
+#include <fmt/format.h>
+
+using namespace fmt::literals;
 
 namespace Slicer {
 
@@ -26,8 +30,12 @@ SavingRevealer::SavingRevealer()
     m_labelSaving.set_padding(10, -1);
     m_spinner.set_size_request(22, 22);
     m_spinner.set_margin_right(3);
+    m_cancelButton.set_image_from_icon_name("process-stop-symbolic");
+    m_cancelButton.set_tooltip_text(_("Cancel saving"));
+    m_cancelButton.get_style_context()->add_class("flat");
     m_boxSaving.pack_start(m_labelSaving);
     m_boxSaving.pack_start(m_spinner);
+    m_boxSaving.pack_start(m_cancelButton);
 
     m_labelDone.set_label(_("Document succesfully saved"));
     m_labelDone.set_padding(10, -1);
@@ -45,10 +53,26 @@ SavingRevealer::SavingRevealer()
     m_closeButton.signal_clicked().connect([this]() {
         set_reveal_child(false);
     });
+
+    m_cancelButton.signal_clicked().connect([this]() {
+        cancelClicked.emit();
+    });
 }
 
 void SavingRevealer::saving()
 {
+    showBusy(_("Saving document…"), _("Cancel saving"));
+}
+
+void SavingRevealer::exporting()
+{
+    showBusy(_("Exporting pages…"), _("Cancel exporting"));
+}
+
+void SavingRevealer::showBusy(const Glib::ustring& label, const Glib::ustring& cancelTooltip)
+{
+    m_labelSaving.set_label(label);
+    m_cancelButton.set_tooltip_text(cancelTooltip);
     m_outerFrame.remove();
     m_outerFrame.add(m_boxSaving);
     m_boxSaving.show_all();
@@ -62,8 +86,44 @@ void SavingRevealer::saving()
     set_reveal_child(true);
 }
 
+void SavingRevealer::setProgress(double fraction, std::uint64_t bytesWritten)
+{
+    const int percentage = static_cast<int>(fraction * 100);
+
+    if (bytesWritten == 0) {
+        m_labelSaving.set_label(fmt::format(_("Saving document… {percentage}%"),
+                                            "percentage"_a = percentage)); //NOLINT
+        return;
+    }
+
+    m_labelSaving.set_label(fmt::format(_("Saving document… {percentage}% ({size} written)"),
+                                        "percentage"_a = percentage, //NOLINT
+                                        "size"_a = Glib::format_size(bytesWritten).raw())); //NOLINT
+}
+
+void SavingRevealer::setExportProgress(std::size_t numberOfWrittenPages, std::size_t numberOfPages, double fraction)
+{
+    const int percentage = static_cast<int>(fraction * 100);
+
+    m_labelSaving.set_label(fmt::format(_("Exporting pages… {percentage}% ({written} of {total})"),
+                                        "percentage"_a = percentage, //NOLINT
+                                        "written"_a = numberOfWrittenPages, //NOLINT
+                                        "total"_a = numberOfPages)); //NOLINT
+}
+
 void SavingRevealer::saved()
 {
+    showDone(_("Document succesfully saved"));
+}
+
+void SavingRevealer::exported()
+{
+    showDone(_("Pages succesfully exported"));
+}
+
+void SavingRevealer::showDone(const Glib::ustring& label)
+{
+    m_labelDone.set_label(label);
     m_outerFrame.remove();
     m_outerFrame.add(m_boxDone);
     m_boxDone.show_all();
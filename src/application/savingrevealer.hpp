@@ -23,6 +23,7 @@
 #include <gtkmm/label.h>
 #include <gtkmm/revealer.h>
 #include <gtkmm/spinner.h>
+#include <cstdint>
 
 namespace Slicer {
 
@@ -31,20 +32,33 @@ public:
     SavingRevealer();
 
     void saving();
+    // Bytes written are shown once there are any
+    void setProgress(double fraction, std::uint64_t bytesWritten);
     void saved();
 
+    // The same notification, for pages written out as images
+    void exporting();
+    void setExportProgress(std::size_t numberOfWrittenPages, std::size_t numberOfPages, double fraction);
+    void exported();
+
+    sigc::signal<void> cancelClicked;
+
 private:
     Gtk::Frame m_outerFrame;
 
     Gtk::Box m_boxSaving;
     Gtk::Label m_labelSaving;
     Gtk::Spinner m_spinner;
+    Gtk::Button m_cancelButton;
 
     Gtk::Box m_boxDone;
     Gtk::Label m_labelDone;
     Gtk::Button m_closeButton;
 
     sigc::connection m_connectionSaved;
+
+    void showBusy(const Glib::ustring& label, const Glib::ustring& cancelTooltip);
+    void showDone(const Glib::ustring& label);
 };
 
 } // namespace Slicer
@@ -0,0 +1,110 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "scrollpredictor.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace Slicer {
+
+// How much each new sample weighs in the velocity, against the ones before
+static constexpr double smoothing = 0.5;
+
+void ScrollPredictor::addSample(double value, Clock::time_point time)
+{
+    const std::chrono::duration<double> elapsed = time - m_lastTime;
+
+    // Coming out of a pause, there's nothing yet to tell a scroll from a jump by
+    if (!m_hasSample || time - m_lastTime > idleTime || elapsed.count() <= 0) {
+        m_velocity = 0;
+        m_hasVelocity = false;
+    }
+    else {
+        const double instant = (value - m_lastValue) / elapsed.count();
+
+        // Turned around: what was measured before points the wrong way
+        if (!m_hasVelocity || instant * m_velocity < 0)
+            m_velocity = instant;
+        else
+            m_velocity = smoothing * instant + (1 - smoothing) * m_velocity;
+
+        m_hasVelocity = true;
+    }
+
+    m_lastValue = value;
+    m_lastTime = time;
+    m_hasSample = true;
+}
+
+void ScrollPredictor::reset()
+{
+    m_velocity = 0;
+    m_hasVelocity = false;
+    m_hasSample = false;
+}
+
+double ScrollPredictor::velocity(Clock::time_point now) const
+{
+    if (!m_hasSample || now - m_lastTime > idleTime)
+        return 0;
+
+    return m_velocity;
+}
+
+std::vector<ScrollPredictor::Span> ScrollPredictor::spans(Clock::time_point now,
+                                                          double value,
+                                                          double pageSize,
+                                                          double upper,
+                                                          double margin) const
+{
+    const double velocity = this->velocity(now);
+    const double speed = pageSize > 0 ? std::abs(velocity) / pageSize : 0;
+    const double direction = velocity < 0 ? -1 : 1;
+
+    const auto clamped = [upper](Span span) {
+        return Span{std::max(0.0, span.top), std::min(upper, span.bottom)};
+    };
+
+    if (speed < slowVelocity)
+        return {clamped({value - margin, value + pageSize + margin})};
+
+    // Reading along: the next screen ahead, and a little of what was just left behind
+    if (speed < fastVelocity) {
+        const double ahead = std::max(margin, pageSize);
+        const double behind = margin / 4;
+
+        if (direction > 0)
+            return {clamped({value - behind, value + pageSize + ahead})};
+
+        return {clamped({value - ahead, value + pageSize + behind})};
+    }
+
+    // A flick: what's on screen for now, and around where it'll come to rest
+    const double landing = std::clamp(value + velocity / kineticFriction, 0.0, std::max(0.0, upper - pageSize));
+    const Span current = clamped({value, value + pageSize});
+    const Span target = clamped({landing - margin / 2, landing + pageSize + margin / 2});
+
+    if (target.top <= current.bottom && current.top <= target.bottom)
+        return {Span{std::min(current.top, target.top), std::max(current.bottom, target.bottom)}};
+
+    if (target.top < current.top)
+        return {target, current};
+
+    return {current, target};
+}
+
+} // namespace Slicer
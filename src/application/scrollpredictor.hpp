@@ -0,0 +1,80 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef SLICER_SCROLLPREDICTOR_HPP
+#define SLICER_SCROLLPREDICTOR_HPP
+
+#include <chrono>
+#include <vector>
+
+namespace Slicer {
+
+// Follows the scroll position to tell which parts of the content are worth
+// rendering ahead of time. Standing still, the viewport and a margin around
+// it are. Scrolling slowly, the next screen in the direction of travel is,
+// and little behind. A fast flick skips what it's passing over and goes
+// for where kinetic scrolling will bring it to rest. Turning around drops
+// what was ahead before, so it stops being rendered.
+class ScrollPredictor {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // A stretch of the content, in the units of the scroll position
+    struct Span {
+        double top;
+        double bottom;
+    };
+
+    // Fed every new position, as it's scrolled to
+    void addSample(double value, Clock::time_point time);
+    // Forgets the motion so far, after a jump or a change of layout
+    void reset();
+
+    // Positive scrolling down, in units per second. Zero once it's been
+    // idleTime since the last sample.
+    double velocity(Clock::time_point now) const;
+
+    // Where to render ahead, with the viewport at value, pageSize tall in
+    // content upper tall, and margin the room asked for around it when
+    // still. The spans are sorted and don't overlap.
+    std::vector<Span> spans(Clock::time_point now,
+                            double value,
+                            double pageSize,
+                            double upper,
+                            double margin) const;
+
+    // No sample for longer than this means the scrolling has stopped
+    static constexpr std::chrono::milliseconds idleTime{150};
+    // Viewport heights per second, below which it's standing still
+    static constexpr double slowVelocity = 0.25;
+    // And above which it's a flick rather than reading along
+    static constexpr double fastVelocity = 3.0;
+    // As GtkScrolledWindow decelerates: kinetic scrolling coming to
+    // rest from a velocity v still covers v / friction
+    static constexpr double kineticFriction = 4.0;
+
+private:
+    double m_velocity = 0;
+    double m_lastValue = 0;
+    Clock::time_point m_lastTime;
+    bool m_hasVelocity = false;
+    bool m_hasSample = false;
+};
+
+} // namespace Slicer
+
+#endif // SLICER_SCROLLPREDICTOR_HPP
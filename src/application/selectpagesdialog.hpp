@@ -0,0 +1,42 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef SELECTPAGESDIALOG_HPP
+#define SELECTPAGESDIALOG_HPP
+
+#include <gtkmm/dialog.h>
+#include <gtkmm/entry.h>
+#include <gtkmm/label.h>
+
+namespace Slicer {
+
+// Asks for a page range expression, such as "1-100, 250, 400-end/3"
+class SelectPagesDialog : public Gtk::Dialog {
+public:
+    SelectPagesDialog(Gtk::Window& parentWindow);
+
+    std::string expression() const;
+    // Keeps the dialog open with the expression as typed, so it can be fixed
+    void showError(const std::string& message);
+
+private:
+    Gtk::Entry m_entry;
+    Gtk::Label m_hintLabel;
+};
+
+} // namespace Slicer
+
+#endif // SELECTPAGESDIALOG_HPP
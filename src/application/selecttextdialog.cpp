@@ -0,0 +1,60 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "selecttextdialog.hpp"
+#include <glibmm/i18n.h>
+
+namespace Slicer {
+
+SelectTextDialog::SelectTextDialog(Gtk::Window& parentWindow)
+    : Gtk::Dialog{_("Select Pages with Text"), parentWindow, true, true}
+{
+    add_button(_("Cancel"), Gtk::RESPONSE_CANCEL);
+    Gtk::Button* selectButton = add_button(_("Select"), Gtk::RESPONSE_OK);
+    selectButton->get_style_context()->add_class("suggested-action");
+    set_default_response(Gtk::RESPONSE_OK);
+
+    m_entry.set_placeholder_text(_("For example: Invoice No."));
+    m_entry.set_activates_default(true);
+    m_entry.set_width_chars(40);
+
+    m_hintLabel.set_text(_("Pages with these words, one after the other"));
+    m_hintLabel.set_xalign(0);
+    m_hintLabel.get_style_context()->add_class("dim-label");
+
+    Gtk::Box* contentArea = get_content_area();
+    contentArea->set_border_width(12);
+    contentArea->set_spacing(6);
+    contentArea->pack_start(m_entry, Gtk::PACK_SHRINK);
+    contentArea->pack_start(m_hintLabel, Gtk::PACK_SHRINK);
+
+    show_all_children();
+}
+
+std::string SelectTextDialog::text() const
+{
+    return m_entry.get_text();
+}
+
+void SelectTextDialog::showError(const std::string& message)
+{
+    m_hintLabel.set_text(message);
+    m_hintLabel.get_style_context()->remove_class("dim-label");
+    m_hintLabel.get_style_context()->add_class("error");
+    m_entry.grab_focus();
+}
+
+} // namespace Slicer
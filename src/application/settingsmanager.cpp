@@ -17,8 +17,10 @@
 #include "settingsmanager.hpp"
 #include <giomm/file.h>
 #include <glibmm/miscutils.h>
+#include <glib/gstdio.h>
 #include <config.hpp>
 #include <logger.hpp>
+#include <algorithm>
 
 namespace Slicer {
 
@@ -44,6 +46,73 @@ namespace misc {
     static const unsigned int defaultZoomLevel = 0;
 }
 
+namespace saving {
+    static const std::string groupName = "saving";
+
+    static const struct {
+        std::string writeProfile = "write-profile";
+        std::string resourceCleanup = "resource-cleanup";
+        std::string downsampleImagesDpi = "downsample-images-dpi";
+    } keys;
+
+    static const PdfSaver::WriteProfile defaultWriteProfile = PdfSaver::WriteProfile::Default;
+    static const PdfSaver::ResourceCleanup defaultResourceCleanup = PdfSaver::ResourceCleanup::WhenPagesLeftOut;
+}
+
+namespace rendering {
+    static const std::string groupName = "rendering";
+
+    static const struct {
+        std::string threads = "threads";
+        std::string prefetchMargin = "prefetch-margin";
+        std::string thumbnailCacheSize = "thumbnail-cache-mb";
+        std::string diskThumbnailCacheSize = "disk-thumbnail-cache-mb";
+        std::string memoryMappedFiles = "memory-mapped-files";
+        std::string throttleInBackground = "throttle-in-background";
+        std::string tuneThreads = "tune-threads";
+        std::string minimumThreads = "minimum-threads";
+        std::string renderProcesses = "render-processes";
+        std::string renderDaemon = "render-daemon";
+        std::string renderBudget = "render-budget-ms";
+    } keys;
+
+    static const int defaultThreads = 0;
+    static const double defaultPrefetchMargin = 1.0;
+    static const int defaultThumbnailCacheSize = 128;
+    static const int defaultDiskThumbnailCacheSize = 512;
+    static const bool defaultMemoryMappedFiles = true;
+    static const bool defaultThrottleInBackground = true;
+    static const bool defaultTuneThreads = true;
+    static const int defaultMinimumThreads = 1;
+    static const bool defaultRenderProcesses = false;
+    static const std::string defaultRenderDaemon;
+    static const int defaultRenderBudget = 2000;
+}
+
+namespace history {
+    static const std::string groupName = "history";
+
+    static const struct {
+        std::string undoSteps = "undo-steps";
+        std::string undoHistorySize = "undo-history-mb";
+    } keys;
+
+    static const int defaultUndoSteps = static_cast<int>(CommandManager::defaultMaxCommands);
+    static const int defaultUndoHistorySize = static_cast<int>(CommandManager::defaultMaxSizeInBytes / (1024 * 1024));
+}
+
+namespace background {
+    static const std::string groupName = "background";
+
+    static const struct {
+        std::string resident = "resident";
+        std::string residentMemory = "resident-memory-mb";
+    } keys;
+
+    static const bool defaultResident = false;
+    static const int defaultResidentMemory = 64;
+}
+
 SettingsManager::SettingsManager()
 {
     loadConfigFile();
@@ -106,6 +175,334 @@ void SettingsManager::saveZoomLevel(unsigned int zoomLevel)
     }
 }
 
+int SettingsManager::loadRenderThreads()
+{
+    try {
+        if (!m_keyFile.has_group(rendering::groupName)
+            || !m_keyFile.has_key(rendering::groupName, rendering::keys.threads))
+            return rendering::defaultThreads;
+
+        return std::max(0, m_keyFile.get_integer(rendering::groupName, rendering::keys.threads));
+    }
+    catch (const Glib::Error& e) {
+        Logger::logWarning("Error while loading render threads: " + e.what());
+
+        return rendering::defaultThreads;
+    }
+}
+
+double SettingsManager::loadPrefetchMargin()
+{
+    try {
+        if (!m_keyFile.has_group(rendering::groupName)
+            || !m_keyFile.has_key(rendering::groupName, rendering::keys.prefetchMargin))
+            return rendering::defaultPrefetchMargin;
+
+        return std::max(0.0, m_keyFile.get_double(rendering::groupName, rendering::keys.prefetchMargin));
+    }
+    catch (const Glib::Error& e) {
+        Logger::logWarning("Error while loading prefetch margin: " + e.what());
+
+        return rendering::defaultPrefetchMargin;
+    }
+}
+
+std::size_t SettingsManager::loadThumbnailCacheSize()
+{
+    const std::size_t megabyte = 1024 * 1024;
+
+    try {
+        if (!m_keyFile.has_group(rendering::groupName)
+            || !m_keyFile.has_key(rendering::groupName, rendering::keys.thumbnailCacheSize))
+            return rendering::defaultThumbnailCacheSize * megabyte;
+
+        const int sizeInMegabytes = m_keyFile.get_integer(rendering::groupName, rendering::keys.thumbnailCacheSize);
+
+        return static_cast<std::size_t>(std::max(0, sizeInMegabytes)) * megabyte;
+    }
+    catch (const Glib::Error& e) {
+        Logger::logWarning("Error while loading thumbnail cache size: " + e.what());
+
+        return rendering::defaultThumbnailCacheSize * megabyte;
+    }
+}
+
+std::size_t SettingsManager::loadDiskThumbnailCacheSize()
+{
+    const std::size_t megabyte = 1024 * 1024;
+
+    try {
+        if (!m_keyFile.has_group(rendering::groupName)
+            || !m_keyFile.has_key(rendering::groupName, rendering::keys.diskThumbnailCacheSize))
+            return rendering::defaultDiskThumbnailCacheSize * megabyte;
+
+        const int sizeInMegabytes = m_keyFile.get_integer(rendering::groupName, rendering::keys.diskThumbnailCacheSize);
+
+        return static_cast<std::size_t>(std::max(0, sizeInMegabytes)) * megabyte;
+    }
+    catch (const Glib::Error& e) {
+        Logger::logWarning("Error while loading disk thumbnail cache size: " + e.what());
+
+        return rendering::defaultDiskThumbnailCacheSize * megabyte;
+    }
+}
+
+bool SettingsManager::loadMemoryMappedFiles()
+{
+    try {
+        if (!m_keyFile.has_group(rendering::groupName)
+            || !m_keyFile.has_key(rendering::groupName, rendering::keys.memoryMappedFiles))
+            return rendering::defaultMemoryMappedFiles;
+
+        return m_keyFile.get_boolean(rendering::groupName, rendering::keys.memoryMappedFiles);
+    }
+    catch (const Glib::Error& e) {
+        Logger::logWarning("Error while loading memory mapped files: " + e.what());
+
+        return rendering::defaultMemoryMappedFiles;
+    }
+}
+
+bool SettingsManager::loadThrottleInBackground()
+{
+    try {
+        if (!m_keyFile.has_group(rendering::groupName)
+            || !m_keyFile.has_key(rendering::groupName, rendering::keys.throttleInBackground))
+            return rendering::defaultThrottleInBackground;
+
+        return m_keyFile.get_boolean(rendering::groupName, rendering::keys.throttleInBackground);
+    }
+    catch (const Glib::Error& e) {
+        Logger::logWarning("Error while loading throttle in background: " + e.what());
+
+        return rendering::defaultThrottleInBackground;
+    }
+}
+
+bool SettingsManager::loadTuneRenderThreads()
+{
+    try {
+        if (!m_keyFile.has_group(rendering::groupName)
+            || !m_keyFile.has_key(rendering::groupName, rendering::keys.tuneThreads))
+            return rendering::defaultTuneThreads;
+
+        return m_keyFile.get_boolean(rendering::groupName, rendering::keys.tuneThreads);
+    }
+    catch (const Glib::Error& e) {
+        Logger::logWarning("Error while loading tune render threads: " + e.what());
+
+        return rendering::defaultTuneThreads;
+    }
+}
+
+int SettingsManager::loadMinimumRenderThreads()
+{
+    try {
+        if (!m_keyFile.has_group(rendering::groupName)
+            || !m_keyFile.has_key(rendering::groupName, rendering::keys.minimumThreads))
+            return rendering::defaultMinimumThreads;
+
+        return std::max(1, m_keyFile.get_integer(rendering::groupName, rendering::keys.minimumThreads));
+    }
+    catch (const Glib::Error& e) {
+        Logger::logWarning("Error while loading minimum render threads: " + e.what());
+
+        return rendering::defaultMinimumThreads;
+    }
+}
+
+bool SettingsManager::loadRenderProcesses()
+{
+    try {
+        if (!m_keyFile.has_group(rendering::groupName)
+            || !m_keyFile.has_key(rendering::groupName, rendering::keys.renderProcesses))
+            return rendering::defaultRenderProcesses;
+
+        return m_keyFile.get_boolean(rendering::groupName, rendering::keys.renderProcesses);
+    }
+    catch (const Glib::Error& e) {
+        Logger::logWarning("Error while loading render processes: " + e.what());
+
+        return rendering::defaultRenderProcesses;
+    }
+}
+
+std::string SettingsManager::loadRenderDaemon()
+{
+    try {
+        if (!m_keyFile.has_group(rendering::groupName)
+            || !m_keyFile.has_key(rendering::groupName, rendering::keys.renderDaemon))
+            return rendering::defaultRenderDaemon;
+
+        return m_keyFile.get_string(rendering::groupName, rendering::keys.renderDaemon);
+    }
+    catch (const Glib::Error& e) {
+        Logger::logWarning("Error while loading render daemon: " + e.what());
+
+        return rendering::defaultRenderDaemon;
+    }
+}
+
+std::chrono::milliseconds SettingsManager::loadRenderBudget()
+{
+    try {
+        if (!m_keyFile.has_group(rendering::groupName)
+            || !m_keyFile.has_key(rendering::groupName, rendering::keys.renderBudget))
+            return std::chrono::milliseconds{rendering::defaultRenderBudget};
+
+        return std::chrono::milliseconds{std::max(0, m_keyFile.get_integer(rendering::groupName, rendering::keys.renderBudget))};
+    }
+    catch (const Glib::Error& e) {
+        Logger::logWarning("Error while loading render budget: " + e.what());
+
+        return std::chrono::milliseconds{rendering::defaultRenderBudget};
+    }
+}
+
+std::size_t SettingsManager::loadUndoSteps()
+{
+    try {
+        if (!m_keyFile.has_group(history::groupName)
+            || !m_keyFile.has_key(history::groupName, history::keys.undoSteps))
+            return history::defaultUndoSteps;
+
+        const int undoSteps = m_keyFile.get_integer(history::groupName, history::keys.undoSteps);
+
+        return static_cast<std::size_t>(std::max(1, undoSteps));
+    }
+    catch (const Glib::Error& e) {
+        Logger::logWarning("Error while loading undo steps: " + e.what());
+
+        return history::defaultUndoSteps;
+    }
+}
+
+std::size_t SettingsManager::loadUndoHistorySize()
+{
+    const std::size_t megabyte = 1024 * 1024;
+
+    try {
+        if (!m_keyFile.has_group(history::groupName)
+            || !m_keyFile.has_key(history::groupName, history::keys.undoHistorySize))
+            return history::defaultUndoHistorySize * megabyte;
+
+        const int sizeInMegabytes = m_keyFile.get_integer(history::groupName, history::keys.undoHistorySize);
+
+        return static_cast<std::size_t>(std::max(0, sizeInMegabytes)) * megabyte;
+    }
+    catch (const Glib::Error& e) {
+        Logger::logWarning("Error while loading undo history size: " + e.what());
+
+        return history::defaultUndoHistorySize * megabyte;
+    }
+}
+
+bool SettingsManager::loadResident()
+{
+    try {
+        if (!m_keyFile.has_group(background::groupName)
+            || !m_keyFile.has_key(background::groupName, background::keys.resident))
+            return background::defaultResident;
+
+        return m_keyFile.get_boolean(background::groupName, background::keys.resident);
+    }
+    catch (const Glib::Error& e) {
+        Logger::logWarning("Error while loading resident mode: " + e.what());
+
+        return background::defaultResident;
+    }
+}
+
+std::size_t SettingsManager::loadResidentMemory()
+{
+    const std::size_t megabyte = 1024 * 1024;
+
+    try {
+        if (!m_keyFile.has_group(background::groupName)
+            || !m_keyFile.has_key(background::groupName, background::keys.residentMemory))
+            return background::defaultResidentMemory * megabyte;
+
+        const int sizeInMegabytes = m_keyFile.get_integer(background::groupName, background::keys.residentMemory);
+
+        return static_cast<std::size_t>(std::max(0, sizeInMegabytes)) * megabyte;
+    }
+    catch (const Glib::Error& e) {
+        Logger::logWarning("Error while loading resident memory: " + e.what());
+
+        return background::defaultResidentMemory * megabyte;
+    }
+}
+
+PdfSaver::WriteProfile SettingsManager::loadWriteProfile()
+{
+    try {
+        if (!m_keyFile.has_group(saving::groupName)
+            || !m_keyFile.has_key(saving::groupName, saving::keys.writeProfile))
+            return saving::defaultWriteProfile;
+
+        const std::string name = m_keyFile.get_string(saving::groupName, saving::keys.writeProfile);
+
+        return PdfSaver::writeProfileFromName(name).value_or(saving::defaultWriteProfile);
+    }
+    catch (const Glib::Error& e) {
+        Logger::logWarning("Error while loading write profile: " + e.what());
+
+        return saving::defaultWriteProfile;
+    }
+}
+
+void SettingsManager::saveWriteProfile(PdfSaver::WriteProfile profile)
+{
+    try {
+        m_keyFile.set_string(saving::groupName, saving::keys.writeProfile, PdfSaver::writeProfileName(profile));
+    }
+    catch (const Glib::Error& e) {
+        Logger::logWarning("Error while writing write profile: " + e.what());
+    }
+}
+
+PdfSaver::ResourceCleanup SettingsManager::loadResourceCleanup()
+{
+    try {
+        if (!m_keyFile.has_group(saving::groupName)
+            || !m_keyFile.has_key(saving::groupName, saving::keys.resourceCleanup))
+            return saving::defaultResourceCleanup;
+
+        const std::string name = m_keyFile.get_string(saving::groupName, saving::keys.resourceCleanup);
+
+        return PdfSaver::resourceCleanupFromName(name).value_or(saving::defaultResourceCleanup);
+    }
+    catch (const Glib::Error& e) {
+        Logger::logWarning("Error while loading resource cleanup: " + e.what());
+
+        return saving::defaultResourceCleanup;
+    }
+}
+
+std::optional<ImageDownsampling::Options> SettingsManager::loadImageDownsampling()
+{
+    try {
+        if (!m_keyFile.has_group(saving::groupName)
+            || !m_keyFile.has_key(saving::groupName, saving::keys.downsampleImagesDpi))
+            return std::nullopt;
+
+        const int dpi = m_keyFile.get_integer(saving::groupName, saving::keys.downsampleImagesDpi);
+
+        if (dpi <= 0)
+            return std::nullopt;
+
+        ImageDownsampling::Options options;
+        options.dpi = dpi;
+
+        return options;
+    }
+    catch (const Glib::Error& e) {
+        Logger::logWarning("Error while loading image downsampling: " + e.what());
+
+        return std::nullopt;
+    }
+}
+
 void SettingsManager::loadConfigFile()
 {
     try {
@@ -119,6 +516,8 @@ void SettingsManager::loadConfigFile()
 void SettingsManager::saveConfigFile()
 {
     try {
+        // Startup creates it off the main thread, maybe not in time
+        g_mkdir_with_parents(config::getConfigDirPath().c_str(), 0700);
         m_keyFile.save_to_file(getSettingsFilePath());
     }
     catch (const Glib::Error& e) {
@@ -17,7 +17,10 @@
 #ifndef SETTINGSMANAGER_HPP
 #define SETTINGSMANAGER_HPP
 
+#include <commandmanager.hpp>
+#include <pdfsaver.hpp>
 #include <glibmm/keyfile.h>
+#include <chrono>
 
 namespace Slicer {
 
@@ -44,6 +47,52 @@ public:
     unsigned int loadZoomLevel();
     void saveZoomLevel(unsigned int zoomLevel);
 
+    // 0 means "one render thread per core"
+    int loadRenderThreads();
+
+    // Measured in viewport heights, above and below the visible area
+    double loadPrefetchMargin();
+
+    // In bytes, although the setting itself is stored in megabytes
+    std::size_t loadThumbnailCacheSize();
+    // Same as above, 0 disables the cache on disk
+    std::size_t loadDiskThumbnailCacheSize();
+
+    // Whether documents are read through memory mappings, see MappedFile
+    bool loadMemoryMappedFiles();
+    // Fewer render threads while no window of the application has the
+    // focus, and while the system saves power
+    bool loadThrottleInBackground();
+    // Fewer render threads than allowed while more wouldn't render any
+    // faster, down to the minimum, see TaskRunner::setTuning()
+    bool loadTuneRenderThreads();
+    int loadMinimumRenderThreads();
+    // Pages rendered by helper processes rather than by this one, see RenderProcessPool
+    bool loadRenderProcesses();
+    // The socket of the RenderDaemon that renders pages instead, if any. Takes
+    // precedence over render processes.
+    std::string loadRenderDaemon();
+    // How long a render may take before its page is rendered apart, see
+    // SharedThumbnails::setRenderBudget()
+    std::chrono::milliseconds loadRenderBudget();
+
+    std::size_t loadUndoSteps();
+    // In bytes, stored in megabytes like the cache sizes
+    std::size_t loadUndoHistorySize();
+
+    // Whether the application stays running once its last window closes,
+    // keeping what it has cached for the next one, see Application
+    bool loadResident();
+    // In bytes, what the caches may hold meanwhile; megabytes in the file
+    std::size_t loadResidentMemory();
+
+    PdfSaver::WriteProfile loadWriteProfile();
+    void saveWriteProfile(PdfSaver::WriteProfile profile);
+
+    PdfSaver::ResourceCleanup loadResourceCleanup();
+    // Nothing unless a resolution is set, see PdfSaver::setImageDownsampling()
+    std::optional<ImageDownsampling::Options> loadImageDownsampling();
+
 private:
     Glib::KeyFile m_keyFile;
 
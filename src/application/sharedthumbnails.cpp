@@ -0,0 +1,402 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "sharedthumbnails.hpp"
+#include <logger.hpp>
+#include <metrics.hpp>
+#include <pixelconversion.hpp>
+#include <rendercost.hpp>
+#include <trace.hpp>
+#include <algorithm>
+#include <functional>
+#include <optional>
+#include <unordered_set>
+
+namespace Slicer {
+
+// Stands in for a page a render helper was lost on, in place of trying it
+// again, and for slow pages until they're rendered
+static Glib::RefPtr<Gdk::Pixbuf> createBlankThumbnail(const Page& page, int targetSize)
+{
+    const Page::Size size = page.scaledRotatedSize(targetSize);
+    auto thumbnail = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, true, 8, size.width, size.height);
+    thumbnail->fill(0xffffffff);
+    PixelConversion::drawRgbaOutline(thumbnail->get_pixels(),
+                                     thumbnail->get_rowstride(),
+                                     thumbnail->get_width(),
+                                     thumbnail->get_height());
+
+    return thumbnail;
+}
+
+// Zoom levels are within this of each other, so zooming out takes no rendering
+static constexpr double maximumDownscale = 4;
+
+static Glib::RefPtr<Gdk::Pixbuf> downscaleThumbnail(const Glib::RefPtr<Gdk::Pixbuf>& source, const Page& page, int targetSize)
+{
+    const Trace::Span span{"SharedThumbnails downscaling"};
+    const Page::Size size = page.scaledRotatedSize(targetSize);
+    const int width = std::min(size.width, source->get_width());
+    const int height = std::min(size.height, source->get_height());
+    auto thumbnail = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, source->get_has_alpha(), 8, width, height);
+
+    PixelConversion::downscale(source->get_pixels(),
+                               source->get_rowstride(),
+                               source->get_width(),
+                               source->get_height(),
+                               thumbnail->get_pixels(),
+                               thumbnail->get_rowstride(),
+                               width,
+                               height,
+                               source->get_n_channels());
+
+    return thumbnail;
+}
+
+SharedThumbnails::SharedThumbnails(TaskRunner& taskRunner)
+    : m_taskRunner{taskRunner}
+{
+}
+
+SharedThumbnails::~SharedThumbnails()
+{
+    // Canceled tasks never get to call back into this
+    for (auto& [key, inFlight] : m_inFlightRenders)
+        inFlight.render->cancel();
+
+    m_taskRunner.dropCanceledTasks();
+}
+
+void SharedThumbnails::setDiskCache(const std::shared_ptr<DiskThumbnailCache>& diskCache)
+{
+    m_diskCache = diskCache;
+}
+
+void SharedThumbnails::setRenderProcessPool(const std::shared_ptr<RenderProcessPool>& renderProcessPool)
+{
+    m_renderProcessPool = renderProcessPool;
+}
+
+void SharedThumbnails::setRenderBudget(std::chrono::milliseconds renderBudget)
+{
+    m_renderBudget = renderBudget;
+}
+
+void SharedThumbnails::forgetPages(const std::string& fileHash, const std::vector<unsigned int>& indexesInFile)
+{
+    m_cache.forget(fileHash, indexesInFile);
+
+    for (unsigned int indexInFile : indexesInFile)
+        m_slowPages.erase({fileHash, indexInFile});
+
+    if (m_diskCache != nullptr)
+        m_diskCache->forget(fileHash, indexesInFile);
+}
+
+void SharedThumbnails::render(const Glib::RefPtr<const Page>& page,
+                              const ThumbnailCache::Key& key,
+                              const std::shared_ptr<InteractivePageWidget>& pageWidget,
+                              const std::shared_ptr<Task>& waiting,
+                              TaskRunner::Priority priority,
+                              PageRenderer::Quality quality)
+{
+    InFlightRender& inFlight = m_inFlightRenders[key];
+    inFlight.waiters.emplace_back(pageWidget, waiting);
+    inFlight.isSpeculative = false;
+
+    if (inFlight.render != nullptr && !inFlight.render->isCanceled()) {
+        // A page in view doesn't wait for a draft and then the pass after it,
+        // nor the focused window behind the renders of another one
+        const bool isGoodEnough = inFlight.quality == PageRenderer::Quality::Full
+                                  || quality == PageRenderer::Quality::Draft;
+        const bool isSoonEnough = inFlight.priority <= priority || inFlight.isInSlowLane;
+
+        if (isGoodEnough && isSoonEnough)
+            return;
+
+        inFlight.render->cancel();
+
+        if (inFlight.quality == PageRenderer::Quality::Full)
+            quality = PageRenderer::Quality::Full;
+    }
+
+    queueRender(page, key, priority, quality, true);
+}
+
+void SharedThumbnails::queueRender(const Glib::RefPtr<const Page>& page,
+                                   const ThumbnailCache::Key& key,
+                                   TaskRunner::Priority priority,
+                                   PageRenderer::Quality quality,
+                                   bool canUseEmbeddedThumbnail)
+{
+    struct Result {
+        Glib::RefPtr<Gdk::Pixbuf> thumbnail;
+        // A blurry embedded thumbnail or a draft, shown until the real render is done
+        bool isPlaceholder = false;
+        std::chrono::steady_clock::duration renderDuration{};
+    };
+
+    const int targetSize = key.targetSize;
+    auto result = std::make_shared<Result>();
+    const bool isSlowPage = m_slowPages.count({key.fileHash, key.indexInFile}) > 0;
+
+    // Zooming out, the size above it is scaled down rather than rendered
+    // again, and that's as sharp as can be even when a draft was asked for
+    Glib::RefPtr<Gdk::Pixbuf> larger = m_cache.findLarger(key, maximumDownscale);
+    if (larger && larger->get_bits_per_sample() != 8)
+        larger.reset();
+    if (larger)
+        quality = PageRenderer::Quality::Full;
+
+    // The placeholder comes first, from the usual lane
+    const bool isInSlowLane = isSlowPage && !canUseEmbeddedThumbnail && !larger;
+
+    auto funcExecute = [page,
+                        targetSize,
+                        result,
+                        quality,
+                        canUseEmbeddedThumbnail,
+                        isSlowPage,
+                        larger,
+                        diskCache = m_diskCache,
+                        renderProcessPool = m_renderProcessPool]() {
+        if (larger) {
+            result->thumbnail = downscaleThumbnail(larger, *page.get(), targetSize);
+            return;
+        }
+
+        std::optional<DiskThumbnailCache::Key> diskKey;
+
+        if (diskCache != nullptr) {
+            diskKey = DiskThumbnailCache::keyFor(*page.get(), targetSize);
+            result->thumbnail = diskCache->load(*diskKey);
+
+            if (result->thumbnail)
+                return;
+        }
+
+        // Scans often carry thumbnails of their own, which take no rasterizing
+        if (canUseEmbeddedThumbnail) {
+            if (auto [embedded, isSharp] = PageRenderer{page}.renderEmbeddedThumbnail(targetSize); embedded) {
+                result->thumbnail = embedded;
+                result->isPlaceholder = !isSharp;
+
+                return;
+            }
+        }
+
+        // Whatever poppler makes of it would take as long as before, even a draft
+        if (isSlowPage && canUseEmbeddedThumbnail) {
+            result->thumbnail = createBlankThumbnail(*page.get(), targetSize);
+            result->isPlaceholder = true;
+            return;
+        }
+
+        const auto renderStart = std::chrono::steady_clock::now();
+
+        if (renderProcessPool != nullptr) {
+            try {
+                result->thumbnail = renderProcessPool->render(*page.get(), targetSize, quality);
+
+                // The helper's own measurements stay in the helper
+                if (result->thumbnail)
+                    Metrics::recordPageRender(page->filePath(),
+                                              page->indexInFile(),
+                                              std::chrono::steady_clock::now() - renderStart,
+                                              static_cast<std::size_t>(result->thumbnail->get_rowstride()) * static_cast<std::size_t>(result->thumbnail->get_height()));
+            }
+            catch (const RenderProcessPool::Unreachable& e) {
+                Logger::logWarning(std::string{"Rendering in this process: "} + e.what());
+                result->thumbnail = PageRenderer{page}.render(targetSize, quality);
+            }
+            catch (const RenderProcessPool::RenderFailed& e) {
+                Logger::logWarning(std::string{"A page couldn't be rendered: "} + e.what());
+
+                // Kept for good, and not on disk, so that it's tried again in the next session
+                result->thumbnail = createBlankThumbnail(*page.get(), targetSize);
+                return;
+            }
+        }
+        else {
+            result->thumbnail = PageRenderer{page}.render(targetSize, quality);
+        }
+
+        result->renderDuration = std::chrono::steady_clock::now() - renderStart;
+
+        if (quality == PageRenderer::Quality::Draft) {
+            result->isPlaceholder = true;
+            return;
+        }
+
+        if (diskKey.has_value())
+            diskCache->store(*diskKey, result->thumbnail);
+    };
+
+    auto funcPostExecute = [this, page, key, quality, priority, result]() {
+        const bool isPageUnchanged = ThumbnailCache::keyFor(*page.get(), key.targetSize) == key;
+        auto it = m_inFlightRenders.find(key);
+
+        // poppler can't be stopped halfway, so a page is only moved aside after it blew its budget once
+        if (m_renderBudget.count() > 0 && result->renderDuration > m_renderBudget
+            && m_slowPages.insert({key.fileHash, key.indexInFile}).second) {
+            const auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(result->renderDuration);
+            Logger::logInfo("Page " + std::to_string(key.indexInFile + 1) + " of " + page->filePath() + " took "
+                            + std::to_string(milliseconds.count()) + " ms to render; rendering it apart from now on");
+        }
+
+        if (result->isPlaceholder) {
+            if (it == m_inFlightRenders.end())
+                return;
+
+            for (auto& [weakWidget, waiting] : it->second.waiters) {
+                if (auto widget = weakWidget.lock(); widget != nullptr && !waiting->isCanceled())
+                    widget->showPlaceholder(result->thumbnail);
+            }
+
+            if (quality == PageRenderer::Quality::Draft) {
+                // Nobody waits anymore; the layout asks again for the pages
+                // that come into view
+                InFlightRender inFlight = std::move(it->second);
+                m_inFlightRenders.erase(it);
+
+                for (auto& [weakWidget, waiting] : inFlight.waiters) {
+                    if (auto widget = weakWidget.lock(); widget != nullptr && !waiting->isCanceled())
+                        widget->cancelRendering();
+                }
+
+                return;
+            }
+
+            // The sharp render comes after everything else that's queued
+            // for the same window
+            if (isPageUnchanged)
+                queueRender(page,
+                            key,
+                            std::max(priority, TaskRunner::Priority::Prefetch),
+                            PageRenderer::Quality::Full,
+                            false);
+
+            return;
+        }
+
+        // The page may have been rotated while this was rendering
+        if (isPageUnchanged)
+            m_cache.insert(key, result->thumbnail);
+
+        if (it == m_inFlightRenders.end())
+            return;
+
+        // Anyone still waiting asked for exactly this thumbnail, maybe
+        // through a later render of the same key that isn't needed now
+        InFlightRender inFlight = std::move(it->second);
+        m_inFlightRenders.erase(it);
+        inFlight.render->cancel();
+
+        for (auto& [weakWidget, waiting] : inFlight.waiters) {
+            if (auto widget = weakWidget.lock(); widget != nullptr && !waiting->isCanceled())
+                widget->showPage(result->thumbnail);
+        }
+    };
+
+    auto task = std::make_shared<Task>(funcExecute, funcPostExecute);
+    task->setHeavy(RenderCost::isHeavy(page->renderCost()));
+    InFlightRender& inFlight = m_inFlightRenders[key];
+    inFlight.render = task;
+    inFlight.quality = quality;
+    inFlight.priority = priority;
+    inFlight.isInSlowLane = isInSlowLane;
+
+    if (isInSlowLane)
+        m_taskRunner.queueSlow(task);
+    else
+        // Pages of the same file go to the worker that already has it open
+        m_taskRunner.queue(task, priority, std::hash<std::string>{}(page->filePath()));
+}
+
+void SharedThumbnails::dropAbandonedRenders()
+{
+    bool isAnyDropped = false;
+
+    for (auto it = m_inFlightRenders.begin(); it != m_inFlightRenders.end();) {
+        auto& waiters = it->second.waiters;
+        waiters.erase(std::remove_if(waiters.begin(), waiters.end(), [](const auto& waiter) {
+                          return waiter.second->isCanceled();
+                      }),
+                      waiters.end());
+
+        if (waiters.empty() && !it->second.isSpeculative) {
+            it->second.render->cancel();
+            it = m_inFlightRenders.erase(it);
+            isAnyDropped = true;
+        }
+        else {
+            ++it;
+        }
+    }
+
+    if (isAnyDropped)
+        m_taskRunner.dropCanceledTasks();
+}
+
+void SharedThumbnails::prerender(const std::vector<std::pair<Glib::RefPtr<const Page>, ThumbnailCache::Key>>& thumbnails)
+{
+    std::unordered_set<ThumbnailCache::Key, ThumbnailCache::KeyHash> wanted;
+    std::vector<std::pair<Glib::RefPtr<const Page>, ThumbnailCache::Key>> toRender;
+    const auto budget = static_cast<double>(m_cache.capacity()) * prerenderShare;
+    double spent = 0;
+
+    for (const auto& [page, key] : thumbnails) {
+        // The slow ones stay the slow lane's
+        if (m_slowPages.count({key.fileHash, key.indexInFile}) > 0)
+            continue;
+
+        const Page::Size size = page->scaledRotatedSize(key.targetSize);
+        spent += static_cast<double>(size.width) * size.height * 4;
+        if (spent > budget)
+            break;
+
+        wanted.insert(key);
+        toRender.emplace_back(page, key);
+    }
+
+    // The ones of last time that aren't wanted now, and that nobody joined
+    bool isAnyDropped = false;
+
+    for (auto it = m_inFlightRenders.begin(); it != m_inFlightRenders.end();) {
+        if (it->second.isSpeculative && it->second.waiters.empty() && wanted.count(it->first) == 0) {
+            it->second.render->cancel();
+            it = m_inFlightRenders.erase(it);
+            isAnyDropped = true;
+        }
+        else {
+            ++it;
+        }
+    }
+
+    if (isAnyDropped)
+        m_taskRunner.dropCanceledTasks();
+
+    for (const auto& [page, key] : toRender) {
+        if (m_inFlightRenders.count(key) > 0 || m_cache.find(key))
+            continue;
+
+        // An embedded thumbnail is only a placeholder, which nobody would see
+        queueRender(page, key, TaskRunner::Priority::Idle, PageRenderer::Quality::Full, false);
+        m_inFlightRenders.at(key).isSpeculative = true;
+    }
+}
+
+} // namespace Slicer
@@ -0,0 +1,116 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef SLICER_SHAREDTHUMBNAILS_HPP
+#define SLICER_SHAREDTHUMBNAILS_HPP
+
+#include "interactivepagewidget.hpp"
+#include "taskrunner.hpp"
+#include <diskthumbnailcache.hpp>
+#include <pagerenderer.hpp>
+#include <renderprocesspool.hpp>
+#include <thumbnailcache.hpp>
+#include <chrono>
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+namespace Slicer {
+
+// The thumbnails of every window, and the renders on their way. Both are
+// keyed by the contents of the files, so a file open in two windows is
+// rendered once, for both. Main thread only, like the views using it.
+class SharedThumbnails {
+public:
+    explicit SharedThumbnails(TaskRunner& taskRunner);
+
+    SharedThumbnails(const SharedThumbnails&) = delete;
+    SharedThumbnails& operator=(const SharedThumbnails&) = delete;
+    SharedThumbnails(SharedThumbnails&&) = delete;
+    SharedThumbnails& operator=(SharedThumbnails&& src) = delete;
+
+    ~SharedThumbnails();
+
+    ThumbnailCache& cache() { return m_cache; }
+    const ThumbnailCache& cache() const { return m_cache; }
+    void setDiskCache(const std::shared_ptr<DiskThumbnailCache>& diskCache);
+    // Null without one
+    const std::shared_ptr<DiskThumbnailCache>& diskCache() const { return m_diskCache; }
+    // Renders go to its helpers from then on; embedded thumbnails are still read here
+    void setRenderProcessPool(const std::shared_ptr<RenderProcessPool>& renderProcessPool);
+    // A page whose render takes longer than this is slow from then on: it
+    // gets a blank placeholder at once, and its renders go to the runner's
+    // slow lane, so that it can't hold up the other pages. Zero for none.
+    void setRenderBudget(std::chrono::milliseconds renderBudget);
+
+    // Shows the thumbnail on pageWidget once it's rendered, unless waiting
+    // is canceled before. Asking again for the same thumbnail, from any
+    // window, joins the render instead of starting another one, as long as
+    // that one is as soon and as good as asked for.
+    void render(const Glib::RefPtr<const Page>& page,
+                const ThumbnailCache::Key& key,
+                const std::shared_ptr<InteractivePageWidget>& pageWidget,
+                const std::shared_ptr<Task>& waiting,
+                TaskRunner::Priority priority,
+                PageRenderer::Quality quality);
+    // Cancels the renders nobody waits for anymore
+    void dropAbandonedRenders();
+    // Renders those thumbnails into the cache when nothing else is queued,
+    // ahead of being asked for, in place of the ones asked for last time
+    // that haven't started. Only as many as fit in a share of the cache.
+    void prerender(const std::vector<std::pair<Glib::RefPtr<const Page>, ThumbnailCache::Key>>& thumbnails);
+    // Of the cache's capacity, what speculative renders may fill
+    static constexpr double prerenderShare = 0.25;
+    // Every thumbnail of those pages, in memory and on disk, for pages
+    // that changed in their file
+    void forgetPages(const std::string& fileHash, const std::vector<unsigned int>& indexesInFile);
+
+    std::size_t numberOfRendersInFlight() const { return m_inFlightRenders.size(); }
+
+private:
+    TaskRunner& m_taskRunner;
+    ThumbnailCache m_cache{ThumbnailCache::defaultCapacity, ThumbnailCache::defaultCompressedCapacity};
+    std::shared_ptr<DiskThumbnailCache> m_diskCache;
+    std::shared_ptr<RenderProcessPool> m_renderProcessPool;
+    std::chrono::milliseconds m_renderBudget{0};
+    // By file hash and index in file
+    std::set<std::pair<std::string, unsigned int>> m_slowPages;
+
+    // Each widget waits through its own task, which is what it cancels; the
+    // render is canceled once nobody waits for it anymore
+    struct InFlightRender {
+        std::shared_ptr<Task> render;
+        PageRenderer::Quality quality = PageRenderer::Quality::Full;
+        TaskRunner::Priority priority = TaskRunner::Priority::Visible;
+        // As soon as it gets, whatever its priority
+        bool isInSlowLane = false;
+        // Asked for by prerender(), not by a widget; kept without waiters
+        bool isSpeculative = false;
+        std::vector<std::pair<std::weak_ptr<InteractivePageWidget>, std::shared_ptr<Task>>> waiters;
+    };
+    std::unordered_map<ThumbnailCache::Key, InFlightRender, ThumbnailCache::KeyHash> m_inFlightRenders;
+
+    void queueRender(const Glib::RefPtr<const Page>& page,
+                     const ThumbnailCache::Key& key,
+                     TaskRunner::Priority priority,
+                     PageRenderer::Quality quality,
+                     bool canUseEmbeddedThumbnail);
+};
+
+} // namespace Slicer
+
+#endif // SLICER_SHAREDTHUMBNAILS_HPP
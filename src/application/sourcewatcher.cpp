@@ -0,0 +1,89 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "sourcewatcher.hpp"
+#include <glibmm/main.h>
+#include <logger.hpp>
+
+namespace Slicer {
+
+SourceWatcher::~SourceWatcher()
+{
+    clear();
+}
+
+void SourceWatcher::watch(const Document& document)
+{
+    for (const Document::LiveFile& liveFile : document.liveFiles()) {
+        const Glib::RefPtr<Gio::File>& file = liveFile.originalFile;
+        const std::string uri = file->get_uri();
+
+        if (m_files.count(uri) > 0 || file->get_path().empty())
+            continue;
+
+        WatchedFile watched{file, {}, {}};
+
+        try {
+            watched.monitor = file->monitor_file();
+        }
+        catch (const Glib::Error& e) {
+            Logger::logWarning(Glib::ustring{"The file can't be watched for changes: "} + e.what());
+            continue;
+        }
+
+        watched.monitor->signal_changed().connect([this, uri](const Glib::RefPtr<Gio::File>&,
+                                                               const Glib::RefPtr<Gio::File>&,
+                                                               Gio::FileMonitorEvent event) {
+            onMonitorEvent(uri, event);
+        });
+
+        m_files.emplace(uri, std::move(watched));
+    }
+}
+
+void SourceWatcher::clear()
+{
+    for (auto& [uri, watched] : m_files) {
+        watched.settle.disconnect();
+        watched.monitor->cancel();
+    }
+
+    m_files.clear();
+}
+
+void SourceWatcher::onMonitorEvent(const std::string& uri, Gio::FileMonitorEvent event)
+{
+    if (event != Gio::FILE_MONITOR_EVENT_CHANGED
+        && event != Gio::FILE_MONITOR_EVENT_CHANGES_DONE_HINT
+        && event != Gio::FILE_MONITOR_EVENT_CREATED)
+        return;
+
+    auto it = m_files.find(uri);
+    if (it == m_files.end())
+        return;
+
+    // Waits for the file to be quiet again
+    it->second.settle.disconnect();
+    it->second.settle = Glib::signal_timeout().connect_once([this, uri]() {
+        auto watched = m_files.find(uri);
+        if (watched != m_files.end())
+            fileChanged.emit(watched->second.file);
+    },
+                                                          settleInterval);
+}
+
+} // namespace Slicer
@@ -0,0 +1,67 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef SLICER_SOURCEWATCHER_HPP
+#define SLICER_SOURCEWATCHER_HPP
+
+#include <document.hpp>
+#include <giomm/file.h>
+#include <giomm/filemonitor.h>
+#include <sigc++/sigc++.h>
+#include <map>
+#include <string>
+
+namespace Slicer {
+
+// Tells when the files a document was opened from change on disk. Editors
+// write a file in several goes, so a change is only told once the file has
+// been quiet for settleInterval. Only local files are watched. Main thread only.
+class SourceWatcher {
+public:
+    SourceWatcher() = default;
+
+    SourceWatcher(const SourceWatcher&) = delete;
+    SourceWatcher& operator=(const SourceWatcher&) = delete;
+    SourceWatcher(SourceWatcher&&) = delete;
+    SourceWatcher& operator=(SourceWatcher&& src) = delete;
+
+    ~SourceWatcher();
+
+    // Starts watching the files of document that aren't watched yet
+    void watch(const Document& document);
+    void clear();
+
+    sigc::signal<void, Glib::RefPtr<Gio::File>> fileChanged;
+
+    static constexpr unsigned int settleInterval = 1000;
+
+private:
+    struct WatchedFile {
+        Glib::RefPtr<Gio::File> file;
+        Glib::RefPtr<Gio::FileMonitor> monitor;
+        sigc::connection settle;
+    };
+
+    // By URI
+    std::map<std::string, WatchedFile> m_files;
+
+    void onMonitorEvent(const std::string& uri, Gio::FileMonitorEvent event);
+};
+
+} // namespace Slicer
+
+#endif // SLICER_SOURCEWATCHER_HPP
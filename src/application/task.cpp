@@ -25,9 +25,38 @@ Task::Task(const std::function<void()>& funcExecute,
 {
 }
 
+void Task::setGeneration(const GenerationCounter& counter)
+{
+    m_generationCounter = counter;
+    m_generation = *counter;
+}
+
 bool Task::isCanceled() const
 {
-    return m_isCanceled;
+    if (m_isCanceled)
+        return true;
+
+    return m_generationCounter != nullptr && *m_generationCounter != m_generation;
+}
+
+void Task::setHeavy(bool isHeavy)
+{
+    m_isHeavy = isHeavy;
+}
+
+bool Task::isHeavy() const
+{
+    return m_isHeavy;
+}
+
+void Task::setQueuedTime(std::chrono::steady_clock::time_point time)
+{
+    m_queuedTime = time;
+}
+
+std::chrono::steady_clock::time_point Task::queuedTime() const
+{
+    return m_queuedTime;
 }
 
 void Task::cancel()
@@ -18,7 +18,9 @@
 #define SLICER_TASK_HPP
 
 #include <atomic>
+#include <chrono>
 #include <functional>
+#include <memory>
 
 namespace Slicer {
 
@@ -27,14 +29,32 @@ public:
 	Task(const std::function<void()>& funcExecute,
          const std::function<void()>& funcPostExecute);
 
+    // A task that belongs to a generation is canceled along with all the
+    // others in it as soon as the counter is moved on. Set before queuing.
+    using GenerationCounter = std::shared_ptr<const std::atomic_uint>;
+    void setGeneration(const GenerationCounter& counter);
+
     [[nodiscard]] bool isCanceled() const;
 
+    // Heavy tasks wait behind the light ones of the same priority that are
+    // queued after them, so that a few costly pages don't hold up the rest
+    void setHeavy(bool isHeavy);
+    [[nodiscard]] bool isHeavy() const;
+
+    // When it went into a queue, to tell waiting apart from running in traces
+    void setQueuedTime(std::chrono::steady_clock::time_point time);
+    [[nodiscard]] std::chrono::steady_clock::time_point queuedTime() const;
+
 	void cancel();
 	void execute();
 	void postExecute();
 
 private:
 	std::atomic_bool m_isCanceled = false;
+    GenerationCounter m_generationCounter;
+    unsigned int m_generation = 0;
+    bool m_isHeavy = false;
+    std::chrono::steady_clock::time_point m_queuedTime;
 	std::function<void()> m_funcExecute;
 	std::function<void()> m_funcPostExecute;
 };
@@ -14,56 +14,460 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
+
 #include "taskrunner.hpp"
-#include <glibmm/main.h>
+#include <cpuresources.hpp>
+#include <metrics.hpp>
+#include <trace.hpp>
+#include <algorithm>
+#include <iterator>
+#include <string>
 
 namespace Slicer {
 
-static const int numThreads = 1;
-
-TaskRunner::TaskRunner()
-    : m_threadpool{numThreads}
+TaskRunner::TaskRunner(int numThreads)
 {
+    const int numberOfWorkers = numThreads > 0 ? numThreads : defaultNumberOfThreads();
+
+    for (int i = 0; i < numberOfWorkers; ++i)
+        m_workerQueues.push_back(std::make_unique<WorkerQueues>());
+
+    m_activeWorkers = m_workerQueues.size();
+    m_maximumActiveWorkers = m_workerQueues.size();
+
+    m_threads.emplace_back([this]() {
+        Trace::setThreadName("Interactive worker");
+        runInteractiveWorker();
+    });
+
+    m_threads.emplace_back([this]() {
+        Trace::setThreadName("Slow worker");
+        runSlowWorker();
+    });
+
+    for (std::size_t i = 0; i < m_workerQueues.size(); ++i)
+        m_threads.emplace_back([this, i]() {
+            Trace::setThreadName("Worker " + std::to_string(i));
+            // Spread over the NUMA nodes, each worker rendering into memory of its own node
+            CpuResources::pinCurrentThreadToNode(i);
+            runWorker(i);
+        });
 }
 
 TaskRunner::~TaskRunner()
 {
-    m_threadpool.wait();
+    {
+        std::lock_guard<std::mutex> lock{m_sleepMutex};
+        m_isStopping = true;
+    }
+
+    m_workerCondition.notify_all();
+    m_interactiveCondition.notify_all();
+    m_slowCondition.notify_all();
+
+    for (std::thread& thread : m_threads)
+        thread.join();
+
+    // Results of pending tasks would have no main loop left to go to, so
+    // they are dropped with the queues
 }
 
-void TaskRunner::queueBack(const std::shared_ptr<Task>& task)
+void TaskRunner::queue(const std::shared_ptr<Task>& task, Priority priority, Affinity affinity)
 {
-    m_threadpool.push([task]() {
-        runTask(task);
-    });
+    if (Trace::isEnabled() || m_isTuning)
+        task->setQueuedTime(Trace::Clock::now());
+
+    if (priority == Priority::Interactive) {
+        {
+            // Counted before it can be taken, so the count never goes below zero
+            std::lock_guard<std::mutex> lock{m_interactiveMutex};
+            ++m_pendingInteractiveTasks;
+            m_interactiveQueue.push_back(task);
+        }
+
+        // A worker that just found nothing is either waiting by now, and
+        // gets the notification, or sees the count before it waits
+        {
+            std::lock_guard<std::mutex> lock{m_sleepMutex};
+        }
+
+        m_interactiveCondition.notify_one();
+        // A general worker may well be idle and get to it first
+        m_workerCondition.notify_one();
+        return;
+    }
+
+    const std::size_t worker = affinity != noAffinity ? affinity % m_workerQueues.size()
+                                                      : m_nextWorker++ % m_workerQueues.size();
+    WorkerQueues& workerQueues = *m_workerQueues.at(worker);
+
+    {
+        std::lock_guard<std::mutex> lock{workerQueues.mutex};
+        auto& queue = workerQueues.queues.at(static_cast<std::size_t>(priority) - 1);
+
+        // Ahead of the heavy tasks at the end, so cheap pages show up first
+        auto position = queue.end();
+        if (!task->isHeavy())
+            while (position != queue.begin() && (*std::prev(position))->isHeavy())
+                --position;
+
+        ++m_pendingTasks;
+        queue.insert(position, task);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{m_sleepMutex};
+    }
+
+    // Whoever wakes up steals it if it isn't the worker it's meant for. A
+    // held back worker would go back to sleep with the wake up, though.
+    if (m_activeWorkers < m_workerQueues.size())
+        m_workerCondition.notify_all();
+    else
+        m_workerCondition.notify_one();
+}
+
+void TaskRunner::queueSlow(const std::shared_ptr<Task>& task)
+{
+    if (Trace::isEnabled())
+        task->setQueuedTime(Trace::Clock::now());
+
+    {
+        std::lock_guard<std::mutex> lock{m_slowMutex};
+        ++m_pendingSlowTasks;
+        m_slowQueue.push_back(task);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{m_sleepMutex};
+    }
+
+    m_slowCondition.notify_one();
+}
+
+void TaskRunner::dropCanceledTasks()
+{
+    const auto isCanceled = [](const std::shared_ptr<Task>& task) { return task->isCanceled(); };
+
+    {
+        std::lock_guard<std::mutex> lock{m_interactiveMutex};
+        const auto it = std::remove_if(m_interactiveQueue.begin(), m_interactiveQueue.end(), isCanceled);
+        const auto dropped = static_cast<std::size_t>(std::distance(it, m_interactiveQueue.end()));
+        m_pendingInteractiveTasks -= dropped;
+        Metrics::add(Metrics::Counter::TasksCanceled, dropped);
+        m_interactiveQueue.erase(it, m_interactiveQueue.end());
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{m_slowMutex};
+        const auto it = std::remove_if(m_slowQueue.begin(), m_slowQueue.end(), isCanceled);
+        const auto dropped = static_cast<std::size_t>(std::distance(it, m_slowQueue.end()));
+        m_pendingSlowTasks -= dropped;
+        Metrics::add(Metrics::Counter::TasksCanceled, dropped);
+        m_slowQueue.erase(it, m_slowQueue.end());
+    }
+
+    for (auto& workerQueues : m_workerQueues) {
+        std::lock_guard<std::mutex> lock{workerQueues->mutex};
+
+        for (auto& queue : workerQueues->queues) {
+            const auto it = std::remove_if(queue.begin(), queue.end(), isCanceled);
+            const auto dropped = static_cast<std::size_t>(std::distance(it, queue.end()));
+            m_pendingTasks -= dropped;
+            Metrics::add(Metrics::Counter::TasksCanceled, dropped);
+            queue.erase(it, queue.end());
+        }
+    }
+}
+
+std::size_t TaskRunner::numberOfPendingTasks() const
+{
+    return m_pendingTasks + m_pendingInteractiveTasks + m_pendingSlowTasks;
+}
+
+int TaskRunner::numberOfThreads() const
+{
+    // The interactive and slow workers aren't counted, they're never there for most thumbnails
+    return static_cast<int>(m_workerQueues.size());
+}
+
+void TaskRunner::setActiveWorkers(int numberOfWorkers)
+{
+    const int clamped = std::clamp(numberOfWorkers, 1, this->numberOfThreads());
+    m_maximumActiveWorkers = static_cast<std::size_t>(clamped);
+
+    std::lock_guard<std::mutex> lock{m_tuningMutex};
+
+    if (!m_isTuning) {
+        applyActiveWorkers(static_cast<std::size_t>(clamped));
+        return;
+    }
+
+    m_tuner.setLimits(std::min(m_minimumTunedWorkers, clamped), clamped);
+    applyActiveWorkers(static_cast<std::size_t>(m_tuner.numberOfWorkers()));
+}
+
+int TaskRunner::maximumActiveWorkers() const
+{
+    return static_cast<int>(m_maximumActiveWorkers.load());
 }
 
-void TaskRunner::queueFront(const std::shared_ptr<Task>& task)
+int TaskRunner::numberOfActiveWorkers() const
 {
-    std::thread{[this, task]() {
-        m_threadpool.apply_for(1, [task]() {
+    return static_cast<int>(m_activeWorkers.load());
+}
+
+void TaskRunner::setTuning(bool isEnabled, int minimumWorkers)
+{
+    const int maximum = maximumActiveWorkers();
+
+    std::lock_guard<std::mutex> lock{m_tuningMutex};
+    m_minimumTunedWorkers = std::clamp(minimumWorkers, 1, this->numberOfThreads());
+
+    m_tuner = WorkerTuner{std::min(m_minimumTunedWorkers, maximum), maximum};
+    m_tasksRun = 0;
+    m_waitMicroseconds = 0;
+    m_ranOutOfTasks = false;
+    m_tuningStart = std::chrono::steady_clock::now();
+    m_isTuning = isEnabled;
+
+    applyActiveWorkers(static_cast<std::size_t>(isEnabled ? m_tuner.numberOfWorkers() : maximum));
+}
+
+bool TaskRunner::isTuning() const
+{
+    return m_isTuning;
+}
+
+int TaskRunner::defaultNumberOfThreads()
+{
+    // What a container's CPU quota allows, not every core of the host
+    return static_cast<int>(CpuResources::availableCores());
+}
+
+void TaskRunner::runInteractiveWorker()
+{
+    while (true) {
+        if (std::shared_ptr<Task> task = takeInteractiveTask(); task != nullptr) {
             runTask(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock{m_sleepMutex};
+        m_interactiveCondition.wait(lock, [this]() {
+            return m_isStopping || m_pendingInteractiveTasks > 0;
         });
-    }}
-        .detach();
+
+        if (m_isStopping)
+            return;
+    }
+}
+
+void TaskRunner::runSlowWorker()
+{
+    while (true) {
+        if (std::shared_ptr<Task> task = takeSlowTask(); task != nullptr) {
+            runTask(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock{m_sleepMutex};
+        m_slowCondition.wait(lock, [this]() {
+            return m_isStopping || m_pendingSlowTasks > 0;
+        });
+
+        if (m_isStopping)
+            return;
+    }
+}
+
+void TaskRunner::runWorker(std::size_t index)
+{
+    while (true) {
+        if (std::shared_ptr<Task> task = takeWorkerTask(index); task != nullptr) {
+            const bool isTuning = m_isTuning;
+
+            if (isTuning && task->queuedTime() != std::chrono::steady_clock::time_point{}) {
+                const auto wait = std::chrono::steady_clock::now() - task->queuedTime();
+                m_waitMicroseconds += static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(wait).count());
+            }
+
+            runTask(task);
+
+            if (isTuning) {
+                ++m_tasksRun;
+                tune();
+            }
+
+            continue;
+        }
+
+        // While it's let through, a worker with nothing to do means there are
+        // enough of them, whatever the throughput
+        if (index < m_activeWorkers)
+            m_ranOutOfTasks = true;
+
+        std::unique_lock<std::mutex> lock{m_sleepMutex};
+        m_workerCondition.wait(lock, [this, index]() {
+            return m_isStopping
+                   || (index < m_activeWorkers && (m_pendingTasks > 0 || m_pendingInteractiveTasks > 0));
+        });
+
+        if (m_isStopping)
+            return;
+    }
+}
+
+std::shared_ptr<Task> TaskRunner::takeInteractiveTask()
+{
+    std::lock_guard<std::mutex> lock{m_interactiveMutex};
+
+    while (!m_interactiveQueue.empty()) {
+        std::shared_ptr<Task> task = m_interactiveQueue.front();
+        m_interactiveQueue.pop_front();
+        --m_pendingInteractiveTasks;
+
+        if (!task->isCanceled())
+            return task;
+
+        Metrics::add(Metrics::Counter::TasksCanceled);
+    }
+
+    return nullptr;
+}
+
+std::shared_ptr<Task> TaskRunner::takeSlowTask()
+{
+    std::lock_guard<std::mutex> lock{m_slowMutex};
+
+    while (!m_slowQueue.empty()) {
+        std::shared_ptr<Task> task = m_slowQueue.front();
+        m_slowQueue.pop_front();
+        --m_pendingSlowTasks;
+
+        if (!task->isCanceled())
+            return task;
+
+        Metrics::add(Metrics::Counter::TasksCanceled);
+    }
+
+    return nullptr;
+}
+
+std::shared_ptr<Task> TaskRunner::takeWorkerTask(std::size_t index)
+{
+    // What's in its own deques gets stolen by the active ones
+    if (index >= m_activeWorkers)
+        return nullptr;
+
+    if (m_pendingInteractiveTasks > 0)
+        if (std::shared_ptr<Task> task = takeInteractiveTask(); task != nullptr)
+            return task;
+
+    const std::size_t numberOfWorkers = m_workerQueues.size();
+
+    // A whole priority class is looked through, own deque first, before
+    // anything of a lower one is taken
+    for (std::size_t priority = 0; priority < numberOfWorkerPriorities; ++priority) {
+        for (std::size_t offset = 0; offset < numberOfWorkers && m_pendingTasks > 0; ++offset) {
+            WorkerQueues& workerQueues = *m_workerQueues.at((index + offset) % numberOfWorkers);
+            std::lock_guard<std::mutex> lock{workerQueues.mutex};
+
+            // Stealing from the back leaves the victim the pages it was
+            // about to get to, whose files it's likely to have open
+            if (auto task = takeFrom(workerQueues.queues.at(priority), offset != 0); task != nullptr)
+                return task;
+        }
+    }
+
+    return nullptr;
+}
+
+std::shared_ptr<Task> TaskRunner::takeFrom(std::deque<std::shared_ptr<Task>>& queue, bool fromBack)
+{
+    while (!queue.empty()) {
+        std::shared_ptr<Task> task;
+
+        if (fromBack) {
+            task = queue.back();
+            queue.pop_back();
+        }
+        else {
+            task = queue.front();
+            queue.pop_front();
+        }
+
+        --m_pendingTasks;
+
+        // Tasks canceled while waiting are dropped without running them
+        if (!task->isCanceled())
+            return task;
+
+        Metrics::add(Metrics::Counter::TasksCanceled);
+    }
+
+    return nullptr;
 }
 
 void TaskRunner::runTask(const std::shared_ptr<Task>& task)
 {
-    if (task->isCanceled())
+    if (task->isCanceled()) {
+        Metrics::add(Metrics::Counter::TasksCanceled);
         return;
+    }
+
+    // Tasks queued before tracing was turned on have no time to go by
+    if (Trace::isEnabled() && task->queuedTime() != Trace::Clock::time_point{})
+        Trace::record("TaskRunner wait", task->queuedTime(), Trace::Clock::now());
 
-    task->execute();
+    {
+        const Trace::Span span{"TaskRunner run"};
+        task->execute();
+    }
 
     if (task->isCanceled())
         return;
 
-    Glib::signal_idle().connect([task]() {
-        if (!task->isCanceled())
-            task->postExecute();
+    m_completions->push(task);
+}
 
-        return false;
-    });
+void TaskRunner::tune()
+{
+    // Long enough for tasks of different costs to even out, short enough to
+    // follow a document that changes from vectors to scans
+    static constexpr auto interval = std::chrono::milliseconds{500};
+    static constexpr std::uint64_t minimumTasks = 16;
+
+    // Whichever worker gets here first does it, the others go on with their tasks
+    std::unique_lock<std::mutex> lock{m_tuningMutex, std::try_to_lock};
+    if (!lock.owns_lock() || !m_isTuning)
+        return;
+
+    const auto now = std::chrono::steady_clock::now();
+    const std::uint64_t tasksRun = m_tasksRun;
+    if (now - m_tuningStart < interval || tasksRun < minimumTasks)
+        return;
+
+    const double seconds = std::chrono::duration<double>(now - m_tuningStart).count();
+    const std::chrono::milliseconds meanWait{m_waitMicroseconds.exchange(0) / tasksRun / 1000};
+    m_tasksRun -= tasksRun;
+    m_tuningStart = now;
+
+    const int workers = m_tuner.update(static_cast<double>(tasksRun) / seconds, meanWait, m_ranOutOfTasks.exchange(false));
+
+    if (static_cast<std::size_t>(workers) != m_activeWorkers)
+        applyActiveWorkers(static_cast<std::size_t>(workers));
+}
+
+void TaskRunner::applyActiveWorkers(std::size_t numberOfWorkers)
+{
+    {
+        std::lock_guard<std::mutex> lock{m_sleepMutex};
+        m_activeWorkers = numberOfWorkers;
+    }
+
+    // The ones let through again may have work waiting
+    m_workerCondition.notify_all();
 }
 
 } // namespace Slicer
@@ -14,17 +14,44 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
+
 #ifndef SLICER_TASKRUNNER_HPP
 #define SLICER_TASKRUNNER_HPP
 
+#include "completionqueue.hpp"
 #include "task.hpp"
-#include <threadpool.hpp>
+#include <workertuner.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 namespace Slicer {
 
 class TaskRunner {
 public:
-	TaskRunner();
+    // Tasks of a higher priority class always start before those of a lower one
+    enum class Priority {
+        Interactive, // The page shown in a PreviewWindow
+        Visible, // Thumbnails inside the viewport
+        Prefetch, // Thumbnails kept ready around the viewport
+        Background, // Thumbnails of a window that isn't the active one
+        Idle, // Work no one waits for, such as indexing the text of pages
+    };
+
+    // Tasks with the same affinity go to the same worker while it keeps up,
+    // e.g. so that it reuses the poppler::document it already has open
+    using Affinity = std::size_t;
+    static constexpr Affinity noAffinity = std::numeric_limits<Affinity>::max();
+
+	explicit TaskRunner(int numThreads = defaultNumberOfThreads());
 
     TaskRunner(const TaskRunner&) = delete;
     TaskRunner& operator=(const TaskRunner&) = delete;
@@ -33,13 +60,102 @@ public:
 
 	~TaskRunner();
 
-	void queueBack(const std::shared_ptr<Task>& task);
-	void queueFront(const std::shared_ptr<Task>& task);
+	void queue(const std::shared_ptr<Task>& task, Priority priority, Affinity affinity = noAffinity);
+    // For tasks known to take long, like renders of pages that blew their
+    // budget: they run one at a time on a worker of their own, so they
+    // never hold up the others however few workers there are
+    void queueSlow(const std::shared_ptr<Task>& task);
+    // Removes the canceled tasks from the queues, so that they don't stand
+    // in front of the ones queued next
+    void dropCanceledTasks();
+
+    // Queued and not started yet, canceled ones included until they're dropped
+    std::size_t numberOfPendingTasks() const;
+
+    int numberOfThreads() const;
+    static int defaultNumberOfThreads();
+
+    // How many of the general workers may take tasks, for a render policy to
+    // save power or leave the cores to other applications. The others sleep
+    // until it's raised again. Interactive tasks are never held back.
+    void setActiveWorkers(int numberOfWorkers);
+    int maximumActiveWorkers() const;
+    // How many take tasks now, fewer than the maximum while tuning
+    int numberOfActiveWorkers() const;
+
+    // Tunes how many of the workers take tasks, between the minimum and the
+    // maximum above, to the throughput of the tasks that are running, see
+    // WorkerTuner. Off by default, when the maximum is what's active.
+    void setTuning(bool isEnabled, int minimumWorkers = 1);
+    bool isTuning() const;
 
 private:
-    static void runTask(const std::shared_ptr<Task>& task);
+    // Interactive tasks are few, so they share a single queue
+    static constexpr std::size_t numberOfWorkerPriorities = 4;
+
+    // A worker takes tasks from the front of its own deques, and steals
+    // from the back of the others' when it runs out
+    struct WorkerQueues {
+        std::mutex mutex;
+        std::array<std::deque<std::shared_ptr<Task>>, numberOfWorkerPriorities> queues;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueues>> m_workerQueues;
+    std::atomic<std::size_t> m_nextWorker = 0;
+
+    std::mutex m_interactiveMutex;
+    std::deque<std::shared_ptr<Task>> m_interactiveQueue;
+
+    std::mutex m_slowMutex;
+    std::deque<std::shared_ptr<Task>> m_slowQueue;
+
+    // Sleeping workers wait here, checking the pending counts under it.
+    // Queueing counts a task under the mutex of its queue, before pushing it,
+    // so that a count never goes below zero, then takes and drops
+    // m_sleepMutex before notifying: a worker that read the old count is
+    // then either waiting, and gets the notification, or not yet checking,
+    // and sees the new count. Notifying without that lock loses wake ups.
+    std::mutex m_sleepMutex;
+    std::condition_variable m_workerCondition;
+    std::condition_variable m_interactiveCondition;
+    std::condition_variable m_slowCondition;
+    std::atomic<std::size_t> m_pendingTasks = 0;
+    std::atomic<std::size_t> m_pendingInteractiveTasks = 0;
+    std::atomic<std::size_t> m_pendingSlowTasks = 0;
+    std::atomic<std::size_t> m_activeWorkers = 0;
+    std::atomic<std::size_t> m_maximumActiveWorkers = 0;
+    bool m_isStopping = false;
+
+    // What the general workers did since the last tuning, reset by the one
+    // worker that tunes, on its way back from a task
+    std::mutex m_tuningMutex;
+    WorkerTuner m_tuner{1, 1};
+    std::atomic<bool> m_isTuning = false;
+    int m_minimumTunedWorkers = 1;
+    std::atomic<std::uint64_t> m_tasksRun = 0;
+    std::atomic<std::uint64_t> m_waitMicroseconds = 0;
+    std::atomic<bool> m_ranOutOfTasks = false;
+    std::chrono::steady_clock::time_point m_tuningStart;
+
+    std::vector<std::thread> m_threads;
+
+    std::shared_ptr<CompletionQueue> m_completions = CompletionQueue::create();
+
+    // Besides the general workers, one thread only takes interactive tasks,
+    // so they never wait behind a long batch of thumbnails
+    void runInteractiveWorker();
+    void runSlowWorker();
+    void runWorker(std::size_t index);
+
+    std::shared_ptr<Task> takeInteractiveTask();
+    std::shared_ptr<Task> takeSlowTask();
+    std::shared_ptr<Task> takeWorkerTask(std::size_t index);
+    std::shared_ptr<Task> takeFrom(std::deque<std::shared_ptr<Task>>& queue, bool fromBack);
+
+    void runTask(const std::shared_ptr<Task>& task);
 
-	astp::ThreadPool m_threadpool;
+    void tune();
+    void applyActiveWorkers(std::size_t numberOfWorkers);
 };
 
 } // namespace Slicer
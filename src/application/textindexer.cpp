@@ -0,0 +1,232 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "textindexer.hpp"
+#include <popplerhandles.hpp>
+#include <trace.hpp>
+#include <algorithm>
+#include <stdexcept>
+
+namespace Slicer {
+
+TextIndexer::TextIndexer(TaskRunner& taskRunner)
+    : m_taskRunner{taskRunner}
+{
+}
+
+TextIndexer::~TextIndexer()
+{
+    ++*m_generation;
+    m_taskRunner.dropCanceledTasks();
+}
+
+void TextIndexer::index(const Document& document)
+{
+    struct UnreadPages {
+        std::string filePath;
+        std::vector<unsigned int> pages;
+    };
+    std::unordered_map<std::string, UnreadPages> unread;
+
+    // By row, without making a page for each
+    for (unsigned int i = 0; i < document.numberOfPages(); ++i) {
+        const PageListModel::Row& page = document.pages()->rowAt(i);
+        const std::string fileKey = fileKeyOf(page);
+        FileIndex& file = m_files[fileKey];
+        const unsigned int indexInFile = page.indexInFile();
+        file.key = {page.fileHash(), page.origin().size, page.origin().modificationTime};
+
+        // A file added twice has its pages twice in the document
+        if (file.index.isIndexed(indexInFile) || !file.queuedPages.insert(indexInFile).second)
+            continue;
+
+        UnreadPages& unreadPages = unread[fileKey];
+        unreadPages.filePath = page.filePath();
+        unreadPages.pages.push_back(indexInFile);
+    }
+
+    for (const auto& [fileKey, unreadPages] : unread) {
+        FileIndex& file = m_files.at(fileKey);
+
+        // Queued pages wait for what's stored to be loaded first
+        if (!file.isLoaded && !file.isLoading)
+            queueLoad(fileKey, unreadPages.filePath);
+        else if (file.isLoaded)
+            queueReads(fileKey, unreadPages.filePath, unreadPages.pages);
+    }
+}
+
+SelectionModel TextIndexer::find(const Document& document, const std::string& query) const
+{
+    // Pages of each file that match, in order
+    std::unordered_map<std::string, std::vector<unsigned int>> matches;
+    std::vector<unsigned int> indexes;
+
+    for (unsigned int i = 0; i < document.numberOfPages(); ++i) {
+        const PageListModel::Row& page = document.pages()->rowAt(i);
+        const std::string fileKey = fileKeyOf(page);
+        auto it = matches.find(fileKey);
+
+        if (it == matches.end()) {
+            const auto file = m_files.find(fileKey);
+            std::vector<unsigned int> pages = file != m_files.end() ? file->second.index.findPages(query)
+                                                                    : std::vector<unsigned int>{};
+            it = matches.emplace(fileKey, std::move(pages)).first;
+        }
+
+        if (std::binary_search(it->second.begin(), it->second.end(), page.indexInFile()))
+            indexes.push_back(i);
+    }
+
+    SelectionModel selection{document.numberOfPages()};
+    selection.selectOnly(indexes);
+
+    return selection;
+}
+
+unsigned int TextIndexer::numberOfIndexedPages(const Document& document) const
+{
+    unsigned int numberOfIndexedPages = 0;
+
+    for (unsigned int i = 0; i < document.numberOfPages(); ++i) {
+        const PageListModel::Row& page = document.pages()->rowAt(i);
+
+        if (const auto it = m_files.find(fileKeyOf(page));
+            it != m_files.end() && it->second.index.isIndexed(page.indexInFile()))
+            ++numberOfIndexedPages;
+    }
+
+    return numberOfIndexedPages;
+}
+
+bool TextIndexer::isReading() const
+{
+    return std::any_of(m_files.begin(), m_files.end(), [](const auto& file) {
+        return !file.second.queuedPages.empty();
+    });
+}
+
+std::string TextIndexer::fileKeyOf(const PageListModel::Row& page)
+{
+    const SourceFile::Origin& origin = page.origin();
+
+    return page.fileHash() + "-" + std::to_string(origin.size) + "-" + std::to_string(origin.modificationTime);
+}
+
+void TextIndexer::queueLoad(const std::string& fileKey, const std::string& filePath)
+{
+    FileIndex& loading = m_files.at(fileKey);
+    loading.isLoading = true;
+
+    auto loaded = std::make_shared<std::optional<TextIndex>>();
+
+    auto funcExecute = [key = loading.key, loaded]() {
+        *loaded = TextIndex::load(key);
+    };
+
+    auto funcPostExecute = [this, fileKey, filePath, loaded]() {
+        FileIndex& file = m_files.at(fileKey);
+        file.isLoading = false;
+        file.isLoaded = true;
+
+        if (loaded->has_value())
+            file.index.merge(loaded->value());
+
+        std::vector<unsigned int> unread;
+        for (auto it = file.queuedPages.begin(); it != file.queuedPages.end();) {
+            if (file.index.isIndexed(*it)) {
+                it = file.queuedPages.erase(it);
+                continue;
+            }
+
+            unread.push_back(*it);
+            ++it;
+        }
+
+        queueReads(fileKey, filePath, unread);
+    };
+
+    auto task = std::make_shared<Task>(funcExecute, funcPostExecute);
+    task->setGeneration(m_generation);
+    m_taskRunner.queue(task, TaskRunner::Priority::Idle);
+}
+
+void TextIndexer::queueReads(const std::string& fileKey,
+                             const std::string& filePath,
+                             const std::vector<unsigned int>& pages)
+{
+    std::vector<unsigned int> sortedPages = pages;
+    std::sort(sortedPages.begin(), sortedPages.end());
+
+    for (std::size_t first = 0; first < sortedPages.size(); first += pagesPerTask) {
+        const std::size_t last = std::min(first + pagesPerTask, sortedPages.size());
+        const std::vector<unsigned int> batch(sortedPages.begin() + static_cast<std::ptrdiff_t>(first),
+                                              sortedPages.begin() + static_cast<std::ptrdiff_t>(last));
+        auto read = std::make_shared<TextIndex>();
+
+        auto funcExecute = [filePath, batch, read]() {
+            const Trace::Span span{"TextIndexer page text"};
+
+            try {
+                for (const unsigned int page : batch) {
+                    // Through the worker's own handle, as when rendering
+                    const std::unique_ptr<poppler::page> ppage = PopplerHandles::createPage(filePath, page);
+                    const poppler::byte_array text = ppage->text().to_utf8();
+                    read->addPage(page, std::string{text.begin(), text.end()});
+                }
+            }
+            catch (const std::runtime_error&) {
+                // The file went away, or a page can't be loaded; what was read is kept
+            }
+        };
+
+        auto funcPostExecute = [this, fileKey, batch, read]() {
+            FileIndex& file = m_files.at(fileKey);
+            file.index.merge(*read);
+            file.hasNewPages = file.hasNewPages || read->numberOfIndexedPages() > 0;
+
+            // Those that couldn't be read are queued again the next time they're asked for
+            for (const unsigned int page : batch)
+                file.queuedPages.erase(page);
+
+            if (file.queuedPages.empty() && file.hasNewPages)
+                queueStore(file);
+        };
+
+        auto task = std::make_shared<Task>(funcExecute, funcPostExecute);
+        task->setGeneration(m_generation);
+        // Spread over every worker, each with its own poppler handle for the file
+        m_taskRunner.queue(task, TaskRunner::Priority::Idle);
+    }
+}
+
+void TextIndexer::queueStore(FileIndex& file)
+{
+    file.hasNewPages = false;
+
+    // The index keeps growing on this thread while it's written
+    auto snapshot = std::make_shared<const TextIndex>(file.index);
+
+    auto funcExecute = [key = file.key, snapshot]() {
+        TextIndex::store(key, *snapshot);
+    };
+
+    auto task = std::make_shared<Task>(funcExecute, []() {});
+    task->setGeneration(m_generation);
+    m_taskRunner.queue(task, TaskRunner::Priority::Idle);
+}
+
+} // namespace Slicer
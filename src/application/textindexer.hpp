@@ -0,0 +1,89 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef SLICER_TEXTINDEXER_HPP
+#define SLICER_TEXTINDEXER_HPP
+
+#include "taskrunner.hpp"
+#include <document.hpp>
+#include <selectionmodel.hpp>
+#include <textindex.hpp>
+#include <optional>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Slicer {
+
+// The text of the pages of every window, read once per file into a
+// TextIndex and looked up from there. Pages are read a few at a time on the
+// workers, at Priority::Idle, so reading never holds back a render. Like
+// SharedThumbnails, files are told apart by their contents, along with the
+// size and modification time of what they were read from, and indexes are
+// stored on disk next to the page index. Main thread only.
+class TextIndexer {
+public:
+    explicit TextIndexer(TaskRunner& taskRunner);
+
+    TextIndexer(const TextIndexer&) = delete;
+    TextIndexer& operator=(const TextIndexer&) = delete;
+    TextIndexer(TextIndexer&&) = delete;
+    TextIndexer& operator=(TextIndexer&& src) = delete;
+
+    ~TextIndexer();
+
+    // Queues the pages of document whose text hasn't been read yet
+    void index(const Document& document);
+    // A selection for document of the pages with the words of query one
+    // after the other. Pages whose text isn't read yet don't match.
+    SelectionModel find(const Document& document, const std::string& query) const;
+    unsigned int numberOfIndexedPages(const Document& document) const;
+    // Whether any page, of any document, is still to be read
+    bool isReading() const;
+
+    static constexpr unsigned int pagesPerTask = 16;
+
+private:
+    struct FileIndex {
+        // What the index is stored under
+        PageIndex::Key key;
+        TextIndex index;
+        // The stored index is loaded before any page is read
+        bool isLoading = false;
+        bool isLoaded = false;
+        // Being read, or waiting for the stored index to load
+        std::set<unsigned int> queuedPages;
+        // Read since the index was last stored
+        bool hasNewPages = false;
+    };
+
+    TaskRunner& m_taskRunner;
+    std::unordered_map<std::string, FileIndex> m_files;
+    // Moving it on cancels everything queued, so nothing calls back into a destroyed indexer
+    std::shared_ptr<std::atomic_uint> m_generation = std::make_shared<std::atomic_uint>(0);
+
+    // What m_files has the file of page under
+    static std::string fileKeyOf(const PageListModel::Row& page);
+
+    void queueLoad(const std::string& fileKey, const std::string& filePath);
+    void queueReads(const std::string& fileKey, const std::string& filePath, const std::vector<unsigned int>& pages);
+    void queueStore(FileIndex& file);
+};
+
+} // namespace Slicer
+
+#endif // SLICER_TEXTINDEXER_HPP
@@ -0,0 +1,376 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "tiledpageview.hpp"
+#include <pagerenderer.hpp>
+#include <cairomm/context.h>
+#include <glibmm/main.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <tuple>
+
+namespace Slicer {
+
+bool TiledPageView::TileKey::operator<(const TileKey& other) const
+{
+    return std::tie(targetSize, row, column) < std::tie(other.targetSize, other.row, other.column);
+}
+
+TiledPageView::TiledPageView(const Glib::RefPtr<const Page>& page,
+                             TaskRunner& taskRunner,
+                             int targetSize)
+    : m_page{page}
+    , m_taskRunner{taskRunner}
+    , m_targetSize{targetSize}
+    , m_size{page->scaledRotatedSize(targetSize)}
+    , m_tileTargetSize{targetSize}
+    , m_tileLayerSize{m_size}
+{
+    set_size_request(m_size.width, m_size.height);
+    set_valign(Gtk::ALIGN_CENTER);
+    set_halign(Gtk::ALIGN_CENTER);
+
+    queueOverview();
+}
+
+TiledPageView::~TiledPageView()
+{
+    m_sizeSettleConnection.disconnect();
+    cancelRendering();
+}
+
+void TiledPageView::changeSize(int targetSize)
+{
+    if (targetSize == m_targetSize)
+        return;
+
+    m_targetSize = targetSize;
+    m_size = m_page->scaledRotatedSize(m_targetSize);
+    set_size_request(m_size.width, m_size.height);
+
+    m_isSizeSettling = true;
+    m_sizeSettleConnection.disconnect();
+    m_sizeSettleConnection = Glib::signal_timeout().connect([this]() {
+        onSizeSettled();
+        return false;
+    },
+                                                            sizeSettleDelay);
+
+    if (!m_overview)
+        queueOverview();
+
+    queue_draw();
+}
+
+void TiledPageView::onSizeSettled()
+{
+    m_isSizeSettling = false;
+
+    if (const int tileTargetSize = closestTileTargetSize(); tileTargetSize != m_tileTargetSize) {
+        // Tiles of the old size stay cached, but aren't needed anymore right now
+        cancelRendering();
+
+        m_tileTargetSize = tileTargetSize;
+        m_tileLayerSize = m_page->scaledRotatedSize(m_tileTargetSize);
+    }
+
+    queuePrefetch();
+    queue_draw();
+}
+
+int TiledPageView::closestTileTargetSize() const
+{
+    auto changeTo = [this](int tileTargetSize) {
+        return std::abs(static_cast<double>(m_targetSize) / tileTargetSize - 1.0);
+    };
+
+    int closest = m_tileTargetSize;
+
+    // Keys are ordered by size first, so each size comes up in a run
+    constexpr int lastPosition = std::numeric_limits<int>::max();
+
+    for (auto it = m_tiles.begin(); it != m_tiles.end();) {
+        const int tileTargetSize = it->first.targetSize;
+
+        if (changeTo(tileTargetSize) < changeTo(closest))
+            closest = tileTargetSize;
+
+        it = m_tiles.upper_bound({tileTargetSize, lastPosition, lastPosition});
+    }
+
+    if (changeTo(closest) < retileThreshold)
+        return closest;
+
+    return m_targetSize;
+}
+
+void TiledPageView::cancelRendering()
+{
+    ++*m_renderGeneration;
+    m_queuedTiles.clear();
+    m_isOverviewQueued = false;
+
+    m_taskRunner.dropCanceledTasks();
+}
+
+void TiledPageView::prefetch(int viewportWidth, int viewportHeight)
+{
+    m_prefetchViewport = Page::Size{viewportWidth, viewportHeight};
+    queuePrefetch();
+}
+
+void TiledPageView::queuePrefetch()
+{
+    if (!m_prefetchViewport.has_value() || m_isSizeSettling)
+        return;
+
+    const double scaleX = static_cast<double>(m_size.width) / m_tileLayerSize.width;
+    const double scaleY = static_cast<double>(m_size.height) / m_tileLayerSize.height;
+    const int width = std::min(m_size.width, m_prefetchViewport->width);
+    const int height = std::min(m_size.height, m_prefetchViewport->height);
+
+    const int lastColumn = (m_tileLayerSize.width - 1) / tileSize;
+    const int lastRow = (m_tileLayerSize.height - 1) / tileSize;
+    const int lastPrefetchedColumn = std::clamp(static_cast<int>(width / scaleX - 1) / tileSize, 0, lastColumn);
+    const int lastPrefetchedRow = std::clamp(static_cast<int>(height / scaleY - 1) / tileSize, 0, lastRow);
+
+    for (int row = 0; row <= lastPrefetchedRow; ++row) {
+        for (int column = 0; column <= lastPrefetchedColumn; ++column) {
+            const TileKey key{m_tileTargetSize, column, row};
+
+            if (m_tiles.count(key) == 0)
+                queueTile(key, TaskRunner::Priority::Visible);
+        }
+    }
+}
+
+bool TiledPageView::on_draw(const Cairo::RefPtr<Cairo::Context>& cr)
+{
+    // On screen now, so what's exposed decides what gets rendered
+    m_prefetchViewport.reset();
+
+    // Only what's exposed, which inside a scrolled window is about what's on screen
+    double clipLeft = 0, clipTop = 0, clipRight = 0, clipBottom = 0;
+    cr->get_clip_extents(clipLeft, clipTop, clipRight, clipBottom);
+
+    // Tiles may be of another size than the page on screen, stretched to it
+    const double scaleX = static_cast<double>(m_size.width) / m_tileLayerSize.width;
+    const double scaleY = static_cast<double>(m_size.height) / m_tileLayerSize.height;
+    clipLeft /= scaleX;
+    clipRight /= scaleX;
+    clipTop /= scaleY;
+    clipBottom /= scaleY;
+
+    const int lastColumn = (m_tileLayerSize.width - 1) / tileSize;
+    const int lastRow = (m_tileLayerSize.height - 1) / tileSize;
+    const int firstVisibleColumn = std::clamp(static_cast<int>(clipLeft) / tileSize, 0, lastColumn);
+    const int lastVisibleColumn = std::clamp(static_cast<int>(clipRight - 1) / tileSize, 0, lastColumn);
+    const int firstVisibleRow = std::clamp(static_cast<int>(clipTop) / tileSize, 0, lastRow);
+    const int lastVisibleRow = std::clamp(static_cast<int>(clipBottom - 1) / tileSize, 0, lastRow);
+
+    bool isAnyTileMissing = false;
+
+    for (int row = firstVisibleRow; row <= lastVisibleRow; ++row) {
+        for (int column = firstVisibleColumn; column <= lastVisibleColumn; ++column) {
+            const TileKey key{m_tileTargetSize, column, row};
+
+            if (auto it = m_tiles.find(key); it != m_tiles.end()) {
+                touchTile(it->second);
+                continue;
+            }
+
+            isAnyTileMissing = true;
+
+            // Mid zoom, they'd likely be for a size that's about to change
+            if (!m_isSizeSettling)
+                queueTile(key, TaskRunner::Priority::Interactive);
+        }
+    }
+
+    if (isAnyTileMissing)
+        drawOverview(cr);
+
+    cr->save();
+    cr->scale(scaleX, scaleY);
+
+    for (int row = firstVisibleRow; row <= lastVisibleRow; ++row) {
+        for (int column = firstVisibleColumn; column <= lastVisibleColumn; ++column) {
+            if (auto it = m_tiles.find({m_tileTargetSize, column, row}); it != m_tiles.end()) {
+                cr->set_source(it->second.surface, column * tileSize, row * tileSize);
+                // Keeps seams from showing between stretched tiles
+                cr->get_source()->set_extend(Cairo::EXTEND_PAD);
+                cr->rectangle(column * tileSize,
+                              row * tileSize,
+                              it->second.width,
+                              it->second.height);
+                cr->fill();
+            }
+        }
+    }
+
+    cr->restore();
+
+    // The ring around what's on screen, ready for scrolling
+    for (int row = firstVisibleRow - 1; row <= lastVisibleRow + 1 && !m_isSizeSettling; ++row) {
+        for (int column = firstVisibleColumn - 1; column <= lastVisibleColumn + 1; ++column) {
+            const bool isInside = row >= 0 && row <= lastRow && column >= 0 && column <= lastColumn;
+            const TileKey key{m_tileTargetSize, column, row};
+
+            if (isInside && m_tiles.count(key) == 0)
+                queueTile(key, TaskRunner::Priority::Visible);
+        }
+    }
+
+    cr->set_line_width(1);
+    cr->set_source_rgb(0, 0, 0);
+    cr->rectangle(0.5, 0.5, m_size.width - 1, m_size.height - 1);
+    cr->stroke();
+
+    return true;
+}
+
+void TiledPageView::queueOverview()
+{
+    if (m_isOverviewQueued)
+        return;
+
+    m_isOverviewQueued = true;
+
+    auto overview = std::make_shared<Cairo::RefPtr<Cairo::ImageSurface>>();
+    const Glib::RefPtr<const Page> page = m_page;
+
+    auto funcExecute = [page, overview]() {
+        *overview = PageRenderer{page}.renderToSurface(overviewSize);
+    };
+
+    auto funcPostExecute = [this, overview]() {
+        if (*overview) {
+            m_overview = toWindowSurface(*overview);
+            m_overviewSize = {(*overview)->get_width(), (*overview)->get_height()};
+        }
+
+        m_isOverviewQueued = false;
+        queue_draw();
+    };
+
+    auto task = std::make_shared<Task>(funcExecute, funcPostExecute);
+    task->setGeneration(m_renderGeneration);
+    m_taskRunner.queue(task, TaskRunner::Priority::Interactive);
+}
+
+void TiledPageView::queueTile(const TileKey& key, TaskRunner::Priority priority)
+{
+    if (!m_queuedTiles.insert(key).second)
+        return;
+
+    auto surface = std::make_shared<Cairo::RefPtr<Cairo::ImageSurface>>();
+    const Glib::RefPtr<const Page> page = m_page;
+
+    auto funcExecute = [page, key, surface]() {
+        *surface = PageRenderer{page}.renderRegionToSurface(key.targetSize,
+                                                            key.column * tileSize,
+                                                            key.row * tileSize,
+                                                            tileSize,
+                                                            tileSize);
+    };
+
+    auto funcPostExecute = [this, key, surface]() {
+        m_queuedTiles.erase(key);
+        insertTile(key, *surface);
+
+        if (key.targetSize == m_tileTargetSize) {
+            const double scaleX = static_cast<double>(m_size.width) / m_tileLayerSize.width;
+            const double scaleY = static_cast<double>(m_size.height) / m_tileLayerSize.height;
+
+            queue_draw_area(static_cast<int>(std::floor(key.column * tileSize * scaleX)),
+                            static_cast<int>(std::floor(key.row * tileSize * scaleY)),
+                            static_cast<int>(std::ceil(tileSize * scaleX)) + 1,
+                            static_cast<int>(std::ceil(tileSize * scaleY)) + 1);
+        }
+    };
+
+    auto task = std::make_shared<Task>(funcExecute, funcPostExecute);
+    task->setGeneration(m_renderGeneration);
+    // Tiles go to every worker; there's a single file behind them
+    m_taskRunner.queue(task, priority);
+}
+
+void TiledPageView::insertTile(const TileKey& key, const Cairo::RefPtr<Cairo::ImageSurface>& surface)
+{
+    if (!surface || m_tiles.count(key) != 0)
+        return;
+
+    const std::size_t sizeInBytes = static_cast<std::size_t>(surface->get_stride()) * static_cast<std::size_t>(surface->get_height());
+
+    m_recentTiles.push_front(key);
+    m_tiles.emplace(key, Tile{toWindowSurface(surface), surface->get_width(), surface->get_height(), sizeInBytes, m_recentTiles.begin()});
+    m_tilesSizeInBytes += sizeInBytes;
+
+    evictTiles();
+}
+
+Cairo::RefPtr<Cairo::Surface> TiledPageView::toWindowSurface(const Cairo::RefPtr<Cairo::ImageSurface>& surface) const
+{
+    Glib::RefPtr<const Gdk::Window> window = get_window();
+
+    if (!window)
+        return surface;
+
+    Cairo::RefPtr<Cairo::Surface> windowSurface = window->create_similar_surface(surface->get_content(),
+                                                                                 surface->get_width(),
+                                                                                 surface->get_height());
+    auto cr = Cairo::Context::create(windowSurface);
+    cr->set_source(surface, 0, 0);
+    cr->paint();
+
+    return windowSurface;
+}
+
+void TiledPageView::touchTile(Tile& tile)
+{
+    m_recentTiles.splice(m_recentTiles.begin(), m_recentTiles, tile.recentPosition);
+}
+
+void TiledPageView::evictTiles()
+{
+    while (m_tilesSizeInBytes > tileCacheCapacity && m_recentTiles.size() > 1) {
+        auto it = m_tiles.find(m_recentTiles.back());
+        m_tilesSizeInBytes -= it->second.sizeInBytes;
+        m_tiles.erase(it);
+        m_recentTiles.pop_back();
+    }
+}
+
+void TiledPageView::drawOverview(const Cairo::RefPtr<Cairo::Context>& cr) const
+{
+    cr->save();
+
+    if (m_overview) {
+        cr->scale(static_cast<double>(m_size.width) / m_overviewSize.width,
+                  static_cast<double>(m_size.height) / m_overviewSize.height);
+        cr->set_source(m_overview, 0, 0);
+    }
+    else {
+        cr->set_source_rgb(1, 1, 1);
+    }
+
+    cr->paint();
+    cr->restore();
+}
+
+} // namespace Slicer
@@ -0,0 +1,132 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef SLICER_TILEDPAGEVIEW_HPP
+#define SLICER_TILEDPAGEVIEW_HPP
+
+#include "taskrunner.hpp"
+#include <page.hpp>
+#include <cairomm/surface.h>
+#include <gtkmm/drawingarea.h>
+#include <list>
+#include <map>
+#include <optional>
+#include <set>
+
+namespace Slicer {
+
+// Shows a page at a large size by rendering it in fixed-size tiles, on as
+// many workers as there are. Only tiles that are exposed get rendered,
+// those on screen first and a ring around them after. Tiles of every size
+// are kept up to a fixed memory budget, so zooming back is immediate.
+// Until its tiles arrive, a part of the page shows a small render of the
+// whole page, stretched. While the size keeps changing, the tiles there are
+// get stretched too; the size they're taken from only moves once it settles,
+// and not at all for a small step, or one towards a size that's cached.
+// A view that isn't on screen yet can be asked to have the tiles it would
+// first show ready, at the size it has, for when it is.
+class TiledPageView : public Gtk::DrawingArea {
+public:
+    TiledPageView(const Glib::RefPtr<const Page>& page,
+                  TaskRunner& taskRunner,
+                  int targetSize);
+
+    TiledPageView(const TiledPageView&) = delete;
+    TiledPageView& operator=(const TiledPageView&) = delete;
+    TiledPageView(TiledPageView&&) = delete;
+    TiledPageView& operator=(TiledPageView&& src) = delete;
+
+    ~TiledPageView() override;
+
+    void changeSize(int targetSize);
+    void cancelRendering();
+    // Renders the tiles a viewport of that size would show of the page
+    // scrolled to its top left, again after every size change, until
+    // the view is first drawn
+    void prefetch(int viewportWidth, int viewportHeight);
+
+    static constexpr int tileSize = 256;
+    static constexpr int overviewSize = 600;
+    static constexpr std::size_t tileCacheCapacity = 64 * 1024 * 1024;
+    static constexpr unsigned int sizeSettleDelay = 200;
+    static constexpr double retileThreshold = 0.15;
+
+protected:
+    bool on_draw(const Cairo::RefPtr<Cairo::Context>& cr) override;
+
+private:
+    struct TileKey {
+        int targetSize;
+        int column;
+        int row;
+
+        bool operator<(const TileKey& other) const;
+    };
+
+    struct Tile {
+        // Like the window's, see toWindowSurface()
+        Cairo::RefPtr<Cairo::Surface> surface;
+        int width;
+        int height;
+        // As it was rendered, wherever it's kept now
+        std::size_t sizeInBytes;
+        std::list<TileKey>::iterator recentPosition;
+    };
+
+    Glib::RefPtr<const Page> m_page;
+    TaskRunner& m_taskRunner;
+    int m_targetSize;
+    Page::Size m_size;
+    // The size tiles are rendered for, and the page at that size
+    int m_tileTargetSize;
+    Page::Size m_tileLayerSize;
+    bool m_isSizeSettling = false;
+    sigc::connection m_sizeSettleConnection;
+
+    // Moving it on cancels everything this view has queued
+    std::shared_ptr<std::atomic_uint> m_renderGeneration = std::make_shared<std::atomic_uint>(0);
+
+    std::map<TileKey, Tile> m_tiles;
+    // Most recently drawn at the front
+    std::list<TileKey> m_recentTiles;
+    std::size_t m_tilesSizeInBytes = 0;
+    std::set<TileKey> m_queuedTiles;
+
+    Cairo::RefPtr<Cairo::Surface> m_overview;
+    Page::Size m_overviewSize{0, 0};
+    bool m_isOverviewQueued = false;
+
+    std::optional<Page::Size> m_prefetchViewport;
+
+    void onSizeSettled();
+    int closestTileTargetSize() const;
+    void queueOverview();
+    void queuePrefetch();
+    void queueTile(const TileKey& key, TaskRunner::Priority priority);
+    void insertTile(const TileKey& key, const Cairo::RefPtr<Cairo::ImageSurface>& surface);
+    // Copies a render, once, into a surface like the window's, so that
+    // drawing it doesn't upload its pixels every time; on X11 they stay
+    // on the server. The render itself if the view has no window yet.
+    Cairo::RefPtr<Cairo::Surface> toWindowSurface(const Cairo::RefPtr<Cairo::ImageSurface>& surface) const;
+    void touchTile(Tile& tile);
+    void evictTiles();
+    void drawOverview(const Cairo::RefPtr<Cairo::Context>& cr) const;
+};
+
+} // namespace Slicer
+
+#endif // SLICER_TILEDPAGEVIEW_HPP
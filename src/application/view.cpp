@@ -15,53 +15,103 @@
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "view.hpp"
-#include "previewwindow.hpp"
+#include "frameprofiler.hpp"
+#include "zoomlevel.hpp"
+#include <metrics.hpp>
+#include <pagerenderer.hpp>
+#include <renderbufferpool.hpp>
 #include <glibmm/main.h>
-#include <range/v3/view.hpp>
-#include <range/v3/range/conversion.hpp>
+#include <gtkmm/window.h>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iterator>
 
 namespace Slicer {
 
-namespace rsv = ranges::views;
+static const int cellHorizontalMargin = 10;
+static const int rowSpacing = 5;
 
 View::View(TaskRunner& taskRunner,
-           const std::function<void()>& onMouseWheelUp,
-           const std::function<void()>& onMouseWheelDown)
+           SharedThumbnails& thumbnails,
+           const std::function<void(double)>& onZoom)
     : m_taskRunner{taskRunner}
+    , m_thumbnails{thumbnails}
 {
-    setupFlowbox();
-    setupSignalHandlers(onMouseWheelUp, onMouseWheelDown);
+    setupGrid();
+    setupSignalHandlers(onZoom);
 }
 
-void View::setupFlowbox()
+void View::setupGrid()
 {
-    m_flowBox.set_row_spacing(5);
-    m_flowBox.set_selection_mode(Gtk::SELECTION_NONE);
-    m_flowBox.set_sort_func(&sortFunction);
+    m_grid.set_halign(Gtk::ALIGN_START);
+    m_grid.set_valign(Gtk::ALIGN_START);
 
-    add(m_flowBox);
+    m_previewButton.set_image_from_icon_name("system-search-symbolic");
+    m_previewButton.set_can_focus(false);
+    m_previewButtonRevealer.add(m_previewButton);
+    m_previewButtonRevealer.set_transition_type(Gtk::REVEALER_TRANSITION_TYPE_CROSSFADE);
+    m_previewButtonRevealer.set_no_show_all();
+    m_previewButton.show();
+
+    m_gridOverlay.add(m_grid);
+    m_gridOverlay.add_overlay(m_previewButtonRevealer);
+    m_gridOverlay.signal_get_child_position().connect(sigc::mem_fun(*this, &View::placePreviewButton));
+
+    add(m_gridOverlay);
 }
 
-void View::setupSignalHandlers(const std::function<void()>& onMouseWheelUp,
-                               const std::function<void()>& onMouseWheelDown)
+void View::setupSignalHandlers(const std::function<void(double)>& onZoom)
 {
-    add_events(Gdk::SCROLL_MASK | Gdk::SMOOTH_SCROLL_MASK);
+    add_events(Gdk::SCROLL_MASK | Gdk::SMOOTH_SCROLL_MASK | Gdk::KEY_PRESS_MASK);
 
-    signal_scroll_event().connect([onMouseWheelUp, onMouseWheelDown](GdkEventScroll* event) {
-        if ((event->state & Gdk::CONTROL_MASK) != 0) {
-            if (event->delta_y < 0) {
-                onMouseWheelUp();
-                return true;
-            }
+    signal_scroll_event().connect([onZoom](GdkEventScroll* event) {
+        if ((event->state & Gdk::CONTROL_MASK) == 0)
+            return false;
 
-            if (event->delta_y > 0) {
-                onMouseWheelDown();
-                return true;
-            }
-        }
+        if (const double factor = ZoomLevel::scrollFactor(event); factor != 1.0)
+            onZoom(factor);
+
+        return true;
+    });
+
+    // The gesture reports the scale since it began; pass on each step of it
+    m_zoomGesture = Gtk::GestureZoom::create(*this);
+    m_zoomGesture->signal_begin().connect([this](GdkEventSequence*) {
+        m_lastGestureScale = 1.0;
+    });
+    m_zoomGesture->signal_scale_changed().connect([this, onZoom](double scale) {
+        if (scale <= 0 || m_lastGestureScale <= 0)
+            return;
+
+        onZoom(scale / m_lastGestureScale);
+        m_lastGestureScale = scale;
+    });
+
+    signal_key_press_event().connect(sigc::mem_fun(*this, &View::onKeyPress));
+
+    // Going from a cell to the button over it leaves the cell
+    m_previewButton.signal_enter_notify_event().connect([this](GdkEventCrossing*) {
+        m_previewButtonRevealer.set_reveal_child(true);
 
         return false;
     });
+
+    m_previewButton.signal_clicked().connect([this]() {
+        if (m_hoveredWidget != nullptr)
+            onPreviewRequested(m_hoveredWidget->page());
+    });
+
+    // Faded out, it's hidden, so that it doesn't take the clicks meant for the cell under it
+    m_previewButtonRevealer.property_child_revealed().signal_changed().connect([this]() {
+        if (!m_previewButtonRevealer.get_child_revealed())
+            m_previewButtonRevealer.hide();
+    });
+
+    // The number of columns depends on the width we're given
+    signal_size_allocate().connect([this](Gtk::Allocation&) {
+        queueLayoutUpdate();
+    });
 }
 
 View::~View()
@@ -69,7 +119,116 @@ View::~View()
     for (sigc::connection& connection : m_documentConnections)
         connection.disconnect();
 
+    for (sigc::connection& connection : m_adjustmentConnections)
+        connection.disconnect();
+
+    m_layoutUpdateConnection.disconnect();
+    m_zoomSettleConnection.disconnect();
+    m_scrollSettleConnection.disconnect();
+    cancelRenderingTasks();
+}
+
+void View::setScrollAdjustment(const Glib::RefPtr<Gtk::Adjustment>& adjustment)
+{
+    for (sigc::connection& connection : m_adjustmentConnections)
+        connection.disconnect();
+
+    m_adjustmentConnections.clear();
+    m_vadjustment = adjustment;
+    m_scrollPredictor.reset();
+
+    if (m_vadjustment) {
+        m_adjustmentConnections.emplace_back(
+            m_vadjustment->signal_value_changed().connect(sigc::mem_fun(*this, &View::onScrolled)));
+        m_adjustmentConnections.emplace_back(
+            m_vadjustment->signal_changed().connect([this]() {
+                // The positions measured so far are of another layout
+                m_scrollPredictor.reset();
+                queueLayoutUpdate();
+            }));
+    }
+
+    queueLayoutUpdate();
+}
+
+void View::onScrolled()
+{
+    m_scrollPredictor.addSample(m_vadjustment->get_value(), ScrollPredictor::Clock::now());
+
+    // Once it stops, the pages around it are rendered on every side again
+    m_scrollSettleConnection.disconnect();
+    m_scrollSettleConnection = Glib::signal_timeout().connect([this]() {
+        queueLayoutUpdate();
+        return false;
+    },
+                                                              static_cast<unsigned int>(ScrollPredictor::idleTime.count()) + 1);
+
+    queueLayoutUpdate();
+}
+
+void View::setPrefetchMargin(double viewportFraction)
+{
+    m_prefetchMargin = std::max(0.0, viewportFraction);
+
+    queueLayoutUpdate();
+}
+
+void View::setZoomLevels(const std::vector<int>& zoomLevels)
+{
+    m_zoomLevels = zoomLevels;
+    std::sort(m_zoomLevels.begin(), m_zoomLevels.end());
+
+    queueLayoutUpdate();
+}
+
+std::size_t View::thumbnailCacheSizeInBytes() const
+{
+    const ThumbnailCache& cache = m_thumbnails.cache();
+
+    return cache.sizeInBytes() + cache.compressedSizeInBytes();
+}
+
+std::size_t View::numberOfRendersInFlight() const
+{
+    return m_thumbnails.numberOfRendersInFlight();
+}
+
+bool View::isAnyThumbnailShown() const
+{
+    return std::any_of(m_boundWidgets.begin(), m_boundWidgets.end(), [](const auto& bound) {
+        return bound.second->isThumbnailVisible();
+    });
+}
+
+bool View::areVisibleThumbnailsSharp() const
+{
+    if (m_document == nullptr || m_isZoomSettling || m_layoutUpdateConnection.connected())
+        return false;
+
+    for (unsigned int i = m_firstVisible; i <= m_lastVisible && i < m_pageOrder.size(); ++i) {
+        const auto it = m_boundWidgets.find(m_pageOrder.at(i));
+        if (it == m_boundWidgets.end() || !it->second->isUpToDate())
+            return false;
+    }
+
+    return true;
+}
+
+void View::rescheduleRenders()
+{
     cancelRenderingTasks();
+    queueLayoutUpdate();
+}
+
+void View::releaseMemory()
+{
+    m_thumbnails.prerender({});
+    m_thumbnails.cache().clear();
+
+    for (auto& pageWidget : m_pageWidgets) {
+        if (m_boundWidgets.count(pageWidget->page()->listKey()) == 0)
+            pageWidget->releaseThumbnail();
+    }
 }
 
 std::shared_ptr<InteractivePageWidget> View::createPageWidget(const Glib::RefPtr<const Page>& page)
@@ -79,24 +238,67 @@ std::shared_ptr<InteractivePageWidget> View::createPageWidget(const Glib::RefPtr
     pageWidget->selectedChanged.connect(sigc::mem_fun(*this, &View::onPageSelection));
     pageWidget->shiftSelected.connect(sigc::mem_fun(*this, &View::onShiftSelection));
     pageWidget->previewRequested.connect(sigc::mem_fun(*this, &View::onPreviewRequested));
+    pageWidget->hoverChanged.connect(sigc::mem_fun(*this, &View::onHoverChanged));
+
+    pageWidget->signal_focus_in_event().connect([this, widget = pageWidget.get()](GdkEventFocus*) {
+        m_focusedPage = indexOf(*widget);
+        return false;
+    });
+
+    if (m_labelsHeight == 0)
+        m_labelsHeight = pageWidget->labelsHeight();
+
+    m_grid.put(*pageWidget, 0, 0);
+    m_widgetPositions[pageWidget.get()] = {0, 0};
 
     return pageWidget;
 }
 
+std::shared_ptr<InteractivePageWidget> View::findBoundWidget(unsigned int index) const
+{
+    // Plain vector lookup: no trip through the list model, no reference counting
+    if (index >= m_pageOrder.size())
+        return nullptr;
+
+    if (auto it = m_boundWidgets.find(m_pageOrder[index]); it != m_boundWidgets.end())
+        return it->second;
+
+    return nullptr;
+}
+
+unsigned int View::indexOf(const InteractivePageWidget& pageWidget) const
+{
+    return pageWidget.page()->getDocumentIndex();
+}
+
 void View::clearState()
 {
     cancelRenderingTasks();
-    clearSelection();
 
-    for (Gtk::Widget* child : m_flowBox.get_children())
-        m_flowBox.remove(*child);
+    m_zoomSettleConnection.disconnect();
+    m_isZoomSettling = false;
+
+    hidePreviewButton();
+
+    for (auto& pageWidget : m_pageWidgets)
+        m_grid.remove(*pageWidget);
 
     m_pageWidgets.clear();
+    m_widgetPositions.clear();
+    m_boundWidgets.clear();
+    m_selection.reset(0);
+    m_pageOrder.clear();
+    m_lastPageSelected.reset();
+    m_focusedPage.reset();
 
     for (sigc::connection& connection : m_documentConnections)
         connection.disconnect();
 
     m_documentConnections.clear();
+
+    // Its pages were of the document that's going away
+    if (m_previewWindow)
+        m_previewWindow->hide();
 }
 
 void View::setDocument(Document& document, int targetWidgetSize)
@@ -105,17 +307,13 @@ void View::setDocument(Document& document, int targetWidgetSize)
 
     m_document = &document;
     m_pageWidgetSize = targetWidgetSize;
-
-    for (unsigned int i = 0; i < m_document->numberOfPages(); ++i) {
-        auto page = m_document->getPage(i);
-        std::shared_ptr<InteractivePageWidget> pageWidget = createPageWidget(page);
-        m_pageWidgets.push_back(pageWidget);
-        m_flowBox.add(*pageWidget);
-        renderPage(pageWidget);
-
-        if (i == 0)
-            pageWidget->grab_focus();
-    }
+    m_selection.reset(m_document->numberOfPages());
+    m_pageOrder.clear();
+    m_pageOrder.reserve(m_document->numberOfPages());
+    for (unsigned int i = 0; i < m_document->numberOfPages(); ++i)
+        m_pageOrder.push_back(m_document->pages()->rowAt(i).key());
+    m_focusFirstPageOnLayout = true;
+    updateRenderBufferSizeClass();
 
     m_documentConnections.emplace_back(
         m_document->pages()->signal_items_changed().connect(sigc::mem_fun(*this, &View::onModelItemsChanged)));
@@ -124,19 +322,71 @@ void View::setDocument(Document& document, int targetWidgetSize)
     m_documentConnections.emplace_back(
         m_document->pagesReordered.connect(sigc::mem_fun(*this, &View::onModelPagesReordered)));
     selectedPagesChanged.emit();
+
+    queueLayoutUpdate();
 }
 
 void View::changePageSize(int targetWidgetSize)
 {
+    if (targetWidgetSize == m_pageWidgetSize)
+        return;
+
+    const FrameProfiler::Scope scope{FrameProfiler::Work::Layout};
+
     cancelRenderingTasks();
 
     m_pageWidgetSize = targetWidgetSize;
 
-    for (auto& pageWidget : m_pageWidgets) {
+    // Stretch what's on screen right away; the sharp renders wait until
+    // the size settles, so a gesture doesn't queue one per step. Spare
+    // widgets are resized once they're bound again, if ever, rather than
+    // each queuing a resize of the grid for nothing.
+    for (auto& [key, pageWidget] : m_boundWidgets) {
         pageWidget->changeSize(m_pageWidgetSize);
-        pageWidget->showSpinner();
-        renderPage(pageWidget);
+        pageWidget->showScaledThumbnail();
+    }
+
+    m_isZoomSettling = true;
+    m_zoomSettleConnection.disconnect();
+    m_zoomSettleConnection = Glib::signal_timeout().connect([this]() {
+        onZoomSettled();
+        return false;
+    },
+                                                            zoomSettleDelay);
+
+    queueLayoutUpdate();
+}
+
+void View::onZoomSettled()
+{
+    m_isZoomSettling = false;
+    updateRenderBufferSizeClass();
+
+    // A small step from the size that was rendered isn't worth rendering for
+    for (auto& [key, pageWidget] : m_boundWidgets) {
+        const int renderedSize = pageWidget->renderedSize();
+
+        if (renderedSize == 0)
+            continue;
+
+        const double change = std::abs(static_cast<double>(m_pageWidgetSize) / renderedSize - 1.0);
+
+        if (change < rerenderThreshold)
+            pageWidget->keepScaledThumbnail();
     }
+
+    queueLayoutUpdate();
+}
+
+void View::showNearestThumbnail(const std::shared_ptr<InteractivePageWidget>& pageWidget)
+{
+    if (pageWidget->renderedSize() != 0)
+        return;
+
+    const ThumbnailCache::Key key = ThumbnailCache::keyFor(*pageWidget->page().get(), m_pageWidgetSize);
+
+    if (Glib::RefPtr<Gdk::Pixbuf> nearest = m_thumbnails.cache().findNearest(key); nearest)
+        pageWidget->showPlaceholder(nearest);
 }
 
 void View::setShowFileNames(bool showFileNames)
@@ -148,6 +398,11 @@ void View::setShowFileNames(bool showFileNames)
 
     for (auto& pageWidget : m_pageWidgets)
         pageWidget->setShowFilename(showFileNames);
+
+    if (!m_pageWidgets.empty())
+        m_labelsHeight = m_pageWidgets.front()->labelsHeight();
+
+    queueLayoutUpdate();
 }
 
 void View::selectPageRange(unsigned int first, unsigned int last)
@@ -155,213 +410,592 @@ void View::selectPageRange(unsigned int first, unsigned int last)
     if (first > last || last > m_document->numberOfPages() - 1)
         throw std::runtime_error("Incorrect parameters");
 
-    clearSelection();
-
-    for (auto& widget : m_pageWidgets | rsv::drop(first) | rsv::take(last - first + 1))
-        widget->setSelected(true);
+    m_selection.selectOnly(first, last);
+    m_lastPageSelected.reset();
+    updateWidgetsSelection();
 
     selectedPagesChanged.emit();
 }
 
 void View::selectAllPages()
 {
-    for (auto& widget : m_pageWidgets)
-        widget->setSelected(true);
-
-    m_lastPageSelected = nullptr;
+    m_selection.selectAll();
+    m_lastPageSelected.reset();
+    updateWidgetsSelection();
 
     selectedPagesChanged.emit();
 }
 
 void View::selectOddPages()
 {
-    for (auto [i, widget] : rsv::enumerate(m_pageWidgets)) {
-        if (i % 2 == 0)
-            widget->setSelected(true);
-        else
-            widget->setSelected(false);
-    }
+    m_selection.selectEveryOther(0);
 
-    m_lastPageSelected = nullptr;
+    m_lastPageSelected.reset();
+    updateWidgetsSelection();
 
     selectedPagesChanged.emit();
 }
 
 void View::selectEvenPages()
 {
-    for (auto [i, widget] : rsv::enumerate(m_pageWidgets)) {
-        if (i % 2 == 1)
-            widget->setSelected(true);
-        else
-            widget->setSelected(false);
-    }
+    m_selection.selectEveryOther(1);
 
-    m_lastPageSelected = nullptr;
+    m_lastPageSelected.reset();
+    updateWidgetsSelection();
+
+    selectedPagesChanged.emit();
+}
+
+void View::selectPagesWithOrientation(PageTable::Orientation orientation)
+{
+    m_selection.selectOnly(m_document->pageTable().pagesWithOrientation(orientation));
+
+    m_lastPageSelected.reset();
+    updateWidgetsSelection();
+
+    selectedPagesChanged.emit();
+}
+
+void View::selectPages(const SelectionModel& selection)
+{
+    if (selection.size() != m_selection.size())
+        throw std::runtime_error("Incorrect parameters");
+
+    m_selection = selection;
+
+    m_lastPageSelected.reset();
+    updateWidgetsSelection();
 
     selectedPagesChanged.emit();
 }
 
 void View::invertSelection()
 {
-    for (auto& widget: m_pageWidgets)
-        widget->setSelected(!widget->getSelected());
-    
-    m_lastPageSelected = nullptr;
-    
+    m_selection.invert();
+    m_lastPageSelected.reset();
+    updateWidgetsSelection();
+
     selectedPagesChanged.emit();
 }
 
 void View::clearSelection()
 {
-    for (auto& widget : m_pageWidgets)
-        widget->setSelected(false);
-
-    m_lastPageSelected = nullptr;
+    m_selection.clear();
+    m_lastPageSelected.reset();
+    updateWidgetsSelection();
 
     selectedPagesChanged.emit();
 }
 
-unsigned int View::getSelectedChildIndex() const
+void View::updateWidgetsSelection()
 {
-    const std::vector<unsigned int> selected = getSelectedChildrenIndexes();
+    for (auto& [key, pageWidget] : m_boundWidgets)
+        if (const unsigned int index = indexOf(*pageWidget); index < m_selection.size())
+            pageWidget->setSelected(m_selection.isSelected(index));
+}
 
-    if (selected.size() != 1)
+unsigned int View::getSelectedChildIndex() const
+{
+    if (m_selection.count() != 1)
         throw std::runtime_error("More than one child was actually selected");
 
-    return selected.front();
+    return m_selection.first().value();
 }
 
 std::vector<unsigned int> View::getSelectedChildrenIndexes() const
 {
-    return m_pageWidgets
-           | rsv::filter(std::mem_fn(&InteractivePageWidget::getSelected))
-           | rsv::transform(std::mem_fn(&InteractivePageWidget::get_index))
-           | ranges::to<std::vector<unsigned int>>;
+    return m_selection.selectedIndexes();
 }
 
 std::vector<unsigned int> View::getUnselectedChildrenIndexes() const
 {
-    return m_pageWidgets
-           | rsv::remove_if(std::mem_fn(&InteractivePageWidget::getSelected))
-           | rsv::transform(std::mem_fn(&InteractivePageWidget::get_index))
-           | ranges::to<std::vector<unsigned int>>;
+    return m_selection.unselectedIndexes();
 }
 
-int View::sortFunction(Gtk::FlowBoxChild* a, Gtk::FlowBoxChild* b)
+void View::renderPage(const std::shared_ptr<InteractivePageWidget>& pageWidget, TaskRunner::Priority priority)
 {
-    const auto widgetA = dynamic_cast<InteractivePageWidget*>(a);
-    const auto widgetB = dynamic_cast<InteractivePageWidget*>(b);
+    const Glib::RefPtr<const Page> page = pageWidget->page();
+    const int targetSize = pageWidget->targetSize();
+    const ThumbnailCache::Key key = ThumbnailCache::keyFor(*page.get(), targetSize);
+
+    // Pages that aren't on screen yet get a draft, and the quality pass
+    // once they come into view. Scrolling fast, most never do.
+    const PageRenderer::Quality quality = priority == TaskRunner::Priority::Prefetch
+                                              ? PageRenderer::Quality::Draft
+                                              : PageRenderer::Quality::Full;
+
+    if (Glib::RefPtr<Gdk::Pixbuf> cached = m_thumbnails.cache().findOrRotate(key); cached) {
+        Metrics::add(Metrics::Counter::ThumbnailCacheHits);
+        pageWidget->showPage(cached);
+        return;
+    }
+
+    Metrics::add(Metrics::Counter::ThumbnailCacheMisses);
+
+    // Off screen, whatever is shown already does as well as a draft
+    if (quality == PageRenderer::Quality::Draft && pageWidget->isThumbnailVisible())
+        return;
+
+    // Some other size is better to look at than the spinner
+    showNearestThumbnail(pageWidget);
+
+    if (quality == PageRenderer::Quality::Draft && pageWidget->isThumbnailVisible())
+        return;
+
+    // Each widget waits on its own task, so leaving doesn't cancel the
+    // render for the others waiting on it
+    auto waiting = std::make_shared<Task>([]() {}, []() {});
+    waiting->setGeneration(m_renderGeneration);
+    pageWidget->setRenderingTask(waiting);
 
-    return InteractivePageWidget::sortFunction(*widgetA, *widgetB);
+    m_thumbnails.render(page, key, pageWidget, waiting, scheduledPriority(priority), quality);
 }
 
-void View::renderPage(const std::shared_ptr<InteractivePageWidget>& pageWidget)
+TaskRunner::Priority View::scheduledPriority(TaskRunner::Priority priority) const
 {
-    std::weak_ptr<InteractivePageWidget> weakWidget = pageWidget;
+    // Another window is the one being looked at, and goes first
+    const auto window = dynamic_cast<const Gtk::Window*>(get_toplevel());
 
-    auto funcExecute = [weakWidget]() {
-        if (auto widget = weakWidget.lock(); widget != nullptr)
-            widget->renderPage();
-    };
+    if (priority != TaskRunner::Priority::Interactive && window != nullptr && !window->is_active())
+        return TaskRunner::Priority::Background;
 
-    auto funcPostExecute = [weakWidget]() {
-        if (auto widget = weakWidget.lock(); widget != nullptr)
-            widget->showPage();
-    };
+    return priority;
+}
+
+View::GridLayout View::computeLayout() const
+{
+    const int minimumCellWidth = m_pageWidgetSize + 2 * cellHorizontalMargin;
+    const int availableWidth = get_allocated_width();
+    const int columns = std::max(1, availableWidth / minimumCellWidth);
+
+    return {columns,
+            std::max(minimumCellWidth, availableWidth / columns),
+            m_pageWidgetSize + m_labelsHeight + rowSpacing};
+}
+
+void View::queueLayoutUpdate()
+{
+    if (m_layoutUpdateConnection.connected())
+        return;
+
+    // Run after GTK is done with its own layout, so that sizes are current
+    m_layoutUpdateConnection = Glib::signal_idle().connect([this]() {
+        updateLayout();
+
+        return false;
+    });
+}
+
+void View::updateLayout()
+{
+    const FrameProfiler::Scope scope{FrameProfiler::Work::Layout};
+    m_layoutUpdateConnection.disconnect();
+
+    if (m_document == nullptr)
+        return;
+
+    const unsigned int numberOfPages = m_document->numberOfPages();
+
+    // The labels height is measured on the first widget
+    if (m_pageWidgets.empty() && numberOfPages > 0)
+        m_pageWidgets.push_back(createPageWidget(m_document->getPage(0)));
+
+    m_layout = computeLayout();
+    const auto columns = static_cast<unsigned>(m_layout.columns);
+    const auto numberOfRows = static_cast<int>((numberOfPages + columns - 1) / columns);
+    const int gridHeight = numberOfRows * m_layout.cellHeight;
+
+    int currentWidth = 0, currentHeight = 0;
+    m_grid.get_size_request(currentWidth, currentHeight);
+    if (currentHeight != gridHeight || currentWidth != m_layout.columns * m_layout.cellWidth)
+        m_grid.set_size_request(m_layout.columns * m_layout.cellWidth, gridHeight);
+
+    // Find the ranges of pages that should be backed by a widget
+    const unsigned int last = numberOfPages == 0 ? 0 : numberOfPages - 1;
+    std::vector<std::pair<unsigned int, unsigned int>> ranges{{0, last}};
+    // The part of them that's actually on screen
+    unsigned int firstVisible = 0;
+    unsigned int lastVisible = last;
+
+    if (m_vadjustment) {
+        const double margin = m_vadjustment->get_page_size() * m_prefetchMargin;
+        const std::vector<ScrollPredictor::Span> spans = m_scrollPredictor.spans(ScrollPredictor::Clock::now(),
+                                                                                 m_vadjustment->get_value(),
+                                                                                 m_vadjustment->get_page_size(),
+                                                                                 m_vadjustment->get_upper(),
+                                                                                 margin);
+        // Going the way the spans are sorted, rows shared by two of them are only backed once
+        ranges.clear();
+        for (const ScrollPredictor::Span& span : spans) {
+            const auto firstRow = static_cast<unsigned>(std::floor(span.top / m_layout.cellHeight));
+            const auto lastRow = static_cast<unsigned>(std::floor(span.bottom / m_layout.cellHeight));
+            const unsigned int first = std::min(firstRow * columns, last);
+            const unsigned int rangeLast = std::min((lastRow + 1) * columns - 1, last);
+
+            if (!ranges.empty() && first <= ranges.back().second + 1) {
+                ranges.back().second = std::max(ranges.back().second, rangeLast);
+                continue;
+            }
+
+            ranges.emplace_back(first, rangeLast);
+        }
+
+        const auto firstVisibleRow = static_cast<unsigned>(std::floor(m_vadjustment->get_value() / m_layout.cellHeight));
+        const auto lastVisibleRow = static_cast<unsigned>(std::floor((m_vadjustment->get_value() + m_vadjustment->get_page_size()) / m_layout.cellHeight));
+
+        firstVisible = std::min(firstVisibleRow * columns, last);
+        lastVisible = std::min((lastVisibleRow + 1) * columns - 1, last);
+    }
+
+    m_firstVisible = firstVisible;
+    m_lastVisible = lastVisible;
+
+    // Keep the widgets of pages that are still in range, so they keep their thumbnails.
+    // The ones left behind, on a flick or when turning around, get their renders canceled.
+    std::unordered_map<PageListModel::Key, std::shared_ptr<InteractivePageWidget>> boundWidgets;
+    std::vector<Glib::RefPtr<Page>> unboundPages;
+
+    for (const auto& [first, rangeLast] : ranges) {
+        for (unsigned int i = first; numberOfPages > 0 && i <= rangeLast; ++i) {
+            if (auto it = m_boundWidgets.find(m_pageOrder.at(i)); it != m_boundWidgets.end()) {
+                boundWidgets.insert(*it);
+                m_boundWidgets.erase(it);
+            }
+            else {
+                unboundPages.push_back(m_document->getPage(i));
+            }
+        }
+    }
+
+    // Whatever is left behind is free to be reused
+    std::vector<std::shared_ptr<InteractivePageWidget>> freeWidgets;
+
+    for (auto& pageWidget : m_pageWidgets) {
+        if (boundWidgets.count(pageWidget->page()->listKey()) == 0) {
+            pageWidget->cancelRendering();
+            freeWidgets.push_back(pageWidget);
+        }
+    }
+
+    for (const Glib::RefPtr<Page>& page : unboundPages) {
+        std::shared_ptr<InteractivePageWidget> pageWidget;
 
-    auto task = std::make_shared<Task>(funcExecute, funcPostExecute);
-    pageWidget->setRenderingTask(task);
-    m_taskRunner.queueBack(task);
+        if (!freeWidgets.empty()) {
+            pageWidget = freeWidgets.back();
+            freeWidgets.pop_back();
+            pageWidget->setPage(page);
+        }
+        else {
+            pageWidget = createPageWidget(page);
+            m_pageWidgets.push_back(pageWidget);
+        }
+
+        boundWidgets.emplace(page->listKey(), pageWidget);
+    }
+
+    // A spare widget would keep a full size thumbnail of a page that's gone
+    for (auto& pageWidget : freeWidgets) {
+        if (pageWidget.get() == m_hoveredWidget)
+            hidePreviewButton();
+
+        pageWidget->hide();
+        pageWidget->releaseThumbnail();
+    }
+
+    m_boundWidgets = std::move(boundWidgets);
+
+    for (auto& [key, pageWidget] : m_boundWidgets) {
+        const unsigned int index = pageWidget->page()->getDocumentIndex();
+        const auto row = static_cast<int>(index / columns);
+        const auto column = static_cast<int>(index % columns);
+
+        pageWidget->set_size_request(m_layout.cellWidth, m_layout.cellHeight - rowSpacing);
+
+        // Moving a child queues a resize of the grid even when it stays in
+        // place, so only the widgets whose cell changed are moved: while
+        // scrolling, that's the few just bound, not everything on screen
+        const std::pair<int, int> position{column * m_layout.cellWidth, row * m_layout.cellHeight};
+        if (std::pair<int, int>& current = m_widgetPositions[pageWidget.get()]; current != position) {
+            m_grid.move(*pageWidget, position.first, position.second);
+            current = position;
+        }
+
+        pageWidget->setSelected(m_selection.isSelected(index));
+        pageWidget->show();
+
+        if (pageWidget->targetSize() != m_pageWidgetSize)
+            pageWidget->changeSize(m_pageWidgetSize);
+
+        if (!pageWidget->isRenderingNeeded())
+            continue;
+
+        if (m_isZoomSettling) {
+            showNearestThumbnail(pageWidget);
+            continue;
+        }
+
+        const bool isVisible = index >= firstVisible && index <= lastVisible;
+        renderPage(pageWidget, isVisible ? TaskRunner::Priority::Visible : TaskRunner::Priority::Prefetch);
+    }
+
+    dropAbandonedRenders();
+    prerenderAdjacentZoomLevels();
+
+    // Its cell may have moved, or changed size
+    if (m_hoveredWidget != nullptr)
+        m_previewButtonRevealer.queue_resize();
+
+    if (m_focusFirstPageOnLayout && numberOfPages > 0) {
+        m_focusFirstPageOnLayout = false;
+        focusPage(0);
+    }
+}
+
+void View::prerenderAdjacentZoomLevels()
+{
+    // Mid gesture the next size isn't known yet, and the window being
+    // looked at is the one whose renders these would be
+    if (m_isZoomSettling || m_zoomLevels.empty()
+        || scheduledPriority(TaskRunner::Priority::Visible) != TaskRunner::Priority::Visible)
+        return;
+
+    std::vector<int> sizes;
+    const auto next = std::upper_bound(m_zoomLevels.begin(), m_zoomLevels.end(), m_pageWidgetSize);
+    const auto previous = std::lower_bound(m_zoomLevels.begin(), m_zoomLevels.end(), m_pageWidgetSize);
+
+    if (next != m_zoomLevels.end())
+        sizes.push_back(*next);
+    if (previous != m_zoomLevels.begin())
+        sizes.push_back(*std::prev(previous));
+
+    // Pages nearest the top of the screen first, in case they don't all fit
+    std::vector<std::pair<Glib::RefPtr<const Page>, ThumbnailCache::Key>> thumbnails;
+
+    for (unsigned int i = m_firstVisible; i <= m_lastVisible && i < m_pageOrder.size(); ++i) {
+        const auto it = m_boundWidgets.find(m_pageOrder.at(i));
+        if (it == m_boundWidgets.end())
+            continue;
+
+        const Glib::RefPtr<const Page> page = it->second->page();
+        for (int size : sizes)
+            thumbnails.emplace_back(page, ThumbnailCache::keyFor(*page.get(), size));
+    }
+
+    // Queued behind everything else, so idle workers are all they take
+    m_thumbnails.prerender(thumbnails);
+}
+
+void View::scrollToPage(unsigned int index)
+{
+    if (!m_vadjustment || m_layout.cellHeight == 0)
+        return;
+
+    const double top = static_cast<double>(index / static_cast<unsigned>(m_layout.columns)) * m_layout.cellHeight;
+    const double bottom = top + m_layout.cellHeight;
+    const double value = m_vadjustment->get_value();
+    const double pageSize = m_vadjustment->get_page_size();
+
+    if (top < value)
+        m_vadjustment->set_value(top);
+    else if (bottom > value + pageSize)
+        m_vadjustment->set_value(bottom - pageSize);
+}
+
+void View::focusPage(unsigned int index)
+{
+    scrollToPage(index);
+
+    // Make sure there's a widget for the page before focusing it
+    if (findBoundWidget(index) == nullptr)
+        updateLayout();
+
+    if (auto pageWidget = findBoundWidget(index); pageWidget != nullptr) {
+        pageWidget->grab_focus();
+        m_focusedPage = index;
+    }
+}
+
+bool View::onKeyPress(GdkEventKey* event)
+{
+    if (m_document == nullptr || m_document->numberOfPages() == 0 || !m_focusedPage.has_value())
+        return false;
+
+    const auto current = static_cast<long>(m_focusedPage.value());
+    const long columns = m_layout.columns;
+    const long lastIndex = static_cast<long>(m_document->numberOfPages()) - 1;
+    long target = current;
+
+    switch (event->keyval) {
+    case GDK_KEY_Left:
+        target = current - 1;
+        break;
+    case GDK_KEY_Right:
+        target = current + 1;
+        break;
+    case GDK_KEY_Up:
+        target = current - columns;
+        break;
+    case GDK_KEY_Down:
+        target = current + columns;
+        break;
+    case GDK_KEY_Home:
+        target = 0;
+        break;
+    case GDK_KEY_End:
+        target = lastIndex;
+        break;
+    default:
+        return false;
+    }
+
+    focusPage(static_cast<unsigned>(std::clamp(target, 0L, lastIndex)));
+
+    return true;
+}
+
+void View::updateRenderBufferSizeClass()
+{
+    const std::optional<Page::Size> pageSize = m_document != nullptr ? m_document->uniformPageSize()
+                                                                     : std::nullopt;
+
+    std::size_t exactSizeClass = 0;
+
+    // Turning a page swaps its sides, so it takes just as many bytes
+    if (pageSize.has_value()) {
+        const Page::Size thumbnailSize = Page::scaleSize(*pageSize, m_pageWidgetSize);
+        exactSizeClass = static_cast<std::size_t>(thumbnailSize.width) * 4 * static_cast<std::size_t>(thumbnailSize.height);
+    }
+
+    for (const std::shared_ptr<RenderBufferPool>& pool : RenderBufferPool::sharedPools())
+        pool->setExactSizeClass(exactSizeClass);
 }
 
 void View::cancelRenderingTasks()
 {
+    ++*m_renderGeneration;
+
+    // The widgets still need to know their thumbnail is outdated
     for (auto& pageWidget : m_pageWidgets)
         pageWidget->cancelRendering();
+
+    // Renders the other windows wait for go on
+    m_thumbnails.dropAbandonedRenders();
+}
+
+void View::dropAbandonedRenders()
+{
+    m_thumbnails.dropAbandonedRenders();
 }
 
 void View::onModelItemsChanged(guint position, guint removed, guint added)
 {
-    auto it = m_pageWidgets.begin();
-    std::advance(it, position);
+    // Bulk removals come as one change that replaces the tail of the list
+    // with the pages that were kept, so the selection is carried over by page
+    std::unordered_map<PageListModel::Key, bool> previousSelection;
+    if (removed > 0 && added > 0) {
+        previousSelection.reserve(removed);
+        for (guint i = position; i < position + removed; ++i)
+            previousSelection.emplace(m_pageOrder.at(i), m_selection.isSelected(i));
+    }
 
-    for (; removed != 0; --removed) {
-        (*it)->cancelRendering();
-        m_flowBox.remove(*(*it));
-        it = m_pageWidgets.erase(it);
+    // By row, so that no page is made for a change off screen
+    std::vector<PageListModel::Key> addedPages;
+    std::vector<bool> addedSelection;
+    addedPages.reserve(added);
+    addedSelection.reserve(added);
+    for (guint i = position; i < position + added; ++i) {
+        const PageListModel::Key page = m_document->pages()->rowAt(i).key();
+        const auto it = previousSelection.find(page);
+        addedPages.push_back(page);
+        addedSelection.push_back(it != previousSelection.end() && it->second);
     }
 
-    for (guint i = 0; i != added; ++i) {
-        auto page = m_document->getPage(position + i);
-        std::shared_ptr<InteractivePageWidget> pageWidget = createPageWidget(page);
+    m_selection.replace(position, removed, addedSelection);
+    m_pageOrder.erase(m_pageOrder.begin() + position, m_pageOrder.begin() + position + removed);
+    m_pageOrder.insert(m_pageOrder.begin() + position, addedPages.begin(), addedPages.end());
 
-        m_pageWidgets.insert(it, pageWidget);
-        m_flowBox.add(*pageWidget);
-        renderPage(pageWidget);
-    }
+    // Indexes after the change point moved around
+    m_lastPageSelected.reset();
+    m_focusedPage.reset();
+
+    // New pages may make the sizes differ
+    if (added > removed)
+        updateRenderBufferSizeClass();
 
     selectedPagesChanged.emit();
+
+    if (m_previewWindow)
+        m_previewWindow->onPagesChanged();
+
+    queueLayoutUpdate();
 }
 
 void View::onModelPagesRotated(const std::vector<unsigned int>& positions)
 {
-    for (auto& pageWidget : m_pageWidgets) {
-        for (unsigned int position : positions) {
-            if (position == static_cast<unsigned>(pageWidget->get_index())) {
-                pageWidget->showSpinner();
-                pageWidget->changeSize(m_pageWidgetSize);
-                renderPage(pageWidget);
-
-                break;
-            }
+    for (unsigned int position : positions) {
+        if (auto pageWidget = findBoundWidget(position); pageWidget != nullptr) {
+            pageWidget->showSpinner();
+            pageWidget->changeSize(m_pageWidgetSize);
+
+            // A cached thumbnail gets turned and replaces the spinner before
+            // it's ever drawn; only a cache miss goes through poppler
+            renderPage(pageWidget, TaskRunner::Priority::Visible);
         }
     }
+
+    dropAbandonedRenders();
+
+    if (m_previewWindow)
+        m_previewWindow->onPagesRotated();
+
+    queueLayoutUpdate();
 }
 
 void View::onModelPagesReordered(const std::vector<unsigned int>& positions)
 {
-    for (auto& pageWidget : m_pageWidgets) {
-        for (unsigned int position : positions) {
-            if (position == static_cast<unsigned>(pageWidget->get_index())) {
-                pageWidget->setSelected(true);
+    for (unsigned int position : positions)
+        m_selection.set(position, true);
 
-                break;
-            }
-        }
-    }
+    updateWidgetsSelection();
 
     selectedPagesChanged.emit();
 }
 
 void View::onPageSelection(InteractivePageWidget* pageWidget)
 {
+    const unsigned int index = indexOf(*pageWidget);
+
+    // The widget may still show a page that was just removed
+    if (index >= m_selection.size())
+        return;
+
+    m_selection.set(index, pageWidget->getSelected());
+
     if (pageWidget->getSelected())
-        m_lastPageSelected = pageWidget;
+        m_lastPageSelected = index;
     else
-        m_lastPageSelected = nullptr;
+        m_lastPageSelected.reset();
 
     selectedPagesChanged.emit();
 }
 
 void View::onShiftSelection(InteractivePageWidget* pageWidget)
 {
-    if (m_lastPageSelected == nullptr) {
-        m_lastPageSelected = pageWidget;
-    }
-    else {
-        int first = m_lastPageSelected->get_index();
-        int last = pageWidget->get_index();
+    const unsigned int index = indexOf(*pageWidget);
 
-        if (first != -1 && last != -1) {
-            for (auto& widget : m_pageWidgets)
-                widget->setSelected(false);
+    if (index >= m_selection.size())
+        return;
 
-            if (first > last)
-                std::swap(first, last);
+    if (!m_lastPageSelected.has_value()) {
+        m_selection.set(index, true);
+        m_lastPageSelected = index;
+    }
+    else {
+        const unsigned int first = std::min(m_lastPageSelected.value(), index);
+        const unsigned int last = std::max(m_lastPageSelected.value(), index);
 
-            for (auto& widget : m_pageWidgets | rsv::drop(first) | rsv::take(last - first + 1))
-                widget->setSelected(true);
-        }
+        m_selection.selectOnly(first, last);
+        updateWidgetsSelection();
     }
 
     selectedPagesChanged.emit();
@@ -369,6 +1003,55 @@ void View::onShiftSelection(InteractivePageWidget* pageWidget)
 
 void View::onPreviewRequested(const Glib::RefPtr<const Page>& page)
 {
-    (new PreviewWindow{page, m_taskRunner})->show();
+    if (!m_previewWindow)
+        m_previewWindow = std::make_unique<PreviewWindow>(m_taskRunner);
+
+    m_previewWindow->showPage(*m_document, page);
+    m_previewWindow->present();
+}
+
+void View::onHoverChanged(InteractivePageWidget* pageWidget, bool isHovered)
+{
+    if (isHovered) {
+        m_hoveredWidget = pageWidget;
+        m_previewButtonRevealer.show();
+        m_previewButtonRevealer.queue_resize();
+
+        // Windows of cells created since would be stacked over it
+        if (const Glib::RefPtr<Gdk::Window> window = m_previewButtonRevealer.get_parent_window())
+            window->raise();
+    }
+
+    m_previewButtonRevealer.set_reveal_child(isHovered);
+}
+
+bool View::placePreviewButton(Gtk::Widget* widget, Gdk::Rectangle& allocation)
+{
+    if (widget != &m_previewButtonRevealer || m_hoveredWidget == nullptr)
+        return false;
+
+    const auto position = m_widgetPositions.find(m_hoveredWidget);
+    if (position == m_widgetPositions.end())
+        return false;
+
+    static const int margin = 10;
+    Gtk::Requisition minimumSize, naturalSize;
+    m_previewButtonRevealer.get_preferred_size(minimumSize, naturalSize);
+
+    // At the top right corner of the thumbnail, as if it were part of the cell
+    const Gdk::Rectangle thumbnail = m_hoveredWidget->thumbnailArea();
+    allocation.set_x(position->second.first + thumbnail.get_x() + thumbnail.get_width() - naturalSize.width - margin);
+    allocation.set_y(position->second.second + thumbnail.get_y() + margin);
+    allocation.set_width(naturalSize.width);
+    allocation.set_height(naturalSize.height);
+
+    return true;
+}
+
+void View::hidePreviewButton()
+{
+    m_hoveredWidget = nullptr;
+    m_previewButtonRevealer.set_reveal_child(false);
+    m_previewButtonRevealer.hide();
 }
 }
@@ -19,20 +19,34 @@
 
 #include <document.hpp>
 #include "interactivepagewidget.hpp"
+#include "previewwindow.hpp"
+#include "scrollpredictor.hpp"
+#include "sharedthumbnails.hpp"
 #include "taskrunner.hpp"
-#include <queue>
+#include <pagerenderer.hpp>
+#include <selectionmodel.hpp>
+#include <thumbnailcache.hpp>
+#include <optional>
+#include <unordered_map>
+#include <utility>
 #include <glibmm/dispatcher.h>
+#include <gtkmm/adjustment.h>
+#include <gtkmm/button.h>
 #include <gtkmm/eventbox.h>
-#include <gtkmm/flowbox.h>
+#include <gtkmm/fixed.h>
+#include <gtkmm/gesturezoom.h>
+#include <gtkmm/overlay.h>
+#include <gtkmm/revealer.h>
 
 namespace Slicer {
 
 class View : public Gtk::EventBox {
 
 public:
+    // onZoom gets how much ctrl+scroll or a pinch asked to scale pages by
     View(TaskRunner& taskRunner,
-         const std::function<void()>& onMouseWheelUp,
-         const std::function<void()>& onMouseWheelDown);
+         SharedThumbnails& thumbnails,
+         const std::function<void(double)>& onZoom);
 
     View(const View&) = delete;
     View& operator=(const View&) = delete;
@@ -42,48 +56,150 @@ public:
     ~View() override;
 
     void setDocument(Document& document, int targetWidgetSize);
+    // Stretches what's on screen right away, and renders again once the
+    // size stops changing for a moment, unless it's close to what's shown
     void changePageSize(int targetWidgetSize);
     void setShowFileNames(bool showFileNames);
+    void setScrollAdjustment(const Glib::RefPtr<Gtk::Adjustment>& adjustment);
+    void setPrefetchMargin(double viewportFraction);
+    // The sizes a zoom step lands on. The pages on screen are rendered at
+    // the ones next to the current size when nothing else is queued, so
+    // that the first step shows them sharp at once.
+    void setZoomLevels(const std::vector<int>& zoomLevels);
+    // Queues again what's on its way, at the priority that goes with
+    // whether the window is the active one now
+    void rescheduleRenders();
+    // Drops the thumbnails that aren't on screen, to be rendered again when needed
+    void releaseMemory();
+    // For the metrics overlay. Shared with the other windows.
+    std::size_t thumbnailCacheSizeInBytes() const;
+    std::size_t numberOfRendersInFlight() const;
+    // For the latency histograms: whether the user sees a first page, and
+    // whether every page on screen is sharp at the size asked for
+    bool isAnyThumbnailShown() const;
+    bool areVisibleThumbnailsSharp() const;
     void selectPageRange(unsigned int first, unsigned int last);
     void selectAllPages();
     void selectOddPages();
     void selectEvenPages();
+    void selectPagesWithOrientation(PageTable::Orientation orientation);
+    // Replaces the whole selection at once, which must have a page for every page of the document
+    void selectPages(const SelectionModel& selection);
     void clearSelection();
     void invertSelection();
 
     unsigned int getSelectedChildIndex() const;
     std::vector<unsigned int> getSelectedChildrenIndexes() const;
     std::vector<unsigned int> getUnselectedChildrenIndexes() const;
+    const SelectionModel& selection() const { return m_selection; }
 
     sigc::signal<void> selectedPagesChanged;
 
+    // How long the size has to stay put before pages are rendered for it
+    static constexpr unsigned int zoomSettleDelay = 200;
+    // Stretched thumbnails closer than this to their size are kept as they are
+    static constexpr double rerenderThreshold = 0.15;
+
 private:
-    Gtk::FlowBox m_flowBox;
-    std::list<std::shared_ptr<InteractivePageWidget>> m_pageWidgets;
+    struct GridLayout {
+        int columns;
+        int cellWidth;
+        int cellHeight;
+    };
+
+    // The grid is virtualized: only pages around the viewport have a
+    // widget, and widgets are recycled as pages scroll in and out of view.
+    // Every cell has the same size, so positions are plain arithmetic.
+    Gtk::Fixed m_grid;
+    std::vector<std::shared_ptr<InteractivePageWidget>> m_pageWidgets;
+    std::unordered_map<PageListModel::Key, std::shared_ptr<InteractivePageWidget>> m_boundWidgets;
+    // Where each widget was last put in the grid
+    std::unordered_map<const InteractivePageWidget*, std::pair<int, int>> m_widgetPositions;
+    GridLayout m_layout{1, 0, 0};
+    int m_labelsHeight = 0;
+
+    // A single preview button, over the thumbnail under the pointer
+    Gtk::Overlay m_gridOverlay;
+    Gtk::Revealer m_previewButtonRevealer;
+    Gtk::Button m_previewButton;
+    InteractivePageWidget* m_hoveredWidget = nullptr;
+
     int m_pageWidgetSize = 0;
     bool m_showFileNames = false;
     Document* m_document = nullptr;
     std::vector<sigc::connection> m_documentConnections;
     TaskRunner& m_taskRunner;
-
-    InteractivePageWidget* m_lastPageSelected = nullptr;
+    SharedThumbnails& m_thumbnails;
+    // Moving it on cancels every render this view waits for at once
+    std::shared_ptr<std::atomic_uint> m_renderGeneration = std::make_shared<std::atomic_uint>(0);
+
+    // Selection state lives here rather than in the recycled widgets
+    SelectionModel m_selection;
+    // Mirror of the model order: O(1) position lookups for rotate and
+    // reorder notifications, and a change replacing a range of pages
+    // can carry the selection of the pages that stay over
+    std::vector<PageListModel::Key> m_pageOrder;
+    std::optional<unsigned int> m_lastPageSelected;
+    std::optional<unsigned int> m_focusedPage;
+    bool m_focusFirstPageOnLayout = false;
+
+    // Only pages inside the viewport, extended by m_prefetchMargin
+    // viewport heights above and below, get a widget and get rendered.
+    // While scrolling, the margin goes where the scroll is headed.
+    Glib::RefPtr<Gtk::Adjustment> m_vadjustment;
+    std::vector<sigc::connection> m_adjustmentConnections;
+    double m_prefetchMargin = 1.0;
+    std::vector<int> m_zoomLevels;
+    // Which way, and how fast, the window moves along the pages
+    ScrollPredictor m_scrollPredictor;
+    sigc::connection m_scrollSettleConnection;
+    sigc::connection m_layoutUpdateConnection;
+    // The pages on screen at the last layout
+    unsigned int m_firstVisible = 0;
+    unsigned int m_lastVisible = 0;
+
+    // While zooming, pages only get stretched; nothing is rendered
+    // until the size has settled
+    Glib::RefPtr<Gtk::GestureZoom> m_zoomGesture;
+    double m_lastGestureScale = 1.0;
+    bool m_isZoomSettling = false;
+    sigc::connection m_zoomSettleConnection;
+
+    // Created for the first preview, and shown again for every one after
+    std::unique_ptr<PreviewWindow> m_previewWindow;
 
     std::shared_ptr<InteractivePageWidget> createPageWidget(const Glib::RefPtr<const Page>& page);
+    std::shared_ptr<InteractivePageWidget> findBoundWidget(unsigned int index) const;
+    unsigned int indexOf(const InteractivePageWidget& pageWidget) const;
 
-    void setupFlowbox();
-    void setupSignalHandlers(const std::function<void()>& onMouseWheelUp,
-                             const std::function<void()>& onMouseWheelDown);
+    void setupGrid();
+    void setupSignalHandlers(const std::function<void(double)>& onZoom);
+    void onZoomSettled();
+    void showNearestThumbnail(const std::shared_ptr<InteractivePageWidget>& pageWidget);
     void onModelItemsChanged(guint position, guint removed, guint added);
     void onModelPagesRotated(const std::vector<unsigned int>& positions);
     void onModelPagesReordered(const std::vector<unsigned int>& positions);
     void onPageSelection(InteractivePageWidget* pageWidget);
     void onShiftSelection(InteractivePageWidget* pageWidget);
     void onPreviewRequested(const Glib::RefPtr<const Page>& page);
-    void renderPage(const std::shared_ptr<InteractivePageWidget>& pageWidget);
+    void onHoverChanged(InteractivePageWidget* pageWidget, bool isHovered);
+    bool placePreviewButton(Gtk::Widget* widget, Gdk::Rectangle& allocation);
+    void hidePreviewButton();
+    bool onKeyPress(GdkEventKey* event);
+    void renderPage(const std::shared_ptr<InteractivePageWidget>& pageWidget, TaskRunner::Priority priority);
+    TaskRunner::Priority scheduledPriority(TaskRunner::Priority priority) const;
+    GridLayout computeLayout() const;
+    void onScrolled();
+    void queueLayoutUpdate();
+    void updateLayout();
+    void prerenderAdjacentZoomLevels();
+    void updateWidgetsSelection();
+    void scrollToPage(unsigned int index);
+    void focusPage(unsigned int index);
     void cancelRenderingTasks();
+    void updateRenderBufferSizeClass();
+    void dropAbandonedRenders();
     void clearState();
-
-    static int sortFunction(Gtk::FlowBoxChild* a, Gtk::FlowBoxChild* b);
 };
 }
 
@@ -15,13 +15,23 @@
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "welcomescreen.hpp"
+#include "filepreview.hpp"
 #include <glibmm/i18n.h>
+#include <gtkmm/button.h>
+#include <gtkmm/recentmanager.h>
 #include <config.hpp>
+#include <fmt/format.h>
+#include <algorithm>
+#include <vector>
 
 namespace Slicer {
 
-WelcomeScreen::WelcomeScreen()
+using namespace fmt::literals;
+
+WelcomeScreen::WelcomeScreen(TaskRunner& taskRunner, SharedThumbnails& thumbnails)
     : Gtk::Box{Gtk::ORIENTATION_VERTICAL}
+    , m_taskRunner{taskRunner}
+    , m_thumbnails{thumbnails}
 {
     m_icon.set_from_icon_name(config::APPLICATION_ID + "-symbolic", Gtk::ICON_SIZE_BUTTON);
     m_icon.set_pixel_size(370);
@@ -31,12 +41,106 @@ WelcomeScreen::WelcomeScreen()
     m_label.get_style_context()->add_class("welcome-label");
     m_label.set_margin_top(30);
 
+    m_recentLabel.set_label(_("Recent documents"));
+    m_recentLabel.get_style_context()->add_class("dim-label");
+    m_recentLabel.set_margin_top(40);
+    m_recentLabel.set_no_show_all();
+
+    m_recentDocuments.set_selection_mode(Gtk::SELECTION_NONE);
+    m_recentDocuments.set_homogeneous();
+    m_recentDocuments.set_halign(Gtk::ALIGN_CENTER);
+    m_recentDocuments.set_max_children_per_line(maximumRecentDocuments / 2);
+    m_recentDocuments.set_column_spacing(12);
+    m_recentDocuments.set_row_spacing(12);
+    m_recentDocuments.set_margin_top(12);
+    m_recentDocuments.set_no_show_all();
+
     m_box.set_orientation(Gtk::ORIENTATION_VERTICAL);
     m_box.set_valign(Gtk::ALIGN_CENTER);
     m_box.pack_start(m_icon, false, false);
     m_box.pack_start(m_label, false, false);
+    m_box.pack_start(m_recentLabel, false, false);
+    m_box.pack_start(m_recentDocuments, false, false);
 
     pack_start(m_box); // NOLINT
 }
 
+void WelcomeScreen::on_map()
+{
+    // Documents may have been opened since it was last shown, here or elsewhere
+    updateRecentDocuments();
+
+    Gtk::Box::on_map();
+}
+
+void WelcomeScreen::updateRecentDocuments()
+{
+    for (Gtk::Widget* child : m_recentDocuments.get_children())
+        m_recentDocuments.remove(*child);
+
+    // The newest first
+    std::vector<Glib::RefPtr<Gtk::RecentInfo>> items = Gtk::RecentManager::get_default()->get_items();
+    std::sort(items.begin(), items.end(), [](const auto& a, const auto& b) {
+        return a->get_modified() > b->get_modified();
+    });
+
+    int numberOfDocuments = 0;
+    for (const Glib::RefPtr<Gtk::RecentInfo>& info : items) {
+        if (numberOfDocuments == maximumRecentDocuments)
+            break;
+
+        if (info->get_mime_type() != "application/pdf" || !info->is_local() || !info->exists())
+            continue;
+
+        m_recentDocuments.add(*createRecentDocument(Gio::File::create_for_uri(info->get_uri()),
+                                                    info->get_display_name()));
+        ++numberOfDocuments;
+    }
+
+    const bool hasRecentDocuments = numberOfDocuments > 0;
+
+    // Room for the documents below it
+    m_icon.set_pixel_size(hasRecentDocuments ? 128 : 370);
+    m_recentLabel.set_visible(hasRecentDocuments);
+    m_recentDocuments.set_visible(hasRecentDocuments);
+    m_recentDocuments.show_all_children();
+}
+
+Gtk::Widget* WelcomeScreen::createRecentDocument(const Glib::RefPtr<Gio::File>& file,
+                                                 const Glib::ustring& displayName)
+{
+    auto button = Gtk::manage(new Gtk::Button); //NOLINT
+    auto box = Gtk::manage(new Gtk::Box{Gtk::ORIENTATION_VERTICAL, 6}); //NOLINT
+    auto preview = Gtk::manage(new FilePreview{m_taskRunner, m_thumbnails}); //NOLINT
+    auto nameLabel = Gtk::manage(new Gtk::Label{displayName}); //NOLINT
+    auto pagesLabel = Gtk::manage(new Gtk::Label); //NOLINT
+
+    button->set_relief(Gtk::RELIEF_NONE);
+    button->set_tooltip_text(file->get_parse_name());
+
+    nameLabel->set_ellipsize(Pango::ELLIPSIZE_MIDDLE);
+    nameLabel->set_max_width_chars(20);
+    pagesLabel->get_style_context()->add_class("dim-label");
+
+    // Known from the document's PageIndex, if it was open before
+    preview->numberOfPagesFound.connect([pagesLabel](unsigned int numberOfPages) {
+        pagesLabel->set_label(fmt::format(ngettext("{number} page", "{number} pages", numberOfPages),
+                                          "number"_a = numberOfPages)); //NOLINT
+    });
+    preview->showFile(file);
+
+    box->pack_start(*preview, false, false);
+    box->pack_start(*nameLabel, false, false);
+    box->pack_start(*pagesLabel, false, false);
+    button->add(*box);
+
+    // Opening it again goes through the PageIndex and the thumbnails on disk,
+    // so even a large document is there at once
+    button->signal_clicked().connect([this, file]() {
+        openRequested.emit(file);
+    });
+
+    return button;
+}
+
 } // namespace Slicer
@@ -17,7 +17,11 @@
 #ifndef WELCOMESCREEN_HPP
 #define WELCOMESCREEN_HPP
 
+#include "sharedthumbnails.hpp"
+#include "taskrunner.hpp"
+#include <giomm/file.h>
 #include <gtkmm/box.h>
+#include <gtkmm/flowbox.h>
 #include <gtkmm/image.h>
 #include <gtkmm/label.h>
 
@@ -25,12 +29,26 @@ namespace Slicer {
 
 class WelcomeScreen : public Gtk::Box {
 public:
-    WelcomeScreen();
+    WelcomeScreen(TaskRunner& taskRunner, SharedThumbnails& thumbnails);
+
+    // One of the recent documents was picked
+    sigc::signal<void, Glib::RefPtr<Gio::File>> openRequested;
+
+    static constexpr int maximumRecentDocuments = 8;
 
 private:
+    TaskRunner& m_taskRunner;
+    SharedThumbnails& m_thumbnails;
+
     Gtk::Image m_icon;
     Gtk::Label m_label;
+    Gtk::Label m_recentLabel;
+    Gtk::FlowBox m_recentDocuments;
     Gtk::Box m_box;
+
+    void on_map() override;
+    void updateRecentDocuments();
+    Gtk::Widget* createRecentDocument(const Glib::RefPtr<Gio::File>& file, const Glib::ustring& displayName);
 };
 
 } // namespace Slicer
@@ -17,6 +17,8 @@
 #include "zoomlevel.hpp"
 #include <range/v3/algorithm.hpp>
 #include <range/v3/action.hpp>
+#include <algorithm>
+#include <cmath>
 
 namespace Slicer {
 
@@ -27,6 +29,7 @@ bool isNonPositive(int number)
 
 ZoomLevel::ZoomLevel(const std::vector<int>& levels)
     : m_zoomLevelIndex{*this, "zoom-level-index", 0}
+    , m_zoomSize{*this, "zoom-size", 0}
     , m_levels{levels}
 {
     m_levels |= ranges::actions::sort | ranges::actions::unique;
@@ -36,16 +39,20 @@ ZoomLevel::ZoomLevel(const std::vector<int>& levels)
 
     if (ranges::any_of(m_levels, isNonPositive))
         throw std::runtime_error("Zoom levels have to be greater than zero");
+
+    m_zoomSize.set_value(m_levels.front());
+
+    m_zoomLevelIndex.get_proxy().signal_changed().connect(sigc::mem_fun(*this, &ZoomLevel::onZoomLevelIndexChanged));
 }
 
 void ZoomLevel::setToDefaultLevel()
 {
-    m_zoomLevelIndex.set_value(0);
+    setSize(minLevel());
 }
 
 int ZoomLevel::currentLevel() const
 {
-    return m_levels.at(m_zoomLevelIndex.get_value());
+    return m_zoomSize.get_value();
 }
 
 int ZoomLevel::minLevel() const
@@ -60,23 +67,97 @@ int ZoomLevel::maxLevel() const
 
 int ZoomLevel::operator++()
 {
-    if (currentLevel() != maxLevel())
-        m_zoomLevelIndex.set_value(m_zoomLevelIndex.get_value() + 1);
+    // From between two levels, the next one is the one above
+    auto next = ranges::upper_bound(m_levels, currentLevel());
+
+    if (next != m_levels.end())
+        setSize(*next);
 
     return currentLevel();
 }
 
 int ZoomLevel::operator--()
 {
-    if (currentLevel() != minLevel())
-        m_zoomLevelIndex.set_value(m_zoomLevelIndex.get_value() - 1);
+    auto previous = ranges::lower_bound(m_levels, currentLevel());
+
+    if (previous != m_levels.begin())
+        setSize(*std::prev(previous));
 
     return currentLevel();
 }
 
+void ZoomLevel::zoomBy(double factor)
+{
+    if (factor <= 0)
+        return;
+
+    auto size = static_cast<int>(std::lround(currentLevel() * factor));
+
+    // Touchpads send steps too small to move a pixel on their own
+    if (size == currentLevel() && factor != 1.0)
+        size += factor > 1.0 ? 1 : -1;
+
+    setSize(size);
+}
+
 Glib::PropertyProxy<unsigned> ZoomLevel::zoomLevelIndex()
 {
     return m_zoomLevelIndex.get_proxy();
 }
 
+Glib::PropertyProxy<int> ZoomLevel::zoomSize()
+{
+    return m_zoomSize.get_proxy();
+}
+
+double ZoomLevel::scrollFactor(const GdkEventScroll* event)
+{
+    double deltaY = 0;
+
+    switch (event->direction) {
+    case GDK_SCROLL_UP:
+        deltaY = -1;
+        break;
+    case GDK_SCROLL_DOWN:
+        deltaY = 1;
+        break;
+    case GDK_SCROLL_SMOOTH:
+        // Touchpads send a stream of small deltas, a wheel one per notch
+        deltaY = event->delta_y;
+        break;
+    default:
+        break;
+    }
+
+    return std::pow(scrollStep, -deltaY);
+}
+
+void ZoomLevel::setSize(int size)
+{
+    size = std::clamp(size, minLevel(), maxLevel());
+
+    if (size != currentLevel())
+        m_zoomSize.set_value(size);
+
+    // The size goes first, so that the index handler finds them in agreement
+    if (const unsigned index = levelIndexFor(size); index != m_zoomLevelIndex.get_value())
+        m_zoomLevelIndex.set_value(index);
+}
+
+unsigned ZoomLevel::levelIndexFor(int size) const
+{
+    auto above = ranges::upper_bound(m_levels, size);
+
+    return static_cast<unsigned>(std::max<std::ptrdiff_t>(std::distance(m_levels.begin(), above) - 1, 0));
+}
+
+void ZoomLevel::onZoomLevelIndexChanged()
+{
+    const unsigned index = std::min<unsigned>(m_zoomLevelIndex.get_value(), m_levels.size() - 1);
+
+    // Set from outside, like when restoring the last session
+    if (levelIndexFor(currentLevel()) != index)
+        m_zoomSize.set_value(m_levels.at(index));
+}
+
 } // namespace Slicer
@@ -17,12 +17,17 @@
 #ifndef ZOOMLEVEL_HPP
 #define ZOOMLEVEL_HPP
 
+#include <gdk/gdk.h>
 #include <glibmm/object.h>
 #include <glibmm/property.h>
 #include <sigc++/signal.h>
 
 namespace Slicer {
 
+// The size pages are shown at. It moves continuously between the smallest
+// and largest level, in fine steps when zooming with a touchpad or a pinch,
+// and from level to level with the zoom actions. The index is that of the
+// largest level not above the current size.
 class ZoomLevel : public Glib::Object {
 public:
     ZoomLevel() = delete;
@@ -37,11 +42,26 @@ public:
 	int operator++();
 	int operator--();
 
+    // Scales the current size, staying between the smallest and largest level
+    void zoomBy(double factor);
+
     Glib::PropertyProxy<unsigned> zoomLevelIndex();
+    Glib::PropertyProxy<int> zoomSize();
+
+    // How much a scroll event zooms in (above one) or out (below one)
+    static double scrollFactor(const GdkEventScroll* event);
+
+    // Each notch of a mouse wheel zooms this much
+    static constexpr double scrollStep = 1.1;
 
 private:
     Glib::Property<unsigned> m_zoomLevelIndex;
+    Glib::Property<int> m_zoomSize;
     std::vector<int> m_levels;
+
+    void setSize(int size);
+    unsigned levelIndexFor(int size) const;
+    void onZoomLevelIndexChanged();
 };
 
 } // namespace Slicer
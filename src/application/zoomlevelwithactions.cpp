@@ -30,6 +30,8 @@ ZoomLevelWithActions::ZoomLevelWithActions(const std::vector<int>& levels, Gio::
     m_zoomInAction->set_enabled(false);
     m_zoomOutAction->set_enabled(false);
     m_resetZoomAction->set_enabled(false);
+
+    zoomSize().signal_changed().connect(sigc::mem_fun(*this, &ZoomLevelWithActions::updateActions));
 }
 
 ZoomLevelWithActions::~ZoomLevelWithActions()
@@ -41,44 +43,37 @@ ZoomLevelWithActions::~ZoomLevelWithActions()
 
 void ZoomLevelWithActions::enable()
 {
-    if (currentLevel() == maxLevel())
-        m_zoomInAction->set_enabled(false);
-    else
-        m_zoomInAction->set_enabled();
-
-    if (currentLevel() == minLevel())
-        m_zoomOutAction->set_enabled(false);
-    else
-        m_zoomOutAction->set_enabled();
-
-    m_resetZoomAction->set_enabled();
+    m_isEnabled = true;
+    updateActions();
 }
 
 void ZoomLevelWithActions::disable()
 {
+    m_isEnabled = false;
+
     m_zoomInAction->set_enabled(false);
     m_zoomOutAction->set_enabled(false);
     m_resetZoomAction->set_enabled(false);
 }
 
-void ZoomLevelWithActions::onZoomInAction()
+void ZoomLevelWithActions::updateActions()
 {
-    operator++();
+    if (!m_isEnabled)
+        return;
 
-    if (currentLevel() == maxLevel())
-        m_zoomInAction->set_enabled(false);
+    m_zoomInAction->set_enabled(currentLevel() != maxLevel());
+    m_zoomOutAction->set_enabled(currentLevel() != minLevel());
+    m_resetZoomAction->set_enabled();
+}
 
-    m_zoomOutAction->set_enabled();
+void ZoomLevelWithActions::onZoomInAction()
+{
+    operator++();
 }
 
 void ZoomLevelWithActions::onZoomOutAction()
 {
     operator--();
-
-    if (currentLevel() == minLevel())
-        m_zoomOutAction->set_enabled(false);
-
-    m_zoomInAction->set_enabled();
 }
 
 void ZoomLevelWithActions::onResetZoomAction()
@@ -38,14 +38,17 @@ public:
 
     void enable();
     void disable();
+    bool isEnabled() const { return m_isEnabled; }
 
 private:
     Gio::ActionMap& m_actionMap;
+    bool m_isEnabled = false;
 
     Glib::RefPtr<Gio::SimpleAction> m_zoomInAction;
     Glib::RefPtr<Gio::SimpleAction> m_zoomOutAction;
     Glib::RefPtr<Gio::SimpleAction> m_resetZoomAction;
 
+    void updateActions();
     void onZoomInAction();
     void onZoomOutAction();
     void onResetZoomAction();
@@ -0,0 +1,238 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "batchdispatch.hpp"
+#include "batchmanifest.hpp"
+#include <glibmm/shell.h>
+#include <glibmm/spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+
+namespace Slicer {
+
+namespace {
+    using Shard = std::vector<std::size_t>;
+
+    // Workers lost this many times in a row, without a single result, are left out
+    constexpr unsigned int maxWorkerFailures = 2;
+
+    void writeAll(int file, const std::string& text)
+    {
+        std::size_t written = 0;
+
+        while (written < text.size()) {
+            const ssize_t size = ::write(file, text.data() + written, text.size() - written);
+            if (size < 0 && errno == EINTR)
+                continue;
+            if (size <= 0)
+                return;
+
+            written += static_cast<std::size_t>(size);
+        }
+    }
+
+    // Hands onResult every result the worker printed for the jobs of the
+    // shard, whose manifest lines are numbered from 1. A worker that can't
+    // be started prints nothing.
+    void runShard(const std::vector<std::string>& worker,
+                  const std::vector<BatchJob>& jobs,
+                  const Shard& shard,
+                  const std::function<void(std::size_t, const BatchJobResult&)>& onResult)
+    {
+        Glib::Pid pid = 0;
+        int input = -1;
+        int output = -1;
+
+        try {
+            Glib::spawn_async_with_pipes({},
+                                         worker,
+                                         Glib::SPAWN_SEARCH_PATH | Glib::SPAWN_DO_NOT_REAP_CHILD,
+                                         {},
+                                         &pid,
+                                         &input,
+                                         &output,
+                                         nullptr);
+        }
+        catch (const Glib::SpawnError&) {
+            return;
+        }
+
+        std::string manifest;
+        for (std::size_t jobNumber : shard)
+            manifest += batchJobToJson(jobs.at(jobNumber)) + "\n";
+
+        // Written alongside the reading, so that neither pipe fills up waiting for the other
+        std::thread writer{[input, manifest = std::move(manifest)]() {
+            writeAll(input, manifest);
+            ::close(input);
+        }};
+
+        std::string pending;
+        std::array<char, 4096> buffer{};
+
+        while (true) {
+            const ssize_t size = ::read(output, buffer.data(), buffer.size());
+            if (size < 0 && errno == EINTR)
+                continue;
+            if (size <= 0)
+                break;
+
+            pending.append(buffer.data(), static_cast<std::size_t>(size));
+
+            for (auto end = pending.find('\n'); end != std::string::npos; end = pending.find('\n')) {
+                const std::string line = pending.substr(0, end);
+                pending.erase(0, end + 1);
+
+                try {
+                    const auto [manifestLine, result] = parseBatchJobResult(line);
+
+                    if (manifestLine >= 1 && manifestLine <= shard.size())
+                        onResult(shard.at(manifestLine - 1), result);
+                }
+                catch (const std::runtime_error&) {
+                    // Not a result: something else the worker printed
+                }
+            }
+        }
+
+        ::close(output);
+        writer.join();
+
+        // It exits unsuccessfully when any job failed, so its status tells nothing more
+        while (::waitpid(pid, nullptr, 0) < 0 && errno == EINTR)
+            continue;
+        Glib::spawn_close_pid(pid);
+    }
+}
+
+std::vector<BatchJobResult> dispatchBatchJobs(const std::vector<BatchJob>& jobs,
+                                              const BatchDispatchOptions& options,
+                                              const BatchJobFinishedSlot& onJobFinished)
+{
+    std::vector<std::vector<std::string>> workers;
+    for (const std::string& worker : options.workers) {
+        try {
+            std::vector<std::string> arguments = Glib::shell_parse_argv(worker);
+            arguments.emplace_back("--manifest");
+            arguments.emplace_back("-");
+            workers.push_back(std::move(arguments));
+        }
+        catch (const Glib::ShellError& e) {
+            throw std::runtime_error("Can't read the worker command '" + worker + "': " + e.what().raw());
+        }
+    }
+
+    // A worker that goes away mustn't take this process with it, as writing to it would
+    std::signal(SIGPIPE, SIG_IGN);
+
+    std::vector<BatchJobResult> results(jobs.size(), BatchJobResult{false, {}, {}, {}, {}});
+    std::vector<bool> isFinished(jobs.size(), false);
+    std::vector<unsigned int> attempts(jobs.size(), 0);
+
+    const std::size_t shardSize = options.shardSize != 0
+                                      ? options.shardSize
+                                      : std::max<std::size_t>(1, jobs.size() / std::max<std::size_t>(1, workers.size() * 4));
+    std::deque<Shard> shards;
+    for (std::size_t first = 0; first < jobs.size(); first += shardSize) {
+        Shard shard(std::min(shardSize, jobs.size() - first));
+        std::iota(shard.begin(), shard.end(), first);
+        shards.push_back(std::move(shard));
+    }
+
+    std::mutex mutex;
+    std::condition_variable shardsChanged;
+    std::size_t numberOfShardsOut = 0;
+
+    auto finish = [&](std::size_t jobNumber, const BatchJobResult& result) {
+        if (isFinished.at(jobNumber))
+            return;
+
+        isFinished.at(jobNumber) = true;
+        results.at(jobNumber) = result;
+
+        if (onJobFinished)
+            onJobFinished(jobNumber, results.at(jobNumber));
+    };
+
+    auto dispatch = [&](const std::vector<std::string>& worker) {
+        unsigned int numberOfFailures = 0;
+        std::unique_lock<std::mutex> lock{mutex};
+
+        while (numberOfFailures < maxWorkerFailures) {
+            shardsChanged.wait(lock, [&]() { return !shards.empty() || numberOfShardsOut == 0; });
+            if (shards.empty())
+                break;
+
+            const Shard shard = std::move(shards.front());
+            shards.pop_front();
+            ++numberOfShardsOut;
+            lock.unlock();
+
+            bool hasResult = false;
+            runShard(worker, jobs, shard, [&](std::size_t jobNumber, const BatchJobResult& result) {
+                std::lock_guard<std::mutex> resultLock{mutex};
+                finish(jobNumber, result);
+                hasResult = true;
+            });
+
+            lock.lock();
+            --numberOfShardsOut;
+            numberOfFailures = hasResult ? 0 : numberOfFailures + 1;
+
+            // What the worker didn't get to goes out again, to any worker
+            Shard lost;
+            for (std::size_t jobNumber : shard) {
+                if (isFinished.at(jobNumber))
+                    continue;
+
+                if (++attempts.at(jobNumber) > options.retries)
+                    finish(jobNumber, {false, "Lost the worker running the job " + std::to_string(attempts.at(jobNumber)) + " times", {}, {}, {}});
+                else
+                    lost.push_back(jobNumber);
+            }
+
+            if (!lost.empty())
+                shards.push_back(std::move(lost));
+
+            shardsChanged.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (const std::vector<std::string>& worker : workers)
+        threads.emplace_back(dispatch, std::cref(worker));
+
+    for (std::thread& thread : threads)
+        thread.join();
+
+    for (std::size_t jobNumber = 0; jobNumber < jobs.size(); ++jobNumber)
+        finish(jobNumber, {false, "No worker was left to run the job", {}, {}, {}});
+
+    return results;
+}
+
+} // namespace Slicer
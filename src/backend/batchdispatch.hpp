@@ -0,0 +1,54 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef BATCHDISPATCH_HPP
+#define BATCHDISPATCH_HPP
+
+#include "batchjob.hpp"
+#include <string>
+#include <vector>
+
+namespace Slicer {
+
+// Spreads batch jobs over worker processes, usually on other machines:
+// each worker is a command line, like "ssh node1 pdfslicer-cli -j 8", that
+// runs the headless slicer with "--manifest -" appended. Jobs go out in
+// shards, as manifest lines on the worker's standard input, and the result
+// lines it prints come back as results. The jobs' files are named by path,
+// so every worker must see them at the same place, through a shared
+// filesystem for instance.
+struct BatchDispatchOptions {
+    // Shell syntax, split as a shell would but not run by one
+    std::vector<std::string> workers;
+    // Jobs per shard; 0 for about four shards per worker, so that faster
+    // workers take more of them
+    std::size_t shardSize = 0;
+    // How often a job is sent again after losing the worker running it. Jobs
+    // that fail on their own aren't retried: they'd fail again.
+    unsigned int retries = 2;
+};
+
+// Like runBatchJobs(), with the same results and the same calls to
+// onJobFinished. A worker that keeps going away without a result is left
+// out, and its jobs fail once there's no worker left to run them.
+// Throws std::runtime_error if a worker command can't be parsed.
+std::vector<BatchJobResult> dispatchBatchJobs(const std::vector<BatchJob>& jobs,
+                                              const BatchDispatchOptions& options,
+                                              const BatchJobFinishedSlot& onJobFinished = {});
+
+} // namespace Slicer
+
+#endif // BATCHDISPATCH_HPP
@@ -0,0 +1,351 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "batchjob.hpp"
+#include "cpuresources.hpp"
+#include "document.hpp"
+#include "pagerangeexpression.hpp"
+#include <glibmm/miscutils.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace Slicer {
+
+std::vector<unsigned int> parsePageRanges(const std::string& pages, unsigned int numberOfPages)
+{
+    return parsePageSelection(pages, numberOfPages).selectedIndexes();
+}
+
+static void runOperation(PageSequence& sequence, const BatchOperation& operation)
+{
+    const std::vector<unsigned int> indexes = parsePageRanges(operation.pages,
+                                                              sequence.size());
+
+    switch (operation.type) {
+    case BatchOperation::Type::Remove:
+        if (indexes.size() == sequence.size())
+            throw std::runtime_error("Can't remove every page of the document");
+
+        sequence.remove(indexes);
+        break;
+
+    case BatchOperation::Type::RotateRight:
+        sequence.rotate(indexes, 1);
+        break;
+
+    case BatchOperation::Type::RotateLeft:
+        sequence.rotate(indexes, -1);
+        break;
+
+    case BatchOperation::Type::Move: {
+        const unsigned int first = indexes.front();
+        const unsigned int last = indexes.back();
+        const auto count = static_cast<unsigned int>(indexes.size());
+
+        if (last - first + 1 != count)
+            throw std::runtime_error("Only a contiguous range of pages can be moved");
+
+        if (operation.destination == 0 || operation.destination - 1 + count > sequence.size())
+            throw std::runtime_error("Invalid destination for the moved pages: "
+                                     + std::to_string(operation.destination));
+
+        sequence.moveRange(first, last, operation.destination - 1);
+        break;
+    }
+    }
+}
+
+static Glib::RefPtr<Gio::File> numberedFile(const Glib::RefPtr<Gio::File>& file, unsigned int number)
+{
+    std::string basename = file->get_basename();
+    std::string extension;
+
+    if (const auto dot = basename.rfind('.'); dot != std::string::npos && dot != 0) {
+        extension = basename.substr(dot);
+        basename.erase(dot);
+    }
+
+    const std::string name = basename + "-" + std::to_string(number) + extension;
+
+    return Gio::File::create_for_path(Glib::build_filename(file->get_parent()->get_path(), name));
+}
+
+static Glib::RefPtr<Gio::File> save(const BatchJob& job,
+                                    const PdfSaver::SaveData& saveData,
+                                    const Glib::RefPtr<Gio::File>& file,
+                                    BatchJobResult& result)
+{
+    PdfSaver saver{saveData, job.saveMode};
+    saver.setWriteProfile(job.writeProfile);
+    saver.setResourceCleanup(job.resourceCleanup);
+    saver.setImageDownsampling(job.imageDownsampling);
+    saver.setEncryption(job.encryption);
+    saver.save(file);
+    result.writeDuration += saver.lastWriteDuration();
+
+    return file;
+}
+
+static void saveToDescriptor(const BatchJob& job, const PdfSaver::SaveData& saveData, BatchJobResult& result)
+{
+    PdfSaver saver{saveData, job.saveMode};
+    saver.setWriteProfile(job.writeProfile);
+    saver.setResourceCleanup(job.resourceCleanup);
+    saver.setImageDownsampling(job.imageDownsampling);
+    saver.setEncryption(job.encryption);
+    saver.saveToDescriptor(job.outputDescriptor);
+    result.writeDuration += saver.lastWriteDuration();
+}
+
+static void exportImages(const BatchJob& job,
+                         const Document& document,
+                         unsigned int numberOfThreads,
+                         BatchJobResult& result)
+{
+    ImageExport::Options options = job.imageExport.value();
+    if (options.numberOfThreads == 0)
+        options.numberOfThreads = numberOfThreads;
+
+    std::vector<Glib::RefPtr<const Page>> pages;
+    for (unsigned int i = 0; i < document.numberOfPages(); ++i)
+        pages.push_back(document.getPage(i));
+
+    const bool hasExtension = job.output->get_basename().find('.', 1) != std::string::npos;
+    auto destinationOfPage = [&job, &options, hasExtension](std::size_t index) {
+        const Glib::RefPtr<Gio::File> file = numberedFile(job.output, static_cast<unsigned int>(index + 1));
+
+        if (hasExtension)
+            return file;
+
+        return Gio::File::create_for_path(file->get_path() + "." + ImageExport::formatName(options.format));
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    result.writtenFiles = ImageExport::exportPages(pages, destinationOfPage, options);
+    result.writeDuration += std::chrono::steady_clock::now() - start;
+}
+
+static void checkJob(const BatchJob& job)
+{
+    if (job.inputs.empty())
+        throw std::runtime_error("No input files given");
+
+    if (!job.output && job.outputDescriptor < 0)
+        throw std::runtime_error("No output file given");
+}
+
+static void runOperations(const BatchJob& job, Document& document)
+{
+    // Applied to the document once, whatever the number of operations
+    PageSequence sequence = document.pageSequence();
+
+    for (const BatchOperation& operation : job.operations)
+        runOperation(sequence, operation);
+
+    document.setPageSequence(sequence);
+}
+
+static bool splits(const BatchJob& job, const PdfSaver::SaveData& saveData)
+{
+    return job.splitSizeInBytes != 0 || job.splitAtOutline
+           || (job.splitEvery != 0 && job.splitEvery < saveData.pages.size());
+}
+
+// Where the parts split by outline or by number of pages start
+static std::vector<std::size_t> partStarts(const BatchJob& job, const PdfSaver::SaveData& saveData, PdfSaver& saver)
+{
+    if (job.splitAtOutline)
+        return saver.outlineStarts();
+
+    std::vector<std::size_t> starts;
+    for (std::size_t first = 0; first < saveData.pages.size(); first += job.splitEvery)
+        starts.push_back(first);
+
+    return starts;
+}
+
+static void runBatchJob(const BatchJob& job, BatchJobResult& result, unsigned int numberOfExportThreads)
+{
+    checkJob(job);
+
+    Document document{job.inputs};
+    runOperations(job, document);
+
+    const bool writesToDescriptor = job.outputDescriptor >= 0;
+
+    if (job.imageExport.has_value() && !writesToDescriptor) {
+        exportImages(job, document, numberOfExportThreads, result);
+        return;
+    }
+
+    const PdfSaver::SaveData saveData = document.getSaveData();
+
+    if (writesToDescriptor) {
+        if (job.imageExport.has_value() || splits(job, saveData))
+            throw std::runtime_error("Only a result saved as a single PDF file can be written to a pipe");
+
+        saveToDescriptor(job, saveData, result);
+        return;
+    }
+
+    if (!splits(job, saveData)) {
+        result.writtenFiles.push_back(save(job, saveData, job.output, result));
+        return;
+    }
+
+    // The inputs are parsed once, and every part is copied out of them
+    PdfSaver saver{saveData, job.saveMode};
+    saver.setWriteProfile(job.writeProfile);
+    saver.setResourceCleanup(job.resourceCleanup);
+    saver.setImageDownsampling(job.imageDownsampling);
+    saver.setEncryption(job.encryption);
+
+    auto destinationOfPart = [&job](unsigned int partNumber) {
+        return numberedFile(job.output, partNumber);
+    };
+
+    if (job.splitSizeInBytes != 0) {
+        result.writtenFiles = saver.savePartsOfSize(job.splitSizeInBytes, destinationOfPart);
+        result.writeDuration += saver.lastWriteDuration();
+        return;
+    }
+
+    const std::vector<std::size_t> starts = partStarts(job, saveData, saver);
+
+    std::vector<PdfSaver::Part> parts;
+    for (std::size_t i = 0; i < starts.size(); ++i) {
+        const std::size_t end = i + 1 < starts.size() ? starts.at(i + 1) : saveData.pages.size();
+        parts.push_back({starts.at(i), end, destinationOfPart(static_cast<unsigned int>(i + 1))});
+    }
+
+    saver.saveParts(parts);
+    result.writeDuration += saver.lastWriteDuration();
+
+    for (const PdfSaver::Part& part : parts)
+        result.writtenFiles.push_back(part.destinationFile);
+}
+
+std::vector<Glib::RefPtr<Gio::File>> runBatchJob(const BatchJob& job)
+{
+    BatchJobResult result{false, {}, {}, {}, {}};
+    runBatchJob(job, result, 0);
+
+    return result.writtenFiles;
+}
+
+std::vector<std::uint64_t> estimateBatchJob(const BatchJob& job)
+{
+    checkJob(job);
+
+    if (job.imageExport.has_value())
+        throw std::runtime_error("Only saved PDF files can be estimated, not exported images");
+
+    Document document{job.inputs};
+    runOperations(job, document);
+
+    const PdfSaver::SaveData saveData = document.getSaveData();
+
+    PdfSaver saver{saveData, job.saveMode};
+    saver.setWriteProfile(job.writeProfile);
+    saver.setResourceCleanup(job.resourceCleanup);
+
+    if (!splits(job, saveData))
+        return {saver.estimatedSize()};
+
+    std::vector<std::uint64_t> sizes;
+
+    if (job.splitSizeInBytes != 0) {
+        for (const PdfSaver::PartEstimate& part : saver.partsOfSize(job.splitSizeInBytes))
+            sizes.push_back(part.sizeInBytes);
+
+        return sizes;
+    }
+
+    const std::vector<std::size_t> starts = partStarts(job, saveData, saver);
+    for (std::size_t i = 0; i < starts.size(); ++i) {
+        const std::size_t end = i + 1 < starts.size() ? starts.at(i + 1) : saveData.pages.size();
+        sizes.push_back(saver.estimatedSizeOfPart(starts.at(i), end));
+    }
+
+    return sizes;
+}
+
+std::vector<BatchJobResult> runBatchJobs(const std::vector<BatchJob>& jobs,
+                                         unsigned int numberOfThreads,
+                                         const BatchJobFinishedSlot& onJobFinished)
+{
+    std::vector<BatchJobResult> results(jobs.size(), BatchJobResult{false, {}, {}, {}, {}});
+
+    if (numberOfThreads == 0)
+        numberOfThreads = CpuResources::availableCores();
+
+    numberOfThreads = std::min(numberOfThreads, static_cast<unsigned int>(jobs.size()));
+
+    // Image exports run on threads of their own, which share the cores with the other jobs
+    const unsigned int numberOfExportThreads = std::max(1U, CpuResources::availableCores() / std::max(1U, numberOfThreads));
+
+    // Jobs share nothing: each one opens its own documents.
+    // Workers take the next job as soon as they are done, so a slow input
+    // only keeps its own worker busy.
+    std::atomic<std::size_t> nextJob{0};
+    std::mutex finishedMutex;
+
+    auto worker = [&]() {
+        for (std::size_t i = nextJob++; i < jobs.size(); i = nextJob++) {
+            const auto start = std::chrono::steady_clock::now();
+
+            try {
+                runBatchJob(jobs[i], results[i], numberOfExportThreads);
+                results[i].succeeded = true;
+            }
+            catch (const Glib::Error& e) {
+                results[i].error = Glib::ustring{e.what()}.raw();
+            }
+            catch (const std::exception& e) {
+                results[i].error = e.what();
+            }
+
+            results[i].duration = std::chrono::steady_clock::now() - start;
+
+            if (onJobFinished) {
+                std::lock_guard<std::mutex> lock{finishedMutex};
+                onJobFinished(i, results[i]);
+            }
+        }
+    };
+
+    // On machines with several NUMA nodes, the workers are spread over them,
+    // and the image export threads they start stay on the node of their worker.
+    // The calling thread is left where it is.
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < numberOfThreads; ++i)
+        threads.emplace_back([&worker, i]() {
+            CpuResources::pinCurrentThreadToNode(i);
+            worker();
+        });
+
+    worker();
+
+    for (std::thread& thread : threads)
+        thread.join();
+
+    return results;
+}
+
+} // namespace Slicer
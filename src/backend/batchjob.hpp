@@ -0,0 +1,117 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef BATCHJOB_HPP
+#define BATCHJOB_HPP
+
+#include "imageexport.hpp"
+#include "pdfsaver.hpp"
+#include <giomm/file.h>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace Slicer {
+
+// One operation of a batch job. Pages are given with the same syntax users
+// type in the page range fields: 1-based, comma separated, "3-7" for a range,
+// "5-" for every page from the 5th one onwards.
+// Pages are resolved against the document as it is when the operation runs.
+struct BatchOperation {
+    enum class Type {
+        Remove,
+        RotateRight,
+        RotateLeft,
+        Move
+    };
+
+    Type type;
+    // A page range expression, see pagerangeexpression.hpp
+    std::string pages;
+    // Only for moves: 1-based position the first moved page ends up at
+    unsigned int destination = 0;
+};
+
+// Everything that can be done from the UI to a document, without a UI.
+// The inputs are opened as one document, in order (merging them when there's
+// more than one), the operations are applied in order, and the result is saved.
+struct BatchJob {
+    std::vector<Glib::RefPtr<Gio::File>> inputs;
+    std::vector<BatchOperation> operations;
+    Glib::RefPtr<Gio::File> output;
+    // When not zero, the result is split into files of this many pages,
+    // named like the output with a 1-based number appended
+    unsigned int splitEvery = 0;
+    PdfSaver::Mode saveMode = PdfSaver::Mode::Default;
+    PdfSaver::WriteProfile writeProfile = PdfSaver::WriteProfile::Default;
+    // When not zero, the result is split into files of about this size at most,
+    // named as with splitEvery
+    std::uint64_t splitSizeInBytes = 0;
+    // Splits the result into a file per top-level outline entry of the first
+    // input, named as with splitEvery
+    bool splitAtOutline = false;
+    PdfSaver::ResourceCleanup resourceCleanup = PdfSaver::ResourceCleanup::WhenPagesLeftOut;
+    // When set, every page of the result is written as an image instead,
+    // named as with splitEvery. Without a thread count, the cores are
+    // shared with the jobs running alongside.
+    std::optional<ImageExport::Options> imageExport;
+    // When set, images drawn at more than its resolution are scaled down
+    // in the saved result, see PdfSaver::setImageDownsampling()
+    std::optional<ImageDownsampling::Options> imageDownsampling;
+    // When set, the saved result is encrypted, see PdfSaver::setEncryption()
+    std::optional<PdfSaver::Encryption> encryption;
+    // When not -1, the result is written to this descriptor, like a pipe to
+    // the next program, instead of to output, see PdfSaver::saveToDescriptor().
+    // Only for results saved as a single PDF file.
+    int outputDescriptor = -1;
+};
+
+struct BatchJobResult {
+    bool succeeded;
+    std::string error;
+    std::vector<Glib::RefPtr<Gio::File>> writtenFiles;
+    std::chrono::duration<double> duration;
+    // Part of the above spent writing the output
+    std::chrono::duration<double> writeDuration;
+};
+
+// Called from the worker thread that ran the job, one call at a time
+using BatchJobFinishedSlot = std::function<void(std::size_t jobNumber, const BatchJobResult& result)>;
+
+// Parses a page range expression into sorted, 0-based indexes.
+// Throws std::runtime_error if it's malformed or out of the document.
+std::vector<unsigned int> parsePageRanges(const std::string& pages, unsigned int numberOfPages);
+
+// Throws std::runtime_error, or whatever poppler or qpdf throw, on failure
+std::vector<Glib::RefPtr<Gio::File>> runBatchJob(const BatchJob& job);
+
+// The sizes of the files the job would write, estimated without writing
+// them, see PdfSaver::estimatedSize(). Before images are scaled down, when
+// the job does that. Throws like runBatchJob(), and for jobs exporting images.
+std::vector<std::uint64_t> estimateBatchJob(const BatchJob& job);
+
+// Runs independent jobs on up to numberOfThreads threads (0 for one per core).
+// A failing job doesn't stop the others; results are in the same order as the jobs.
+std::vector<BatchJobResult> runBatchJobs(const std::vector<BatchJob>& jobs,
+                                         unsigned int numberOfThreads,
+                                         const BatchJobFinishedSlot& onJobFinished = {});
+
+} // namespace Slicer
+
+#endif // BATCHJOB_HPP
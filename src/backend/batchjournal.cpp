@@ -0,0 +1,219 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "batchjournal.hpp"
+#include "batchmanifest.hpp"
+#include <glibmm/checksum.h>
+#include <glibmm/error.h>
+#include <sstream>
+#include <stdexcept>
+
+namespace Slicer {
+
+namespace {
+    // Paths may hold tabs and line breaks, which would break up a line
+    std::string escaped(const std::string& text)
+    {
+        std::string result;
+
+        for (char c : text) {
+            if (c == '\\')
+                result += "\\\\";
+            else if (c == '\t')
+                result += "\\t";
+            else if (c == '\n')
+                result += "\\n";
+            else
+                result += c;
+        }
+
+        return result;
+    }
+
+    std::string unescaped(const std::string& text)
+    {
+        std::string result;
+
+        for (std::size_t i = 0; i < text.size(); ++i) {
+            if (text[i] != '\\' || i + 1 == text.size()) {
+                result += text[i];
+                continue;
+            }
+
+            const char next = text[++i];
+            result += next == 't' ? '\t' : next == 'n' ? '\n' : next;
+        }
+
+        return result;
+    }
+
+    std::vector<std::string> fieldsOf(const std::string& line)
+    {
+        std::vector<std::string> fields;
+        std::istringstream stream{line};
+
+        for (std::string field; std::getline(stream, field, '\t');)
+            fields.push_back(field);
+
+        return fields;
+    }
+
+    std::optional<std::uint64_t> sizeOf(const std::string& path)
+    {
+        try {
+            const auto info = Gio::File::create_for_path(path)->query_info(G_FILE_ATTRIBUTE_STANDARD_SIZE);
+
+            return static_cast<std::uint64_t>(info->get_size());
+        }
+        catch (const Glib::Error&) {
+            return std::nullopt;
+        }
+    }
+
+    std::string sha256Of(const std::string& path)
+    {
+        Glib::Checksum checksum{Glib::Checksum::CHECKSUM_SHA256};
+        std::ifstream file{path, std::ios::binary};
+        std::vector<char> buffer(1024 * 1024);
+
+        while (file.read(buffer.data(), static_cast<std::streamsize>(buffer.size())) || file.gcount() > 0)
+            checksum.update(reinterpret_cast<const guchar*>(buffer.data()), file.gcount()); //NOLINT
+
+        return checksum.get_string();
+    }
+} // namespace
+
+BatchJournal::BatchJournal(const std::string& path)
+{
+    // Lines that don't read back, like the last one of a run killed while
+    // writing it, are skipped: their jobs are done again
+    std::ifstream existing{path};
+    bool endsWithLineBreak = true;
+
+    for (std::string line; std::getline(existing, line);) {
+        endsWithLineBreak = !existing.eof();
+        const std::vector<std::string> fields = fieldsOf(line);
+
+        if (fields.empty() || (fields.size() - 1) % 3 != 0)
+            continue;
+
+        std::vector<Output> outputs;
+        try {
+            for (std::size_t i = 1; i < fields.size(); i += 3)
+                outputs.push_back({fields[i], std::stoull(fields[i + 1]), unescaped(fields[i + 2])});
+        }
+        catch (const std::exception&) {
+            continue;
+        }
+
+        m_finished[fields.front()] = std::move(outputs);
+    }
+
+    m_file.open(path, std::ios::app);
+    if (!m_file)
+        throw std::runtime_error("Couldn't open the journal " + path);
+
+    // Or the first line of this run would be glued to the cut one
+    if (!endsWithLineBreak)
+        m_file << std::endl;
+}
+
+std::string BatchJournal::keyOf(const BatchJob& job)
+{
+    std::string text = batchJobToJson(job);
+
+    for (const Glib::RefPtr<Gio::File>& input : job.inputs) {
+        try {
+            const auto info = input->query_info(G_FILE_ATTRIBUTE_STANDARD_SIZE "," G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+                                                G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+            text += " " + std::to_string(info->get_size()) + " "
+                    + std::to_string(info->get_attribute_uint64(G_FILE_ATTRIBUTE_TIME_MODIFIED)) + "."
+                    + std::to_string(info->get_attribute_uint32(G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC));
+        }
+        catch (const Glib::Error&) {
+            // The job fails when run, and nothing is recorded for it
+            text += " missing";
+        }
+    }
+
+    return Glib::Checksum::compute_checksum(Glib::Checksum::CHECKSUM_SHA256, text);
+}
+
+std::optional<std::vector<Glib::RefPtr<Gio::File>>> BatchJournal::finishedOutputs(const BatchJob& job) const
+{
+    if (job.outputDescriptor >= 0)
+        return std::nullopt;
+
+    const std::string key = keyOf(job);
+    std::vector<Output> outputs;
+
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+
+        const auto it = m_finished.find(key);
+        if (it == m_finished.end())
+            return std::nullopt;
+
+        outputs = it->second;
+    }
+
+    // Saves replace their destination in one rename, so a file of the size
+    // it had is the one written, unless something else wrote it since
+    std::vector<Glib::RefPtr<Gio::File>> files;
+
+    for (const Output& output : outputs) {
+        if (sizeOf(output.path) != output.size)
+            return std::nullopt;
+
+        files.push_back(Gio::File::create_for_path(output.path));
+    }
+
+    return files;
+}
+
+void BatchJournal::recordFinished(const BatchJob& job, const std::vector<Glib::RefPtr<Gio::File>>& writtenFiles)
+{
+    if (job.outputDescriptor >= 0)
+        return;
+
+    const std::string key = keyOf(job);
+    std::vector<Output> outputs;
+    std::string line = key;
+
+    for (const Glib::RefPtr<Gio::File>& file : writtenFiles) {
+        // Remote files can't be looked at again cheaply: their jobs are done again
+        const std::string path = file->get_path();
+        if (path.empty())
+            return;
+
+        outputs.push_back({sha256Of(path), sizeOf(path).value_or(0), path});
+        line += "\t" + outputs.back().sha256 + "\t" + std::to_string(outputs.back().size) + "\t" + escaped(path);
+    }
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+
+    m_file << line << std::endl;
+    m_finished[key] = std::move(outputs);
+}
+
+std::size_t BatchJournal::numberOfFinishedJobs() const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+
+    return m_finished.size();
+}
+
+} // namespace Slicer
@@ -0,0 +1,74 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef BATCHJOURNAL_HPP
+#define BATCHJOURNAL_HPP
+
+#include "batchjob.hpp"
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Slicer {
+
+// Remembers the batch jobs that finished, so that a run that died partway
+// can be started again and skip them. The journal is a file only ever
+// appended to, a line per finished job, flushed as soon as the job is done:
+// a run killed while writing a line loses that line, and nothing else.
+//
+// A line holds the key of the job, then the SHA-256, size and path of every
+// file it wrote, separated by tabs. The key is a hash of the job, as
+// batchJobToJson() gives it, and of the sizes and modification times of
+// its inputs, so a job is done again when it, or one of its inputs, changes.
+class BatchJournal {
+public:
+    // Reads what earlier runs left in the file, which is created when missing.
+    // Throws std::runtime_error when it can't be opened for appending.
+    explicit BatchJournal(const std::string& path);
+
+    // The files the job wrote when it finished in an earlier run, when they
+    // are all still there, with the sizes they had. Nothing otherwise, and
+    // for jobs writing to a descriptor, which leave nothing to find.
+    std::optional<std::vector<Glib::RefPtr<Gio::File>>> finishedOutputs(const BatchJob& job) const;
+
+    // Appends the job, with the hashes of the files it wrote. Takes a read
+    // of those files. With a mutex, so that any thread can call it.
+    void recordFinished(const BatchJob& job, const std::vector<Glib::RefPtr<Gio::File>>& writtenFiles);
+
+    // Jobs finished, in earlier runs or in this one
+    std::size_t numberOfFinishedJobs() const;
+
+    static std::string keyOf(const BatchJob& job);
+
+private:
+    struct Output {
+        std::string sha256;
+        std::uint64_t size;
+        std::string path;
+    };
+
+    std::unordered_map<std::string, std::vector<Output>> m_finished;
+    std::ofstream m_file;
+    mutable std::mutex m_mutex;
+};
+
+} // namespace Slicer
+
+#endif // BATCHJOURNAL_HPP
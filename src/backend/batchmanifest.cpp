@@ -0,0 +1,735 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "batchmanifest.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <iomanip>
+#include <iterator>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+namespace Slicer {
+
+namespace {
+
+// Just enough JSON for job manifests: no external dependency for a handful
+// of objects, arrays and strings
+struct JsonValue {
+    enum class Type {
+        Null,
+        Boolean,
+        Number,
+        String,
+        Array,
+        Object
+    };
+
+    Type type = Type::Null;
+    bool boolean = false;
+    double number = 0;
+    std::string string;
+    std::vector<JsonValue> elements;
+    std::vector<std::string> keys;
+    unsigned int line = 0;
+
+    const JsonValue* find(const std::string& key) const
+    {
+        for (std::size_t i = 0; i < keys.size(); ++i)
+            if (keys[i] == key)
+                return &elements[i];
+
+        return nullptr;
+    }
+};
+
+class JsonParser {
+public:
+    explicit JsonParser(const std::string& text, unsigned int firstLine = 1)
+        : m_text{text}
+        , m_line{firstLine}
+    {
+    }
+
+    JsonValue parseValue()
+    {
+        skipWhitespace();
+
+        JsonValue value;
+        value.line = m_line;
+
+        switch (peek()) {
+        case '{':
+            enterNested();
+            parseObject(value);
+            --m_depth;
+            break;
+        case '[':
+            enterNested();
+            parseArray(value);
+            --m_depth;
+            break;
+        case '"':
+            value.type = JsonValue::Type::String;
+            value.string = parseString();
+            break;
+        case 't':
+            expectWord("true");
+            value.type = JsonValue::Type::Boolean;
+            value.boolean = true;
+            break;
+        case 'f':
+            expectWord("false");
+            value.type = JsonValue::Type::Boolean;
+            break;
+        case 'n':
+            expectWord("null");
+            break;
+        default:
+            value.type = JsonValue::Type::Number;
+            value.number = parseNumber();
+        }
+
+        return value;
+    }
+
+    void expectEnd()
+    {
+        skipWhitespace();
+
+        if (m_position != m_text.size())
+            fail("Unexpected text after the end of the value");
+    }
+
+    char peek() const
+    {
+        return m_position < m_text.size() ? m_text[m_position] : '\0';
+    }
+
+    void expect(char character)
+    {
+        skipWhitespace();
+
+        if (peek() != character)
+            fail(std::string{"Expected '"} + character + "'");
+
+        ++m_position;
+    }
+
+    void skipWhitespace()
+    {
+        while (m_position < m_text.size() && std::isspace(static_cast<unsigned char>(m_text[m_position])) != 0) {
+            if (m_text[m_position] == '\n')
+                ++m_line;
+
+            ++m_position;
+        }
+    }
+
+    unsigned int line() const { return m_line; }
+
+    [[noreturn]] void fail(const std::string& message) const
+    {
+        throw std::runtime_error(message + " (line " + std::to_string(m_line) + ")");
+    }
+
+    // Far more than any manifest needs; values are parsed recursively, and
+    // a manifest may come from another process
+    static constexpr unsigned int maxDepth = 64;
+
+private:
+    const std::string& m_text;
+    std::size_t m_position = 0;
+    unsigned int m_line;
+    unsigned int m_depth = 0;
+
+    void enterNested()
+    {
+        if (++m_depth > maxDepth)
+            fail("Values nested too deeply");
+    }
+
+    void parseObject(JsonValue& value)
+    {
+        value.type = JsonValue::Type::Object;
+        expect('{');
+        skipWhitespace();
+
+        if (peek() == '}') {
+            ++m_position;
+            return;
+        }
+
+        while (true) {
+            skipWhitespace();
+            value.keys.push_back(parseString());
+            expect(':');
+            value.elements.push_back(parseValue());
+            skipWhitespace();
+
+            if (peek() != ',')
+                break;
+
+            ++m_position;
+        }
+
+        expect('}');
+    }
+
+    void parseArray(JsonValue& value)
+    {
+        value.type = JsonValue::Type::Array;
+        expect('[');
+        skipWhitespace();
+
+        if (peek() == ']') {
+            ++m_position;
+            return;
+        }
+
+        while (true) {
+            value.elements.push_back(parseValue());
+            skipWhitespace();
+
+            if (peek() != ',')
+                break;
+
+            ++m_position;
+        }
+
+        expect(']');
+    }
+
+    std::string parseString()
+    {
+        if (peek() != '"')
+            fail("Expected a string");
+
+        ++m_position;
+        std::string result;
+
+        while (m_position < m_text.size() && m_text[m_position] != '"') {
+            char character = m_text[m_position++];
+
+            if (character == '\\') {
+                if (m_position >= m_text.size())
+                    break;
+
+                switch (const char escaped = m_text[m_position++]) {
+                case 'n':
+                    character = '\n';
+                    break;
+                case 't':
+                    character = '\t';
+                    break;
+                case 'r':
+                    character = '\r';
+                    break;
+                case 'b':
+                    character = '\b';
+                    break;
+                case 'f':
+                    character = '\f';
+                    break;
+                case 'u':
+                    appendCodePoint(result, parseHex4());
+                    continue;
+                default:
+                    character = escaped;
+                }
+            }
+
+            result.push_back(character);
+        }
+
+        if (m_position >= m_text.size())
+            fail("Unterminated string");
+
+        ++m_position;
+
+        return result;
+    }
+
+    unsigned int parseHex4()
+    {
+        if (m_position + 4 > m_text.size())
+            fail("Invalid unicode escape");
+
+        const std::string digits = m_text.substr(m_position, 4);
+        m_position += 4;
+
+        if (digits.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos)
+            fail("Invalid unicode escape");
+
+        return static_cast<unsigned int>(std::stoul(digits, nullptr, 16));
+    }
+
+    static void appendCodePoint(std::string& result, unsigned int codePoint)
+    {
+        // Paths beyond the basic multilingual plane are rare enough that
+        // surrogate pairs are not combined
+        if (codePoint < 0x80) {
+            result.push_back(static_cast<char>(codePoint));
+        }
+        else if (codePoint < 0x800) {
+            result.push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+            result.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+        }
+        else {
+            result.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+            result.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+            result.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+        }
+    }
+
+    double parseNumber()
+    {
+        const std::size_t start = m_position;
+
+        while (m_position < m_text.size() && std::string{"+-.eE0123456789"}.find(m_text[m_position]) != std::string::npos)
+            ++m_position;
+
+        if (start == m_position)
+            fail("Unexpected character");
+
+        try {
+            return std::stod(m_text.substr(start, m_position - start));
+        }
+        catch (const std::logic_error&) {
+            fail("Invalid number");
+        }
+    }
+
+    void expectWord(const std::string& word)
+    {
+        if (m_text.compare(m_position, word.size(), word) != 0)
+            fail("Unexpected character");
+
+        m_position += word.size();
+    }
+};
+
+const std::string& stringMember(const JsonValue& object, const std::string& key)
+{
+    const JsonValue* member = object.find(key);
+
+    if (member == nullptr || member->type != JsonValue::Type::String)
+        throw std::runtime_error("Expected a string for \"" + key + "\"");
+
+    return member->string;
+}
+
+unsigned int countMember(const JsonValue& object, const std::string& key)
+{
+    const JsonValue* member = object.find(key);
+
+    if (member == nullptr)
+        return 0;
+
+    // Checked before the cast, which is undefined for what doesn't fit, NaN included
+    const double number = member->type == JsonValue::Type::Number ? member->number : -1;
+    if (!(number >= 0 && number <= std::numeric_limits<unsigned int>::max()) || std::floor(number) != number)
+        throw std::runtime_error("Expected a positive whole number for \"" + key + "\"");
+
+    return static_cast<unsigned int>(number);
+}
+
+BatchOperation parseOperation(const JsonValue& value)
+{
+    if (value.type != JsonValue::Type::Object)
+        throw std::runtime_error("Expected an object for every operation");
+
+    const std::string& name = stringMember(value, "op");
+    BatchOperation operation{BatchOperation::Type::Remove, stringMember(value, "pages")};
+
+    if (name == "remove")
+        operation.type = BatchOperation::Type::Remove;
+    else if (name == "rotate-right")
+        operation.type = BatchOperation::Type::RotateRight;
+    else if (name == "rotate-left")
+        operation.type = BatchOperation::Type::RotateLeft;
+    else if (name == "move") {
+        operation.type = BatchOperation::Type::Move;
+        operation.destination = countMember(value, "to");
+    }
+    else
+        throw std::runtime_error("Unknown operation: \"" + name + "\"");
+
+    return operation;
+}
+
+BatchJob jobFromJson(const JsonValue& value)
+{
+    if (value.type != JsonValue::Type::Object)
+        throw std::runtime_error("Expected a job object");
+
+    BatchJob job;
+
+    if (const JsonValue* inputs = value.find("inputs"); inputs != nullptr) {
+        if (inputs->type != JsonValue::Type::Array)
+            throw std::runtime_error("Expected an array for \"inputs\"");
+
+        for (const JsonValue& input : inputs->elements) {
+            if (input.type != JsonValue::Type::String)
+                throw std::runtime_error("Expected a string for every input");
+
+            job.inputs.push_back(Gio::File::create_for_commandline_arg(input.string));
+        }
+    }
+    else {
+        job.inputs.push_back(Gio::File::create_for_commandline_arg(stringMember(value, "input")));
+    }
+
+    job.output = Gio::File::create_for_commandline_arg(stringMember(value, "output"));
+    job.splitEvery = countMember(value, "split");
+    job.splitSizeInBytes = std::uint64_t{countMember(value, "split-size")} * 1024 * 1024;
+
+    if (const JsonValue* splitOutline = value.find("split-outline"); splitOutline != nullptr) {
+        if (splitOutline->type != JsonValue::Type::Boolean)
+            throw std::runtime_error("Expected true or false for \"split-outline\"");
+
+        job.splitAtOutline = splitOutline->boolean;
+    }
+
+    if (const JsonValue* lowMemory = value.find("low-memory"); lowMemory != nullptr) {
+        if (lowMemory->type != JsonValue::Type::Boolean)
+            throw std::runtime_error("Expected true or false for \"low-memory\"");
+
+        if (lowMemory->boolean)
+            job.saveMode = PdfSaver::Mode::LowMemory;
+    }
+
+    if (value.find("profile") != nullptr) {
+        const std::string& name = stringMember(value, "profile");
+        const std::optional<PdfSaver::WriteProfile> profile = PdfSaver::writeProfileFromName(name);
+
+        if (!profile.has_value())
+            throw std::runtime_error("Unknown profile: \"" + name + "\"");
+
+        job.writeProfile = profile.value();
+    }
+
+    if (value.find("resource-cleanup") != nullptr) {
+        const std::string& name = stringMember(value, "resource-cleanup");
+        const std::optional<PdfSaver::ResourceCleanup> cleanup = PdfSaver::resourceCleanupFromName(name);
+
+        if (!cleanup.has_value())
+            throw std::runtime_error("Unknown resource cleanup: \"" + name + "\"");
+
+        job.resourceCleanup = cleanup.value();
+    }
+
+    if (value.find("images") != nullptr) {
+        const std::string& name = stringMember(value, "images");
+        const std::optional<ImageExport::Format> format = ImageExport::formatFromName(name);
+
+        if (!format.has_value())
+            throw std::runtime_error("Unknown image format: \"" + name + "\"");
+
+        ImageExport::Options options;
+        options.format = format.value();
+
+        if (value.find("dpi") != nullptr)
+            options.dpi = countMember(value, "dpi");
+        if (value.find("quality") != nullptr)
+            options.quality = static_cast<int>(countMember(value, "quality"));
+
+        job.imageExport = options;
+    }
+
+    if (value.find("downsample-images") != nullptr) {
+        ImageDownsampling::Options options;
+        options.dpi = std::max(1U, countMember(value, "downsample-images"));
+        job.imageDownsampling = options;
+    }
+
+    if (value.find("password") != nullptr) {
+        const std::string& password = stringMember(value, "password");
+        job.encryption = PdfSaver::Encryption{password, password};
+    }
+
+    if (const JsonValue* operations = value.find("operations"); operations != nullptr) {
+        if (operations->type != JsonValue::Type::Array)
+            throw std::runtime_error("Expected an array for \"operations\"");
+
+        for (const JsonValue& operation : operations->elements)
+            job.operations.push_back(parseOperation(operation));
+    }
+
+    return job;
+}
+
+std::string quoted(const std::string& text)
+{
+    std::ostringstream result;
+    result << '"';
+
+    for (const char character : text) {
+        switch (character) {
+        case '"':
+            result << "\\\"";
+            break;
+        case '\\':
+            result << "\\\\";
+            break;
+        case '\n':
+            result << "\\n";
+            break;
+        default:
+            if (static_cast<unsigned char>(character) < 0x20)
+                result << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+                       << static_cast<int>(character) << std::dec;
+            else
+                result << character;
+        }
+    }
+
+    result << '"';
+
+    return result.str();
+}
+
+std::string quotedFile(const Glib::RefPtr<Gio::File>& file)
+{
+    const std::string path = file->get_path();
+
+    return quoted(path.empty() ? file->get_uri() : path);
+}
+
+std::string operationName(BatchOperation::Type type)
+{
+    switch (type) {
+    case BatchOperation::Type::Remove:
+        return "remove";
+    case BatchOperation::Type::RotateRight:
+        return "rotate-right";
+    case BatchOperation::Type::RotateLeft:
+        return "rotate-left";
+    case BatchOperation::Type::Move:
+        return "move";
+    }
+
+    return {};
+}
+
+double numberMember(const JsonValue& object, const std::string& key)
+{
+    const JsonValue* member = object.find(key);
+
+    return member != nullptr && member->type == JsonValue::Type::Number ? member->number : 0;
+}
+
+} // namespace
+
+BatchJob parseBatchJob(const std::string& text)
+{
+    JsonParser parser{text};
+    const JsonValue value = parser.parseValue();
+    parser.expectEnd();
+
+    return jobFromJson(value);
+}
+
+std::vector<BatchManifestEntry> readBatchManifest(std::istream& manifest)
+{
+    const std::string text{std::istreambuf_iterator<char>{manifest}, std::istreambuf_iterator<char>{}};
+    std::vector<BatchManifestEntry> entries;
+
+    auto addEntry = [&entries](unsigned int line, auto&& readJob) {
+        try {
+            entries.push_back({line, readJob(), {}});
+        }
+        catch (const std::exception& e) {
+            entries.push_back({line, std::nullopt, e.what()});
+        }
+    };
+
+    JsonParser documentParser{text};
+
+    // A single array of jobs
+    if (documentParser.skipWhitespace(); documentParser.peek() == '[') {
+        const JsonValue jobs = documentParser.parseValue();
+        documentParser.expectEnd();
+
+        for (const JsonValue& job : jobs.elements)
+            addEntry(job.line, [&job]() { return jobFromJson(job); });
+
+        return entries;
+    }
+
+    // JSON Lines: every line stands on its own, so a bad one only loses itself
+    std::istringstream lines{text};
+    std::string line;
+    unsigned int lineNumber = 0;
+
+    while (std::getline(lines, line)) {
+        ++lineNumber;
+
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+
+        addEntry(lineNumber, [&line, lineNumber]() {
+            JsonParser parser{line, lineNumber};
+            const JsonValue value = parser.parseValue();
+            parser.expectEnd();
+
+            return jobFromJson(value);
+        });
+    }
+
+    return entries;
+}
+
+std::string batchJobResultToJson(unsigned int line,
+                                 const BatchJobResult& result,
+                                 PdfSaver::WriteProfile writeProfile)
+{
+    std::ostringstream json;
+    json << "{\"line\": " << line
+         << ", \"status\": " << (result.succeeded ? "\"ok\"" : "\"error\"")
+         << ", \"seconds\": " << std::fixed << std::setprecision(3) << result.duration.count();
+
+    if (result.succeeded) {
+        json << ", \"outputs\": [";
+
+        for (std::size_t i = 0; i < result.writtenFiles.size(); ++i)
+            json << (i == 0 ? "" : ", ") << quoted(result.writtenFiles[i]->get_path());
+
+        json << "], \"profile\": " << quoted(PdfSaver::writeProfileName(writeProfile))
+             << ", \"write_seconds\": " << result.writeDuration.count();
+    }
+    else {
+        json << ", \"error\": " << quoted(result.error);
+    }
+
+    json << "}";
+
+    return json.str();
+}
+
+std::string inspectionToJson(const Glib::RefPtr<Gio::File>& file, const Inspection::Result& result)
+{
+    std::ostringstream json;
+    json << "{\"input\": " << quotedFile(file);
+
+    if (!result.info.has_value()) {
+        json << ", \"status\": \"error\", \"error\": " << quoted(result.error) << "}";
+        return json.str();
+    }
+
+    const Inspection::FileInfo& info = result.info.value();
+    json << ", \"status\": \"ok\""
+         << ", \"encrypted\": " << (info.isEncrypted ? "true" : "false")
+         << ", \"password-needed\": " << (info.needsPassword ? "true" : "false")
+         << ", \"pages\": " << info.pages.size()
+         << ", \"sizes\": [";
+
+    for (std::size_t i = 0; i < info.pages.size(); ++i) {
+        const Inspection::PageInfo& page = info.pages[i];
+        json << (i == 0 ? "" : ", ") << "[" << page.width << ", " << page.height << ", " << page.rotation << "]";
+    }
+
+    json << "]}";
+
+    return json.str();
+}
+
+std::string batchJobToJson(const BatchJob& job)
+{
+    std::ostringstream json;
+    json << "{\"inputs\": [";
+
+    for (std::size_t i = 0; i < job.inputs.size(); ++i)
+        json << (i == 0 ? "" : ", ") << quotedFile(job.inputs[i]);
+
+    json << "], \"output\": " << quotedFile(job.output);
+
+    if (job.splitEvery != 0)
+        json << ", \"split\": " << job.splitEvery;
+    if (job.splitSizeInBytes != 0)
+        json << ", \"split-size\": " << job.splitSizeInBytes / (1024 * 1024);
+    if (job.splitAtOutline)
+        json << ", \"split-outline\": true";
+    if (job.saveMode == PdfSaver::Mode::LowMemory)
+        json << ", \"low-memory\": true";
+
+    json << ", \"profile\": " << quoted(PdfSaver::writeProfileName(job.writeProfile))
+         << ", \"resource-cleanup\": " << quoted(PdfSaver::resourceCleanupName(job.resourceCleanup));
+
+    if (job.imageExport.has_value())
+        json << ", \"images\": " << quoted(ImageExport::formatName(job.imageExport->format))
+             << ", \"dpi\": " << job.imageExport->dpi
+             << ", \"quality\": " << job.imageExport->quality;
+
+    if (job.imageDownsampling.has_value())
+        json << ", \"downsample-images\": " << job.imageDownsampling->dpi;
+
+    if (job.encryption.has_value())
+        json << ", \"password\": " << quoted(job.encryption->userPassword);
+
+    json << ", \"operations\": [";
+
+    for (std::size_t i = 0; i < job.operations.size(); ++i) {
+        const BatchOperation& operation = job.operations[i];
+        json << (i == 0 ? "" : ", ") << "{\"op\": " << quoted(operationName(operation.type))
+             << ", \"pages\": " << quoted(operation.pages);
+
+        if (operation.type == BatchOperation::Type::Move)
+            json << ", \"to\": " << operation.destination;
+
+        json << "}";
+    }
+
+    json << "]}";
+
+    return json.str();
+}
+
+std::pair<unsigned int, BatchJobResult> parseBatchJobResult(const std::string& text)
+{
+    JsonParser parser{text};
+    const JsonValue value = parser.parseValue();
+    parser.expectEnd();
+
+    if (value.type != JsonValue::Type::Object)
+        throw std::runtime_error("Expected a result object");
+
+    const std::string& status = stringMember(value, "status");
+    if (status != "ok" && status != "error")
+        throw std::runtime_error("Unknown status: \"" + status + "\"");
+
+    BatchJobResult result{status == "ok", {}, {}, {}, {}};
+    result.duration = std::chrono::duration<double>{numberMember(value, "seconds")};
+    result.writeDuration = std::chrono::duration<double>{numberMember(value, "write_seconds")};
+
+    if (result.succeeded) {
+        if (const JsonValue* outputs = value.find("outputs"); outputs != nullptr && outputs->type == JsonValue::Type::Array) {
+            for (const JsonValue& output : outputs->elements) {
+                if (output.type == JsonValue::Type::String)
+                    result.writtenFiles.push_back(Gio::File::create_for_commandline_arg(output.string));
+            }
+        }
+    }
+    else {
+        result.error = stringMember(value, "error");
+    }
+
+    return {countMember(value, "line"), result};
+}
+
+} // namespace Slicer
@@ -0,0 +1,85 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef BATCHMANIFEST_HPP
+#define BATCHMANIFEST_HPP
+
+#include "batchjob.hpp"
+#include "inspection.hpp"
+#include <istream>
+#include <optional>
+#include <utility>
+
+namespace Slicer {
+
+// A job manifest lists batch jobs as JSON: either one job object per line
+// (JSON Lines), or a single array of job objects. A job looks like
+//
+//   {"inputs": ["a.pdf", "b.pdf"], "output": "out.pdf", "split": 10,
+//    "operations": [{"op": "remove", "pages": "1-3"},
+//                   {"op": "rotate-right", "pages": "4-"},
+//                   {"op": "rotate-left", "pages": "2"},
+//                   {"op": "move", "pages": "5-6", "to": 1}]}
+//
+// "input" can be given instead of "inputs" for a single file,
+// "low-memory": true saves with PdfSaver::Mode::LowMemory, "profile"
+// picks a PdfSaver::WriteProfile by name, and "resource-cleanup" a
+// PdfSaver::ResourceCleanup. Instead of "split", "split-size"
+// splits in files of at most that many megabytes, and "split-outline": true
+// in a file per top-level outline entry. "images": "png", "jpg" or "webp"
+// writes the pages as images instead, at "dpi" and "quality" when given.
+// "downsample-images" scales images down to that many dots per inch, see
+// ImageDownsampling, and "password" encrypts the result to be opened with it.
+struct BatchManifestEntry {
+    // 1-based line of the manifest where the job starts
+    unsigned int line;
+    // Empty when the entry couldn't be read; error says why
+    std::optional<BatchJob> job;
+    std::string error;
+};
+
+// A malformed entry is reported in its BatchManifestEntry and doesn't
+// prevent reading the rest. Throws std::runtime_error only for a
+// malformed top level array.
+std::vector<BatchManifestEntry> readBatchManifest(std::istream& manifest);
+
+// Throws std::runtime_error if text isn't a valid job object
+BatchJob parseBatchJob(const std::string& text);
+
+// One line of JSON describing how a job went, for streaming the results
+std::string batchJobResultToJson(unsigned int line,
+                                 const BatchJobResult& result,
+                                 PdfSaver::WriteProfile writeProfile = PdfSaver::WriteProfile::Default);
+
+// One line of JSON that parseBatchJob() reads back as the same job, for
+// sending jobs to other processes
+std::string batchJobToJson(const BatchJob& job);
+
+// One line of JSON with what was found of a file, or why it couldn't be:
+//
+//   {"input": "a.pdf", "status": "ok", "encrypted": false, "password-needed": false,
+//    "pages": 2, "sizes": [[595, 842, 0], [842, 595, 90]]}
+//
+// Sizes are width, height and rotation of each page, see Inspection::PageInfo.
+std::string inspectionToJson(const Glib::RefPtr<Gio::File>& file, const Inspection::Result& result);
+
+// The line and result of a batchJobResultToJson() line.
+// Throws std::runtime_error if text isn't one.
+std::pair<unsigned int, BatchJobResult> parseBatchJobResult(const std::string& text);
+
+} // namespace Slicer
+
+#endif // BATCHMANIFEST_HPP
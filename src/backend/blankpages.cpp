@@ -0,0 +1,300 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "blankpages.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SLICER_BLANK_X86
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#define SLICER_BLANK_NEON
+#include <arm_neon.h>
+#endif
+
+namespace Slicer::BlankPages {
+
+// Pages with more ink than this, in parts of the page, have something on them
+static constexpr double maximumInkCoverage = 0.001;
+// Out of 255. Paper and the noise of scanning it stay well below this.
+static constexpr double maximumStandardDeviation = 8.0;
+// Out of the width and height, on each side
+static constexpr double marginFraction = 0.05;
+
+// Luma with the BT.601 weights, in 8 bit fixed point
+static constexpr std::uint32_t redWeight = 77;
+static constexpr std::uint32_t greenWeight = 150;
+static constexpr std::uint32_t blueWeight = 29;
+
+double Statistics::inkCoverage() const
+{
+    return numberOfPixels == 0 ? 0 : static_cast<double>(numberOfInkPixels) / static_cast<double>(numberOfPixels);
+}
+
+double Statistics::standardDeviation() const
+{
+    if (numberOfPixels == 0)
+        return 0;
+
+    const double count = static_cast<double>(numberOfPixels);
+    const double mean = static_cast<double>(sum) / count;
+    const double variance = static_cast<double>(sumOfSquares) / count - mean * mean;
+
+    return variance > 0 ? std::sqrt(variance) : 0;
+}
+
+static void measureRowScalar(const std::uint8_t* row, int width, Statistics& statistics)
+{
+    for (int x = 0; x < width; ++x) {
+        const std::uint8_t* pixel = row + 4 * x;
+        const std::uint32_t gray = (redWeight * pixel[0] + greenWeight * pixel[1] + blueWeight * pixel[2]) >> 8;
+
+        statistics.sum += gray;
+        statistics.sumOfSquares += gray * gray;
+        statistics.numberOfInkPixels += gray < inkThreshold ? 1 : 0;
+    }
+
+    statistics.numberOfPixels += static_cast<std::uint64_t>(width);
+}
+
+#ifdef SLICER_BLANK_X86
+// Four pixels at a time, with the gray level of each in its own 32 bit lane.
+// Lanes hold a row's worth of sums at most, see measure().
+static void measureRowSse2(const std::uint8_t* row, int width, Statistics& statistics)
+{
+    // With a little endian CPU, the bytes R, G, B, A are the word ABGR
+    const __m128i redBlueMask = _mm_set1_epi32(0x00ff00ff);
+    const __m128i lowByteMask = _mm_set1_epi32(0xff);
+    const __m128i redBlueWeights = _mm_set1_epi32(static_cast<int>((blueWeight << 16) | redWeight));
+    const __m128i greenWeights = _mm_set1_epi32(static_cast<int>(greenWeight));
+    const __m128i threshold = _mm_set1_epi32(inkThreshold);
+    __m128i sum = _mm_setzero_si128();
+    __m128i sumOfSquares = _mm_setzero_si128();
+    __m128i numberOfInkPixels = _mm_setzero_si128();
+    int x = 0;
+
+    for (; x + 4 <= width; x += 4) {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + 4 * x)); //NOLINT
+        const __m128i redBlue = _mm_and_si128(pixels, redBlueMask);
+        const __m128i green = _mm_and_si128(_mm_srli_epi32(pixels, 8), lowByteMask);
+        const __m128i gray = _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(redBlue, redBlueWeights),
+                                                          _mm_madd_epi16(green, greenWeights)),
+                                            8);
+
+        sum = _mm_add_epi32(sum, gray);
+        sumOfSquares = _mm_add_epi32(sumOfSquares, _mm_madd_epi16(gray, gray));
+        // Lanes that compare are all ones, that is -1
+        numberOfInkPixels = _mm_sub_epi32(numberOfInkPixels, _mm_cmpgt_epi32(threshold, gray));
+    }
+
+    alignas(16) std::uint32_t lanes[3][4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes[0]), sum); //NOLINT
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes[1]), sumOfSquares); //NOLINT
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes[2]), numberOfInkPixels); //NOLINT
+
+    for (int lane = 0; lane < 4; ++lane) {
+        statistics.sum += lanes[0][lane]; //NOLINT
+        statistics.sumOfSquares += lanes[1][lane]; //NOLINT
+        statistics.numberOfInkPixels += lanes[2][lane]; //NOLINT
+    }
+
+    statistics.numberOfPixels += static_cast<std::uint64_t>(x);
+    measureRowScalar(row + 4 * x, width - x, statistics);
+}
+
+__attribute__((target("avx2"))) static void measureRowAvx2(const std::uint8_t* row,
+                                                           int width,
+                                                           Statistics& statistics)
+{
+    const __m256i redBlueMask = _mm256_set1_epi32(0x00ff00ff);
+    const __m256i lowByteMask = _mm256_set1_epi32(0xff);
+    const __m256i redBlueWeights = _mm256_set1_epi32(static_cast<int>((blueWeight << 16) | redWeight));
+    const __m256i greenWeights = _mm256_set1_epi32(static_cast<int>(greenWeight));
+    const __m256i threshold = _mm256_set1_epi32(inkThreshold);
+    __m256i sum = _mm256_setzero_si256();
+    __m256i sumOfSquares = _mm256_setzero_si256();
+    __m256i numberOfInkPixels = _mm256_setzero_si256();
+    int x = 0;
+
+    for (; x + 8 <= width; x += 8) {
+        const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + 4 * x)); //NOLINT
+        const __m256i redBlue = _mm256_and_si256(pixels, redBlueMask);
+        const __m256i green = _mm256_and_si256(_mm256_srli_epi32(pixels, 8), lowByteMask);
+        const __m256i gray = _mm256_srli_epi32(_mm256_add_epi32(_mm256_madd_epi16(redBlue, redBlueWeights),
+                                                                _mm256_madd_epi16(green, greenWeights)),
+                                               8);
+
+        sum = _mm256_add_epi32(sum, gray);
+        sumOfSquares = _mm256_add_epi32(sumOfSquares, _mm256_madd_epi16(gray, gray));
+        numberOfInkPixels = _mm256_sub_epi32(numberOfInkPixels, _mm256_cmpgt_epi32(threshold, gray));
+    }
+
+    alignas(32) std::uint32_t lanes[3][8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes[0]), sum); //NOLINT
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes[1]), sumOfSquares); //NOLINT
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes[2]), numberOfInkPixels); //NOLINT
+
+    for (int lane = 0; lane < 8; ++lane) {
+        statistics.sum += lanes[0][lane]; //NOLINT
+        statistics.sumOfSquares += lanes[1][lane]; //NOLINT
+        statistics.numberOfInkPixels += lanes[2][lane]; //NOLINT
+    }
+
+    statistics.numberOfPixels += static_cast<std::uint64_t>(x);
+    measureRowSse2(row + 4 * x, width - x, statistics);
+}
+#endif
+
+#ifdef SLICER_BLANK_NEON
+static void measureRowNeon(const std::uint8_t* row, int width, Statistics& statistics)
+{
+    const uint8x8_t redWeights = vdup_n_u8(redWeight);
+    const uint8x8_t greenWeights = vdup_n_u8(greenWeight);
+    const uint8x8_t blueWeights = vdup_n_u8(blueWeight);
+    const uint8x16_t threshold = vdupq_n_u8(inkThreshold);
+    uint32x4_t sum = vdupq_n_u32(0);
+    uint32x4_t sumOfSquares = vdupq_n_u32(0);
+    uint32x4_t numberOfInkPixels = vdupq_n_u32(0);
+    int x = 0;
+
+    for (; x + 16 <= width; x += 16) {
+        // Loads as planes: val[0] is red, val[1] green, val[2] blue
+        const uint8x16x4_t pixels = vld4q_u8(row + 4 * x);
+
+        uint16x8_t low = vmull_u8(vget_low_u8(pixels.val[0]), redWeights);
+        low = vmlal_u8(low, vget_low_u8(pixels.val[1]), greenWeights);
+        low = vmlal_u8(low, vget_low_u8(pixels.val[2]), blueWeights);
+        uint16x8_t high = vmull_u8(vget_high_u8(pixels.val[0]), redWeights);
+        high = vmlal_u8(high, vget_high_u8(pixels.val[1]), greenWeights);
+        high = vmlal_u8(high, vget_high_u8(pixels.val[2]), blueWeights);
+        const uint8x16_t gray = vcombine_u8(vshrn_n_u16(low, 8), vshrn_n_u16(high, 8));
+
+        sum = vpadalq_u16(sum, vpaddlq_u8(gray));
+        sumOfSquares = vpadalq_u16(sumOfSquares, vmull_u8(vget_low_u8(gray), vget_low_u8(gray)));
+        sumOfSquares = vpadalq_u16(sumOfSquares, vmull_u8(vget_high_u8(gray), vget_high_u8(gray)));
+        numberOfInkPixels = vpadalq_u16(numberOfInkPixels, vpaddlq_u8(vshrq_n_u8(vcltq_u8(gray, threshold), 7)));
+    }
+
+    statistics.sum += vaddvq_u32(sum);
+    statistics.sumOfSquares += vaddvq_u32(sumOfSquares);
+    statistics.numberOfInkPixels += vaddvq_u32(numberOfInkPixels);
+    statistics.numberOfPixels += static_cast<std::uint64_t>(x);
+    measureRowScalar(row + 4 * x, width - x, statistics);
+}
+#endif
+
+using RowMeasurer = void (*)(const std::uint8_t*, int, Statistics&);
+
+struct Implementation {
+    RowMeasurer measureRow;
+    const char* name;
+};
+
+static Implementation pickImplementation()
+{
+#ifdef SLICER_BLANK_X86
+    if (__builtin_cpu_supports("avx2"))
+        return {measureRowAvx2, "avx2"};
+
+    return {measureRowSse2, "sse2"};
+#elif defined(SLICER_BLANK_NEON)
+    return {measureRowNeon, "neon"};
+#else
+    return {measureRowScalar, "scalar"};
+#endif
+}
+
+static const Implementation& implementation()
+{
+    static const Implementation result = pickImplementation();
+
+    return result;
+}
+
+static bool isLittleEndian()
+{
+    const std::uint32_t one = 1;
+    std::uint8_t firstByte;
+    std::memcpy(&firstByte, &one, 1);
+
+    return firstByte == 1;
+}
+
+Statistics measure(const std::uint8_t* pixels, int stride, int width, int height)
+{
+    // The x86 code assumes the byte order of the words it loads
+    if (!isLittleEndian())
+        return measureScalar(pixels, stride, width, height);
+
+    const RowMeasurer measureRow = implementation().measureRow;
+    Statistics statistics;
+
+    for (int y = 0; y < height; ++y)
+        measureRow(pixels + y * stride, width, statistics);
+
+    return statistics;
+}
+
+Statistics measureScalar(const std::uint8_t* pixels, int stride, int width, int height)
+{
+    Statistics statistics;
+
+    for (int y = 0; y < height; ++y)
+        measureRowScalar(pixels + y * stride, width, statistics);
+
+    return statistics;
+}
+
+bool isBlank(const Statistics& statistics)
+{
+    return statistics.numberOfPixels > 0
+           && statistics.inkCoverage() <= maximumInkCoverage
+           && statistics.standardDeviation() <= maximumStandardDeviation;
+}
+
+bool isBlank(const Glib::RefPtr<const Gdk::Pixbuf>& page)
+{
+    if (!page || page->get_bits_per_sample() != 8)
+        return false;
+
+    // Scanned pages come without alpha
+    const Glib::RefPtr<const Gdk::Pixbuf> rgba = page->get_has_alpha() ? page : page->add_alpha(false, 0, 0, 0);
+
+    const int marginX = std::max(1, static_cast<int>(rgba->get_width() * marginFraction));
+    const int marginY = std::max(1, static_cast<int>(rgba->get_height() * marginFraction));
+    const int width = rgba->get_width() - 2 * marginX;
+    const int height = rgba->get_height() - 2 * marginY;
+
+    if (width <= 0 || height <= 0)
+        return false;
+
+    const std::uint8_t* pixels = rgba->read_pixels() + marginY * rgba->get_rowstride() + 4 * marginX; //NOLINT
+
+    return isBlank(measure(pixels, rgba->get_rowstride(), width, height));
+}
+
+const char* measureImplementation()
+{
+    if (!isLittleEndian())
+        return "scalar";
+
+    return implementation().name;
+}
+
+} // namespace Slicer::BlankPages
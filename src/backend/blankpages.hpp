@@ -0,0 +1,62 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef BLANKPAGES_HPP
+#define BLANKPAGES_HPP
+
+#include <gdkmm/pixbuf.h>
+#include <cstdint>
+
+namespace Slicer::BlankPages {
+
+// How much ink a page has, from the gray level of its pixels
+struct Statistics {
+    std::uint64_t numberOfPixels = 0;
+    // Pixels darker than inkThreshold
+    std::uint64_t numberOfInkPixels = 0;
+    std::uint64_t sum = 0;
+    std::uint64_t sumOfSquares = 0;
+
+    double inkCoverage() const;
+    double standardDeviation() const;
+};
+
+// Gray levels below this count as ink, above it as paper
+constexpr std::uint8_t inkThreshold = 160;
+
+// Measures straight alpha RGBA bytes (what Gdk::Pixbuf holds), ignoring
+// alpha. Strides are in bytes. Uses the widest vector instructions the CPU
+// has; rows must be narrower than 16384 pixels.
+Statistics measure(const std::uint8_t* pixels, int stride, int width, int height);
+
+// Plain C++ version of the above, for reference and for odd platforms
+Statistics measureScalar(const std::uint8_t* pixels, int stride, int width, int height);
+
+// Whether the page looks like it has nothing on it: almost no ink, and
+// hardly any change of tone, unlike light text or photos
+bool isBlank(const Statistics& statistics);
+
+// Same, for a render or thumbnail of the page. A margin around the edges,
+// where the outline and the shadows of scanning are, is left out.
+bool isBlank(const Glib::RefPtr<const Gdk::Pixbuf>& page);
+
+// Name of the implementation measure() picked, such as "avx2"
+const char* measureImplementation();
+
+} // namespace Slicer::BlankPages
+
+#endif // BLANKPAGES_HPP
@@ -15,9 +15,21 @@
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "command.hpp"
+#include <memory_resource>
+#include <unordered_set>
 
 namespace Slicer {
 
+static std::size_t sizeOfPages(const std::vector<Glib::RefPtr<Page>>& pages)
+{
+    std::size_t size = 0;
+
+    for (const auto& page : pages)
+        size += page->sizeInBytes();
+
+    return size;
+}
+
 RemovePageCommand::RemovePageCommand(Document& document,
                                      unsigned int position)
     : m_document{document}
@@ -40,6 +52,11 @@ void RemovePageCommand::redo()
     m_document.removePage(m_position);
 }
 
+std::size_t RemovePageCommand::sizeInBytes() const
+{
+    return m_removedPage ? m_removedPage->sizeInBytes() : 0;
+}
+
 RemovePagesCommand::RemovePagesCommand(Document& document,
                                        const std::vector<unsigned int>& listPositions)
     : m_document{document}
@@ -62,6 +79,11 @@ void RemovePagesCommand::redo()
     m_document.removePages(m_listPositions);
 }
 
+std::size_t RemovePagesCommand::sizeInBytes() const
+{
+    return sizeOfPages(m_removedPages);
+}
+
 RemovePageRangeCommand::RemovePageRangeCommand(Document& document,
                                                unsigned int first,
                                                unsigned int last)
@@ -86,48 +108,58 @@ void RemovePageRangeCommand::redo()
     m_document.removePageRange(m_first, m_last);
 }
 
-RotatePagesRightCommand::RotatePagesRightCommand(Document& document,
-                                                 const std::vector<unsigned int>& pageNumbers)
+std::size_t RemovePageRangeCommand::sizeInBytes() const
+{
+    return sizeOfPages(m_removedPages);
+}
+
+RotatePagesCommand::RotatePagesCommand(Document& document,
+                                       const std::vector<unsigned int>& pageNumbers,
+                                       int quarterTurns)
     : m_document{document}
     , m_pageNumbers{pageNumbers}
+    , m_quarterTurns{quarterTurns}
 {
 }
 
-void RotatePagesRightCommand::execute()
+void RotatePagesCommand::execute()
 {
-    m_document.rotatePagesRight(m_pageNumbers);
+    m_document.rotatePages(m_pageNumbers, m_quarterTurns);
 }
 
-void RotatePagesRightCommand::undo()
+void RotatePagesCommand::undo()
 {
-    m_document.rotatePagesLeft(m_pageNumbers);
+    m_document.rotatePages(m_pageNumbers, -m_quarterTurns);
 }
 
-void RotatePagesRightCommand::redo()
+void RotatePagesCommand::redo()
 {
     execute();
 }
 
-RotatePagesLeftCommand::RotatePagesLeftCommand(Document& document,
-                                               const std::vector<unsigned int>& pageNumbers)
-    : m_document{document}
-    , m_pageNumbers{pageNumbers}
+bool RotatePagesCommand::mergeWith(const Command& next)
 {
-}
+    const auto nextRotation = dynamic_cast<const RotatePagesCommand*>(&next);
 
-void RotatePagesLeftCommand::execute()
-{
-    m_document.rotatePagesLeft(m_pageNumbers);
+    if (nextRotation == nullptr || nextRotation->m_pageNumbers != m_pageNumbers)
+        return false;
+
+    // Kept within a turn, so that undo never does more than one pass
+    m_quarterTurns = (m_quarterTurns + nextRotation->m_quarterTurns) % 4;
+
+    return true;
 }
 
-void RotatePagesLeftCommand::undo()
+RotatePagesRightCommand::RotatePagesRightCommand(Document& document,
+                                                 const std::vector<unsigned int>& pageNumbers)
+    : RotatePagesCommand{document, pageNumbers, 1}
 {
-    m_document.rotatePagesRight(m_pageNumbers);
 }
 
-void RotatePagesLeftCommand::redo()
+RotatePagesLeftCommand::RotatePagesLeftCommand(Document& document,
+                                               const std::vector<unsigned int>& pageNumbers)
+    : RotatePagesCommand{document, pageNumbers, -1}
 {
-    execute();
 }
 
 MovePageCommand::MovePageCommand(Document& document,
@@ -141,12 +173,15 @@ MovePageCommand::MovePageCommand(Document& document,
 
 void MovePageCommand::execute()
 {
-    m_document.movePage(m_indexToMove, m_indexDestination);
+    if (m_indexToMove != m_indexDestination)
+        m_document.movePage(m_indexToMove, m_indexDestination);
 }
 
 void MovePageCommand::undo()
 {
-    m_document.movePage(m_indexDestination, m_indexToMove);
+    // Moves that were merged may have brought the page back where it was
+    if (m_indexToMove != m_indexDestination)
+        m_document.movePage(m_indexDestination, m_indexToMove);
 }
 
 void MovePageCommand::redo()
@@ -154,6 +189,18 @@ void MovePageCommand::redo()
     execute();
 }
 
+bool MovePageCommand::mergeWith(const Command& next)
+{
+    const auto nextMove = dynamic_cast<const MovePageCommand*>(&next);
+
+    if (nextMove == nullptr || nextMove->m_indexToMove != m_indexDestination)
+        return false;
+
+    m_indexDestination = nextMove->m_indexDestination;
+
+    return true;
+}
+
 MovePageRangeCommand::MovePageRangeCommand(Document& document,
                                            unsigned int indexFirst,
                                            unsigned int indexLast,
@@ -167,16 +214,18 @@ MovePageRangeCommand::MovePageRangeCommand(Document& document,
 
 void MovePageRangeCommand::execute()
 {
-    m_document.movePageRange(m_indexFirst, m_indexLast, m_indexDestination);
+    if (m_indexFirst != m_indexDestination)
+        m_document.movePageRange(m_indexFirst, m_indexLast, m_indexDestination);
 }
 
 void MovePageRangeCommand::undo()
 {
     const unsigned int numberOfPages = m_indexLast - m_indexFirst + 1;
 
-    m_document.movePageRange(m_indexDestination,
-                             m_indexDestination + numberOfPages - 1,
-                             m_indexFirst);
+    if (m_indexFirst != m_indexDestination)
+        m_document.movePageRange(m_indexDestination,
+                                 m_indexDestination + numberOfPages - 1,
+                                 m_indexFirst);
 }
 
 void MovePageRangeCommand::redo()
@@ -184,6 +233,44 @@ void MovePageRangeCommand::redo()
     execute();
 }
 
+bool MovePageRangeCommand::mergeWith(const Command& next)
+{
+    const auto nextMove = dynamic_cast<const MovePageRangeCommand*>(&next);
+
+    if (nextMove == nullptr
+        || nextMove->m_indexFirst != m_indexDestination
+        || nextMove->m_indexLast - nextMove->m_indexFirst != m_indexLast - m_indexFirst)
+        return false;
+
+    m_indexDestination = nextMove->m_indexDestination;
+
+    return true;
+}
+
+MovePagesCommand::MovePagesCommand(Document& document,
+                                   const std::vector<unsigned int>& indexes,
+                                   unsigned int destination)
+    : m_document{document}
+    , m_indexes{indexes}
+    , m_destination{destination}
+{
+}
+
+void MovePagesCommand::execute()
+{
+    m_document.movePages(m_indexes, m_destination);
+}
+
+void MovePagesCommand::undo()
+{
+    m_document.returnMovedPages(m_indexes, m_destination);
+}
+
+void MovePagesCommand::redo()
+{
+    execute();
+}
+
 AddFilesCommand::AddFilesCommand(Document& document,
                                  const std::vector<Glib::RefPtr<Gio::File>>& files,
                                  unsigned int position)
@@ -206,6 +293,135 @@ void AddFilesCommand::undo()
 void AddFilesCommand::redo()
 {
     m_document.insertPageRange(m_addedPages, m_position);
+    // The next undo takes them out of the document again
+    m_addedPages.clear();
+}
+
+std::size_t AddFilesCommand::sizeInBytes() const
+{
+    // Only holds pages once undone, the document owns them otherwise
+    return sizeOfPages(m_addedPages);
+}
+
+EditPagesCommand::EditPagesCommand(Document& document,
+                                   std::function<void(PageSequence&)> edit)
+    : m_document{document}
+    , m_edit{std::move(edit)}
+    , m_before{document.pageSequence()}
+{
+}
+
+void EditPagesCommand::prepare()
+{
+    switch (m_state) {
+    case State::New:
+        applyEdit();
+        m_change = Document::changeBetween(m_before, m_after);
+        break;
+    case State::Executed:
+        m_change = Document::changeBetween(m_after, m_before);
+        break;
+    case State::Undone:
+        m_change = Document::changeBetween(m_before, m_after);
+        break;
+    }
+}
+
+void EditPagesCommand::execute()
+{
+    if (!m_change.has_value()) {
+        applyEdit();
+        m_change = Document::changeBetween(m_before, m_after);
+    }
+
+    // Something else got to the document first: the edit is done again on what's there now
+    if (!m_document.applyPageSequenceChange(*m_change)) {
+        m_before = m_document.pageSequence();
+        applyEdit();
+        m_document.setPageSequence(m_after);
+    }
+
+    m_change.reset();
+    m_edit = nullptr;
+    m_state = State::Executed;
+}
+
+void EditPagesCommand::applyEdit()
+{
+    m_after = m_before;
+    m_edit(m_after);
+
+    // The chunks the edit replaced, plus the pages only the command keeps alive.
+    // Chunks shared with the document, or with the neighbouring commands, are not counted.
+    // A node for every page of the document, gone with the edit: they're
+    // taken from one arena, sized for all of them, and freed together
+    std::pmr::monotonic_buffer_resource arena{(m_after.size() + 1) * 4 * sizeof(void*)};
+    std::pmr::unordered_set<const Page*> keptPages{&arena};
+    keptPages.reserve(m_after.size());
+    for (const PageSequence::Record& record : m_after)
+        keptPages.insert(record.page.get());
+
+    m_sizeInBytes = m_before.sizeInBytesNotSharedWith(m_after);
+    for (const PageSequence::Record& record : m_before)
+        if (keptPages.count(record.page.get()) == 0)
+            m_sizeInBytes += record.page->sizeInBytes();
+}
+
+void EditPagesCommand::undo()
+{
+    apply(m_after, m_before);
+    m_state = State::Undone;
+}
+
+void EditPagesCommand::redo()
+{
+    apply(m_before, m_after);
+    m_state = State::Executed;
+}
+
+void EditPagesCommand::apply(const PageSequence& from, const PageSequence& to)
+{
+    if (!m_change.has_value() || !m_change->from.isSameVersionAs(from) || !m_document.applyPageSequenceChange(*m_change))
+        m_document.setPageSequence(to);
+
+    m_change.reset();
+}
+
+CommandGroup::CommandGroup(Document& document,
+                           std::vector<std::shared_ptr<Command>> commands)
+    : m_document{document}
+    , m_commands{std::move(commands)}
+{
+}
+
+void CommandGroup::undo()
+{
+    m_document.holdNotifications();
+
+    for (auto it = m_commands.rbegin(); it != m_commands.rend(); ++it)
+        (*it)->undo();
+
+    m_document.releaseNotifications();
+}
+
+void CommandGroup::redo()
+{
+    m_document.holdNotifications();
+
+    for (const auto& command : m_commands)
+        command->redo();
+
+    m_document.releaseNotifications();
+}
+
+std::size_t CommandGroup::sizeInBytes() const
+{
+    std::size_t size = 0;
+
+    for (const auto& command : m_commands)
+        size += command->sizeInBytes();
+
+    return size;
 }
 
 } // namespace Slicer
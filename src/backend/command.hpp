@@ -18,6 +18,8 @@
 #define COMMAND_HPP
 
 #include "document.hpp"
+#include <functional>
+#include <optional>
 
 namespace Slicer {
 
@@ -35,6 +37,21 @@ public:
     virtual void execute() = 0;
     virtual void undo() = 0;
     virtual void redo() = 0;
+
+    // Takes in the command executed right after this one, so that both are
+    // undone and redone as one. Returns false, changing nothing, if it can't.
+    virtual bool mergeWith(const Command&) { return false; }
+
+    // Memory held for undoing or redoing, such as the pages that were removed
+    virtual std::size_t sizeInBytes() const { return 0; }
+
+    // Some commands can work out what they do next, be it execute(), undo()
+    // or redo(), from a snapshot of the pages rather than the document.
+    // prepare() may then run on any thread while nothing edits the document,
+    // and the next of those only applies what it found, as a single change.
+    // Left unprepared, they work it out themselves.
+    virtual bool isPreparable() const { return false; }
+    virtual void prepare() {}
 };
 
 class RemovePageCommand : public Command {
@@ -45,6 +62,7 @@ public:
     void execute() override;
     void undo() override;
     void redo() override;
+    std::size_t sizeInBytes() const override;
 
 private:
     Document& m_document;
@@ -60,6 +78,7 @@ public:
     void execute() override;
     void undo() override;
     void redo() override;
+    std::size_t sizeInBytes() const override;
 
 private:
     Document& m_document;
@@ -76,6 +95,7 @@ public:
     void execute() override;
     void undo() override;
     void redo() override;
+    std::size_t sizeInBytes() const override;
 
 private:
     Document& m_document;
@@ -83,34 +103,37 @@ private:
     const unsigned int m_first, m_last;
 };
 
-class RotatePagesRightCommand : public Command {
+// Consecutive rotations of the same pages merge into one, with the net turn
+class RotatePagesCommand : public Command {
 public:
-    RotatePagesRightCommand(Document& document,
-                            const std::vector<unsigned int>& pageNumbers);
+    RotatePagesCommand(Document& document,
+                       const std::vector<unsigned int>& pageNumbers,
+                       int quarterTurns);
 
     void execute() override;
     void undo() override;
     void redo() override;
+    bool mergeWith(const Command& next) override;
 
 private:
     Document& m_document;
     const std::vector<unsigned int> m_pageNumbers;
+    int m_quarterTurns;
+};
+
+class RotatePagesRightCommand : public RotatePagesCommand {
+public:
+    RotatePagesRightCommand(Document& document,
+                            const std::vector<unsigned int>& pageNumbers);
 };
 
-class RotatePagesLeftCommand : public Command {
+class RotatePagesLeftCommand : public RotatePagesCommand {
 public:
     RotatePagesLeftCommand(Document& document,
                            const std::vector<unsigned int>& pageNumbers);
-
-    void execute() override;
-    void undo() override;
-    void redo() override;
-
-private:
-    Document& m_document;
-    const std::vector<unsigned int> m_pageNumbers;
 };
 
+// A move of the page that was just moved merges with the previous move
 class MovePageCommand : public Command {
 public:
     MovePageCommand(Document& document,
@@ -120,13 +143,15 @@ public:
     void execute() override;
     void undo() override;
     void redo() override;
+    bool mergeWith(const Command& next) override;
 
 private:
     Document& m_document;
     const unsigned int m_indexToMove;
-    const unsigned int m_indexDestination;
+    unsigned int m_indexDestination;
 };
 
+// Same as MovePageCommand, for the range that was just moved
 class MovePageRangeCommand : public Command {
 public:
     MovePageRangeCommand(Document& document,
@@ -137,12 +162,30 @@ public:
     void execute() override;
     void undo() override;
     void redo() override;
+    bool mergeWith(const Command& next) override;
 
 private:
     Document& m_document;
     const unsigned int m_indexFirst;
     const unsigned int m_indexLast;
-    const unsigned int m_indexDestination;
+    unsigned int m_indexDestination;
+};
+
+// For pages that aren't next to each other: they end up together, in order, starting at destination
+class MovePagesCommand : public Command {
+public:
+    MovePagesCommand(Document& document,
+                     const std::vector<unsigned int>& indexes,
+                     unsigned int destination);
+
+    void execute() override;
+    void undo() override;
+    void redo() override;
+
+private:
+    Document& m_document;
+    const std::vector<unsigned int> m_indexes;
+    const unsigned int m_destination;
 };
 
 class AddFilesCommand : public Command {
@@ -154,6 +197,7 @@ public:
     void execute() override;
     void undo() override;
     void redo() override;
+    std::size_t sizeInBytes() const override;
 
 protected:
     const std::vector<Glib::RefPtr<Gio::File>> m_files;
@@ -165,6 +209,61 @@ private:
     std::vector<Glib::RefPtr<Page>> m_addedPages;
 };
 
+// Any number of removals, rotations and moves, applied to a PageSequence
+// and then to the document in one go. Undo and redo swap whole sequences.
+// The snapshot the edit applies to is taken on construction, so all of it
+// can be prepared away from the main thread.
+class EditPagesCommand : public Command {
+public:
+    EditPagesCommand(Document& document,
+                     std::function<void(PageSequence&)> edit);
+
+    void execute() override;
+    void undo() override;
+    void redo() override;
+    std::size_t sizeInBytes() const override { return m_sizeInBytes; }
+    bool isPreparable() const override { return true; }
+    void prepare() override;
+
+private:
+    enum class State {
+        New,
+        Executed,
+        Undone
+    };
+
+    Document& m_document;
+    std::function<void(PageSequence&)> m_edit;
+    PageSequence m_before;
+    PageSequence m_after;
+    std::size_t m_sizeInBytes = 0;
+    State m_state = State::New;
+    // From prepare(), for whatever comes next
+    std::optional<Document::PageSequenceChange> m_change;
+
+    void applyEdit();
+    // Falls back to setting the whole sequence if the document moved on since the change was prepared
+    void apply(const PageSequence& from, const PageSequence& to);
+};
+
+// Commands that already ran together, as one step of the history.
+// Undo and redo hold the document's notifications, so the views follow
+// the whole group at once instead of every command in it.
+class CommandGroup : public Command {
+public:
+    CommandGroup(Document& document,
+                 std::vector<std::shared_ptr<Command>> commands);
+
+    void execute() override {}
+    void undo() override;
+    void redo() override;
+    std::size_t sizeInBytes() const override;
+
+private:
+    Document& m_document;
+    const std::vector<std::shared_ptr<Command>> m_commands;
+};
+
 } // namespace Slicer
 
 #endif // COMMAND_HPP
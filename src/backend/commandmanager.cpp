@@ -15,50 +15,180 @@
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "commandmanager.hpp"
+#include <algorithm>
+#include <stdexcept>
 
 namespace Slicer {
 
 bool CommandManager::canUndo() const
 {
-    return !m_undoStack.empty();
+    return !isInTransaction() && !m_undoStack.empty();
 }
 
 bool CommandManager::canRedo() const
 {
-    return !m_redoStack.empty();
+    return !isInTransaction() && !m_redoStack.empty();
+}
+
+std::shared_ptr<Command> CommandManager::commandToUndo() const
+{
+    return canUndo() ? m_undoStack.back() : nullptr;
+}
+
+std::shared_ptr<Command> CommandManager::commandToRedo() const
+{
+    return canRedo() ? m_redoStack.back() : nullptr;
 }
 
 void CommandManager::execute(const std::shared_ptr<Command>& command)
 {
+    if (isInTransaction()) {
+        command->execute();
+
+        if (m_transactionCommands.empty() || !m_transactionCommands.back()->mergeWith(*command))
+            m_transactionCommands.push_back(command);
+
+        return;
+    }
+
     m_redoStack = CommandStack{};
     command->execute();
-    m_undoStack.push(command);
+
+    // Holding the arrow key to move pages, or rotating the same pages
+    // again and again, leaves a single command to undo
+    if (m_undoStack.empty() || !m_undoStack.back()->mergeWith(*command))
+        m_undoStack.push_back(command);
+
+    trimHistory();
 
     commandExecuted.emit();
 }
 
 void CommandManager::undo()
 {
-    m_undoStack.top()->undo();
-    m_redoStack.push(m_undoStack.top());
-    m_undoStack.pop();
+    m_undoStack.back()->undo();
+    m_redoStack.push_back(m_undoStack.back());
+    m_undoStack.pop_back();
+    updateMemoryCharge();
 
     commandExecuted.emit();
 }
 
 void CommandManager::redo()
 {
-    m_redoStack.top()->redo();
-    m_undoStack.push(m_redoStack.top());
-    m_redoStack.pop();
+    m_redoStack.back()->redo();
+    m_undoStack.push_back(m_redoStack.back());
+    m_redoStack.pop_back();
+    updateMemoryCharge();
 
     commandExecuted.emit();
 }
 
+void CommandManager::beginTransaction(Document& document)
+{
+    if (isInTransaction())
+        throw std::logic_error("A transaction is already in progress");
+
+    m_transactionDocument = &document;
+    m_transactionDocument->holdNotifications();
+}
+
+void CommandManager::commitTransaction()
+{
+    if (!isInTransaction())
+        throw std::logic_error("There is no transaction to commit");
+
+    Document& document = *m_transactionDocument;
+    std::vector<std::shared_ptr<Command>> commands = std::move(m_transactionCommands);
+    m_transactionDocument = nullptr;
+    m_transactionCommands = {};
+
+    document.releaseNotifications();
+
+    if (commands.empty())
+        return;
+
+    m_redoStack = CommandStack{};
+    if (commands.size() == 1)
+        m_undoStack.push_back(commands.front());
+    else
+        m_undoStack.push_back(std::make_shared<CommandGroup>(document, std::move(commands)));
+
+    trimHistory();
+
+    commandExecuted.emit();
+}
+
+void CommandManager::rollbackTransaction()
+{
+    if (!isInTransaction())
+        throw std::logic_error("There is no transaction to roll back");
+
+    for (auto it = m_transactionCommands.rbegin(); it != m_transactionCommands.rend(); ++it)
+        (*it)->undo();
+
+    Document& document = *m_transactionDocument;
+    m_transactionDocument = nullptr;
+    m_transactionCommands = {};
+
+    document.releaseNotifications();
+}
+
+bool CommandManager::isInTransaction() const
+{
+    return m_transactionDocument != nullptr;
+}
+
+void CommandManager::setHistoryLimits(std::size_t maxCommands, std::size_t maxSizeInBytes)
+{
+    m_maxCommands = std::max<std::size_t>(maxCommands, 1);
+    m_maxSizeInBytes = maxSizeInBytes;
+
+    trimHistory();
+}
+
+std::size_t CommandManager::historySizeInBytes() const
+{
+    // Commands change what they hold as they are undone and redone,
+    // so this is added up every time rather than kept as a running total
+    std::size_t size = 0;
+
+    for (const auto& command : m_undoStack)
+        size += command->sizeInBytes();
+
+    for (const auto& command : m_redoStack)
+        size += command->sizeInBytes();
+
+    return size;
+}
+
+void CommandManager::trimHistory()
+{
+    while (m_undoStack.size() > m_maxCommands)
+        m_undoStack.pop_front();
+
+    // Added up once, after any merge into the top command, rather than
+    // for every command dropped. Dropping the oldest command releases
+    // whatever pages it was holding.
+    std::size_t size = historySizeInBytes();
+    while (m_undoStack.size() > 1 && size > m_maxSizeInBytes) {
+        size -= m_undoStack.front()->sizeInBytes();
+        m_undoStack.pop_front();
+    }
+
+    m_memoryCharge.set(size);
+}
+
+void CommandManager::updateMemoryCharge()
+{
+    m_memoryCharge.set(historySizeInBytes());
+}
+
 void CommandManager::reset()
 {
     m_undoStack = {};
     m_redoStack = {};
+    updateMemoryCharge();
 
     commandExecuted.emit();
 }
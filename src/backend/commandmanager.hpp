@@ -18,7 +18,8 @@
 #define COMMANDMANAGER_HPP
 
 #include "command.hpp"
-#include <stack>
+#include "metrics.hpp"
+#include <deque>
 
 namespace Slicer {
 
@@ -31,16 +32,46 @@ public:
     void redo();
     void reset();
 
+    // Everything executed until the commit is a single step of the history,
+    // and the document tells its views about all of it at once on commit.
+    // Rolling back undoes whatever ran since the transaction began.
+    void beginTransaction(Document& document);
+    void commitTransaction();
+    void rollbackTransaction();
+    bool isInTransaction() const;
+
+    // Neither while in a transaction
     bool canUndo() const;
     bool canRedo() const;
+    // What undo() and redo() would go through, to be prepared beforehand
+    std::shared_ptr<Command> commandToUndo() const;
+    std::shared_ptr<Command> commandToRedo() const;
+
+    // The oldest commands are forgotten once either limit is exceeded,
+    // but the last command executed can always be undone
+    void setHistoryLimits(std::size_t maxCommands, std::size_t maxSizeInBytes);
+    std::size_t historySizeInBytes() const;
+
+    static constexpr std::size_t defaultMaxCommands = 200;
+    static constexpr std::size_t defaultMaxSizeInBytes = 64 * 1024 * 1024;
 
     sigc::signal<void> commandExecuted;
 
 private:
-    using CommandStack = std::stack<std::shared_ptr<Command>>;
+    // The top of the stack is at the back
+    using CommandStack = std::deque<std::shared_ptr<Command>>;
 
     CommandStack m_undoStack;
     CommandStack m_redoStack;
+    std::size_t m_maxCommands = defaultMaxCommands;
+    std::size_t m_maxSizeInBytes = defaultMaxSizeInBytes;
+    Metrics::MemoryCharge m_memoryCharge{Metrics::Memory::UndoHistory};
+    // The document of the transaction, while in one
+    Document* m_transactionDocument = nullptr;
+    std::vector<std::shared_ptr<Command>> m_transactionCommands;
+
+    void trimHistory();
+    void updateMemoryCharge();
 };
 }
 #endif // COMMANDMANAGER_HPP
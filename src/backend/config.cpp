@@ -16,9 +16,10 @@
 
 #include "config.hpp"
 #include <glibmm/i18n.h>
-#include <giomm/file.h>
 #include <glibmm/miscutils.h>
-#include <gtkmm/main.h>
+#include <glib/gstdio.h>
+#include <cerrno>
+#include <cstring>
 #include <iostream>
 
 namespace Slicer::config {
@@ -49,23 +50,20 @@ std::string getTempDirPath()
                                 APPLICATION_ID);
 }
 
-void createSlicerDirsIfNotExistent()
+std::string getCacheDirPath()
 {
-    try {
-        Gtk::Main::init_gtkmm_internals();
-
-        auto settingsDirectory = Gio::File::create_for_path(getConfigDirPath());
-        auto tempDirectory = Gio::File::create_for_path(getTempDirPath());
-
-        if (!settingsDirectory->query_exists())
-            settingsDirectory->make_directory_with_parents();
+    return Glib::build_filename(Glib::get_user_cache_dir(),
+                                APPLICATION_ID);
+}
 
-        if (!tempDirectory->query_exists())
-            tempDirectory->make_directory_with_parents();
-    }
-    catch (const Glib::Error& e) {
-        std::cerr << "Couldn't create config dir or temp dir with error: " << '\n'
-                  << e.what() << std::endl;
+void createSlicerDirsIfNotExistent()
+{
+    // Plain GLib, without gtkmm set up, so that it can run on any thread
+    for (const std::string& path : {getConfigDirPath(), getTempDirPath(), getCacheDirPath()}) {
+        if (g_mkdir_with_parents(path.c_str(), 0700) != 0) {
+            std::cerr << "Couldn't create config, temp or cache dir with error: " << '\n'
+                      << std::strerror(errno) << std::endl;
+        }
     }
 }
 
@@ -0,0 +1,267 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "cpuresources.hpp"
+#ifdef __linux__
+#include <dirent.h>
+#include <sched.h>
+#endif
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <sstream>
+#include <thread>
+
+namespace Slicer::CpuResources {
+
+namespace {
+#ifdef __linux__
+    std::string readFile(const std::string& path)
+    {
+        std::ifstream file{path};
+
+        return {std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+    }
+
+    std::vector<int> affinityCores()
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) != 0)
+            return {};
+
+        std::vector<int> cores;
+        for (int core = 0; core < CPU_SETSIZE; ++core)
+            if (CPU_ISSET(core, &set))
+                cores.push_back(core);
+
+        return cores;
+    }
+
+    // From the directory of the cgroup up to where the hierarchy is mounted.
+    // In a container, the path is often one of the host, which isn't there:
+    // the container's own cgroup is then the one at the mount point.
+    template<typename Function>
+    void forEachCgroupDirectory(const std::string& mountPoint, std::string path, Function&& function)
+    {
+        while (true) {
+            function(mountPoint + path);
+
+            if (path.empty() || path == "/")
+                return;
+
+            path.erase(path.rfind('/'));
+        }
+    }
+
+    std::optional<double> cgroupCores()
+    {
+        std::optional<double> fewest;
+        auto consider = [&fewest](std::optional<double> cores) {
+            if (cores.has_value() && (!fewest.has_value() || *cores < *fewest))
+                fewest = cores;
+        };
+
+        // Lines like "0::/a/b" for cgroup v2, or "4:cpu,cpuacct:/a/b" for v1
+        std::istringstream cgroups{readFile("/proc/self/cgroup")};
+
+        for (std::string line; std::getline(cgroups, line);) {
+            const auto first = line.find(':');
+            const auto second = first == std::string::npos ? std::string::npos : line.find(':', first + 1);
+            if (second == std::string::npos)
+                continue;
+
+            const std::string controllers = "," + line.substr(first + 1, second - first - 1) + ",";
+            const std::string path = line.substr(second + 1);
+
+            if (controllers == ",,") {
+                forEachCgroupDirectory("/sys/fs/cgroup", path, [&consider](const std::string& directory) {
+                    consider(coresOfCpuMax(readFile(directory + "/cpu.max")));
+                });
+            }
+            else if (controllers.find(",cpu,") != std::string::npos) {
+                for (const char* mountPoint : {"/sys/fs/cgroup/cpu", "/sys/fs/cgroup/cpu,cpuacct"}) {
+                    forEachCgroupDirectory(mountPoint, path, [&consider](const std::string& directory) {
+                        std::istringstream quota{readFile(directory + "/cpu.cfs_quota_us")};
+                        std::istringstream period{readFile(directory + "/cpu.cfs_period_us")};
+                        long long quotaMicroseconds = 0;
+                        long long periodMicroseconds = 0;
+
+                        if (quota >> quotaMicroseconds && period >> periodMicroseconds)
+                            consider(coresOfCfsQuota(quotaMicroseconds, periodMicroseconds));
+                    });
+                }
+            }
+        }
+
+        return fewest;
+    }
+
+    std::vector<std::vector<int>> readNodes()
+    {
+        const std::vector<int> allowed = affinityCores();
+        const std::set<int> allowedSet{allowed.begin(), allowed.end()};
+        std::vector<std::vector<int>> nodes;
+
+        if (DIR* directory = opendir("/sys/devices/system/node"); directory != nullptr) {
+            std::vector<int> nodeNumbers;
+
+            while (const dirent* entry = readdir(directory)) {
+                const std::string name = entry->d_name;
+                if (name.size() > 4 && name.compare(0, 4, "node") == 0
+                    && name.find_first_not_of("0123456789", 4) == std::string::npos)
+                    nodeNumbers.push_back(std::stoi(name.substr(4)));
+            }
+
+            closedir(directory);
+            std::sort(nodeNumbers.begin(), nodeNumbers.end());
+
+            for (int node : nodeNumbers) {
+                std::vector<int> cores;
+                for (int core : parseCpuList(readFile("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist")))
+                    if (allowedSet.count(core) != 0)
+                        cores.push_back(core);
+
+                if (!cores.empty())
+                    nodes.push_back(cores);
+            }
+        }
+
+        if (nodes.empty())
+            nodes.push_back(allowed);
+
+        return nodes;
+    }
+#else
+    std::vector<std::vector<int>> readNodes()
+    {
+        return {{}};
+    }
+#endif
+} // namespace
+
+unsigned int availableCores()
+{
+    static const unsigned int cores = []() {
+        // Allowed to return 0 when it can't tell
+        double available = std::max(1U, std::thread::hardware_concurrency());
+
+#ifdef __linux__
+        if (const std::vector<int> allowed = affinityCores(); !allowed.empty())
+            available = std::min(available, static_cast<double>(allowed.size()));
+
+        if (const std::optional<double> quota = cgroupCores(); quota.has_value())
+            available = std::min(available, std::ceil(*quota));
+#endif
+
+        return std::max(1U, static_cast<unsigned int>(available));
+    }();
+
+    return cores;
+}
+
+const std::vector<std::vector<int>>& nodes()
+{
+    static const std::vector<std::vector<int>> cached = readNodes();
+
+    return cached;
+}
+
+std::size_t currentNode()
+{
+#ifdef __linux__
+    if (nodes().size() > 1) {
+        const int core = sched_getcpu();
+
+        for (std::size_t node = 0; node < nodes().size(); ++node)
+            if (std::find(nodes().at(node).begin(), nodes().at(node).end(), core) != nodes().at(node).end())
+                return node;
+    }
+#endif
+
+    return 0;
+}
+
+void pinCurrentThreadToNode(std::size_t node)
+{
+#ifdef __linux__
+    if (nodes().size() <= 1)
+        return;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int core : nodes().at(node % nodes().size()))
+        CPU_SET(core, &set);
+
+    // Left where it was when it fails: pinning only helps, it's never needed
+    sched_setaffinity(0, sizeof(set), &set);
+#else
+    static_cast<void>(node);
+#endif
+}
+
+std::optional<double> coresOfCpuMax(const std::string& contents)
+{
+    std::istringstream fields{contents};
+    std::string quota;
+    long long period = 100000;
+
+    if (!(fields >> quota) || quota == "max")
+        return std::nullopt;
+
+    fields >> period;
+
+    try {
+        return coresOfCfsQuota(std::stoll(quota), period);
+    }
+    catch (const std::exception&) {
+        return std::nullopt;
+    }
+}
+
+std::optional<double> coresOfCfsQuota(long long quota, long long period)
+{
+    if (quota <= 0 || period <= 0)
+        return std::nullopt;
+
+    return static_cast<double>(quota) / static_cast<double>(period);
+}
+
+std::vector<int> parseCpuList(const std::string& list)
+{
+    std::vector<int> cores;
+    std::istringstream ranges{list};
+
+    for (std::string range; std::getline(ranges, range, ',');) {
+        try {
+            const auto dash = range.find('-');
+            const int first = std::stoi(range.substr(0, dash));
+            const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+
+            for (int core = first; core <= last; ++core)
+                cores.push_back(core);
+        }
+        catch (const std::exception&) {
+            // An empty list, or a trailing line break
+        }
+    }
+
+    return cores;
+}
+
+} // namespace Slicer::CpuResources
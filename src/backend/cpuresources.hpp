@@ -0,0 +1,63 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef CPURESOURCES_HPP
+#define CPURESOURCES_HPP
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace Slicer::CpuResources {
+
+// What the process can actually run on, for sizing thread pools. In a
+// container, std::thread::hardware_concurrency() reports every core of
+// the host, while the CPU quota of the cgroup, or the affinity mask the
+// process was started with, may allow a few of them.
+
+// The fewest of: the cores in the affinity mask, and the CPU quota of
+// the cgroup of the process and of its parents, rounded up. At least 1.
+// Read once, on the first call.
+unsigned int availableCores();
+
+// The cores of the affinity mask, grouped by the NUMA node they belong to,
+// leaving out nodes without any. A single group on machines with one
+// node, or where it can't be told.
+const std::vector<std::vector<int>>& nodes();
+
+// The index in nodes() of the node the calling thread runs on right now
+std::size_t currentNode();
+
+// Keeps the calling thread on the cores of nodes().at(node), so that the
+// memory it touches first is allocated on that node. Does nothing with a
+// single node.
+void pinCurrentThreadToNode(std::size_t node);
+
+// Cores allowed by the contents of a cgroup v2 cpu.max file, like
+// "400000 100000". Nothing for "max", without a limit.
+std::optional<double> coresOfCpuMax(const std::string& contents);
+
+// Cores allowed by the cpu.cfs_quota_us and cpu.cfs_period_us of cgroup v1.
+// Nothing for a quota of -1, without a limit.
+std::optional<double> coresOfCfsQuota(long long quota, long long period);
+
+// The cores of a list as Linux writes them, like "0-3,8,10-11"
+std::vector<int> parseCpuList(const std::string& list);
+
+} // namespace Slicer::CpuResources
+
+#endif // CPURESOURCES_HPP
@@ -0,0 +1,96 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "decryption.hpp"
+#include "trace.hpp"
+#include <qpdf/QPDF.hh>
+#include <qpdf/QPDFWriter.hh>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <vector>
+
+namespace Slicer::Decryption {
+
+// Enough for the trailer, or the dictionary of an xref stream, and startxref
+static const std::streamoff sampleSize = 4096;
+
+static std::string readAt(std::ifstream& file, std::streamoff offset)
+{
+    std::vector<char> buffer(static_cast<std::size_t>(sampleSize));
+
+    file.clear();
+    file.seekg(offset);
+    file.read(buffer.data(), sampleSize);
+
+    return {buffer.data(), static_cast<std::size_t>(file.gcount())};
+}
+
+bool mayBeEncrypted(const std::string& filePath)
+{
+    std::ifstream file{filePath, std::ios::binary | std::ios::ate};
+    const std::streamoff fileSize = file.tellg();
+
+    if (!file || fileSize <= 0)
+        return false;
+
+    const std::string end = readAt(file, std::max(std::streamoff{0}, fileSize - sampleSize));
+    if (end.find("/Encrypt") != std::string::npos)
+        return true;
+
+    // With an xref stream, its dictionary is the trailer, right before its data
+    const std::size_t startxref = end.rfind("startxref");
+    if (startxref == std::string::npos)
+        return false;
+
+    const std::streamoff xrefOffset = std::strtoll(end.c_str() + startxref + 9, nullptr, 10);
+    if (xrefOffset <= 0 || xrefOffset >= fileSize)
+        return false;
+
+    return readAt(file, xrefOffset).find("/Encrypt") != std::string::npos;
+}
+
+bool decryptTo(const std::string& filePath, const std::string& destinationPath)
+{
+    const Trace::Span span{"Decryption::decryptTo"};
+
+    try {
+        QPDF qpdf;
+        qpdf.setSuppressWarnings(true);
+        // Files that need a user password throw here
+        qpdf.processFile(filePath.c_str());
+
+        if (!qpdf.isEncrypted())
+            return false;
+
+        QPDFWriter writer{qpdf, destinationPath.c_str()};
+        writer.setPreserveEncryption(false);
+        writer.setObjectStreamMode(qpdf_o_preserve);
+        writer.setDecodeLevel(qpdf_dl_none);
+        writer.setDeterministicID(true);
+        writer.write();
+
+        return true;
+    }
+    catch (const std::exception&) {
+        std::remove(destinationPath.c_str());
+
+        return false;
+    }
+}
+}
@@ -0,0 +1,43 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef DECRYPTION_HPP
+#define DECRYPTION_HPP
+
+#include <string>
+
+namespace Slicer::Decryption {
+
+// Poppler decrypts the streams of an encrypted file every time it renders a
+// page, and qpdf again on every save. Opened files that only need the empty
+// user password, the ones that merely restrict printing or copying, are
+// decrypted once into a working copy instead, which everything reads from.
+
+// Whether the trailer of the file, at its end or where its last startxref
+// points, names an /Encrypt dictionary. Reads a few kilobytes of the file,
+// so it's cheap enough for every file opened; a file that says yes is then
+// parsed by decryptTo() to be sure.
+bool mayBeEncrypted(const std::string& filePath);
+
+// Writes the file to destinationPath, which mustn't exist, without its
+// encryption. Streams stay as compressed as they were, and the result
+// is the same every time, so its content hash is too.
+// Returns false, without writing anything, when the file isn't encrypted,
+// needs a password or can't be read.
+bool decryptTo(const std::string& filePath, const std::string& destinationPath);
+}
+
+#endif // DECRYPTION_HPP
@@ -0,0 +1,223 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "diskthumbnailcache.hpp"
+#include "sourcefile.hpp"
+#include <giomm/file.h>
+#include <glibmm/fileutils.h>
+#include <glibmm/miscutils.h>
+#include <glibmm/stringutils.h>
+#include <algorithm>
+#include <cstdio>
+
+namespace Slicer {
+
+static const std::string thumbnailExtension = ".png";
+
+DiskThumbnailCache::DiskThumbnailCache(const std::string& directoryPath, std::size_t capacityInBytes)
+    : m_directoryPath{directoryPath}
+    , m_capacity{capacityInBytes}
+{
+    try {
+        auto directory = Gio::File::create_for_path(m_directoryPath);
+
+        if (!directory->query_exists())
+            directory->make_directory_with_parents();
+    }
+    catch (const Glib::Error&) {
+        // Every store will fail, and every load will miss
+    }
+}
+
+DiskThumbnailCache::Key DiskThumbnailCache::keyFor(const Page& page, int targetSize)
+{
+    const SourceFile::Origin& origin = page.sourceFile().origin();
+
+    return {page.fileHash(), page.indexInFile(), page.currentRotation(), targetSize, origin.size, origin.modificationTime};
+}
+
+Glib::RefPtr<Gdk::Pixbuf> DiskThumbnailCache::load(const Key& key)
+{
+    if (key.fileHash.empty() || m_capacity == 0)
+        return {};
+
+    const std::string path = pathFor(key);
+
+    if (!Glib::file_test(path, Glib::FILE_TEST_IS_REGULAR))
+        return {};
+
+    try {
+        Glib::RefPtr<Gdk::Pixbuf> result = Gdk::Pixbuf::create_from_file(path);
+
+        // Keeps the file from being evicted soon
+        Gio::File::create_for_path(path)->set_attribute_uint64(G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                                                g_get_real_time() / G_USEC_PER_SEC);
+
+        return result;
+    }
+    catch (const Glib::Error&) {
+        return {};
+    }
+}
+
+void DiskThumbnailCache::store(const Key& key, const Glib::RefPtr<Gdk::Pixbuf>& thumbnail)
+{
+    if (key.fileHash.empty() || !thumbnail || m_capacity == 0)
+        return;
+
+    const std::string path = pathFor(key);
+    const std::string partialPath = path + ".part";
+
+    try {
+        // Written aside and then moved, so readers never see half a file
+        thumbnail->save(partialPath, "png");
+
+        auto file = Gio::File::create_for_path(partialPath);
+        const auto size = static_cast<std::size_t>(file->query_info(G_FILE_ATTRIBUTE_STANDARD_SIZE)->get_size());
+        file->move(Gio::File::create_for_path(path), Gio::FILE_COPY_OVERWRITE);
+
+        std::lock_guard<std::mutex> lock{m_mutex};
+
+        if (!m_isSizeKnown)
+            computeSize();
+        else
+            m_sizeInBytes += size;
+
+        evict();
+    }
+    catch (const Glib::Error&) {
+        if (Glib::file_test(partialPath, Glib::FILE_TEST_EXISTS))
+            std::remove(partialPath.c_str());
+    }
+}
+
+void DiskThumbnailCache::forget(const std::string& fileHash, const std::vector<unsigned int>& indexesInFile)
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+
+    for (const CachedFile& file : listFiles()) {
+        const std::string name = Glib::path_get_basename(file.path);
+
+        // Named as pathFor() does: hash, index, rotation, size and origin
+        const bool isForgotten = std::any_of(indexesInFile.begin(), indexesInFile.end(), [&name, &fileHash](unsigned int indexInFile) {
+            return Glib::str_has_prefix(name, fileHash + "-" + std::to_string(indexInFile) + "-");
+        });
+
+        if (isForgotten && std::remove(file.path.c_str()) == 0 && m_isSizeKnown)
+            m_sizeInBytes -= std::min(m_sizeInBytes, file.size);
+    }
+}
+
+void DiskThumbnailCache::setCapacity(std::size_t capacityInBytes)
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+
+    m_capacity = capacityInBytes;
+
+    if (!m_isSizeKnown)
+        computeSize();
+
+    evict();
+}
+
+std::size_t DiskThumbnailCache::sizeInBytes()
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+
+    if (!m_isSizeKnown)
+        computeSize();
+
+    return m_sizeInBytes;
+}
+
+std::string DiskThumbnailCache::pathFor(const Key& key) const
+{
+    const std::string fileName = key.fileHash
+                                 + "-" + std::to_string(key.indexInFile)
+                                 + "-" + std::to_string(key.rotation)
+                                 + "-" + std::to_string(key.targetSize)
+                                 + "-" + std::to_string(key.fileSize)
+                                 + "-" + std::to_string(key.modificationTime)
+                                 + thumbnailExtension;
+
+    return Glib::build_filename(m_directoryPath, fileName);
+}
+
+std::vector<DiskThumbnailCache::CachedFile> DiskThumbnailCache::listFiles() const
+{
+    std::vector<CachedFile> result;
+
+    try {
+        auto directory = Gio::File::create_for_path(m_directoryPath);
+        auto enumerator = directory->enumerate_children(G_FILE_ATTRIBUTE_STANDARD_NAME ","
+                                                        G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+                                                        G_FILE_ATTRIBUTE_TIME_MODIFIED);
+
+        while (Glib::RefPtr<Gio::FileInfo> info = enumerator->next_file()) {
+            const std::string name = info->get_name();
+
+            if (!Glib::str_has_suffix(name, thumbnailExtension))
+                continue;
+
+            result.push_back({Glib::build_filename(m_directoryPath, name),
+                              static_cast<std::size_t>(info->get_size()),
+                              info->get_attribute_uint64(G_FILE_ATTRIBUTE_TIME_MODIFIED)});
+        }
+    }
+    catch (const Glib::Error&) {
+        // Whatever was listed so far is still useful
+    }
+
+    return result;
+}
+
+void DiskThumbnailCache::computeSize()
+{
+    m_sizeInBytes = 0;
+
+    for (const CachedFile& file : listFiles())
+        m_sizeInBytes += file.size;
+
+    m_isSizeKnown = true;
+}
+
+void DiskThumbnailCache::evict()
+{
+    if (m_sizeInBytes <= m_capacity)
+        return;
+
+    std::vector<CachedFile> files = listFiles();
+    std::sort(files.begin(), files.end(), [](const CachedFile& a, const CachedFile& b) {
+        return a.lastUsed < b.lastUsed;
+    });
+
+    // Go a bit below capacity, so that the directory isn't listed on every store
+    const std::size_t target = m_capacity - m_capacity / 10;
+
+    m_sizeInBytes = 0;
+    for (const CachedFile& file : files)
+        m_sizeInBytes += file.size;
+
+    for (const CachedFile& file : files) {
+        if (m_sizeInBytes <= target)
+            break;
+
+        if (std::remove(file.path.c_str()) == 0)
+            m_sizeInBytes -= file.size;
+    }
+}
+
+} // namespace Slicer
@@ -0,0 +1,88 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef DISKTHUMBNAILCACHE_HPP
+#define DISKTHUMBNAILCACHE_HPP
+
+#include "page.hpp"
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Slicer {
+
+// Stores rendered thumbnails as PNG files, so that re-opening a known
+// file doesn't need poppler. Files are named after the content hash, size and
+// modification time of their source, and the least recently used ones are
+// deleted when the directory grows past its capacity.
+// It's a best-effort cache: I/O errors just turn into misses.
+// Safe to use from several threads at once.
+class DiskThumbnailCache {
+public:
+    struct Key {
+        std::string fileHash;
+        unsigned int indexInFile;
+        int rotation;
+        int targetSize;
+        // Of the file the hash was taken of, see SourceFile::Origin: the hash
+        // only samples the file, and a rewrite in place may keep its ends.
+        // Zero when the hash is of the whole file.
+        std::uint64_t fileSize;
+        std::uint64_t modificationTime;
+    };
+
+    DiskThumbnailCache(const std::string& directoryPath, std::size_t capacityInBytes);
+
+    DiskThumbnailCache(const DiskThumbnailCache&) = delete;
+    DiskThumbnailCache& operator=(const DiskThumbnailCache&) = delete;
+    DiskThumbnailCache(DiskThumbnailCache&&) = delete;
+    DiskThumbnailCache& operator=(DiskThumbnailCache&& src) = delete;
+
+    ~DiskThumbnailCache() = default;
+
+    static Key keyFor(const Page& page, int targetSize);
+
+    Glib::RefPtr<Gdk::Pixbuf> load(const Key& key);
+    void store(const Key& key, const Glib::RefPtr<Gdk::Pixbuf>& thumbnail);
+    // Every thumbnail of those pages, at any rotation and size
+    void forget(const std::string& fileHash, const std::vector<unsigned int>& indexesInFile);
+
+    void setCapacity(std::size_t capacityInBytes);
+    std::size_t sizeInBytes();
+
+private:
+    struct CachedFile {
+        std::string path;
+        std::size_t size;
+        guint64 lastUsed;
+    };
+
+    std::mutex m_mutex;
+    const std::string m_directoryPath;
+    std::size_t m_capacity;
+    std::size_t m_sizeInBytes = 0;
+    bool m_isSizeKnown = false;
+
+    std::string pathFor(const Key& key) const;
+    std::vector<CachedFile> listFiles() const;
+    void computeSize();
+    void evict();
+};
+
+} // namespace Slicer
+
+#endif // DISKTHUMBNAILCACHE_HPP
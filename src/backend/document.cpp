@@ -15,36 +15,113 @@
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "document.hpp"
+#include "cpuresources.hpp"
+#include "decryption.hpp"
+#include "metrics.hpp"
+#include "popplerhandles.hpp"
+#include "remotefile.hpp"
+#include "rendercost.hpp"
+#include "snapshotstore.hpp"
 #include "tempfile.hpp"
+#include "trace.hpp"
+#include <glibmm/checksum.h>
 #include <glibmm/convert.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <future>
+#include <iterator>
 #include <numeric>
 #include <range/v3/view/enumerate.hpp>
 
 namespace Slicer {
 
-Document::Document(const Glib::RefPtr<Gio::File>& sourceFile)
-    : m_pages{Gio::ListStore<Page>::create()}
+Document::Document()
+    : m_pages{PageListModel::create()}
 {
-    FileData fileData = loadFile(sourceFile);
-    m_pages->splice(0, 0, loadPages(fileData, 0));
+    // Any other edit makes the cached sequence and table stale
+    m_pages->signal_items_changed().connect([this](guint, guint, guint) {
+        m_pageSequence.reset();
+        m_pageTable.reset();
+    });
+    pagesRotated.connect([this](const std::vector<unsigned int>&) {
+        m_pageSequence.reset();
+        m_pageTable.reset();
+    });
+}
 
-    m_filesData.emplace_back(std::move(fileData));
+Document::Document(const Glib::RefPtr<Gio::File>& sourceFile)
+    : Document()
+{
+    FileLoader loader{sourceFile};
+    const unsigned int fileNumber = addLoadedFile(loader);
+    appendRows(loader.loadRows(0, loader.numberOfPages(), fileNumber));
 }
 
 Document::Document(const std::vector<Glib::RefPtr<Gio::File>>& sourceFiles) : Document(sourceFiles[0])
 {
     std::vector<Glib::RefPtr<Gio::File>> additional_files(sourceFiles.size() - 1);
     std::copy(sourceFiles.begin() + 1, sourceFiles.end(), additional_files.begin());
-    addFiles(additional_files, m_pages->get_n_items());
+    addFiles(additional_files, numberOfPages());
 }
 
-Glib::RefPtr<Page> Document::removePage(unsigned int index)
+Document::Document(const Session::DocumentState& state)
+    : Document()
 {
-    Glib::RefPtr<Page> removedPage = m_pages->get_item(index);
-    m_pages->remove(index);
+    const Trace::Span span{"Document::restore"};
+    // Files only pages in the undo history came from are let go, those pages are gone
+    std::vector<std::shared_ptr<PageListModel::Source>> sources;
+
+    for (const Session::FileState& fileState : state.files) {
+        const Glib::RefPtr<Gio::File> originalFile = Gio::File::create_for_uri(fileState.originalUri);
+        const Glib::RefPtr<Gio::File> snapshot = Gio::File::create_for_path(fileState.snapshotPath);
+        auto sourceFile = std::make_shared<SourceFile>(snapshot);
+        // The original may have changed since; the copy the session keeps hasn't
+        const PageIndex::Key snapshotKey = pageIndexKeyOf(snapshot, fileState.contentHash);
+        sourceFile->setOrigin({snapshotKey.fileSize, snapshotKey.modificationTime});
+
+        registerFile(FileData{originalFile, snapshot, fileState.contentHash, sourceFile});
+        m_lastAddedFile = originalFile;
+
+        sources.push_back(std::make_shared<PageListModel::Source>(
+            PageListModel::Source{Glib::filename_display_name(originalFile->get_basename()),
+                                  std::move(sourceFile),
+                                  fileState.contentHash,
+                                  static_cast<unsigned int>(sources.size()),
+                                  {}}));
+    }
+
+    // Pages of different files come in any order, so each gets its entry first
+    std::vector<unsigned int> entries;
+    entries.reserve(state.pages.size());
+
+    for (const Session::PageState& pageState : state.pages) {
+        std::vector<PageListModel::Source::Entry>& fileEntries = sources.at(pageState.file)->entries;
+
+        entries.push_back(static_cast<unsigned int>(fileEntries.size()));
+        fileEntries.push_back({pageState.indexInFile,
+                               {pageState.width, pageState.height, pageState.sourceRotation, 0}});
+    }
 
-    for (unsigned int i = index; i < numberOfPages(); ++i)
-        m_pages->get_item(i)->setDocumentIndex(i);
+    std::vector<PageListModel::Row> rows;
+    rows.reserve(state.pages.size());
+
+    for (unsigned int i = 0; i < state.pages.size(); ++i) {
+        const Session::PageState& pageState = state.pages.at(i);
+        rows.emplace_back(sources.at(pageState.file), entries.at(i), pageState.rotation);
+    }
+
+    appendRows(std::move(rows));
+}
+
+// Each file is released by its last page, or row, see SourceFile
+Document::~Document() = default;
+
+Glib::RefPtr<Page> Document::removePage(unsigned int index)
+{
+    Glib::RefPtr<Page> removedPage = m_pages->pageAt(index);
+    m_pages->splice(index, 1, {});
+    renumberPagesFrom(index);
 
     return removedPage;
 }
@@ -53,23 +130,38 @@ std::vector<Glib::RefPtr<Page>> Document::removePages(const std::vector<unsigned
 {
     std::vector<Glib::RefPtr<Page>> removedPages;
 
-    for (unsigned int position : indexes) {
-        auto page = m_pages->get_item(position);
-        removedPages.push_back(page);
+    if (indexes.empty())
+        return removedPages;
+
+    std::vector<unsigned int> sortedIndexes = indexes;
+    std::sort(sortedIndexes.begin(), sortedIndexes.end());
+    sortedIndexes.erase(std::unique(sortedIndexes.begin(), sortedIndexes.end()), sortedIndexes.end());
+
+    // Removing the pages one by one shifts the rest of the list, and notifies
+    // the views, once per page. Instead, the pages after the first removed one
+    // are compacted in a single pass and put back with one splice.
+    const unsigned int first = sortedIndexes.front();
+    const unsigned int numberOfPagesBefore = numberOfPages();
+
+    // Only the removed pages are made, to hand them out; the rest move as rows
+    std::vector<PageListModel::Row> keptRows;
+    keptRows.reserve(numberOfPagesBefore - first);
+
+    auto nextRemoved = sortedIndexes.cbegin();
+    for (unsigned int position = first; position < numberOfPagesBefore; ++position) {
+        if (nextRemoved != sortedIndexes.cend() && *nextRemoved == position) {
+            removedPages.push_back(m_pages->pageAt(position));
+            ++nextRemoved;
+        }
+        else {
+            keptRows.push_back(m_pages->rowAt(position));
+        }
     }
 
-    // Removing disjoint pages is complicated.
-    // The list positions are the positions in the list of the pages we
-    // want to remove.
-    // The problem is that, everytime a page is removed, all positions are invalidated.
-    // After each page removal, the remaining positions must be decremented by one.
-    for (unsigned int i = 0; i < indexes.size(); ++i) {
-        const unsigned int actualPosition = indexes.at(i) - i;
-        m_pages->remove(actualPosition);
-    }
+    m_pages->splice(first, numberOfPagesBefore - first, std::move(keptRows));
+    m_pages->renumberFrom(first);
 
-    for (unsigned int i = indexes.front(); i < numberOfPages(); ++i)
-        m_pages->get_item(i)->setDocumentIndex(i);
+    notifyRenumbered(first);
 
     return removedPages;
 }
@@ -77,31 +169,69 @@ std::vector<Glib::RefPtr<Page>> Document::removePages(const std::vector<unsigned
 std::vector<Glib::RefPtr<Page>> Document::removePageRange(unsigned int first, unsigned int last)
 {
     std::vector<Glib::RefPtr<Page>> removedPages;
+    removedPages.reserve(last - first + 1);
 
     for (unsigned int i = first; i <= last; ++i)
-        removedPages.push_back(m_pages->get_item(i));
+        removedPages.push_back(m_pages->pageAt(i));
 
     const unsigned int nElem = last - first + 1;
     m_pages->splice(first, nElem, {});
-
-    for (unsigned int i = first; i < numberOfPages(); ++i)
-        m_pages->get_item(i)->setDocumentIndex(i);
+    renumberPagesFrom(first);
 
     return removedPages;
 }
 
 void Document::insertPage(const Glib::RefPtr<Page>& page)
 {
-    for (unsigned int i = page->getDocumentIndex(); i < numberOfPages(); ++i)
-        m_pages->get_item(i)->setDocumentIndex(i + 1);
+    // Past the end, the page is appended
+    const unsigned int position = std::min(page->getDocumentIndex(), numberOfPages());
 
-    m_pages->insert_sorted(page, pageComparator{});
+    trackPageSize(page->size());
+    m_pages->splice(position, 0, {m_pages->rowOf(page)});
+    m_pages->renumberFrom(position);
+    notifyRenumbered(position);
 }
 
 void Document::insertPages(const std::vector<Glib::RefPtr<Page>>& pages)
 {
-    for (const auto& page : pages)
-        insertPage(page);
+    if (pages.empty())
+        return;
+
+    std::vector<Glib::RefPtr<Page>> insertedPages = pages;
+    std::stable_sort(insertedPages.begin(), insertedPages.end(), [](const auto& a, const auto& b) {
+        return a->getDocumentIndex() < b->getDocumentIndex();
+    });
+
+    // Inserting the pages one by one shifts and renumbers the rest of the
+    // list once per page. Instead, like removePages(), the pages are merged
+    // back with the following ones in a single pass and put back with one splice.
+    const unsigned int numberOfPagesBefore = numberOfPages();
+    const unsigned int first = std::min(insertedPages.front()->getDocumentIndex(), numberOfPagesBefore);
+
+    std::vector<PageListModel::Row> mergedRows;
+    mergedRows.reserve(numberOfPagesBefore - first + insertedPages.size());
+
+    auto nextInserted = insertedPages.cbegin();
+    unsigned int nextKept = first;
+    while (nextKept < numberOfPagesBefore || nextInserted != insertedPages.cend()) {
+        const unsigned int position = first + static_cast<unsigned int>(mergedRows.size());
+
+        // Past the end, the pages are appended
+        if (nextInserted != insertedPages.cend()
+            && ((*nextInserted)->getDocumentIndex() <= position || nextKept == numberOfPagesBefore)) {
+            const Glib::RefPtr<Page>& page = *nextInserted++;
+            trackPageSize(page->size());
+            mergedRows.push_back(m_pages->rowOf(page));
+        }
+        else {
+            mergedRows.push_back(m_pages->rowAt(nextKept++));
+        }
+    }
+
+    m_pages->splice(first, numberOfPagesBefore - first, std::move(mergedRows));
+    m_pages->renumberFrom(first);
+
+    notifyRenumbered(first);
 }
 
 void Document::insertPageRange(const std::vector<Glib::RefPtr<Page>>& pages, unsigned int position)
@@ -109,10 +239,22 @@ void Document::insertPageRange(const std::vector<Glib::RefPtr<Page>>& pages, uns
     if (position > numberOfPages())
         throw std::runtime_error("The insertion position is greater than the number of pages");
 
-    for (unsigned int i = position; i < numberOfPages(); ++i)
-        m_pages->get_item(i)->setDocumentIndex(i + static_cast<unsigned>(pages.size()));
+    std::vector<PageListModel::Row> rows;
+    rows.reserve(pages.size());
+
+    for (const auto& page : pages)
+        rows.push_back(m_pages->rowOf(page));
+
+    insertRows(std::move(rows), position);
+}
+
+void Document::insertRows(std::vector<PageListModel::Row> rows, unsigned int position)
+{
+    for (const PageListModel::Row& row : rows)
+        trackPageSize(row.size());
 
-    m_pages->splice(position, 0, pages);
+    m_pages->splice(position, 0, std::move(rows));
+    renumberPagesFrom(position);
 }
 
 void Document::movePage(unsigned int indexToMove, unsigned int indexDestination)
@@ -121,145 +263,1035 @@ void Document::movePage(unsigned int indexToMove, unsigned int indexDestination)
     pageToMove->setDocumentIndex(indexDestination);
     insertPage(pageToMove);
 
-    pagesReordered.emit({indexDestination});
+    notifyReordered({indexDestination});
 }
 
 void Document::movePageRange(unsigned int indexFirst,
                              unsigned int indexLast,
                              unsigned int indexDestination)
 {
-    auto pagesToMove = removePageRange(indexFirst, indexLast);
+    const unsigned int numberOfPages = indexLast - indexFirst + 1;
 
-    for (unsigned int i = 0; i < pagesToMove.size(); ++i)
-        pagesToMove.at(i)->setDocumentIndex(indexDestination + i);
+    // As rows, so that the pages aren't made just to be moved
+    std::vector<PageListModel::Row> rowsToMove;
+    rowsToMove.reserve(numberOfPages);
+    for (unsigned int i = indexFirst; i <= indexLast; ++i)
+        rowsToMove.push_back(m_pages->rowAt(i));
 
-    insertPageRange(pagesToMove, indexDestination);
+    m_pages->splice(indexFirst, numberOfPages, {});
+    renumberPagesFrom(indexFirst);
+    insertRows(std::move(rowsToMove), indexDestination);
 
-    const unsigned int numberOfPages = indexLast - indexFirst + 1;
     std::vector<unsigned int> reorderedIndexes(numberOfPages);
     std::iota(reorderedIndexes.begin(), reorderedIndexes.end(), indexDestination);
 
-    pagesReordered.emit(reorderedIndexes);
+    notifyReordered(reorderedIndexes);
+}
+
+static std::vector<unsigned int> sortedUnique(std::vector<unsigned int> indexes)
+{
+    std::sort(indexes.begin(), indexes.end());
+    indexes.erase(std::unique(indexes.begin(), indexes.end()), indexes.end());
+
+    return indexes;
+}
+
+void Document::movePages(const std::vector<unsigned int>& indexes, unsigned int destination)
+{
+    const std::vector<unsigned int> sortedIndexes = sortedUnique(indexes);
+    const auto numberOfMovedPages = static_cast<unsigned int>(sortedIndexes.size());
+
+    if (sortedIndexes.empty())
+        return;
+
+    if (sortedIndexes.back() >= numberOfPages() || destination + numberOfMovedPages > numberOfPages())
+        throw std::runtime_error("The pages to move don't fit at the destination");
+
+    // Only the pages between the first one involved and the last one change
+    // places. The moved ones are taken out of that span in a single pass,
+    // like removePages() does, and then put back in one block.
+    const unsigned int first = std::min(sortedIndexes.front(), destination);
+    const unsigned int end = std::max(sortedIndexes.back() + 1, destination + numberOfMovedPages);
+
+    std::vector<PageListModel::Row> movedRows;
+    std::vector<PageListModel::Row> otherRows;
+    movedRows.reserve(numberOfMovedPages);
+    otherRows.reserve(end - first - numberOfMovedPages);
+
+    auto nextMoved = sortedIndexes.cbegin();
+    for (unsigned int position = first; position < end; ++position) {
+        if (nextMoved != sortedIndexes.cend() && *nextMoved == position) {
+            movedRows.push_back(m_pages->rowAt(position));
+            ++nextMoved;
+        }
+        else {
+            otherRows.push_back(m_pages->rowAt(position));
+        }
+    }
+
+    const auto split = otherRows.begin() + (destination - first);
+    std::vector<PageListModel::Row> reorderedRows{otherRows.begin(), split};
+    reorderedRows.reserve(end - first);
+    reorderedRows.insert(reorderedRows.end(), movedRows.begin(), movedRows.end());
+    reorderedRows.insert(reorderedRows.end(), split, otherRows.end());
+
+    replaceRowsFrom(first, std::move(reorderedRows));
+
+    std::vector<unsigned int> reorderedIndexes(numberOfMovedPages);
+    std::iota(reorderedIndexes.begin(), reorderedIndexes.end(), destination);
+
+    notifyReordered(reorderedIndexes);
+}
+
+void Document::returnMovedPages(const std::vector<unsigned int>& indexes, unsigned int destination)
+{
+    const std::vector<unsigned int> sortedIndexes = sortedUnique(indexes);
+    const auto numberOfMovedPages = static_cast<unsigned int>(sortedIndexes.size());
+
+    if (sortedIndexes.empty())
+        return;
+
+    if (sortedIndexes.back() >= numberOfPages() || destination + numberOfMovedPages > numberOfPages())
+        throw std::runtime_error("The moved pages don't fit at their original places");
+
+    const unsigned int first = std::min(sortedIndexes.front(), destination);
+    const unsigned int end = std::max(sortedIndexes.back() + 1, destination + numberOfMovedPages);
+
+    std::vector<PageListModel::Row> reorderedRows;
+    reorderedRows.reserve(end - first);
+
+    // The block at destination is dealt back to the original places, and
+    // every other page of the span fills the gaps, in order
+    unsigned int nextMoved = destination;
+    unsigned int nextOther = first;
+    auto nextIndex = sortedIndexes.cbegin();
+    for (unsigned int position = first; position < end; ++position) {
+        if (nextIndex != sortedIndexes.cend() && *nextIndex == position) {
+            reorderedRows.push_back(m_pages->rowAt(nextMoved++));
+            ++nextIndex;
+            continue;
+        }
+
+        if (nextOther == destination)
+            nextOther += numberOfMovedPages;
+
+        reorderedRows.push_back(m_pages->rowAt(nextOther++));
+    }
+
+    replaceRowsFrom(first, std::move(reorderedRows));
+
+    notifyReordered(sortedIndexes);
+}
+
+void Document::replaceRowsFrom(unsigned int first, std::vector<PageListModel::Row> rows)
+{
+    const auto numberOfRows = static_cast<unsigned int>(rows.size());
+
+    m_pages->splice(first, numberOfRows, std::move(rows));
+    m_pages->renumberFrom(first);
+
+    notifyRenumbered(first);
 }
 
 void Document::rotatePagesRight(const std::vector<unsigned int>& pageNumbers)
 {
     for (unsigned int pageNumber : pageNumbers)
-        m_pages->get_item(pageNumber)->rotateRight();
+        m_pages->rotate(pageNumber, 1);
 
-    pagesRotated.emit(pageNumbers);
+    notifyRotated(pageNumbers);
 }
 
 void Document::rotatePagesLeft(const std::vector<unsigned int>& pageNumbers)
 {
     for (unsigned int pageNumber : pageNumbers)
-        m_pages->get_item(pageNumber)->rotateLeft();
+        m_pages->rotate(pageNumber, -1);
+
+    notifyRotated(pageNumbers);
+}
+
+void Document::rotatePages(const std::vector<unsigned int>& pageNumbers, int quarterTurns)
+{
+    if (quarterTurns % 4 == 0)
+        return;
+
+    for (unsigned int pageNumber : pageNumbers)
+        m_pages->rotate(pageNumber, quarterTurns);
+
+    notifyRotated(pageNumbers);
+}
+
+PageSequence Document::pageSequence() const
+{
+    if (m_pageSequence.has_value())
+        return *m_pageSequence;
+
+    std::vector<PageSequence::Record> records;
+    records.reserve(numberOfPages());
 
-    pagesRotated.emit(pageNumbers);
+    for (unsigned int i = 0; i < numberOfPages(); ++i) {
+        Glib::RefPtr<Page> page = m_pages->pageAt(i);
+        const int rotation = page->currentRotation();
+        records.push_back({std::move(page), rotation});
+    }
+
+    m_pageSequence = PageSequence{records};
+
+    return *m_pageSequence;
+}
+
+const PageTable& Document::pageTable() const
+{
+    if (!m_pageTable.has_value()) {
+        PageTable table;
+        table.reserve(numberOfPages());
+
+        for (unsigned int i = 0; i < numberOfPages(); ++i)
+            table.append(m_pages->rowAt(i));
+
+        m_pageTable = std::move(table);
+    }
+
+    return *m_pageTable;
+}
+
+void Document::setPageSequence(const PageSequence& sequence)
+{
+    applyPageSequenceChange(changeBetween(pageSequence(), sequence));
+}
+
+Document::PageSequenceChange Document::changeBetween(const PageSequence& from, const PageSequence& to)
+{
+    const unsigned int oldSize = from.size();
+    const unsigned int newSize = to.size();
+    PageSequenceChange change{from, to};
+
+    unsigned int prefix = 0;
+    for (auto old = from.begin(), it = to.begin(); prefix < std::min(oldSize, newSize) && old->page == it->page; ++old, ++it)
+        ++prefix;
+
+    unsigned int suffix = 0;
+    while (suffix < std::min(oldSize, newSize) - prefix
+           && from.at(oldSize - suffix - 1).page == to.at(newSize - suffix - 1).page)
+        ++suffix;
+
+    const bool isSpliced = prefix + suffix < std::max(oldSize, newSize);
+    change.first = prefix;
+    change.numberOfReplaced = isSpliced ? oldSize - prefix - suffix : 0;
+    change.numberOfInserted = isSpliced ? newSize - prefix - suffix : 0;
+
+    unsigned int i = 0;
+    for (const PageSequence::Record& record : to) {
+        if (const int quarterTurns = (record.rotation - record.page->currentRotation()) / 90; quarterTurns != 0)
+            change.rotations.emplace_back(i, quarterTurns);
+
+        // Pages after the splice shift when the number of pages changes
+        if (isSpliced && i >= prefix)
+            change.renumberedPages.push_back(record.page);
+
+        ++i;
+    }
+
+    return change;
+}
+
+bool Document::applyPageSequenceChange(const PageSequenceChange& change)
+{
+    // Worked out for another version of the document
+    if (!m_pageSequence.has_value() || !m_pageSequence->isSameVersionAs(change.from))
+        return false;
+
+    const unsigned int spliceEnd = change.first + change.numberOfInserted;
+    // Only pages that stay where they were need a separate notification
+    std::vector<unsigned int> rotatedPages;
+
+    // New pages are rotated before the splice, so that the views pick them up
+    // already rotated. The others are rotated where they end up.
+    for (const auto& [index, quarterTurns] : change.rotations) {
+        if (index < change.first || index >= spliceEnd)
+            rotatedPages.push_back(index);
+        else
+            change.to.at(index).page->rotateBy(quarterTurns);
+    }
+
+    if (!change.renumberedPages.empty()) {
+        std::vector<PageListModel::Row> middle;
+        middle.reserve(change.numberOfInserted);
+
+        for (unsigned int i = 0; i < change.numberOfInserted; ++i) {
+            const Glib::RefPtr<Page>& page = change.renumberedPages.at(i);
+            trackPageSize(page->size());
+            middle.push_back(m_pages->rowOf(page));
+        }
+
+        m_pages->splice(change.first, change.numberOfReplaced, std::move(middle));
+        m_pages->renumberFrom(change.first);
+        notifyRenumbered(change.first);
+    }
+
+    for (const auto& [index, quarterTurns] : change.rotations) {
+        if (index < change.first || index >= spliceEnd)
+            m_pages->rotate(index, quarterTurns);
+    }
+
+    if (!rotatedPages.empty())
+        notifyRotated(rotatedPages);
+
+    // Keeps sharing chunks with the versions held for undo
+    m_pageSequence = change.to;
+
+    return true;
 }
 
 unsigned int Document::addFile(const Glib::RefPtr<Gio::File>& file, unsigned int position)
 {
-    FileData fileData = loadFile(file);
-    std::vector<Glib::RefPtr<Page>> pages = loadPages(fileData, m_filesData.size());
+    FileLoader loader{file};
+    const unsigned int fileNumber = addLoadedFile(loader);
+    std::vector<PageListModel::Row> rows = loader.loadRows(0, loader.numberOfPages(), fileNumber);
+    const auto numberOfAddedPages = static_cast<unsigned int>(rows.size());
+
+    insertRows(std::move(rows), position);
+
+    return numberOfAddedPages;
+}
+
+std::optional<Page::Size> Document::uniformPageSize() const
+{
+    if (!m_hasUniformPageSize)
+        return {};
+
+    return m_firstPageSize;
+}
+
+void Document::trackPageSize(Page::Size size)
+{
+    if (!m_firstPageSize.has_value())
+        m_firstPageSize = size;
+    else if (size.width != m_firstPageSize->width || size.height != m_firstPageSize->height)
+        m_hasUniformPageSize = false;
+}
+
+unsigned int Document::addLoadedFile(FileLoader& loader)
+{
+    m_lastAddedFile = loader.m_fileData.originalFile;
+
+    if (const std::optional<unsigned int> sameFile = findSameFile(loader.m_fileData); sameFile.has_value()) {
+        loader.shareFile(m_filesData.at(sameFile.value()), m_filesData.at(sameFile.value()).sourceFile.lock());
+        return sameFile.value();
+    }
+
+    registerFile(loader.m_fileData);
+
+    return m_filesData.size() - 1;
+}
+
+void Document::registerFile(const FileData& fileData)
+{
+    const std::shared_ptr<SourceFile> sourceFile = fileData.sourceFile.lock();
+
+    if (sourceFile != nullptr)
+        sourceFile->setParsedFileCache(m_parsedFileCache);
+
+    if (m_filesData.empty())
+        m_shellFile = sourceFile;
+
+    m_filesData.push_back(fileData);
+}
+
+static bool haveSameContents(const std::string& firstPath, const std::string& secondPath)
+{
+    std::ifstream first{firstPath, std::ios::binary | std::ios::ate};
+    std::ifstream second{secondPath, std::ios::binary | std::ios::ate};
+
+    if (!first || !second || first.tellg() != second.tellg())
+        return false;
+
+    first.seekg(0);
+    second.seekg(0);
+
+    const std::size_t blockSize = 64 * 1024;
+    std::vector<char> firstBlock(blockSize);
+    std::vector<char> secondBlock(blockSize);
+
+    while (first && second) {
+        first.read(firstBlock.data(), blockSize);
+        second.read(secondBlock.data(), blockSize);
+
+        if (first.gcount() != second.gcount()
+            || !std::equal(firstBlock.begin(), firstBlock.begin() + first.gcount(), secondBlock.begin()))
+            return false;
+    }
+
+    return true;
+}
+
+std::optional<unsigned int> Document::findSameFile(const FileData& fileData) const
+{
+    // The hash only samples the files, so a match is checked byte by byte.
+    // Files that differ almost never get that far.
+    for (unsigned int i = 0; i < m_filesData.size(); ++i) {
+        const FileData& candidate = m_filesData.at(i);
+
+        // The bytes of files still being fetched can't be compared yet
+        if (candidate.contentHash == fileData.contentHash && !candidate.sourceFile.expired()
+            && RemoteFile::isComplete(candidate.tempFile->get_path())
+            && RemoteFile::isComplete(fileData.tempFile->get_path())
+            && haveSameContents(candidate.tempFile->get_path(), fileData.tempFile->get_path()))
+            return i;
+    }
+
+    return {};
+}
+
+unsigned int Document::numberOfLiveFiles() const
+{
+    return static_cast<unsigned>(std::count_if(m_filesData.begin(), m_filesData.end(), [](const FileData& fileData) {
+        return !fileData.sourceFile.expired();
+    }));
+}
+
+std::vector<Document::LiveFile> Document::liveFiles() const
+{
+    std::vector<LiveFile> result;
+
+    for (unsigned int i = 0; i < m_filesData.size(); ++i) {
+        const FileData& fileData = m_filesData.at(i);
+        const std::shared_ptr<SourceFile> sourceFile = fileData.sourceFile.lock();
+        if (sourceFile == nullptr)
+            continue;
+
+        LiveFile file{i, fileData.originalFile, fileData.tempFile->get_path(), fileData.contentHash, sourceFile->origin()};
+
+        // Later file numbers are later versions
+        auto it = std::find_if(result.begin(), result.end(), [&fileData](const LiveFile& other) {
+            return other.originalFile->equal(fileData.originalFile);
+        });
+
+        if (it != result.end())
+            *it = std::move(file);
+        else
+            result.push_back(std::move(file));
+    }
 
-    for (auto [i, page] : ranges::views::enumerate(pages))
+    return result;
+}
+
+Session::DocumentState Document::sessionState() const
+{
+    Session::DocumentState state;
+    std::vector<std::optional<std::uint32_t>> stateFiles(m_filesData.size());
+
+    for (unsigned int i = 0; i < m_filesData.size(); ++i) {
+        const FileData& fileData = m_filesData.at(i);
+        const std::shared_ptr<SourceFile> sourceFile = fileData.sourceFile.lock();
+
+        if (sourceFile == nullptr || (sourceFile->remoteFile() != nullptr && !sourceFile->remoteFile()->isComplete()))
+            continue;
+
+        stateFiles.at(i) = static_cast<std::uint32_t>(state.files.size());
+        state.files.push_back({fileData.originalFile->get_uri(), fileData.contentHash, fileData.tempFile->get_path()});
+    }
+
+    state.pages.reserve(numberOfPages());
+
+    for (unsigned int i = 0; i < numberOfPages(); ++i) {
+        const PageListModel::Row& row = m_pages->rowAt(i);
+        const std::optional<std::uint32_t> file = stateFiles.at(row.fileNumber());
+
+        if (!file.has_value())
+            continue;
+
+        state.pages.push_back({file.value(),
+                               row.indexInFile(),
+                               row.size().width,
+                               row.size().height,
+                               row.sourceRotation(),
+                               row.currentRotation()});
+    }
+
+    return state;
+}
+
+void Document::appendPages(const std::vector<Glib::RefPtr<Page>>& pages)
+{
+    const unsigned int position = numberOfPages();
+    std::vector<PageListModel::Row> rows;
+    rows.reserve(pages.size());
+
+    for (auto [i, page] : ranges::views::enumerate(pages)) {
         page->setDocumentIndex(position + i);
+        rows.push_back(m_pages->rowOf(page));
+    }
+
+    appendRows(std::move(rows));
+}
 
-    insertPageRange(pages, position);
-    m_filesData.emplace_back(std::move(fileData));
+void Document::appendRows(std::vector<PageListModel::Row> rows)
+{
+    for (const PageListModel::Row& row : rows)
+        trackPageSize(row.size());
 
-    return pages.size();
+    // The pages made from new rows already get their index
+    m_pages->splice(numberOfPages(), 0, std::move(rows));
+}
+
+std::vector<Glib::RefPtr<Page>> Document::reloadFile(FileLoader& loader, const PageDigest::Changes& changes)
+{
+    // Pages of any earlier version can be in the document, the unchanged ones kept from each reload
+    const Glib::RefPtr<Gio::File> originalFile = loader.m_fileData.originalFile;
+    std::vector<bool> isVersion(m_filesData.size());
+    for (unsigned int i = 0; i < m_filesData.size(); ++i)
+        isVersion.at(i) = m_filesData.at(i).originalFile->equal(originalFile);
+
+    const unsigned int fileNumber = addLoadedFile(loader);
+    std::vector<Glib::RefPtr<Page>> replacedPages;
+    std::vector<PageListModel::Row> rows;
+    rows.reserve(numberOfPages() + changes.numberOfAddedPages());
+
+    std::optional<unsigned int> firstChange;
+    // Just after the last page of the file, where added pages go
+    std::optional<std::size_t> endOfFile;
+
+    for (unsigned int i = 0; i < numberOfPages(); ++i) {
+        PageListModel::Row row = m_pages->rowAt(i);
+
+        if (row.fileNumber() < isVersion.size() && isVersion.at(row.fileNumber())) {
+            const unsigned int indexInFile = row.indexInFile();
+
+            if (indexInFile >= changes.numberOfPagesAfter) {
+                replacedPages.push_back(m_pages->pageAt(i));
+                firstChange = firstChange.value_or(i);
+                continue;
+            }
+
+            if (std::binary_search(changes.changedPages.begin(), changes.changedPages.end(), indexInFile)) {
+                Glib::RefPtr<Page> newPage = loader.loadPages(indexInFile, 1, fileNumber).at(0);
+                newPage->rotateBy((row.currentRotation() - row.sourceRotation()) / 90);
+
+                replacedPages.push_back(m_pages->pageAt(i));
+                row = m_pages->rowOf(newPage);
+                firstChange = firstChange.value_or(i);
+            }
+
+            endOfFile = rows.size() + 1;
+        }
+
+        rows.push_back(std::move(row));
+    }
+
+    if (changes.numberOfAddedPages() > 0) {
+        const std::size_t position = endOfFile.value_or(rows.size());
+        std::vector<PageListModel::Row> addedRows = loader.loadRows(changes.numberOfPagesBefore,
+                                                                    changes.numberOfAddedPages(),
+                                                                    fileNumber);
+
+        rows.insert(rows.begin() + static_cast<std::ptrdiff_t>(position),
+                    std::make_move_iterator(addedRows.begin()),
+                    std::make_move_iterator(addedRows.end()));
+        firstChange = std::min(firstChange.value_or(numberOfPages()), static_cast<unsigned int>(position));
+    }
+
+    if (!firstChange.has_value())
+        return replacedPages;
+
+    const unsigned int first = firstChange.value();
+    const unsigned int numberOfPagesBefore = numberOfPages();
+    std::vector<PageListModel::Row> changedRows{std::make_move_iterator(rows.begin() + first),
+                                                std::make_move_iterator(rows.end())};
+
+    for (const PageListModel::Row& row : changedRows)
+        trackPageSize(row.size());
+
+    m_pages->splice(first, numberOfPagesBefore - first, std::move(changedRows));
+    m_pages->renumberFrom(first);
+
+    notifyRenumbered(first);
+
+    return replacedPages;
 }
 
 unsigned int Document::addFiles(const std::vector<Glib::RefPtr<Gio::File>>& files,
                                 unsigned int position)
 {
-    unsigned int totalNumberOfInsertedPages = 0;
+    // Snapshotting and parsing are what take time, and each file is independent
+    // of the others, so files are loaded concurrently, a few at a time
+    const std::size_t concurrency = CpuResources::availableCores();
+    std::vector<std::unique_ptr<FileLoader>> loaders;
+
+    for (std::size_t first = 0; first < files.size(); first += concurrency) {
+        std::vector<std::future<std::unique_ptr<FileLoader>>> loads;
+
+        for (std::size_t i = first; i < std::min(first + concurrency, files.size()); ++i)
+            loads.push_back(std::async(std::launch::async, [file = files.at(i)]() {
+                return std::make_unique<FileLoader>(file);
+            }));
+
+        // Rethrows the first failure, before the document is touched
+        for (std::future<std::unique_ptr<FileLoader>>& load : loads)
+            loaders.push_back(load.get());
+    }
 
-    for (const auto& file : files) {
-        unsigned int numberOfInsertedPages = addFile(file, position);
-        position += numberOfInsertedPages;
-        totalNumberOfInsertedPages += numberOfInsertedPages;
+    // Files are registered in order, so that repeated ones, even within
+    // this same call, end up as the first of them
+    std::vector<PageListModel::Row> rows;
+
+    for (std::unique_ptr<FileLoader>& loader : loaders) {
+        const unsigned int fileNumber = addLoadedFile(*loader);
+        std::vector<PageListModel::Row> fileRows = loader->loadRows(0, loader->numberOfPages(), fileNumber);
+        rows.insert(rows.end(), std::make_move_iterator(fileRows.begin()), std::make_move_iterator(fileRows.end()));
     }
 
-    return totalNumberOfInsertedPages;
+    const auto numberOfAddedPages = static_cast<unsigned int>(rows.size());
+    insertRows(std::move(rows), position);
+
+    return numberOfAddedPages;
+}
+
+void Document::holdNotifications()
+{
+    if (m_notificationHolds++ == 0)
+        m_pages->holdNotifications();
+}
+
+void Document::releaseNotifications()
+{
+    if (m_notificationHolds == 0 || --m_notificationHolds > 0)
+        return;
+
+    const PageListModel::HeldChange change = m_pages->releaseNotifications();
+
+    // The views take the pages of the splice as new, turned as they are now
+    if (change.numberOfRemoved > 0 || change.numberOfAdded > 0)
+        pagesRenumbered.emit(change.first);
+
+    if (!change.rotatedRows.empty())
+        pagesRotated.emit(change.rotatedRows);
+}
+
+void Document::notifyRenumbered(unsigned int first)
+{
+    if (m_notificationHolds == 0)
+        pagesRenumbered.emit(first);
+}
+
+void Document::notifyReordered(const std::vector<unsigned int>& positions)
+{
+    if (m_notificationHolds == 0)
+        pagesReordered.emit(positions);
+}
+
+void Document::notifyRotated(const std::vector<unsigned int>& positions)
+{
+    if (m_notificationHolds == 0)
+        pagesRotated.emit(positions);
+}
+
+void Document::renumberPagesFrom(unsigned int first)
+{
+    m_pages->renumberFrom(first);
+
+    notifyRenumbered(first);
 }
 
 Glib::RefPtr<Page> Document::getPage(unsigned int index) const
 {
-    return m_pages->get_item(index);
+    return m_pages->pageAt(index);
 }
 
-const Glib::RefPtr<Gio::ListStore<Page>>& Document::pages() const
+const Glib::RefPtr<PageListModel>& Document::pages() const
 {
     return m_pages;
 }
 
 unsigned int Document::numberOfPages() const
 {
-    return m_pages->get_n_items();
+    return m_pages->size();
 }
 
 std::string Document::lastAddedFileParentPath() const
 {
-    return m_filesData.back().originalFile->get_parent()->get_path();
+    return m_lastAddedFile->get_parent()->get_path();
 }
 
 PdfSaver::SaveData Document::getSaveData() const
 {
     PdfSaver::SaveData result;
+    result.files.reserve(m_filesData.size());
+    result.sourceFiles.reserve(m_filesData.size());
+    result.pages.reserve(numberOfPages());
 
-    for (const FileData& fileData : m_filesData)
+    for (const FileData& fileData : m_filesData) {
         result.files.push_back(fileData.tempFile);
+        result.sourceFiles.push_back(fileData.sourceFile.lock());
+    }
+
+    result.isUnchanged = !m_filesData.empty() && numberOfPages() > 0
+                         && numberOfPages() == m_filesData.front().numberOfPages;
+
+    for (unsigned int i = 0; i < numberOfPages(); ++i) {
+        const PageListModel::Row& row = m_pages->rowAt(i);
+        result.pages.push_back(PdfSaver::PageData{row.fileNumber(),
+                                                  row.indexInFile(),
+                                                  row.currentRotation()});
 
-    for (unsigned int i = 0; i < m_pages->get_n_items(); ++i) {
-        Glib::RefPtr<Page> page = m_pages->get_item(i);
-        result.pages.push_back(PdfSaver::PageData{page->m_fileNumber,
-                                                  page->indexInFile(),
-                                                  page->currentRotation()});
+        if (row.fileNumber() != 0 || row.indexInFile() != i || (row.currentRotation() - row.sourceRotation()) % 360 != 0)
+            result.isUnchanged = false;
     }
 
     return result;
 }
 
-Document::FileData Document::loadFile(const Glib::RefPtr<Gio::File>& sourceFile)
+// Read from both ends of a file by contentHashOf()
+static const std::streamoff contentHashSampleSize = 1024 * 1024;
+
+// Hashing whole files would read every byte of them again, which is what
+// snapshotting avoids. The size plus both ends of the file are enough to tell
+// files apart: incremental updates to a PDF rewrite its trailer at the end.
+std::string Document::contentHashOf(const std::string& filePath)
+{
+    const std::streamoff sampleSize = contentHashSampleSize;
+    Glib::Checksum checksum{Glib::Checksum::CHECKSUM_SHA256};
+    std::ifstream file{filePath, std::ios::binary | std::ios::ate};
+    const std::streamoff fileSize = file.tellg();
+    std::vector<char> buffer(static_cast<std::size_t>(sampleSize));
+
+    const std::string sizeText = std::to_string(fileSize);
+    checksum.update(reinterpret_cast<const guchar*>(sizeText.data()), sizeText.size()); //NOLINT
+
+    for (std::streamoff offset : {std::streamoff{0}, std::max(std::streamoff{0}, fileSize - sampleSize)}) {
+        file.clear();
+        file.seekg(offset);
+        file.read(buffer.data(), sampleSize);
+        checksum.update(reinterpret_cast<const guchar*>(buffer.data()), file.gcount()); //NOLINT
+
+        if (fileSize <= sampleSize)
+            break;
+    }
+
+    return checksum.get_string();
+}
+
+namespace {
+    // contentHashOf() a file, worked out from its bytes as they go by in
+    // order, while a snapshot is copied. Needs the size of the file up front,
+    // to know where its end begins; gives nothing if it ended elsewhere.
+    class StreamedContentHash {
+    public:
+        explicit StreamedContentHash(std::uint64_t size)
+            : m_size{size}
+        {
+        }
+
+        void add(const char* data, std::size_t size)
+        {
+            const auto sampleSize = static_cast<std::uint64_t>(contentHashSampleSize);
+            const std::uint64_t end = m_offset + size;
+
+            if (m_offset < sampleSize)
+                m_head.append(data, static_cast<std::size_t>(std::min(end, sampleSize) - m_offset));
+
+            if (m_size > sampleSize && end > m_size - sampleSize) {
+                const std::uint64_t tailStart = std::max(m_offset, m_size - sampleSize);
+                m_tail.append(data + (tailStart - m_offset), static_cast<std::size_t>(std::min(end, m_size) - tailStart));
+            }
+
+            m_offset = end;
+        }
+
+        std::optional<std::string> finish() const
+        {
+            if (m_offset != m_size)
+                return {};
+
+            Glib::Checksum checksum{Glib::Checksum::CHECKSUM_SHA256};
+            const std::string sizeText = std::to_string(m_size);
+            checksum.update(reinterpret_cast<const guchar*>(sizeText.data()), sizeText.size()); //NOLINT
+            checksum.update(reinterpret_cast<const guchar*>(m_head.data()), m_head.size()); //NOLINT
+
+            if (m_size > static_cast<std::uint64_t>(contentHashSampleSize))
+                checksum.update(reinterpret_cast<const guchar*>(m_tail.data()), m_tail.size()); //NOLINT
+
+            return checksum.get_string();
+        }
+
+    private:
+        const std::uint64_t m_size;
+        std::uint64_t m_offset = 0;
+        std::string m_head;
+        std::string m_tail;
+    };
+}
+
+PageIndex::Key Document::pageIndexKeyOf(const Glib::RefPtr<Gio::File>& sourceFile, const std::string& contentHash)
 {
-    std::unique_ptr<poppler::document> tempDocument{poppler::document::load_from_file(sourceFile->get_path())};
+    try {
+        Glib::RefPtr<Gio::FileInfo> info = sourceFile->query_info(G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+                                                                  G_FILE_ATTRIBUTE_TIME_MODIFIED);
+
+        return {contentHash,
+                static_cast<std::uint64_t>(info->get_size()),
+                info->get_attribute_uint64(G_FILE_ATTRIBUTE_TIME_MODIFIED)};
+    }
+    catch (const Glib::Error&) {
+        // Without a hash the index is neither read nor written
+        return {{}, 0, 0};
+    }
+}
 
-    if (tempDocument == nullptr)
-        throw std::runtime_error("Couldn't load file: " + sourceFile->get_path());
+static void removeQuietly(const Glib::RefPtr<Gio::File>& file)
+{
+    try {
+        file->remove();
+    }
+    catch (const Glib::Error&) {
+        // Never created
+    }
+}
+
+// A snapshot of the file, its content hash worked out while copying it
+// when it's copied, see TempFile::snapshotTo(). Reflinks read nothing.
+static Glib::RefPtr<Gio::File> hashedSnapshot(const Glib::RefPtr<Gio::File>& sourceFile,
+                                              std::optional<std::string>& contentHash)
+{
+    const Glib::RefPtr<Gio::File> snapshot = TempFile::generate();
+    const auto size = static_cast<std::uint64_t>(sourceFile->query_info(G_FILE_ATTRIBUTE_STANDARD_SIZE)->get_size());
+    StreamedContentHash hash{size};
+
+    if (TempFile::snapshotTo(sourceFile, snapshot, [&hash](const char* data, std::size_t dataSize) { hash.add(data, dataSize); }))
+        contentHash = hash.finish();
+
+    return snapshot;
+}
+
+// The snapshot, or a decrypted copy of it in its place, see Decryption.
+// The hash of a replaced snapshot is forgotten.
+static Glib::RefPtr<Gio::File> decryptedSnapshot(const Glib::RefPtr<Gio::File>& snapshot,
+                                                 std::optional<std::string>& contentHash)
+{
+    if (!Decryption::mayBeEncrypted(snapshot->get_path()))
+        return snapshot;
 
-    Glib::RefPtr<Gio::File> tempFile = TempFile::generate();
-    sourceFile->copy(tempFile, Gio::FILE_COPY_OVERWRITE);
+    const Glib::RefPtr<Gio::File> decrypted = TempFile::generate();
+    if (!Decryption::decryptTo(snapshot->get_path(), decrypted->get_path()))
+        return snapshot;
 
-    std::unique_ptr<poppler::document> document{poppler::document::load_from_file(tempFile->get_path())};
+    removeQuietly(snapshot);
+    contentHash.reset();
 
-    return FileData{sourceFile,
-                    tempFile,
-                    std::move(document)};
+    return decrypted;
 }
 
-std::vector<Glib::RefPtr<Page>> Document::loadPages(const Document::FileData& fileData,
-                                                    unsigned int fileNumber)
+// Whether a document opened on part of a linearized file reads as the whole one would
+static bool readsFirstPage(const std::shared_ptr<poppler::document>& document, unsigned int numberOfPages)
 {
-    const Glib::ustring basename = Glib::filename_display_basename(fileData.originalFile->get_path());
+    if (document == nullptr || document->pages() != static_cast<int>(numberOfPages) || numberOfPages == 0)
+        return false;
+
+    const std::unique_ptr<poppler::page> page{document->create_page(0)};
+
+    return page != nullptr;
+}
+
+Document::FileLoader::FileLoader(const Glib::RefPtr<Gio::File>& sourceFile)
+{
+    const Trace::Span span{"Document::FileLoader"};
+
+    // Parse only the snapshot, and keep that same handle. Parsing the source
+    // first just to validate it doubled the open time of big files.
+    Glib::RefPtr<Gio::File> tempFile;
+    std::optional<std::string> snapshotHash;
+    if (RemoteFile::isRemote(sourceFile)) {
+        // Left encrypted when fetched as it's read: decrypting needs all of it
+        tempFile = TempFile::generate();
+
+        try {
+            m_remoteFile = RemoteFile::start(sourceFile, tempFile);
+        }
+        catch (...) {
+            // Copied whole then, as local files are
+            removeQuietly(tempFile);
+            tempFile = decryptedSnapshot(hashedSnapshot(sourceFile, snapshotHash), snapshotHash);
+        }
+    }
+    else {
+        // Decrypted before it's stored, so that it's only ever decrypted once
+        m_sourceFile = SnapshotStore::acquire(sourceFile, [](const Glib::RefPtr<Gio::File>& copy) {
+            std::optional<std::string> unknownHash;
+            return decryptedSnapshot(copy, unknownHash);
+        });
+
+        if (m_sourceFile != nullptr)
+            tempFile = m_sourceFile->snapshot();
+        else
+            tempFile = decryptedSnapshot(hashedSnapshot(sourceFile, snapshotHash), snapshotHash);
+    }
+
+    // Deletes the snapshot, and stops fetching it, if loading fails
+    const bool isOwnSourceFile = m_sourceFile == nullptr;
+    if (isOwnSourceFile)
+        m_sourceFile = std::make_shared<SourceFile>(tempFile, m_remoteFile);
+
+    if (m_remoteFile != nullptr) {
+        const auto sampleSize = static_cast<std::uint64_t>(contentHashSampleSize);
+        m_remoteFile->fetch(0, sampleSize);
+        m_remoteFile->fetch(m_remoteFile->size() - std::min(m_remoteFile->size(), sampleSize), sampleSize);
+    }
+
+    const std::string contentHash = snapshotHash.has_value() ? snapshotHash.value() : contentHashOf(tempFile->get_path());
+
+    // Keyed on the source, as Inspection looks it up without opening it: a
+    // decrypted copy has a hash of its own
+    const bool isDecryptedCopy = m_remoteFile == nullptr && Decryption::mayBeEncrypted(sourceFile->get_path());
+    m_indexKey = pageIndexKeyOf(sourceFile, isDecryptedCopy ? contentHashOf(sourceFile->get_path()) : contentHash);
+    m_indexedPages = PageIndex::load(m_indexKey);
+
+    // The store gives its entries theirs, before another document can share them
+    if (isOwnSourceFile)
+        m_sourceFile->setOrigin({m_indexKey.fileSize, m_indexKey.modificationTime});
+
+    if (!m_indexedPages.has_value()) {
+        if (m_remoteFile != nullptr && !m_remoteFile->isFirstPageFetched())
+            m_remoteFile->waitUntilComplete();
+
+        m_isPartiallyLoaded = m_remoteFile != nullptr && !m_remoteFile->isComplete();
+        m_popplerDocument = PopplerHandles::load(tempFile->get_path());
+
+        // Poppler may not make sense of the partial file after all
+        if (m_isPartiallyLoaded && !readsFirstPage(m_popplerDocument, m_remoteFile->linearization()->numberOfPages)) {
+            m_remoteFile->waitUntilComplete();
+            m_isPartiallyLoaded = false;
+            m_popplerDocument = PopplerHandles::load(tempFile->get_path());
+        }
+
+        if (m_popplerDocument == nullptr)
+            throw std::runtime_error("Couldn't load file: " + sourceFile->get_parse_name());
+
+        m_newIndex.resize(static_cast<std::size_t>(m_popplerDocument->pages()));
+    }
+
+    m_fileData = FileData{sourceFile,
+                          tempFile,
+                          contentHash,
+                          m_sourceFile};
+    m_fileData.numberOfPages = numberOfPages();
+}
+
+void Document::FileLoader::shareFile(const FileData& fileData, std::shared_ptr<SourceFile> sourceFile)
+{
+    // The pages keep the name they were added with
+    const Glib::RefPtr<Gio::File> originalFile = m_fileData.originalFile;
+
+    m_fileData = fileData;
+    m_fileData.originalFile = originalFile;
+    m_sourceFile = std::move(sourceFile);
+}
+
+unsigned int Document::FileLoader::numberOfAvailablePages() const
+{
+    if (m_isPartiallyLoaded && !m_remoteFile->isComplete())
+        return std::min(1U, numberOfPages());
+
+    return numberOfPages();
+}
+
+unsigned int Document::FileLoader::numberOfPages() const
+{
+    if (m_indexedPages.has_value())
+        return static_cast<unsigned>(m_indexedPages->size());
+
+    return static_cast<unsigned>(m_popplerDocument->pages());
+}
+
+std::vector<Glib::RefPtr<Page>> Document::FileLoader::loadPages(unsigned int first,
+                                                                unsigned int count,
+                                                                unsigned int fileNumber) const
+{
+    const std::shared_ptr<const PageListModel::Source> source = loadSource(first, count, fileNumber);
     std::vector<Glib::RefPtr<Page>> result;
+    result.reserve(source->entries.size());
+
+    for (unsigned int i = 0; i < source->entries.size(); ++i)
+        result.push_back(source->createPage(i));
 
-    for (int i = 0; i < fileData.popplerDocument->pages(); ++i) {
-        std::unique_ptr<poppler::page> ppage{fileData.popplerDocument->create_page(i)};
+    return result;
+}
+
+std::vector<PageListModel::Row> Document::FileLoader::loadRows(unsigned int first,
+                                                               unsigned int count,
+                                                               unsigned int fileNumber) const
+{
+    return PageListModel::Row::rowsOf(loadSource(first, count, fileNumber));
+}
+
+std::shared_ptr<const PageListModel::Source> Document::FileLoader::loadSource(unsigned int first,
+                                                                              unsigned int count,
+                                                                              unsigned int fileNumber) const
+{
+    const Trace::Span span{"Document::loadPages"};
+    const unsigned int last = std::min(first + count, numberOfPages());
+    auto source = std::make_shared<PageListModel::Source>(
+        PageListModel::Source{Glib::filename_display_name(m_fileData.originalFile->get_basename()),
+                              m_sourceFile,
+                              m_fileData.contentHash,
+                              fileNumber,
+                              {}});
+    source->entries.reserve(last > first ? last - first : 0);
+
+    // Only the first page could be read from the partial file
+    if (m_isPartiallyLoaded && last > std::max(first, 1U)) {
+        m_remoteFile->waitUntilComplete();
+        m_popplerDocument = PopplerHandles::load(m_fileData.tempFile->get_path());
+        m_isPartiallyLoaded = false;
+
+        if (m_popplerDocument == nullptr)
+            throw std::runtime_error("Couldn't load file: " + m_fileData.originalFile->get_parse_name());
+    }
+
+    for (unsigned int i = first; i < last; ++i) {
+        if (m_indexedPages.has_value()) {
+            source->entries.push_back({i, m_indexedPages->at(i)});
+            continue;
+        }
+
+        const auto creationStart = std::chrono::steady_clock::now();
+        std::unique_ptr<poppler::page> ppage{m_popplerDocument->create_page(static_cast<int>(i))};
 
         if (ppage == nullptr)
             throw std::runtime_error("Couldn't load page with number: " + std::to_string(i));
 
-        auto page = Glib::RefPtr<Page>{new Page{std::move(ppage),
-                                                basename,
-                                                fileNumber,
-                                                static_cast<unsigned>(i)}};
-        result.push_back(page);
+        Metrics::recordPageCreation(m_sourceFile->path(), i, std::chrono::steady_clock::now() - creationStart);
+
+        // The poppler::page goes away here; pages keep only plain metadata
+        const Page::Size size = Page::sizeOf(*ppage);
+        const PageIndex::Entry entry{size.width, size.height, Page::rotationOf(*ppage), renderCostOf(i)};
+        source->entries.push_back({i, entry});
+
+        m_newIndex.at(i) = entry;
+        if (++m_numberOfNewIndexEntries == m_newIndex.size())
+            PageIndex::store(m_indexKey, m_newIndex);
     }
 
-    return result;
+    return source;
+}
+
+std::uint32_t Document::FileLoader::renderCostOf(unsigned int indexInFile) const
+{
+    // Only the first page of a partial file is read, and QPDF needs all of it
+    if (m_isPartiallyLoaded)
+        return 0;
+
+    if (!m_renderCosts.has_value()) {
+        const Trace::Span span{"RenderCost::estimate"};
+
+        try {
+            m_renderCosts = RenderCost::estimate(m_fileData.tempFile->get_path());
+        }
+        catch (const std::runtime_error&) {
+            // Poppler may still read what QPDF can't; the pages are just of unknown cost
+            m_renderCosts.emplace();
+        }
+    }
+
+    return indexInFile < m_renderCosts->size() ? m_renderCosts->at(indexInFile) : 0;
 }
 
 }
@@ -18,24 +18,139 @@
 #define DOCUMENT_HPP
 
 #include "page.hpp"
+#include "pagedigest.hpp"
+#include "pageindex.hpp"
+#include "pagelistmodel.hpp"
+#include "pagesequence.hpp"
+#include "pagetable.hpp"
 #include "pdfsaver.hpp"
+#include "session.hpp"
+#include "sourcefile.hpp"
 #include <giomm/file.h>
-#include <giomm/liststore.h>
 #include <poppler/cpp/poppler-document.h>
+#include <memory>
+#include <optional>
 #include <vector>
 
 namespace Slicer {
 
 class Document {
+private:
+    struct FileData {
+        Glib::RefPtr<Gio::File> originalFile;
+        Glib::RefPtr<Gio::File> tempFile;
+        std::string contentHash;
+        // Owned by the pages of the file; expired once they are all gone
+        std::weak_ptr<SourceFile> sourceFile;
+        // 0 when not known, as for files restored from a session
+        unsigned int numberOfPages = 0;
+    };
+
 public:
+    // Opens a file in steps, so that the slow ones can run on a worker thread.
+    // Constructing a FileLoader and calling loadPages() never touch a Document.
+    class FileLoader {
+    public:
+        explicit FileLoader(const Glib::RefPtr<Gio::File>& sourceFile);
+
+        unsigned int numberOfPages() const;
+        // The pages that load without waiting: only the first one of a
+        // remote file whose first page was fetched ahead of the rest
+        unsigned int numberOfAvailablePages() const;
+        std::vector<Glib::RefPtr<Page>> loadPages(unsigned int first,
+                                                  unsigned int count,
+                                                  unsigned int fileNumber) const;
+        // The same pages, as rows that only make the Page objects when the
+        // document is asked for them. What large files are loaded as.
+        std::vector<PageListModel::Row> loadRows(unsigned int first,
+                                                 unsigned int count,
+                                                 unsigned int fileNumber) const;
+
+        const std::string& contentHash() const { return m_fileData.contentHash; }
+        std::string snapshotPath() const { return m_fileData.tempFile->get_path(); }
+        SourceFile::Origin origin() const { return {m_indexKey.fileSize, m_indexKey.modificationTime}; }
+
+    private:
+        friend class Document;
+        // Pages are loaded as pages of that file, already in the document
+        void shareFile(const FileData& fileData, std::shared_ptr<SourceFile> sourceFile);
+
+        FileData m_fileData;
+        // Deletes the snapshot if no page is ever loaded from it
+        std::shared_ptr<SourceFile> m_sourceFile;
+        // Only for files without a local path
+        std::shared_ptr<RemoteFile> m_remoteFile;
+        // Only for reading the pages; renders open their own handles.
+        // Not even opened when the pages come from the index. Opened again
+        // once a remote file is complete, if it was opened on part of it.
+        mutable std::shared_ptr<poppler::document> m_popplerDocument;
+        mutable bool m_isPartiallyLoaded = false;
+        std::optional<std::vector<PageIndex::Entry>> m_indexedPages;
+        PageIndex::Key m_indexKey;
+        // Read from poppler as the pages load, and stored once they all have
+        mutable std::vector<PageIndex::Entry> m_newIndex;
+        mutable unsigned int m_numberOfNewIndexEntries = 0;
+        // Estimated along with the index, with QPDF, once the file is all there
+        mutable std::optional<std::vector<std::uint32_t>> m_renderCosts;
+
+        std::uint32_t renderCostOf(unsigned int indexInFile) const;
+        std::shared_ptr<const PageListModel::Source> loadSource(unsigned int first,
+                                                                unsigned int count,
+                                                                unsigned int fileNumber) const;
+    };
+
+    // What the pages of the file get as their fileHash(), and their
+    // thumbnails are cached by. Reads both ends of the file, not all of it.
+    static std::string contentHashOf(const std::string& filePath);
+    // Where the PageIndex of the file is looked for, with what it's checked against
+    static PageIndex::Key pageIndexKeyOf(const Glib::RefPtr<Gio::File>& file, const std::string& contentHash);
+
+    // A file that some page, in the document or in the undo history, comes from
+    struct LiveFile {
+        unsigned int fileNumber;
+        Glib::RefPtr<Gio::File> originalFile;
+        std::string snapshotPath;
+        std::string contentHash;
+        // Of the source, when the snapshot was taken
+        SourceFile::Origin origin;
+    };
+
+    Document();
     Document(const Glib::RefPtr<Gio::File>& sourceFile);
     Document(const std::vector<Glib::RefPtr<Gio::File>>& sourceFiles);
+    // As it was stored, reading from the copies kept by the session.
+    // Nothing is parsed: the pages are made from what was stored about them.
+    explicit Document(const Session::DocumentState& state);
+
+    Document(const Document&) = delete;
+    Document& operator=(const Document&) = delete;
+    Document(Document&&) = delete;
+    Document& operator=(Document&& src) = delete;
+
+    ~Document();
+
+    // Registers the file behind a FileLoader, returning the file number to load its pages with.
+    // A file with the same contents as one already in the document is
+    // registered as that one: its pages share the snapshot, the poppler
+    // handles and the parsed copy when saving, and the loader's own
+    // snapshot goes away with the loader.
+    unsigned int addLoadedFile(FileLoader& loader);
+    void appendPages(const std::vector<Glib::RefPtr<Page>>& pages);
+    void appendRows(std::vector<PageListModel::Row> rows);
+    // Registers a new version of a file of the document, and brings in only
+    // what changed since the last one: changed pages are replaced where
+    // they are, keeping their rotation, removed ones are taken out, and added
+    // ones go after the last page of the file. The other pages keep the
+    // version they came from, and its snapshot. Returns the pages replaced
+    // or removed.
+    std::vector<Glib::RefPtr<Page>> reloadFile(FileLoader& loader, const PageDigest::Changes& changes);
 
     Glib::RefPtr<Page> removePage(unsigned int index);
     std::vector<Glib::RefPtr<Page>> removePages(const std::vector<unsigned int>& indexes);
     std::vector<Glib::RefPtr<Page>> removePageRange(unsigned int first, unsigned int last);
 
     void insertPage(const Glib::RefPtr<Page>& page);
+    // Each page goes back to its document index, as removePages() left it
     void insertPages(const std::vector<Glib::RefPtr<Page>>& pages);
     void insertPageRange(const std::vector<Glib::RefPtr<Page>>& pages, unsigned int position);
 
@@ -43,35 +158,106 @@ public:
     void movePageRange(unsigned int indexFirst,
                        unsigned int indexLast,
                        unsigned int indexDestination);
+    // Any set of pages, kept in their order, ends up starting at destination.
+    // The rest keep theirs too.
+    void movePages(const std::vector<unsigned int>& indexes, unsigned int destination);
+    // Puts the pages that movePages() took to destination back at indexes
+    void returnMovedPages(const std::vector<unsigned int>& indexes, unsigned int destination);
 
     void rotatePagesRight(const std::vector<unsigned int>& pageNumbers);
     void rotatePagesLeft(const std::vector<unsigned int>& pageNumbers);
+    // Any number of quarter turns in one go: right for positive ones, left for negative ones
+    void rotatePages(const std::vector<unsigned int>& pageNumbers, int quarterTurns);
+
+    // Cached between edits: consecutive versions share their unchanged chunks.
+    // The sequence holds every page, so they are all made for it.
+    PageSequence pageSequence() const;
+    // Cached between edits as well
+    const PageTable& pageTable() const;
+    // Makes the document look like sequence. Only the span between the first
+    // and the last page that differ is replaced, with a single splice, and
+    // every signal is emitted at most once.
+    void setPageSequence(const PageSequence& sequence);
+
+    // What setPageSequence() does, worked out beforehand. Takes no document,
+    // so it can run on any thread, as long as nothing turns the pages meanwhile.
+    struct PageSequenceChange {
+        PageSequence from;
+        PageSequence to;
+        unsigned int first = 0;
+        unsigned int numberOfReplaced = 0;
+        unsigned int numberOfInserted = 0;
+        // Every page from first onwards, when there's a splice, in its new order
+        std::vector<Glib::RefPtr<Page>> renumberedPages;
+        // By position in to
+        std::vector<std::pair<unsigned int, int>> rotations;
+    };
+    static PageSequenceChange changeBetween(const PageSequence& from, const PageSequence& to);
+    // Like setPageSequence(), but only if the document is still at change.from, as
+    // last handed out by pageSequence() or set. Returns false, changing nothing, if not.
+    bool applyPageSequenceChange(const PageSequenceChange& change);
 
     unsigned int addFile(const Glib::RefPtr<Gio::File>& file, unsigned int position);
     unsigned int addFiles(const std::vector<Glib::RefPtr<Gio::File>>& files, unsigned int position);
 
+    // Made if nothing holds it, see PageListModel
     Glib::RefPtr<Page> getPage(unsigned int index) const;
-    const Glib::RefPtr<Gio::ListStore<Page>>& pages() const;
+    const Glib::RefPtr<PageListModel>& pages() const;
     unsigned int numberOfPages() const;
     std::string lastAddedFileParentPath() const;
+    // The size every page has, if they all have the same, before rotations.
+    // Pages removed later aren't taken into account.
+    std::optional<Page::Size> uniformPageSize() const;
 
     PdfSaver::SaveData getSaveData() const;
+    // Files still referenced by a page, in the document or in the undo history
+    unsigned int numberOfLiveFiles() const;
+    // The last version of each file that's live, see reloadFile()
+    std::vector<LiveFile> liveFiles() const;
+    // To restore the document later. Leaves out files still being fetched,
+    // and their pages, rather than keep a partial copy.
+    Session::DocumentState sessionState() const;
+    // Lets repeated saves of this document skip parsing its files again
+    const std::shared_ptr<PdfSaver::ParsedFileCache>& parsedFileCache() const { return m_parsedFileCache; }
+
+    // Edits made until the matching release reach the views as a single
+    // change, however many there are: one splice of pages() over the span
+    // they touched, and a single pagesRotated for the pages turned outside
+    // of it. Holds nest; the last release notifies.
+    void holdNotifications();
+    void releaseNotifications();
 
     sigc::signal<void, std::vector<unsigned int>> pagesRotated;
     sigc::signal<void, std::vector<unsigned int>> pagesReordered;
+    // Every page from the given index onwards may have a new document index
+    sigc::signal<void, unsigned int> pagesRenumbered;
 
 private:
-    struct FileData {
-        Glib::RefPtr<Gio::File> originalFile;
-        Glib::RefPtr<Gio::File> tempFile;
-        std::unique_ptr<poppler::document> popplerDocument;
-    };
-
-    static FileData loadFile(const Glib::RefPtr<Gio::File>& sourceFile);
-    static std::vector<Glib::RefPtr<Page>> loadPages(const FileData& fileData, unsigned int fileNumber);
+    void notifyRenumbered(unsigned int first);
+    void notifyReordered(const std::vector<unsigned int>& positions);
+    void notifyRotated(const std::vector<unsigned int>& positions);
+    void renumberPagesFrom(unsigned int first);
+    // The rows from first onwards, in their new order, numbered and put back with one splice
+    void replaceRowsFrom(unsigned int first, std::vector<PageListModel::Row> rows);
+    void insertRows(std::vector<PageListModel::Row> rows, unsigned int position);
+    void trackPageSize(Page::Size size);
+    void registerFile(const FileData& fileData);
+    // The number of a live file with the same contents, if there's one
+    std::optional<unsigned int> findSameFile(const FileData& fileData) const;
 
+    // Indexed by file number, so released files keep their entry
     std::vector<FileData> m_filesData;
-    Glib::RefPtr<Gio::ListStore<Page>> m_pages;
+    // The first file is the shell of every save, so it's kept even with no pages left
+    std::shared_ptr<SourceFile> m_shellFile;
+    Glib::RefPtr<Gio::File> m_lastAddedFile;
+    std::optional<Page::Size> m_firstPageSize;
+    bool m_hasUniformPageSize = true;
+    Glib::RefPtr<PageListModel> m_pages;
+    unsigned int m_notificationHolds = 0;
+    std::shared_ptr<PdfSaver::ParsedFileCache> m_parsedFileCache = std::make_shared<PdfSaver::ParsedFileCache>();
+    // The last sequence handed out or set, while the document hasn't changed since
+    mutable std::optional<PageSequence> m_pageSequence;
+    mutable std::optional<PageTable> m_pageTable;
 };
 }
 
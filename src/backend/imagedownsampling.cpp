@@ -0,0 +1,365 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "imagedownsampling.hpp"
+#include <gdkmm/pixbufloader.h>
+#include <qpdf/Buffer.hh>
+#include <qpdf/DLL.h>
+#include <qpdf/Pl_Buffer.hh>
+#include <qpdf/Pl_Flate.hh>
+#include <qpdf/QPDFPageDocumentHelper.hh>
+#include <qpdf/QUtil.hh>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <stdexcept>
+
+namespace Slicer::ImageDownsampling {
+
+namespace {
+    // Smaller images aren't worth the work
+    constexpr int minimumSide = 64;
+    constexpr double pointsPerInch = 72.0;
+
+    // a b c d e f, as cm takes them
+    using Matrix = std::array<double, 6>;
+
+    constexpr Matrix identity{1, 0, 0, 1, 0, 0};
+
+    Matrix multiply(const Matrix& m, const Matrix& ctm)
+    {
+        return {m[0] * ctm[0] + m[1] * ctm[2],
+                m[0] * ctm[1] + m[1] * ctm[3],
+                m[2] * ctm[0] + m[3] * ctm[2],
+                m[2] * ctm[1] + m[3] * ctm[3],
+                m[4] * ctm[0] + m[5] * ctm[2] + ctm[4],
+                m[4] * ctm[1] + m[5] * ctm[3] + ctm[5]};
+    }
+
+    struct Placement {
+        std::string xObjectName;
+        Matrix matrix;
+    };
+
+    // Follows the transformations of the contents, and where they draw XObjects
+    class PlacementFinder : public QPDFObjectHandle::ParserCallbacks {
+    public:
+        using QPDFObjectHandle::ParserCallbacks::handleObject;
+
+        void handleObject(QPDFObjectHandle object) override
+        {
+            if (!object.isOperator()) {
+                m_operands.push_back(object);
+                return;
+            }
+
+            const std::string op = object.getOperator();
+
+            if (op == "q") {
+                m_stateStack.push_back(m_ctm);
+            }
+            else if (op == "Q" && !m_stateStack.empty()) {
+                m_ctm = m_stateStack.back();
+                m_stateStack.pop_back();
+            }
+            else if (op == "cm" && m_operands.size() == 6
+                     && std::all_of(m_operands.begin(), m_operands.end(), [](QPDFObjectHandle& operand) {
+                            return operand.isNumber();
+                        })) {
+                Matrix m{};
+                for (std::size_t i = 0; i < m.size(); ++i)
+                    m.at(i) = m_operands.at(i).getNumericValue();
+
+                m_ctm = multiply(m, m_ctm);
+            }
+            else if (op == "Do" && m_operands.size() == 1 && m_operands.front().isName()) {
+                m_placements.push_back({m_operands.front().getName(), m_ctm});
+            }
+
+            m_operands.clear();
+        }
+
+        void handleEOF() override
+        {
+        }
+
+        const std::vector<Placement>& placements() const { return m_placements; }
+
+    private:
+        std::vector<QPDFObjectHandle> m_operands;
+        Matrix m_ctm = identity;
+        std::vector<Matrix> m_stateStack;
+        std::vector<Placement> m_placements;
+    };
+
+    bool isNameOrSingleNameArray(QPDFObjectHandle object, const std::string& name)
+    {
+        if (object.isArray() && object.getArrayNItems() == 1)
+            object = object.getArrayItem(0);
+
+        return object.isName() && object.getName() == name;
+    }
+
+    // 0 for color spaces that can't be turned into RGB as they are. An ICC
+    // profile goes unapplied, and the result is plain RGB.
+    int componentsOf(QPDFObjectHandle colorSpace)
+    {
+        if (colorSpace.isName()) {
+            if (colorSpace.getName() == "/DeviceGray")
+                return 1;
+            if (colorSpace.getName() == "/DeviceRGB")
+                return 3;
+
+            return 0;
+        }
+
+        if (colorSpace.isArray() && colorSpace.getArrayNItems() == 2 && colorSpace.getArrayItem(0).isName()
+            && colorSpace.getArrayItem(0).getName() == "/ICCBased" && colorSpace.getArrayItem(1).isStream()) {
+            QPDFObjectHandle components = colorSpace.getArrayItem(1).getDict().getKey("/N");
+
+            if (components.isInteger() && (components.getIntValue() == 1 || components.getIntValue() == 3))
+                return static_cast<int>(components.getIntValue());
+        }
+
+        return 0;
+    }
+
+    // Without the target size, which depends on every place it's drawn at
+    std::optional<Candidate> candidateFor(QPDFObjectHandle image)
+    {
+        if (!image.isStream())
+            return std::nullopt;
+
+        QPDFObjectHandle dict = image.getDict();
+        QPDFObjectHandle subtype = dict.getKey("/Subtype");
+        QPDFObjectHandle bitsPerComponent = dict.getKey("/BitsPerComponent");
+        QPDFObjectHandle imageMask = dict.getKey("/ImageMask");
+        QPDFObjectHandle width = dict.getKey("/Width");
+        QPDFObjectHandle height = dict.getKey("/Height");
+        QPDFObjectHandle filter = dict.getKey("/Filter");
+
+        if (!subtype.isName() || subtype.getName() != "/Image"
+            || !bitsPerComponent.isInteger() || bitsPerComponent.getIntValue() != 8
+            || (imageMask.isBool() && imageMask.getBoolValue())
+            || !dict.getKey("/Mask").isNull()
+            || !dict.getKey("/Decode").isNull()
+            || !dict.getKey("/DecodeParms").isNull()
+            || !width.isInteger() || !height.isInteger())
+            return std::nullopt;
+
+        Candidate candidate;
+        candidate.image = image;
+        candidate.isJpeg = isNameOrSingleNameArray(filter, "/DCTDecode");
+        candidate.isFlate = isNameOrSingleNameArray(filter, "/FlateDecode");
+        candidate.width = static_cast<int>(width.getIntValue());
+        candidate.height = static_cast<int>(height.getIntValue());
+        candidate.components = componentsOf(dict.getKey("/ColorSpace"));
+
+        if ((!filter.isNull() && !candidate.isJpeg && !candidate.isFlate) || candidate.components == 0
+            || candidate.width < minimumSide || candidate.height < minimumSide)
+            return std::nullopt;
+
+        return candidate;
+    }
+
+    std::string inflate(const std::string& data)
+    {
+        Pl_Buffer buffer{"image samples"};
+        Pl_Flate flate{"image inflate", &buffer, Pl_Flate::a_inflate};
+        flate.write(QUtil::unsigned_char_pointer(data), data.size());
+        flate.finish();
+
+        const std::unique_ptr<Buffer> samples{buffer.getBuffer()};
+
+        return std::string{reinterpret_cast<const char*>(samples->getBuffer()), samples->getSize()}; //NOLINT
+    }
+
+    Glib::RefPtr<Gdk::Pixbuf> decodeJpeg(const std::string& data, int targetWidth, int targetHeight)
+    {
+        // With a size, libjpeg decodes at 1/2, 1/4 or 1/8 of the resolution
+        // when that's still enough, which is most of the work saved
+        auto loader = Gdk::PixbufLoader::create("jpeg");
+        loader->set_size(targetWidth, targetHeight);
+        loader->write(reinterpret_cast<const guint8*>(data.data()), data.size()); //NOLINT
+        loader->close();
+
+        return loader->get_pixbuf();
+    }
+
+    Glib::RefPtr<Gdk::Pixbuf> decodeSamples(const Candidate& candidate, const std::string& data)
+    {
+        const std::string samples = candidate.isFlate ? inflate(data) : data;
+        const auto rowLength = static_cast<std::size_t>(candidate.width) * static_cast<std::size_t>(candidate.components);
+
+        if (samples.size() < rowLength * static_cast<std::size_t>(candidate.height))
+            return {};
+
+        auto pixbuf = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, false, 8, candidate.width, candidate.height);
+
+        for (int y = 0; y < candidate.height; ++y) {
+            const char* source = samples.data() + static_cast<std::ptrdiff_t>(y) * static_cast<std::ptrdiff_t>(rowLength); //NOLINT
+            guint8* destination = pixbuf->get_pixels() + static_cast<std::ptrdiff_t>(y) * pixbuf->get_rowstride(); //NOLINT
+
+            if (candidate.components == 3) {
+                std::copy(source, source + rowLength, destination); //NOLINT
+                continue;
+            }
+
+            for (int x = 0; x < candidate.width; ++x)
+                std::fill_n(destination + 3 * x, 3, static_cast<guint8>(source[x])); //NOLINT
+        }
+
+        return pixbuf;
+    }
+}
+
+std::vector<Candidate> findCandidates(QPDF& pdf, const Options& options)
+{
+    std::map<QPDFObjGen, Candidate> candidates;
+    // In points, the largest each image is drawn at
+    std::map<QPDFObjGen, std::pair<double, double>> drawnSizes;
+
+    for (QPDFPageObjectHelper& page : QPDFPageDocumentHelper{pdf}.getAllPages()) {
+        QPDFObjectHandle resources = page.getAttribute("/Resources", false);
+        if (!resources.isDictionary())
+            continue;
+
+        QPDFObjectHandle xObjects = resources.getKey("/XObject");
+        if (!xObjects.isDictionary())
+            continue;
+
+        PlacementFinder finder;
+#if defined(QPDF_MAJOR_VERSION) && (QPDF_MAJOR_VERSION > 10 || (QPDF_MAJOR_VERSION == 10 && QPDF_MINOR_VERSION >= 1))
+        page.parseContents(&finder);
+#else
+        page.parsePageContents(&finder);
+#endif
+
+        for (const Placement& placement : finder.placements()) {
+            QPDFObjectHandle image = xObjects.getKey(placement.xObjectName);
+
+            if (!image.isStream() || !image.isIndirect())
+                continue;
+
+            const QPDFObjGen objGen = image.getObjGen();
+
+            if (candidates.find(objGen) == candidates.end()) {
+                std::optional<Candidate> candidate = candidateFor(image);
+                if (!candidate.has_value())
+                    continue;
+
+                candidates.emplace(objGen, std::move(candidate.value()));
+            }
+
+            // The image is the unit square, turned into the page by the matrix
+            const Matrix& m = placement.matrix;
+            auto& [drawnWidth, drawnHeight] = drawnSizes[objGen];
+            drawnWidth = std::max(drawnWidth, std::hypot(m[0], m[1]));
+            drawnHeight = std::max(drawnHeight, std::hypot(m[2], m[3]));
+        }
+    }
+
+    std::vector<Candidate> result;
+
+    for (auto& [objGen, candidate] : candidates) {
+        const auto& [drawnWidth, drawnHeight] = drawnSizes.at(objGen);
+
+        if (drawnWidth <= 0 || drawnHeight <= 0)
+            continue;
+
+        // The axis drawn at the lowest resolution sets the scale for both
+        const double dpi = std::min(candidate.width * pointsPerInch / drawnWidth,
+                                    candidate.height * pointsPerInch / drawnHeight);
+
+        if (dpi <= options.dpi * options.threshold)
+            continue;
+
+        const double scale = options.dpi / dpi;
+        candidate.targetWidth = std::max(1, static_cast<int>(std::lround(candidate.width * scale)));
+        candidate.targetHeight = std::max(1, static_cast<int>(std::lround(candidate.height * scale)));
+        result.push_back(std::move(candidate));
+    }
+
+    return result;
+}
+
+std::string readData(const Candidate& candidate)
+{
+    QPDFObjectHandle image = candidate.image;
+    auto data = image.getRawStreamData();
+
+    return std::string{reinterpret_cast<const char*>(data->getBuffer()), data->getSize()}; //NOLINT
+}
+
+std::optional<Recompressed> recompress(const Candidate& candidate, const std::string& data, const Options& options)
+{
+    Glib::RefPtr<Gdk::Pixbuf> pixbuf;
+
+    try {
+        pixbuf = candidate.isJpeg ? decodeJpeg(data, candidate.targetWidth, candidate.targetHeight)
+                                  : decodeSamples(candidate, data);
+    }
+    catch (const Glib::Error&) {
+        return std::nullopt;
+    }
+    catch (const std::runtime_error&) {
+        // Flate data qpdf couldn't inflate
+        return std::nullopt;
+    }
+
+    if (!pixbuf)
+        return std::nullopt;
+
+    // Tiles average the pixels under each one when scaling down, which keeps
+    // thin lines of text from breaking up
+    if (pixbuf->get_width() != candidate.targetWidth || pixbuf->get_height() != candidate.targetHeight)
+        pixbuf = pixbuf->scale_simple(candidate.targetWidth, candidate.targetHeight, Gdk::INTERP_TILES);
+
+    gchar* buffer = nullptr;
+    gsize size = 0;
+
+    try {
+        pixbuf->save_to_buffer(buffer, size, "jpeg", {"quality"}, {std::to_string(std::clamp(options.quality, 0, 100))});
+    }
+    catch (const Glib::Error&) {
+        return std::nullopt;
+    }
+
+    Recompressed result{std::string{buffer, size}, pixbuf->get_width(), pixbuf->get_height()};
+    g_free(buffer);
+
+    if (result.jpeg.size() >= data.size())
+        return std::nullopt;
+
+    return result;
+}
+
+void replace(const Candidate& candidate, const Recompressed& recompressed)
+{
+    QPDFObjectHandle image = candidate.image;
+    image.replaceStreamData(recompressed.jpeg, QPDFObjectHandle::newName("/DCTDecode"), QPDFObjectHandle::newNull());
+
+    // The gdk-pixbuf JPEG writer always writes RGB
+    QPDFObjectHandle dict = image.getDict();
+    dict.replaceKey("/Width", QPDFObjectHandle::newInteger(recompressed.width));
+    dict.replaceKey("/Height", QPDFObjectHandle::newInteger(recompressed.height));
+    dict.replaceKey("/ColorSpace", QPDFObjectHandle::newName("/DeviceRGB"));
+    dict.replaceKey("/BitsPerComponent", QPDFObjectHandle::newInteger(8));
+}
+
+} // namespace Slicer::ImageDownsampling
@@ -0,0 +1,79 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef IMAGEDOWNSAMPLING_HPP
+#define IMAGEDOWNSAMPLING_HPP
+
+#include <qpdf/QPDF.hh>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace Slicer::ImageDownsampling {
+
+// Makes files smaller, for sending them by mail: images drawn at more than
+// a resolution are scaled down to it and compressed again as JPEG. Only
+// images of 8 bit gray or RGB samples, uncompressed, Flate or JPEG, without
+// decode arrays or color key masks, and drawn straight from the contents of
+// a page; those in forms and patterns are left as they are.
+
+struct Options {
+    double dpi = 150;
+    // Only images drawn at more than this many times dpi are scaled down:
+    // scaling a little saves little, and takes a generation of JPEG from them
+    double threshold = 1.5;
+    // From 0 to 100
+    int quality = 80;
+};
+
+// An image to scale down, found in the QPDF the saver writes
+struct Candidate {
+    QPDFObjectHandle image;
+    bool isJpeg = false;
+    bool isFlate = false;
+    int width = 0;
+    int height = 0;
+    // 1 for gray, 3 for RGB
+    int components = 0;
+    // At options.dpi where it's drawn the largest
+    int targetWidth = 0;
+    int targetHeight = 0;
+};
+
+struct Recompressed {
+    std::string jpeg;
+    int width = 0;
+    int height = 0;
+};
+
+// Goes through the contents of every page. Like everything that touches
+// the QPDF, from one thread at a time.
+std::vector<Candidate> findCandidates(QPDF& pdf, const Options& options);
+
+// The image data, as the file has it
+std::string readData(const Candidate& candidate);
+
+// Doesn't touch the QPDF, or the image handle of the candidate, so it can
+// run on every core at once. Nothing when the data can't be read, or the
+// result wouldn't be smaller.
+std::optional<Recompressed> recompress(const Candidate& candidate, const std::string& data, const Options& options);
+
+// Puts the result in place of the image, for every page that draws it
+void replace(const Candidate& candidate, const Recompressed& recompressed);
+
+} // namespace Slicer::ImageDownsampling
+
+#endif // IMAGEDOWNSAMPLING_HPP
@@ -0,0 +1,243 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "imageexport.hpp"
+#include "cpuresources.hpp"
+#include "pagerenderer.hpp"
+#include "trace.hpp"
+#include <gdkmm/pixbufformat.h>
+#include <glibmm/ustring.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace Slicer::ImageExport {
+
+std::string formatName(Format format)
+{
+    switch (format) {
+    case Format::Png:
+        return "png";
+    case Format::Jpeg:
+        return "jpg";
+    case Format::WebP:
+        return "webp";
+    }
+
+    return "png";
+}
+
+std::optional<Format> formatFromName(const std::string& name)
+{
+    if (name == "jpeg")
+        return Format::Jpeg;
+
+    for (Format format : {Format::Png, Format::Jpeg, Format::WebP})
+        if (formatName(format) == name)
+            return format;
+
+    return {};
+}
+
+// What gdk-pixbuf calls it
+static Glib::ustring pixbufTypeOf(Format format)
+{
+    return format == Format::Jpeg ? "jpeg" : formatName(format);
+}
+
+bool canWrite(Format format)
+{
+    const Glib::ustring type = pixbufTypeOf(format);
+
+    for (const Gdk::PixbufFormat& pixbufFormat : Gdk::Pixbuf::get_formats())
+        if (pixbufFormat.get_name() == type && pixbufFormat.is_writable())
+            return true;
+
+    return false;
+}
+
+static void write(const Glib::RefPtr<Gdk::Pixbuf>& image,
+                  const Glib::RefPtr<Gio::File>& file,
+                  const Options& options)
+{
+    const Trace::Span span{"ImageExport write"};
+
+    switch (options.format) {
+    case Format::Png:
+        // A low zlib level: pages compress well even so, and writing keeps up with rendering
+        image->save(file->get_path(), "png", {"compression"}, {"3"});
+        break;
+    case Format::Jpeg:
+    case Format::WebP:
+        // The JPEG writer drops alpha by itself; pages are opaque anyway
+        image->save(file->get_path(),
+                    pixbufTypeOf(options.format),
+                    {"quality"},
+                    {std::to_string(std::clamp(options.quality, 0, 100))});
+        break;
+    }
+}
+
+std::vector<Glib::RefPtr<Gio::File>> exportPages(const std::vector<Glib::RefPtr<const Page>>& pages,
+                                                 const std::function<Glib::RefPtr<Gio::File>(std::size_t)>& destinationOfPage,
+                                                 const Options& options,
+                                                 const PageWrittenSlot& onPageWritten,
+                                                 const std::shared_ptr<std::atomic<bool>>& canceled)
+{
+    if (!canWrite(options.format))
+        throw std::runtime_error("Can't write " + formatName(options.format) + " images on this system");
+
+    if (options.dpi <= 0)
+        throw std::runtime_error("Invalid resolution: " + std::to_string(options.dpi));
+
+    unsigned int numberOfThreads = options.numberOfThreads;
+    if (numberOfThreads == 0)
+        numberOfThreads = CpuResources::availableCores();
+    numberOfThreads = static_cast<unsigned int>(std::min<std::size_t>(numberOfThreads, pages.size()));
+
+    const unsigned int maximumFramesInFlight = options.maximumFramesInFlight != 0 ? options.maximumFramesInFlight
+                                                                                  : numberOfThreads;
+
+    struct Frame {
+        std::size_t index;
+        Glib::RefPtr<Gdk::Pixbuf> image;
+    };
+
+    // Guarded by mutex
+    std::mutex mutex;
+    std::condition_variable frameDone;
+    std::deque<Frame> rendered;
+    std::size_t nextPage = 0;
+    unsigned int framesInFlight = 0;
+    std::string error;
+    std::vector<Glib::RefPtr<Gio::File>> writtenFiles(pages.size());
+
+    auto isStopped = [&]() {
+        return !error.empty() || (canceled != nullptr && *canceled);
+    };
+
+    // Writing comes first, so that frames don't pile up while pages render.
+    // A thread waits only when there's nothing rendered to write and
+    // maximumFramesInFlight are already rendering or being written.
+    auto worker = [&]() {
+        std::unique_lock<std::mutex> lock{mutex};
+
+        for (;;) {
+            frameDone.wait(lock, [&]() {
+                return !rendered.empty() || isStopped() || nextPage >= pages.size()
+                       || framesInFlight < maximumFramesInFlight;
+            });
+
+            if (!rendered.empty() && !isStopped()) {
+                Frame frame = std::move(rendered.front());
+                rendered.pop_front();
+                lock.unlock();
+
+                std::string failure;
+                Glib::RefPtr<Gio::File> file;
+
+                try {
+                    file = destinationOfPage(frame.index);
+                    write(frame.image, file, options);
+                }
+                catch (const Glib::Error& e) {
+                    failure = Glib::ustring{e.what()}.raw();
+                }
+                catch (const std::exception& e) {
+                    failure = e.what();
+                }
+
+                // The frame goes before another can be rendered in its place
+                frame.image.reset();
+
+                lock.lock();
+                --framesInFlight;
+
+                if (!failure.empty() && error.empty())
+                    error = failure;
+                else if (failure.empty()) {
+                    writtenFiles.at(frame.index) = file;
+
+                    if (onPageWritten)
+                        onPageWritten(frame.index, file);
+                }
+
+                frameDone.notify_all();
+                continue;
+            }
+
+            if (isStopped()) {
+                framesInFlight -= static_cast<unsigned int>(rendered.size());
+                rendered.clear();
+                frameDone.notify_all();
+                break;
+            }
+
+            if (nextPage >= pages.size())
+                break;
+
+            const std::size_t index = nextPage++;
+            ++framesInFlight;
+            lock.unlock();
+
+            std::string failure;
+            Glib::RefPtr<Gdk::Pixbuf> image;
+
+            try {
+                image = PageRenderer{pages.at(index)}.renderAtResolution(options.dpi);
+            }
+            catch (const std::exception& e) {
+                failure = e.what();
+            }
+
+            lock.lock();
+
+            if (failure.empty()) {
+                rendered.push_back({index, std::move(image)});
+            }
+            else {
+                --framesInFlight;
+                if (error.empty())
+                    error = failure;
+            }
+
+            frameDone.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < numberOfThreads; ++i)
+        threads.emplace_back(worker);
+
+    worker();
+
+    for (std::thread& thread : threads)
+        thread.join();
+
+    if (!error.empty())
+        throw std::runtime_error(error);
+
+    writtenFiles.erase(std::remove(writtenFiles.begin(), writtenFiles.end(), Glib::RefPtr<Gio::File>{}),
+                       writtenFiles.end());
+
+    return writtenFiles;
+}
+
+} // namespace Slicer::ImageExport
@@ -0,0 +1,76 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef IMAGEEXPORT_HPP
+#define IMAGEEXPORT_HPP
+
+#include "page.hpp"
+#include <giomm/file.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace Slicer::ImageExport {
+
+enum class Format {
+    Png,
+    Jpeg,
+    WebP
+};
+
+// Also the extension of the files: "png", "jpg" and "webp"
+std::string formatName(Format format);
+// From formatName(), or "jpeg"
+std::optional<Format> formatFromName(const std::string& name);
+// WebP needs a gdk-pixbuf loader that isn't always installed
+bool canWrite(Format format);
+
+struct Options {
+    Format format = Format::Png;
+    double dpi = 150;
+    // From 0 to 100, for JPEG and WebP
+    int quality = 90;
+    // 0 for one per core
+    unsigned int numberOfThreads = 0;
+    // Rendered pages held at once, waiting to be written or being written,
+    // which bounds the memory an export takes. 0 for one per thread, which
+    // is enough to keep them all busy.
+    unsigned int maximumFramesInFlight = 0;
+};
+
+// Called from the thread that wrote the image, one call at a time
+using PageWrittenSlot = std::function<void(std::size_t index, const Glib::RefPtr<Gio::File>& file)>;
+
+// Renders pages at options.dpi and writes each one to destinationOfPage(its
+// index), on every thread at once. Each thread writes the pages rendered
+// before rendering more, so no more than options.maximumFramesInFlight are
+// ever waiting. Stops early when canceled is raised, and throws
+// std::runtime_error on the first page that can't be rendered or written,
+// once the other threads are done with theirs. Returns the files written,
+// in the order of pages.
+std::vector<Glib::RefPtr<Gio::File>> exportPages(const std::vector<Glib::RefPtr<const Page>>& pages,
+                                                 const std::function<Glib::RefPtr<Gio::File>(std::size_t)>& destinationOfPage,
+                                                 const Options& options,
+                                                 const PageWrittenSlot& onPageWritten = {},
+                                                 const std::shared_ptr<std::atomic<bool>>& canceled = {});
+
+} // namespace Slicer::ImageExport
+
+#endif // IMAGEEXPORT_HPP
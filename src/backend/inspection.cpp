@@ -0,0 +1,177 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "inspection.hpp"
+#include "cpuresources.hpp"
+#include "decryption.hpp"
+#include "document.hpp"
+#include "pageindex.hpp"
+#include "trace.hpp"
+#include <qpdf/QPDF.hh>
+#include <qpdf/QPDFExc.hh>
+#include <qpdf/QPDFPageDocumentHelper.hh>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+
+namespace Slicer::Inspection {
+
+// Page trees are shallow; more than this is a loop
+static const int maximumTreeDepth = 64;
+
+// US Letter, which poppler takes pages without a media box to be
+static const PageInfo defaultPage{612, 792, 0};
+
+static QPDFObjectHandle inheritedKey(QPDFObjectHandle node, const std::string& key)
+{
+    for (int depth = 0; depth < maximumTreeDepth && node.isDictionary(); ++depth) {
+        if (node.hasKey(key))
+            return node.getKey(key);
+
+        node = node.getKey("/Parent");
+    }
+
+    return QPDFObjectHandle::newNull();
+}
+
+static bool readBox(const QPDFObjectHandle& box, PageInfo& page)
+{
+    if (!box.isArray() || box.getArrayNItems() != 4)
+        return false;
+
+    for (int i = 0; i < 4; ++i)
+        if (!box.getArrayItem(i).isNumber())
+            return false;
+
+    page.width = static_cast<int>(std::abs(box.getArrayItem(2).getNumericValue() - box.getArrayItem(0).getNumericValue()));
+    page.height = static_cast<int>(std::abs(box.getArrayItem(3).getNumericValue() - box.getArrayItem(1).getNumericValue()));
+
+    return true;
+}
+
+static PageInfo pageInfoOf(QPDFPageObjectHelper& page)
+{
+    const QPDFObjectHandle object = page.getObjectHandle();
+    PageInfo info = defaultPage;
+
+    if (!readBox(inheritedKey(object, "/CropBox"), info))
+        readBox(inheritedKey(object, "/MediaBox"), info);
+
+    const QPDFObjectHandle rotate = inheritedKey(object, "/Rotate");
+    if (rotate.isInteger())
+        info.rotation = ((rotate.getIntValueAsInt() % 360) + 360) % 360;
+
+    return info;
+}
+
+static std::optional<FileInfo> fromIndex(const Glib::RefPtr<Gio::File>& file, const std::string& path)
+{
+    // Its key needs the content hash, which is a read of both ends of the file
+    if (!PageIndex::isEnabled() && PageIndex::memoryBudget() == 0)
+        return {};
+
+    const std::optional<std::vector<PageIndex::Entry>> entries
+        = PageIndex::load(Document::pageIndexKeyOf(file, Document::contentHashOf(path)));
+
+    if (!entries.has_value())
+        return {};
+
+    FileInfo info;
+    info.isFromIndex = true;
+    info.isEncrypted = Decryption::mayBeEncrypted(path);
+    info.pages.reserve(entries->size());
+
+    for (const PageIndex::Entry& entry : entries.value())
+        info.pages.push_back({entry.width, entry.height, entry.rotation});
+
+    return info;
+}
+
+FileInfo inspect(const Glib::RefPtr<Gio::File>& file)
+{
+    const Trace::Span span{"Inspection::inspect"};
+
+    const std::string path = file->get_path();
+    if (path.empty())
+        throw std::runtime_error("Only local files can be inspected: " + file->get_uri());
+
+    if (std::optional<FileInfo> indexed = fromIndex(file, path))
+        return indexed.value();
+
+    FileInfo info;
+    QPDF qpdf;
+    qpdf.setSuppressWarnings(true);
+
+    try {
+        qpdf.processFile(path.c_str());
+    }
+    catch (const QPDFExc& e) {
+        if (e.getErrorCode() != qpdf_e_password)
+            throw;
+
+        info.isEncrypted = true;
+        info.needsPassword = true;
+
+        return info;
+    }
+
+    info.isEncrypted = qpdf.isEncrypted();
+
+    std::vector<QPDFPageObjectHelper> pages = QPDFPageDocumentHelper{qpdf}.getAllPages();
+    info.pages.reserve(pages.size());
+
+    for (QPDFPageObjectHelper& page : pages)
+        info.pages.push_back(pageInfoOf(page));
+
+    return info;
+}
+
+std::vector<Result> inspectAll(const std::vector<Glib::RefPtr<Gio::File>>& files, unsigned int numberOfThreads)
+{
+    std::vector<Result> results(files.size());
+    std::atomic<std::size_t> next{0};
+
+    // Each file is a few reads, so every thread takes the next one when done
+    auto worker = [&files, &results, &next]() {
+        for (std::size_t i = next++; i < files.size(); i = next++) {
+            try {
+                results[i].info = inspect(files[i]);
+            }
+            catch (const std::exception& e) {
+                results[i].error = e.what();
+            }
+            catch (const Glib::Error& e) {
+                results[i].error = e.what();
+            }
+        }
+    };
+
+    const unsigned int threadCount = numberOfThreads == 0 ? CpuResources::availableCores() : numberOfThreads;
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < std::min<std::size_t>(threadCount, files.size()); ++i)
+        threads.emplace_back(worker);
+
+    worker();
+
+    for (std::thread& thread : threads)
+        thread.join();
+
+    return results;
+}
+}
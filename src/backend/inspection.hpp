@@ -0,0 +1,62 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef INSPECTION_HPP
+#define INSPECTION_HPP
+
+#include <giomm/file.h>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace Slicer::Inspection {
+
+// What deciding where a file goes needs to know about it, without opening
+// it as a Document: no snapshot, and no poppler. Comes from the page index
+// when it has the file, and otherwise from qpdf reading the trailer, the
+// cross-reference table and the page tree, never the page contents.
+
+struct PageInfo {
+    // In points, before rotations, from the crop box like a Page has them
+    int width;
+    int height;
+    // In degrees, as the file has it
+    int rotation;
+};
+
+struct FileInfo {
+    std::vector<PageInfo> pages;
+    bool isEncrypted = false;
+    // Encrypted with a user password: nothing else can be read then
+    bool needsPassword = false;
+    // Whether it came from the page index, without parsing the file
+    bool isFromIndex = false;
+};
+
+// Throws std::runtime_error, or whatever qpdf throws, if the file isn't a PDF it can read
+FileInfo inspect(const Glib::RefPtr<Gio::File>& file);
+
+struct Result {
+    // Empty when the file couldn't be inspected; error says why
+    std::optional<FileInfo> info;
+    std::string error;
+};
+
+// On up to numberOfThreads threads (0 for one per core), in the same order as the files
+std::vector<Result> inspectAll(const std::vector<Glib::RefPtr<Gio::File>>& files, unsigned int numberOfThreads);
+}
+
+#endif // INSPECTION_HPP
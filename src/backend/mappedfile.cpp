@@ -0,0 +1,117 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "mappedfile.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/vfs.h>
+#endif
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+namespace Slicer {
+
+namespace {
+    std::atomic<bool> isEnabled = true;
+
+    // PDF readers, qpdf and poppler alike, start with the trailer and the
+    // last cross-reference section at the end of the file
+    constexpr std::size_t tailSize = 1024 * 1024;
+}
+
+MappedFile::MappedFile(const std::string& path)
+{
+    const int descriptor = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (descriptor < 0)
+        throw std::runtime_error("Couldn't open " + path + ": " + std::strerror(errno));
+
+    struct stat status {};
+    if (::fstat(descriptor, &status) != 0 || status.st_size <= 0) {
+        ::close(descriptor);
+        throw std::runtime_error("Couldn't map " + path + ": empty or unreadable");
+    }
+
+    const auto size = static_cast<std::size_t>(status.st_size);
+    void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    const int mapError = errno;
+
+    // The mapping keeps its own reference to the file
+    ::close(descriptor);
+
+    if (data == MAP_FAILED)
+        throw std::runtime_error("Couldn't map " + path + ": " + std::strerror(mapError));
+
+    // After the tail, objects are read in whatever order they are needed,
+    // so readahead would mostly bring in pages nobody asked for
+    ::madvise(data, size, MADV_RANDOM);
+
+    const auto pageSize = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    const std::size_t tailStart = (size - std::min(size, tailSize)) / pageSize * pageSize;
+    ::madvise(static_cast<char*>(data) + tailStart, size - tailStart, MADV_WILLNEED);
+
+    m_data = static_cast<char*>(data);
+    m_size = size;
+}
+
+MappedFile::~MappedFile()
+{
+    ::munmap(m_data, m_size);
+}
+
+void MappedFile::setEnabled(bool enabled)
+{
+    isEnabled = enabled;
+}
+
+bool MappedFile::isUsableFor(const std::string& path)
+{
+    if (!isEnabled)
+        return false;
+
+#ifdef __linux__
+    struct statfs status {};
+    if (::statfs(path.c_str(), &status) != 0)
+        return false;
+
+    // NFS, SMB, CIFS, SMB2, FUSE (sshfs and the like), AFS, Ceph, Coda, NCP and 9P
+    static constexpr std::array<unsigned long, 10> networkFilesystems = {0x6969,
+                                                                         0x517B,
+                                                                         0xFF534D42,
+                                                                         0xFE534D42,
+                                                                         0x65735546,
+                                                                         0x5346414F,
+                                                                         0x00C36400,
+                                                                         0x73757245,
+                                                                         0x564C,
+                                                                         0x01021997};
+
+    const auto type = static_cast<unsigned long>(status.f_type);
+
+    return std::find(networkFilesystems.begin(), networkFilesystems.end(), type) == networkFilesystems.end();
+#else
+    // No way to tell network filesystems apart here
+    return false;
+#endif
+}
+
+} // namespace Slicer
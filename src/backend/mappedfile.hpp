@@ -0,0 +1,56 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+#include <cstddef>
+#include <string>
+
+namespace Slicer {
+
+// A whole file mapped read-only into memory, so that readers go straight to
+// the page cache instead of copying the file into buffers of their own.
+// Throws std::runtime_error if it can't be mapped, e.g. when it's empty.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&&) = delete;
+    MappedFile& operator=(MappedFile&&) = delete;
+
+    const char* data() const { return m_data; }
+    std::size_t size() const { return m_size; }
+
+    // On by default. Off, every file is read as a file.
+    static void setEnabled(bool enabled);
+    // Whether path should be mapped: mapping is on and the file is on a local
+    // filesystem. With network filesystems a read can fail after the mapping
+    // is made, and through a mapping that kills the process instead of
+    // returning an error.
+    static bool isUsableFor(const std::string& path);
+
+private:
+    char* m_data = nullptr;
+    std::size_t m_size = 0;
+};
+
+} // namespace Slicer
+
+#endif // MAPPEDFILE_HPP
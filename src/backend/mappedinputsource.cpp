@@ -0,0 +1,34 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "mappedinputsource.hpp"
+
+namespace Slicer {
+
+MappedBuffer::MappedBuffer(const std::string& path)
+    : m_file{path}
+    // Buffer only takes mutable memory, but BufferInputSource never writes to it
+    , m_buffer{reinterpret_cast<unsigned char*>(const_cast<char*>(m_file.data())), m_file.size()} //NOLINT
+{
+}
+
+MappedInputSource::MappedInputSource(const std::string& path)
+    : MappedBuffer{path}
+    , BufferInputSource{path, &m_buffer, false}
+{
+}
+
+} // namespace Slicer
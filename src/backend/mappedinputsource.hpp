@@ -0,0 +1,47 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef MAPPEDINPUTSOURCE_HPP
+#define MAPPEDINPUTSOURCE_HPP
+
+#include "mappedfile.hpp"
+#include <string>
+#include <qpdf/Buffer.hh>
+#include <qpdf/BufferInputSource.hh>
+
+namespace Slicer {
+
+// A mapped file, wrapped in a Buffer without copying it
+class MappedBuffer {
+protected:
+    explicit MappedBuffer(const std::string& path);
+
+    MappedFile m_file;
+    Buffer m_buffer;
+};
+
+// Lets QPDF read a file straight from the page cache, instead of through
+// stdio, which keeps a second copy of everything read in its own buffers.
+// The mapping is a base so that it's there before the buffer source is
+// built on it, and still there until it's gone.
+class MappedInputSource : private MappedBuffer, public BufferInputSource {
+public:
+    explicit MappedInputSource(const std::string& path);
+};
+
+} // namespace Slicer
+
+#endif // MAPPEDINPUTSOURCE_HPP
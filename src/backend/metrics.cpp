@@ -0,0 +1,376 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "metrics.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <utility>
+
+namespace Slicer::Metrics {
+
+namespace {
+    std::array<std::atomic<std::uint64_t>, numberOfCounters> counters{};
+
+    std::size_t indexOf(Counter counter)
+    {
+        return static_cast<std::size_t>(counter);
+    }
+
+    std::array<std::array<std::atomic<std::uint64_t>, Histogram::numberOfBuckets>, numberOfLatencies> latencies{};
+
+    const std::array<const char*, numberOfLatencies> latencyNames{"Open to first thumbnail",
+                                                                  "Selection handled",
+                                                                  "Zoom to sharp thumbnails",
+                                                                  "Save"};
+
+    // Signed, as a charge may be released on another thread before it's seen taken
+    std::array<std::atomic<std::int64_t>, numberOfMemories> memories{};
+
+    const std::array<const char*, numberOfMemories> memoryNames{"Thumbnails",
+                                                                "Widget thumbnails",
+                                                                "Pages",
+                                                                "Poppler documents",
+                                                                "Save files",
+                                                                "Undo history"};
+
+    void charge(Memory memory, std::int64_t bytes)
+    {
+        memories.at(static_cast<std::size_t>(memory)).fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    // Page costs are recorded once per page load or render, far less often
+    // than counters, so a lock does
+    std::mutex pageCostsMutex;
+    std::map<std::pair<std::string, unsigned int>, PageCost> pageCosts;
+
+    std::chrono::microseconds toMicroseconds(std::chrono::steady_clock::duration duration)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(duration);
+    }
+
+    bool isSlower(const PageCost& a, const PageCost& b)
+    {
+        return a.creation + a.render > b.creation + b.render;
+    }
+
+    // Called with the lock held
+    PageCost& pageCostOf(const std::string& filePath, unsigned int indexInFile)
+    {
+        if (pageCosts.size() >= maximumTrackedPages && pageCosts.count({filePath, indexInFile}) == 0) {
+            std::vector<PageCost> costs;
+            costs.reserve(pageCosts.size());
+            for (const auto& [key, cost] : pageCosts)
+                costs.push_back(cost);
+
+            const auto middle = costs.begin() + static_cast<std::ptrdiff_t>(costs.size() / 2);
+            std::nth_element(costs.begin(), middle, costs.end(), isSlower);
+
+            pageCosts.clear();
+            for (auto it = costs.begin(); it != middle; ++it)
+                pageCosts.emplace(std::make_pair(it->filePath, it->indexInFile), std::move(*it));
+        }
+
+        PageCost& cost = pageCosts[{filePath, indexInFile}];
+        cost.filePath = filePath;
+        cost.indexInFile = indexInFile;
+
+        return cost;
+    }
+}
+
+void add(Counter counter, std::uint64_t amount)
+{
+    counters.at(indexOf(counter)).fetch_add(amount, std::memory_order_relaxed);
+}
+
+std::uint64_t Snapshot::operator[](Counter counter) const
+{
+    return values.at(indexOf(counter));
+}
+
+Snapshot snapshot()
+{
+    Snapshot result;
+    result.time = std::chrono::steady_clock::now();
+
+    for (std::size_t i = 0; i < numberOfCounters; ++i)
+        result.values.at(i) = counters.at(i).load(std::memory_order_relaxed);
+
+    return result;
+}
+
+std::string describe(const Snapshot& earlier, const Snapshot& later)
+{
+    const double seconds = std::chrono::duration<double>(later.time - earlier.time).count();
+    const auto delta = [&](Counter counter) { return later[counter] - earlier[counter]; };
+    const auto perSecond = [&](Counter counter) {
+        return seconds > 0 ? static_cast<double>(delta(counter)) / seconds : 0.0;
+    };
+
+    const std::uint64_t lookups = delta(Counter::ThumbnailCacheHits) + delta(Counter::ThumbnailCacheMisses);
+    const double hitRate = lookups > 0 ? 100.0 * static_cast<double>(delta(Counter::ThumbnailCacheHits)) / static_cast<double>(lookups)
+                                       : 0.0;
+
+    const double savedMegabytes = static_cast<double>(delta(Counter::BytesSaved)) / (1024.0 * 1024.0);
+    const double saveSeconds = static_cast<double>(delta(Counter::SaveMilliseconds)) / 1000.0;
+    const double saveThroughput = saveSeconds > 0 ? savedMegabytes / saveSeconds : 0.0;
+
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1)
+        << "Pages rendered: " << delta(Counter::PagesRendered)
+        << " (" << perSecond(Counter::PagesRendered) << "/s)\n"
+        << "Thumbnail cache hit rate: " << hitRate << "% of " << lookups << "\n"
+        << "Tasks canceled: " << delta(Counter::TasksCanceled)
+        << " (" << perSecond(Counter::TasksCanceled) << "/s)\n"
+        << "Files saved: " << delta(Counter::FilesSaved)
+        << " (" << savedMegabytes << " MB at " << saveThroughput << " MB/s)";
+
+    return out.str();
+}
+
+void record(Latency latency, std::chrono::steady_clock::duration duration)
+{
+    const auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+    const std::size_t bucket = Histogram::bucketOf(static_cast<std::uint64_t>(std::max<decltype(microseconds)>(microseconds, 0)));
+
+    latencies.at(static_cast<std::size_t>(latency)).at(bucket).fetch_add(1, std::memory_order_relaxed);
+
+    // Also in the trace, ending now, to line it up with the spans around it
+    if (Trace::isEnabled()) {
+        const Trace::Clock::time_point now = Trace::Clock::now();
+        Trace::record(latencyNames.at(static_cast<std::size_t>(latency)), now - duration, now);
+    }
+}
+
+std::size_t Histogram::bucketOf(std::uint64_t microseconds)
+{
+    // Values below 2^(subBucketBits + 1) get a bucket each. Above, every
+    // power of two is split in 2^subBucketBits buckets, by the bits under the top one.
+    std::uint64_t magnitude = 0;
+    while ((microseconds >> magnitude) >= (2U << subBucketBits))
+        ++magnitude;
+
+    const std::size_t bucket = (magnitude << subBucketBits) + (microseconds >> magnitude);
+
+    return std::min(bucket, numberOfBuckets - 1);
+}
+
+std::uint64_t Histogram::lowestValueOf(std::size_t bucket)
+{
+    const std::size_t magnitude = bucket < (2U << subBucketBits) ? 0 : (bucket >> subBucketBits) - 1;
+
+    return static_cast<std::uint64_t>(bucket - (magnitude << subBucketBits)) << magnitude;
+}
+
+std::uint64_t Histogram::numberOfSamples() const
+{
+    std::uint64_t total = 0;
+    for (std::uint64_t count : counts)
+        total += count;
+
+    return total;
+}
+
+double Histogram::quantile(double fraction) const
+{
+    const std::uint64_t total = numberOfSamples();
+    if (total == 0)
+        return 0;
+
+    // The rank of the sample the quantile is, counting from one
+    const auto rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(fraction * static_cast<double>(total))));
+    std::uint64_t seen = 0;
+
+    for (std::size_t bucket = 0; bucket < numberOfBuckets; ++bucket) {
+        seen += counts.at(bucket);
+
+        if (seen >= rank) {
+            const auto low = static_cast<double>(lowestValueOf(bucket));
+            const auto high = static_cast<double>(bucket + 1 < numberOfBuckets ? lowestValueOf(bucket + 1) : lowestValueOf(bucket) + 1);
+
+            return (low + high) / 2;
+        }
+    }
+
+    return static_cast<double>(lowestValueOf(numberOfBuckets - 1));
+}
+
+Histogram histogram(Latency latency)
+{
+    Histogram result;
+    const auto& buckets = latencies.at(static_cast<std::size_t>(latency));
+
+    for (std::size_t i = 0; i < Histogram::numberOfBuckets; ++i)
+        result.counts.at(i) = buckets.at(i).load(std::memory_order_relaxed);
+
+    return result;
+}
+
+std::string describeLatencies()
+{
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1);
+
+    for (std::size_t i = 0; i < numberOfLatencies; ++i) {
+        const Histogram samples = histogram(static_cast<Latency>(i));
+        if (samples.numberOfSamples() == 0)
+            continue;
+
+        const auto milliseconds = [&samples](double fraction) { return samples.quantile(fraction) / 1000.0; };
+
+        if (out.tellp() > 0)
+            out << "\n";
+
+        out << latencyNames.at(i) << ": " << samples.numberOfSamples() << " times, "
+            << "p50 " << milliseconds(0.5) << " ms, "
+            << "p90 " << milliseconds(0.9) << " ms, "
+            << "p99 " << milliseconds(0.99) << " ms, "
+            << "max " << milliseconds(1.0) << " ms";
+    }
+
+    return out.str();
+}
+
+std::uint64_t bytesHeld(Memory memory)
+{
+    const std::int64_t bytes = memories.at(static_cast<std::size_t>(memory)).load(std::memory_order_relaxed);
+
+    return static_cast<std::uint64_t>(std::max<std::int64_t>(bytes, 0));
+}
+
+MemoryCharge::MemoryCharge(Memory memory, std::size_t bytes)
+    : m_memory{memory}
+{
+    set(bytes);
+}
+
+MemoryCharge::MemoryCharge(MemoryCharge&& src) noexcept
+    : m_memory{src.m_memory}
+    , m_bytes{src.m_bytes}
+{
+    src.m_bytes = 0;
+}
+
+MemoryCharge& MemoryCharge::operator=(MemoryCharge&& src) noexcept
+{
+    if (this != &src) {
+        set(0);
+        m_memory = src.m_memory;
+        m_bytes = src.m_bytes;
+        src.m_bytes = 0;
+    }
+
+    return *this;
+}
+
+MemoryCharge::~MemoryCharge()
+{
+    set(0);
+}
+
+void MemoryCharge::set(std::size_t bytes)
+{
+    charge(m_memory, static_cast<std::int64_t>(bytes) - static_cast<std::int64_t>(m_bytes));
+    m_bytes = bytes;
+}
+
+std::string describeMemory()
+{
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1);
+
+    for (std::size_t i = 0; i < numberOfMemories; ++i) {
+        if (i > 0)
+            out << "\n";
+
+        out << memoryNames.at(i) << ": "
+            << static_cast<double>(bytesHeld(static_cast<Memory>(i))) / (1024.0 * 1024.0) << " MB";
+    }
+
+    return out.str();
+}
+
+void recordPageCreation(const std::string& filePath,
+                        unsigned int indexInFile,
+                        std::chrono::steady_clock::duration duration)
+{
+    const std::lock_guard<std::mutex> lock{pageCostsMutex};
+    PageCost& cost = pageCostOf(filePath, indexInFile);
+
+    cost.creation = std::max(cost.creation, toMicroseconds(duration));
+}
+
+void recordPageRender(const std::string& filePath,
+                      unsigned int indexInFile,
+                      std::chrono::steady_clock::duration duration,
+                      std::size_t outputBytes)
+{
+    const std::lock_guard<std::mutex> lock{pageCostsMutex};
+    PageCost& cost = pageCostOf(filePath, indexInFile);
+
+    ++cost.numberOfRenders;
+    cost.render = std::max(cost.render, toMicroseconds(duration));
+    cost.outputBytes = std::max(cost.outputBytes, outputBytes);
+}
+
+std::vector<PageCost> slowestPages(std::size_t count)
+{
+    std::vector<PageCost> costs;
+
+    {
+        const std::lock_guard<std::mutex> lock{pageCostsMutex};
+        costs.reserve(pageCosts.size());
+
+        for (const auto& [key, cost] : pageCosts)
+            costs.push_back(cost);
+    }
+
+    count = std::min(count, costs.size());
+    std::partial_sort(costs.begin(), costs.begin() + static_cast<std::ptrdiff_t>(count), costs.end(), isSlower);
+    costs.resize(count);
+
+    return costs;
+}
+
+std::string describeSlowestPages(std::size_t count)
+{
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1);
+
+    for (const PageCost& cost : slowestPages(count)) {
+        if (out.tellp() > 0)
+            out << "\n";
+
+        out << cost.filePath << ", page " << cost.indexInFile + 1 << ": "
+            << static_cast<double>(cost.creation.count()) / 1000.0 << " ms to create, "
+            << static_cast<double>(cost.render.count()) / 1000.0 << " ms to render";
+
+        if (cost.numberOfRenders > 0)
+            out << " (" << cost.numberOfRenders << " times, up to "
+                << static_cast<double>(cost.outputBytes) / 1024.0 << " KB)";
+    }
+
+    return out.str();
+}
+
+} // namespace Slicer::Metrics
@@ -0,0 +1,181 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Slicer::Metrics {
+
+// Counters of what the application has been doing, for telling where a
+// slow session goes without a profiler. They only ever go up; rates come
+// from the difference between two snapshots. Safe to add to from any thread.
+
+enum class Counter {
+    PagesRendered,
+    ThumbnailCacheHits,
+    ThumbnailCacheMisses,
+    TasksCanceled,
+    FilesSaved,
+    BytesSaved,
+    SaveMilliseconds,
+};
+
+constexpr std::size_t numberOfCounters = 7;
+
+void add(Counter counter, std::uint64_t amount = 1);
+
+struct Snapshot {
+    std::chrono::steady_clock::time_point time;
+    std::array<std::uint64_t, numberOfCounters> values{};
+
+    std::uint64_t operator[](Counter counter) const;
+};
+
+Snapshot snapshot();
+
+// What happened between the two, one "name: value" line per counter, with
+// rates per second, the cache hit rate and the save throughput
+std::string describe(const Snapshot& earlier, const Snapshot& later);
+
+// How long the user waits for what they asked, from the input to what they
+// see. Each is a histogram of log-linear buckets, as in HdrHistogram: 16 per
+// power of two, so any value is within about 6% of its bucket. Recording is
+// lock-free, and memory is the same however many samples go in. Since startup.
+
+enum class Latency {
+    OpenToFirstThumbnail,
+    SelectionHandled,
+    ZoomToSharpThumbnails,
+    Save,
+};
+
+constexpr std::size_t numberOfLatencies = 4;
+
+// Also recorded as a trace span, named as in describeLatencies(), while tracing
+void record(Latency latency, std::chrono::steady_clock::duration duration);
+
+struct Histogram {
+    static constexpr unsigned int subBucketBits = 4;
+    // Up to 2^40 microseconds, twelve days, which nothing takes
+    static constexpr std::size_t numberOfBuckets = (40 - subBucketBits + 1) << subBucketBits;
+
+    std::array<std::uint64_t, numberOfBuckets> counts{};
+
+    std::uint64_t numberOfSamples() const;
+    // In microseconds, from the middle of the bucket the quantile falls in
+    double quantile(double fraction) const;
+    double maximum() const { return quantile(1.0); }
+
+    static std::size_t bucketOf(std::uint64_t microseconds);
+    static std::uint64_t lowestValueOf(std::size_t bucket);
+};
+
+Histogram histogram(Latency latency);
+
+// One line per latency with samples: how many, and their p50, p90, p99 and maximum
+std::string describeLatencies();
+
+// Bytes held by each part of the application, for telling what a session
+// that grew big is made of. Estimates from the sizes each part knows about,
+// not from the allocator: poppler and QPDF don't say what they allocate.
+// Unlike counters, they go down as memory is released.
+
+enum class Memory {
+    // Pixels in the thumbnail caches, both tiers
+    Thumbnails,
+    // The copies widgets draw, stretched or on the window's surface
+    WidgetThumbnails,
+    // Every Page, wherever it's held, and the rows of the page lists
+    Pages,
+    // Poppler documents, counted at the size of their file
+    PopplerDocuments,
+    // Files QPDF has open for a save, or keeps parsed for the next one
+    SaveFiles,
+    UndoHistory,
+};
+
+constexpr std::size_t numberOfMemories = 6;
+
+std::uint64_t bytesHeld(Memory memory);
+
+// Holds bytes of a kind for as long as it lives, so owners only say how
+// much they take now. Safe to use from any thread, one at a time.
+class MemoryCharge {
+public:
+    explicit MemoryCharge(Memory memory, std::size_t bytes = 0);
+
+    MemoryCharge(const MemoryCharge&) = delete;
+    MemoryCharge& operator=(const MemoryCharge&) = delete;
+    MemoryCharge(MemoryCharge&& src) noexcept;
+    MemoryCharge& operator=(MemoryCharge&& src) noexcept;
+
+    ~MemoryCharge();
+
+    void set(std::size_t bytes);
+    std::size_t bytes() const { return m_bytes; }
+
+private:
+    Memory m_memory;
+    std::size_t m_bytes = 0;
+};
+
+// One "name: megabytes" line per kind
+std::string describeMemory();
+
+// The pages that cost the most, for telling which ones make a document slow,
+// and why: poppler reading the page, rasterizing it, or how big it comes
+// out. Keyed by file and index in file, so that a page can be sent upstream
+// or flattened ahead. Only the slowest pages seen are kept. Since startup.
+
+struct PageCost {
+    std::string filePath;
+    unsigned int indexInFile = 0;
+    unsigned int numberOfRenders = 0;
+    // The slowest of each, and the largest output: a page that was slow
+    // once is slow, whatever the caches did for it since
+    std::chrono::microseconds creation{0};
+    std::chrono::microseconds render{0};
+    std::size_t outputBytes = 0;
+};
+
+// How long poppler took to create the page, from a file it has open
+void recordPageCreation(const std::string& filePath,
+                        unsigned int indexInFile,
+                        std::chrono::steady_clock::duration duration);
+void recordPageRender(const std::string& filePath,
+                      unsigned int indexInFile,
+                      std::chrono::steady_clock::duration duration,
+                      std::size_t outputBytes);
+
+// By their slowest creation and render together, slowest first
+std::vector<PageCost> slowestPages(std::size_t count);
+
+// One line per page, empty before any was recorded
+std::string describeSlowestPages(std::size_t count = 10);
+
+// Past it, the faster half is forgotten
+constexpr std::size_t maximumTrackedPages = 8192;
+
+} // namespace Slicer::Metrics
+
+#endif // METRICS_HPP
@@ -15,101 +15,92 @@
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "page.hpp"
-#include <cmath>
+#include "sourcefile.hpp"
 
 namespace Slicer {
 
-Page::Page(std::unique_ptr<poppler::page> ppage,
-           const Glib::ustring& fileName,
-           unsigned int fileNumber,
-           unsigned int pageNumber)
-    : m_fileNumber{fileNumber}
-    , m_ppage{std::move(ppage)}
-    , m_fileName{fileName}
-    , m_indexInFile{pageNumber}
-    , m_indexInDocument{m_indexInFile}
+Page::Size Page::sizeOf(const poppler::page& ppage)
 {
-    switch (m_ppage->orientation()) {
+    const poppler::rectf rectangle = ppage.page_rect();
+
+    return {static_cast<int>(rectangle.width()), static_cast<int>(rectangle.height())};
+}
+
+int Page::rotationOf(const poppler::page& ppage)
+{
+    switch (ppage.orientation()) {
     case poppler::page::orientation_enum::portrait:
-        m_sourceRotation = m_currentRotation = 0;
-        break;
+        return 0;
     case poppler::page::orientation_enum::landscape:
-        m_sourceRotation = m_currentRotation = 90;
-        break;
+        return 90;
     case poppler::page::orientation_enum::upside_down:
-        m_sourceRotation = m_currentRotation = 180;
-        break;
+        return 180;
     case poppler::page::orientation_enum::seascape:
-        m_sourceRotation = m_currentRotation = 270;
-        break;
+        return 270;
     }
-}
 
-const Glib::ustring& Page::fileName() const
-{
-    return m_fileName;
+    return 0;
 }
 
-unsigned int Page::indexInFile() const
+Page::Page(const poppler::page& ppage,
+           const Glib::ustring& fileName,
+           const std::shared_ptr<const SourceFile>& sourceFile,
+           const std::string& fileHash,
+           unsigned int fileNumber,
+           unsigned int pageNumber)
+    : Page{sizeOf(ppage), rotationOf(ppage), fileName, sourceFile, fileHash, fileNumber, pageNumber}
 {
-    return m_indexInFile;
 }
 
-unsigned int Page::getDocumentIndex() const
+Page::Page(Size size,
+           int sourceRotation,
+           const Glib::ustring& fileName,
+           const std::shared_ptr<const SourceFile>& sourceFile,
+           const std::string& fileHash,
+           unsigned int fileNumber,
+           unsigned int pageNumber)
+    : m_fileNumber{fileNumber}
+    , m_fileName{fileName}
+    , m_sourceFile{sourceFile}
+    , m_filePath{sourceFile->path()}
+    , m_fileHash{fileHash}
+    , m_indexInFile{pageNumber}
+    , m_indexInDocument{m_indexInFile}
+    , m_size{size}
+    , m_sourceRotation{sourceRotation}
+    , m_currentRotation{sourceRotation}
 {
-    return m_indexInDocument;
+    m_memoryCharge.set(sizeInBytes());
 }
 
-Page::Size Page::size() const
+const Glib::ustring& Page::fileName() const
 {
-    poppler::rectf rectangle = m_ppage->page_rect();
-
-    return {static_cast<int>(rectangle.width()), static_cast<int>(rectangle.height())};
+    return m_fileName;
 }
 
-Page::Size Page::rotatedSize() const
+const std::string& Page::filePath() const
 {
-    Size size = this->size();
-
-    if (std::abs((m_currentRotation / 90) % 2) != 0)
-        std::swap(size.width, size.height);
-
-    return size;
+    return m_filePath;
 }
 
-Page::Size scaleSize(Page::Size sourceSize, int targetSize)
+const std::string& Page::fileHash() const
 {
-    Page::Size scaledSize{};
-
-    if (sourceSize.height > sourceSize.width) {
-        scaledSize.height = targetSize;
-        const double ratioFactor = static_cast<double>(sourceSize.width) / sourceSize.height;
-        scaledSize.width = static_cast<int>(floor(targetSize * ratioFactor));
-    }
-    else {
-        scaledSize.width = targetSize;
-        const double ratioFactor = static_cast<double>(sourceSize.height) / sourceSize.width;
-        scaledSize.height = static_cast<int>(floor(targetSize * ratioFactor));
-    }
-
-    return scaledSize;
+    return m_fileHash;
 }
 
-Page::Size Page::scaledSize(int targetSize) const
+const SourceFile& Page::sourceFile() const
 {
-    return scaleSize(size(), targetSize);
+    return *m_sourceFile;
 }
 
-Page::Size Page::scaledRotatedSize(int targetSize) const
+unsigned int Page::indexInFile() const
 {
-    return scaleSize(rotatedSize(), targetSize);
+    return m_indexInFile;
 }
 
-void Page::setDocumentIndex(unsigned int newIndex)
+unsigned int Page::getDocumentIndex() const
 {
-    m_indexInDocument = newIndex;
-
-    indexChanged.emit();
+    return m_indexInDocument;
 }
 
 void Page::rotateRight()
@@ -128,6 +119,16 @@ void Page::rotateLeft()
         m_currentRotation -= 90;
 }
 
+std::size_t Page::sizeInBytes() const
+{
+    return sizeof(Page) + m_fileName.bytes() + m_filePath.capacity() + m_fileHash.capacity();
+}
+
+void Page::rotateBy(int quarterTurns)
+{
+    m_currentRotation = (((m_currentRotation + 90 * quarterTurns) % 360) + 360) % 360;
+}
+
 int Page::sortFunction(const Page& a, const Page& b)
 {
     const unsigned int aPosition = a.getDocumentIndex();
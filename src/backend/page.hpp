@@ -17,12 +17,18 @@
 #ifndef PAGE_HPP
 #define PAGE_HPP
 
+#include "metrics.hpp"
 #include <glibmm/object.h>
 #include <gdkmm/pixbuf.h>
 #include <poppler/cpp/poppler-page.h>
+#include <cstdint>
+#include <memory>
+#include <optional>
 
 namespace Slicer {
 
+class SourceFile;
+
 class Page : public Glib::Object {
 public:
     struct Size {
@@ -30,26 +36,64 @@ public:
         int height;
     };
 
-    Page(std::unique_ptr<poppler::page> ppage,
+    // Only reads what it needs from ppage, which can be dropped afterwards.
+    // Renders get their own poppler::page through PopplerHandles.
+    // Keeps sourceFile alive for as long as the page exists.
+    Page(const poppler::page& ppage,
+         const Glib::ustring& fileName,
+         const std::shared_ptr<const SourceFile>& sourceFile,
+         const std::string& fileHash,
+         unsigned int fileNumber,
+         unsigned int pageNumber);
+    // From what was read from poppler before, see PageIndex
+    Page(Size size,
+         int sourceRotation,
          const Glib::ustring& fileName,
+         const std::shared_ptr<const SourceFile>& sourceFile,
+         const std::string& fileHash,
          unsigned int fileNumber,
          unsigned int pageNumber);
 
     const Glib::ustring& fileName() const;
+    const std::string& filePath() const;
+    // Identifies the contents of the source file, across sessions
+    const std::string& fileHash() const;
+    const SourceFile& sourceFile() const;
     unsigned int indexInFile() const;
     unsigned int getDocumentIndex() const;
+    // What keeping this page around costs, for the undo history
+    std::size_t sizeInBytes() const;
     int sourceRotation() const { return m_sourceRotation; }
     int currentRotation() const { return m_currentRotation; }
-    Size size() const;
-    Size rotatedSize() const;
-    Size scaledSize(int targetSize) const;
-    Size scaledRotatedSize(int targetSize) const;
-
-    void setDocumentIndex(unsigned int newIndex);
+    // See RenderCost. Zero when it isn't known.
+    std::uint32_t renderCost() const { return m_renderCost; }
+    void setRenderCost(std::uint32_t cost) { m_renderCost = cost; }
+    // The row of its PageListModel, which may make another Page for it once
+    // this one is gone. Zero until the page is in one.
+    std::uint64_t listKey() const { return m_listKey; }
+    void setListKey(std::uint64_t key) { m_listKey = key; }
+
+    // All plain data captured at load time, cheap enough for every layout pass
+    Size size() const { return m_size; }
+    Size rotatedSize() const { return rotateSize(m_size, m_currentRotation); }
+    Size scaledSize(int targetSize) const { return scaleSize(size(), targetSize); }
+    Size scaledRotatedSize(int targetSize) const { return scaleSize(rotatedSize(), targetSize); }
+
+    // Fits the longest side to targetSize, keeping the aspect ratio
+    static constexpr Size scaleSize(Size sourceSize, int targetSize);
+    static constexpr Size rotateSize(Size sourceSize, int rotation);
+    // What the constructor reads from poppler
+    static Size sizeOf(const poppler::page& ppage);
+    static int rotationOf(const poppler::page& ppage);
+
+    // Doesn't notify anyone. Document renumbers pages in bulk and
+    // emits a single Document::pagesRenumbered for the whole batch.
+    void setDocumentIndex(unsigned int newIndex) { m_indexInDocument = newIndex; }
     void rotateRight();
     void rotateLeft();
+    // Right for positive turns, left for negative ones
+    void rotateBy(int quarterTurns);
 
-    sigc::signal<void> indexChanged;
     const unsigned int m_fileNumber;
 
     static int sortFunction(const Page& a, const Page& b);
@@ -57,16 +101,45 @@ public:
                             const Glib::RefPtr<const Page>& b);
 
 private:
-    std::unique_ptr<poppler::page> m_ppage;
     const Glib::ustring m_fileName;
+    const std::shared_ptr<const SourceFile> m_sourceFile;
+    const std::string m_filePath;
+    const std::string m_fileHash;
     const unsigned int m_indexInFile;
     unsigned int m_indexInDocument;
+    Size m_size;
     int m_sourceRotation;
     int m_currentRotation;
-
-    friend class PageRenderer; // For access to m_ppage
+    std::uint32_t m_renderCost = 0;
+    std::uint64_t m_listKey = 0;
+    Metrics::MemoryCharge m_memoryCharge{Metrics::Memory::Pages};
 };
 
+constexpr Page::Size Page::scaleSize(Size sourceSize, int targetSize)
+{
+    if (sourceSize.width <= 0 || sourceSize.height <= 0)
+        return {targetSize, targetSize};
+
+    // Integer math rounds down like the floor() it replaces, without going through a double
+    if (sourceSize.height > sourceSize.width)
+        return {static_cast<int>(static_cast<long long>(targetSize) * sourceSize.width / sourceSize.height),
+                targetSize};
+
+    return {targetSize,
+            static_cast<int>(static_cast<long long>(targetSize) * sourceSize.height / sourceSize.width)};
+}
+
+constexpr Page::Size Page::rotateSize(Size sourceSize, int rotation)
+{
+    if ((rotation / 90) % 2 != 0)
+        return {sourceSize.height, sourceSize.width};
+
+    return sourceSize;
+}
+
+static_assert(Page::scaleSize({600, 800}, 200).width == 150);
+static_assert(Page::rotateSize({600, 800}, 270).width == 800);
+
 struct pageComparator {
     int operator()(const Glib::RefPtr<const Page>& a,
                    const Glib::RefPtr<const Page>& b);
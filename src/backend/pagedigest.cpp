@@ -0,0 +1,179 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "pagedigest.hpp"
+#include "mappedinputsource.hpp"
+#include <qpdf/DLL.h>
+#include <qpdf/QPDF.hh>
+#include <qpdf/QPDFPageDocumentHelper.hh>
+#include <qpdf/QPDFXRefEntry.hh>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace Slicer::PageDigest {
+
+namespace {
+    // Links to other pages and to the page tree don't change how a page
+    // looks, and following them would sum up the other pages as well
+    const std::unordered_set<std::string> skippedKeys = {"/Parent", "/P", "/Dest", "/A", "/B"};
+
+    // FNV-1a, a byte at a time
+    class Hash {
+    public:
+        void add(std::uint64_t value)
+        {
+            for (int byte = 0; byte < 8; ++byte) {
+                m_value ^= (value >> (byte * 8)) & 0xff; //NOLINT
+                m_value *= 0x100000001b3;
+            }
+        }
+
+        std::uint64_t value() const { return m_value; }
+
+    private:
+        std::uint64_t m_value = 0xcbf29ce484222325;
+    };
+
+    void openFile(QPDF& qpdf, const std::string& filePath)
+    {
+        qpdf.setSuppressWarnings(true);
+
+        std::unique_ptr<MappedInputSource> source;
+        if (MappedFile::isUsableFor(filePath)) {
+            try {
+                source = std::make_unique<MappedInputSource>(filePath);
+            }
+            catch (const std::runtime_error&) {
+                // Read through stdio then
+            }
+        }
+
+        if (source != nullptr) {
+#if defined(QPDF_MAJOR_VERSION) && QPDF_MAJOR_VERSION >= 11
+            qpdf.processInputSource(std::shared_ptr<InputSource>{std::move(source)});
+#else
+            qpdf.processInputSource(PointerHolder<InputSource>{source.release()});
+#endif
+        }
+        else {
+            qpdf.processFile(filePath.c_str());
+        }
+    }
+
+    std::uint64_t digestOf(QPDFObjectHandle page, const std::map<QPDFObjGen, QPDFXRefEntry>& xrefTable)
+    {
+        Hash hash;
+        std::set<QPDFObjGen> visited;
+        std::vector<QPDFObjectHandle> pending{page};
+
+        // Depth first with a stack of our own, since object graphs can be deep
+        while (!pending.empty()) {
+            QPDFObjectHandle object = pending.back();
+            pending.pop_back();
+
+            if (object.isIndirect()) {
+                const QPDFObjGen objGen = object.getObjGen();
+                if (!visited.insert(objGen).second)
+                    continue;
+
+                hash.add(static_cast<std::uint64_t>(objGen.getObj()));
+                hash.add(static_cast<std::uint64_t>(objGen.getGen()));
+
+                if (const auto entry = xrefTable.find(objGen); entry != xrefTable.end()) {
+                    hash.add(static_cast<std::uint64_t>(entry->second.getType()));
+                    if (entry->second.getType() == 1) {
+                        hash.add(static_cast<std::uint64_t>(entry->second.getOffset()));
+                    }
+                    else if (entry->second.getType() == 2) {
+                        hash.add(static_cast<std::uint64_t>(entry->second.getObjStreamNumber()));
+                        hash.add(static_cast<std::uint64_t>(entry->second.getObjStreamIndex()));
+                    }
+                }
+            }
+
+            if (object.isStream())
+                object = object.getDict();
+
+            if (object.isDictionary()) {
+                for (const std::string& key : object.getKeys()) {
+                    if (skippedKeys.count(key) == 0)
+                        pending.push_back(object.getKey(key));
+                }
+            }
+            else if (object.isArray()) {
+                for (int i = object.getArrayNItems() - 1; i >= 0; --i)
+                    pending.push_back(object.getArrayItem(i));
+            }
+        }
+
+        return hash.value();
+    }
+}
+
+std::vector<std::uint64_t> compute(const std::string& filePath)
+{
+    try {
+        QPDF qpdf;
+        openFile(qpdf, filePath);
+
+        const std::map<QPDFObjGen, QPDFXRefEntry> xrefTable = qpdf.getXRefTable();
+        std::vector<std::uint64_t> digests;
+
+        for (QPDFPageObjectHelper& page : QPDFPageDocumentHelper{qpdf}.getAllPages())
+            digests.push_back(digestOf(page.getObjectHandle(), xrefTable));
+
+        return digests;
+    }
+    catch (const std::exception& error) {
+        throw std::runtime_error(std::string{"Couldn't read the pages of the file: "} + error.what());
+    }
+}
+
+bool Changes::isEmpty() const
+{
+    return changedPages.empty() && numberOfPagesBefore == numberOfPagesAfter;
+}
+
+unsigned int Changes::numberOfAddedPages() const
+{
+    return numberOfPagesAfter > numberOfPagesBefore ? numberOfPagesAfter - numberOfPagesBefore : 0;
+}
+
+unsigned int Changes::numberOfRemovedPages() const
+{
+    return numberOfPagesBefore > numberOfPagesAfter ? numberOfPagesBefore - numberOfPagesAfter : 0;
+}
+
+Changes compare(const std::vector<std::uint64_t>& before, const std::vector<std::uint64_t>& after)
+{
+    Changes changes;
+    changes.numberOfPagesBefore = static_cast<unsigned int>(before.size());
+    changes.numberOfPagesAfter = static_cast<unsigned int>(after.size());
+
+    const std::size_t numberOfCommonPages = std::min(before.size(), after.size());
+    for (std::size_t i = 0; i < numberOfCommonPages; ++i) {
+        if (before.at(i) != after.at(i))
+            changes.changedPages.push_back(static_cast<unsigned int>(i));
+    }
+
+    return changes;
+}
+
+} // namespace Slicer::PageDigest
@@ -0,0 +1,56 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PAGEDIGEST_HPP
+#define PAGEDIGEST_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Slicer {
+
+// Tells which pages of a file changed between two versions of it, without
+// rendering or comparing their contents. Writers that add to a file, like
+// scanners appending pages, do it with incremental updates: the objects of
+// the pages they don't touch keep their place in the file. So a page is
+// summed up by where each object it draws from is stored. Rewriting the
+// whole file moves everything, and then every page reads as changed.
+namespace PageDigest {
+
+    // One digest per page, in the order of the file, read with QPDF.
+    // Throws std::runtime_error if the file can't be read.
+    std::vector<std::uint64_t> compute(const std::string& filePath);
+
+    struct Changes {
+        // Pages in both versions, at the same index, that differ
+        std::vector<unsigned int> changedPages;
+        unsigned int numberOfPagesBefore = 0;
+        unsigned int numberOfPagesAfter = 0;
+
+        bool isEmpty() const;
+        // Added or removed pages are at the end
+        unsigned int numberOfAddedPages() const;
+        unsigned int numberOfRemovedPages() const;
+    };
+
+    Changes compare(const std::vector<std::uint64_t>& before, const std::vector<std::uint64_t>& after);
+
+} // namespace PageDigest
+
+} // namespace Slicer
+
+#endif // PAGEDIGEST_HPP
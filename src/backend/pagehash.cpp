@@ -0,0 +1,154 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "pagehash.hpp"
+#include "pixelconversion.hpp"
+#include <array>
+#include <bitset>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace Slicer::PageHash {
+
+static constexpr int gridWidth = 9;
+static constexpr int gridHeight = 8;
+// Out of 255. Neighbouring cells of plain paper differ by noise only, and
+// should hash the same every time.
+static constexpr int minimumDifference = 2;
+
+// As many slices as bits may differ, plus one
+static constexpr int numberOfSlices = maximumDuplicateDistance + 1;
+static constexpr int bitsPerSlice = (64 + numberOfSlices - 1) / numberOfSlices;
+
+std::optional<std::uint64_t> differenceHash(const Glib::RefPtr<const Gdk::Pixbuf>& page)
+{
+    if (!page || page->get_bits_per_sample() != 8)
+        return std::nullopt;
+
+    // Scanned pages come without alpha
+    const Glib::RefPtr<const Gdk::Pixbuf> rgba = page->get_has_alpha() ? page : page->add_alpha(false, 0, 0, 0);
+    const int width = rgba->get_width();
+    const int height = rgba->get_height();
+
+    if (width < gridWidth || height < gridHeight)
+        return std::nullopt;
+
+    std::array<int, gridWidth + 1> columnStarts{};
+    for (int column = 0; column <= gridWidth; ++column)
+        columnStarts.at(static_cast<std::size_t>(column)) = column * width / gridWidth;
+
+    std::array<std::array<std::uint64_t, gridWidth>, gridHeight> sums{};
+    std::vector<std::uint8_t> gray(static_cast<std::size_t>(width));
+
+    for (int y = 0; y < height; ++y) {
+        PixelConversion::rgbaToGray(rgba->read_pixels() + y * rgba->get_rowstride(), //NOLINT
+                                    rgba->get_rowstride(),
+                                    gray.data(),
+                                    width,
+                                    width,
+                                    1);
+
+        auto& row = sums.at(static_cast<std::size_t>(y * gridHeight / height));
+
+        for (std::size_t column = 0; column < gridWidth; ++column) {
+            std::uint64_t sum = 0;
+            for (int x = columnStarts.at(column); x < columnStarts.at(column + 1); ++x)
+                sum += gray[static_cast<std::size_t>(x)];
+
+            row.at(column) += sum;
+        }
+    }
+
+    std::uint64_t hash = 0;
+
+    for (int row = 0; row < gridHeight; ++row) {
+        const int rowHeight = (row + 1) * height / gridHeight - row * height / gridHeight;
+
+        auto meanOf = [&](int column) {
+            const int columnWidth = columnStarts.at(static_cast<std::size_t>(column + 1)) - columnStarts.at(static_cast<std::size_t>(column));
+            const std::uint64_t sum = sums.at(static_cast<std::size_t>(row)).at(static_cast<std::size_t>(column));
+
+            return static_cast<int>(sum / static_cast<std::uint64_t>(rowHeight * columnWidth));
+        };
+
+        for (int column = 0; column + 1 < gridWidth; ++column) {
+            hash <<= 1;
+            hash |= meanOf(column) > meanOf(column + 1) + minimumDifference ? 1 : 0;
+        }
+    }
+
+    return hash;
+}
+
+int distance(std::uint64_t first, std::uint64_t second)
+{
+    return static_cast<int>(std::bitset<64>{first ^ second}.count());
+}
+
+static std::uint64_t sliceOf(std::uint64_t hash, int slice)
+{
+    const std::uint64_t mask = (std::uint64_t{1} << bitsPerSlice) - 1;
+
+    return (hash >> (slice * bitsPerSlice)) & mask;
+}
+
+std::vector<unsigned int> findDuplicates(const std::vector<std::optional<std::uint64_t>>& hashes)
+{
+    std::vector<unsigned int> duplicates;
+    // Pages that are exactly the same, such as a file added twice, stop here,
+    // so that big runs of them don't fill the buckets below
+    std::unordered_set<std::uint64_t> seen;
+    std::array<std::unordered_map<std::uint64_t, std::vector<std::uint64_t>>, numberOfSlices> slices;
+
+    for (unsigned int i = 0; i < hashes.size(); ++i) {
+        if (!hashes[i].has_value())
+            continue;
+
+        const std::uint64_t hash = *hashes[i];
+
+        if (!seen.insert(hash).second) {
+            duplicates.push_back(i);
+            continue;
+        }
+
+        bool isDuplicate = false;
+
+        for (int slice = 0; slice < numberOfSlices && !isDuplicate; ++slice) {
+            const auto bucket = slices.at(static_cast<std::size_t>(slice)).find(sliceOf(hash, slice));
+
+            if (bucket == slices.at(static_cast<std::size_t>(slice)).end())
+                continue;
+
+            for (const std::uint64_t other : bucket->second) {
+                if (distance(hash, other) <= maximumDuplicateDistance) {
+                    isDuplicate = true;
+                    break;
+                }
+            }
+        }
+
+        if (isDuplicate)
+            duplicates.push_back(i);
+
+        for (int slice = 0; slice < numberOfSlices; ++slice)
+            slices.at(static_cast<std::size_t>(slice))[sliceOf(hash, slice)].push_back(hash);
+    }
+
+    return duplicates;
+}
+
+} // namespace Slicer::PageHash
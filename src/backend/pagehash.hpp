@@ -0,0 +1,49 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef PAGEHASH_HPP
+#define PAGEHASH_HPP
+
+#include <gdkmm/pixbuf.h>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace Slicer::PageHash {
+
+// Pages this many bits apart, or less, look the same
+constexpr int maximumDuplicateDistance = 4;
+
+// A difference hash of a render or thumbnail of a page: the page is shrunk
+// to a grid of 9 by 8 gray cells, and each bit tells whether a cell is
+// clearly brighter than the one to its right. Renders of the same page at
+// any size, or a scan of it sent twice, get hashes a few bits apart.
+// Nothing if the image is smaller than the grid.
+std::optional<std::uint64_t> differenceHash(const Glib::RefPtr<const Gdk::Pixbuf>& page);
+
+// Number of bits that differ
+int distance(std::uint64_t first, std::uint64_t second);
+
+// The indexes of the hashes that look like one before them. Pages without
+// a hash are never duplicates. Close hashes are found through an index per
+// slice of the bits, rather than by comparing every pair: two hashes within
+// maximumDuplicateDistance have at least one slice in common.
+std::vector<unsigned int> findDuplicates(const std::vector<std::optional<std::uint64_t>>& hashes);
+
+} // namespace Slicer::PageHash
+
+#endif // PAGEHASH_HPP
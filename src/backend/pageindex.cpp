@@ -0,0 +1,306 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "pageindex.hpp"
+#include <giomm/file.h>
+#include <glibmm/miscutils.h>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace Slicer::PageIndex {
+
+namespace {
+    std::mutex directoryMutex;
+    std::string directory;
+
+    // Changes whenever the layout below does, so old indexes just miss
+    constexpr std::uint32_t magic = 0x58495350; // "PSIX"
+    constexpr std::uint32_t version = 2;
+
+    // Followed by numberOfPages entries
+    struct Header {
+        std::uint32_t magic;
+        std::uint32_t version;
+        std::uint64_t fileSize;
+        std::uint64_t modificationTime;
+        std::uint32_t numberOfPages;
+        std::uint32_t padding;
+    };
+
+    // The most recently used first
+    struct KeptIndex {
+        Key key;
+        std::vector<Entry> entries;
+    };
+
+    std::mutex memoryMutex;
+    std::size_t memoryBudgetInBytes = 0;
+    std::size_t memoryUsed = 0;
+    std::list<KeptIndex> keptIndexes;
+    std::unordered_map<std::string, std::list<KeptIndex>::iterator> keptIndexesByHash;
+
+    std::size_t sizeOf(const KeptIndex& index)
+    {
+        return index.entries.size() * sizeof(Entry) + sizeof(KeptIndex);
+    }
+
+    // Called with memoryMutex held
+    void forget(std::list<KeptIndex>::iterator index)
+    {
+        memoryUsed -= sizeOf(*index);
+        keptIndexesByHash.erase(index->key.fileHash);
+        keptIndexes.erase(index);
+    }
+
+    // Called with memoryMutex held
+    void evict()
+    {
+        while (memoryUsed > memoryBudgetInBytes && !keptIndexes.empty())
+            forget(std::prev(keptIndexes.end()));
+    }
+
+    void keep(const Key& key, const std::vector<Entry>& entries)
+    {
+        std::lock_guard<std::mutex> lock{memoryMutex};
+
+        if (memoryBudgetInBytes == 0)
+            return;
+
+        if (auto it = keptIndexesByHash.find(key.fileHash); it != keptIndexesByHash.end())
+            forget(it->second);
+
+        keptIndexes.push_front({key, entries});
+        keptIndexesByHash.emplace(key.fileHash, keptIndexes.begin());
+        memoryUsed += sizeOf(keptIndexes.front());
+
+        evict();
+    }
+
+    std::optional<std::vector<Entry>> findKept(const Key& key)
+    {
+        std::lock_guard<std::mutex> lock{memoryMutex};
+
+        const auto it = keptIndexesByHash.find(key.fileHash);
+        if (it == keptIndexesByHash.end())
+            return {};
+
+        const KeptIndex& index = *it->second;
+        if (index.key.fileSize != key.fileSize || index.key.modificationTime != key.modificationTime)
+            return {};
+
+        keptIndexes.splice(keptIndexes.begin(), keptIndexes, it->second);
+
+        return index.entries;
+    }
+
+    constexpr std::uint32_t digestsMagic = 0x47445350; // "PSDG"
+    constexpr std::uint32_t digestsVersion = 2;
+
+    // Followed by numberOfPages digests
+    struct DigestsHeader {
+        std::uint32_t magic;
+        std::uint32_t version;
+        std::uint64_t fileSize;
+        std::uint64_t modificationTime;
+        std::uint32_t numberOfPages;
+        std::uint32_t padding;
+    };
+
+    std::string pathFor(const std::string& directoryPath, const Key& key)
+    {
+        return Glib::build_filename(directoryPath, key.fileHash + ".index");
+    }
+
+    std::string digestsPathFor(const std::string& directoryPath, const Key& key)
+    {
+        return Glib::build_filename(directoryPath, key.fileHash + ".digests");
+    }
+
+    // Readers see either the old file or the whole new one
+    void writeAtomically(const std::string& path, const std::function<void(std::ofstream&)>& write)
+    {
+        const std::string partialPath = path + ".part";
+
+        {
+            std::ofstream file{partialPath, std::ios::binary | std::ios::trunc};
+            write(file);
+
+            if (!file) {
+                file.close();
+                std::remove(partialPath.c_str());
+                return;
+            }
+        }
+
+        if (std::rename(partialPath.c_str(), path.c_str()) != 0)
+            std::remove(partialPath.c_str());
+    }
+}
+
+void setDirectory(const std::string& directoryPath)
+{
+    std::lock_guard<std::mutex> lock{directoryMutex};
+    directory = directoryPath;
+
+    if (directory.empty())
+        return;
+
+    try {
+        auto file = Gio::File::create_for_path(directory);
+
+        if (!file->query_exists())
+            file->make_directory_with_parents();
+    }
+    catch (const Glib::Error&) {
+        // Every store will fail, and every load will miss
+    }
+}
+
+std::string directoryPath()
+{
+    std::lock_guard<std::mutex> lock{directoryMutex};
+    return directory;
+}
+
+bool isEnabled()
+{
+    return !directoryPath().empty();
+}
+
+void setMemoryBudget(std::size_t bytes)
+{
+    std::lock_guard<std::mutex> lock{memoryMutex};
+    memoryBudgetInBytes = bytes;
+
+    evict();
+}
+
+std::size_t memoryBudget()
+{
+    std::lock_guard<std::mutex> lock{memoryMutex};
+    return memoryBudgetInBytes;
+}
+
+std::optional<std::vector<Entry>> load(const Key& key)
+{
+    if (key.fileHash.empty())
+        return {};
+
+    if (std::optional<std::vector<Entry>> kept = findKept(key); kept.has_value())
+        return kept;
+
+    const std::string currentDirectory = directoryPath();
+
+    if (currentDirectory.empty())
+        return {};
+
+    std::ifstream file{pathFor(currentDirectory, key), std::ios::binary};
+    Header header{};
+
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) //NOLINT
+        || header.magic != magic || header.version != version
+        || header.fileSize != key.fileSize || header.modificationTime != key.modificationTime
+        || header.numberOfPages == 0)
+        return {};
+
+    std::vector<Entry> entries(header.numberOfPages);
+    const auto size = static_cast<std::streamsize>(entries.size() * sizeof(Entry));
+
+    if (!file.read(reinterpret_cast<char*>(entries.data()), size)) //NOLINT
+        return {};
+
+    keep(key, entries);
+
+    return entries;
+}
+
+void store(const Key& key, const std::vector<Entry>& entries)
+{
+    if (key.fileHash.empty() || entries.empty())
+        return;
+
+    keep(key, entries);
+
+    const std::string currentDirectory = directoryPath();
+
+    if (currentDirectory.empty())
+        return;
+
+    const Header header{magic,
+                        version,
+                        key.fileSize,
+                        key.modificationTime,
+                        static_cast<std::uint32_t>(entries.size()),
+                        0};
+
+    writeAtomically(pathFor(currentDirectory, key), [&header, &entries](std::ofstream& file) {
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header)); //NOLINT
+        file.write(reinterpret_cast<const char*>(entries.data()), //NOLINT
+                   static_cast<std::streamsize>(entries.size() * sizeof(Entry)));
+    });
+}
+
+std::optional<std::vector<std::uint64_t>> loadDigests(const Key& key)
+{
+    const std::string currentDirectory = directoryPath();
+
+    if (currentDirectory.empty() || key.fileHash.empty())
+        return {};
+
+    std::ifstream file{digestsPathFor(currentDirectory, key), std::ios::binary};
+    DigestsHeader header{};
+
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) //NOLINT
+        || header.magic != digestsMagic || header.version != digestsVersion
+        || header.fileSize != key.fileSize || header.modificationTime != key.modificationTime)
+        return {};
+
+    std::vector<std::uint64_t> digests(header.numberOfPages);
+    const auto size = static_cast<std::streamsize>(digests.size() * sizeof(std::uint64_t));
+
+    if (!file.read(reinterpret_cast<char*>(digests.data()), size)) //NOLINT
+        return {};
+
+    return digests;
+}
+
+void storeDigests(const Key& key, const std::vector<std::uint64_t>& digests)
+{
+    const std::string currentDirectory = directoryPath();
+
+    if (currentDirectory.empty() || key.fileHash.empty())
+        return;
+
+    const DigestsHeader header{digestsMagic,
+                               digestsVersion,
+                               key.fileSize,
+                               key.modificationTime,
+                               static_cast<std::uint32_t>(digests.size()),
+                               0};
+
+    writeAtomically(digestsPathFor(currentDirectory, key), [&header, &digests](std::ofstream& file) {
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header)); //NOLINT
+        file.write(reinterpret_cast<const char*>(digests.data()), //NOLINT
+                   static_cast<std::streamsize>(digests.size() * sizeof(std::uint64_t)));
+    });
+}
+
+} // namespace Slicer::PageIndex
@@ -0,0 +1,77 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PAGEINDEX_HPP
+#define PAGEINDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace Slicer {
+
+// What opening a file needs to know about each of its pages, stored in the
+// cache dir after the first time, so that opening a known file again doesn't
+// ask poppler about every page. Poppler then only opens the file to render.
+// Indexes are compact binary files named after the content hash of their
+// file, and are only used if the file still has the same size and
+// modification time. Best effort, like DiskThumbnailCache: errors are misses.
+namespace PageIndex {
+
+    struct Key {
+        std::string fileHash;
+        std::uint64_t fileSize;
+        std::uint64_t modificationTime;
+    };
+
+    struct Entry {
+        std::int32_t width;
+        std::int32_t height;
+        // In degrees, as the file has it
+        std::int32_t rotation;
+        // See RenderCost
+        std::uint32_t renderCost;
+    };
+
+    // Empty, the default, turns the index off
+    void setDirectory(const std::string& directoryPath);
+    bool isEnabled();
+    // For what's kept along with the index, such as the TextIndex
+    std::string directoryPath();
+
+    std::optional<std::vector<Entry>> load(const Key& key);
+    void store(const Key& key, const std::vector<Entry>& entries);
+
+    // The indexes last loaded or stored are also kept in memory, up to this
+    // many bytes, so a process that stays around opens them again without
+    // reading the disk. 0, the default, keeps none. Works without a directory.
+    void setMemoryBudget(std::size_t bytes);
+    std::size_t memoryBudget();
+
+    // The PageDigest of every page, kept next to the index. Only needed when
+    // the file changes, so it's stored then, for the next change to compare
+    // with. Keyed like the index, by the content hash of the snapshot it's
+    // computed from and the size and modification time of its source.
+    std::optional<std::vector<std::uint64_t>> loadDigests(const Key& key);
+    void storeDigests(const Key& key, const std::vector<std::uint64_t>& digests);
+
+} // namespace PageIndex
+
+} // namespace Slicer
+
+#endif // PAGEINDEX_HPP
@@ -0,0 +1,337 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#include "pagelistmodel.hpp"
+#include "sourcefile.hpp"
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+
+namespace Slicer {
+
+// Rows of files are made on the threads that load them
+static PageListModel::Key nextKey()
+{
+    static std::atomic<PageListModel::Key> lastKey{0};
+
+    return ++lastKey;
+}
+
+Glib::RefPtr<Page> PageListModel::Source::createPage(unsigned int entry) const
+{
+    const Entry& pageEntry = entries.at(entry);
+    Glib::RefPtr<Page> page{new Page{Page::Size{pageEntry.metadata.width, pageEntry.metadata.height},
+                                     pageEntry.metadata.rotation,
+                                     fileName,
+                                     sourceFile,
+                                     fileHash,
+                                     fileNumber,
+                                     pageEntry.indexInFile}};
+    page->setRenderCost(pageEntry.metadata.renderCost);
+
+    return page;
+}
+
+PageListModel::Row::Row(std::shared_ptr<const Source> source, unsigned int entry, int rotation)
+    : m_key{nextKey()}
+    , m_source{std::move(source)}
+    , m_entry{entry}
+    , m_rotation{rotation}
+{
+}
+
+std::vector<PageListModel::Row> PageListModel::Row::rowsOf(const std::shared_ptr<const Source>& source)
+{
+    std::vector<Row> rows;
+    rows.reserve(source->entries.size());
+
+    for (unsigned int i = 0; i < source->entries.size(); ++i)
+        rows.emplace_back(source, i, source->entries[i].metadata.rotation);
+
+    return rows;
+}
+
+unsigned int PageListModel::Row::fileNumber() const
+{
+    return m_page ? m_page->m_fileNumber : m_source->fileNumber;
+}
+
+const std::string& PageListModel::Row::filePath() const
+{
+    return m_page ? m_page->filePath() : m_source->sourceFile->path();
+}
+
+const std::string& PageListModel::Row::fileHash() const
+{
+    return m_page ? m_page->fileHash() : m_source->fileHash;
+}
+
+const SourceFile::Origin& PageListModel::Row::origin() const
+{
+    return m_page ? m_page->sourceFile().origin() : m_source->sourceFile->origin();
+}
+
+unsigned int PageListModel::Row::indexInFile() const
+{
+    return m_page ? m_page->indexInFile() : entry().indexInFile;
+}
+
+Page::Size PageListModel::Row::size() const
+{
+    if (m_page)
+        return m_page->size();
+
+    return {entry().metadata.width, entry().metadata.height};
+}
+
+int PageListModel::Row::sourceRotation() const
+{
+    return m_page ? m_page->sourceRotation() : entry().metadata.rotation;
+}
+
+int PageListModel::Row::currentRotation() const
+{
+    return m_page ? m_page->currentRotation() : m_rotation;
+}
+
+PageListModel::CachedPage::CachedPage(Page& page, std::weak_ptr<const Source> source, unsigned int entry)
+    : source{std::move(source)}
+    , entry{entry}
+{
+    g_weak_ref_init(&m_page, page.gobj());
+}
+
+PageListModel::CachedPage::~CachedPage()
+{
+    g_weak_ref_clear(&m_page);
+}
+
+Glib::RefPtr<Page> PageListModel::CachedPage::lock() const
+{
+    auto object = static_cast<GObject*>(g_weak_ref_get(&m_page));
+
+    if (object == nullptr)
+        return {};
+
+    // Takes over the reference g_weak_ref_get() added
+    return Glib::RefPtr<Page>::cast_dynamic(Glib::wrap(object, false));
+}
+
+PageListModel::PageListModel()
+    : Glib::ObjectBase{typeid(PageListModel)}
+    , Gio::ListModel{}
+{
+}
+
+Glib::RefPtr<PageListModel> PageListModel::create()
+{
+    return Glib::RefPtr<PageListModel>{new PageListModel};
+}
+
+// The pages still held elsewhere outlive the model, and keep their files
+PageListModel::~PageListModel() = default;
+
+GType PageListModel::get_item_type_vfunc()
+{
+    return Page::get_base_type();
+}
+
+guint PageListModel::get_n_items_vfunc()
+{
+    return size();
+}
+
+gpointer PageListModel::get_item_vfunc(guint position)
+{
+    if (position >= size())
+        return nullptr;
+
+    // The caller owns the reference
+    return pageAt(position)->gobj_copy();
+}
+
+Glib::RefPtr<Page> PageListModel::livePageAt(unsigned int position) const
+{
+    const Row& row = m_rows.at(position);
+
+    if (row.m_page)
+        return row.m_page;
+
+    const auto it = m_cachedPages.find(row.m_key);
+
+    return it != m_cachedPages.end() ? it->second.lock() : Glib::RefPtr<Page>{};
+}
+
+Glib::RefPtr<Page> PageListModel::pageAt(unsigned int position) const
+{
+    if (Glib::RefPtr<Page> page = livePageAt(position))
+        return page;
+
+    const Row& row = m_rows.at(position);
+    Glib::RefPtr<Page> page = row.m_source->createPage(row.m_entry);
+    page->rotateBy((row.m_rotation - row.sourceRotation()) / 90);
+    page->setDocumentIndex(position);
+    page->setListKey(row.m_key);
+
+    // Weakly: once no one holds it, the next one is made from the row again
+    m_cachedPages.erase(row.m_key);
+    m_cachedPages.try_emplace(row.m_key, *page.get(), row.m_source, row.m_entry);
+
+    if (m_cachedPages.size() >= m_cacheSizeToPrune)
+        pruneCache();
+
+    return page;
+}
+
+void PageListModel::pruneCache() const
+{
+    for (auto it = m_cachedPages.begin(); it != m_cachedPages.end();) {
+        if (!it->second.lock())
+            it = m_cachedPages.erase(it);
+        else
+            ++it;
+    }
+
+    m_cacheSizeToPrune = std::max(minimumCacheSizeToPrune, 2 * m_cachedPages.size());
+}
+
+PageListModel::Row PageListModel::rowOf(const Glib::RefPtr<Page>& page) const
+{
+    Row row;
+    row.m_key = page->listKey();
+
+    if (const auto it = m_cachedPages.find(row.m_key); row.m_key != 0 && it != m_cachedPages.end()) {
+        if (std::shared_ptr<const Source> source = it->second.source.lock()) {
+            row.m_source = std::move(source);
+            row.m_entry = it->second.entry;
+            row.m_rotation = page->currentRotation();
+
+            return row;
+        }
+
+        // Every other row of its file went away, the page is all there's left of it
+        m_cachedPages.erase(it);
+    }
+
+    if (row.m_key == 0) {
+        row.m_key = nextKey();
+        page->setListKey(row.m_key);
+    }
+
+    row.m_page = page;
+
+    return row;
+}
+
+void PageListModel::splice(unsigned int position, unsigned int numberOfRemoved, std::vector<Row> rows)
+{
+    const auto numberOfAdded = static_cast<unsigned int>(rows.size());
+    const auto first = m_rows.begin() + position;
+
+    if (numberOfRemoved >= numberOfAdded) {
+        std::move(rows.begin(), rows.end(), first);
+        m_rows.erase(first + numberOfAdded, first + numberOfRemoved);
+    }
+    else {
+        std::move(rows.begin(), rows.begin() + numberOfRemoved, first);
+        m_rows.insert(first + numberOfRemoved,
+                      std::make_move_iterator(rows.begin() + numberOfRemoved),
+                      std::make_move_iterator(rows.end()));
+    }
+
+    m_memoryCharge.set(m_rows.capacity() * sizeof(Row));
+
+    if ((numberOfRemoved > 0 || numberOfAdded > 0) && !isHoldingNotifications())
+        items_changed(position, numberOfRemoved, numberOfAdded);
+}
+
+void PageListModel::rotate(unsigned int position, int quarterTurns)
+{
+    Row& row = m_rows.at(position);
+
+    if (row.m_page) {
+        row.m_page->rotateBy(quarterTurns);
+        return;
+    }
+
+    row.m_rotation = (((row.m_rotation + 90 * quarterTurns) % 360) + 360) % 360;
+
+    if (const Glib::RefPtr<Page> page = livePageAt(position))
+        page->rotateBy(quarterTurns);
+}
+
+void PageListModel::renumberFrom(unsigned int first) const
+{
+    for (unsigned int i = first; i < size(); ++i) {
+        if (const Glib::RefPtr<Page> page = livePageAt(i))
+            page->setDocumentIndex(i);
+    }
+}
+
+void PageListModel::holdNotifications()
+{
+    if (isHoldingNotifications())
+        return;
+
+    m_heldRows.emplace();
+    m_heldRows->reserve(m_rows.size());
+
+    for (const Row& row : m_rows)
+        m_heldRows->emplace_back(row.key(), row.currentRotation());
+}
+
+PageListModel::HeldChange PageListModel::releaseNotifications()
+{
+    HeldChange change;
+
+    if (!isHoldingNotifications())
+        return change;
+
+    const std::vector<std::pair<Key, int>> held = std::move(*m_heldRows);
+    m_heldRows.reset();
+
+    const auto oldSize = static_cast<unsigned int>(held.size());
+    const unsigned int newSize = size();
+
+    unsigned int prefix = 0;
+    while (prefix < std::min(oldSize, newSize) && held[prefix].first == m_rows[prefix].key())
+        ++prefix;
+
+    unsigned int suffix = 0;
+    while (suffix < std::min(oldSize, newSize) - prefix
+           && held[oldSize - suffix - 1].first == m_rows[newSize - suffix - 1].key())
+        ++suffix;
+
+    change.first = prefix;
+    change.numberOfRemoved = oldSize - prefix - suffix;
+    change.numberOfAdded = newSize - prefix - suffix;
+
+    for (unsigned int i = 0; i < prefix; ++i) {
+        if (held[i].second != m_rows[i].currentRotation())
+            change.rotatedRows.push_back(i);
+    }
+
+    for (unsigned int i = newSize - suffix; i < newSize; ++i) {
+        if (held[i - newSize + oldSize].second != m_rows[i].currentRotation())
+            change.rotatedRows.push_back(i);
+    }
+
+    if (change.numberOfRemoved > 0 || change.numberOfAdded > 0)
+        items_changed(change.first, change.numberOfRemoved, change.numberOfAdded);
+
+    return change;
+}
+
+} // namespace Slicer
@@ -0,0 +1,180 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#ifndef PAGELISTMODEL_HPP
+#define PAGELISTMODEL_HPP
+
+#include "metrics.hpp"
+#include "page.hpp"
+#include "pageindex.hpp"
+#include "sourcefile.hpp"
+#include <giomm/listmodel.h>
+#include <glibmm/object.h>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Slicer {
+
+// The pages of a Document, as a GListModel. Each row is a few words of plain
+// data; Page objects are only made when get_item() or pageAt() asks for one,
+// which the view does for the pages on screen, and are only kept for as long
+// as someone else holds them. Asking again for a page that's still held gives
+// that same object. Main thread only, as Gio::ListStore is.
+class PageListModel : public Glib::Object, public Gio::ListModel {
+public:
+    // Tells the pages of the model apart, across the Page objects made for each
+    using Key = std::uint64_t;
+
+    // What the rows of a file make their pages from. Never changes once made,
+    // so that the rows can be made on any thread.
+    struct Source {
+        struct Entry {
+            unsigned int indexInFile;
+            PageIndex::Entry metadata;
+        };
+
+        Glib::ustring fileName;
+        std::shared_ptr<const SourceFile> sourceFile;
+        std::string fileHash;
+        unsigned int fileNumber;
+        std::vector<Entry> entries;
+
+        // A new one each time, not yet in any model
+        Glib::RefPtr<Page> createPage(unsigned int entry) const;
+    };
+
+    class Row {
+    public:
+        Row() = default;
+        // The page of an entry of source, turned to rotation
+        Row(std::shared_ptr<const Source> source, unsigned int entry, int rotation);
+
+        // One row per entry of source, as the file has them turned
+        static std::vector<Row> rowsOf(const std::shared_ptr<const Source>& source);
+
+        Key key() const { return m_key; }
+        unsigned int fileNumber() const;
+        const std::string& filePath() const;
+        const std::string& fileHash() const;
+        const SourceFile::Origin& origin() const;
+        unsigned int indexInFile() const;
+        // Before rotations, in points
+        Page::Size size() const;
+        int sourceRotation() const;
+        int currentRotation() const;
+
+    private:
+        friend class PageListModel;
+
+        Key m_key = 0;
+        // Only rows of pages that came in as Page objects hold them
+        Glib::RefPtr<Page> m_page;
+        std::shared_ptr<const Source> m_source;
+        unsigned int m_entry = 0;
+        int m_rotation = 0;
+
+        const Source::Entry& entry() const { return m_source->entries[m_entry]; }
+    };
+
+    static Glib::RefPtr<PageListModel> create();
+    ~PageListModel() override;
+
+    PageListModel(const PageListModel&) = delete;
+    PageListModel& operator=(const PageListModel&) = delete;
+    PageListModel(PageListModel&&) = delete;
+    PageListModel& operator=(PageListModel&&) = delete;
+
+    unsigned int size() const { return static_cast<unsigned>(m_rows.size()); }
+    const Row& rowAt(unsigned int position) const { return m_rows.at(position); }
+    // Made now, if no one holds it
+    Glib::RefPtr<Page> pageAt(unsigned int position) const;
+    // A row for page. Pages made by this model go back to being plain rows.
+    Row rowOf(const Glib::RefPtr<Page>& page) const;
+
+    // Like Gio::ListStore::splice(), with a single notification
+    void splice(unsigned int position, unsigned int numberOfRemoved, std::vector<Row> rows);
+    // Right for positive turns, left for negative ones. Doesn't notify.
+    void rotate(unsigned int position, int quarterTurns);
+    // The pages held by someone get the index of their row, from first onwards.
+    // Doesn't notify, see Page::setDocumentIndex().
+    void renumberFrom(unsigned int first) const;
+
+    // What changed while notifications were held: the span from the first
+    // to the last row that isn't the one that was there, and the rows
+    // outside of it that were turned, which rotate() doesn't notify anyway
+    struct HeldChange {
+        unsigned int first = 0;
+        unsigned int numberOfRemoved = 0;
+        unsigned int numberOfAdded = 0;
+        std::vector<unsigned int> rotatedRows;
+    };
+
+    // Until released, changes are made without being notified. Releasing
+    // notifies all of them as a single splice, whatever their number.
+    void holdNotifications();
+    HeldChange releaseNotifications();
+    bool isHoldingNotifications() const { return m_heldRows.has_value(); }
+
+protected:
+    PageListModel();
+
+    GType get_item_type_vfunc() override;
+    guint get_n_items_vfunc() override;
+    gpointer get_item_vfunc(guint position) override;
+
+private:
+    // Made by the model, and held elsewhere, or gone
+    class CachedPage {
+    public:
+        CachedPage(Page& page, std::weak_ptr<const Source> source, unsigned int entry);
+        ~CachedPage();
+
+        CachedPage(const CachedPage&) = delete;
+        CachedPage& operator=(const CachedPage&) = delete;
+        CachedPage(CachedPage&&) = delete;
+        CachedPage& operator=(CachedPage&&) = delete;
+
+        // Null once the page is gone; pages can go on any thread
+        Glib::RefPtr<Page> lock() const;
+
+        std::weak_ptr<const Source> source;
+        unsigned int entry;
+
+    private:
+        mutable GWeakRef m_page;
+    };
+
+    std::vector<Row> m_rows;
+    // The key and rotation of every row when notifications were held
+    std::optional<std::vector<std::pair<Key, int>>> m_heldRows;
+    mutable std::unordered_map<Key, CachedPage> m_cachedPages;
+    // The entries of pages that are gone are dropped once there are this many
+    mutable std::size_t m_cacheSizeToPrune = minimumCacheSizeToPrune;
+    Metrics::MemoryCharge m_memoryCharge{Metrics::Memory::Pages};
+
+    static constexpr std::size_t minimumCacheSizeToPrune = 1024;
+
+    Glib::RefPtr<Page> livePageAt(unsigned int position) const;
+    void pruneCache() const;
+};
+
+} // namespace Slicer
+
+#endif // PAGELISTMODEL_HPP
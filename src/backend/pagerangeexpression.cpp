@@ -0,0 +1,136 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "pagerangeexpression.hpp"
+#include <sstream>
+#include <stdexcept>
+
+namespace Slicer {
+
+static std::string trim(const std::string& text)
+{
+    const auto first = text.find_first_not_of(' ');
+
+    if (first == std::string::npos)
+        return {};
+
+    return text.substr(first, text.find_last_not_of(' ') - first + 1);
+}
+
+static unsigned int parseNumber(const std::string& text)
+{
+    if (text.empty() || text.size() > 9 || text.find_first_not_of("0123456789") != std::string::npos)
+        throw std::runtime_error("Invalid page number: '" + text + "'");
+
+    return static_cast<unsigned int>(std::stoul(text));
+}
+
+static unsigned int parsePageNumber(const std::string& text, unsigned int numberOfPages)
+{
+    if (text == "end")
+        return numberOfPages;
+
+    const unsigned int pageNumber = parseNumber(text);
+
+    if (pageNumber == 0 || pageNumber > numberOfPages)
+        throw std::runtime_error("Page " + text + " is out of the document, which has "
+                                 + std::to_string(numberOfPages) + " pages");
+
+    return pageNumber;
+}
+
+static SelectionModel::Range parseTerm(const std::string& term, unsigned int numberOfPages)
+{
+    if (term == "all")
+        return {0, numberOfPages - 1, 1};
+
+    if (term == "odd")
+        return {0, numberOfPages - 1, 2};
+
+    if (term == "even") {
+        if (numberOfPages < 2)
+            throw std::runtime_error("There are no even pages in a document with one page");
+
+        return {1, numberOfPages - 1, 2};
+    }
+
+    std::string range = term;
+    unsigned int step = 1;
+
+    if (const auto slash = term.find('/'); slash != std::string::npos) {
+        range = trim(term.substr(0, slash));
+        step = parseNumber(trim(term.substr(slash + 1)));
+
+        if (step == 0)
+            throw std::runtime_error("Invalid step in page range: '" + term + "'");
+    }
+
+    const auto dash = range.find('-');
+    unsigned int first = 0, last = 0;
+
+    if (range == "all") {
+        first = 1;
+        last = numberOfPages;
+    }
+    else if (dash == std::string::npos) {
+        first = last = parsePageNumber(range, numberOfPages);
+    }
+    else {
+        first = parsePageNumber(trim(range.substr(0, dash)), numberOfPages);
+        const std::string end = trim(range.substr(dash + 1));
+        last = end.empty() ? numberOfPages : parsePageNumber(end, numberOfPages);
+    }
+
+    if (first > last)
+        throw std::runtime_error("Invalid page range: '" + term + "'");
+
+    return {first - 1, last - 1, step};
+}
+
+std::vector<SelectionModel::Range> parsePageRangeExpression(const std::string& expression,
+                                                            unsigned int numberOfPages)
+{
+    if (numberOfPages == 0)
+        throw std::runtime_error("The document has no pages");
+
+    std::vector<SelectionModel::Range> ranges;
+    std::istringstream stream{expression};
+    std::string term;
+
+    while (std::getline(stream, term, ',')) {
+        term = trim(term);
+
+        if (term.empty())
+            throw std::runtime_error("Invalid page number: ''");
+
+        ranges.push_back(parseTerm(term, numberOfPages));
+    }
+
+    if (ranges.empty())
+        throw std::runtime_error("No pages given");
+
+    return ranges;
+}
+
+SelectionModel parsePageSelection(const std::string& expression, unsigned int numberOfPages)
+{
+    SelectionModel selection{numberOfPages};
+    selection.selectOnly(parsePageRangeExpression(expression, numberOfPages));
+
+    return selection;
+}
+
+} // namespace Slicer
@@ -0,0 +1,42 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PAGERANGEEXPRESSION_HPP
+#define PAGERANGEEXPRESSION_HPP
+
+#include "selectionmodel.hpp"
+#include <string>
+#include <vector>
+
+namespace Slicer {
+
+// Page range expressions, as typed in the GUI and as given to the CLI:
+// comma separated terms with 1-based page numbers, where "end" is the last page.
+//   5           a single page
+//   1-100       a range, both ends included
+//   400-end     up to the last page, also written "400-"
+//   1-end/3     every third page of a range, starting at its first page
+//   odd, even, all
+// Throws std::runtime_error naming the first term that isn't valid.
+std::vector<SelectionModel::Range> parsePageRangeExpression(const std::string& expression,
+                                                            unsigned int numberOfPages);
+
+// Same as above, straight into a selection of numberOfPages pages
+SelectionModel parsePageSelection(const std::string& expression, unsigned int numberOfPages);
+
+} // namespace Slicer
+
+#endif // PAGERANGEEXPRESSION_HPP
@@ -15,11 +15,40 @@
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "pagerenderer.hpp"
+#include "metrics.hpp"
+#include "pixelconversion.hpp"
+#include "popplerhandles.hpp"
+#include "renderbufferpool.hpp"
+#include "scannedpages.hpp"
+#include "trace.hpp"
 #include <cairomm/context.h>
+#include <gdkmm/pixbufloader.h>
 #include <poppler/cpp/poppler-page-renderer.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <mutex>
 
 namespace Slicer {
 
+namespace {
+    std::mutex renderSettingsMutex;
+    // Indexed by quality
+    std::array<RenderSettings, 2> qualitySettings = [] {
+        RenderSettings draft;
+        draft.textAntialiasing = false;
+
+        return std::array<RenderSettings, 2>{draft, RenderSettings{}};
+    }();
+
+    std::size_t indexOf(PageRenderer::Quality quality)
+    {
+        return quality == PageRenderer::Quality::Draft ? 0 : 1;
+    }
+}
+
 PageRenderer::PageRenderer(const Glib::RefPtr<const Page>& page)
     : m_page{page}
 {
@@ -57,37 +86,321 @@ PageRenderer::RenderDimensions PageRenderer::getRenderDimensions(int targetSize)
     return {outputSize, scale, renderRotation};
 }
 
-Glib::RefPtr<Gdk::Pixbuf> PageRenderer::render(int targetSize) const
+poppler::image PageRenderer::renderImage(int targetSize, Quality quality) const
 {
-    poppler::page_renderer renderer;
-    renderer.set_render_hint(poppler::page_renderer::text_antialiasing);
-
-    const auto [outputSize, scale, renderRotation] = getRenderDimensions(targetSize);
-
-    poppler::image image = renderer.render_page(m_page->m_ppage.get(),
-                                                standardDpi * scale,
-                                                standardDpi * scale,
-                                                -1,
-                                                -1,
-                                                outputSize.width,
-                                                outputSize.height,
-                                                renderRotation);
-
-    const int stride = Cairo::ImageSurface::format_stride_for_width(Cairo::FORMAT_ARGB32, outputSize.width);
-    auto surface = Cairo::ImageSurface::create(reinterpret_cast<unsigned char*>(image.data()), //NOLINT
-                                               Cairo::FORMAT_ARGB32,
-                                               outputSize.width,
-                                               outputSize.height,
-                                               stride);
+    const RenderDimensions dimensions = getRenderDimensions(targetSize);
+
+    return renderImage(dimensions, -1, -1, dimensions.outputSize.width, dimensions.outputSize.height, quality);
+}
+
+poppler::image PageRenderer::renderImage(const RenderDimensions& dimensions,
+                                         int x,
+                                         int y,
+                                         int width,
+                                         int height,
+                                         Quality quality) const
+{
+    const Trace::Span span{"PageRenderer poppler raster"};
+
+    // Render through a handle and a renderer owned by the calling thread,
+    // so that several workers can render pages of the same file at the same time
+    const auto creationStart = std::chrono::steady_clock::now();
+    std::unique_ptr<poppler::page> ppage = PopplerHandles::createPage(m_page->filePath(),
+                                                                      m_page->indexInFile());
+    poppler::page_renderer& renderer = RenderContext::forCurrentThread(renderSettings(quality));
+
+    const auto renderStart = std::chrono::steady_clock::now();
+    poppler::image image = renderer.render_page(ppage.get(),
+                                                standardDpi * dimensions.scale,
+                                                standardDpi * dimensions.scale,
+                                                x,
+                                                y,
+                                                width,
+                                                height,
+                                                dimensions.rotation);
+    const auto renderEnd = std::chrono::steady_clock::now();
+
+    // For the report of the slowest pages
+    Metrics::recordPageCreation(m_page->filePath(), m_page->indexInFile(), renderStart - creationStart);
+    Metrics::recordPageRender(m_page->filePath(),
+                              m_page->indexInFile(),
+                              renderEnd - renderStart,
+                              image.is_valid() ? static_cast<std::size_t>(image.bytes_per_row()) * static_cast<std::size_t>(image.height()) : 0);
+
+    return image;
+}
+
+Glib::RefPtr<Gdk::Pixbuf> PageRenderer::render(int targetSize, Quality quality) const
+{
+    const Trace::Span span{"PageRenderer::render"};
+    Metrics::add(Metrics::Counter::PagesRendered);
+
+    // Cheaper than even a draft, and as sharp as a full render
+    if (Glib::RefPtr<Gdk::Pixbuf> scanned = decodeScannedPage(targetSize); scanned)
+        return scanned;
+
+    if (quality == Quality::Draft) {
+        const Page::Size outputSize = m_page->scaledRotatedSize(targetSize);
+        const poppler::image image = renderImage(std::max(1, targetSize / draftDivisor), Quality::Draft);
+
+        auto draft = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, true, 8, image.width(), image.height());
+        PixelConversion::argb32ToRgba(reinterpret_cast<const std::uint8_t*>(image.const_data()), //NOLINT
+                                      image.bytes_per_row(),
+                                      draft->get_pixels(),
+                                      draft->get_rowstride(),
+                                      image.width(),
+                                      image.height());
+
+        // Outlined after stretching, so that it stays one pixel wide
+        auto pixbuf = draft->scale_simple(outputSize.width, outputSize.height, Gdk::INTERP_TILES);
+        PixelConversion::drawRgbaOutline(pixbuf->get_pixels(),
+                                         pixbuf->get_rowstride(),
+                                         pixbuf->get_width(),
+                                         pixbuf->get_height());
+
+        return pixbuf;
+    }
+
+    const poppler::image image = renderImage(targetSize);
+
+    // Convert straight into the Pixbuf, rather than going through a Cairo
+    // surface and gdk_pixbuf_get_from_surface(), which does it pixel by pixel
+    // The buffer comes from a pool, since renders happen in large bursts of similar sizes
+    const Trace::Span conversionSpan{"PageRenderer pixbuf conversion"};
+    auto pixbuf = RenderBufferPool::shared()->createPixbuf(image.width(), image.height());
+    PixelConversion::argb32ToRgba(reinterpret_cast<const std::uint8_t*>(image.const_data()), //NOLINT
+                                  image.bytes_per_row(),
+                                  pixbuf->get_pixels(),
+                                  pixbuf->get_rowstride(),
+                                  image.width(),
+                                  image.height());
+    PixelConversion::drawRgbaOutline(pixbuf->get_pixels(),
+                                     pixbuf->get_rowstride(),
+                                     image.width(),
+                                     image.height());
+
+    return pixbuf;
+}
+
+Glib::RefPtr<Gdk::Pixbuf> PageRenderer::renderAtResolution(double dpi) const
+{
+    const Trace::Span span{"PageRenderer::renderAtResolution"};
+    Metrics::add(Metrics::Counter::PagesRendered);
+
+    const Page::Size rotatedSize = m_page->rotatedSize();
+    const double longestSide = std::max(rotatedSize.width, rotatedSize.height);
+    const int targetSize = std::max(1, static_cast<int>(std::lround(longestSide * dpi / standardDpi)));
+    const poppler::image image = renderImage(targetSize);
+
+    // Not from the pool: these are far bigger than thumbnails, and go away once written
+    auto pixbuf = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, true, 8, image.width(), image.height());
+    PixelConversion::argb32ToRgba(reinterpret_cast<const std::uint8_t*>(image.const_data()), //NOLINT
+                                  image.bytes_per_row(),
+                                  pixbuf->get_pixels(),
+                                  pixbuf->get_rowstride(),
+                                  image.width(),
+                                  image.height());
+
+    return pixbuf;
+}
+
+Glib::RefPtr<Gdk::Pixbuf> PageRenderer::decodeScannedPage(int targetSize) const
+{
+    const std::optional<std::string> jpeg = ScannedPages::fullPageJpeg(m_page->filePath(), m_page->indexInFile());
+
+    if (!jpeg.has_value())
+        return {};
+
+    const Trace::Span span{"PageRenderer scanned page decoding"};
+    const Page::Size outputSize = m_page->scaledRotatedSize(targetSize);
+    // The image is upright on the page as the file has it, before any rotation
+    const bool isTurned = m_page->currentRotation() % 180 != 0;
+    Glib::RefPtr<Gdk::Pixbuf> decoded;
+
+    try {
+        // Asking for a size lets the jpeg loader have libjpeg decode at
+        // 1/2, 1/4 or 1/8 of the resolution, the smallest that's still enough
+        auto loader = Gdk::PixbufLoader::create("jpeg");
+        loader->set_size(isTurned ? outputSize.height : outputSize.width,
+                         isTurned ? outputSize.width : outputSize.height);
+        loader->write(reinterpret_cast<const guint8*>(jpeg->data()), jpeg->size()); //NOLINT
+        loader->close();
+        decoded = loader->get_pixbuf();
+    }
+    catch (const Glib::Error&) {
+        return {};
+    }
+
+    if (!decoded)
+        return {};
+
+    // Gdk measures rotations counterclockwise
+    switch (m_page->currentRotation()) {
+    case 90:
+        decoded = decoded->rotate_simple(Gdk::PIXBUF_ROTATE_CLOCKWISE);
+        break;
+    case 180:
+        decoded = decoded->rotate_simple(Gdk::PIXBUF_ROTATE_UPSIDEDOWN);
+        break;
+    case 270:
+        decoded = decoded->rotate_simple(Gdk::PIXBUF_ROTATE_COUNTERCLOCKWISE);
+        break;
+    default:
+        break;
+    }
+
+    if (decoded->get_width() != outputSize.width || decoded->get_height() != outputSize.height)
+        decoded = decoded->scale_simple(outputSize.width, outputSize.height, Gdk::INTERP_BILINEAR);
+
+    // Same layout and outline as a render from poppler
+    Glib::RefPtr<Gdk::Pixbuf> result = decoded->add_alpha(false, 0, 0, 0);
+    PixelConversion::drawRgbaOutline(result->get_pixels(),
+                                     result->get_rowstride(),
+                                     result->get_width(),
+                                     result->get_height());
+
+    return result;
+}
+
+void PageRenderer::setRenderSettings(Quality quality, const RenderSettings& settings)
+{
+    std::lock_guard<std::mutex> lock{renderSettingsMutex};
+    qualitySettings.at(indexOf(quality)) = settings;
+}
+
+RenderSettings PageRenderer::renderSettings(Quality quality)
+{
+    std::lock_guard<std::mutex> lock{renderSettingsMutex};
+
+    return qualitySettings.at(indexOf(quality));
+}
+
+PageRenderer::EmbeddedThumbnail PageRenderer::renderEmbeddedThumbnail(int targetSize) const
+{
+    std::unique_ptr<poppler::page> ppage = PopplerHandles::createPage(m_page->filePath(),
+                                                                      m_page->indexInFile());
+    const poppler::image image = ppage->thumbnail();
+
+    if (!image.is_valid() || image.width() <= 0 || image.height() <= 0)
+        return {};
+
+    const poppler::image::format_enum format = image.format();
+    if (format != poppler::image::format_rgb24
+        && format != poppler::image::format_bgr24
+        && format != poppler::image::format_argb32)
+        return {};
+
+    auto stored = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, false, 8, image.width(), image.height());
+    const auto* source = reinterpret_cast<const std::uint8_t*>(image.const_data()); //NOLINT
+    std::uint8_t* destination = stored->get_pixels();
+
+    for (int y = 0; y < image.height(); ++y) {
+        const std::uint8_t* sourceRow = source + static_cast<std::ptrdiff_t>(y) * image.bytes_per_row(); //NOLINT
+        std::uint8_t* destinationRow = destination + static_cast<std::ptrdiff_t>(y) * stored->get_rowstride(); //NOLINT
+
+        for (int x = 0; x < image.width(); ++x) {
+            std::uint8_t* pixel = destinationRow + 3 * x; //NOLINT
+
+            if (format == poppler::image::format_rgb24) {
+                std::copy_n(sourceRow + 3 * x, 3, pixel); //NOLINT
+            }
+            else if (format == poppler::image::format_bgr24) {
+                const std::uint8_t* bgr = sourceRow + 3 * x; //NOLINT
+                pixel[0] = bgr[2]; //NOLINT
+                pixel[1] = bgr[1]; //NOLINT
+                pixel[2] = bgr[0]; //NOLINT
+            }
+            else {
+                // Native endian 0xAARRGGBB; thumbnails are opaque
+                std::uint32_t argb = 0;
+                std::memcpy(&argb, sourceRow + 4 * x, sizeof(argb)); //NOLINT
+                pixel[0] = static_cast<std::uint8_t>(argb >> 16); //NOLINT
+                pixel[1] = static_cast<std::uint8_t>(argb >> 8); //NOLINT
+                pixel[2] = static_cast<std::uint8_t>(argb); //NOLINT
+            }
+        }
+    }
+
+    const RenderDimensions dimensions = getRenderDimensions(targetSize);
+
+    // Gdk measures rotations counterclockwise
+    switch (dimensions.rotation) {
+    case poppler::rotate_90:
+        stored = stored->rotate_simple(Gdk::PIXBUF_ROTATE_CLOCKWISE);
+        break;
+    case poppler::rotate_180:
+        stored = stored->rotate_simple(Gdk::PIXBUF_ROTATE_UPSIDEDOWN);
+        break;
+    case poppler::rotate_270:
+        stored = stored->rotate_simple(Gdk::PIXBUF_ROTATE_COUNTERCLOCKWISE);
+        break;
+    default:
+        break;
+    }
+
+    const Page::Size outputSize = dimensions.outputSize;
+    const bool isSharp = stored->get_width() >= outputSize.width && stored->get_height() >= outputSize.height;
+
+    // Same layout and outline as render(), so it can take the place of a render
+    Glib::RefPtr<Gdk::Pixbuf> result = stored->scale_simple(outputSize.width, outputSize.height, Gdk::INTERP_BILINEAR)
+                                           ->add_alpha(false, 0, 0, 0);
+    PixelConversion::drawRgbaOutline(result->get_pixels(),
+                                     result->get_rowstride(),
+                                     result->get_width(),
+                                     result->get_height());
+
+    return {result, isSharp};
+}
+
+Cairo::RefPtr<Cairo::ImageSurface> PageRenderer::renderToSurface(int targetSize) const
+{
+    auto surface = createSurface(renderImage(targetSize));
 
     // Paint a black outline
     auto cr = Cairo::Context::create(surface);
     cr->set_line_width(1);
     cr->set_source_rgb(0, 0, 0);
-    cr->rectangle(0, 0, outputSize.width, outputSize.height);
+    cr->rectangle(0, 0, surface->get_width(), surface->get_height());
     cr->stroke();
 
-    return Gdk::Pixbuf::create(surface, 0, 0, outputSize.width, outputSize.height);
+    return surface;
+}
+
+Cairo::RefPtr<Cairo::ImageSurface> PageRenderer::renderRegionToSurface(int targetSize,
+                                                                     int x,
+                                                                     int y,
+                                                                     int width,
+                                                                     int height) const
+{
+    const RenderDimensions dimensions = getRenderDimensions(targetSize);
+    const Page::Size outputSize = dimensions.outputSize;
+
+    x = std::clamp(x, 0, outputSize.width);
+    y = std::clamp(y, 0, outputSize.height);
+    width = std::clamp(width, 1, std::max(1, outputSize.width - x));
+    height = std::clamp(height, 1, std::max(1, outputSize.height - y));
+
+    return createSurface(renderImage(dimensions, x, y, width, height));
+}
+
+Cairo::RefPtr<Cairo::ImageSurface> PageRenderer::createSurface(poppler::image&& renderedImage)
+{
+    const Trace::Span span{"PageRenderer surface wrap"};
+    auto image = std::make_unique<poppler::image>(std::move(renderedImage));
+
+    auto surface = Cairo::ImageSurface::create(reinterpret_cast<unsigned char*>(image->data()), //NOLINT
+                                               Cairo::FORMAT_ARGB32,
+                                               image->width(),
+                                               image->height(),
+                                               image->bytes_per_row());
+
+    // The surface borrows the image's pixels, so it takes ownership of the image
+    static cairo_user_data_key_t imageKey;
+    cairo_surface_set_user_data(surface->cobj(), &imageKey, image.release(), [](void* data) {
+        delete static_cast<poppler::image*>(data); //NOLINT
+    });
+
+    return surface;
 }
 
 } // namespace Slicer
@@ -18,6 +18,9 @@
 #define PAGERENDERER_HPP
 
 #include "page.hpp"
+#include "rendercontext.hpp"
+#include <cairomm/surface.h>
+#include <poppler/cpp/poppler-image.h>
 
 namespace Slicer {
 
@@ -25,7 +28,47 @@ class PageRenderer {
 public:
     PageRenderer(const Glib::RefPtr<const Page>& page);
 
-    [[nodiscard]] Glib::RefPtr<Gdk::Pixbuf> render(int targetSize) const;
+    enum class Quality {
+        // Half the resolution, stretched back, and no antialiasing: a
+        // stand-in for pages going by, several times cheaper to rasterize
+        Draft,
+        Full
+    };
+
+    [[nodiscard]] Glib::RefPtr<Gdk::Pixbuf> render(int targetSize, Quality quality = Quality::Full) const;
+
+    // What poppler renders each tier with, from any thread. The default full
+    // quality antialiases text only; drafts don't antialias anything.
+    static void setRenderSettings(Quality quality, const RenderSettings& settings);
+    static RenderSettings renderSettings(Quality quality);
+
+    // Same as render(), but skips the copy and ARGB to RGBA conversion that
+    // building a Pixbuf takes. The surface draws straight from poppler's buffer.
+    [[nodiscard]] Cairo::RefPtr<Cairo::ImageSurface> renderToSurface(int targetSize) const;
+
+    // Renders only a rectangle of the page as it would look at targetSize,
+    // without an outline. The rectangle is clipped to the page.
+    [[nodiscard]] Cairo::RefPtr<Cairo::ImageSurface> renderRegionToSurface(int targetSize,
+                                                                           int x,
+                                                                           int y,
+                                                                           int width,
+                                                                           int height) const;
+
+    // The whole page at dpi, without the outline thumbnails get, for
+    // writing it out as an image. Always rasterized by poppler.
+    [[nodiscard]] Glib::RefPtr<Gdk::Pixbuf> renderAtResolution(double dpi) const;
+
+    struct EmbeddedThumbnail {
+        Glib::RefPtr<Gdk::Pixbuf> thumbnail;
+        // Whether it was stored at least at the requested size, so that it
+        // can stand in for a render for good
+        bool isSharp = false;
+    };
+
+    // The thumbnail stored in the file for the page (its /Thumb), scaled
+    // and turned like render() would, if the file has one. Much cheaper
+    // than rendering, since nothing gets rasterized.
+    [[nodiscard]] EmbeddedThumbnail renderEmbeddedThumbnail(int targetSize) const;
 
 private:
     struct RenderDimensions {
@@ -37,7 +80,20 @@ private:
     const Glib::RefPtr<const Page>& m_page;
 
     static constexpr double standardDpi = 72.0;
+    static constexpr int draftDivisor = 2;
     [[nodiscard]] RenderDimensions getRenderDimensions(int targetSize) const;
+    // A page that's only a scanned JPEG, decoded at a fraction of its size
+    // if that's still enough for targetSize, see ScannedPages. Null if the
+    // page isn't one.
+    [[nodiscard]] Glib::RefPtr<Gdk::Pixbuf> decodeScannedPage(int targetSize) const;
+    [[nodiscard]] poppler::image renderImage(int targetSize, Quality quality = Quality::Full) const;
+    [[nodiscard]] poppler::image renderImage(const RenderDimensions& dimensions,
+                                             int x,
+                                             int y,
+                                             int width,
+                                             int height,
+                                             Quality quality = Quality::Full) const;
+    static Cairo::RefPtr<Cairo::ImageSurface> createSurface(poppler::image&& image);
 };
 
 } // namespace Slicer
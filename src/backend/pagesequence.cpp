@@ -0,0 +1,216 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "pagesequence.hpp"
+#include <algorithm>
+#include <memory_resource>
+#include <unordered_set>
+#include <utility>
+
+namespace Slicer {
+
+PageSequence::const_iterator::const_iterator(const std::vector<std::shared_ptr<const Chunk>>* chunks,
+                                             std::size_t chunk,
+                                             std::size_t offset)
+    : m_chunks{chunks}
+    , m_chunk{chunk}
+    , m_offset{offset}
+{
+}
+
+PageSequence::const_iterator& PageSequence::const_iterator::operator++()
+{
+    if (++m_offset == (*m_chunks)[m_chunk]->size()) {
+        ++m_chunk;
+        m_offset = 0;
+    }
+
+    return *this;
+}
+
+PageSequence::PageSequence(const std::vector<Record>& records)
+{
+    for (std::size_t first = 0; first < records.size(); first += chunkSize) {
+        const auto last = std::min(first + chunkSize, records.size());
+        m_chunks.push_back(std::make_shared<const Chunk>(records.begin() + first, records.begin() + last));
+    }
+
+    updateChunkStarts();
+}
+
+const PageSequence::Record& PageSequence::at(unsigned int index) const
+{
+    const std::size_t chunk = chunkIndexOf(index);
+
+    return m_chunks.at(chunk)->at(index - m_chunkStarts[chunk]);
+}
+
+void PageSequence::remove(const std::vector<unsigned int>& indexes)
+{
+    if (indexes.empty())
+        return;
+
+    std::vector<unsigned int> sortedIndexes = indexes;
+    std::sort(sortedIndexes.begin(), sortedIndexes.end());
+    sortedIndexes.erase(std::unique(sortedIndexes.begin(), sortedIndexes.end()), sortedIndexes.end());
+
+    auto nextRemoved = sortedIndexes.cbegin();
+
+    while (nextRemoved != sortedIndexes.cend()) {
+        const std::size_t chunk = chunkIndexOf(*nextRemoved);
+        const unsigned int chunkStart = m_chunkStarts[chunk];
+        const Chunk& oldChunk = *m_chunks[chunk];
+        Chunk newChunk;
+        newChunk.reserve(oldChunk.size());
+
+        for (unsigned int i = 0; i < oldChunk.size(); ++i) {
+            if (nextRemoved != sortedIndexes.cend() && *nextRemoved == chunkStart + i)
+                ++nextRemoved;
+            else
+                newChunk.push_back(oldChunk[i]);
+        }
+
+        m_chunks[chunk] = newChunk.empty() ? nullptr : std::make_shared<const Chunk>(std::move(newChunk));
+    }
+
+    m_chunks.erase(std::remove(m_chunks.begin(), m_chunks.end(), nullptr), m_chunks.end());
+    updateChunkStarts();
+    packIfFragmented();
+}
+
+void PageSequence::rotate(const std::vector<unsigned int>& indexes, int quarterTurns)
+{
+    if (indexes.empty() || quarterTurns % 4 == 0)
+        return;
+
+    std::vector<unsigned int> sortedIndexes = indexes;
+    std::sort(sortedIndexes.begin(), sortedIndexes.end());
+    sortedIndexes.erase(std::unique(sortedIndexes.begin(), sortedIndexes.end()), sortedIndexes.end());
+
+    auto nextRotated = sortedIndexes.cbegin();
+
+    while (nextRotated != sortedIndexes.cend()) {
+        const std::size_t chunk = chunkIndexOf(*nextRotated);
+        const unsigned int chunkEnd = m_chunkStarts[chunk] + static_cast<unsigned>(m_chunks[chunk]->size());
+        Chunk newChunk = *m_chunks[chunk];
+
+        for (; nextRotated != sortedIndexes.cend() && *nextRotated < chunkEnd; ++nextRotated) {
+            int& rotation = newChunk.at(*nextRotated - m_chunkStarts[chunk]).rotation;
+            rotation = (((rotation + 90 * quarterTurns) % 360) + 360) % 360;
+        }
+
+        m_chunks[chunk] = std::make_shared<const Chunk>(std::move(newChunk));
+    }
+}
+
+void PageSequence::moveRange(unsigned int first, unsigned int last, unsigned int destination)
+{
+    if (destination == first)
+        return;
+
+    const unsigned int count = last - first + 1;
+
+    // Cut at both ends of the range and where it goes, then move whole chunks
+    if (destination < first) {
+        const std::size_t to = splitAt(destination);
+        const std::size_t from = splitAt(first);
+        const std::size_t end = splitAt(last + 1);
+        std::rotate(m_chunks.begin() + to, m_chunks.begin() + from, m_chunks.begin() + end);
+    }
+    else {
+        const std::size_t from = splitAt(first);
+        const std::size_t middle = splitAt(last + 1);
+        const std::size_t end = splitAt(destination + count);
+        std::rotate(m_chunks.begin() + from, m_chunks.begin() + middle, m_chunks.begin() + end);
+    }
+
+    updateChunkStarts();
+    packIfFragmented();
+}
+
+std::size_t PageSequence::sizeInBytesNotSharedWith(const PageSequence& other) const
+{
+    // Looked up once per chunk, and dropped on return, as in EditPagesCommand
+    std::pmr::monotonic_buffer_resource arena{(other.m_chunks.size() + 1) * 4 * sizeof(void*)};
+    std::pmr::unordered_set<const Chunk*> otherChunks{&arena};
+    otherChunks.reserve(other.m_chunks.size());
+    for (const auto& chunk : other.m_chunks)
+        otherChunks.insert(chunk.get());
+
+    std::size_t size = m_chunks.size() * (sizeof(std::shared_ptr<const Chunk>) + sizeof(unsigned int));
+
+    for (const auto& chunk : m_chunks)
+        if (otherChunks.count(chunk.get()) == 0)
+            size += sizeof(Chunk) + chunk->size() * sizeof(Record);
+
+    return size;
+}
+
+std::size_t PageSequence::chunkIndexOf(unsigned int index) const
+{
+    // The last chunk starting at or before index
+    const auto it = std::upper_bound(m_chunkStarts.begin(), m_chunkStarts.end(), index);
+
+    return static_cast<std::size_t>(it - m_chunkStarts.begin()) - 1;
+}
+
+std::size_t PageSequence::splitAt(unsigned int index)
+{
+    if (index >= m_size)
+        return m_chunks.size();
+
+    const std::size_t chunk = chunkIndexOf(index);
+    const unsigned int offset = index - m_chunkStarts[chunk];
+
+    if (offset == 0)
+        return chunk;
+
+    const Chunk& oldChunk = *m_chunks[chunk];
+    auto head = std::make_shared<const Chunk>(oldChunk.begin(), oldChunk.begin() + offset);
+    auto tail = std::make_shared<const Chunk>(oldChunk.begin() + offset, oldChunk.end());
+
+    m_chunks[chunk] = std::move(head);
+    m_chunks.insert(m_chunks.begin() + static_cast<std::ptrdiff_t>(chunk) + 1, std::move(tail));
+    m_chunkStarts.insert(m_chunkStarts.begin() + static_cast<std::ptrdiff_t>(chunk) + 1, index);
+
+    return chunk + 1;
+}
+
+void PageSequence::updateChunkStarts()
+{
+    m_chunkStarts.resize(m_chunks.size());
+    m_size = 0;
+
+    for (std::size_t i = 0; i < m_chunks.size(); ++i) {
+        m_chunkStarts[i] = m_size;
+        m_size += static_cast<unsigned>(m_chunks[i]->size());
+    }
+}
+
+void PageSequence::packIfFragmented()
+{
+    // Twice as many chunks as needed: lookups and copies are getting slower
+    // than the one-off cost of packing everything again
+    const std::size_t neededChunks = (m_size + chunkSize - 1) / chunkSize;
+
+    if (m_chunks.size() <= 2 * neededChunks + 4)
+        return;
+
+    const std::vector<Record> records(begin(), end());
+    *this = PageSequence{records};
+}
+
+} // namespace Slicer
@@ -0,0 +1,112 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PAGESEQUENCE_HPP
+#define PAGESEQUENCE_HPP
+
+#include "page.hpp"
+#include <iterator>
+#include <memory>
+#include <vector>
+
+namespace Slicer {
+
+// The order and rotation of the pages of a document, as plain values.
+// Multi-step edits are applied to a PageSequence, where nothing is listening,
+// and the result is handed to Document::setPageSequence(), which only touches
+// the part of the page list that actually changed.
+//
+// Records are stored in immutable chunks shared between copies. Copying a
+// sequence only copies the chunk pointers, and an edit only replaces the
+// chunks it touches, so versions of a document kept for undo cost memory in
+// proportion to what changed between them, not to the size of the document.
+class PageSequence {
+public:
+    struct Record {
+        Glib::RefPtr<Page> page;
+        int rotation;
+    };
+
+private:
+    using Chunk = std::vector<Record>;
+
+public:
+    // Chunks are split by edits, and packed again once they get too fragmented
+    static constexpr unsigned int chunkSize = 64;
+
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Record;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Record*;
+        using reference = const Record&;
+
+        reference operator*() const { return (*m_chunks)[m_chunk]->at(m_offset); }
+        pointer operator->() const { return &**this; }
+        const_iterator& operator++();
+        bool operator==(const const_iterator& other) const { return m_chunk == other.m_chunk && m_offset == other.m_offset; }
+        bool operator!=(const const_iterator& other) const { return !(*this == other); }
+
+    private:
+        friend class PageSequence;
+        const_iterator(const std::vector<std::shared_ptr<const Chunk>>* chunks, std::size_t chunk, std::size_t offset);
+
+        const std::vector<std::shared_ptr<const Chunk>>* m_chunks;
+        std::size_t m_chunk;
+        std::size_t m_offset;
+    };
+
+    PageSequence() = default;
+    explicit PageSequence(const std::vector<Record>& records);
+
+    unsigned int size() const { return m_size; }
+    // O(log n) in the number of chunks
+    const Record& at(unsigned int index) const;
+    const_iterator begin() const { return {&m_chunks, 0, 0}; }
+    const_iterator end() const { return {&m_chunks, m_chunks.size(), 0}; }
+
+    // In a single pass, whatever the order of the indexes
+    void remove(const std::vector<unsigned int>& indexes);
+    // Right for positive turns, left for negative ones
+    void rotate(const std::vector<unsigned int>& indexes, int quarterTurns);
+    // The range ends up starting at destination, as in Document::movePageRange().
+    // Only the chunks at the edges of the range are copied.
+    void moveRange(unsigned int first, unsigned int last, unsigned int destination);
+
+    // Whether both are copies of the same version, sharing every chunk. Equal
+    // sequences made apart aren't.
+    bool isSameVersionAs(const PageSequence& other) const { return m_chunks == other.m_chunks; }
+
+    // What this sequence holds in chunks that other doesn't share
+    std::size_t sizeInBytesNotSharedWith(const PageSequence& other) const;
+
+private:
+    std::vector<std::shared_ptr<const Chunk>> m_chunks;
+    // Index of the first record of each chunk; no chunk is ever empty
+    std::vector<unsigned int> m_chunkStarts;
+    unsigned int m_size = 0;
+
+    std::size_t chunkIndexOf(unsigned int index) const;
+    // Makes a chunk start at index (unless it's the end), returning that chunk's index
+    std::size_t splitAt(unsigned int index);
+    void updateChunkStarts();
+    void packIfFragmented();
+};
+
+} // namespace Slicer
+
+#endif // PAGESEQUENCE_HPP
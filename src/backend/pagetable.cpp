@@ -0,0 +1,77 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "pagetable.hpp"
+
+namespace Slicer {
+
+void PageTable::reserve(unsigned int numberOfPages)
+{
+    m_fileNumbers.reserve(numberOfPages);
+    m_indexesInFile.reserve(numberOfPages);
+    m_widths.reserve(numberOfPages);
+    m_heights.reserve(numberOfPages);
+    m_sourceRotations.reserve(numberOfPages);
+    m_currentRotations.reserve(numberOfPages);
+}
+
+void PageTable::append(const PageListModel::Row& row)
+{
+    const Page::Size size = row.size();
+
+    m_fileNumbers.push_back(row.fileNumber());
+    m_indexesInFile.push_back(row.indexInFile());
+    m_widths.push_back(size.width);
+    m_heights.push_back(size.height);
+    m_sourceRotations.push_back(row.sourceRotation());
+    m_currentRotations.push_back(row.currentRotation());
+}
+
+std::vector<unsigned int> PageTable::pagesWithOrientation(Orientation orientation) const
+{
+    const unsigned int numberOfPages = size();
+    const bool wantsLandscape = orientation == Orientation::Landscape;
+
+    // Flags first, in a branchless loop over the arrays, then the indexes
+    std::vector<unsigned char> isLandscape(numberOfPages);
+
+    for (unsigned int i = 0; i < numberOfPages; ++i) {
+        const bool isTurned = (m_currentRotations[i] / 90) % 2 != 0;
+        const int shownWidth = isTurned ? m_heights[i] : m_widths[i];
+        const int shownHeight = isTurned ? m_widths[i] : m_heights[i];
+        isLandscape[i] = shownWidth > shownHeight;
+    }
+
+    std::vector<unsigned int> result;
+
+    for (unsigned int i = 0; i < numberOfPages; ++i)
+        if ((isLandscape[i] != 0) == wantsLandscape)
+            result.push_back(i);
+
+    return result;
+}
+
+double PageTable::totalArea() const
+{
+    double area = 0;
+
+    for (unsigned int i = 0; i < size(); ++i)
+        area += static_cast<double>(m_widths[i]) * m_heights[i];
+
+    return area;
+}
+
+} // namespace Slicer
@@ -0,0 +1,67 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PAGETABLE_HPP
+#define PAGETABLE_HPP
+
+#include "pagelistmodel.hpp"
+#include <vector>
+
+namespace Slicer {
+
+// The metadata of every page of a document, one array per field, in document
+// order. Document builds it on demand and keeps it until the next edit, so
+// that questions about the whole document are loops over plain arrays
+// instead of walks over thousands of Page objects spread across the heap.
+class PageTable {
+public:
+    enum class Orientation {
+        Portrait,
+        Landscape
+    };
+
+    PageTable() = default;
+
+    void reserve(unsigned int numberOfPages);
+    void append(const PageListModel::Row& row);
+
+    unsigned int size() const { return static_cast<unsigned>(m_widths.size()); }
+
+    const std::vector<unsigned int>& fileNumbers() const { return m_fileNumbers; }
+    const std::vector<unsigned int>& indexesInFile() const { return m_indexesInFile; }
+    // Before rotations, in points
+    const std::vector<int>& widths() const { return m_widths; }
+    const std::vector<int>& heights() const { return m_heights; }
+    const std::vector<int>& sourceRotations() const { return m_sourceRotations; }
+    const std::vector<int>& currentRotations() const { return m_currentRotations; }
+
+    // As the pages are shown, rotations included. Square pages are portrait.
+    std::vector<unsigned int> pagesWithOrientation(Orientation orientation) const;
+    // In square points
+    double totalArea() const;
+
+private:
+    std::vector<unsigned int> m_fileNumbers;
+    std::vector<unsigned int> m_indexesInFile;
+    std::vector<int> m_widths;
+    std::vector<int> m_heights;
+    std::vector<int> m_sourceRotations;
+    std::vector<int> m_currentRotations;
+};
+
+} // namespace Slicer
+
+#endif // PAGETABLE_HPP
@@ -1,58 +1,1134 @@
 #include "pdfsaver.hpp"
+#include "cpuresources.hpp"
+#include "mappedinputsource.hpp"
+#include "metrics.hpp"
+#include "remotefile.hpp"
 #include "tempfile.hpp"
+#include "trace.hpp"
+#include <glibmm/checksum.h>
+#include <qpdf/DLL.h>
+#include <qpdf/Pl_Count.hh>
+#include <qpdf/Pl_StdioFile.hh>
+#include <qpdf/QPDFOutlineDocumentHelper.hh>
 #include <qpdf/QPDFWriter.hh>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
 #include <range/v3/view/iota.hpp>
 #include <range/v3/view/set_algorithm.hpp>
 
 namespace Slicer {
 
-PdfSaver::PdfSaver(const SaveData& saveData)
-    : m_saveData{saveData}
+std::string PdfSaver::writeProfileName(WriteProfile profile)
 {
-    for (const auto& file : m_saveData.files) {
-        auto qpdf = std::make_unique<QPDF>();
-        qpdf->processFile(file->get_path().c_str());
-        auto qpdfPageDocumentHelper = std::make_unique<QPDFPageDocumentHelper>(*qpdf);
-        std::vector<QPDFPageObjectHelper> pages = qpdfPageDocumentHelper->getAllPages();
+    switch (profile) {
+    case WriteProfile::Default:
+        return "default";
+    case WriteProfile::Smallest:
+        return "smallest";
+    case WriteProfile::Fastest:
+        return "fastest";
+    case WriteProfile::FastWebView:
+        return "web";
+    }
+
+    return "default";
+}
 
-        qpdfPageDocumentHelper->pushInheritedAttributesToPage();
+std::optional<PdfSaver::WriteProfile> PdfSaver::writeProfileFromName(const std::string& name)
+{
+    for (WriteProfile profile : {WriteProfile::Default,
+                                 WriteProfile::Smallest,
+                                 WriteProfile::Fastest,
+                                 WriteProfile::FastWebView})
+        if (writeProfileName(profile) == name)
+            return profile;
 
-        m_filesData.emplace_back(FileData{std::move(qpdf),
-                                          std::move(qpdfPageDocumentHelper),
-                                          std::move(pages)});
+    return {};
+}
+
+std::string PdfSaver::resourceCleanupName(ResourceCleanup cleanup)
+{
+    switch (cleanup) {
+    case ResourceCleanup::WhenPagesLeftOut:
+        return "auto";
+    case ResourceCleanup::Always:
+        return "always";
+    case ResourceCleanup::Never:
+        return "never";
     }
+
+    return "auto";
+}
+
+std::optional<PdfSaver::ResourceCleanup> PdfSaver::resourceCleanupFromName(const std::string& name)
+{
+    for (ResourceCleanup cleanup : {ResourceCleanup::WhenPagesLeftOut,
+                                    ResourceCleanup::Always,
+                                    ResourceCleanup::Never})
+        if (resourceCleanupName(cleanup) == name)
+            return cleanup;
+
+    return {};
+}
+
+void PdfSaver::ParsedFileCache::clear()
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_files.clear();
+    m_shellPath.clear();
+    m_shell.reset();
+}
+
+void PdfSaver::ParsedFileCache::forget(const std::string& filePath)
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_files.erase(filePath);
+
+    if (m_shellPath == filePath) {
+        m_shellPath.clear();
+        m_shell.reset();
+    }
+}
+
+void PdfSaver::ParsedFileCache::prepare(const SaveData& saveData)
+{
+    const Trace::Span span{"ParsedFileCache prepare"};
+
+    if (saveData.files.empty() || saveData.pages.empty())
+        return;
+
+    std::vector<bool> isFileUsed(saveData.files.size(), false);
+    isFileUsed.front() = true;
+    for (const PageData& page : saveData.pages)
+        isFileUsed.at(page.file) = true;
+
+    for (std::size_t i = 0; i < saveData.files.size(); ++i) {
+        const std::string path = saveData.files.at(i)->get_path();
+
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            const bool isReady = i == 0 ? m_shell != nullptr && m_shellPath == path : m_files.count(path) > 0;
+
+            if (!isFileUsed.at(i) || isReady)
+                continue;
+        }
+
+        std::shared_ptr<FileData> fileData;
+        try {
+            fileData = std::make_shared<FileData>(openFile(saveData.files.at(i)));
+        }
+        catch (const std::exception&) {
+            // The save parses it again, and tells what's wrong with it
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock{m_mutex};
+        if (i == 0) {
+            m_shellPath = path;
+            m_shell = std::move(fileData);
+        }
+        else {
+            m_files.emplace(path, std::move(fileData));
+        }
+    }
+}
+
+bool PdfSaver::ParsedFileCache::contains(const std::string& filePath) const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+
+    return m_files.count(filePath) > 0 || (m_shell != nullptr && m_shellPath == filePath);
+}
+
+PdfSaver::PdfSaver(SaveData saveData, Mode mode, const Monitor& monitor)
+    : m_saveData{std::move(saveData)}
+    , m_mode{mode}
+    , m_monitor{monitor}
+{
+    const Trace::Span span{"PdfSaver parse"};
+
+    // Files whose pages were all removed are never parsed; their entry stays empty.
+    // The first file is always needed: it's the shell of the result.
+    const std::vector<bool> isFileUsed = usedFiles();
+
+    // An unchanged file may only need to be copied: it's opened once it's known not to be
+    std::vector<std::size_t> filesToOpen;
+    for (std::size_t i = 0; i < m_saveData.files.size() && !m_saveData.isUnchanged; ++i)
+        if (i == 0 || (m_mode == Mode::Default && isFileUsed.at(i)))
+            filesToOpen.push_back(i);
+
+    m_filesData.resize(m_saveData.files.size());
+
+    parseFiles(filesToOpen.size(), [this, &filesToOpen](std::size_t i) {
+        m_filesData.at(filesToOpen.at(i)) = openFile(m_saveData.files.at(filesToOpen.at(i)));
+    });
+}
+
+PdfSaver::PdfSaver(SaveData saveData,
+                   const std::shared_ptr<ParsedFileCache>& cache,
+                   const Monitor& monitor)
+    : m_saveData{std::move(saveData)}
+    , m_mode{Mode::Default}
+    , m_cache{cache}
+    , m_monitor{monitor}
+{
+    const Trace::Span span{"PdfSaver parse"};
+
+    const std::vector<bool> isFileUsed = usedFiles();
+
+    m_filesData.resize(m_saveData.files.size());
+    m_cachedFilesData.resize(m_saveData.files.size());
+
+    // The shell gets modified by persist(), so it can't be shared through the
+    // cache: only a spare one, prepared for a single save, is taken from it.
+    // An unchanged file is opened once it's known it can't just be copied.
+    std::vector<std::size_t> filesToParse;
+    if (!m_saveData.isUnchanged && !takePreparedShell())
+        filesToParse.push_back(0);
+
+    {
+        std::lock_guard<std::mutex> lock{cache->m_mutex};
+
+        for (std::size_t i = 1; i < m_saveData.files.size(); ++i) {
+            if (!isFileUsed.at(i))
+                continue;
+
+            if (auto it = cache->m_files.find(m_saveData.files.at(i)->get_path()); it != cache->m_files.end())
+                m_cachedFilesData.at(i) = it->second;
+            else
+                filesToParse.push_back(i);
+        }
+    }
+
+    parseFiles(filesToParse.size(), [this, &filesToParse](std::size_t i) {
+        const std::size_t fileNumber = filesToParse.at(i);
+        FileData fileData = openFile(m_saveData.files.at(fileNumber));
+
+        if (fileNumber == 0)
+            m_filesData.at(0) = std::move(fileData);
+        else
+            m_cachedFilesData.at(fileNumber) = std::make_shared<FileData>(std::move(fileData));
+    });
+
+    std::lock_guard<std::mutex> lock{cache->m_mutex};
+
+    for (std::size_t fileNumber : filesToParse)
+        if (fileNumber != 0)
+            cache->m_files.emplace(m_saveData.files.at(fileNumber)->get_path(), m_cachedFilesData.at(fileNumber));
+}
+
+std::vector<bool> PdfSaver::usedFiles() const
+{
+    std::vector<bool> isFileUsed(m_saveData.files.size(), false);
+
+    for (const PageData& page : m_saveData.pages)
+        isFileUsed.at(page.file) = true;
+
+    return isFileUsed;
+}
+
+void PdfSaver::parseFiles(std::size_t count, const std::function<void(std::size_t)>& parse)
+{
+    std::size_t parsed = 0;
+    std::mutex parsedMutex;
+    reportProgress(Progress::Stage::Parsing, 0);
+
+    runConcurrently(count, [this, &parse, &parsed, &parsedMutex, count](std::size_t i) {
+        throwIfCanceled();
+        parse(i);
+
+        // Counted and reported together, so that reports never go backwards
+        std::lock_guard<std::mutex> lock{parsedMutex};
+        reportProgress(Progress::Stage::Parsing, static_cast<double>(++parsed) / static_cast<double>(count));
+    });
+}
+
+void PdfSaver::runConcurrently(std::size_t count, const std::function<void(std::size_t)>& task)
+{
+    // Parsing is what takes time, and every QPDF is independent of the others
+    // until persist() puts the pages together, so files are parsed concurrently.
+    // Each worker takes the next file when done, so the slowest file sets the pace.
+    std::vector<std::exception_ptr> errors(count);
+    std::atomic<std::size_t> next{0};
+
+    auto worker = [&]() {
+        for (std::size_t i = next++; i < count; i = next++) {
+            try {
+                task(i);
+            }
+            catch (...) {
+                errors.at(i) = std::current_exception();
+            }
+        }
+    };
+
+    const std::size_t numberOfThreads = std::min<std::size_t>(CpuResources::availableCores(), count);
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < numberOfThreads; ++i)
+        threads.emplace_back(worker);
+
+    worker();
+
+    for (std::thread& thread : threads)
+        thread.join();
+
+    for (const std::exception_ptr& error : errors)
+        if (error)
+            std::rethrow_exception(error);
+}
+
+static std::uint64_t sizeOf(const Glib::RefPtr<Gio::File>& file)
+{
+    try {
+        return static_cast<std::uint64_t>(file->query_info(G_FILE_ATTRIBUTE_STANDARD_SIZE)->get_size());
+    }
+    catch (const Glib::Error&) {
+        // Not created yet
+        return 0;
+    }
+}
+
+PdfSaver::FileData PdfSaver::openFile(const Glib::RefPtr<Gio::File>& file)
+{
+    auto qpdf = std::make_unique<QPDF>();
+    const std::string path = file->get_path();
+
+    // QPDF reads the whole cross-reference table, and the page tree
+    RemoteFile::waitUntilComplete(path);
+
+    // Mapped when possible, see MappedInputSource; the source lives as long
+    // as the QPDF, and the streams copied out of it, need it
+    std::unique_ptr<MappedInputSource> source;
+    if (MappedFile::isUsableFor(path)) {
+        try {
+            source = std::make_unique<MappedInputSource>(path);
+        }
+        catch (const std::runtime_error&) {
+            // Read through stdio then
+        }
+    }
+
+    if (source != nullptr) {
+#if defined(QPDF_MAJOR_VERSION) && QPDF_MAJOR_VERSION >= 11
+        qpdf->processInputSource(std::shared_ptr<InputSource>{std::move(source)});
+#else
+        qpdf->processInputSource(PointerHolder<InputSource>{source.release()});
+#endif
+    }
+    else {
+        qpdf->processFile(path.c_str());
+    }
+
+    auto qpdfPageDocumentHelper = std::make_unique<QPDFPageDocumentHelper>(*qpdf);
+    std::vector<QPDFPageObjectHelper> pages = qpdfPageDocumentHelper->getAllPages();
+
+    qpdfPageDocumentHelper->pushInheritedAttributesToPage();
+
+    // QPDF holds what it read of the file, and the file itself when it's mapped
+    return FileData{std::move(qpdf),
+                    std::move(qpdfPageDocumentHelper),
+                    std::move(pages),
+                    Metrics::MemoryCharge{Metrics::Memory::SaveFiles, static_cast<std::size_t>(sizeOf(file))}};
+}
+
+PdfSaver::Canceled::Canceled()
+    : std::runtime_error{"The save was canceled"}
+{
+}
+
+void PdfSaver::throwIfCanceled() const
+{
+    if (m_monitor.canceled != nullptr && *m_monitor.canceled)
+        throw Canceled{};
+}
+
+void PdfSaver::reportProgress(Progress::Stage stage, double stageFraction, std::uint64_t bytesWritten)
+{
+    if (!m_monitor.onProgress)
+        return;
+
+    // Where each stage starts, as a share of the whole save. Writing is
+    // what takes longest on big documents.
+    static constexpr std::array<double, 4> stageStarts = {0.0, 0.2, 0.5, 1.0};
+    const auto index = static_cast<std::size_t>(stage);
+    const double end = index + 1 < stageStarts.size() ? stageStarts.at(index + 1) : 1.0;
+    const double fraction = stageStarts.at(index) + (end - stageStarts.at(index)) * std::clamp(stageFraction, 0.0, 1.0);
+
+    std::lock_guard<std::mutex> lock{m_progressMutex};
+    m_monitor.onProgress(Progress{stage, fraction, bytesWritten});
+}
+
+// A page can be in the result more than once, e.g. from a file added twice.
+// Repeats get a page object of their own, sharing the contents and resources
+// of the first one, so that each keeps its own rotation.
+static QPDFPageObjectHelper pageToPlace(QPDF& destinationPDF,
+                                        QPDFPageObjectHelper page,
+                                        std::set<std::pair<const QPDF*, QPDFObjGen>>& placedPages)
+{
+    QPDFObjectHandle object = page.getObjectHandle();
+
+    if (placedPages.emplace(object.getOwningQPDF(), object.getObjGen()).second)
+        return page;
+
+    // The first one was copied over when placed, and the same copy comes back here
+    if (object.getOwningQPDF() != &destinationPDF)
+        object = destinationPDF.copyForeignObject(object);
+
+    return QPDFPageObjectHelper{destinationPDF.makeIndirectObject(object.shallowCopy())};
 }
 
 void PdfSaver::save(const Glib::RefPtr<Gio::File>& destinationFile)
 {
-    Glib::RefPtr<Gio::File> tempFile = TempFile::generate();
-    persist(tempFile);
+    throwIfCanceled();
+
+    const std::uint64_t size = replaceFile(destinationFile, [this](const Glib::RefPtr<Gio::File>& tempFile) {
+        if (copiesUnchangedFile()) {
+            const auto copyStart = std::chrono::steady_clock::now();
+            reportProgress(Progress::Stage::Writing, 0);
+            TempFile::snapshotTo(m_saveData.files.front(), tempFile);
+            m_lastWriteDuration = std::chrono::steady_clock::now() - copyStart;
+            return;
+        }
+
+        openShell();
+
+        if (!persistIncrementally(tempFile))
+            persist(tempFile);
+    });
+
+    reportProgress(Progress::Stage::Done, 1, size);
+}
+
+void PdfSaver::saveToDescriptor(int descriptor)
+{
+    throwIfCanceled();
+
+    // The stdio file gets a descriptor of its own to close, leaving the given one open
+    const int duplicate = dup(descriptor);
+    std::FILE* stream = duplicate < 0 ? nullptr : fdopen(duplicate, "wb");
+    if (stream == nullptr) {
+        if (duplicate >= 0)
+            close(duplicate);
+
+        throw std::runtime_error("Can't write to the output: " + std::string{std::strerror(errno)});
+    }
+
+    const std::unique_ptr<std::FILE, int (*)(std::FILE*)> streamCloser{stream, &std::fclose};
+
+    // QPDFWriter only ever writes forward to a pipeline, so the output doesn't
+    // need to seek; linearizing makes its first pass into memory
+    Pl_StdioFile file{"save output", stream};
+    Pl_Count count{"save output count", &file};
+
+    const WriteTarget target{
+        [&count](QPDFWriter& writer) { writer.setOutputPipeline(&count); },
+        [&count]() { return static_cast<std::uint64_t>(count.getCount()); }};
+
+    openShell();
+    m_lastWriteDuration = write(assemble(), target);
+
+    if (std::fflush(stream) != 0)
+        throw std::runtime_error("Can't write to the output: " + std::string{std::strerror(errno)});
+
+    Metrics::add(Metrics::Counter::FilesSaved);
+    Metrics::add(Metrics::Counter::BytesSaved, static_cast<std::uint64_t>(count.getCount()));
+
+    reportProgress(Progress::Stage::Done, 1, static_cast<std::uint64_t>(count.getCount()));
+}
+
+std::uint64_t PdfSaver::replaceFile(const Glib::RefPtr<Gio::File>& destinationFile,
+                                    const std::function<void(const Glib::RefPtr<Gio::File>&)>& persist)
+{
+    // Writing next to the destination makes the final move a rename within
+    // the same filesystem: the output is written once, and it appears whole.
+    // Destinations without a local path (e.g. remote ones) go through the temp dir.
+    Glib::RefPtr<Gio::File> tempFile = destinationFile->get_path().empty()
+                                           ? TempFile::generate()
+                                           : TempFile::generateNextTo(destinationFile);
+    const auto startTime = std::chrono::steady_clock::now();
+
+    try {
+        persist(tempFile);
+
+        // The last chance to cancel before the destination is replaced
+        throwIfCanceled();
+    }
+    catch (...) {
+        try {
+            tempFile->remove();
+        }
+        catch (const Glib::Error&) {
+            // The partial file may not even exist
+        }
+
+        throw;
+    }
+
+    const std::uint64_t size = sizeOf(tempFile);
     tempFile->move(destinationFile, Gio::FILE_COPY_OVERWRITE);
+
+    const auto duration = std::chrono::steady_clock::now() - startTime;
+    Metrics::add(Metrics::Counter::FilesSaved);
+    Metrics::add(Metrics::Counter::BytesSaved, size);
+    Metrics::add(Metrics::Counter::SaveMilliseconds,
+                 static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(duration).count()));
+
+    return size;
+}
+
+void PdfSaver::openAllUsedFiles()
+{
+    // In low memory mode only the shell was parsed up front. Every part reads
+    // from the same files, so here they are all opened, once.
+    const std::vector<bool> isFileUsed = usedFiles();
+    std::vector<std::size_t> filesToOpen;
+    for (std::size_t i = 0; i < m_saveData.files.size(); ++i)
+        if (isFileUsed.at(i) && !m_filesData.at(i).qpdf && (m_cachedFilesData.empty() || !m_cachedFilesData.at(i)))
+            filesToOpen.push_back(i);
+
+    parseFiles(filesToOpen.size(), [this, &filesToOpen](std::size_t i) {
+        m_filesData.at(filesToOpen.at(i)) = openFile(m_saveData.files.at(filesToOpen.at(i)));
+    });
+}
+
+void PdfSaver::openShell()
+{
+    if (m_filesData.front().qpdf || takePreparedShell())
+        return;
+
+    parseFiles(1, [this](std::size_t) {
+        m_filesData.front() = openFile(m_saveData.files.front());
+    });
+}
+
+bool PdfSaver::takePreparedShell()
+{
+    if (m_cache == nullptr)
+        return false;
+
+    std::shared_ptr<FileData> shell;
+    {
+        std::lock_guard<std::mutex> lock{m_cache->m_mutex};
+
+        if (m_cache->m_shell == nullptr || m_cache->m_shellPath != m_saveData.files.front()->get_path())
+            return false;
+
+        shell = std::move(m_cache->m_shell);
+        m_cache->m_shellPath.clear();
+    }
+
+    m_filesData.front() = std::move(*shell);
+
+    return true;
+}
+
+bool PdfSaver::copiesUnchangedFile() const
+{
+    return m_saveData.isUnchanged && m_incrementalUpdates && m_writeProfile == WriteProfile::Default
+           && !m_deduplicateStreams && m_resourceCleanup != ResourceCleanup::Always
+           && !m_imageDownsampling.has_value() && !m_encryption.has_value();
+}
+
+QPDFPageObjectHelper& PdfSaver::sourcePage(const PageData& page)
+{
+    FileData& fileData = m_cachedFilesData.empty() || !m_cachedFilesData.at(page.file)
+                             ? m_filesData.at(page.file)
+                             : *m_cachedFilesData.at(page.file);
+
+    return fileData.qpdfPages.at(page.pageNumber);
+}
+
+// The parsed files are only read from: the pages are copied into a new file
+// per part, which is the only one touched. The copied streams keep reading
+// from the parsed files while written, and a QPDF can't be read from two
+// threads, so parts are written one after the other. Each one is released
+// once written, so memory follows the largest part, not all of them.
+void PdfSaver::savePart(std::size_t firstPage,
+                        std::size_t endPage,
+                        const Glib::RefPtr<Gio::File>& destinationFile)
+{
+    QPDF part;
+    part.emptyPDF();
+    QPDFPageDocumentHelper partPageDocumentHelper{part};
+
+    QPDFObjectHandle info = m_filesData.front().qpdf->getTrailer().getKey("/Info");
+    if (info.isDictionary())
+        part.getTrailer().replaceKey("/Info", part.copyForeignObject(info));
+
+    std::set<std::pair<const QPDF*, QPDFObjGen>> placedPages;
+
+    for (std::size_t i = firstPage; i < endPage; ++i) {
+        const PageData& page = m_saveData.pages.at(i);
+        QPDFObjectHandle copiedObject = part.copyForeignObject(sourcePage(page).getObjectHandle());
+        QPDFPageObjectHelper copiedPage = pageToPlace(part, QPDFPageObjectHelper{copiedObject}, placedPages);
+        copiedPage.rotatePage(page.rotation, false);
+        partPageDocumentHelper.addPage(copiedPage, false);
+        throwIfCanceled();
+    }
+
+    // A part leaves out the pages of every other part
+    if (m_resourceCleanup != ResourceCleanup::Never)
+        partPageDocumentHelper.removeUnreferencedResources();
+
+    const double total = static_cast<double>(m_saveData.pages.size());
+    const std::uint64_t size = replaceFile(destinationFile, [&](const Glib::RefPtr<Gio::File>& tempFile) {
+        m_lastWriteDuration += write(part, tempFile, static_cast<double>(firstPage) / total, static_cast<double>(endPage) / total);
+    });
+
+    reportProgress(Progress::Stage::Writing, static_cast<double>(endPage) / total, size);
+}
+
+void PdfSaver::saveParts(const std::vector<Part>& parts)
+{
+    const Trace::Span span{"PdfSaver::saveParts"};
+    throwIfCanceled();
+    openAllUsedFiles();
+
+    m_lastWriteDuration = std::chrono::duration<double>{0};
+
+    for (const Part& part : parts)
+        savePart(part.firstPage, part.endPage, part.destinationFile);
+
+    reportProgress(Progress::Stage::Done, 1);
+}
+
+// Streams that only say how their data is encoded, like most content
+// streams, could be anything, so only those saying more, like the sizes of
+// an image or a font, are taken to be alike when their dictionaries are
+static std::string streamDictionaryKey(QPDFObjectHandle stream);
+
+static std::optional<std::string> lookAlikeKey(QPDFObjectHandle stream)
+{
+    const std::set<std::string> keys = stream.getDict().getKeys();
+    const bool describesData = std::any_of(keys.begin(), keys.end(), [](const std::string& name) {
+        return name != "/Length" && name != "/Filter" && name != "/DecodeParms";
+    });
+
+    if (!describesData)
+        return std::nullopt;
+
+    return streamDictionaryKey(stream);
+}
+
+std::uint64_t PdfSaver::estimatedSizeOf(QPDFObjectHandle object, SizeCount& counted) const
+{
+    // What the writer usually spends on an object besides its stream data
+    static constexpr std::uint64_t objectOverhead = 64;
+
+    const bool deduplicates = deduplicatesStreams();
+    std::uint64_t size = 0;
+    std::vector<QPDFObjectHandle> pending = {object};
+
+    while (!pending.empty()) {
+        QPDFObjectHandle current = pending.back();
+        pending.pop_back();
+
+        if (current.isIndirect() && !counted.objects.emplace(current.getOwningQPDF(), current.getObjGen()).second)
+            continue;
+
+        // A stream merged into one that looks alike isn't written
+        if (current.isStream() && deduplicates)
+            if (std::optional<std::string> key = lookAlikeKey(current))
+                if (!counted.streams.insert(*key).second)
+                    continue;
+
+        if (current.isIndirect())
+            size += objectOverhead;
+
+        if (current.isStream()) {
+            QPDFObjectHandle dictionary = current.getDict();
+            QPDFObjectHandle length = dictionary.getKey("/Length");
+            if (length.isInteger() && length.getIntValue() > 0)
+                size += static_cast<std::uint64_t>(length.getIntValue());
+
+            pending.push_back(dictionary);
+        }
+        else if (current.isDictionary()) {
+            // Going up to the page tree, or back from an annotation to its
+            // page, would count the whole file
+            for (const std::string& key : current.getKeys())
+                if (key != "/Parent" && key != "/P")
+                    pending.push_back(current.getKey(key));
+        }
+        else if (current.isArray()) {
+            for (int i = 0; i < current.getArrayNItems(); ++i)
+                pending.push_back(current.getArrayItem(i));
+        }
+    }
+
+    return size;
+}
+
+// The header, the cross reference table and the trailer
+static constexpr std::uint64_t fileOverhead = 512;
+
+std::uint64_t PdfSaver::estimatedSize()
+{
+    const Trace::Span span{"PdfSaver::estimatedSize"};
+    openAllUsedFiles();
+
+    SizeCount counted;
+    std::uint64_t size = fileOverhead;
+
+    for (const PageData& page : m_saveData.pages)
+        size += estimatedSizeOf(sourcePage(page).getObjectHandle(), counted);
+
+    // The result is written out of the first file, with what its catalog
+    // holds, like the outline. Its pages left out of the result are only
+    // reachable from there through the page tree, so they are skipped.
+    QPDF& shell = *m_filesData.front().qpdf;
+    for (QPDFPageObjectHelper& page : m_filesData.front().qpdfPages)
+        counted.objects.emplace(&shell, page.getObjectHandle().getObjGen());
+
+    size += estimatedSizeOf(shell.getTrailer(), counted);
+
+    return size;
+}
+
+std::uint64_t PdfSaver::estimatedSizeOfPart(std::size_t firstPage, std::size_t endPage)
+{
+    openAllUsedFiles();
+
+    // A part is a new file with the pages and the document info, see savePart()
+    SizeCount counted;
+    std::uint64_t size = fileOverhead + estimatedSizeOf(m_filesData.front().qpdf->getTrailer().getKey("/Info"), counted);
+
+    for (std::size_t i = firstPage; i < endPage; ++i)
+        size += estimatedSizeOf(sourcePage(m_saveData.pages.at(i)).getObjectHandle(), counted);
+
+    return size;
+}
+
+std::vector<PdfSaver::PartEstimate> PdfSaver::partsOfSize(std::uint64_t maxSizeInBytes)
+{
+    const Trace::Span span{"PdfSaver::partsOfSize"};
+    openAllUsedFiles();
+
+    std::vector<PartEstimate> parts;
+
+    // Objects shared by the pages of a part, like fonts, are written once per
+    // part, so they only count for the first page of the part that uses them
+    SizeCount counted;
+    std::uint64_t partSize = 0;
+    std::size_t firstPage = 0;
+
+    for (std::size_t i = 0; i < m_saveData.pages.size(); ++i) {
+        const QPDFObjectHandle page = sourcePage(m_saveData.pages.at(i)).getObjectHandle();
+        const std::uint64_t pageSize = estimatedSizeOf(page, counted);
+
+        if (i > firstPage && partSize + pageSize > maxSizeInBytes) {
+            parts.push_back({firstPage, i, partSize});
+
+            // The page starts the next part, where nothing was counted yet
+            firstPage = i;
+            counted = {};
+            partSize = estimatedSizeOf(page, counted);
+        }
+        else {
+            partSize += pageSize;
+        }
+    }
+
+    parts.push_back({firstPage, m_saveData.pages.size(), partSize});
+
+    return parts;
+}
+
+std::vector<Glib::RefPtr<Gio::File>> PdfSaver::savePartsOfSize(std::uint64_t maxSizeInBytes,
+                                                               const DestinationOfPart& destinationOfPart)
+{
+    const Trace::Span span{"PdfSaver::savePartsOfSize"};
+    throwIfCanceled();
+
+    const std::vector<PartEstimate> parts = partsOfSize(maxSizeInBytes);
+
+    m_lastWriteDuration = std::chrono::duration<double>{0};
+    std::vector<Glib::RefPtr<Gio::File>> writtenFiles;
+
+    for (const PartEstimate& part : parts) {
+        writtenFiles.push_back(destinationOfPart(static_cast<unsigned int>(writtenFiles.size() + 1)));
+        savePart(part.firstPage, part.endPage, writtenFiles.back());
+    }
+
+    reportProgress(Progress::Stage::Done, 1);
+
+    return writtenFiles;
+}
+
+std::vector<std::size_t> PdfSaver::outlineStarts()
+{
+    openShell();
+
+    // Where the pages of the first file ended up in the result
+    std::map<QPDFObjGen, std::size_t> positions;
+    const std::vector<QPDFPageObjectHelper>& shellPages = m_filesData.front().qpdfPages;
+
+    for (std::size_t i = 0; i < m_saveData.pages.size(); ++i) {
+        const PageData& page = m_saveData.pages.at(i);
+        if (page.file == 0)
+            positions.emplace(shellPages.at(page.pageNumber).getObjectHandle().getObjGen(), i);
+    }
+
+    std::set<std::size_t> starts = {0};
+    QPDFOutlineDocumentHelper outlines{*m_filesData.front().qpdf};
+
+    // Entries pointing to removed pages, or nowhere, don't start a part
+    for (QPDFOutlineObjectHelper& outline : outlines.getTopLevelOutlines()) {
+        QPDFObjectHandle page = outline.getDestPage();
+        if (!page.isNull())
+            if (auto it = positions.find(page.getObjGen()); it != positions.end())
+                starts.insert(it->second);
+    }
+
+    return {starts.begin(), starts.end()};
+}
+
+namespace {
+    // Passes on how far QPDFWriter got
+    class WriteProgressReporter : public QPDFWriter::ProgressReporter {
+    public:
+        explicit WriteProgressReporter(const std::function<void(int)>& onProgress)
+            : m_onProgress{onProgress}
+        {
+        }
+
+        void reportProgress(int percentage) override
+        {
+            m_onProgress(percentage);
+        }
+
+    private:
+        std::function<void(int)> m_onProgress;
+    };
+}
+
+// Since qpdf 10.1, copied streams read their data straight from the
+// source file, so the source QPDF can be destroyed before writing
+static bool canReleaseForeignFiles()
+{
+    const std::string version = QPDF::QPDFVersion();
+    const auto dot = version.find('.');
+    const int major = std::stoi(version.substr(0, dot));
+    const int minor = dot == std::string::npos ? 0 : std::stoi(version.substr(dot + 1));
+
+    return major > 10 || (major == 10 && minor >= 1);
+}
+
+bool PdfSaver::keepsShellOrder() const
+{
+    for (std::size_t i = 0; i < m_saveData.pages.size(); ++i) {
+        const PageData& page = m_saveData.pages.at(i);
+
+        if (page.file != 0 || (i > 0 && page.pageNumber <= m_saveData.pages.at(i - 1).pageNumber))
+            return false;
+    }
+
+    return true;
+}
+
+bool PdfSaver::leavesPagesOut(const std::vector<std::size_t>& pagesInFiles) const
+{
+    std::vector<std::vector<bool>> isPageUsed(pagesInFiles.size());
+    for (std::size_t i = 0; i < pagesInFiles.size(); ++i)
+        isPageUsed.at(i).resize(pagesInFiles.at(i), false);
+
+    for (const PageData& page : m_saveData.pages)
+        if (page.pageNumber < isPageUsed.at(page.file).size())
+            isPageUsed.at(page.file).at(page.pageNumber) = true;
+
+    // Files with no page in the result don't matter: nothing of them is written
+    for (std::size_t i = 0; i < isPageUsed.size(); ++i) {
+        const std::vector<bool>& used = isPageUsed.at(i);
+        const bool isFileUsed = std::find(used.begin(), used.end(), true) != used.end();
+
+        if ((isFileUsed || i == 0) && std::find(used.begin(), used.end(), false) != used.end())
+            return true;
+    }
+
+    return false;
+}
+
+std::vector<QPDFObjectHandle> PdfSaver::copyForeignPages(QPDF& destinationPDF, std::vector<std::size_t>& pagesInFiles)
+{
+    std::vector<QPDFObjectHandle> copiedPages(m_saveData.pages.size());
+    const bool releaseFiles = canReleaseForeignFiles();
+    std::size_t copiedCount = 0;
+
+    // Which pages of the result come from each file
+    std::vector<std::vector<std::size_t>> pagesByFile(m_saveData.files.size());
+    for (std::size_t i = 0; i < m_saveData.pages.size(); ++i)
+        pagesByFile.at(m_saveData.pages.at(i).file).push_back(i);
+
+    for (std::size_t fileNumber = 1; fileNumber < m_saveData.files.size(); ++fileNumber) {
+        if (pagesByFile.at(fileNumber).empty())
+            continue;
+
+        // Cached files are only read from; otherwise the file is opened now,
+        // in low memory mode, and closed once its pages are copied
+        std::shared_ptr<FileData> fileData = m_cachedFilesData.empty()
+                                                 ? std::make_shared<FileData>(openFile(m_saveData.files.at(fileNumber)))
+                                                 : m_cachedFilesData.at(fileNumber);
+
+        pagesInFiles.at(fileNumber) = fileData->qpdfPages.size();
+
+        for (std::size_t i : pagesByFile.at(fileNumber)) {
+            QPDFPageObjectHelper sourcePage = fileData->qpdfPages.at(m_saveData.pages.at(i).pageNumber);
+            copiedPages.at(i) = destinationPDF.copyForeignObject(sourcePage.getObjectHandle());
+
+            // Copying is the first half of stitching, placing the pages the second
+            throwIfCanceled();
+            reportProgress(Progress::Stage::Stitching,
+                           static_cast<double>(++copiedCount) / static_cast<double>(2 * m_saveData.pages.size()));
+        }
+
+        // Older qpdf versions still read from the source while writing
+        if (m_cachedFilesData.empty() && !releaseFiles)
+            m_filesData.at(fileNumber) = std::move(*fileData);
+    }
+
+    return copiedPages;
+}
+
+static int normalizedRotation(int rotation)
+{
+    return ((rotation % 360) + 360) % 360;
+}
+
+static int rotationOf(QPDFPageObjectHelper& page)
+{
+    QPDFObjectHandle rotate = page.getObjectHandle().getKey("/Rotate");
+
+    return rotate.isInteger() ? normalizedRotation(rotate.getIntValueAsInt()) : 0;
+}
+
+// Offset of the last cross-reference section, or nothing if it's not a plain
+// "xref" table (cross-reference streams would need an update stream of their own)
+static std::optional<std::streamoff> lastXrefTableOffset(const std::string& path)
+{
+    std::ifstream file{path, std::ios::binary};
+    file.seekg(0, std::ios::end);
+    const std::streamoff size = file.tellg();
+    const std::streamoff tailSize = std::min<std::streamoff>(size, 1024);
+
+    std::string tail(static_cast<std::size_t>(tailSize), '\0');
+    file.seekg(size - tailSize);
+    file.read(tail.data(), static_cast<std::streamsize>(tailSize));
+
+    const auto keyword = tail.rfind("startxref");
+    if (keyword == std::string::npos)
+        return {};
+
+    std::istringstream number{tail.substr(keyword + 9)};
+    std::streamoff offset = -1;
+    number >> offset;
+
+    if (offset < 0 || offset >= size)
+        return {};
+
+    std::string start(4, '\0');
+    file.seekg(offset);
+    file.read(start.data(), 4);
+
+    if (start != "xref")
+        return {};
+
+    return offset;
+}
+
+bool PdfSaver::persistIncrementally(const Glib::RefPtr<Gio::File>& destinationFile)
+{
+    const Trace::Span span{"PdfSaver::persistIncrementally"};
+
+    if (!m_incrementalUpdates || m_writeProfile != WriteProfile::Default || m_imageDownsampling.has_value()
+        || m_encryption.has_value() || m_saveData.files.size() != 1 || !m_filesData.front().qpdf)
+        return false;
+
+    QPDF& qpdf = *m_filesData.front().qpdf;
+    std::vector<QPDFPageObjectHelper>& qpdfPages = m_filesData.front().qpdfPages;
+
+    if (qpdf.isEncrypted() || m_saveData.pages.size() != qpdfPages.size())
+        return false;
+
+    std::vector<std::size_t> rotatedPages;
+
+    for (std::size_t i = 0; i < m_saveData.pages.size(); ++i) {
+        const PageData& page = m_saveData.pages.at(i);
+
+        if (page.pageNumber != i)
+            return false;
+
+        if (normalizedRotation(page.rotation) != rotationOf(qpdfPages.at(i)))
+            rotatedPages.push_back(i);
+    }
+
+    if (rotatedPages.size() > maxIncrementalEdits)
+        return false;
+
+    const std::string sourcePath = m_saveData.files.front()->get_path();
+    const std::optional<std::streamoff> previousXref = lastXrefTableOffset(sourcePath);
+
+    if (!previousXref.has_value())
+        return false;
+
+    const auto writeStart = std::chrono::steady_clock::now();
+
+    reportProgress(Progress::Stage::Writing, 0);
+    TempFile::snapshotTo(m_saveData.files.front(), destinationFile);
+
+    if (rotatedPages.empty()) {
+        m_lastWriteDuration = std::chrono::steady_clock::now() - writeStart;
+        return true;
+    }
+
+    std::fstream output{destinationFile->get_path(), std::ios::binary | std::ios::in | std::ios::out};
+    output.seekp(0, std::ios::end);
+    output << "\n";
+
+    // The changed page dictionaries replace the old ones, under the same object numbers
+    std::vector<std::pair<QPDFObjGen, std::streamoff>> offsets;
+
+    for (std::size_t i : rotatedPages) {
+        QPDFObjectHandle page = qpdfPages.at(i).getObjectHandle();
+        qpdfPages.at(i).rotatePage(m_saveData.pages.at(i).rotation, false);
+
+        offsets.emplace_back(page.getObjGen(), output.tellp());
+        output << page.getObjectID() << " " << page.getGeneration() << " obj\n"
+               << page.unparseResolved() << "\nendobj\n";
+    }
+
+    std::sort(offsets.begin(), offsets.end(), [](const auto& a, const auto& b) {
+        return a.first.getObj() < b.first.getObj();
+    });
+
+    const std::streamoff xrefOffset = output.tellp();
+    output << "xref\n";
+
+    for (const auto& [objGen, offset] : offsets)
+        output << objGen.getObj() << " 1\n"
+               << std::setw(10) << std::setfill('0') << offset << " "
+               << std::setw(5) << std::setfill('0') << objGen.getGen() << " n\r\n";
+
+    QPDFObjectHandle trailer = QPDFObjectHandle::newDictionary();
+    QPDFObjectHandle previousTrailer = qpdf.getTrailer();
+
+    for (const char* key : {"/Size", "/Root", "/Info", "/ID"})
+        if (previousTrailer.hasKey(key))
+            trailer.replaceKey(key, previousTrailer.getKey(key));
+
+    trailer.replaceKey("/Prev", QPDFObjectHandle::newInteger(previousXref.value()));
+
+    output << "trailer\n"
+           << trailer.unparse() << "\n"
+           << "startxref\n"
+           << xrefOffset << "\n"
+           << "%%EOF\n";
+
+    output.close();
+
+    if (!output)
+        throw std::runtime_error("Couldn't write the incremental update to " + destinationFile->get_path());
+
+    m_lastWriteDuration = std::chrono::steady_clock::now() - writeStart;
+
+    return true;
 }
 
 void PdfSaver::persist(const Glib::RefPtr<Gio::File>& destinationFile)
 {
+    const Trace::Span span{"PdfSaver::persist"};
+
+    m_lastWriteDuration = write(assemble(), destinationFile);
+}
+
+QPDF& PdfSaver::assemble()
+{
+
     // Use the hollow shell of the first PDF to build the result.
     // This preserves the metadata and outline of that file.
     QPDF* destinationPDF = m_filesData.front().qpdf.get();
     QPDFPageDocumentHelper* destinationPageDocumentHelper = m_filesData.front().qpdfPageDocumentHelper.get();
     const std::vector<QPDFPageObjectHelper> originalPages = destinationPageDocumentHelper->getAllPages();
 
-    for (const auto& qpdfPage : originalPages)
-        destinationPageDocumentHelper->removePage(qpdfPage);
-
-    // Add the wanted pages into the document.
     // It's necessary to keep track of which pages from the original document
-    // got inserted.
+    // are kept.
     std::set<int> preserverdPagesFromOriginalFile;
 
-    for (PageData page : m_saveData.pages) {
-        QPDFPageObjectHelper qpdfPage = m_filesData.at(page.file).qpdfPages.at(page.pageNumber);
-        qpdfPage.rotatePage(page.rotation, false);
-        destinationPageDocumentHelper->addPage(qpdfPage, false);
+    std::vector<std::size_t> pagesInFiles(m_saveData.files.size(), 0);
+    for (std::size_t i = 0; i < m_saveData.files.size(); ++i)
+        if (m_filesData.at(i).qpdf)
+            pagesInFiles.at(i) = m_filesData.at(i).qpdfPages.size();
 
-        if (page.file == 0)
-            preserverdPagesFromOriginalFile.insert(static_cast<int>(page.pageNumber));
+    if (keepsShellOrder()) {
+        // Only the differences are applied: the dropped pages are removed and
+        // the rotated ones rotated. The page tree stays as it is, instead of
+        // being rebuilt with addPage(), which isn't cheap on big files.
+        std::size_t next = 0;
+
+        for (std::size_t pageNumber = 0; pageNumber < originalPages.size(); ++pageNumber) {
+            QPDFPageObjectHelper qpdfPage = originalPages.at(pageNumber);
+
+            if (next < m_saveData.pages.size() && m_saveData.pages.at(next).pageNumber == pageNumber) {
+                const int rotation = m_saveData.pages.at(next).rotation;
+                if (normalizedRotation(rotation) != rotationOf(qpdfPage))
+                    qpdfPage.rotatePage(rotation, false);
+
+                preserverdPagesFromOriginalFile.insert(static_cast<int>(pageNumber));
+                ++next;
+            }
+            else {
+                destinationPageDocumentHelper->removePage(qpdfPage);
+            }
+
+            throwIfCanceled();
+            reportProgress(Progress::Stage::Stitching,
+                           static_cast<double>(pageNumber + 1) / static_cast<double>(originalPages.size()));
+        }
+    }
+    else {
+        for (const auto& qpdfPage : originalPages)
+            destinationPageDocumentHelper->removePage(qpdfPage);
+
+        // In low memory mode, or when the files come from a cache, the pages of
+        // the other files are copied into the result first, and only the copies are touched
+        const bool copiesForeignPages = m_mode == Mode::LowMemory || !m_cachedFilesData.empty();
+
+        std::vector<QPDFObjectHandle> copiedPages;
+        if (copiesForeignPages)
+            copiedPages = copyForeignPages(*destinationPDF, pagesInFiles);
+
+        std::set<std::pair<const QPDF*, QPDFObjGen>> placedPages;
+
+        // Add the wanted pages into the document
+        for (std::size_t i = 0; i < m_saveData.pages.size(); ++i) {
+            const PageData& page = m_saveData.pages.at(i);
+            QPDFPageObjectHelper qpdfPage = pageToPlace(*destinationPDF,
+                                                        page.file == 0 || !copiesForeignPages
+                                                            ? m_filesData.at(page.file).qpdfPages.at(page.pageNumber)
+                                                            : QPDFPageObjectHelper{copiedPages.at(i)},
+                                                        placedPages);
+            qpdfPage.rotatePage(page.rotation, false);
+            destinationPageDocumentHelper->addPage(qpdfPage, false);
+
+            if (page.file == 0)
+                preserverdPagesFromOriginalFile.insert(static_cast<int>(page.pageNumber));
+
+            throwIfCanceled();
+            const double placed = static_cast<double>(i + 1) / static_cast<double>(m_saveData.pages.size());
+            reportProgress(Progress::Stage::Stitching, copiesForeignPages ? 0.5 + placed / 2 : placed);
+        }
     }
 
     // It's necessary to manually delete the page objects of the pages
@@ -66,12 +1142,301 @@ void PdfSaver::persist(const Glib::RefPtr<Gio::File>& destinationFile)
             originalPages.at(static_cast<unsigned>(pageNumber)).getObjectHandle().getObjGen(),
             QPDFObjectHandle::newNull());
 
-    destinationPageDocumentHelper->removeUnreferencedResources();
+    if (m_resourceCleanup == ResourceCleanup::Always
+        || (m_resourceCleanup == ResourceCleanup::WhenPagesLeftOut && leavesPagesOut(pagesInFiles))) {
+        const Trace::Span cleanupSpan{"PdfSaver::removeUnreferencedResources"};
+        destinationPageDocumentHelper->removeUnreferencedResources();
+    }
+
+    throwIfCanceled();
+
+    return *destinationPDF;
+}
+
+// Only what can differ between copies of the same stream: /Length can be
+// an indirect object of its own, and the dictionary may reference streams
+// merged in an earlier round, which is why it's unparsed after rewriting
+static std::string streamDictionaryKey(QPDFObjectHandle stream)
+{
+    QPDFObjectHandle dictionary = stream.getDict();
+    QPDFObjectHandle length = dictionary.getKey("/Length");
+    std::string key = length.isInteger() ? std::to_string(length.getIntValue()) : "?";
+
+    for (const std::string& name : dictionary.getKeys())
+        if (name != "/Length")
+            key += name + " " + dictionary.getKey(name).unparse() + " ";
+
+    return key;
+}
+
+static std::string streamDataHash(QPDFObjectHandle stream)
+{
+    auto data = stream.getRawStreamData();
+    Glib::Checksum checksum{Glib::Checksum::CHECKSUM_SHA256};
+    checksum.update(data->getBuffer(), data->getSize());
+
+    return checksum.get_string();
+}
+
+// Points every reference found in object, and in what it holds directly, to the canonical copy
+static void rewriteReferences(QPDFObjectHandle object, const std::map<QPDFObjGen, QPDFObjectHandle>& canonical)
+{
+    auto replacement = [&canonical](QPDFObjectHandle value) -> std::optional<QPDFObjectHandle> {
+        if (!value.isIndirect())
+            return {};
+
+        if (auto it = canonical.find(value.getObjGen()); it != canonical.end())
+            return it->second;
+
+        return {};
+    };
+
+    std::vector<QPDFObjectHandle> pending = {object.isStream() ? object.getDict() : object};
+
+    while (!pending.empty()) {
+        QPDFObjectHandle current = pending.back();
+        pending.pop_back();
 
-    // Write the result to a file
-    QPDFWriter writer{*destinationPDF};
-    writer.setOutputFilename(destinationFile->get_path().c_str());
+        if (current.isDictionary()) {
+            for (const std::string& key : current.getKeys()) {
+                QPDFObjectHandle value = current.getKey(key);
+
+                if (std::optional<QPDFObjectHandle> newValue = replacement(value); newValue.has_value())
+                    current.replaceKey(key, newValue.value());
+                else if (!value.isIndirect())
+                    pending.push_back(value);
+            }
+        }
+        else if (current.isArray()) {
+            for (int i = 0; i < current.getArrayNItems(); ++i) {
+                QPDFObjectHandle value = current.getArrayItem(i);
+
+                if (std::optional<QPDFObjectHandle> newValue = replacement(value); newValue.has_value())
+                    current.setArrayItem(i, newValue.value());
+                else if (!value.isIndirect())
+                    pending.push_back(value);
+            }
+        }
+    }
+}
+
+std::size_t PdfSaver::deduplicateStreams(QPDF& pdf)
+{
+    const Trace::Span span{"PdfSaver::deduplicateStreams"};
+    std::size_t merged = 0;
+
+    // Merging streams can make the dictionaries of the streams that reference
+    // them equal, like images sharing a color profile, so it goes in rounds
+    static constexpr int maxRounds = 4;
+
+    for (int round = 0; round < maxRounds; ++round) {
+        // Only streams whose dictionaries match are read, to compare their data
+        std::map<std::string, std::vector<QPDFObjectHandle>> candidates;
+        for (QPDFObjectHandle& object : pdf.getAllObjects())
+            if (object.isStream())
+                candidates[streamDictionaryKey(object)].push_back(object);
+
+        std::map<QPDFObjGen, QPDFObjectHandle> canonical;
+
+        for (auto& [key, streams] : candidates) {
+            if (streams.size() < 2)
+                continue;
+
+            std::map<std::string, QPDFObjectHandle> byHash;
+            for (QPDFObjectHandle& stream : streams) {
+                auto [it, isFirst] = byHash.emplace(streamDataHash(stream), stream);
+                if (!isFirst)
+                    canonical.emplace(stream.getObjGen(), it->second);
+            }
+        }
+
+        if (canonical.empty())
+            break;
+
+        // The merged copies are left unreferenced, so they aren't written
+        for (QPDFObjectHandle& object : pdf.getAllObjects())
+            rewriteReferences(object, canonical);
+        rewriteReferences(pdf.getTrailer(), canonical);
+
+        merged += canonical.size();
+    }
+
+    return merged;
+}
+
+std::size_t PdfSaver::downsampleImages(QPDF& pdf)
+{
+    const Trace::Span span{"PdfSaver::downsampleImages"};
+    const ImageDownsampling::Options& options = m_imageDownsampling.value();
+    const std::vector<ImageDownsampling::Candidate> candidates = ImageDownsampling::findCandidates(pdf, options);
+
+    // A few images per core at a time, so that the data of the images of a
+    // large scanned document isn't all in memory at once
+    const std::size_t batchSize = 4 * std::size_t{CpuResources::availableCores()};
+    std::size_t replaced = 0;
+
+    for (std::size_t start = 0; start < candidates.size(); start += batchSize) {
+        throwIfCanceled();
+
+        const std::size_t count = std::min(batchSize, candidates.size() - start);
+        std::vector<std::string> data;
+        for (std::size_t i = 0; i < count; ++i)
+            data.push_back(ImageDownsampling::readData(candidates.at(start + i)));
+
+        // The workers only see the data and the sizes, never the QPDF
+        std::vector<std::optional<ImageDownsampling::Recompressed>> results(count);
+        runConcurrently(count, [this, &candidates, &data, &results, &options, start](std::size_t i) {
+            throwIfCanceled();
+            results.at(i) = ImageDownsampling::recompress(candidates.at(start + i), data.at(i), options);
+        });
+
+        for (std::size_t i = 0; i < count; ++i) {
+            if (results.at(i).has_value()) {
+                ImageDownsampling::replace(candidates.at(start + i), results.at(i).value());
+                ++replaced;
+            }
+        }
+    }
+
+    return replaced;
+}
+
+std::size_t PdfSaver::precompressStreams(QPDF& pdf, bool recompress)
+{
+    const Trace::Span span{"PdfSaver::precompressStreams"};
+    const std::vector<StreamCompression::Candidate> candidates = StreamCompression::findCandidates(pdf, recompress);
+
+    // Batches are cut by size as well as by count, so that large images don't
+    // all sit in memory at once, and thousands of small content streams don't
+    // start threads for a few of them at a time
+    const std::size_t maxBatchCount = 1024;
+    const std::size_t maxBatchBytes = 64 * 1024 * 1024;
+    std::size_t compressed = 0;
+
+    for (std::size_t next = 0; next < candidates.size();) {
+        throwIfCanceled();
+
+        std::vector<const StreamCompression::Candidate*> batch;
+        std::vector<std::string> data;
+        std::size_t batchBytes = 0;
+
+        for (; next < candidates.size() && batch.size() < maxBatchCount && batchBytes < maxBatchBytes; ++next) {
+            std::optional<std::string> streamData = StreamCompression::readData(candidates.at(next));
+            if (!streamData.has_value())
+                continue;
+
+            batchBytes += streamData->size();
+            batch.push_back(&candidates.at(next));
+            data.push_back(std::move(*streamData));
+        }
+
+        // The workers only see the data, never the QPDF
+        std::vector<std::optional<std::string>> results(batch.size());
+        runConcurrently(batch.size(), [this, &batch, &data, &results](std::size_t i) {
+            throwIfCanceled();
+            results.at(i) = StreamCompression::compress(*batch.at(i), data.at(i));
+        });
+
+        for (std::size_t i = 0; i < batch.size(); ++i) {
+            if (results.at(i).has_value()) {
+                StreamCompression::replace(*batch.at(i), results.at(i).value());
+                ++compressed;
+            }
+        }
+    }
+
+    return compressed;
+}
+
+std::chrono::duration<double> PdfSaver::write(QPDF& pdf,
+                                              const Glib::RefPtr<Gio::File>& destinationFile,
+                                              double progressStart,
+                                              double progressEnd)
+{
+    const WriteTarget target{
+        [destinationFile](QPDFWriter& writer) { writer.setOutputFilename(destinationFile->get_path().c_str()); },
+        [destinationFile]() { return sizeOf(destinationFile); }};
+
+    return write(pdf, target, progressStart, progressEnd);
+}
+
+std::chrono::duration<double> PdfSaver::write(QPDF& pdf,
+                                              const WriteTarget& target,
+                                              double progressStart,
+                                              double progressEnd)
+{
+    if (deduplicatesStreams())
+        deduplicateStreams(pdf);
+
+    if (m_imageDownsampling.has_value())
+        downsampleImages(pdf);
+
+    // What's left to the writer is copying the compressed streams out, and
+    // compressing the object streams it makes
+    const bool compresses = m_writeProfile != WriteProfile::Fastest;
+    if (compresses)
+        precompressStreams(pdf, m_writeProfile == WriteProfile::Smallest);
+
+    const auto writeStart = std::chrono::steady_clock::now();
+
+    QPDFWriter writer{pdf};
+    target.setOutput(writer);
+
+    switch (m_writeProfile) {
+    case WriteProfile::Default:
+        break;
+    case WriteProfile::Smallest:
+        writer.setObjectStreamMode(qpdf_o_generate);
+        writer.setCompressStreams(true);
+        break;
+    case WriteProfile::Fastest:
+        writer.setObjectStreamMode(qpdf_o_preserve);
+        writer.setCompressStreams(false);
+        writer.setDecodeLevel(qpdf_dl_none);
+        break;
+    case WriteProfile::FastWebView:
+        writer.setLinearization(true);
+        break;
+    }
+
+    if (m_encryption.has_value())
+        writer.setR6EncryptionParameters(m_encryption->userPassword.c_str(),
+                                         m_encryption->ownerPassword.c_str(),
+                                         true,
+                                         true,
+                                         true,
+                                         true,
+                                         true,
+                                         true,
+                                         qpdf_r3p_full,
+                                         true);
+
+    // Streams just compressed are marked as modified, which the writer would
+    // otherwise take as a reason to inflate and deflate them once more
+    if (compresses)
+        writer.setDecodeLevel(qpdf_dl_none);
+
+    // Canceling while writing throws out of QPDFWriter, which closes the
+    // file on the way out; replaceFile() then removes it
+    const auto onWriteProgress = [this, &target, progressStart, progressEnd](int percentage) {
+        throwIfCanceled();
+        reportProgress(Progress::Stage::Writing,
+                       progressStart + (progressEnd - progressStart) * percentage / 100.0,
+                       target.bytesWritten());
+    };
+
+    if (m_monitor.onProgress || m_monitor.canceled != nullptr) {
+#if defined(QPDF_MAJOR_VERSION) && QPDF_MAJOR_VERSION >= 11
+        writer.registerProgressReporter(std::make_shared<WriteProgressReporter>(onWriteProgress));
+#else
+        writer.registerProgressReporter(PointerHolder<QPDFWriter::ProgressReporter>{new WriteProgressReporter{onWriteProgress}});
+#endif
+    }
+
+    reportProgress(Progress::Stage::Writing, progressStart);
     writer.write();
+
+    return std::chrono::steady_clock::now() - writeStart;
 }
 
 } // namespace Slicer
@@ -1,14 +1,34 @@
 #ifndef PDFSAVER_HPP
 #define PDFSAVER_HPP
 
+#include "imagedownsampling.hpp"
+#include "metrics.hpp"
+#include "streamcompression.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <stdexcept>
+#include <unordered_map>
 #include <vector>
 #include <giomm/file.h>
 #include <qpdf/QPDF.hh>
 #include <qpdf/QPDFPageDocumentHelper.hh>
 
+class QPDFWriter;
+
 namespace Slicer {
 
+class SourceFile;
+
 class PdfSaver {
+private:
+    struct FileData;
+
 public:
     struct PageData {
         unsigned int file;
@@ -19,23 +39,310 @@ public:
     struct SaveData {
         std::vector<Glib::RefPtr<Gio::File>> files;
         std::vector<PageData> pages;
+        // Keeps the files alive until the save is done, whatever happens to
+        // the document meanwhile. Empty, or null for files no longer used.
+        std::vector<std::shared_ptr<SourceFile>> sourceFiles;
+        // Set when the pages are every page of the first file, in order and
+        // turned as the file has them. Saving then copies the file, without
+        // parsing it, unless the save is asked to change how it's written.
+        bool isUnchanged = false;
+    };
+
+    enum class Mode {
+        // Every input is opened up front and kept open until saved
+        Default,
+        // Inputs other than the first are opened one at a time, only their
+        // pages in use are copied into the result, and then they are closed.
+        // Peak memory follows the largest input instead of all of them.
+        LowMemory
+    };
+
+    // How the result is written, trading writing time for size
+    enum class WriteProfile {
+        // qpdf's defaults: object streams as in the sources, streams compressed
+        Default,
+        // Object streams generated and every stream recompressed
+        Smallest,
+        // Everything written as it comes, nothing recompressed
+        Fastest,
+        // Linearized, so that viewers can show the first page while downloading
+        FastWebView
+    };
+
+    // Names used in the settings, on the command line and in the logs
+    static std::string writeProfileName(WriteProfile profile);
+    static std::optional<WriteProfile> writeProfileFromName(const std::string& name);
+
+    // When the resources that no page of the result uses are dropped. Pages
+    // of a file often share one resource dictionary, so leaving some of them
+    // out leaves resources behind, but finding them takes a pass over every
+    // page, which is most of the save time of documents with thousands of them.
+    enum class ResourceCleanup {
+        // Only when some page of a file is left out of the result: with all
+        // of them in, every resource is still used, as in the source
+        WhenPagesLeftOut,
+        Always,
+        Never
+    };
+
+    // Named like the write profiles
+    static std::string resourceCleanupName(ResourceCleanup cleanup);
+    static std::optional<ResourceCleanup> resourceCleanupFromName(const std::string& name);
+
+    // Keeps the files of a document parsed between saves. Saving with a cache
+    // only copies pages out of the cached files, so they stay untouched and
+    // can be used again. Only the first file, the shell of the result, is
+    // parsed again on every save. Saves sharing a cache must not overlap.
+    class ParsedFileCache {
+    public:
+        void clear();
+        void forget(const std::string& filePath);
+
+        // Parses the files the pages use ahead of a save, on the calling
+        // thread, along with a spare copy of the first one that the next save
+        // takes as its shell. That save then only stitches and writes. Files
+        // already cached are skipped, and those that fail are left to the save.
+        // May run while a save with this cache does.
+        void prepare(const SaveData& saveData);
+        // Whether the file is cached, or is the spare shell
+        bool contains(const std::string& filePath) const;
+
+    private:
+        friend class PdfSaver;
+        mutable std::mutex m_mutex;
+        std::unordered_map<std::string, std::shared_ptr<FileData>> m_files;
+        std::string m_shellPath;
+        std::shared_ptr<FileData> m_shell;
+    };
+
+    // Where a save is at, from parsing the inputs to writing the result
+    struct Progress {
+        enum class Stage {
+            Parsing,
+            Stitching,
+            Writing,
+            Done
+        };
+
+        Stage stage;
+        // Of the whole save, from 0 to 1
+        double fraction;
+        // While writing, the size of the output so far
+        std::uint64_t bytesWritten;
+    };
+
+    // Follows a save as it goes, and can stop it. Parsing happens in the
+    // constructor, so it's given there.
+    struct Monitor {
+        // Called from the saving threads, one call at a time
+        std::function<void(const Progress&)> onProgress;
+        // Looked at between files, between pages and while writing. Once
+        // it goes up, the save throws Canceled and leaves the destination untouched.
+        std::shared_ptr<const std::atomic<bool>> canceled;
     };
 
-    PdfSaver(const SaveData& saveData);
+    struct Canceled : std::runtime_error {
+        Canceled();
+    };
+
+    // The save data is moved in when given as a temporary: with documents of
+    // a hundred thousand pages, a copy of it is more than the save needs
+    PdfSaver(SaveData saveData, Mode mode = Mode::Default, const Monitor& monitor = {});
+    PdfSaver(SaveData saveData,
+             const std::shared_ptr<ParsedFileCache>& cache,
+             const Monitor& monitor = {});
+
+    void setWriteProfile(WriteProfile profile) { m_writeProfile = profile; }
+    WriteProfile writeProfile() const { return m_writeProfile; }
+
+    // When the document is a single file with its pages in their original
+    // order, and only a few of them were rotated, the result is the original
+    // file plus an incremental update with the changed pages, instead of
+    // a whole new file. Only with the default write profile. On by default.
+    void setIncrementalUpdates(bool enabled) { m_incrementalUpdates = enabled; }
+
+    // Before writing, streams with the same dictionary and data, like the
+    // fonts, logos and color profiles of files made by the same program,
+    // are merged into one, and every reference goes to that one. Costs a read
+    // of the streams that could be the same. Off by default, but always on
+    // with the smallest write profile.
+    void setDeduplicateStreams(bool enabled) { m_deduplicateStreams = enabled; }
+
+    void setResourceCleanup(ResourceCleanup cleanup) { m_resourceCleanup = cleanup; }
+
+    // Before writing, images drawn at more than the resolution of the
+    // options are scaled down and compressed again as JPEG, on all cores,
+    // see ImageDownsampling. Rules out incremental updates. Off by default.
+    void setImageDownsampling(const std::optional<ImageDownsampling::Options>& options) { m_imageDownsampling = options; }
+
+    // The passwords of an encrypted result. With an empty user password it
+    // opens without asking, and the owner password lifts the restrictions.
+    struct Encryption {
+        std::string userPassword;
+        std::string ownerPassword;
+    };
+
+    // When set, the result is encrypted with AES-256. Encrypted inputs are
+    // decrypted once as they are opened, see Decryption, so without this the
+    // result isn't encrypted. Rules out incremental updates. Off by default.
+    void setEncryption(const std::optional<Encryption>& encryption) { m_encryption = encryption; }
 
     void save(const Glib::RefPtr<Gio::File>& destinationFile);
 
+    // Writes the result as it's made to a descriptor that may not seek, like
+    // a pipe to another program or the standard output, without a temp file
+    // in between. What's written stays written when the save fails or is
+    // canceled halfway. Never an incremental update. The descriptor is left
+    // open. Throws std::runtime_error when writing to it fails.
+    void saveToDescriptor(int descriptor);
+
+    // A run of pages of the document, saved to a file of its own
+    struct Part {
+        std::size_t firstPage;
+        // One past the last page
+        std::size_t endPage;
+        Glib::RefPtr<Gio::File> destinationFile;
+    };
+
+    // Saves every part out of the files parsed once by this saver, instead of
+    // one saver, and one parse, per part. The pages are copied into a new file
+    // for each part, which keeps the document info of the first file but not
+    // its outline. Parts are built and written one at a time.
+    // Not to be mixed with save() on the same saver.
+    void saveParts(const std::vector<Part>& parts);
+
+    // Gives the file for the 1-based number of a part
+    using DestinationOfPart = std::function<Glib::RefPtr<Gio::File>(unsigned int partNumber)>;
+
+    // Like saveParts(), with runs of pages of at most maxSizeInBytes each, as
+    // far as can be told from the sizes of the objects they use before writing
+    // them. A page bigger than that on its own gets a part of its own.
+    // Returns the written files.
+    std::vector<Glib::RefPtr<Gio::File>> savePartsOfSize(std::uint64_t maxSizeInBytes,
+                                                         const DestinationOfPart& destinationOfPart);
+
+    // How large a save would make the result, as far as can be told from
+    // the sizes the files give their objects, without writing anything:
+    // every object the pages use counts once, as the sources have it, plus
+    // what the writer adds around it. With the smallest write profile, or
+    // stream deduplication, streams that look alike count once.
+    // Takes a walk over the objects, no reading of stream data. In low memory
+    // mode, opens every used file, like saveParts().
+    std::uint64_t estimatedSize();
+    // Of the pages from firstPage to endPage, saved as a part of their own
+    std::uint64_t estimatedSizeOfPart(std::size_t firstPage, std::size_t endPage);
+
+    struct PartEstimate {
+        std::size_t firstPage;
+        // One past the last page
+        std::size_t endPage;
+        std::uint64_t sizeInBytes;
+    };
+
+    // The parts savePartsOfSize() would write, without writing them
+    std::vector<PartEstimate> partsOfSize(std::uint64_t maxSizeInBytes);
+
+    // Where each top-level outline entry of the first file starts in the
+    // result, sorted, and always starting with 0 for the pages before them
+    std::vector<std::size_t> outlineStarts();
+
+    // Time taken by QPDFWriter during the last save
+    std::chrono::duration<double> lastWriteDuration() const { return m_lastWriteDuration; }
+
 private:
+    // Empty for the files that aren't opened
     struct FileData {
         std::unique_ptr<QPDF> qpdf;
         std::unique_ptr<QPDFPageDocumentHelper> qpdfPageDocumentHelper;
         std::vector<QPDFPageObjectHelper> qpdfPages;
+        Metrics::MemoryCharge memoryCharge{Metrics::Memory::SaveFiles};
     };
 
     const SaveData m_saveData;
+    const Mode m_mode;
+    WriteProfile m_writeProfile = WriteProfile::Default;
+    bool m_incrementalUpdates = true;
+    bool m_deduplicateStreams = false;
+    ResourceCleanup m_resourceCleanup = ResourceCleanup::WhenPagesLeftOut;
+    std::optional<ImageDownsampling::Options> m_imageDownsampling;
+    std::optional<Encryption> m_encryption;
+    std::chrono::duration<double> m_lastWriteDuration{0};
     std::vector<FileData> m_filesData;
+    // With a cache, the files other than the first one come from here
+    std::vector<std::shared_ptr<FileData>> m_cachedFilesData;
+    std::shared_ptr<ParsedFileCache> m_cache;
+    const Monitor m_monitor;
+    std::mutex m_progressMutex;
 
+    std::vector<bool> usedFiles() const;
+    void throwIfCanceled() const;
+    // Within the stage, from 0 to 1. Stages take a fixed share of the whole.
+    void reportProgress(Progress::Stage stage, double stageFraction, std::uint64_t bytesWritten = 0);
+    // runConcurrently(), reporting progress and looking at the cancel flag between files
+    void parseFiles(std::size_t count, const std::function<void(std::size_t)>& parse);
+    static FileData openFile(const Glib::RefPtr<Gio::File>& file);
+    // Runs task(0) ... task(count - 1) on all cores, rethrowing the first failure
+    static void runConcurrently(std::size_t count, const std::function<void(std::size_t)>& task);
+    // Also fills in the number of pages of each file it opens
+    std::vector<QPDFObjectHandle> copyForeignPages(QPDF& destinationPDF, std::vector<std::size_t>& pagesInFiles);
+    // Whether the result is only pages of the first file, in their order,
+    // maybe with some left out or rotated
+    bool keepsShellOrder() const;
+    // Given how many pages each file has, 0 for those unknown
+    bool leavesPagesOut(const std::vector<std::size_t>& pagesInFiles) const;
     void persist(const Glib::RefPtr<Gio::File>& destinationFile);
+    // Puts the pages of the result together in the shell, the first file.
+    // Returns the shell, ready to be written.
+    QPDF& assemble();
+    // Gives the writer where to write, and tells how much it wrote
+    struct WriteTarget {
+        std::function<void(QPDFWriter&)> setOutput;
+        std::function<std::uint64_t()> bytesWritten;
+    };
+    // Writes with the write profile, reporting progress between the given
+    // fractions of the writing stage. Returns the time taken by QPDFWriter.
+    std::chrono::duration<double> write(QPDF& pdf,
+                                        const WriteTarget& target,
+                                        double progressStart = 0,
+                                        double progressEnd = 1);
+    std::chrono::duration<double> write(QPDF& pdf,
+                                        const Glib::RefPtr<Gio::File>& destinationFile,
+                                        double progressStart = 0,
+                                        double progressEnd = 1);
+    // Returns the number of streams merged away
+    static std::size_t deduplicateStreams(QPDF& pdf);
+    // Returns the number of images replaced
+    std::size_t downsampleImages(QPDF& pdf);
+    // The compression QPDFWriter would do, done ahead of it on all cores, see
+    // StreamCompression. Returns the number of streams compressed.
+    std::size_t precompressStreams(QPDF& pdf, bool recompress);
+    // Runs persist on a temp file and moves it over the destination once whole.
+    // Returns the size of the result.
+    std::uint64_t replaceFile(const Glib::RefPtr<Gio::File>& destinationFile,
+                     const std::function<void(const Glib::RefPtr<Gio::File>&)>& persist);
+    void openAllUsedFiles();
+    // The shell isn't opened up front when the file is unchanged
+    void openShell();
+    // Moves in the shell prepared by the cache, when it's of the first file
+    bool takePreparedShell();
+    bool copiesUnchangedFile() const;
+    QPDFPageObjectHelper& sourcePage(const PageData& page);
+    void savePart(std::size_t firstPage, std::size_t endPage, const Glib::RefPtr<Gio::File>& destinationFile);
+    // What was counted so far of the objects of a result. Objects are told
+    // apart by their file too: numbers repeat across files.
+    struct SizeCount {
+        std::set<std::pair<const QPDF*, QPDFObjGen>> objects;
+        // With deduplication, the streams that look alike, counted once
+        std::set<std::string> streams;
+    };
+
+    // Of the objects reachable from object that aren't in counted yet, adding them to it
+    std::uint64_t estimatedSizeOf(QPDFObjectHandle object, SizeCount& counted) const;
+    bool deduplicatesStreams() const { return m_deduplicateStreams || m_writeProfile == WriteProfile::Smallest; }
+    // Returns false, without touching anything, when an incremental update doesn't apply
+    bool persistIncrementally(const Glib::RefPtr<Gio::File>& destinationFile);
+
+    static constexpr std::size_t maxIncrementalEdits = 64;
 };
 
 } // namespace Slicer
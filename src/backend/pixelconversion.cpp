@@ -0,0 +1,826 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "pixelconversion.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SLICER_PIXELS_X86
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#define SLICER_PIXELS_NEON
+#include <arm_neon.h>
+#endif
+
+namespace Slicer::PixelConversion {
+
+// The most source rows a destination row of downscale() is made of
+static constexpr int maximumBlendedRows = 16;
+
+// The pixel is a native endian word, so with a little endian CPU
+// its bytes are B, G, R, A in memory
+static inline void convertPixel(const std::uint8_t* source, std::uint8_t* destination)
+{
+    std::uint32_t argb;
+    std::memcpy(&argb, source, sizeof(argb));
+
+    const std::uint32_t alpha = argb >> 24;
+    std::uint32_t red = (argb >> 16) & 0xff;
+    std::uint32_t green = (argb >> 8) & 0xff;
+    std::uint32_t blue = argb & 0xff;
+
+    if (alpha != 0xff && alpha != 0) {
+        red = (red * 255 + alpha / 2) / alpha;
+        green = (green * 255 + alpha / 2) / alpha;
+        blue = (blue * 255 + alpha / 2) / alpha;
+    }
+
+    destination[0] = static_cast<std::uint8_t>(red);
+    destination[1] = static_cast<std::uint8_t>(green);
+    destination[2] = static_cast<std::uint8_t>(blue);
+    destination[3] = static_cast<std::uint8_t>(alpha);
+}
+
+static void convertRowScalar(const std::uint8_t* source, std::uint8_t* destination, int width)
+{
+    for (int x = 0; x < width; ++x)
+        convertPixel(source + 4 * x, destination + 4 * x);
+}
+
+#ifdef SLICER_PIXELS_X86
+// Swaps blue and red in each 32 bit lane of four opaque pixels at a time.
+// Groups with a translucent pixel go through the scalar code.
+static void convertRowSse2(const std::uint8_t* source, std::uint8_t* destination, int width)
+{
+    const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xff000000));
+    const __m128i greenAlphaMask = _mm_set1_epi32(static_cast<int>(0xff00ff00));
+    const __m128i lowByteMask = _mm_set1_epi32(0xff);
+    int x = 0;
+
+    for (; x + 4 <= width; x += 4) {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 4 * x)); //NOLINT
+        const __m128i opaque = _mm_cmpeq_epi32(_mm_and_si128(pixels, alphaMask), alphaMask);
+
+        if (_mm_movemask_epi8(opaque) != 0xffff) {
+            convertRowScalar(source + 4 * x, destination + 4 * x, 4);
+            continue;
+        }
+
+        const __m128i redToLow = _mm_and_si128(_mm_srli_epi32(pixels, 16), lowByteMask);
+        const __m128i blueToHigh = _mm_slli_epi32(_mm_and_si128(pixels, lowByteMask), 16);
+        const __m128i result = _mm_or_si128(_mm_and_si128(pixels, greenAlphaMask),
+                                            _mm_or_si128(redToLow, blueToHigh));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + 4 * x), result); //NOLINT
+    }
+
+    convertRowScalar(source + 4 * x, destination + 4 * x, width - x);
+}
+
+__attribute__((target("avx2"))) static void convertRowAvx2(const std::uint8_t* source,
+                                                           std::uint8_t* destination,
+                                                           int width)
+{
+    const __m256i alphaMask = _mm256_set1_epi32(static_cast<int>(0xff000000));
+    // Within each 32 bit lane: take bytes 2, 1, 0, 3
+    const __m256i shuffle = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                                             2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    int x = 0;
+
+    for (; x + 8 <= width; x += 8) {
+        const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + 4 * x)); //NOLINT
+        const __m256i opaque = _mm256_cmpeq_epi32(_mm256_and_si256(pixels, alphaMask), alphaMask);
+
+        if (_mm256_movemask_epi8(opaque) != -1) {
+            convertRowScalar(source + 4 * x, destination + 4 * x, 8);
+            continue;
+        }
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + 4 * x), //NOLINT
+                            _mm256_shuffle_epi8(pixels, shuffle));
+    }
+
+    convertRowSse2(source + 4 * x, destination + 4 * x, width - x);
+}
+#endif
+
+#ifdef SLICER_PIXELS_NEON
+static void convertRowNeon(const std::uint8_t* source, std::uint8_t* destination, int width)
+{
+    int x = 0;
+
+    for (; x + 16 <= width; x += 16) {
+        // Loads as planes: val[0] is blue, val[1] green, val[2] red, val[3] alpha
+        uint8x16x4_t pixels = vld4q_u8(source + 4 * x);
+
+        if (vminvq_u8(pixels.val[3]) != 0xff) {
+            convertRowScalar(source + 4 * x, destination + 4 * x, 16);
+            continue;
+        }
+
+        const uint8x16_t blue = pixels.val[0];
+        pixels.val[0] = pixels.val[2];
+        pixels.val[2] = blue;
+        vst4q_u8(destination + 4 * x, pixels);
+    }
+
+    convertRowScalar(source + 4 * x, destination + 4 * x, width - x);
+}
+#endif
+
+static constexpr std::uint32_t redWeight = 77;
+static constexpr std::uint32_t greenWeight = 150;
+static constexpr std::uint32_t blueWeight = 29;
+
+static void grayRowScalar(const std::uint8_t* source, std::uint8_t* destination, int width)
+{
+    for (int x = 0; x < width; ++x) {
+        const std::uint8_t* pixel = source + 4 * x;
+        destination[x] = static_cast<std::uint8_t>((redWeight * pixel[0] + greenWeight * pixel[1] + blueWeight * pixel[2]) >> 8);
+    }
+}
+
+#ifdef SLICER_PIXELS_X86
+// Sixteen pixels at a time: the gray level of each lands in its own 32 bit
+// lane, and the four vectors are packed down to bytes.
+static void grayRowSse2(const std::uint8_t* source, std::uint8_t* destination, int width)
+{
+    // With a little endian CPU, the bytes R, G, B, A are the word ABGR
+    const __m128i redBlueMask = _mm_set1_epi32(0x00ff00ff);
+    const __m128i lowByteMask = _mm_set1_epi32(0xff);
+    const __m128i redBlueWeights = _mm_set1_epi32(static_cast<int>((blueWeight << 16) | redWeight));
+    const __m128i greenWeights = _mm_set1_epi32(static_cast<int>(greenWeight));
+    int x = 0;
+
+    auto grayOf = [&](const std::uint8_t* pixels) {
+        const __m128i loaded = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels)); //NOLINT
+        const __m128i redBlue = _mm_and_si128(loaded, redBlueMask);
+        const __m128i green = _mm_and_si128(_mm_srli_epi32(loaded, 8), lowByteMask);
+
+        return _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(redBlue, redBlueWeights),
+                                            _mm_madd_epi16(green, greenWeights)),
+                              8);
+    };
+
+    for (; x + 16 <= width; x += 16) {
+        const __m128i first = _mm_packs_epi32(grayOf(source + 4 * x), grayOf(source + 4 * x + 16));
+        const __m128i second = _mm_packs_epi32(grayOf(source + 4 * x + 32), grayOf(source + 4 * x + 48));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + x), _mm_packus_epi16(first, second)); //NOLINT
+    }
+
+    grayRowScalar(source + 4 * x, destination + x, width - x);
+}
+#endif
+
+#ifdef SLICER_PIXELS_NEON
+static void grayRowNeon(const std::uint8_t* source, std::uint8_t* destination, int width)
+{
+    const uint8x8_t redWeights = vdup_n_u8(redWeight);
+    const uint8x8_t greenWeights = vdup_n_u8(greenWeight);
+    const uint8x8_t blueWeights = vdup_n_u8(blueWeight);
+    int x = 0;
+
+    for (; x + 16 <= width; x += 16) {
+        // Loads as planes: val[0] is red, val[1] green, val[2] blue
+        const uint8x16x4_t pixels = vld4q_u8(source + 4 * x);
+
+        uint16x8_t low = vmull_u8(vget_low_u8(pixels.val[0]), redWeights);
+        low = vmlal_u8(low, vget_low_u8(pixels.val[1]), greenWeights);
+        low = vmlal_u8(low, vget_low_u8(pixels.val[2]), blueWeights);
+        uint16x8_t high = vmull_u8(vget_high_u8(pixels.val[0]), redWeights);
+        high = vmlal_u8(high, vget_high_u8(pixels.val[1]), greenWeights);
+        high = vmlal_u8(high, vget_high_u8(pixels.val[2]), blueWeights);
+
+        vst1q_u8(destination + x, vcombine_u8(vshrn_n_u16(low, 8), vshrn_n_u16(high, 8)));
+    }
+
+    grayRowScalar(source + 4 * x, destination + x, width - x);
+}
+#endif
+
+static bool opaqueGrayRowScalar(const std::uint8_t* source, std::uint8_t* destination, int width)
+{
+    for (int x = 0; x < width; ++x) {
+        const std::uint8_t* pixel = source + 4 * x;
+
+        if (pixel[0] != pixel[1] || pixel[0] != pixel[2] || pixel[3] != 0xff)
+            return false;
+
+        destination[x] = pixel[0];
+    }
+
+    return true;
+}
+
+static void expandGrayRowScalar(const std::uint8_t* source, std::uint8_t* destination, int width)
+{
+    for (int x = 0; x < width; ++x) {
+        std::uint8_t* pixel = destination + 4 * x;
+        pixel[0] = source[x];
+        pixel[1] = source[x];
+        pixel[2] = source[x];
+        pixel[3] = 0xff;
+    }
+}
+
+#ifdef SLICER_PIXELS_X86
+// Sixteen pixels at a time: each 32 bit lane is compared with its red byte
+// spread over red, green and blue, under an opaque alpha
+static bool opaqueGrayRowSse2(const std::uint8_t* source, std::uint8_t* destination, int width)
+{
+    const __m128i lowByteMask = _mm_set1_epi32(0xff);
+    const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xff000000));
+    int x = 0;
+
+    auto grayOf = [&](const std::uint8_t* pixels, bool& isGray) {
+        const __m128i loaded = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels)); //NOLINT
+        const __m128i red = _mm_and_si128(loaded, lowByteMask);
+        const __m128i expected = _mm_or_si128(_mm_or_si128(red, alphaMask),
+                                              _mm_or_si128(_mm_slli_epi32(red, 8), _mm_slli_epi32(red, 16)));
+        isGray = isGray && _mm_movemask_epi8(_mm_cmpeq_epi32(loaded, expected)) == 0xffff;
+
+        return red;
+    };
+
+    for (; x + 16 <= width; x += 16) {
+        bool isGray = true;
+        const __m128i first = _mm_packs_epi32(grayOf(source + 4 * x, isGray), grayOf(source + 4 * x + 16, isGray));
+        const __m128i second = _mm_packs_epi32(grayOf(source + 4 * x + 32, isGray), grayOf(source + 4 * x + 48, isGray));
+
+        if (!isGray)
+            return false;
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + x), _mm_packus_epi16(first, second)); //NOLINT
+    }
+
+    return opaqueGrayRowScalar(source + 4 * x, destination + x, width - x);
+}
+
+// Each gray byte is doubled, then paired with an opaque alpha
+static void expandGrayRowSse2(const std::uint8_t* source, std::uint8_t* destination, int width)
+{
+    const __m128i opaque = _mm_set1_epi8(static_cast<char>(0xff));
+    int x = 0;
+
+    for (; x + 16 <= width; x += 16) {
+        const __m128i gray = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + x)); //NOLINT
+        const __m128i grayGrayLow = _mm_unpacklo_epi8(gray, gray);
+        const __m128i grayGrayHigh = _mm_unpackhi_epi8(gray, gray);
+        const __m128i grayAlphaLow = _mm_unpacklo_epi8(gray, opaque);
+        const __m128i grayAlphaHigh = _mm_unpackhi_epi8(gray, opaque);
+        auto* pixels = reinterpret_cast<__m128i*>(destination + 4 * x); //NOLINT
+
+        _mm_storeu_si128(pixels, _mm_unpacklo_epi16(grayGrayLow, grayAlphaLow));
+        _mm_storeu_si128(pixels + 1, _mm_unpackhi_epi16(grayGrayLow, grayAlphaLow)); //NOLINT
+        _mm_storeu_si128(pixels + 2, _mm_unpacklo_epi16(grayGrayHigh, grayAlphaHigh)); //NOLINT
+        _mm_storeu_si128(pixels + 3, _mm_unpackhi_epi16(grayGrayHigh, grayAlphaHigh)); //NOLINT
+    }
+
+    expandGrayRowScalar(source + x, destination + 4 * x, width - x);
+}
+#endif
+
+#ifdef SLICER_PIXELS_NEON
+static bool opaqueGrayRowNeon(const std::uint8_t* source, std::uint8_t* destination, int width)
+{
+    int x = 0;
+
+    for (; x + 16 <= width; x += 16) {
+        // Loads as planes: val[0] is red, val[1] green, val[2] blue, val[3] alpha
+        const uint8x16x4_t pixels = vld4q_u8(source + 4 * x);
+        const uint8x16_t isGray = vandq_u8(vandq_u8(vceqq_u8(pixels.val[0], pixels.val[1]),
+                                                    vceqq_u8(pixels.val[0], pixels.val[2])),
+                                           pixels.val[3]);
+
+        if (vminvq_u8(isGray) != 0xff)
+            return false;
+
+        vst1q_u8(destination + x, pixels.val[0]);
+    }
+
+    return opaqueGrayRowScalar(source + 4 * x, destination + x, width - x);
+}
+
+static void expandGrayRowNeon(const std::uint8_t* source, std::uint8_t* destination, int width)
+{
+    int x = 0;
+
+    for (; x + 16 <= width; x += 16) {
+        const uint8x16_t gray = vld1q_u8(source + x);
+        const uint8x16x4_t pixels = {{gray, gray, gray, vdupq_n_u8(0xff)}};
+        vst4q_u8(destination + 4 * x, pixels);
+    }
+
+    expandGrayRowScalar(source + x, destination + 4 * x, width - x);
+}
+#endif
+
+// The box filter of downscale(): every destination pixel is the average of
+// the source pixels under it, weighed by how much of each it covers. The
+// weights of a pixel add up to weightOne.
+static constexpr int weightOne = 1 << 14;
+// The horizontal pass keeps this many bits less than its sums take, so
+// that what it leaves fits the 16 bit multiplies of the vertical pass
+static constexpr int horizontalShift = 7;
+static constexpr int verticalShift = 2 * 14 - horizontalShift;
+
+struct Contributions {
+    // For each destination pixel, its first source pixel and where its
+    // weights start in weights; they end where those of the next one start
+    std::vector<int> first;
+    std::vector<int> offsets;
+    std::vector<std::int16_t> weights;
+};
+
+static Contributions contributionsFor(int sourceLength, int destinationLength)
+{
+    Contributions result;
+    const double scale = static_cast<double>(sourceLength) / destinationLength;
+
+    // From the running sum of the coverage, so that the rounded weights of
+    // each destination pixel still add up exactly
+    const auto fixedPoint = [scale](double sourcePosition, int destinationIndex) {
+        return static_cast<int>(std::lround((sourcePosition - destinationIndex * scale) / scale * weightOne));
+    };
+
+    for (int i = 0; i < destinationLength; ++i) {
+        const double start = i * scale;
+        const double end = std::min<double>(sourceLength, (i + 1) * scale);
+        const int first = std::min(sourceLength - 1, static_cast<int>(start));
+        int previous = 0;
+
+        result.first.push_back(first);
+        result.offsets.push_back(static_cast<int>(result.weights.size()));
+
+        for (int j = first; j < sourceLength && j < end; ++j) {
+            const int cumulative = j + 1 >= end ? weightOne : fixedPoint(j + 1, i);
+            result.weights.push_back(static_cast<std::int16_t>(cumulative - previous));
+            previous = cumulative;
+        }
+    }
+
+    result.offsets.push_back(static_cast<int>(result.weights.size()));
+
+    return result;
+}
+
+static void downscaleRowHorizontally(const std::uint8_t* source,
+                                     std::int16_t* destination,
+                                     const Contributions& contributions,
+                                     int destinationWidth,
+                                     int bytesPerPixel)
+{
+    for (int x = 0; x < destinationWidth; ++x) {
+        const std::uint8_t* pixels = source + contributions.first.at(x) * bytesPerPixel;
+        const std::int16_t* weights = contributions.weights.data() + contributions.offsets.at(x);
+        const int numberOfWeights = contributions.offsets.at(x + 1) - contributions.offsets.at(x);
+
+        for (int channel = 0; channel < bytesPerPixel; ++channel) {
+            int sum = 0;
+
+            for (int j = 0; j < numberOfWeights; ++j)
+                sum += weights[j] * pixels[j * bytesPerPixel + channel];
+
+            destination[x * bytesPerPixel + channel] = static_cast<std::int16_t>((sum + (1 << (horizontalShift - 1))) >> horizontalShift);
+        }
+    }
+}
+
+static void blendRowsScalar(const std::int16_t* const* rows,
+                            const std::int16_t* weights,
+                            int numberOfRows,
+                            std::uint8_t* destination,
+                            int length)
+{
+    for (int x = 0; x < length; ++x) {
+        int sum = 0;
+
+        for (int k = 0; k < numberOfRows; ++k)
+            sum += weights[k] * rows[k][x];
+
+        destination[x] = static_cast<std::uint8_t>(std::clamp((sum + (1 << (verticalShift - 1))) >> verticalShift, 0, 255));
+    }
+}
+
+#ifdef SLICER_PIXELS_X86
+// Eight bytes at a time: the 16 bit products are put back together into
+// 32 bit sums from their low and high halves
+static void blendRowsSse2(const std::int16_t* const* rows,
+                          const std::int16_t* weights,
+                          int numberOfRows,
+                          std::uint8_t* destination,
+                          int length)
+{
+    const __m128i rounding = _mm_set1_epi32(1 << (verticalShift - 1));
+    int x = 0;
+
+    for (; x + 8 <= length; x += 8) {
+        __m128i low = _mm_setzero_si128();
+        __m128i high = _mm_setzero_si128();
+
+        for (int k = 0; k < numberOfRows; ++k) {
+            const __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k] + x)); //NOLINT
+            const __m128i weight = _mm_set1_epi16(weights[k]);
+            const __m128i productsLow = _mm_mullo_epi16(values, weight);
+            const __m128i productsHigh = _mm_mulhi_epi16(values, weight);
+
+            low = _mm_add_epi32(low, _mm_unpacklo_epi16(productsLow, productsHigh));
+            high = _mm_add_epi32(high, _mm_unpackhi_epi16(productsLow, productsHigh));
+        }
+
+        low = _mm_srai_epi32(_mm_add_epi32(low, rounding), verticalShift);
+        high = _mm_srai_epi32(_mm_add_epi32(high, rounding), verticalShift);
+        const __m128i packed = _mm_packs_epi32(low, high);
+
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(destination + x), _mm_packus_epi16(packed, packed)); //NOLINT
+    }
+
+    const std::int16_t* remaining[maximumBlendedRows];
+    for (int k = 0; k < numberOfRows; ++k)
+        remaining[k] = rows[k] + x; //NOLINT
+
+    blendRowsScalar(remaining, weights, numberOfRows, destination + x, length - x);
+}
+
+// Like the above, sixteen bytes at a time. Unpacking and packing both stay
+// within 128 bit lanes, so the sums come out in order in each lane.
+__attribute__((target("avx2"))) static void blendRowsAvx2(const std::int16_t* const* rows,
+                                                          const std::int16_t* weights,
+                                                          int numberOfRows,
+                                                          std::uint8_t* destination,
+                                                          int length)
+{
+    const __m256i rounding = _mm256_set1_epi32(1 << (verticalShift - 1));
+    int x = 0;
+
+    for (; x + 16 <= length; x += 16) {
+        __m256i low = _mm256_setzero_si256();
+        __m256i high = _mm256_setzero_si256();
+
+        for (int k = 0; k < numberOfRows; ++k) {
+            const __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[k] + x)); //NOLINT
+            const __m256i weight = _mm256_set1_epi16(weights[k]);
+            const __m256i productsLow = _mm256_mullo_epi16(values, weight);
+            const __m256i productsHigh = _mm256_mulhi_epi16(values, weight);
+
+            low = _mm256_add_epi32(low, _mm256_unpacklo_epi16(productsLow, productsHigh));
+            high = _mm256_add_epi32(high, _mm256_unpackhi_epi16(productsLow, productsHigh));
+        }
+
+        low = _mm256_srai_epi32(_mm256_add_epi32(low, rounding), verticalShift);
+        high = _mm256_srai_epi32(_mm256_add_epi32(high, rounding), verticalShift);
+        const __m256i packed = _mm256_packs_epi32(low, high);
+        // Each lane holds its eight bytes twice; the first copy of each is kept
+        const __m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(packed, packed), 0x08);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + x), _mm256_castsi256_si128(bytes)); //NOLINT
+    }
+
+    const std::int16_t* remaining[maximumBlendedRows];
+    for (int k = 0; k < numberOfRows; ++k)
+        remaining[k] = rows[k] + x; //NOLINT
+
+    blendRowsSse2(remaining, weights, numberOfRows, destination + x, length - x);
+}
+#endif
+
+#ifdef SLICER_PIXELS_NEON
+static void blendRowsNeon(const std::int16_t* const* rows,
+                          const std::int16_t* weights,
+                          int numberOfRows,
+                          std::uint8_t* destination,
+                          int length)
+{
+    int x = 0;
+
+    for (; x + 8 <= length; x += 8) {
+        int32x4_t low = vdupq_n_s32(0);
+        int32x4_t high = vdupq_n_s32(0);
+
+        for (int k = 0; k < numberOfRows; ++k) {
+            const int16x8_t values = vld1q_s16(rows[k] + x);
+            low = vmlal_n_s16(low, vget_low_s16(values), weights[k]);
+            high = vmlal_n_s16(high, vget_high_s16(values), weights[k]);
+        }
+
+        const uint16x8_t packed = vcombine_u16(vqmovun_s32(vrshrq_n_s32(low, verticalShift)),
+                                               vqmovun_s32(vrshrq_n_s32(high, verticalShift)));
+        vst1_u8(destination + x, vqmovn_u16(packed));
+    }
+
+    const std::int16_t* remaining[maximumBlendedRows];
+    for (int k = 0; k < numberOfRows; ++k)
+        remaining[k] = rows[k] + x;
+
+    blendRowsScalar(remaining, weights, numberOfRows, destination + x, length - x);
+}
+#endif
+
+using RowConverter = void (*)(const std::uint8_t*, std::uint8_t*, int);
+
+using RowChecker = bool (*)(const std::uint8_t*, std::uint8_t*, int);
+
+using RowBlender = void (*)(const std::int16_t* const*, const std::int16_t*, int, std::uint8_t*, int);
+
+struct Implementation {
+    RowConverter convertRow;
+    RowConverter grayRow;
+    RowChecker opaqueGrayRow;
+    RowConverter expandGrayRow;
+    RowBlender blendRows;
+    const char* name;
+};
+
+static Implementation pickImplementation()
+{
+#ifdef SLICER_PIXELS_X86
+    if (__builtin_cpu_supports("avx2"))
+        return {convertRowAvx2, grayRowSse2, opaqueGrayRowSse2, expandGrayRowSse2, blendRowsAvx2, "avx2"};
+
+    return {convertRowSse2, grayRowSse2, opaqueGrayRowSse2, expandGrayRowSse2, blendRowsSse2, "sse2"};
+#elif defined(SLICER_PIXELS_NEON)
+    return {convertRowNeon, grayRowNeon, opaqueGrayRowNeon, expandGrayRowNeon, blendRowsNeon, "neon"};
+#else
+    return {convertRowScalar, grayRowScalar, opaqueGrayRowScalar, expandGrayRowScalar, blendRowsScalar, "scalar"};
+#endif
+}
+
+static const Implementation& implementation()
+{
+    static const Implementation result = pickImplementation();
+
+    return result;
+}
+
+static bool isLittleEndian()
+{
+    const std::uint32_t one = 1;
+    std::uint8_t firstByte;
+    std::memcpy(&firstByte, &one, 1);
+
+    return firstByte == 1;
+}
+
+void argb32ToRgba(const std::uint8_t* source,
+                  int sourceStride,
+                  std::uint8_t* destination,
+                  int destinationStride,
+                  int width,
+                  int height)
+{
+    // The vector code assumes the byte order of the pixels
+    if (!isLittleEndian()) {
+        argb32ToRgbaScalar(source, sourceStride, destination, destinationStride, width, height);
+        return;
+    }
+
+    const RowConverter convertRow = implementation().convertRow;
+
+    for (int y = 0; y < height; ++y)
+        convertRow(source + y * sourceStride, destination + y * destinationStride, width);
+}
+
+void argb32ToRgbaScalar(const std::uint8_t* source,
+                        int sourceStride,
+                        std::uint8_t* destination,
+                        int destinationStride,
+                        int width,
+                        int height)
+{
+    for (int y = 0; y < height; ++y)
+        convertRowScalar(source + y * sourceStride, destination + y * destinationStride, width);
+}
+
+void rgbaToGray(const std::uint8_t* source,
+                int sourceStride,
+                std::uint8_t* destination,
+                int destinationStride,
+                int width,
+                int height)
+{
+    if (!isLittleEndian()) {
+        rgbaToGrayScalar(source, sourceStride, destination, destinationStride, width, height);
+        return;
+    }
+
+    const RowConverter grayRow = implementation().grayRow;
+
+    for (int y = 0; y < height; ++y)
+        grayRow(source + y * sourceStride, destination + y * destinationStride, width);
+}
+
+void rgbaToGrayScalar(const std::uint8_t* source,
+                      int sourceStride,
+                      std::uint8_t* destination,
+                      int destinationStride,
+                      int width,
+                      int height)
+{
+    for (int y = 0; y < height; ++y)
+        grayRowScalar(source + y * sourceStride, destination + y * destinationStride, width);
+}
+
+bool rgbaToOpaqueGray(const std::uint8_t* source,
+                      int sourceStride,
+                      std::uint8_t* destination,
+                      int destinationStride,
+                      int width,
+                      int height)
+{
+    if (!isLittleEndian())
+        return rgbaToOpaqueGrayScalar(source, sourceStride, destination, destinationStride, width, height);
+
+    const RowChecker opaqueGrayRow = implementation().opaqueGrayRow;
+
+    for (int y = 0; y < height; ++y) {
+        if (!opaqueGrayRow(source + y * sourceStride, destination + y * destinationStride, width))
+            return false;
+    }
+
+    return true;
+}
+
+bool rgbaToOpaqueGrayScalar(const std::uint8_t* source,
+                            int sourceStride,
+                            std::uint8_t* destination,
+                            int destinationStride,
+                            int width,
+                            int height)
+{
+    for (int y = 0; y < height; ++y) {
+        if (!opaqueGrayRowScalar(source + y * sourceStride, destination + y * destinationStride, width))
+            return false;
+    }
+
+    return true;
+}
+
+void grayToRgba(const std::uint8_t* source,
+                int sourceStride,
+                std::uint8_t* destination,
+                int destinationStride,
+                int width,
+                int height)
+{
+    if (!isLittleEndian()) {
+        grayToRgbaScalar(source, sourceStride, destination, destinationStride, width, height);
+        return;
+    }
+
+    const RowConverter expandGrayRow = implementation().expandGrayRow;
+
+    for (int y = 0; y < height; ++y)
+        expandGrayRow(source + y * sourceStride, destination + y * destinationStride, width);
+}
+
+void grayToRgbaScalar(const std::uint8_t* source,
+                      int sourceStride,
+                      std::uint8_t* destination,
+                      int destinationStride,
+                      int width,
+                      int height)
+{
+    for (int y = 0; y < height; ++y)
+        expandGrayRowScalar(source + y * sourceStride, destination + y * destinationStride, width);
+}
+
+static void downscaleWith(RowBlender blendRows,
+                          const std::uint8_t* source,
+                          int sourceStride,
+                          int sourceWidth,
+                          int sourceHeight,
+                          std::uint8_t* destination,
+                          int destinationStride,
+                          int destinationWidth,
+                          int destinationHeight,
+                          int bytesPerPixel)
+{
+    if (sourceWidth <= 0 || sourceHeight <= 0 || destinationWidth <= 0 || destinationHeight <= 0)
+        return;
+
+    if (destinationWidth > sourceWidth || destinationHeight > sourceHeight)
+        throw std::invalid_argument{"Images can only be scaled down"};
+
+    // Beyond that, the vertical pass would take more rows than it has room for
+    if (sourceHeight > destinationHeight * (maximumBlendedRows - 1))
+        throw std::invalid_argument{"Images can't be scaled down that much at once"};
+
+    const Contributions columns = contributionsFor(sourceWidth, destinationWidth);
+    const Contributions rows = contributionsFor(sourceHeight, destinationHeight);
+    const int length = destinationWidth * bytesPerPixel;
+
+    // Every source row, scaled down horizontally, as each is used by one
+    // or two destination rows
+    std::vector<std::int16_t> scaledRows(static_cast<std::size_t>(length) * static_cast<std::size_t>(sourceHeight));
+    for (int y = 0; y < sourceHeight; ++y)
+        downscaleRowHorizontally(source + static_cast<std::ptrdiff_t>(y) * sourceStride,
+                                 scaledRows.data() + static_cast<std::ptrdiff_t>(y) * length,
+                                 columns,
+                                 destinationWidth,
+                                 bytesPerPixel);
+
+    const std::int16_t* rowPointers[maximumBlendedRows];
+
+    for (int y = 0; y < destinationHeight; ++y) {
+        const int numberOfRows = rows.offsets.at(y + 1) - rows.offsets.at(y);
+
+        for (int k = 0; k < numberOfRows; ++k)
+            rowPointers[k] = scaledRows.data() + static_cast<std::ptrdiff_t>(rows.first.at(y) + k) * length; //NOLINT
+
+        blendRows(rowPointers,
+                  rows.weights.data() + rows.offsets.at(y),
+                  numberOfRows,
+                  destination + static_cast<std::ptrdiff_t>(y) * destinationStride,
+                  length);
+    }
+}
+
+void downscale(const std::uint8_t* source,
+               int sourceStride,
+               int sourceWidth,
+               int sourceHeight,
+               std::uint8_t* destination,
+               int destinationStride,
+               int destinationWidth,
+               int destinationHeight,
+               int bytesPerPixel)
+{
+    downscaleWith(implementation().blendRows,
+                  source,
+                  sourceStride,
+                  sourceWidth,
+                  sourceHeight,
+                  destination,
+                  destinationStride,
+                  destinationWidth,
+                  destinationHeight,
+                  bytesPerPixel);
+}
+
+void downscaleScalar(const std::uint8_t* source,
+                     int sourceStride,
+                     int sourceWidth,
+                     int sourceHeight,
+                     std::uint8_t* destination,
+                     int destinationStride,
+                     int destinationWidth,
+                     int destinationHeight,
+                     int bytesPerPixel)
+{
+    downscaleWith(blendRowsScalar,
+                  source,
+                  sourceStride,
+                  sourceWidth,
+                  sourceHeight,
+                  destination,
+                  destinationStride,
+                  destinationWidth,
+                  destinationHeight,
+                  bytesPerPixel);
+}
+
+void drawRgbaOutline(std::uint8_t* pixels, int stride, int width, int height)
+{
+    if (width <= 0 || height <= 0)
+        return;
+
+    const std::uint8_t black[4] = {0, 0, 0, 0xff};
+
+    for (int x = 0; x < width; ++x) {
+        std::memcpy(pixels + 4 * x, black, 4);
+        std::memcpy(pixels + (height - 1) * stride + 4 * x, black, 4);
+    }
+
+    for (int y = 0; y < height; ++y) {
+        std::memcpy(pixels + y * stride, black, 4);
+        std::memcpy(pixels + y * stride + 4 * (width - 1), black, 4);
+    }
+}
+
+const char* argb32ToRgbaImplementation()
+{
+    if (!isLittleEndian())
+        return "scalar";
+
+    return implementation().name;
+}
+
+} // namespace Slicer::PixelConversion
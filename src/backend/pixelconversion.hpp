@@ -0,0 +1,133 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PIXELCONVERSION_HPP
+#define PIXELCONVERSION_HPP
+
+#include <cstdint>
+
+namespace Slicer::PixelConversion {
+
+// Converts premultiplied, native endian ARGB32 (what cairo and poppler
+// produce) into straight alpha RGBA bytes (what Gdk::Pixbuf holds).
+// Strides are in bytes. Uses the widest vector instructions the CPU has,
+// with a fast path for runs of opaque pixels, which is most of a page.
+void argb32ToRgba(const std::uint8_t* source,
+                  int sourceStride,
+                  std::uint8_t* destination,
+                  int destinationStride,
+                  int width,
+                  int height);
+
+// Plain C++ version of the above, for reference and for odd platforms
+void argb32ToRgbaScalar(const std::uint8_t* source,
+                        int sourceStride,
+                        std::uint8_t* destination,
+                        int destinationStride,
+                        int width,
+                        int height);
+
+// Gray levels of straight alpha RGBA bytes, one byte per pixel, with the
+// BT.601 weights in 8 bit fixed point. Alpha is ignored. Vectorized like
+// argb32ToRgba().
+void rgbaToGray(const std::uint8_t* source,
+                int sourceStride,
+                std::uint8_t* destination,
+                int destinationStride,
+                int width,
+                int height);
+
+// Plain C++ version of the above
+void rgbaToGrayScalar(const std::uint8_t* source,
+                      int sourceStride,
+                      std::uint8_t* destination,
+                      int destinationStride,
+                      int width,
+                      int height);
+
+// Whether every pixel of straight alpha RGBA bytes is an opaque gray,
+// with red, green and blue alike, as with pages of black text. If so, also
+// writes those levels to destination, one byte per pixel; otherwise stops
+// at the first pixel that isn't, with destination partly written.
+// Vectorized like argb32ToRgba().
+bool rgbaToOpaqueGray(const std::uint8_t* source,
+                      int sourceStride,
+                      std::uint8_t* destination,
+                      int destinationStride,
+                      int width,
+                      int height);
+
+// Plain C++ version of the above
+bool rgbaToOpaqueGrayScalar(const std::uint8_t* source,
+                            int sourceStride,
+                            std::uint8_t* destination,
+                            int destinationStride,
+                            int width,
+                            int height);
+
+// The other way around: opaque RGBA bytes from gray levels
+void grayToRgba(const std::uint8_t* source,
+                int sourceStride,
+                std::uint8_t* destination,
+                int destinationStride,
+                int width,
+                int height);
+
+// Plain C++ version of the above
+void grayToRgbaScalar(const std::uint8_t* source,
+                      int sourceStride,
+                      std::uint8_t* destination,
+                      int destinationStride,
+                      int width,
+                      int height);
+
+// Scales an image of 8 bit channels down, averaging the source pixels
+// under each destination pixel (a box filter), which is as sharp as it gets
+// without ringing for the ratios between zoom levels. bytesPerPixel is 3
+// or 4; every channel is averaged alike, so alpha is best straight and
+// opaque, as with thumbnails. The vertical pass uses the widest vector
+// instructions the CPU has. Throws std::invalid_argument if either size
+// would grow, or shrink by more than 15 times.
+void downscale(const std::uint8_t* source,
+               int sourceStride,
+               int sourceWidth,
+               int sourceHeight,
+               std::uint8_t* destination,
+               int destinationStride,
+               int destinationWidth,
+               int destinationHeight,
+               int bytesPerPixel);
+
+// Plain C++ version of the above, with the same results
+void downscaleScalar(const std::uint8_t* source,
+                     int sourceStride,
+                     int sourceWidth,
+                     int sourceHeight,
+                     std::uint8_t* destination,
+                     int destinationStride,
+                     int destinationWidth,
+                     int destinationHeight,
+                     int bytesPerPixel);
+
+// Paints a 1 pixel wide, opaque black border around an RGBA image
+void drawRgbaOutline(std::uint8_t* pixels, int stride, int width, int height);
+
+// Name of the implementation argb32ToRgba() picked, such as "avx2"
+const char* argb32ToRgbaImplementation();
+
+} // namespace Slicer::PixelConversion
+
+#endif // PIXELCONVERSION_HPP
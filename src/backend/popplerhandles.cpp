@@ -0,0 +1,130 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "popplerhandles.hpp"
+#include "mappedfile.hpp"
+#include "metrics.hpp"
+#include "remotefile.hpp"
+#include <sys/stat.h>
+#include <atomic>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace Slicer::PopplerHandles {
+
+namespace {
+    // Only ever grows, so each thread can remember how far it has read
+    std::mutex releasedFilesMutex;
+    std::vector<std::string> releasedFiles;
+    std::atomic<std::size_t> numberOfReleasedFiles = 0;
+
+    std::size_t sizeOfFile(const std::string& filePath)
+    {
+        struct stat status {};
+        if (::stat(filePath.c_str(), &status) != 0 || status.st_size <= 0)
+            return 0;
+
+        return static_cast<std::size_t>(status.st_size);
+    }
+
+    // Poppler keeps what it parsed of a file for as long as its document
+    // lives, which grows with the file; mappings of it may be shared
+    std::shared_ptr<poppler::document> charged(poppler::document* document,
+                                               std::size_t fileSize,
+                                               std::shared_ptr<MappedFile> mapping)
+    {
+        if (document == nullptr)
+            return nullptr;
+
+        auto charge = std::make_shared<Metrics::MemoryCharge>(Metrics::Memory::PopplerDocuments, fileSize);
+
+        return std::shared_ptr<poppler::document>{document, [mapping, charge](poppler::document* loaded) {
+                                                      delete loaded; //NOLINT
+                                                  }};
+    }
+}
+
+std::shared_ptr<poppler::document> load(const std::string& filePath)
+{
+    std::shared_ptr<MappedFile> mapping;
+    if (MappedFile::isUsableFor(filePath)) {
+        try {
+            mapping = std::make_shared<MappedFile>(filePath);
+        }
+        catch (const std::runtime_error&) {
+            // Read as a file then
+        }
+    }
+
+    if (mapping == nullptr || mapping->size() > static_cast<std::size_t>(std::numeric_limits<int>::max()))
+        return charged(poppler::document::load_from_file(filePath), sizeOfFile(filePath), nullptr);
+
+    // Poppler reads the raw data in place, for as long as the document lives
+    poppler::document* document = poppler::document::load_from_raw_data(mapping->data(),
+                                                                         static_cast<int>(mapping->size()));
+
+    return charged(document, mapping->size(), mapping);
+}
+
+poppler::document* forCurrentThread(const std::string& filePath)
+{
+    thread_local std::unordered_map<std::string, std::shared_ptr<poppler::document>> handles;
+    thread_local std::size_t numberOfReleasesSeen = 0;
+
+    if (numberOfReleasedFiles != numberOfReleasesSeen) {
+        std::lock_guard<std::mutex> lock{releasedFilesMutex};
+
+        for (; numberOfReleasesSeen < releasedFiles.size(); ++numberOfReleasesSeen)
+            handles.erase(releasedFiles.at(numberOfReleasesSeen));
+    }
+
+    auto it = handles.find(filePath);
+
+    if (it == handles.end()) {
+        std::shared_ptr<poppler::document> document = load(filePath);
+
+        if (document == nullptr)
+            throw std::runtime_error("Couldn't load file: " + filePath);
+
+        it = handles.emplace(filePath, std::move(document)).first;
+    }
+
+    return it->second.get();
+}
+
+void release(const std::string& filePath)
+{
+    std::lock_guard<std::mutex> lock{releasedFilesMutex};
+    releasedFiles.push_back(filePath);
+    numberOfReleasedFiles = releasedFiles.size();
+}
+
+std::unique_ptr<poppler::page> createPage(const std::string& filePath, unsigned int pageNumber)
+{
+    RemoteFile::waitUntilReadable(filePath, pageNumber);
+
+    std::unique_ptr<poppler::page> page{forCurrentThread(filePath)->create_page(static_cast<int>(pageNumber))};
+
+    if (page == nullptr)
+        throw std::runtime_error("Couldn't load page with number: " + std::to_string(pageNumber));
+
+    return page;
+}
+
+} // namespace Slicer::PopplerHandles
@@ -0,0 +1,48 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef POPPLERHANDLES_HPP
+#define POPPLERHANDLES_HPP
+
+#include <poppler/cpp/poppler-document.h>
+#include <poppler/cpp/poppler-page.h>
+#include <memory>
+#include <string>
+
+namespace Slicer::PopplerHandles {
+
+// Opens a document, or returns null if poppler can't. When MappedFile is
+// usable for the file, poppler reads it from a mapping that the document
+// keeps alive, so renders are served by the page cache without poppler
+// copying the file; otherwise, and for files too big for poppler's raw
+// data loading, it's read as a file.
+std::shared_ptr<poppler::document> load(const std::string& filePath);
+
+// A poppler::document can't be shared between threads, so every thread
+// that renders pages opens its own handle for each file it touches.
+// Handles are kept open for the lifetime of the calling thread.
+poppler::document* forCurrentThread(const std::string& filePath);
+
+// For files that won't be rendered again: every thread closes its handle
+// the next time it asks for any handle. Asking again opens a new one.
+void release(const std::string& filePath);
+
+// Waits for the page to be fetched first, if the file is a RemoteFile snapshot
+std::unique_ptr<poppler::page> createPage(const std::string& filePath, unsigned int pageNumber);
+
+} // namespace Slicer::PopplerHandles
+
+#endif // POPPLERHANDLES_HPP
@@ -0,0 +1,388 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "remotefile.hpp"
+#include "popplerhandles.hpp"
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace Slicer {
+
+namespace {
+    // The files being fetched, by the path of their snapshot
+    std::mutex startedFilesMutex;
+    std::unordered_map<std::string, std::weak_ptr<RemoteFile>> startedFiles;
+    // Lets readers of local files skip the lock
+    std::atomic<std::size_t> numberOfStartedFiles = 0;
+
+    std::shared_ptr<RemoteFile> findStarted(const std::string& snapshotPath)
+    {
+        if (numberOfStartedFiles == 0)
+            return nullptr;
+
+        std::lock_guard<std::mutex> lock{startedFilesMutex};
+        const auto it = startedFiles.find(snapshotPath);
+
+        return it != startedFiles.end() ? it->second.lock() : nullptr;
+    }
+
+    void skipWhitespace(std::string_view text, std::size_t& position)
+    {
+        while (position < text.size() && std::isspace(static_cast<unsigned char>(text[position])) != 0)
+            ++position;
+    }
+}
+
+std::optional<RemoteFile::Linearization> RemoteFile::readLinearization(std::string_view head)
+{
+    const std::size_t key = head.find("/Linearized");
+    if (key == std::string_view::npos)
+        return std::nullopt;
+
+    const std::size_t begin = head.rfind("<<", key);
+    const std::size_t end = head.find(">>", key);
+    if (begin == std::string_view::npos || end == std::string_view::npos)
+        return std::nullopt;
+
+    // Every entry of the dictionary is a number, or an array of them
+    const std::string_view dictionary = head.substr(begin + 2, end - begin - 2);
+    std::unordered_map<std::string, std::vector<std::uint64_t>> entries;
+
+    for (std::size_t position = 0; position < dictionary.size();) {
+        if (dictionary[position] != '/') {
+            ++position;
+            continue;
+        }
+
+        const std::size_t nameBegin = ++position;
+        while (position < dictionary.size() && std::isalnum(static_cast<unsigned char>(dictionary[position])) != 0)
+            ++position;
+        std::vector<std::uint64_t>& numbers = entries[std::string{dictionary.substr(nameBegin, position - nameBegin)}];
+
+        skipWhitespace(dictionary, position);
+        const bool isArray = position < dictionary.size() && dictionary[position] == '[';
+        if (isArray)
+            ++position;
+
+        do {
+            skipWhitespace(dictionary, position);
+            if (position == dictionary.size() || std::isdigit(static_cast<unsigned char>(dictionary[position])) == 0)
+                break;
+
+            std::uint64_t number = 0;
+            for (; position < dictionary.size() && std::isdigit(static_cast<unsigned char>(dictionary[position])) != 0; ++position)
+                number = number * 10 + static_cast<std::uint64_t>(dictionary[position] - '0');
+            numbers.push_back(number);
+        } while (isArray);
+    }
+
+    const auto single = [&entries](const std::string& name) -> std::optional<std::uint64_t> {
+        const auto it = entries.find(name);
+        if (it == entries.end() || it->second.size() != 1)
+            return std::nullopt;
+
+        return it->second.front();
+    };
+
+    const std::optional<std::uint64_t> fileLength = single("L");
+    const std::optional<std::uint64_t> firstPageEnd = single("E");
+    const std::optional<std::uint64_t> mainXRefOffset = single("T");
+    const std::optional<std::uint64_t> numberOfPages = single("N");
+    const auto hintStream = entries.find("H");
+
+    if (!fileLength.has_value() || !firstPageEnd.has_value() || !mainXRefOffset.has_value()
+        || !numberOfPages.has_value() || hintStream == entries.end() || hintStream->second.size() < 2)
+        return std::nullopt;
+
+    if (firstPageEnd.value() > fileLength.value() || mainXRefOffset.value() > fileLength.value())
+        return std::nullopt;
+
+    Linearization linearization;
+    linearization.fileLength = fileLength.value();
+    linearization.firstPageEnd = firstPageEnd.value();
+    linearization.mainXRefOffset = mainXRefOffset.value();
+    linearization.numberOfPages = static_cast<unsigned int>(numberOfPages.value());
+    linearization.hintStreamOffset = hintStream->second.at(0);
+    linearization.hintStreamLength = hintStream->second.at(1);
+
+    return linearization;
+}
+
+bool RemoteFile::isRemote(const Glib::RefPtr<Gio::File>& file)
+{
+    return file->get_path().empty();
+}
+
+std::shared_ptr<RemoteFile> RemoteFile::start(const Glib::RefPtr<Gio::File>& source,
+                                              const Glib::RefPtr<Gio::File>& snapshot)
+{
+    std::shared_ptr<RemoteFile> file{new RemoteFile{source, snapshot}};
+    file->fetchFirstPage();
+
+    {
+        std::lock_guard<std::mutex> lock{startedFilesMutex};
+        startedFiles[file->m_path] = file;
+        numberOfStartedFiles = startedFiles.size();
+    }
+
+    file->m_thread = std::thread{[file = file.get()]() {
+        file->fetchInBackground();
+    }};
+
+    return file;
+}
+
+RemoteFile::RemoteFile(const Glib::RefPtr<Gio::File>& source, const Glib::RefPtr<Gio::File>& snapshot)
+    : m_path{snapshot->get_path()}
+{
+    const Glib::RefPtr<Gio::FileInfo> info = source->query_info(m_cancellable, G_FILE_ATTRIBUTE_STANDARD_SIZE);
+    if (!info->has_attribute(G_FILE_ATTRIBUTE_STANDARD_SIZE))
+        throw std::runtime_error("The size of the file is unknown: " + source->get_uri());
+
+    m_size = static_cast<std::uint64_t>(info->get_size());
+    m_stream = source->read(m_cancellable);
+    m_canSeek = m_stream->can_seek();
+    m_isChunkFetched.resize(static_cast<std::size_t>((m_size + chunkSize - 1) / chunkSize));
+
+    // Sized up front, so that readers of the partial file get its real length
+    m_snapshot.open(m_path, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+    if (m_size > 0) {
+        m_snapshot.seekp(static_cast<std::streamoff>(m_size - 1));
+        m_snapshot.put('\0');
+        m_snapshot.flush();
+    }
+
+    if (!m_snapshot)
+        throw std::runtime_error("Couldn't create the snapshot: " + m_path);
+}
+
+RemoteFile::~RemoteFile()
+{
+    cancel();
+
+    if (m_thread.joinable())
+        m_thread.join();
+
+    std::lock_guard<std::mutex> lock{startedFilesMutex};
+    startedFiles.erase(m_path);
+    numberOfStartedFiles = startedFiles.size();
+}
+
+void RemoteFile::fetch(std::uint64_t offset, std::uint64_t length)
+{
+    ++m_numberOfWaitingFetches;
+    std::lock_guard<std::mutex> lock{m_mutex};
+
+    // Lowered with the lock held, so that the background fetch can't miss it
+    const auto stopWaiting = [this]() {
+        --m_numberOfWaitingFetches;
+        m_chunkFetched.notify_all();
+    };
+
+    try {
+        fetchRange(offset, length);
+    }
+    catch (...) {
+        stopWaiting();
+        throw;
+    }
+
+    stopWaiting();
+}
+
+void RemoteFile::waitUntilComplete() const
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    m_chunkFetched.wait(lock, [this]() {
+        return m_isComplete || !m_error.empty();
+    });
+
+    if (!m_isComplete)
+        throwIfFailed();
+}
+
+void RemoteFile::cancel()
+{
+    m_cancellable->cancel();
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (m_error.empty() && !m_isComplete)
+        m_error = "The download was canceled";
+
+    m_chunkFetched.notify_all();
+}
+
+bool RemoteFile::isComplete(const std::string& snapshotPath)
+{
+    const std::shared_ptr<RemoteFile> file = findStarted(snapshotPath);
+
+    return file == nullptr || file->isComplete();
+}
+
+void RemoteFile::waitUntilComplete(const std::string& snapshotPath)
+{
+    if (const std::shared_ptr<RemoteFile> file = findStarted(snapshotPath))
+        file->waitUntilComplete();
+}
+
+void RemoteFile::waitUntilReadable(const std::string& snapshotPath, unsigned int pageNumber)
+{
+    const std::shared_ptr<RemoteFile> file = findStarted(snapshotPath);
+
+    if (file == nullptr || (pageNumber == 0 && file->isFirstPageFetched()))
+        return;
+
+    file->waitUntilComplete();
+}
+
+void RemoteFile::fetchRange(std::uint64_t offset, std::uint64_t length)
+{
+    if (length == 0 || offset >= m_size)
+        return;
+
+    const std::uint64_t end = std::min(offset + length, m_size);
+
+    for (std::uint64_t chunk = offset / chunkSize; chunk * chunkSize < end; ++chunk)
+        fetchChunk(static_cast<std::size_t>(chunk));
+}
+
+void RemoteFile::fetchChunk(std::size_t chunk)
+{
+    throwIfFailed();
+
+    try {
+        // A stream that can't seek only goes forward, so everything before it is fetched already
+        for (std::size_t next = m_canSeek ? chunk : static_cast<std::size_t>(m_streamPosition / chunkSize);
+             next <= chunk && !m_isChunkFetched.at(chunk);
+             ++next)
+            readChunk(next);
+    }
+    catch (const Glib::Error& error) {
+        fail(error.what().raw());
+    }
+    catch (const std::exception& error) {
+        fail(error.what());
+    }
+}
+
+void RemoteFile::readChunk(std::size_t chunk)
+{
+    if (m_isChunkFetched.at(chunk))
+        return;
+
+    const std::uint64_t offset = chunk * chunkSize;
+    const std::size_t length = static_cast<std::size_t>(std::min(chunkSize, m_size - offset));
+
+    if (m_streamPosition != offset) {
+        m_stream->seek(static_cast<goffset>(offset), Glib::SEEK_TYPE_SET, m_cancellable);
+        m_streamPosition = offset;
+    }
+
+    m_buffer.resize(length);
+    for (std::size_t filled = 0; filled < length;) {
+        const gssize read = m_stream->read(m_buffer.data() + filled, length - filled, m_cancellable); //NOLINT
+        if (read <= 0)
+            throw std::runtime_error("The file ended before its size");
+
+        filled += static_cast<std::size_t>(read);
+    }
+    m_streamPosition += length;
+
+    m_snapshot.seekp(static_cast<std::streamoff>(offset));
+    m_snapshot.write(m_buffer.data(), static_cast<std::streamsize>(length));
+    // Readers of the snapshot open it on their own
+    m_snapshot.flush();
+    if (!m_snapshot)
+        throw std::runtime_error("Couldn't write the snapshot: " + m_path);
+
+    m_isChunkFetched.at(chunk) = true;
+}
+
+void RemoteFile::fetchFirstPage()
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+
+    const std::uint64_t headLength = std::min(headSize, m_size);
+    fetchRange(0, headLength);
+
+    std::string head(static_cast<std::size_t>(headLength), '\0');
+    m_snapshot.seekg(0);
+    m_snapshot.read(head.data(), static_cast<std::streamsize>(headLength));
+
+    m_linearization = readLinearization(head);
+    if (!m_linearization.has_value() || m_linearization->fileLength != m_size) {
+        m_linearization.reset();
+        return;
+    }
+
+    // Reaching the main cross-reference table would take the whole file
+    if (!m_canSeek)
+        return;
+
+    // The first page is read through the cross-reference table at the end
+    // and the hint stream, which tells where the objects of that page are
+    fetchRange(0, m_linearization->firstPageEnd);
+    fetchRange(m_linearization->mainXRefOffset, m_size - m_linearization->mainXRefOffset);
+    fetchRange(m_linearization->hintStreamOffset, m_linearization->hintStreamLength);
+    m_isFirstPageFetched = true;
+}
+
+void RemoteFile::fetchInBackground()
+{
+    for (std::size_t chunk = 0; chunk < m_isChunkFetched.size(); ++chunk) {
+        std::unique_lock<std::mutex> lock{m_mutex};
+
+        // Chunks that someone is waiting for go first
+        m_chunkFetched.wait(lock, [this]() {
+            return m_numberOfWaitingFetches == 0 || !m_error.empty();
+        });
+
+        try {
+            fetchChunk(chunk);
+        }
+        catch (const std::runtime_error&) {
+            // Whoever waits is told by m_error
+            return;
+        }
+    }
+
+    // Handles opened on the partial snapshot would keep reading it as it was
+    PopplerHandles::release(m_path);
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_isComplete = true;
+    m_snapshot.close();
+    m_chunkFetched.notify_all();
+}
+
+void RemoteFile::fail(const std::string& error)
+{
+    if (m_error.empty())
+        m_error = error;
+
+    m_chunkFetched.notify_all();
+    throw std::runtime_error(m_error);
+}
+
+void RemoteFile::throwIfFailed() const
+{
+    if (!m_error.empty())
+        throw std::runtime_error(m_error);
+}
+
+} // namespace Slicer
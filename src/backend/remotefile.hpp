@@ -0,0 +1,138 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef REMOTEFILE_HPP
+#define REMOTEFILE_HPP
+
+#include <giomm/cancellable.h>
+#include <giomm/file.h>
+#include <giomm/fileinputstream.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace Slicer {
+
+// A file with no local path, such as one served over HTTP by GVFS, copied
+// into a local snapshot chunk by chunk through a seekable stream, which
+// GVFS turns into range requests. Poppler and QPDF only read local files,
+// so they read the snapshot, which has the full size from the start: what
+// hasn't been fetched yet reads as zeros.
+// When the file is linearized, what the first page needs is fetched before
+// anything else, so that it can be shown while the rest comes in the
+// background. Chunks asked for by fetch() go ahead of the background ones.
+class RemoteFile {
+public:
+    // The parameters of a linearized file, from the dictionary that opens it
+    struct Linearization {
+        std::uint64_t fileLength = 0;
+        // Where the objects of the first page end
+        std::uint64_t firstPageEnd = 0;
+        // Where the main cross-reference table starts, near the end of the file
+        std::uint64_t mainXRefOffset = 0;
+        unsigned int numberOfPages = 0;
+        std::uint64_t hintStreamOffset = 0;
+        std::uint64_t hintStreamLength = 0;
+    };
+
+    // From the first bytes of a file; nothing if it isn't linearized
+    static std::optional<Linearization> readLinearization(std::string_view head);
+
+    static bool isRemote(const Glib::RefPtr<Gio::File>& file);
+
+    // Opens source and fetches what the first page needs before returning,
+    // if the file is linearized, and then the rest in the background.
+    // Throws Glib::Error or std::runtime_error if source can't be read.
+    static std::shared_ptr<RemoteFile> start(const Glib::RefPtr<Gio::File>& source,
+                                             const Glib::RefPtr<Gio::File>& snapshot);
+
+    RemoteFile(const RemoteFile&) = delete;
+    RemoteFile& operator=(const RemoteFile&) = delete;
+    RemoteFile(RemoteFile&&) = delete;
+    RemoteFile& operator=(RemoteFile&& src) = delete;
+
+    ~RemoteFile();
+
+    std::uint64_t size() const { return m_size; }
+    const std::optional<Linearization>& linearization() const { return m_linearization; }
+
+    // Blocks until the range is in the snapshot. Throws std::runtime_error
+    // if the download failed or was canceled.
+    void fetch(std::uint64_t offset, std::uint64_t length);
+    // Whether what the first page needs is in the snapshot already
+    bool isFirstPageFetched() const { return m_isFirstPageFetched; }
+    bool isComplete() const { return m_isComplete; }
+    // Throws like fetch()
+    void waitUntilComplete() const;
+    // Stops the download, failing whoever waits for it
+    void cancel();
+
+    // For readers that only know the path of the snapshot. Files that
+    // aren't snapshots of a remote file are complete, and never wait.
+    static bool isComplete(const std::string& snapshotPath);
+    static void waitUntilComplete(const std::string& snapshotPath);
+    // Pages other than the first wait for the whole file
+    static void waitUntilReadable(const std::string& snapshotPath, unsigned int pageNumber);
+
+    static constexpr std::uint64_t chunkSize = 256 * 1024;
+    // Where the linearization dictionary must be found
+    static constexpr std::uint64_t headSize = 1024;
+
+private:
+    RemoteFile(const Glib::RefPtr<Gio::File>& source, const Glib::RefPtr<Gio::File>& snapshot);
+
+    // With m_mutex locked
+    void fetchRange(std::uint64_t offset, std::uint64_t length);
+    void fetchChunk(std::size_t chunk);
+    void readChunk(std::size_t chunk);
+    [[noreturn]] void fail(const std::string& error);
+    void throwIfFailed() const;
+
+    void fetchFirstPage();
+    void fetchInBackground();
+
+    const std::string m_path;
+    const Glib::RefPtr<Gio::Cancellable> m_cancellable = Gio::Cancellable::create();
+    Glib::RefPtr<Gio::FileInputStream> m_stream;
+    bool m_canSeek = false;
+    std::uint64_t m_streamPosition = 0;
+    std::fstream m_snapshot;
+    std::vector<char> m_buffer;
+    std::uint64_t m_size = 0;
+    std::optional<Linearization> m_linearization;
+
+    mutable std::mutex m_mutex;
+    mutable std::condition_variable m_chunkFetched;
+    std::vector<bool> m_isChunkFetched;
+    std::string m_error;
+    std::atomic<unsigned int> m_numberOfWaitingFetches = 0;
+    std::atomic<bool> m_isFirstPageFetched = false;
+    // Only raised once the poppler handles opened on the partial snapshot are released
+    std::atomic<bool> m_isComplete = false;
+    std::thread m_thread;
+};
+
+} // namespace Slicer
+
+#endif // REMOTEFILE_HPP
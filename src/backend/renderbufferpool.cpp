@@ -0,0 +1,157 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "renderbufferpool.hpp"
+#include "cpuresources.hpp"
+
+namespace Slicer {
+
+static const std::size_t smallestSizeClass = 64 * 1024;
+
+RenderBufferPool::RenderBufferPool(std::size_t maxRetainedBytes)
+    : m_maxRetainedBytes{maxRetainedBytes}
+{
+}
+
+const std::shared_ptr<RenderBufferPool>& RenderBufferPool::shared()
+{
+    return sharedPools().at(CpuResources::currentNode());
+}
+
+const std::vector<std::shared_ptr<RenderBufferPool>>& RenderBufferPool::sharedPools()
+{
+    // The budget of retained buffers is shared by the nodes
+    static const std::vector<std::shared_ptr<RenderBufferPool>> pools = []() {
+        const std::size_t numberOfNodes = CpuResources::nodes().size();
+        std::vector<std::shared_ptr<RenderBufferPool>> perNode;
+
+        for (std::size_t node = 0; node < numberOfNodes; ++node)
+            perNode.push_back(std::make_shared<RenderBufferPool>(defaultMaxRetainedBytes / numberOfNodes));
+
+        return perNode;
+    }();
+
+    return pools;
+}
+
+Glib::RefPtr<Gdk::Pixbuf> RenderBufferPool::createPixbuf(int width, int height)
+{
+    const int rowstride = width * 4;
+    const std::size_t size = static_cast<std::size_t>(rowstride) * static_cast<std::size_t>(height);
+    const std::size_t sizeClass = size == m_exactSizeClass ? size : sizeClassFor(size);
+    std::uint8_t* buffer = acquire(sizeClass).release();
+
+    // Pixbufs can outlive everything else, so the slot keeps the pool alive
+    std::shared_ptr<RenderBufferPool> self = shared_from_this();
+
+    return Gdk::Pixbuf::create_from_data(buffer,
+                                         Gdk::COLORSPACE_RGB,
+                                         true,
+                                         8,
+                                         width,
+                                         height,
+                                         rowstride,
+                                         [self, sizeClass](const guint8* data) {
+                                             self->release(data, sizeClass);
+                                         });
+}
+
+void RenderBufferPool::trim()
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+
+    m_freeBuffers.clear();
+    m_retainedBytes = 0;
+}
+
+void RenderBufferPool::setExactSizeClass(std::size_t sizeInBytes)
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+
+    const std::size_t previous = m_exactSizeClass.exchange(sizeInBytes);
+
+    // Nothing else will ask for buffers of the old size again
+    if (previous == sizeInBytes || previous == sizeClassFor(previous))
+        return;
+
+    if (auto it = m_freeBuffers.find(previous); it != m_freeBuffers.end()) {
+        m_retainedBytes -= previous * it->second.size();
+        m_freeBuffers.erase(it);
+    }
+}
+
+std::size_t RenderBufferPool::retainedBytes() const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+
+    return m_retainedBytes;
+}
+
+std::size_t RenderBufferPool::numberOfAllocations() const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+
+    return m_numberOfAllocations;
+}
+
+std::unique_ptr<std::uint8_t[]> RenderBufferPool::acquire(std::size_t sizeClass) //NOLINT
+{
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+
+        if (auto it = m_freeBuffers.find(sizeClass); it != m_freeBuffers.end() && !it->second.empty()) {
+            std::unique_ptr<std::uint8_t[]> result = std::move(it->second.back()); //NOLINT
+            it->second.pop_back();
+            m_retainedBytes -= sizeClass;
+
+            return result;
+        }
+
+        ++m_numberOfAllocations;
+    }
+
+    return std::make_unique<std::uint8_t[]>(sizeClass); //NOLINT
+}
+
+void RenderBufferPool::release(const std::uint8_t* buffer, std::size_t sizeClass)
+{
+    std::unique_ptr<std::uint8_t[]> owned{const_cast<std::uint8_t*>(buffer)}; //NOLINT
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+
+    // Past the limit, buffers are just freed
+    if (m_retainedBytes + sizeClass > m_maxRetainedBytes)
+        return;
+
+    // So are those of an exact size class that's been replaced
+    if (sizeClass != m_exactSizeClass && sizeClass != sizeClassFor(sizeClass))
+        return;
+
+    m_freeBuffers[sizeClass].push_back(std::move(owned));
+    m_retainedBytes += sizeClass;
+}
+
+std::size_t RenderBufferPool::sizeClassFor(std::size_t size)
+{
+    std::size_t result = smallestSizeClass;
+
+    while (result < size)
+        result *= 2;
+
+    return result;
+}
+
+} // namespace Slicer
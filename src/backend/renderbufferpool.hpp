@@ -0,0 +1,84 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef RENDERBUFFERPOOL_HPP
+#define RENDERBUFFERPOOL_HPP
+
+#include <gdkmm/pixbuf.h>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Slicer {
+
+// Recycles the pixel buffers of rendered thumbnails. Buffers are grouped
+// in power of two size classes, so a zoom change that renders thousands of
+// pages of similar sizes keeps reusing the same few allocations.
+// Safe to use from several threads at once.
+class RenderBufferPool : public std::enable_shared_from_this<RenderBufferPool> {
+public:
+    explicit RenderBufferPool(std::size_t maxRetainedBytes = defaultMaxRetainedBytes);
+
+    RenderBufferPool(const RenderBufferPool&) = delete;
+    RenderBufferPool& operator=(const RenderBufferPool&) = delete;
+    RenderBufferPool(RenderBufferPool&&) = delete;
+    RenderBufferPool& operator=(RenderBufferPool&& src) = delete;
+
+    ~RenderBufferPool() = default;
+
+    // The pool used by PageRenderer: that of the NUMA node the calling
+    // thread runs on, so that rendering workers pinned to a node reuse
+    // buffers in memory of their node. A single pool without NUMA.
+    static const std::shared_ptr<RenderBufferPool>& shared();
+    // Every pool shared() may give, one per node
+    static const std::vector<std::shared_ptr<RenderBufferPool>>& sharedPools();
+
+    // An RGBA Pixbuf whose buffer goes back to the pool once it's destroyed.
+    // Its contents are undefined.
+    Glib::RefPtr<Gdk::Pixbuf> createPixbuf(int width, int height);
+
+    // Frees the buffers kept for reuse
+    void trim();
+
+    // Buffers of exactly this many bytes get a size class of their own,
+    // instead of being rounded up to a power of two. For documents where
+    // every thumbnail has the same size. 0 turns it off.
+    void setExactSizeClass(std::size_t sizeInBytes);
+
+    std::size_t retainedBytes() const;
+    std::size_t numberOfAllocations() const;
+
+    static constexpr std::size_t defaultMaxRetainedBytes = 64 * 1024 * 1024;
+
+private:
+    mutable std::mutex m_mutex;
+    std::map<std::size_t, std::vector<std::unique_ptr<std::uint8_t[]>>> m_freeBuffers; //NOLINT
+    std::size_t m_maxRetainedBytes;
+    std::size_t m_retainedBytes = 0;
+    std::size_t m_numberOfAllocations = 0;
+    std::atomic<std::size_t> m_exactSizeClass = 0;
+
+    std::unique_ptr<std::uint8_t[]> acquire(std::size_t sizeClass); //NOLINT
+    void release(const std::uint8_t* buffer, std::size_t sizeClass);
+
+    static std::size_t sizeClassFor(std::size_t size);
+};
+
+} // namespace Slicer
+
+#endif // RENDERBUFFERPOOL_HPP
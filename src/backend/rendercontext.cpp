@@ -0,0 +1,90 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "rendercontext.hpp"
+#include <poppler/cpp/poppler-version.h>
+#include <tuple>
+
+#if POPPLER_VERSION_MAJOR > 0 || POPPLER_VERSION_MINOR >= 65
+#define SLICER_POPPLER_LINE_MODES
+#endif
+
+namespace Slicer {
+
+bool RenderSettings::operator==(const RenderSettings& other) const
+{
+    return std::tie(antialiasing, textAntialiasing, textHinting, lineMode, paperColor)
+           == std::tie(other.antialiasing, other.textAntialiasing, other.textHinting, other.lineMode, other.paperColor);
+}
+
+namespace RenderContext {
+
+    namespace {
+        void apply(poppler::page_renderer& renderer, const RenderSettings& settings)
+        {
+            renderer.set_render_hint(poppler::page_renderer::antialiasing, settings.antialiasing);
+            renderer.set_render_hint(poppler::page_renderer::text_antialiasing, settings.textAntialiasing);
+            renderer.set_render_hint(poppler::page_renderer::text_hinting, settings.textHinting);
+            renderer.set_paper_color(settings.paperColor);
+
+#ifdef SLICER_POPPLER_LINE_MODES
+            switch (settings.lineMode) {
+            case RenderSettings::LineMode::Solid:
+                renderer.set_line_mode(poppler::page_renderer::line_solid);
+                break;
+            case RenderSettings::LineMode::Shape:
+                renderer.set_line_mode(poppler::page_renderer::line_shape);
+                break;
+            default:
+                renderer.set_line_mode(poppler::page_renderer::line_default);
+                break;
+            }
+#endif
+        }
+    }
+
+    poppler::page_renderer& forCurrentThread(const RenderSettings& settings)
+    {
+        thread_local poppler::page_renderer renderer;
+        thread_local bool isSetUp = false;
+        thread_local RenderSettings current;
+
+        if (!isSetUp || current != settings) {
+            apply(renderer, settings);
+            current = settings;
+            isSetUp = true;
+        }
+
+        return renderer;
+    }
+
+    bool supportsLineModes()
+    {
+#ifdef SLICER_POPPLER_LINE_MODES
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    bool canRender()
+    {
+        return poppler::page_renderer::can_render();
+    }
+
+} // namespace RenderContext
+
+} // namespace Slicer
@@ -0,0 +1,68 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef RENDERCONTEXT_HPP
+#define RENDERCONTEXT_HPP
+
+#include <poppler/cpp/poppler-page-renderer.h>
+#include <cstdint>
+
+namespace Slicer {
+
+// How poppler rasterizes a page. Its cpp frontend draws through Splash,
+// the one backend it has, so what can be chosen is how Splash goes about it.
+struct RenderSettings {
+    enum class LineMode {
+        Default,
+        // Thin lines drawn one pixel wide, solid or antialiased across pixels
+        Solid,
+        Shape
+    };
+
+    bool antialiasing = false;
+    bool textAntialiasing = true;
+    bool textHinting = false;
+    LineMode lineMode = LineMode::Default;
+    // 0xAARRGGBB
+    std::uint32_t paperColor = 0xffffffff;
+
+    bool operator==(const RenderSettings& other) const;
+    bool operator!=(const RenderSettings& other) const { return !(*this == other); }
+};
+
+namespace RenderContext {
+
+    // A renderer owned by the calling thread, set up with the given
+    // settings. It's kept for the lifetime of the thread, and only reset
+    // when asked for with other settings. Valid until the next call.
+    // Fonts aren't kept by the renderer, nor by the document handles:
+    // render_page() draws with a Splash device of its own that loads the
+    // fonts of the page afresh, and poppler's cpp frontend has no way in
+    // to share them. Font work follows the number of renders, whatever
+    // the number of threads; only system font lookups are process wide.
+    poppler::page_renderer& forCurrentThread(const RenderSettings& settings);
+
+    // Line modes need poppler 0.65 or later; on older ones they're ignored
+    bool supportsLineModes();
+
+    // Whether the installed poppler was built with a backend to render with at all
+    bool canRender();
+
+} // namespace RenderContext
+
+} // namespace Slicer
+
+#endif // RENDERCONTEXT_HPP
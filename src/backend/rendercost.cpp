@@ -0,0 +1,157 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "rendercost.hpp"
+#include "mappedinputsource.hpp"
+#include <qpdf/DLL.h>
+#include <qpdf/QPDF.hh>
+#include <qpdf/QPDFPageDocumentHelper.hh>
+#include <qpdf/QPDFPageObjectHelper.hh>
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <set>
+#include <stdexcept>
+
+namespace Slicer::RenderCost {
+
+namespace {
+    // Forms drawn by forms drawn by forms: deeper ones are rare, and left out
+    constexpr int maximumFormDepth = 4;
+
+    struct Contents {
+        std::uint64_t bytes = 0;
+        std::uint64_t numberOfImages = 0;
+        std::uint64_t imagePixels = 0;
+    };
+
+    void openFile(QPDF& qpdf, const std::string& filePath)
+    {
+        qpdf.setSuppressWarnings(true);
+
+        std::unique_ptr<MappedInputSource> source;
+        if (MappedFile::isUsableFor(filePath)) {
+            try {
+                source = std::make_unique<MappedInputSource>(filePath);
+            }
+            catch (const std::runtime_error&) {
+                // Read through stdio then
+            }
+        }
+
+        if (source != nullptr) {
+#if defined(QPDF_MAJOR_VERSION) && QPDF_MAJOR_VERSION >= 11
+            qpdf.processInputSource(std::shared_ptr<InputSource>{std::move(source)});
+#else
+            qpdf.processInputSource(PointerHolder<InputSource>{source.release()});
+#endif
+        }
+        else {
+            qpdf.processFile(filePath.c_str());
+        }
+    }
+
+    std::uint64_t lengthOf(QPDFObjectHandle stream)
+    {
+        if (!stream.isStream())
+            return 0;
+
+        QPDFObjectHandle length = stream.getDict().getKey("/Length");
+
+        return length.isInteger() && length.getIntValue() > 0 ? static_cast<std::uint64_t>(length.getIntValue()) : 0;
+    }
+
+    std::uint64_t integerOf(QPDFObjectHandle dict, const std::string& key)
+    {
+        QPDFObjectHandle value = dict.getKey(key);
+
+        return value.isInteger() && value.getIntValue() > 0 ? static_cast<std::uint64_t>(value.getIntValue()) : 0;
+    }
+
+    // Of the images and forms in resources, as if each were drawn once
+    void addXObjects(QPDFObjectHandle resources, int depth, std::set<QPDFObjGen>& visitedForms, Contents& contents)
+    {
+        if (!resources.isDictionary())
+            return;
+
+        QPDFObjectHandle xObjects = resources.getKey("/XObject");
+        if (!xObjects.isDictionary())
+            return;
+
+        for (const std::string& name : xObjects.getKeys()) {
+            QPDFObjectHandle xObject = xObjects.getKey(name);
+            if (!xObject.isStream())
+                continue;
+
+            QPDFObjectHandle dict = xObject.getDict();
+            QPDFObjectHandle subtype = dict.getKey("/Subtype");
+            if (!subtype.isName())
+                continue;
+
+            if (subtype.getName() == "/Image") {
+                ++contents.numberOfImages;
+                contents.imagePixels += integerOf(dict, "/Width") * integerOf(dict, "/Height");
+            }
+            else if (subtype.getName() == "/Form" && depth < maximumFormDepth
+                     && (!xObject.isIndirect() || visitedForms.insert(xObject.getObjGen()).second)) {
+                contents.bytes += lengthOf(xObject);
+                addXObjects(dict.getKey("/Resources"), depth + 1, visitedForms, contents);
+            }
+        }
+    }
+
+    std::uint32_t costOf(QPDFPageObjectHelper& page)
+    {
+        Contents contents;
+        QPDFObjectHandle pageContents = page.getObjectHandle().getKey("/Contents");
+
+        if (pageContents.isArray()) {
+            for (int i = 0; i < pageContents.getArrayNItems(); ++i)
+                contents.bytes += lengthOf(pageContents.getArrayItem(i));
+        }
+        else {
+            contents.bytes += lengthOf(pageContents);
+        }
+
+        std::set<QPDFObjGen> visitedForms;
+        addXObjects(page.getAttribute("/Resources", false), 0, visitedForms, contents);
+
+        // Weighed so that 256 KB of content streams cost as much as 64 megapixels of images
+        const std::uint64_t cost = contents.bytes / 256 + contents.numberOfImages * 4 + contents.imagePixels / 65536;
+
+        return static_cast<std::uint32_t>(std::min<std::uint64_t>(cost, std::numeric_limits<std::uint32_t>::max()));
+    }
+}
+
+std::vector<std::uint32_t> estimate(const std::string& filePath)
+{
+    try {
+        QPDF qpdf;
+        openFile(qpdf, filePath);
+
+        std::vector<std::uint32_t> costs;
+
+        for (QPDFPageObjectHelper& page : QPDFPageDocumentHelper{qpdf}.getAllPages())
+            costs.push_back(costOf(page));
+
+        return costs;
+    }
+    catch (const std::exception& error) {
+        throw std::runtime_error(std::string{"Couldn't read the pages of the file: "} + error.what());
+    }
+}
+
+} // namespace Slicer::RenderCost
@@ -0,0 +1,50 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef RENDERCOST_HPP
+#define RENDERCOST_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Slicer {
+
+// Guesses what rasterizing each page takes, so that the light ones can be
+// rendered before the heavy ones and progress can be told by work rather
+// than by pages. Costs only come from the dictionaries of the page: how long
+// its content streams are, and how many images it draws and of how many
+// pixels, forms included. Nothing is decoded, so counts of operators are
+// left out: finding them would take about as long as rendering. The
+// costs are in no unit, only good for comparing pages with each other.
+namespace RenderCost {
+
+    // One cost per page, in the order of the file, read with QPDF.
+    // Throws std::runtime_error if the file can't be read.
+    std::vector<std::uint32_t> estimate(const std::string& filePath);
+
+    // A 256 KB content stream, or 64 megapixels of images
+    constexpr std::uint32_t heavy = 1024;
+    // What every page takes besides what's estimated, writing it out for instance
+    constexpr std::uint32_t perPage = 16;
+
+    constexpr bool isHeavy(std::uint32_t cost) { return cost >= heavy; }
+
+} // namespace RenderCost
+
+} // namespace Slicer
+
+#endif // RENDERCOST_HPP
@@ -0,0 +1,419 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "renderdaemon.hpp"
+#include "sourcefile.hpp"
+#include "tempfile.hpp"
+#include <glibmm/checksum.h>
+#include <glibmm/fileutils.h>
+#include <glibmm/miscutils.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace Slicer {
+
+namespace {
+    // Renders only differ by what the request says, so that's what the cache
+    // tells them apart by, along with the hash of the file
+    std::string cacheNameFor(const std::string& fileHash, const RenderProtocol::RequestHeader& request)
+    {
+        return fileHash + "-" + std::to_string(request.width) + "x" + std::to_string(request.height)
+               + "r" + std::to_string(request.sourceRotation)
+               + "s" + std::to_string(request.antialiasing) + std::to_string(request.textAntialiasing)
+               + std::to_string(request.textHinting) + std::to_string(request.lineMode)
+               + "p" + std::to_string(request.paperColor);
+    }
+
+    bool isValid(const RenderProtocol::RequestHeader& request)
+    {
+        return request.width > 0 && request.width <= RenderDaemon::maxPageSize
+               && request.height > 0 && request.height <= RenderDaemon::maxPageSize
+               && request.targetSize > 0 && request.targetSize <= RenderDaemon::maxTargetSize
+               && request.sourceRotation % 90 == 0 && request.rotation % 90 == 0;
+    }
+
+    bool writeAll(int file, const char* data, std::size_t size)
+    {
+        while (size > 0) {
+            const ssize_t written = ::write(file, data, size);
+            if (written < 0 && errno == EINTR)
+                continue;
+            if (written <= 0)
+                return false;
+
+            data += written; //NOLINT
+            size -= static_cast<std::size_t>(written);
+        }
+
+        return true;
+    }
+}
+
+RenderDaemon::RenderDaemon(Options options)
+    : m_options{std::move(options)}
+    , m_renderProcessPool{m_options.helperPath, m_options.numberOfHelpers}
+    , m_diskCache{Glib::build_filename(m_options.storePath, "thumbnails"), m_options.diskCacheCapacity}
+    , m_cache{m_options.cacheCapacity}
+{
+    // Copies of files are only kept while the daemon runs; thumbnails outlive it
+    const std::string filesPath = Glib::build_filename(m_options.storePath, "files");
+    if (g_mkdir_with_parents(filesPath.c_str(), 0700) != 0)
+        throw std::runtime_error("Couldn't create the store of the render daemon: " + filesPath);
+
+    Glib::Dir files{filesPath};
+    for (const std::string& name : files)
+        std::remove(Glib::build_filename(filesPath, name).c_str());
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (m_options.socketPath.size() >= sizeof(address.sun_path))
+        throw std::runtime_error("The path of the socket is too long: " + m_options.socketPath);
+
+    std::memcpy(address.sun_path, m_options.socketPath.c_str(), m_options.socketPath.size() + 1);
+
+    if (::pipe2(m_stopPipe.data(), O_CLOEXEC) != 0)
+        throw std::runtime_error("Couldn't create the pipe of the render daemon");
+
+    m_socket = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (m_socket < 0) {
+        ::close(m_stopPipe.at(0));
+        ::close(m_stopPipe.at(1));
+        throw std::runtime_error("Couldn't create the socket of the render daemon");
+    }
+
+    // Left behind by a daemon that didn't exit cleanly
+    ::unlink(m_options.socketPath.c_str());
+
+    if (::bind(m_socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 //NOLINT
+        || ::chmod(m_options.socketPath.c_str(), 0666) != 0
+        || ::listen(m_socket, SOMAXCONN) != 0) {
+        ::close(m_socket);
+        ::close(m_stopPipe.at(0));
+        ::close(m_stopPipe.at(1));
+        throw std::runtime_error("Couldn't listen on " + m_options.socketPath);
+    }
+}
+
+RenderDaemon::~RenderDaemon()
+{
+    stop();
+
+    {
+        // Wakes up the connections waiting for their next request
+        std::unique_lock<std::mutex> lock{m_mutex};
+        for (int connection : m_connections)
+            ::shutdown(connection, SHUT_RDWR);
+
+        m_connectionClosed.wait(lock, [this]() { return m_connections.empty(); });
+    }
+
+    ::close(m_socket);
+    ::close(m_stopPipe.at(0));
+    ::close(m_stopPipe.at(1));
+    ::unlink(m_options.socketPath.c_str());
+}
+
+void RenderDaemon::run()
+{
+    std::array<pollfd, 2> waiting{pollfd{m_socket, POLLIN, 0}, pollfd{m_stopPipe.at(0), POLLIN, 0}};
+
+    while (!m_isStopping) {
+        if (::poll(waiting.data(), waiting.size(), -1) < 0 && errno != EINTR)
+            return;
+
+        if ((waiting.at(0).revents & POLLIN) == 0)
+            continue;
+
+        const int connection = ::accept4(m_socket, nullptr, nullptr, SOCK_CLOEXEC);
+        if (connection < 0)
+            continue;
+
+        std::lock_guard<std::mutex> lock{m_mutex};
+        if (m_isStopping) {
+            ::close(connection);
+            return;
+        }
+
+        // Rather than a thread more for each
+        if (m_connections.size() >= m_options.maxConnections) {
+            ::close(connection);
+            continue;
+        }
+
+        m_connections.insert(connection);
+        std::thread{[this, connection]() { serve(connection); }}.detach();
+    }
+}
+
+void RenderDaemon::stop()
+{
+    if (m_isStopping.exchange(true))
+        return;
+
+    const char byte = 0;
+    [[maybe_unused]] const ssize_t written = ::write(m_stopPipe.at(1), &byte, 1);
+}
+
+void RenderDaemon::serve(int connection)
+{
+    RenderProtocol::Request request;
+
+    while (!m_isStopping && RenderProtocol::receiveRequest(connection, request)) {
+        Glib::RefPtr<Gdk::Pixbuf> thumbnail;
+        std::string error;
+
+        try {
+            thumbnail = answer(request);
+        }
+        catch (const std::exception& e) {
+            error = e.what();
+        }
+        catch (const Glib::Error& e) {
+            error = e.what();
+        }
+
+        if (request.file >= 0)
+            ::close(request.file);
+
+        const bool isAnswered = thumbnail ? RenderProtocol::sendThumbnail(connection, thumbnail)
+                                          : RenderProtocol::sendError(connection, error);
+        if (!isAnswered)
+            break;
+    }
+
+    // Notified under the lock, since the daemon may be gone once it's released
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_connections.erase(connection);
+    ::close(connection);
+    m_connectionClosed.notify_all();
+}
+
+Glib::RefPtr<Gdk::Pixbuf> RenderDaemon::answer(const RenderProtocol::Request& request)
+{
+    if (request.file < 0)
+        throw std::runtime_error("The file didn't come with the request");
+
+    if (!isValid(request.header))
+        throw std::runtime_error("Not a page that can be rendered");
+
+    const std::string fileHash = storeFile(request.file);
+
+    try {
+        Glib::RefPtr<Gdk::Pixbuf> thumbnail = render(request, fileHash);
+        releaseFile(fileHash);
+
+        return thumbnail;
+    }
+    catch (...) {
+        releaseFile(fileHash);
+        throw;
+    }
+}
+
+Glib::RefPtr<Gdk::Pixbuf> RenderDaemon::render(const RenderProtocol::Request& request, const std::string& fileHash)
+{
+    const PageRenderer::Quality quality = RenderProtocol::qualityOf(request.header);
+    const ThumbnailCache::Key key{cacheNameFor(fileHash, request.header),
+                                  request.header.indexInFile,
+                                  request.header.rotation,
+                                  request.header.targetSize,
+                                  0,
+                                  0};
+    // The hash is of the whole file, so there's no origin to go with it
+    const DiskThumbnailCache::Key diskKey{key.fileHash, key.indexInFile, key.rotation, key.targetSize, 0, 0};
+
+    // Drafts are only there until the real render, so they're not worth keeping
+    if (quality == PageRenderer::Quality::Full) {
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            if (Glib::RefPtr<Gdk::Pixbuf> thumbnail = m_cache.find(key))
+                return thumbnail;
+        }
+
+        if (Glib::RefPtr<Gdk::Pixbuf> thumbnail = m_diskCache.load(diskKey)) {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            m_cache.insert(key, thumbnail);
+
+            return thumbnail;
+        }
+    }
+
+    const Glib::RefPtr<const Page> page = RenderProtocol::pageOf(request.header,
+                                                                 SourceFile::borrowed(Gio::File::create_for_path(storedPath(fileHash))));
+    Glib::RefPtr<Gdk::Pixbuf> thumbnail = m_renderProcessPool.render(*page.get(),
+                                                                     request.header.targetSize,
+                                                                     quality,
+                                                                     RenderProtocol::settingsOf(request.header));
+
+    if (quality == PageRenderer::Quality::Full) {
+        m_diskCache.store(diskKey, thumbnail);
+
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_cache.insert(key, thumbnail);
+    }
+
+    return thumbnail;
+}
+
+std::string RenderDaemon::storeFile(int file)
+{
+    struct stat status {};
+    if (::fstat(file, &status) != 0 || !S_ISREG(status.st_mode))
+        throw std::runtime_error("Not a file that can be rendered");
+
+    const FileIdentity identity{status.st_dev, status.st_ino, status.st_size, status.st_mtim.tv_sec, status.st_mtim.tv_nsec};
+    const auto fileSize = static_cast<std::uint64_t>(status.st_size);
+
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        if (auto it = m_fileHashes.find(identity); it != m_fileHashes.end()) {
+            if (auto stored = m_storedFiles.find(it->second); stored != m_storedFiles.end()) {
+                ++stored->second.users;
+                stored->second.lastUse = ++m_numberOfUses;
+                return it->second;
+            }
+
+            // Its copy made room for others since
+            m_fileHashes.erase(it);
+        }
+
+        // Taken before copying, so that copies on their way in can't go past the capacity together
+        if (!makeRoomFor(fileSize))
+            throw std::runtime_error("The file doesn't fit in the render daemon's store");
+        m_storedSize += fileSize;
+    }
+
+    // What's hashed is what's written to the copy, so that a client changing
+    // its file meanwhile can't get other contents stored under a hash. No
+    // more than the room taken is copied should the file grow.
+    const auto partialFile = TempFile::generateNextTo(Gio::File::create_for_path(storedPath("file")));
+    const std::string partialPath = partialFile->get_path();
+    const int copy = ::open(partialPath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600); //NOLINT
+    std::uint64_t offset = 0;
+    bool isCopied = copy >= 0;
+
+    if (isCopied) {
+        Glib::Checksum checksum{Glib::Checksum::CHECKSUM_SHA256};
+        std::vector<char> buffer(1024 * 1024);
+
+        while (offset < fileSize) {
+            const auto wanted = static_cast<std::size_t>(std::min<std::uint64_t>(buffer.size(), fileSize - offset));
+            const ssize_t size = ::pread(file, buffer.data(), wanted, static_cast<off_t>(offset));
+            if (size < 0 && errno == EINTR)
+                continue;
+            if (size <= 0) {
+                isCopied = false;
+                break;
+            }
+
+            checksum.update(reinterpret_cast<const guchar*>(buffer.data()), static_cast<gsize>(size)); //NOLINT
+            if (!writeAll(copy, buffer.data(), static_cast<std::size_t>(size))) {
+                isCopied = false;
+                break;
+            }
+
+            offset += static_cast<std::uint64_t>(size);
+        }
+
+        ::close(copy);
+
+        if (isCopied) {
+            const std::string fileHash = checksum.get_string();
+
+            std::lock_guard<std::mutex> lock{m_mutex};
+            m_storedSize -= fileSize;
+
+            auto stored = m_storedFiles.find(fileHash);
+            if (stored != m_storedFiles.end()) {
+                // Just stored for another request
+                std::remove(partialPath.c_str());
+            }
+            else if (::rename(partialPath.c_str(), storedPath(fileHash).c_str()) == 0) {
+                stored = m_storedFiles.emplace(fileHash, StoredFile{fileSize, 0, 0}).first;
+                m_storedSize += fileSize;
+            }
+            else {
+                std::remove(partialPath.c_str());
+                throw std::runtime_error("Couldn't store the file");
+            }
+
+            ++stored->second.users;
+            stored->second.lastUse = ++m_numberOfUses;
+
+            if (m_fileHashes.size() >= m_options.maxKnownFiles)
+                m_fileHashes.erase(m_fileHashes.begin());
+            m_fileHashes.insert_or_assign(identity, fileHash);
+
+            return fileHash;
+        }
+
+        std::remove(partialPath.c_str());
+    }
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_storedSize -= fileSize;
+
+    throw std::runtime_error("Couldn't store the file");
+}
+
+void RenderDaemon::releaseFile(const std::string& fileHash)
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (auto stored = m_storedFiles.find(fileHash); stored != m_storedFiles.end())
+        --stored->second.users;
+}
+
+bool RenderDaemon::makeRoomFor(std::uint64_t size)
+{
+    if (size > m_options.fileStoreCapacity)
+        return false;
+
+    while (m_storedSize + size > m_options.fileStoreCapacity) {
+        auto unused = m_storedFiles.end();
+        for (auto it = m_storedFiles.begin(); it != m_storedFiles.end(); ++it) {
+            if (it->second.users == 0 && (unused == m_storedFiles.end() || it->second.lastUse < unused->second.lastUse))
+                unused = it;
+        }
+
+        if (unused == m_storedFiles.end())
+            return false;
+
+        // Identities it was known by are dropped as they're looked up
+        std::remove(storedPath(unused->first).c_str());
+        m_storedSize -= unused->second.size;
+        m_storedFiles.erase(unused);
+    }
+
+    return true;
+}
+
+std::string RenderDaemon::storedPath(const std::string& fileHash) const
+{
+    return Glib::build_filename(m_options.storePath, "files", fileHash + ".pdf");
+}
+
+} // namespace Slicer
@@ -0,0 +1,139 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef RENDERDAEMON_HPP
+#define RENDERDAEMON_HPP
+
+#include "diskthumbnailcache.hpp"
+#include "renderprocesspool.hpp"
+#include "renderprotocol.hpp"
+#include "thumbnailcache.hpp"
+#include <sys/types.h>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <tuple>
+
+namespace Slicer {
+
+// Renders pages for every instance on the host, through a socket they all
+// connect to with RenderProcessPool::Target::Daemon, so that a file opened
+// by several users, or in several windows, is rendered once. Clients send
+// the file itself along with each request, and the daemon keeps a copy of
+// its own, named after the SHA-256 of its contents, for as long as there's
+// room for it once no render uses it anymore. Thumbnails are cached
+// by that hash, in memory and on disk, so they're shared by every client
+// that has the same file, wherever it is. The daemon never trusts what
+// clients say a file is: it hashes its own copy.
+// Renders happen in helper processes, like in the application, so that a
+// file that crashes poppler only costs the request that sent it.
+class RenderDaemon {
+public:
+    struct Options {
+        std::string socketPath;
+        // Where the copies of files and the disk cache are kept
+        std::string storePath;
+        std::string helperPath;
+        unsigned int numberOfHelpers = 2;
+        std::size_t cacheCapacity = ThumbnailCache::defaultCapacity;
+        std::size_t diskCacheCapacity = 512 * 1024 * 1024;
+        // What the copies of files take in all, those on their way in too.
+        // The least recently used ones that no render uses are removed to
+        // make room, and a file that still doesn't fit is turned down.
+        std::uint64_t fileStoreCapacity = std::uint64_t{1} * 1024 * 1024 * 1024;
+        // Files known by identity, which are then not copied again
+        std::size_t maxKnownFiles = 4096;
+        // Connections past these are closed as they come, and the clients render on their own
+        std::size_t maxConnections = 64;
+    };
+
+    // Listens on the socket right away, and lets every local user connect.
+    // Throws std::runtime_error if it can't.
+    explicit RenderDaemon(Options options);
+
+    RenderDaemon(const RenderDaemon&) = delete;
+    RenderDaemon& operator=(const RenderDaemon&) = delete;
+    RenderDaemon(RenderDaemon&&) = delete;
+    RenderDaemon& operator=(RenderDaemon&& src) = delete;
+
+    // Stops, waits for the connections to close, and removes the socket.
+    // run() must have returned by then.
+    ~RenderDaemon();
+
+    // Serves every client until stop() is called, one thread per connection,
+    // up to Options::maxConnections at once
+    void run();
+    // Async-signal-safe, so SIGTERM can stop the daemon
+    void stop();
+
+    // Bigger requests are turned down
+    static constexpr int maxTargetSize = 8192;
+    static constexpr int maxPageSize = 100000;
+
+private:
+    // Files that are known already, by device, inode, size and modification time
+    using FileIdentity = std::tuple<dev_t, ino_t, off_t, time_t, long>;
+
+    const Options m_options;
+    RenderProcessPool m_renderProcessPool;
+    DiskThumbnailCache m_diskCache;
+
+    int m_socket = -1;
+    std::array<int, 2> m_stopPipe{-1, -1};
+    std::atomic_bool m_isStopping = false;
+
+    // Guards everything from here on
+    std::mutex m_mutex;
+    ThumbnailCache m_cache;
+    std::map<FileIdentity, std::string> m_fileHashes;
+
+    struct StoredFile {
+        std::uint64_t size;
+        // Counts requests, so that the least recently used goes first
+        std::uint64_t lastUse;
+        // Requests rendering from it, which keep it
+        unsigned int users;
+    };
+
+    std::map<std::string, StoredFile> m_storedFiles;
+    // Of the stored files, and of those being copied
+    std::uint64_t m_storedSize = 0;
+    std::uint64_t m_numberOfUses = 0;
+    // Each served by a thread of its own
+    std::set<int> m_connections;
+    std::condition_variable m_connectionClosed;
+
+    void serve(int connection);
+    Glib::RefPtr<Gdk::Pixbuf> answer(const RenderProtocol::Request& request);
+    Glib::RefPtr<Gdk::Pixbuf> render(const RenderProtocol::Request& request, const std::string& fileHash);
+    // The hash of the file that came with a request, after keeping a copy of
+    // it, which stays until releaseFile()
+    std::string storeFile(int file);
+    void releaseFile(const std::string& fileHash);
+    // Removes the least recently used copies no render uses until size more
+    // fits. False if it can't. Under m_mutex.
+    bool makeRoomFor(std::uint64_t size);
+    std::string storedPath(const std::string& fileHash) const;
+};
+
+} // namespace Slicer
+
+#endif // RENDERDAEMON_HPP
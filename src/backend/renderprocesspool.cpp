@@ -0,0 +1,348 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "renderprocesspool.hpp"
+#include "remotefile.hpp"
+#include "renderprotocol.hpp"
+#include "sourcefile.hpp"
+#include "trace.hpp"
+#include <glibmm/fileutils.h>
+#include <glibmm/miscutils.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <map>
+
+namespace Slicer {
+
+RenderProcessPool::RenderProcessPool(std::string helperPath,
+                                     unsigned int numberOfProcesses,
+                                     std::chrono::milliseconds timeout)
+    : RenderProcessPool{Target::Helpers, std::move(helperPath), numberOfProcesses, timeout}
+{
+}
+
+RenderProcessPool::RenderProcessPool(Target target,
+                                     std::string path,
+                                     unsigned int numberOfProcesses,
+                                     std::chrono::milliseconds timeout)
+    : m_target{target}
+    , m_path{std::move(path)}
+    , m_timeout{timeout}
+    , m_numberOfProcesses{std::max(1U, numberOfProcesses)}
+    , m_idleProcesses(m_numberOfProcesses)
+{
+}
+
+RenderProcessPool::~RenderProcessPool()
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    m_processReturned.wait(lock, [this]() { return m_idleProcesses.size() == m_numberOfProcesses; });
+
+    // Helpers exit once their socket is closed
+    for (Process& process : m_idleProcesses) {
+        if (process.socket >= 0)
+            ::close(process.socket);
+
+        if (process.pid > 0)
+            ::waitpid(process.pid, nullptr, 0);
+    }
+}
+
+Glib::RefPtr<Gdk::Pixbuf> RenderProcessPool::render(const Page& page, int targetSize, PageRenderer::Quality quality)
+{
+    return render(page, targetSize, quality, PageRenderer::renderSettings(quality));
+}
+
+Glib::RefPtr<Gdk::Pixbuf> RenderProcessPool::render(const Page& page,
+                                                    int targetSize,
+                                                    PageRenderer::Quality quality,
+                                                    const RenderSettings& settings)
+{
+    const Trace::Span span{"RenderProcessPool::render"};
+    const std::pair<std::string, unsigned int> pageKey{page.filePath(), page.indexInFile()};
+
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        if (m_failedPages.count(pageKey) > 0)
+            throw RenderFailed{"The page took down a render helper before"};
+    }
+
+    // What this process fetches of a remote file is only in the snapshot once it's
+    // here. The daemon stores whole files, so it gets them once they're complete.
+    if (m_target == Target::Daemon)
+        RemoteFile::waitUntilComplete(page.filePath());
+    else
+        RemoteFile::waitUntilReadable(page.filePath(), page.indexInFile());
+
+    Process process = take(page.filePath());
+
+    try {
+        Glib::RefPtr<Gdk::Pixbuf> thumbnail = exchange(process, page, targetSize, quality, settings);
+        process.lastFilePath = page.filePath();
+        giveBack(std::move(process));
+
+        return thumbnail;
+    }
+    catch (const RenderFailed&) {
+        // The helper was lost on it, rather than told it couldn't be rendered.
+        // The daemon renders through helpers of its own, which it watches.
+        if (process.socket < 0 && m_target == Target::Helpers) {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            m_failedPages.insert(pageKey);
+        }
+
+        giveBack(std::move(process));
+        throw;
+    }
+}
+
+std::string RenderProcessPool::findHelper()
+{
+    try {
+        const std::string executable = Glib::file_read_link("/proc/self/exe");
+        const std::string besideExecutable = Glib::build_filename(Glib::path_get_dirname(executable), helperName);
+
+        if (Glib::file_test(besideExecutable, Glib::FILE_TEST_IS_EXECUTABLE))
+            return besideExecutable;
+    }
+    catch (const Glib::FileError&) {
+        // Not on Linux, look in PATH then
+    }
+
+    return Glib::find_program_in_path(helperName);
+}
+
+RenderProcessPool::Process RenderProcessPool::take(const std::string& filePath)
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    m_processReturned.wait(lock, [this]() { return !m_idleProcesses.empty(); });
+
+    auto it = std::find_if(m_idleProcesses.begin(), m_idleProcesses.end(), [&filePath](const Process& process) {
+        return process.lastFilePath == filePath;
+    });
+    if (it == m_idleProcesses.end())
+        it = std::prev(m_idleProcesses.end());
+
+    Process process = std::move(*it);
+    m_idleProcesses.erase(it);
+
+    return process;
+}
+
+void RenderProcessPool::giveBack(Process process)
+{
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_idleProcesses.push_back(std::move(process));
+    }
+
+    m_processReturned.notify_all();
+}
+
+void RenderProcessPool::start(Process& process) const
+{
+    if (m_target == Target::Daemon) {
+        connect(process);
+        return;
+    }
+
+    std::array<int, 2> sockets{};
+    if (::socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sockets.data()) != 0)
+        throw RenderFailed{"Couldn't create the socket of a render helper"};
+
+    // The child of a threaded process can only make async-signal-safe
+    // calls before exec, so everything it needs is ready beforehand
+    const std::string socketArgument = std::to_string(sockets.at(1));
+    std::array<char*, 3> arguments{const_cast<char*>(m_path.c_str()), //NOLINT
+                                   const_cast<char*>(socketArgument.c_str()), //NOLINT
+                                   nullptr};
+    const int helperSocket = sockets.at(1);
+
+    const pid_t pid = ::fork();
+
+    if (pid == 0) {
+        // Goes away with the application, even if it crashes
+        ::prctl(PR_SET_PDEATHSIG, SIGKILL);
+        ::fcntl(helperSocket, F_SETFD, 0);
+        ::execv(arguments.at(0), arguments.data());
+        ::_exit(127);
+    }
+
+    ::close(helperSocket);
+
+    if (pid < 0) {
+        ::close(sockets.at(0));
+        throw RenderFailed{"Couldn't start a render helper"};
+    }
+
+    process.pid = pid;
+    process.socket = sockets.at(0);
+    process.lastFilePath.clear();
+}
+
+void RenderProcessPool::connect(Process& process) const
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (m_path.size() >= sizeof(address.sun_path))
+        throw Unreachable{"The path of the render daemon's socket is too long: " + m_path};
+
+    std::memcpy(address.sun_path, m_path.c_str(), m_path.size() + 1);
+
+    const int socket = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (socket < 0)
+        throw Unreachable{"Couldn't create a socket for the render daemon"};
+
+    if (::connect(socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) { //NOLINT
+        ::close(socket);
+        throw Unreachable{"The render daemon isn't listening at " + m_path};
+    }
+
+    process.socket = socket;
+    process.lastFilePath.clear();
+}
+
+void RenderProcessPool::stop(Process& process)
+{
+    if (process.pid > 0) {
+        ::kill(process.pid, SIGKILL);
+        ::waitpid(process.pid, nullptr, 0);
+    }
+
+    if (process.socket >= 0)
+        ::close(process.socket);
+
+    process = Process{};
+}
+
+void RenderProcessPool::lose(Process& process, const std::string& error) const
+{
+    stop(process);
+
+    if (m_target == Target::Daemon)
+        throw Unreachable{error};
+
+    throw RenderFailed{error};
+}
+
+Glib::RefPtr<Gdk::Pixbuf> RenderProcessPool::exchange(Process& process,
+                                                      const Page& page,
+                                                      int targetSize,
+                                                      PageRenderer::Quality quality,
+                                                      const RenderSettings& settings) const
+{
+    if (process.socket < 0)
+        start(process);
+
+    const std::string& filePath = page.filePath();
+    const std::string pageName = "page " + std::to_string(page.indexInFile() + 1) + " of " + filePath;
+
+    // The daemon may run as another user, who can read the file through this
+    int file = -1;
+    if (m_target == Target::Daemon) {
+        file = ::open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (file < 0)
+            throw RenderFailed{"Couldn't open " + filePath};
+    }
+
+    const bool isSent = RenderProtocol::sendRequest(process.socket,
+                                                    RenderProtocol::requestFor(page, targetSize, quality, settings),
+                                                    filePath,
+                                                    file);
+    if (file >= 0)
+        ::close(file);
+
+    if (!isSent) {
+        if (filePath.size() > RenderProtocol::maxPathLength)
+            throw RenderFailed{"The path is too long to render in another process: " + filePath};
+
+        lose(process, "The render process is gone");
+    }
+
+    // The watchdog: a helper stuck in poppler doesn't get to keep a render thread
+    pollfd waiting{process.socket, POLLIN, 0};
+    int numberOfReady = 0;
+    do
+        numberOfReady = ::poll(&waiting, 1, static_cast<int>(m_timeout.count()));
+    while (numberOfReady < 0 && errno == EINTR);
+
+    if (numberOfReady == 0)
+        lose(process, "The render process took too long on " + pageName);
+
+    RenderProtocol::Response response;
+    if (!RenderProtocol::receiveResponse(process.socket, response))
+        lose(process, "The render process crashed on " + pageName);
+
+    if (!response.thumbnail)
+        throw RenderFailed{response.error};
+
+    return response.thumbnail;
+}
+
+int RenderProcessPool::serve(int socket)
+{
+    // Borrowed: the application owns the snapshots, and removes them
+    std::map<std::string, std::shared_ptr<SourceFile>> sourceFiles;
+
+    while (true) {
+        RenderProtocol::Request request;
+        if (!RenderProtocol::receiveRequest(socket, request))
+            return EXIT_SUCCESS;
+
+        if (request.file >= 0)
+            ::close(request.file);
+
+        Glib::RefPtr<Gdk::Pixbuf> thumbnail;
+        std::string error;
+
+        try {
+            std::shared_ptr<SourceFile>& sourceFile = sourceFiles[request.filePath];
+            if (sourceFile == nullptr)
+                sourceFile = SourceFile::borrowed(Gio::File::create_for_path(request.filePath));
+
+            const PageRenderer::Quality quality = RenderProtocol::qualityOf(request.header);
+            PageRenderer::setRenderSettings(quality, RenderProtocol::settingsOf(request.header));
+
+            const Glib::RefPtr<const Page> page = RenderProtocol::pageOf(request.header, sourceFile);
+            thumbnail = PageRenderer{page}.render(request.header.targetSize, quality);
+        }
+        catch (const std::exception& e) {
+            error = e.what();
+        }
+        catch (const Glib::Error& e) {
+            error = e.what();
+        }
+
+        const bool isAnswered = thumbnail ? RenderProtocol::sendThumbnail(socket, thumbnail)
+                                          : RenderProtocol::sendError(socket, error);
+        if (!isAnswered)
+            return EXIT_FAILURE;
+    }
+}
+
+} // namespace Slicer
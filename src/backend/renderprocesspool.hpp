@@ -0,0 +1,140 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef RENDERPROCESSPOOL_HPP
+#define RENDERPROCESSPOOL_HPP
+
+#include "page.hpp"
+#include "pagerenderer.hpp"
+#include <sys/types.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Slicer {
+
+// Renders pages in helper processes instead of this one, so that a file
+// that makes poppler crash or spin takes down a helper rather than the
+// application and the user's edits, and so that renders share no poppler
+// state at all. The pixels come back in a memfd, which the thumbnail maps
+// without a copy. A helper that crashes, or takes longer than the timeout,
+// is killed and started again for the next render, and the page it was on
+// isn't sent to a helper again. Safe to use from any thread: every render
+// takes a helper for itself, or waits for one to be free.
+//
+// Or, pointed at a RenderDaemon's socket, renders pages through the daemon
+// every instance on the host shares, over as many connections.
+class RenderProcessPool {
+public:
+    enum class Target {
+        Helpers,
+        Daemon
+    };
+
+    RenderProcessPool(std::string helperPath,
+                      unsigned int numberOfProcesses,
+                      std::chrono::milliseconds timeout = defaultTimeout);
+    // path is the helper's for Helpers, the daemon socket's for Daemon
+    RenderProcessPool(Target target,
+                      std::string path,
+                      unsigned int numberOfConnections,
+                      std::chrono::milliseconds timeout = defaultTimeout);
+
+    RenderProcessPool(const RenderProcessPool&) = delete;
+    RenderProcessPool& operator=(const RenderProcessPool&) = delete;
+    RenderProcessPool(RenderProcessPool&&) = delete;
+    RenderProcessPool& operator=(RenderProcessPool&& src) = delete;
+
+    // Waits for the renders that are out, and for the helpers to exit
+    ~RenderProcessPool();
+
+    class RenderFailed : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    // The daemon couldn't be reached, or went away: the page could still be
+    // rendered some other way
+    class Unreachable : public RenderFailed {
+    public:
+        using RenderFailed::RenderFailed;
+    };
+
+    // Like PageRenderer::render(), with the render settings this process has
+    // for quality. Throws RenderFailed if the helper couldn't render the page.
+    [[nodiscard]] Glib::RefPtr<Gdk::Pixbuf> render(const Page& page, int targetSize, PageRenderer::Quality quality);
+    // With settings rather than those of this process
+    [[nodiscard]] Glib::RefPtr<Gdk::Pixbuf> render(const Page& page,
+                                                   int targetSize,
+                                                   PageRenderer::Quality quality,
+                                                   const RenderSettings& settings);
+
+    // The helper installed next to the running executable, or else the one in PATH.
+    // Empty if there's none.
+    static std::string findHelper();
+
+    // The helper's side: renders what comes through socket until it's closed.
+    // Returns the exit status for the helper.
+    static int serve(int socket);
+
+    static constexpr std::chrono::milliseconds defaultTimeout{10000};
+    static constexpr const char* helperName = "pdfslicer-render-helper";
+
+private:
+    // A connection, to the daemon
+    struct Process {
+        pid_t pid = -1;
+        // -1 until it's started, and once it's lost
+        int socket = -1;
+        // Helpers keep a poppler handle open for every file they render
+        std::string lastFilePath;
+    };
+
+    const Target m_target;
+    const std::string m_path;
+    const std::chrono::milliseconds m_timeout;
+    const std::size_t m_numberOfProcesses;
+
+    std::mutex m_mutex;
+    std::condition_variable m_processReturned;
+    // Not started for the first time until they're needed
+    std::vector<Process> m_idleProcesses;
+    // By file path and index in file
+    std::set<std::pair<std::string, unsigned int>> m_failedPages;
+
+    // One that last rendered filePath, if it's free
+    Process take(const std::string& filePath);
+    void giveBack(Process process);
+    void start(Process& process) const;
+    void connect(Process& process) const;
+    static void stop(Process& process);
+    // Stops it, and throws error as RenderFailed, or Unreachable for the daemon
+    [[noreturn]] void lose(Process& process, const std::string& error) const;
+    Glib::RefPtr<Gdk::Pixbuf> exchange(Process& process,
+                                       const Page& page,
+                                       int targetSize,
+                                       PageRenderer::Quality quality,
+                                       const RenderSettings& settings) const;
+};
+
+} // namespace Slicer
+
+#endif // RENDERPROCESSPOOL_HPP
@@ -0,0 +1,302 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "renderprotocol.hpp"
+#include <glibmm/miscutils.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace Slicer::RenderProtocol {
+
+namespace {
+    bool sendPacket(int socket, const std::string& packet, int fileDescriptor = -1)
+    {
+        iovec data{const_cast<char*>(packet.data()), packet.size()}; //NOLINT
+        msghdr message{};
+        message.msg_iov = &data;
+        message.msg_iovlen = 1;
+
+        alignas(cmsghdr) std::array<char, CMSG_SPACE(sizeof(int))> control{};
+        if (fileDescriptor >= 0) {
+            message.msg_control = control.data();
+            message.msg_controllen = control.size();
+
+            cmsghdr* header = CMSG_FIRSTHDR(&message);
+            header->cmsg_level = SOL_SOCKET;
+            header->cmsg_type = SCM_RIGHTS;
+            header->cmsg_len = CMSG_LEN(sizeof(int));
+            std::memcpy(CMSG_DATA(header), &fileDescriptor, sizeof(int));
+        }
+
+        ssize_t sent = 0;
+        do
+            sent = ::sendmsg(socket, &message, MSG_NOSIGNAL);
+        while (sent < 0 && errno == EINTR);
+
+        return sent == static_cast<ssize_t>(packet.size());
+    }
+
+    // The size of the packet, 0 once the other side is gone, or -1 on errors.
+    // The descriptor that came with it, if any, goes to fileDescriptor.
+    ssize_t receivePacket(int socket, std::vector<char>& buffer, int& fileDescriptor)
+    {
+        iovec data{buffer.data(), buffer.size()};
+        msghdr message{};
+        message.msg_iov = &data;
+        message.msg_iovlen = 1;
+
+        alignas(cmsghdr) std::array<char, CMSG_SPACE(sizeof(int))> control{};
+        message.msg_control = control.data();
+        message.msg_controllen = control.size();
+
+        ssize_t received = 0;
+        do
+            received = ::recvmsg(socket, &message, MSG_CMSG_CLOEXEC);
+        while (received < 0 && errno == EINTR);
+
+        fileDescriptor = -1;
+        for (cmsghdr* header = CMSG_FIRSTHDR(&message); header != nullptr; header = CMSG_NXTHDR(&message, header)) {
+            if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS)
+                std::memcpy(&fileDescriptor, CMSG_DATA(header), sizeof(int));
+        }
+
+        if (received > 0 && (message.msg_flags & MSG_TRUNC) != 0)
+            return -1;
+
+        return received;
+    }
+
+    template<typename Header>
+    std::string packetOf(const Header& header, const std::string& tail)
+    {
+        std::string packet(sizeof(Header), '\0');
+        std::memcpy(packet.data(), &header, sizeof(Header));
+
+        return packet + tail;
+    }
+
+    // Into a memfd, sized and laid out as the pixbuf is
+    int writeToMemfd(const Glib::RefPtr<Gdk::Pixbuf>& thumbnail)
+    {
+        const auto size = static_cast<std::size_t>(thumbnail->get_rowstride()) * static_cast<std::size_t>(thumbnail->get_height());
+        const int memfd = ::memfd_create("pdfslicer-thumbnail", MFD_CLOEXEC);
+        if (memfd < 0)
+            throw std::runtime_error("Couldn't create a memfd for the thumbnail");
+
+        void* mapping = MAP_FAILED;
+        if (::ftruncate(memfd, static_cast<off_t>(size)) == 0)
+            mapping = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+
+        if (mapping == MAP_FAILED) {
+            ::close(memfd);
+            throw std::runtime_error("Couldn't map the memfd for the thumbnail");
+        }
+
+        // The last row of a pixbuf may be shorter than the rowstride
+        std::memcpy(mapping, thumbnail->get_pixels(), thumbnail->get_byte_length());
+        ::munmap(mapping, size);
+
+        return memfd;
+    }
+
+    void closeIfOpen(int fileDescriptor)
+    {
+        if (fileDescriptor >= 0)
+            ::close(fileDescriptor);
+    }
+}
+
+RequestHeader requestFor(const Page& page, int targetSize, PageRenderer::Quality quality, const RenderSettings& settings)
+{
+    RequestHeader request{};
+    request.indexInFile = page.indexInFile();
+    request.width = page.size().width;
+    request.height = page.size().height;
+    request.sourceRotation = page.sourceRotation();
+    request.rotation = page.currentRotation();
+    request.targetSize = targetSize;
+    request.quality = static_cast<std::uint32_t>(quality);
+    request.antialiasing = settings.antialiasing ? 1 : 0;
+    request.textAntialiasing = settings.textAntialiasing ? 1 : 0;
+    request.textHinting = settings.textHinting ? 1 : 0;
+    request.lineMode = static_cast<std::uint32_t>(settings.lineMode);
+    request.paperColor = settings.paperColor;
+
+    return request;
+}
+
+PageRenderer::Quality qualityOf(const RequestHeader& request)
+{
+    return request.quality == static_cast<std::uint32_t>(PageRenderer::Quality::Draft) ? PageRenderer::Quality::Draft
+                                                                                      : PageRenderer::Quality::Full;
+}
+
+RenderSettings settingsOf(const RequestHeader& request)
+{
+    RenderSettings settings;
+    settings.antialiasing = request.antialiasing != 0;
+    settings.textAntialiasing = request.textAntialiasing != 0;
+    settings.textHinting = request.textHinting != 0;
+    settings.lineMode = static_cast<RenderSettings::LineMode>(std::min<std::uint32_t>(request.lineMode, 2));
+    settings.paperColor = request.paperColor;
+
+    return settings;
+}
+
+Glib::RefPtr<Page> pageOf(const RequestHeader& request, const std::shared_ptr<const SourceFile>& sourceFile)
+{
+    auto page = Glib::RefPtr<Page>{new Page{Page::Size{request.width, request.height},
+                                            request.sourceRotation,
+                                            Glib::path_get_basename(sourceFile->path()),
+                                            sourceFile,
+                                            "",
+                                            0,
+                                            request.indexInFile}};
+    page->rotateBy((request.rotation - request.sourceRotation) / 90);
+
+    return page;
+}
+
+bool sendRequest(int socket, const RequestHeader& header, const std::string& filePath, int file)
+{
+    if (filePath.size() > maxPathLength)
+        return false;
+
+    RequestHeader request = header;
+    request.pathLength = static_cast<std::uint32_t>(filePath.size());
+
+    return sendPacket(socket, packetOf(request, filePath), file);
+}
+
+bool receiveRequest(int socket, Request& request)
+{
+    std::vector<char> buffer(sizeof(RequestHeader) + maxPathLength);
+    int file = -1;
+    const ssize_t size = receivePacket(socket, buffer, file);
+
+    if (size < static_cast<ssize_t>(sizeof(RequestHeader))) {
+        closeIfOpen(file);
+        return false;
+    }
+
+    std::memcpy(&request.header, buffer.data(), sizeof(RequestHeader));
+    if (sizeof(RequestHeader) + request.header.pathLength != static_cast<std::size_t>(size)) {
+        closeIfOpen(file);
+        return false;
+    }
+
+    request.filePath.assign(buffer.data() + sizeof(RequestHeader), request.header.pathLength);
+    request.file = file;
+
+    return true;
+}
+
+bool sendThumbnail(int socket, const Glib::RefPtr<Gdk::Pixbuf>& thumbnail)
+{
+    int memfd = -1;
+    try {
+        memfd = writeToMemfd(thumbnail);
+    }
+    catch (const std::runtime_error& e) {
+        return sendError(socket, e.what());
+    }
+
+    ResponseHeader response{};
+    response.isRendered = 1;
+    response.width = thumbnail->get_width();
+    response.height = thumbnail->get_height();
+    response.rowstride = thumbnail->get_rowstride();
+    response.hasAlpha = thumbnail->get_has_alpha() ? 1 : 0;
+
+    const bool isSent = sendPacket(socket, packetOf(response, {}), memfd);
+    ::close(memfd);
+
+    return isSent;
+}
+
+bool sendError(int socket, const std::string& error)
+{
+    ResponseHeader response{};
+    const std::string message = error.substr(0, maxErrorLength);
+    response.errorLength = static_cast<std::uint32_t>(message.size());
+
+    return sendPacket(socket, packetOf(response, message));
+}
+
+bool receiveResponse(int socket, Response& response)
+{
+    std::vector<char> buffer(sizeof(ResponseHeader) + maxErrorLength);
+    int memfd = -1;
+    const ssize_t size = receivePacket(socket, buffer, memfd);
+
+    ResponseHeader header{};
+    if (size < static_cast<ssize_t>(sizeof(ResponseHeader))) {
+        closeIfOpen(memfd);
+        return false;
+    }
+
+    std::memcpy(&header, buffer.data(), sizeof(ResponseHeader));
+
+    if (header.isRendered == 0 || memfd < 0) {
+        closeIfOpen(memfd);
+
+        const std::size_t errorLength = std::min<std::size_t>(header.errorLength, static_cast<std::size_t>(size) - sizeof(ResponseHeader));
+        response.thumbnail.reset();
+        response.error.assign(buffer.data() + sizeof(ResponseHeader), errorLength);
+
+        return true;
+    }
+
+    // Private, so that whatever is done to the pixbuf stays in this process.
+    // A memfd shorter than the pixels would fault when they're read past its end.
+    const auto length = static_cast<std::size_t>(header.rowstride) * static_cast<std::size_t>(header.height);
+    struct stat status{};
+    const bool isWhole = header.width > 0 && header.height > 0 && header.rowstride >= header.width * 3
+                         && ::fstat(memfd, &status) == 0 && static_cast<std::size_t>(status.st_size) >= length;
+    void* mapping = isWhole ? ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, memfd, 0) : MAP_FAILED;
+    ::close(memfd);
+
+    if (mapping == MAP_FAILED) {
+        response.thumbnail.reset();
+        response.error = "Couldn't map the thumbnail";
+
+        return true;
+    }
+
+    response.thumbnail = Gdk::Pixbuf::create_from_data(static_cast<const guint8*>(mapping),
+                                                       Gdk::COLORSPACE_RGB,
+                                                       header.hasAlpha != 0,
+                                                       8,
+                                                       header.width,
+                                                       header.height,
+                                                       header.rowstride,
+                                                       [length](const guint8* data) {
+                                                           ::munmap(const_cast<guint8*>(data), length); //NOLINT
+                                                       });
+    response.error.clear();
+
+    return true;
+}
+
+} // namespace Slicer::RenderProtocol
@@ -0,0 +1,95 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef RENDERPROTOCOL_HPP
+#define RENDERPROTOCOL_HPP
+
+#include "page.hpp"
+#include "pagerenderer.hpp"
+#include "sourcefile.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace Slicer::RenderProtocol {
+
+// What render helpers and the render daemon are asked, over SOCK_SEQPACKET
+// sockets. Each message is one packet: a header, and then the path of the
+// file or the error. Along with a request may come the file itself, and
+// along with an answer comes the thumbnail, both as file descriptors.
+
+struct RequestHeader {
+    std::uint32_t indexInFile;
+    std::int32_t width;
+    std::int32_t height;
+    std::int32_t sourceRotation;
+    std::int32_t rotation;
+    std::int32_t targetSize;
+    std::uint32_t quality;
+    // The settings of that quality, which only the asking process knows
+    std::uint32_t antialiasing;
+    std::uint32_t textAntialiasing;
+    std::uint32_t textHinting;
+    std::uint32_t lineMode;
+    std::uint32_t paperColor;
+    std::uint32_t pathLength;
+};
+
+struct ResponseHeader {
+    std::uint32_t isRendered;
+    std::int32_t width;
+    std::int32_t height;
+    std::int32_t rowstride;
+    std::uint32_t hasAlpha;
+    std::uint32_t errorLength;
+};
+
+constexpr std::size_t maxPathLength = 4096;
+constexpr std::size_t maxErrorLength = 1024;
+
+struct Request {
+    RequestHeader header{};
+    std::string filePath;
+    // Open for reading, for whoever can't open the path. -1 if it didn't come.
+    int file = -1;
+};
+
+struct Response {
+    // Null if it couldn't be rendered
+    Glib::RefPtr<Gdk::Pixbuf> thumbnail;
+    std::string error;
+};
+
+// For rendering page like PageRenderer::render() would with settings for quality
+RequestHeader requestFor(const Page& page, int targetSize, PageRenderer::Quality quality, const RenderSettings& settings);
+PageRenderer::Quality qualityOf(const RequestHeader& request);
+RenderSettings settingsOf(const RequestHeader& request);
+// A page like the one asked for, read from sourceFile
+Glib::RefPtr<Page> pageOf(const RequestHeader& request, const std::shared_ptr<const SourceFile>& sourceFile);
+
+// These return false once the other side is gone, or sent something that isn't a message.
+// The receiver of a file closes it.
+bool sendRequest(int socket, const RequestHeader& header, const std::string& filePath, int file = -1);
+bool receiveRequest(int socket, Request& request);
+// Sends an error instead if it couldn't be put in a memfd
+bool sendThumbnail(int socket, const Glib::RefPtr<Gdk::Pixbuf>& thumbnail);
+bool sendError(int socket, const std::string& error);
+// The thumbnail maps the memfd it came in, privately, without a copy
+bool receiveResponse(int socket, Response& response);
+
+} // namespace Slicer::RenderProtocol
+
+#endif // RENDERPROTOCOL_HPP
@@ -0,0 +1,320 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "scannedpages.hpp"
+#include "mappedinputsource.hpp"
+#include "remotefile.hpp"
+#include <qpdf/DLL.h>
+#include <qpdf/QPDF.hh>
+#include <qpdf/QPDFPageDocumentHelper.hh>
+#include <qpdf/QPDFPageObjectHelper.hh>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace Slicer::ScannedPages {
+
+namespace {
+    // Scans only need a few operators; longer contents draw more than an image
+    constexpr long long maximumContentsLength = 1024;
+    // In points, for scanners that round the page size
+    constexpr double coverageTolerance = 1.0;
+
+    // a b c d e f, as cm takes them
+    using Matrix = std::array<double, 6>;
+
+    constexpr Matrix identity{1, 0, 0, 1, 0, 0};
+
+    Matrix multiply(const Matrix& m, const Matrix& ctm)
+    {
+        return {m[0] * ctm[0] + m[1] * ctm[2],
+                m[0] * ctm[1] + m[1] * ctm[3],
+                m[2] * ctm[0] + m[3] * ctm[2],
+                m[2] * ctm[1] + m[3] * ctm[3],
+                m[4] * ctm[0] + m[5] * ctm[2] + ctm[4],
+                m[4] * ctm[1] + m[5] * ctm[3] + ctm[5]};
+    }
+
+    // Follows the contents, as long as they only save and restore the
+    // graphics state, transform, and draw a single XObject
+    class SingleImageDrawing : public QPDFObjectHandle::ParserCallbacks {
+    public:
+        using QPDFObjectHandle::ParserCallbacks::handleObject;
+
+        void handleObject(QPDFObjectHandle object) override
+        {
+            if (!object.isOperator()) {
+                m_operands.push_back(object);
+                return;
+            }
+
+            const std::string op = object.getOperator();
+
+            if (op == "q") {
+                m_stateStack.push_back(m_ctm);
+            }
+            else if (op == "Q" && !m_stateStack.empty()) {
+                m_ctm = m_stateStack.back();
+                m_stateStack.pop_back();
+            }
+            else if (op == "cm" && m_operands.size() == 6
+                     && std::all_of(m_operands.begin(), m_operands.end(), [](QPDFObjectHandle& operand) {
+                            return operand.isNumber();
+                        })) {
+                Matrix m{};
+                for (std::size_t i = 0; i < m.size(); ++i)
+                    m.at(i) = m_operands.at(i).getNumericValue();
+
+                m_ctm = multiply(m, m_ctm);
+            }
+            else if (op == "Do" && m_operands.size() == 1 && m_operands.front().isName() && m_xObjectName.empty()) {
+                m_xObjectName = m_operands.front().getName();
+                m_xObjectMatrix = m_ctm;
+            }
+            else {
+                m_isSingleImage = false;
+            }
+
+            m_operands.clear();
+        }
+
+        void handleEOF() override
+        {
+        }
+
+        bool isSingleImage() const { return m_isSingleImage && !m_xObjectName.empty(); }
+        const std::string& xObjectName() const { return m_xObjectName; }
+        const Matrix& xObjectMatrix() const { return m_xObjectMatrix; }
+
+    private:
+        bool m_isSingleImage = true;
+        std::vector<QPDFObjectHandle> m_operands;
+        Matrix m_ctm = identity;
+        std::vector<Matrix> m_stateStack;
+        std::string m_xObjectName;
+        Matrix m_xObjectMatrix = identity;
+    };
+
+    struct Handle {
+        std::string filePath;
+        std::unique_ptr<QPDF> qpdf;
+        std::vector<QPDFPageObjectHelper> pages;
+        std::vector<bool> isKnownNotScanned;
+    };
+
+    thread_local Handle currentHandle;
+
+    void open(Handle& handle, const std::string& filePath)
+    {
+        // The pages go before the QPDF they belong to
+        handle.pages.clear();
+        handle = Handle{};
+
+        auto qpdf = std::make_unique<QPDF>();
+        qpdf->setSuppressWarnings(true);
+
+        std::unique_ptr<MappedInputSource> source;
+        if (MappedFile::isUsableFor(filePath)) {
+            try {
+                source = std::make_unique<MappedInputSource>(filePath);
+            }
+            catch (const std::runtime_error&) {
+                // Read through stdio then
+            }
+        }
+
+        if (source != nullptr) {
+#if defined(QPDF_MAJOR_VERSION) && QPDF_MAJOR_VERSION >= 11
+            qpdf->processInputSource(std::shared_ptr<InputSource>{std::move(source)});
+#else
+            qpdf->processInputSource(PointerHolder<InputSource>{source.release()});
+#endif
+        }
+        else {
+            qpdf->processFile(filePath.c_str());
+        }
+
+        handle.pages = QPDFPageDocumentHelper{*qpdf}.getAllPages();
+        handle.isKnownNotScanned.assign(handle.pages.size(), false);
+        handle.qpdf = std::move(qpdf);
+        handle.filePath = filePath;
+    }
+
+    long long contentsLength(QPDFObjectHandle contents)
+    {
+        auto lengthOf = [](QPDFObjectHandle stream) -> long long {
+            if (!stream.isStream())
+                return maximumContentsLength + 1;
+
+            QPDFObjectHandle length = stream.getDict().getKey("/Length");
+
+            return length.isInteger() ? length.getIntValue() : maximumContentsLength + 1;
+        };
+
+        if (!contents.isArray())
+            return lengthOf(contents);
+
+        long long total = 0;
+        for (int i = 0; i < contents.getArrayNItems(); ++i)
+            total += lengthOf(contents.getArrayItem(i));
+
+        return total;
+    }
+
+    bool isNameOrSingleNameArray(QPDFObjectHandle object, const std::string& name)
+    {
+        if (object.isArray() && object.getArrayNItems() == 1)
+            object = object.getArrayItem(0);
+
+        return object.isName() && object.getName() == name;
+    }
+
+    bool isDecodableJpeg(QPDFObjectHandle image)
+    {
+        if (!image.isStream())
+            return false;
+
+        QPDFObjectHandle dict = image.getDict();
+        QPDFObjectHandle subtype = dict.getKey("/Subtype");
+        QPDFObjectHandle bitsPerComponent = dict.getKey("/BitsPerComponent");
+        QPDFObjectHandle imageMask = dict.getKey("/ImageMask");
+
+        if (!subtype.isName() || subtype.getName() != "/Image"
+            || !isNameOrSingleNameArray(dict.getKey("/Filter"), "/DCTDecode")
+            || !bitsPerComponent.isInteger() || bitsPerComponent.getIntValue() != 8
+            || (imageMask.isBool() && imageMask.getBoolValue())
+            || !dict.getKey("/SMask").isNull()
+            || !dict.getKey("/Mask").isNull()
+            || !dict.getKey("/Decode").isNull()
+            || !dict.getKey("/DecodeParms").isNull())
+            return false;
+
+        QPDFObjectHandle colorSpace = dict.getKey("/ColorSpace");
+
+        if (colorSpace.isName())
+            return colorSpace.getName() == "/DeviceRGB" || colorSpace.getName() == "/DeviceGray";
+
+        // An ICC profile goes unapplied, as poppler mostly leaves it too
+        if (colorSpace.isArray() && colorSpace.getArrayNItems() == 2
+            && isNameOrSingleNameArray(colorSpace.getArrayItem(0), "/ICCBased")
+            && colorSpace.getArrayItem(1).isStream()) {
+            QPDFObjectHandle components = colorSpace.getArrayItem(1).getDict().getKey("/N");
+
+            return components.isInteger() && (components.getIntValue() == 1 || components.getIntValue() == 3);
+        }
+
+        return false;
+    }
+
+    bool coversCropBox(const Matrix& m, QPDFObjectHandle cropBox)
+    {
+        if (!cropBox.isRectangle())
+            return false;
+
+        // Skewed, turned or flipped images are left to poppler
+        if (std::abs(m[1]) > 1e-6 || std::abs(m[2]) > 1e-6 || m[0] <= 0 || m[3] <= 0)
+            return false;
+
+        const QPDFObjectHandle::Rectangle box = cropBox.getArrayAsRectangle();
+        const double left = std::min(box.llx, box.urx);
+        const double right = std::max(box.llx, box.urx);
+        const double bottom = std::min(box.lly, box.ury);
+        const double top = std::max(box.lly, box.ury);
+
+        return std::abs(m[4] - left) <= coverageTolerance
+               && std::abs(m[4] + m[0] - right) <= coverageTolerance
+               && std::abs(m[5] - bottom) <= coverageTolerance
+               && std::abs(m[5] + m[3] - top) <= coverageTolerance;
+    }
+
+    std::optional<std::string> findFullPageJpeg(QPDFPageObjectHelper& page)
+    {
+        QPDFObjectHandle pageObject = page.getObjectHandle();
+
+        if (contentsLength(pageObject.getKey("/Contents")) > maximumContentsLength)
+            return std::nullopt;
+
+        SingleImageDrawing drawing;
+#if defined(QPDF_MAJOR_VERSION) && (QPDF_MAJOR_VERSION > 10 || (QPDF_MAJOR_VERSION == 10 && QPDF_MINOR_VERSION >= 1))
+        page.parseContents(&drawing);
+#else
+        page.parsePageContents(&drawing);
+#endif
+
+        if (!drawing.isSingleImage())
+            return std::nullopt;
+
+        QPDFObjectHandle resources = page.getAttribute("/Resources", false);
+        if (!resources.isDictionary())
+            return std::nullopt;
+
+        QPDFObjectHandle xObjects = resources.getKey("/XObject");
+        if (!xObjects.isDictionary())
+            return std::nullopt;
+
+        QPDFObjectHandle image = xObjects.getKey(drawing.xObjectName());
+        if (!isDecodableJpeg(image) || !coversCropBox(drawing.xObjectMatrix(), page.getCropBox()))
+            return std::nullopt;
+
+        // Still DCT encoded, as the file has it
+        auto data = image.getRawStreamData();
+
+        return std::string{reinterpret_cast<const char*>(data->getBuffer()), data->getSize()}; //NOLINT
+    }
+}
+
+std::optional<std::string> fullPageJpeg(const std::string& filePath, unsigned int pageNumber)
+{
+    Handle& handle = currentHandle;
+
+    // QPDF can't open the file until it's all there, and a file it can't
+    // open would be remembered as such; poppler renders the page meanwhile
+    if (!RemoteFile::isComplete(filePath))
+        return std::nullopt;
+
+    try {
+        if (handle.filePath != filePath)
+            open(handle, filePath);
+
+        if (pageNumber >= handle.pages.size() || handle.isKnownNotScanned.at(pageNumber))
+            return std::nullopt;
+
+        std::optional<std::string> jpeg = findFullPageJpeg(handle.pages.at(pageNumber));
+
+        if (!jpeg.has_value())
+            handle.isKnownNotScanned.at(pageNumber) = true;
+
+        return jpeg;
+    }
+    catch (const std::exception&) {
+        // A file QPDF can't open is asked about again with every page;
+        // remembering it keeps it from being parsed each time
+        if (handle.filePath != filePath) {
+            handle = Handle{};
+            handle.filePath = filePath;
+        }
+        else if (pageNumber < handle.isKnownNotScanned.size()) {
+            handle.isKnownNotScanned.at(pageNumber) = true;
+        }
+
+        return std::nullopt;
+    }
+}
+
+} // namespace Slicer::ScannedPages
@@ -0,0 +1,42 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef SCANNEDPAGES_HPP
+#define SCANNEDPAGES_HPP
+
+#include <optional>
+#include <string>
+
+namespace Slicer {
+
+// Scanners make pages that do nothing but draw one JPEG over the whole
+// page. Decoding that image straight at thumbnail size, which libjpeg can
+// do at a fraction of its resolution, is much cheaper than having poppler
+// decode it whole and rasterize the page.
+namespace ScannedPages {
+
+    // The JPEG the page is made of, if it's such a page: its contents only
+    // draw one 8 bit gray or RGB DCT image, unmasked and upright, covering
+    // the crop box. Pages are checked with a QPDF handle that each thread
+    // keeps for the last file it asked about, and pages that aren't scans
+    // are remembered as such. Any error reads as not a scan.
+    std::optional<std::string> fullPageJpeg(const std::string& filePath, unsigned int pageNumber);
+
+} // namespace ScannedPages
+
+} // namespace Slicer
+
+#endif // SCANNEDPAGES_HPP
@@ -0,0 +1,306 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "selectionmodel.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace Slicer {
+
+SelectionModel::SelectionModel(unsigned int size)
+{
+    reset(size);
+}
+
+void SelectionModel::reset(unsigned int size)
+{
+    m_size = size;
+    m_words.assign((size + bitsPerWord - 1) / bitsPerWord, 0);
+    m_count = 0;
+    m_boundsValid = true;
+}
+
+bool SelectionModel::isSelected(unsigned int index) const
+{
+    if (index >= m_size)
+        throw std::out_of_range("Selection index out of range");
+
+    return (m_words[index / bitsPerWord] >> (index % bitsPerWord) & 1U) != 0;
+}
+
+std::optional<unsigned int> SelectionModel::first() const
+{
+    if (m_count == 0)
+        return {};
+
+    updateBounds();
+
+    return m_first;
+}
+
+std::optional<unsigned int> SelectionModel::last() const
+{
+    if (m_count == 0)
+        return {};
+
+    updateBounds();
+
+    return m_last;
+}
+
+bool SelectionModel::isContiguous() const
+{
+    if (m_count == 0)
+        return true;
+
+    updateBounds();
+
+    return m_last - m_first + 1 == m_count;
+}
+
+void SelectionModel::set(unsigned int index, bool selected)
+{
+    if (isSelected(index) == selected)
+        return;
+
+    const Word mask = Word{1} << (index % bitsPerWord);
+
+    if (selected) {
+        m_words[index / bitsPerWord] |= mask;
+
+        if (m_count == 0) {
+            m_first = index;
+            m_last = index;
+            m_boundsValid = true;
+        }
+        else if (m_boundsValid) {
+            m_first = std::min(m_first, index);
+            m_last = std::max(m_last, index);
+        }
+
+        ++m_count;
+    }
+    else {
+        m_words[index / bitsPerWord] &= ~mask;
+        --m_count;
+
+        if (index == m_first || index == m_last)
+            m_boundsValid = false;
+    }
+}
+
+void SelectionModel::selectOnly(unsigned int first, unsigned int last)
+{
+    if (first > last || last >= m_size)
+        throw std::out_of_range("Selection range out of range");
+
+    std::fill(m_words.begin(), m_words.end(), 0);
+
+    const unsigned int firstWord = first / bitsPerWord;
+    const unsigned int lastWord = last / bitsPerWord;
+
+    for (unsigned int word = firstWord; word <= lastWord; ++word)
+        m_words[word] = ~Word{0};
+
+    m_words[firstWord] &= ~Word{0} << (first % bitsPerWord);
+    m_words[lastWord] &= ~Word{0} >> (bitsPerWord - 1 - last % bitsPerWord);
+
+    m_count = last - first + 1;
+    m_first = first;
+    m_last = last;
+    m_boundsValid = true;
+}
+
+void SelectionModel::selectAll()
+{
+    std::fill(m_words.begin(), m_words.end(), ~Word{0});
+    trimLastWord();
+
+    m_count = m_size;
+    m_first = 0;
+    m_last = m_size == 0 ? 0 : m_size - 1;
+    m_boundsValid = true;
+}
+
+void SelectionModel::selectEveryOther(unsigned int offset)
+{
+    const Word pattern = offset % 2 == 0 ? 0x5555555555555555 : 0xAAAAAAAAAAAAAAAA; //NOLINT
+
+    std::fill(m_words.begin(), m_words.end(), pattern);
+    trimLastWord();
+    recount();
+}
+
+void SelectionModel::selectOnly(const std::vector<unsigned int>& indexes)
+{
+    std::fill(m_words.begin(), m_words.end(), 0);
+
+    for (unsigned int index : indexes)
+        m_words.at(index / bitsPerWord) |= Word{1} << (index % bitsPerWord);
+
+    trimLastWord();
+    recount();
+}
+
+void SelectionModel::selectOnly(const std::vector<Range>& ranges)
+{
+    std::fill(m_words.begin(), m_words.end(), 0);
+
+    for (const Range& range : ranges) {
+        if (range.first > range.last || range.last >= m_size || range.step == 0)
+            throw std::out_of_range("Selection range out of range");
+
+        if (range.step > 1) {
+            for (unsigned int index = range.first; index <= range.last; index += range.step)
+                m_words[index / bitsPerWord] |= Word{1} << (index % bitsPerWord);
+
+            continue;
+        }
+
+        const unsigned int firstWord = range.first / bitsPerWord;
+        const unsigned int lastWord = range.last / bitsPerWord;
+        const Word firstMask = ~Word{0} << (range.first % bitsPerWord);
+        const Word lastMask = ~Word{0} >> (bitsPerWord - 1 - range.last % bitsPerWord);
+
+        if (firstWord == lastWord) {
+            m_words[firstWord] |= firstMask & lastMask;
+            continue;
+        }
+
+        m_words[firstWord] |= firstMask;
+        std::fill(m_words.begin() + firstWord + 1, m_words.begin() + lastWord, ~Word{0});
+        m_words[lastWord] |= lastMask;
+    }
+
+    recount();
+}
+
+void SelectionModel::invert()
+{
+    for (Word& word : m_words)
+        word = ~word;
+
+    trimLastWord();
+
+    m_count = m_size - m_count;
+    m_boundsValid = false;
+}
+
+void SelectionModel::clear()
+{
+    std::fill(m_words.begin(), m_words.end(), 0);
+
+    m_count = 0;
+    m_boundsValid = true;
+}
+
+void SelectionModel::replace(unsigned int position, unsigned int removed, const std::vector<bool>& added)
+{
+    if (position + removed > m_size)
+        throw std::out_of_range("Selection range out of range");
+
+    const auto newSize = static_cast<unsigned int>(m_size - removed + added.size());
+    std::vector<Word> words((newSize + bitsPerWord - 1) / bitsPerWord, 0);
+
+    // The words before the change point are kept as they are
+    const unsigned int untouchedWords = position / bitsPerWord;
+    std::copy(m_words.begin(), m_words.begin() + untouchedWords, words.begin());
+
+    auto setBit = [&words](unsigned int index) {
+        words[index / bitsPerWord] |= Word{1} << (index % bitsPerWord);
+    };
+
+    for (unsigned int i = untouchedWords * bitsPerWord; i < position; ++i)
+        if (isSelected(i))
+            setBit(i);
+
+    for (unsigned int i = 0; i < added.size(); ++i)
+        if (added[i])
+            setBit(position + i);
+
+    const auto shiftedPosition = static_cast<unsigned int>(position + added.size());
+    for (unsigned int i = position + removed; i < m_size; ++i)
+        if (isSelected(i))
+            setBit(shiftedPosition + i - position - removed);
+
+    m_words = std::move(words);
+    m_size = newSize;
+    recount();
+}
+
+std::vector<unsigned int> SelectionModel::selectedIndexes() const
+{
+    std::vector<unsigned int> result;
+    result.reserve(m_count);
+
+    for (unsigned int word = 0; word < m_words.size(); ++word)
+        for (Word bits = m_words[word]; bits != 0; bits &= bits - 1)
+            result.push_back(word * bitsPerWord + static_cast<unsigned int>(__builtin_ctzll(bits)));
+
+    return result;
+}
+
+std::vector<unsigned int> SelectionModel::unselectedIndexes() const
+{
+    std::vector<unsigned int> result;
+    result.reserve(m_size - m_count);
+
+    for (unsigned int word = 0; word < m_words.size(); ++word) {
+        Word bits = ~m_words[word];
+
+        if (word == m_words.size() - 1 && m_size % bitsPerWord != 0)
+            bits &= (Word{1} << (m_size % bitsPerWord)) - 1;
+
+        for (; bits != 0; bits &= bits - 1)
+            result.push_back(word * bitsPerWord + static_cast<unsigned int>(__builtin_ctzll(bits)));
+    }
+
+    return result;
+}
+
+void SelectionModel::updateBounds() const
+{
+    if (m_boundsValid || m_count == 0)
+        return;
+
+    const auto firstWord = std::find_if(m_words.begin(), m_words.end(), [](Word word) { return word != 0; });
+    const auto lastWord = std::find_if(m_words.rbegin(), m_words.rend(), [](Word word) { return word != 0; });
+
+    const auto firstIndex = static_cast<unsigned int>(firstWord - m_words.begin());
+    const auto lastIndex = static_cast<unsigned int>(m_words.rend() - lastWord - 1);
+
+    m_first = firstIndex * bitsPerWord + static_cast<unsigned int>(__builtin_ctzll(*firstWord));
+    m_last = lastIndex * bitsPerWord + bitsPerWord - 1 - static_cast<unsigned int>(__builtin_clzll(*lastWord));
+    m_boundsValid = true;
+}
+
+void SelectionModel::trimLastWord()
+{
+    if (m_size % bitsPerWord != 0)
+        m_words.back() &= (Word{1} << (m_size % bitsPerWord)) - 1;
+}
+
+void SelectionModel::recount()
+{
+    m_count = 0;
+
+    for (Word word : m_words)
+        m_count += static_cast<unsigned int>(__builtin_popcountll(word));
+
+    m_boundsValid = false;
+}
+
+} // namespace Slicer
@@ -0,0 +1,97 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef SELECTIONMODEL_HPP
+#define SELECTIONMODEL_HPP
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace Slicer {
+
+// Which pages of the view are selected, as a bitset.
+// The number of selected pages is kept up to date on every change and the
+// first and last selected pages are cached, so that the questions asked on
+// every click (how many, is the first page selected, ...) don't walk the
+// whole document.
+class SelectionModel {
+public:
+    // From first to last, both included, every step pages
+    struct Range {
+        unsigned int first;
+        unsigned int last;
+        unsigned int step = 1;
+    };
+
+    SelectionModel() = default;
+    explicit SelectionModel(unsigned int size);
+
+    // Resizes the selection to size pages, none of them selected
+    void reset(unsigned int size);
+
+    unsigned int size() const { return m_size; }
+    unsigned int count() const { return m_count; }
+    bool empty() const { return m_count == 0; }
+    bool isSelected(unsigned int index) const;
+
+    std::optional<unsigned int> first() const;
+    std::optional<unsigned int> last() const;
+    // Whether the selected pages, if any, form a single run
+    bool isContiguous() const;
+
+    void set(unsigned int index, bool selected);
+    // Selects the pages between first and last, both included, and unselects the rest
+    void selectOnly(unsigned int first, unsigned int last);
+    void selectAll();
+    // Selects every other page starting at offset, and unselects the rest
+    void selectEveryOther(unsigned int offset);
+    // Selects the pages at indexes, and unselects the rest
+    void selectOnly(const std::vector<unsigned int>& indexes);
+    // Selects the pages in ranges, and unselects the rest. Plain runs are
+    // filled a word at a time, and pages are counted once at the end.
+    void selectOnly(const std::vector<Range>& ranges);
+    void invert();
+    void clear();
+
+    // Mirrors a change of the list of pages: removed pages starting at
+    // position are replaced by the pages in added, selected or not
+    void replace(unsigned int position, unsigned int removed, const std::vector<bool>& added);
+
+    std::vector<unsigned int> selectedIndexes() const;
+    std::vector<unsigned int> unselectedIndexes() const;
+
+private:
+    using Word = std::uint64_t;
+    static constexpr unsigned int bitsPerWord = 64;
+
+    std::vector<Word> m_words;
+    unsigned int m_size = 0;
+    unsigned int m_count = 0;
+
+    mutable bool m_boundsValid = true;
+    mutable unsigned int m_first = 0;
+    mutable unsigned int m_last = 0;
+
+    void updateBounds() const;
+    // Zeroes the bits past the end, so that whole words can be counted
+    void trimLastWord();
+    void recount();
+};
+
+} // namespace Slicer
+
+#endif // SELECTIONMODEL_HPP
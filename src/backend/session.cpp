@@ -0,0 +1,289 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "session.hpp"
+#include "tempfile.hpp"
+#include <giomm/file.h>
+#include <glibmm/fileutils.h>
+#include <glibmm/miscutils.h>
+#include <glibmm/stringutils.h>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <set>
+
+namespace Slicer::Session {
+
+namespace {
+    std::mutex directoryMutex;
+    std::string directory;
+    // One store at a time, so that one never removes what another just copied
+    std::mutex storeMutex;
+
+    // Changes whenever the layout below does, so old sessions just miss
+    constexpr std::uint32_t magic = 0x53535350; // "PSSS"
+    constexpr std::uint32_t version = 1;
+
+    // Followed by numberOfDocuments documents
+    struct Header {
+        std::uint32_t magic;
+        std::uint32_t version;
+        std::uint32_t numberOfDocuments;
+        std::uint32_t padding;
+    };
+
+    // Followed by numberOfFiles files, and then numberOfPages PageStates
+    struct DocumentHeader {
+        std::uint32_t numberOfFiles;
+        std::uint32_t numberOfPages;
+    };
+
+    // Followed by the URI, and then the hash
+    struct FileHeader {
+        std::uint32_t uriLength;
+        std::uint32_t hashLength;
+    };
+
+    constexpr std::uint32_t maximumStringLength = 64 * 1024;
+    const std::string keptCopyExtension = ".pdf";
+
+    std::string statePath(const std::string& directoryPath)
+    {
+        return Glib::build_filename(directoryPath, "documents");
+    }
+
+    std::string keptCopyPath(const std::string& directoryPath, const std::string& contentHash)
+    {
+        return Glib::build_filename(directoryPath, contentHash + keptCopyExtension);
+    }
+
+    bool readString(std::ifstream& file, std::uint32_t length, std::string& result)
+    {
+        if (length > maximumStringLength)
+            return false;
+
+        result.resize(length);
+        return static_cast<bool>(file.read(result.data(), length));
+    }
+
+    bool keepCopy(const std::string& snapshotPath, const std::string& keptPath)
+    {
+        if (snapshotPath == keptPath || Glib::file_test(keptPath, Glib::FILE_TEST_EXISTS))
+            return true;
+
+        // A copy cut short by a crash must not pass for a whole one
+        const std::string partialPath = keptPath + ".part";
+
+        try {
+            std::remove(partialPath.c_str());
+            TempFile::snapshotTo(Gio::File::create_for_path(snapshotPath), Gio::File::create_for_path(partialPath));
+        }
+        catch (const Glib::Error&) {
+            std::remove(partialPath.c_str());
+            return false;
+        }
+
+        return std::rename(partialPath.c_str(), keptPath.c_str()) == 0;
+    }
+
+    void removeUnusedCopies(const std::string& directoryPath, const std::set<std::string>& usedPaths)
+    {
+        try {
+            Glib::Dir dir{directoryPath};
+
+            for (const std::string& name : dir) {
+                const std::string path = Glib::build_filename(directoryPath, name);
+
+                if (!Glib::str_has_suffix(name, keptCopyExtension) && !Glib::str_has_suffix(name, ".part"))
+                    continue;
+
+                if (usedPaths.count(path) == 0)
+                    std::remove(path.c_str());
+            }
+        }
+        catch (const Glib::FileError&) {
+            // Nothing kept yet
+        }
+    }
+}
+
+void setDirectory(const std::string& directoryPath)
+{
+    std::lock_guard<std::mutex> lock{directoryMutex};
+    directory = directoryPath;
+
+    if (directory.empty())
+        return;
+
+    try {
+        auto file = Gio::File::create_for_path(directory);
+
+        if (!file->query_exists())
+            file->make_directory_with_parents();
+    }
+    catch (const Glib::Error&) {
+        // Every store will fail, and there will be nothing to load
+    }
+}
+
+static std::string directoryPath()
+{
+    std::lock_guard<std::mutex> lock{directoryMutex};
+    return directory;
+}
+
+bool isEnabled()
+{
+    return !directoryPath().empty();
+}
+
+bool isKeptCopy(const std::string& path)
+{
+    const std::string currentDirectory = directoryPath();
+
+    return !currentDirectory.empty() && Glib::path_get_dirname(path) == currentDirectory;
+}
+
+std::vector<DocumentState> load()
+{
+    const std::string currentDirectory = directoryPath();
+
+    if (currentDirectory.empty())
+        return {};
+
+    std::ifstream file{statePath(currentDirectory), std::ios::binary};
+    Header header{};
+
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) //NOLINT
+        || header.magic != magic || header.version != version)
+        return {};
+
+    std::vector<DocumentState> documents;
+
+    for (std::uint32_t i = 0; i < header.numberOfDocuments; ++i) {
+        DocumentHeader documentHeader{};
+        if (!file.read(reinterpret_cast<char*>(&documentHeader), sizeof(documentHeader))) //NOLINT
+            return {};
+
+        DocumentState document;
+        bool hasAllFiles = true;
+
+        for (std::uint32_t j = 0; j < documentHeader.numberOfFiles; ++j) {
+            FileHeader fileHeader{};
+            FileState fileState;
+
+            if (!file.read(reinterpret_cast<char*>(&fileHeader), sizeof(fileHeader)) //NOLINT
+                || !readString(file, fileHeader.uriLength, fileState.originalUri)
+                || !readString(file, fileHeader.hashLength, fileState.contentHash))
+                return {};
+
+            fileState.snapshotPath = keptCopyPath(currentDirectory, fileState.contentHash);
+            hasAllFiles = hasAllFiles && Glib::file_test(fileState.snapshotPath, Glib::FILE_TEST_IS_REGULAR);
+
+            document.files.push_back(std::move(fileState));
+        }
+
+        document.pages.resize(documentHeader.numberOfPages);
+        const auto size = static_cast<std::streamsize>(document.pages.size() * sizeof(PageState));
+
+        if (!file.read(reinterpret_cast<char*>(document.pages.data()), size)) //NOLINT
+            return {};
+
+        bool hasValidPages = true;
+        for (const PageState& page : document.pages)
+            hasValidPages = hasValidPages && page.file < document.files.size();
+
+        if (hasAllFiles && hasValidPages && !document.pages.empty())
+            documents.push_back(std::move(document));
+    }
+
+    return documents;
+}
+
+void store(const std::vector<DocumentState>& documents)
+{
+    const std::string currentDirectory = directoryPath();
+
+    if (currentDirectory.empty())
+        return;
+
+    std::lock_guard<std::mutex> lock{storeMutex};
+
+    // A document whose copies can't be kept isn't stored, rather than coming back without its pages
+    std::vector<const DocumentState*> storedDocuments;
+    std::set<std::string> usedPaths;
+
+    for (const DocumentState& document : documents) {
+        bool hasAllFiles = true;
+        std::vector<std::string> keptPaths;
+
+        for (const FileState& fileState : document.files) {
+            const std::string keptPath = keptCopyPath(currentDirectory, fileState.contentHash);
+            hasAllFiles = hasAllFiles && !fileState.contentHash.empty() && keepCopy(fileState.snapshotPath, keptPath);
+            keptPaths.push_back(keptPath);
+        }
+
+        // Even when not stored, the document may be reading from them
+        usedPaths.insert(keptPaths.begin(), keptPaths.end());
+
+        if (hasAllFiles)
+            storedDocuments.push_back(&document);
+    }
+
+    const std::string path = statePath(currentDirectory);
+    const std::string partialPath = path + ".part";
+
+    {
+        std::ofstream file{partialPath, std::ios::binary | std::ios::trunc};
+        const Header header{magic, version, static_cast<std::uint32_t>(storedDocuments.size()), 0};
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header)); //NOLINT
+
+        for (const DocumentState* document : storedDocuments) {
+            const DocumentHeader documentHeader{static_cast<std::uint32_t>(document->files.size()),
+                                                static_cast<std::uint32_t>(document->pages.size())};
+            file.write(reinterpret_cast<const char*>(&documentHeader), sizeof(documentHeader)); //NOLINT
+
+            for (const FileState& fileState : document->files) {
+                const FileHeader fileHeader{static_cast<std::uint32_t>(fileState.originalUri.size()),
+                                            static_cast<std::uint32_t>(fileState.contentHash.size())};
+                file.write(reinterpret_cast<const char*>(&fileHeader), sizeof(fileHeader)); //NOLINT
+                file.write(fileState.originalUri.data(), static_cast<std::streamsize>(fileState.originalUri.size()));
+                file.write(fileState.contentHash.data(), static_cast<std::streamsize>(fileState.contentHash.size()));
+            }
+
+            file.write(reinterpret_cast<const char*>(document->pages.data()), //NOLINT
+                       static_cast<std::streamsize>(document->pages.size() * sizeof(PageState)));
+        }
+
+        if (!file) {
+            file.close();
+            std::remove(partialPath.c_str());
+            return;
+        }
+    }
+
+    // Readers see either the old session or the whole new one
+    if (std::rename(partialPath.c_str(), path.c_str()) != 0) {
+        std::remove(partialPath.c_str());
+        return;
+    }
+
+    // Only once nothing stored refers to them
+    removeUnusedCopies(currentDirectory, usedPaths);
+}
+
+} // namespace Slicer::Session
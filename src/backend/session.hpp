@@ -0,0 +1,79 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef SESSION_HPP
+#define SESSION_HPP
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace Slicer {
+
+// The documents open when the application last closed, so that they come
+// back as they were, without opening their files again. Pages are stored
+// with what Page needs to know about them, and read from copies of their
+// snapshots kept next to the session, so restoring neither parses nor
+// copies anything. Thumbnails and text come from their caches, which are
+// keyed by the same content hashes. Stored in config::getConfigDirPath().
+namespace Session {
+
+    struct FileState {
+        std::string originalUri;
+        std::string contentHash;
+        // The snapshot to keep a copy of when storing; the kept copy when loaded
+        std::string snapshotPath;
+    };
+
+    struct PageState {
+        // Into DocumentState::files
+        std::uint32_t file;
+        std::uint32_t indexInFile;
+        std::int32_t width;
+        std::int32_t height;
+        // In degrees, as the file has it
+        std::int32_t sourceRotation;
+        std::int32_t rotation;
+    };
+
+    struct DocumentState {
+        // Every file some page comes from, in the document or in the undo
+        // history, so that their kept copies stay while the pages might need them
+        std::vector<FileState> files;
+        std::vector<PageState> pages;
+    };
+
+    // Empty, the default, turns sessions off
+    void setDirectory(const std::string& directoryPath);
+    bool isEnabled();
+
+    // Only documents whose kept copies are all there
+    std::vector<DocumentState> load();
+    // Keeps a copy of the snapshots that aren't kept yet, and removes the
+    // copies no document needs anymore. On the first store of a big file
+    // that takes a while, unless the filesystem can reflink it.
+    void store(const std::vector<DocumentState>& documents);
+
+    // Kept copies aren't removed with the pages reading from them, see SourceFile
+    bool isKeptCopy(const std::string& path);
+
+} // namespace Session
+
+} // namespace Slicer
+
+#endif // SESSION_HPP
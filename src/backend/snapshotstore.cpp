@@ -0,0 +1,308 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "snapshotstore.hpp"
+#include "document.hpp"
+#include "tempfile.hpp"
+#include "trace.hpp"
+#include <glibmm/fileutils.h>
+#include <glibmm/miscutils.h>
+#include <glibmm/stringutils.h>
+#include <glib/gstdio.h>
+#include <algorithm>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Slicer::SnapshotStore {
+
+namespace {
+    const std::string entryExtension = ".pdf";
+
+    std::mutex storeMutex;
+    std::string storeDirectoryPath;
+    std::uint64_t storeSizeLimit = defaultSizeLimit;
+    // The entries open in this process, by name, shared by every document
+    std::unordered_map<std::string, std::weak_ptr<SourceFile>> liveEntries;
+
+    std::string directoryPath()
+    {
+        std::lock_guard<std::mutex> lock{storeMutex};
+
+        return storeDirectoryPath;
+    }
+
+    // A shared lock for as long as the entry is used, which removal tries to
+    // take exclusively. -1 where there are no locks. Empty if the entry isn't
+    // there, or another instance removed it while this one waited for the lock.
+    std::optional<int> lockEntry(const std::string& path)
+    {
+#ifdef __linux__
+        const int descriptor = open(path.c_str(), O_RDONLY | O_CLOEXEC); //NOLINT
+        if (descriptor < 0)
+            return std::nullopt;
+
+        flock(descriptor, LOCK_SH);
+
+        // Removal unlinks the entry while it holds the lock, so what's locked
+        // stays only if it's still the file at path
+        struct stat locked {};
+        struct stat current {};
+        if (fstat(descriptor, &locked) != 0 || stat(path.c_str(), &current) != 0
+            || locked.st_dev != current.st_dev || locked.st_ino != current.st_ino) {
+            close(descriptor);
+            return std::nullopt;
+        }
+
+        return descriptor;
+#else
+        if (!Glib::file_test(path, Glib::FILE_TEST_IS_REGULAR))
+            return std::nullopt;
+
+        return -1;
+#endif
+    }
+
+    void unlockEntry(int descriptor)
+    {
+#ifdef __linux__
+        if (descriptor >= 0)
+            close(descriptor);
+#else
+        (void)descriptor;
+#endif
+    }
+
+    // Whether no one, in this instance or another, uses the entry anymore
+    bool removeIfUnused(const std::string& path)
+    {
+#ifdef __linux__
+        const int descriptor = open(path.c_str(), O_RDONLY | O_CLOEXEC); //NOLINT
+        if (descriptor < 0)
+            return false;
+
+        const bool isUnused = flock(descriptor, LOCK_EX | LOCK_NB) == 0;
+        if (isUnused)
+            g_remove(path.c_str());
+
+        close(descriptor);
+
+        return isUnused;
+#else
+        // Without locks, only what this instance uses is known to be in use
+        return g_remove(path.c_str()) == 0;
+#endif
+    }
+
+    // Part of the name of an entry, along with the sampled content hash. The
+    // inode and both times, to the nanosecond, change with any rewrite of the
+    // file, even within the same second, or by a tool that keeps the size,
+    // the ends and the modification time, as the change time can't be set.
+    // Empty when the file can't be looked at.
+    std::string identityOf(const std::string& path)
+    {
+        GStatBuf status{};
+        if (g_stat(path.c_str(), &status) != 0)
+            return {};
+
+#ifdef __linux__
+        return std::to_string(status.st_dev) + "-" + std::to_string(status.st_ino) + "-"
+               + std::to_string(status.st_size) + "-" + std::to_string(status.st_mtim.tv_sec) + "."
+               + std::to_string(status.st_mtim.tv_nsec) + "-" + std::to_string(status.st_ctim.tv_sec) + "."
+               + std::to_string(status.st_ctim.tv_nsec);
+#else
+        return std::to_string(status.st_size) + "-" + std::to_string(status.st_mtime) + "-"
+               + std::to_string(status.st_ctime);
+#endif
+    }
+
+    struct StoredFile {
+        std::string name;
+        std::uint64_t size;
+        gint64 lastUse;
+    };
+
+    void removeLeastRecentlyUsed(const std::string& directory)
+    {
+        const Trace::Span span{"SnapshotStore::removeLeastRecentlyUsed"};
+
+        std::vector<StoredFile> files;
+        std::uint64_t totalSize = 0;
+
+        try {
+            Glib::Dir dir{directory};
+
+            for (const std::string& name : dir) {
+                GStatBuf status{};
+                if (!Glib::str_has_suffix(name, entryExtension) || name.front() == '.'
+                    || g_stat(Glib::build_filename(directory, name).c_str(), &status) != 0)
+                    continue;
+
+                files.push_back({name, static_cast<std::uint64_t>(status.st_size), static_cast<gint64>(status.st_mtime)});
+                totalSize += files.back().size;
+            }
+        }
+        catch (const Glib::FileError&) {
+            return;
+        }
+
+        std::sort(files.begin(), files.end(), [](const StoredFile& a, const StoredFile& b) {
+            return a.lastUse < b.lastUse;
+        });
+
+        std::lock_guard<std::mutex> lock{storeMutex};
+
+        for (const StoredFile& file : files) {
+            if (totalSize <= storeSizeLimit)
+                break;
+
+            if (liveEntries.count(file.name) > 0)
+                continue;
+
+            if (removeIfUnused(Glib::build_filename(directory, file.name)))
+                totalSize -= file.size;
+        }
+    }
+
+    // Copied next to where it goes, so that it appears there whole
+    bool store(const Glib::RefPtr<Gio::File>& sourceFile, const std::string& path, const Preparer& prepare)
+    {
+        const Glib::RefPtr<Gio::File> entry = Gio::File::create_for_path(path);
+        const Glib::RefPtr<Gio::File> partial = TempFile::generateNextTo(entry);
+
+        try {
+            TempFile::snapshotTo(sourceFile, partial);
+
+            const Glib::RefPtr<Gio::File> prepared = prepare(partial);
+            prepared->move(entry, Gio::FILE_COPY_OVERWRITE);
+        }
+        catch (const Glib::Error&) {
+            g_remove(partial->get_path().c_str());
+            return false;
+        }
+
+        return true;
+    }
+
+    void release(const std::string& name, int descriptor)
+    {
+        unlockEntry(descriptor);
+
+        std::lock_guard<std::mutex> lock{storeMutex};
+
+        if (auto it = liveEntries.find(name); it != liveEntries.end() && it->second.expired())
+            liveEntries.erase(it);
+    }
+}
+
+void setDirectory(const std::string& directoryPath)
+{
+    std::lock_guard<std::mutex> lock{storeMutex};
+    storeDirectoryPath = directoryPath;
+}
+
+bool isEnabled()
+{
+    return !directoryPath().empty();
+}
+
+void setSizeLimit(std::uint64_t bytes)
+{
+    std::lock_guard<std::mutex> lock{storeMutex};
+    storeSizeLimit = bytes;
+}
+
+std::shared_ptr<SourceFile> acquire(const Glib::RefPtr<Gio::File>& sourceFile, const Preparer& prepare)
+{
+    const std::string directory = directoryPath();
+    const std::string sourcePath = sourceFile->get_path();
+
+    if (directory.empty() || sourcePath.empty())
+        return nullptr;
+
+    const Trace::Span span{"SnapshotStore::acquire"};
+
+    const std::string identity = identityOf(sourcePath);
+    if (identity.empty())
+        return nullptr;
+
+    const std::string contentHash = Document::contentHashOf(sourcePath);
+    const std::string name = contentHash + "-" + identity + entryExtension;
+    const PageIndex::Key key = Document::pageIndexKeyOf(sourceFile, contentHash);
+    const SourceFile::Origin origin{key.fileSize, key.modificationTime};
+    const std::string path = Glib::build_filename(directory, name);
+
+    {
+        std::lock_guard<std::mutex> lock{storeMutex};
+
+        if (auto it = liveEntries.find(name); it != liveEntries.end())
+            if (std::shared_ptr<SourceFile> live = it->second.lock())
+                return live;
+    }
+
+    // Locked before it's known to be there, so that another instance can't
+    // remove it in between. One that another instance makes room for others
+    // by removing right after it's stored is left to be snapshotted as usual.
+    std::optional<int> descriptor = lockEntry(path);
+    const bool isNew = !descriptor.has_value();
+    if (isNew) {
+        g_mkdir_with_parents(directory.c_str(), 0700);
+
+        if (!store(sourceFile, path, prepare))
+            return nullptr;
+
+        descriptor = lockEntry(path);
+        if (!descriptor.has_value())
+            return nullptr;
+    }
+
+    // Marks it as just used, for removeLeastRecentlyUsed()
+    g_utime(path.c_str(), nullptr);
+
+    std::shared_ptr<SourceFile> entry = SourceFile::stored(Gio::File::create_for_path(path), [name, descriptor = *descriptor]() {
+        release(name, descriptor);
+    });
+    entry->setOrigin(origin);
+
+    std::unique_lock<std::mutex> lock{storeMutex};
+    std::weak_ptr<SourceFile>& live = liveEntries[name];
+
+    // Another thread got there first: this one goes, once out of the lock
+    if (std::shared_ptr<SourceFile> first = live.lock()) {
+        lock.unlock();
+        entry.reset();
+
+        return first;
+    }
+
+    live = entry;
+    lock.unlock();
+
+    // Only once the new entry is locked, and live, so that it stays
+    if (isNew)
+        removeLeastRecentlyUsed(directory);
+
+    return entry;
+}
+}
@@ -0,0 +1,54 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef SNAPSHOTSTORE_HPP
+#define SNAPSHOTSTORE_HPP
+
+#include "sourcefile.hpp"
+#include <giomm/file.h>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace Slicer::SnapshotStore {
+
+// Snapshots of opened files, kept in a directory under the content hash,
+// inode and times of their source, so that opening a file that's already
+// open, in this window or another, shares its snapshot, and opening it again
+// later, unchanged, takes no copy. Entries in use are locked, by this and by
+// any other running instance; the least recently used of the rest are removed
+// once the store is over its size limit. Best effort: errors mean a copy of
+// the file's own, as without the store.
+
+// Empty, the default, turns the store off
+void setDirectory(const std::string& directoryPath);
+bool isEnabled();
+
+static constexpr std::uint64_t defaultSizeLimit = std::uint64_t{2} * 1024 * 1024 * 1024;
+void setSizeLimit(std::uint64_t bytes);
+
+// Turns a fresh copy of a file into what's stored, like a decrypted copy of
+// it, and returns that; it's then moved into the store
+using Preparer = std::function<Glib::RefPtr<Gio::File>(const Glib::RefPtr<Gio::File>& copy)>;
+
+// The stored snapshot of sourceFile, made with prepare first when the store
+// doesn't have it. The same one for as long as any page holds it. Null when
+// the store is off, the file has no local path or it couldn't be stored.
+std::shared_ptr<SourceFile> acquire(const Glib::RefPtr<Gio::File>& sourceFile, const Preparer& prepare);
+}
+
+#endif // SNAPSHOTSTORE_HPP
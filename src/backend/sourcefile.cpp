@@ -0,0 +1,80 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "sourcefile.hpp"
+#include "popplerhandles.hpp"
+#include "session.hpp"
+
+namespace Slicer {
+
+SourceFile::SourceFile(const Glib::RefPtr<Gio::File>& snapshot,
+                       std::shared_ptr<RemoteFile> remoteFile)
+    : m_snapshot{snapshot}
+    , m_path{snapshot->get_path()}
+    , m_remoteFile{std::move(remoteFile)}
+{
+}
+
+SourceFile::~SourceFile()
+{
+    if (m_isBorrowed)
+        return;
+
+    // Renders still waiting for it may keep it a little longer
+    if (m_remoteFile != nullptr)
+        m_remoteFile->cancel();
+
+    // The render threads keep a handle open for each file they have rendered
+    PopplerHandles::release(m_path);
+
+    if (const auto cache = m_parsedFileCache.lock())
+        cache->forget(m_path);
+
+    if (m_onReleased) {
+        m_onReleased();
+        return;
+    }
+
+    // The session removes its own copies, once no document needs them
+    if (Session::isKeptCopy(m_path))
+        return;
+
+    try {
+        m_snapshot->remove();
+    }
+    catch (const Glib::Error&) {
+        // Already gone, or the temp dir went away with it
+    }
+}
+
+std::shared_ptr<SourceFile> SourceFile::borrowed(const Glib::RefPtr<Gio::File>& snapshot)
+{
+    auto sourceFile = std::make_shared<SourceFile>(snapshot);
+    sourceFile->m_isBorrowed = true;
+
+    return sourceFile;
+}
+
+std::shared_ptr<SourceFile> SourceFile::stored(const Glib::RefPtr<Gio::File>& snapshot,
+                                               std::function<void()> onReleased)
+{
+    auto sourceFile = std::make_shared<SourceFile>(snapshot);
+    sourceFile->m_onReleased = std::move(onReleased);
+
+    return sourceFile;
+}
+
+} // namespace Slicer
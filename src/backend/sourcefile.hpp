@@ -0,0 +1,86 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef SOURCEFILE_HPP
+#define SOURCEFILE_HPP
+
+#include "pdfsaver.hpp"
+#include "remotefile.hpp"
+#include <giomm/file.h>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace Slicer {
+
+// The private snapshot of a file that pages are read and saved from.
+// Every page of the file shares ownership of it, whether the page is in
+// the document or held by a command in the undo history. Once the last one
+// is gone, the poppler handles and any parsed copy kept for saving are
+// released, and the snapshot is deleted, unless it is a copy kept by the Session
+// or by the SnapshotStore.
+class SourceFile {
+public:
+    // remoteFile, if any, is what fills the snapshot, and stops with it
+    explicit SourceFile(const Glib::RefPtr<Gio::File>& snapshot,
+                        std::shared_ptr<RemoteFile> remoteFile = {});
+
+    SourceFile(const SourceFile&) = delete;
+    SourceFile& operator=(const SourceFile&) = delete;
+    SourceFile(SourceFile&&) = delete;
+    SourceFile& operator=(SourceFile&& src) = delete;
+
+    ~SourceFile();
+
+    // A snapshot another process owns, as a render helper reads it: left
+    // where it is, and in every cache, when the last page goes away
+    static std::shared_ptr<SourceFile> borrowed(const Glib::RefPtr<Gio::File>& snapshot);
+    // A snapshot in the SnapshotStore: released like any other when the last
+    // page goes away, and then left where it is, for onReleased to follow up
+    static std::shared_ptr<SourceFile> stored(const Glib::RefPtr<Gio::File>& snapshot,
+                                              std::function<void()> onReleased);
+
+    const Glib::RefPtr<Gio::File>& snapshot() const { return m_snapshot; }
+    const std::string& path() const { return m_path; }
+    const std::shared_ptr<RemoteFile>& remoteFile() const { return m_remoteFile; }
+
+    // The size and modification time of the file the snapshot was taken of,
+    // which what's kept across sessions goes by along with the content hash,
+    // as PageIndex does. Zero when unknown. Set before any page is made of it.
+    struct Origin {
+        std::uint64_t size = 0;
+        std::uint64_t modificationTime = 0;
+    };
+
+    const Origin& origin() const { return m_origin; }
+    void setOrigin(const Origin& origin) { m_origin = origin; }
+
+    // The cache the file may end up parsed into, to be cleared along with it
+    void setParsedFileCache(const std::shared_ptr<PdfSaver::ParsedFileCache>& cache) { m_parsedFileCache = cache; }
+
+private:
+    const Glib::RefPtr<Gio::File> m_snapshot;
+    const std::string m_path;
+    const std::shared_ptr<RemoteFile> m_remoteFile;
+    std::weak_ptr<PdfSaver::ParsedFileCache> m_parsedFileCache;
+    bool m_isBorrowed = false;
+    Origin m_origin;
+    std::function<void()> m_onReleased;
+};
+
+} // namespace Slicer
+
+#endif // SOURCEFILE_HPP
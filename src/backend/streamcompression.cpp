@@ -0,0 +1,173 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "streamcompression.hpp"
+#include <qpdf/Buffer.hh>
+#include <qpdf/Pl_Buffer.hh>
+#include <qpdf/Pl_Flate.hh>
+#include <qpdf/QUtil.hh>
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <stdexcept>
+
+namespace Slicer::StreamCompression {
+
+namespace {
+    // The filters qpdf undoes at qpdf_dl_generalized, with their abbreviations
+    constexpr std::array<const char*, 10> generalizedFilters{"/FlateDecode", "/Fl",
+                                                             "/LZWDecode", "/LZW",
+                                                             "/ASCIIHexDecode", "/AHx",
+                                                             "/ASCII85Decode", "/A85",
+                                                             "/RunLengthDecode", "/RL"};
+
+    bool isGeneralized(QPDFObjectHandle filter)
+    {
+        if (!filter.isName())
+            return false;
+
+        const std::string name = filter.getName();
+
+        return std::any_of(generalizedFilters.begin(), generalizedFilters.end(), [&name](const char* generalized) {
+            return name == generalized;
+        });
+    }
+
+    std::vector<QPDFObjectHandle> filtersOf(QPDFObjectHandle dict)
+    {
+        QPDFObjectHandle filter = dict.getKey("/Filter");
+
+        if (filter.isArray())
+            return filter.getArrayAsVector();
+        if (filter.isNull())
+            return {};
+
+        return {filter};
+    }
+
+    bool hasParameters(QPDFObjectHandle dict)
+    {
+        QPDFObjectHandle parameters = dict.getKey("/DecodeParms");
+
+        if (parameters.isArray())
+            for (QPDFObjectHandle& item : parameters.getArrayAsVector())
+                if (!item.isNull())
+                    return true;
+
+        return !parameters.isNull() && !parameters.isArray();
+    }
+
+    std::optional<Candidate> candidateOf(QPDFObjectHandle stream, bool recompress)
+    {
+        QPDFObjectHandle dict = stream.getDict();
+
+        if (dict.getKey("/Type").isName() && dict.getKey("/Type").getName() == "/Metadata")
+            return std::nullopt;
+
+        const std::vector<QPDFObjectHandle> filters = filtersOf(dict);
+
+        if (filters.empty())
+            return Candidate{stream, Source::Raw};
+
+        if (!std::all_of(filters.begin(), filters.end(), isGeneralized))
+            return std::nullopt;
+
+        // The writer leaves Flate data alone unless told to recompress it
+        const bool isFlate = filters.size() == 1
+                             && (filters.front().getName() == "/FlateDecode" || filters.front().getName() == "/Fl");
+
+        if (isFlate && !recompress)
+            return std::nullopt;
+
+        return Candidate{stream, isFlate && !hasParameters(dict) ? Source::Flate : Source::Decoded};
+    }
+
+    std::string toString(Pl_Buffer& buffer)
+    {
+        const std::unique_ptr<Buffer> data{buffer.getBuffer()};
+
+        return std::string{reinterpret_cast<const char*>(data->getBuffer()), data->getSize()}; //NOLINT
+    }
+
+    std::string runFlate(const std::string& data, Pl_Flate::action_e action)
+    {
+        Pl_Buffer buffer{"stream compression"};
+        Pl_Flate flate{"stream compression", &buffer, action};
+        flate.write(QUtil::unsigned_char_pointer(data), data.size());
+        flate.finish();
+
+        return toString(buffer);
+    }
+} // namespace
+
+std::vector<Candidate> findCandidates(QPDF& pdf, bool recompress)
+{
+    std::vector<Candidate> candidates;
+
+    for (QPDFObjectHandle& object : pdf.getAllObjects()) {
+        if (!object.isStream())
+            continue;
+
+        if (std::optional<Candidate> candidate = candidateOf(object, recompress))
+            candidates.push_back(std::move(*candidate));
+    }
+
+    return candidates;
+}
+
+std::optional<std::string> readData(const Candidate& candidate)
+{
+    QPDFObjectHandle stream = candidate.stream;
+
+    try {
+        auto data = candidate.source == Source::Decoded ? stream.getStreamData(qpdf_dl_generalized)
+                                                        : stream.getRawStreamData();
+
+        return std::string{reinterpret_cast<const char*>(data->getBuffer()), data->getSize()}; //NOLINT
+    }
+    catch (const std::exception&) {
+        // Damaged data, which the writer copies out as it is
+        return std::nullopt;
+    }
+}
+
+std::optional<std::string> compress(const Candidate& candidate, const std::string& data)
+{
+    if (candidate.source != Source::Flate)
+        return runFlate(data, Pl_Flate::a_deflate);
+
+    std::string recompressed;
+
+    try {
+        recompressed = runFlate(runFlate(data, Pl_Flate::a_inflate), Pl_Flate::a_deflate);
+    }
+    catch (const std::runtime_error&) {
+        return std::nullopt;
+    }
+
+    if (recompressed.size() >= data.size())
+        return std::nullopt;
+
+    return recompressed;
+}
+
+void replace(const Candidate& candidate, const std::string& compressed)
+{
+    QPDFObjectHandle stream = candidate.stream;
+    stream.replaceStreamData(compressed, QPDFObjectHandle::newName("/FlateDecode"), QPDFObjectHandle::newNull());
+}
+
+} // namespace Slicer::StreamCompression
@@ -0,0 +1,68 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef STREAMCOMPRESSION_HPP
+#define STREAMCOMPRESSION_HPP
+
+#include <qpdf/QPDF.hh>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace Slicer::StreamCompression {
+
+// QPDFWriter deflates every stream it writes compressed on one thread. This
+// does that work ahead of it, on all cores: the streams are compressed into
+// finished Flate data, and the writer, set to leave filtered streams as they
+// are, only copies them out. The result is the one the writer would give.
+
+enum class Source {
+    // Unfiltered data, compressed as it is
+    Raw,
+    // Flate data without parameters, inflated and deflated again
+    Flate,
+    // Data under other filters qpdf can undo, like LZW, ASCII85 or Flate
+    // with a predictor, decoded by qpdf while it's read
+    Decoded
+};
+
+// A stream to compress, found in the QPDF the saver writes
+struct Candidate {
+    QPDFObjectHandle stream;
+    Source source = Source::Raw;
+};
+
+// The streams the writer would compress. With recompress, also those it
+// would only recompress, like the smallest write profile does. Metadata
+// stays uncompressed, for programs that look for it in the file.
+// Like everything that touches the QPDF, from one thread at a time.
+std::vector<Candidate> findCandidates(QPDF& pdf, bool recompress);
+
+// The data to compress. Nothing when qpdf can't decode it, and the stream
+// is best left to the writer.
+std::optional<std::string> readData(const Candidate& candidate);
+
+// Doesn't touch the QPDF, or the stream handle of the candidate, so it can
+// run on every core at once. Nothing when Flate data can't be inflated, or
+// recompressing it wouldn't make it smaller.
+std::optional<std::string> compress(const Candidate& candidate, const std::string& data);
+
+// Puts the Flate data in place of the stream data
+void replace(const Candidate& candidate, const std::string& compressed);
+
+} // namespace Slicer::StreamCompression
+
+#endif // STREAMCOMPRESSION_HPP
@@ -16,16 +16,271 @@
 
 #include "tempfile.hpp"
 #include <config.hpp>
+#include <glibmm/fileutils.h>
 #include <glibmm/miscutils.h>
+#include <glibmm/stringutils.h>
+#include <glib/gstdio.h>
 #include <uuid.h>
+#include <cstdio>
+#include <vector>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
 
 namespace Slicer::TempFile {
 
+static const std::string instanceDirPrefix = "instance-";
+static const std::string lockFileSuffix = ".lock";
+// For loose files, which belong to no instance
+static const gint64 staleAgeInSeconds = 24 * 60 * 60;
+
+#ifdef __linux__
+static constexpr bool hasInstanceLocks = true;
+#else
+// Without locks there's no telling abandoned instances from running ones
+static constexpr bool hasInstanceLocks = false;
+#endif
+
+namespace {
+    class InstanceDir {
+    public:
+        InstanceDir()
+        {
+            const std::string name = instanceDirPrefix + uuids::to_string(uuids::uuid_system_generator{}());
+            m_path = Glib::build_filename(config::getTempDirPath(), name);
+            m_lockPath = m_path + lockFileSuffix;
+
+            // Startup creates it off the main thread, maybe not in time
+            g_mkdir_with_parents(config::getTempDirPath().c_str(), 0700);
+
+#ifdef __linux__
+            // Locked under another name and then renamed, so that a sweep
+            // running meanwhile never sees the lock file unlocked
+            const std::string partialLockPath = m_lockPath + ".part";
+            m_lockDescriptor = open(partialLockPath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600); //NOLINT
+
+            if (m_lockDescriptor >= 0) {
+                flock(m_lockDescriptor, LOCK_EX | LOCK_NB);
+                std::rename(partialLockPath.c_str(), m_lockPath.c_str());
+            }
+#endif
+
+            // Created after the lock, so a directory without one is always stale
+            g_mkdir_with_parents(m_path.c_str(), 0700);
+        }
+
+        InstanceDir(const InstanceDir&) = delete;
+        InstanceDir& operator=(const InstanceDir&) = delete;
+        InstanceDir(InstanceDir&&) = delete;
+        InstanceDir& operator=(InstanceDir&& src) = delete;
+
+        ~InstanceDir()
+        {
+            // Only succeeds if every temp file was cleaned up; otherwise the next sweep does it
+            if (g_rmdir(m_path.c_str()) == 0)
+                g_remove(m_lockPath.c_str());
+
+#ifdef __linux__
+            if (m_lockDescriptor >= 0)
+                close(m_lockDescriptor);
+#endif
+        }
+
+        const std::string& path() const { return m_path; }
+
+    private:
+        std::string m_path;
+        std::string m_lockPath;
+        int m_lockDescriptor = -1;
+    };
+}
+
+std::string instanceDirPath()
+{
+    static const InstanceDir instanceDir;
+
+    return instanceDir.path();
+}
+
 Glib::RefPtr<Gio::File> generate()
 {
-    const std::string path = Glib::build_filename(Slicer::config::getTempDirPath(),
+    const std::string path = Glib::build_filename(instanceDirPath(),
                                                   uuids::to_string(uuids::uuid_system_generator{}()));
 
     return Gio::File::create_for_path(path);
 }
+
+Glib::RefPtr<Gio::File> generateNextTo(const Glib::RefPtr<Gio::File>& file)
+{
+    const std::string name = "." + file->get_basename() + "."
+                             + uuids::to_string(uuids::uuid_system_generator{}()) + ".part";
+
+    return file->get_parent()->get_child(name);
+}
+
+static bool tryReflink(const std::string& sourcePath, const std::string& destinationPath)
+{
+#if defined(__linux__) && defined(FICLONE)
+    const int source = open(sourcePath.c_str(), O_RDONLY | O_CLOEXEC); //NOLINT
+    if (source < 0)
+        return false;
+
+    const int destination = open(destinationPath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600); //NOLINT
+    if (destination < 0) {
+        close(source);
+        return false;
+    }
+
+    const bool isCloned = ioctl(destination, FICLONE, source) == 0; //NOLINT
+    close(destination);
+    close(source);
+
+    if (!isCloned)
+        unlink(destinationPath.c_str());
+
+    return isCloned;
+#else
+    (void)sourcePath;
+    (void)destinationPath;
+
+    return false;
+#endif
+}
+
+Glib::RefPtr<Gio::File> snapshot(const Glib::RefPtr<Gio::File>& sourceFile)
+{
+    Glib::RefPtr<Gio::File> tempFile = generate();
+    snapshotTo(sourceFile, tempFile);
+
+    return tempFile;
+}
+
+void snapshotTo(const Glib::RefPtr<Gio::File>& sourceFile, const Glib::RefPtr<Gio::File>& destination)
+{
+    const std::string sourcePath = sourceFile->get_path();
+
+    if (sourcePath.empty() || !tryReflink(sourcePath, destination->get_path()))
+        sourceFile->copy(destination, Gio::FILE_COPY_OVERWRITE);
+}
+
+// Large enough for the reads to stream, small enough to stay in the cache
+static const gsize copyChunkSize = 256 * 1024;
+
+bool snapshotTo(const Glib::RefPtr<Gio::File>& sourceFile,
+                const Glib::RefPtr<Gio::File>& destination,
+                const DataSlot& onData)
+{
+    const std::string sourcePath = sourceFile->get_path();
+
+    if (!sourcePath.empty() && tryReflink(sourcePath, destination->get_path()))
+        return false;
+
+    Glib::RefPtr<Gio::FileInputStream> input = sourceFile->read();
+    Glib::RefPtr<Gio::FileOutputStream> output = destination->replace(std::string{}, false, Gio::FILE_CREATE_PRIVATE);
+    std::vector<char> buffer(copyChunkSize);
+
+    for (gssize size = input->read(buffer.data(), buffer.size()); size > 0; size = input->read(buffer.data(), buffer.size())) {
+        gsize written = 0;
+        output->write_all(buffer.data(), static_cast<gsize>(size), written);
+        onData(buffer.data(), static_cast<std::size_t>(size));
+    }
+
+    output->close();
+
+    return true;
+}
+
+static void removeRecursively(const Glib::RefPtr<Gio::File>& file)
+{
+    try {
+        if (file->query_file_type(Gio::FILE_QUERY_INFO_NOFOLLOW_SYMLINKS) == Gio::FILE_TYPE_DIRECTORY) {
+            auto enumerator = file->enumerate_children(G_FILE_ATTRIBUTE_STANDARD_NAME,
+                                                       Gio::FILE_QUERY_INFO_NOFOLLOW_SYMLINKS);
+
+            while (Glib::RefPtr<Gio::FileInfo> info = enumerator->next_file())
+                removeRecursively(file->get_child(info->get_name()));
+        }
+
+        file->remove();
+    }
+    catch (const Glib::Error&) {
+        // Owned by someone else, or already gone
+    }
+}
+
+// Whether no running instance holds the lock at lockPath
+static bool isAbandoned(const std::string& lockPath)
+{
+#ifdef __linux__
+    const int descriptor = open(lockPath.c_str(), O_RDONLY | O_CLOEXEC); //NOLINT
+
+    if (descriptor < 0)
+        return false;
+
+    const bool isLocked = flock(descriptor, LOCK_EX | LOCK_NB) != 0;
+    close(descriptor);
+
+    return !isLocked;
+#else
+    (void)lockPath;
+
+    return false;
+#endif
+}
+
+void removeStaleFiles()
+{
+    const std::string tempDirPath = config::getTempDirPath();
+    const std::string ownDirName = Glib::path_get_basename(instanceDirPath());
+    const gint64 now = g_get_real_time() / G_USEC_PER_SEC;
+
+    try {
+        auto tempDir = Gio::File::create_for_path(tempDirPath);
+        auto enumerator = tempDir->enumerate_children(G_FILE_ATTRIBUTE_STANDARD_NAME ","
+                                                      G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+                                                      G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                                      Gio::FILE_QUERY_INFO_NOFOLLOW_SYMLINKS);
+
+        while (Glib::RefPtr<Gio::FileInfo> info = enumerator->next_file()) {
+            const std::string name = info->get_name();
+            const std::string path = Glib::build_filename(tempDirPath, name);
+
+            if (name == ownDirName || name == ownDirName + lockFileSuffix)
+                continue;
+
+            if (Glib::str_has_prefix(name, instanceDirPrefix) && Glib::str_has_suffix(name, lockFileSuffix)) {
+                // The directory goes first, see InstanceDir
+                if (isAbandoned(path)) {
+                    removeRecursively(Gio::File::create_for_path(path.substr(0, path.size() - lockFileSuffix.size())));
+                    g_remove(path.c_str());
+                }
+
+                continue;
+            }
+
+            if (info->get_file_type() == Gio::FILE_TYPE_DIRECTORY) {
+                if (hasInstanceLocks
+                    && Glib::str_has_prefix(name, instanceDirPrefix)
+                    && !Glib::file_test(path + lockFileSuffix, Glib::FILE_TEST_EXISTS))
+                    removeRecursively(Gio::File::create_for_path(path));
+
+                continue;
+            }
+
+            // Including lock files that an instance died before renaming
+            const auto modified = static_cast<gint64>(info->get_attribute_uint64(G_FILE_ATTRIBUTE_TIME_MODIFIED));
+
+            if (info->get_file_type() == Gio::FILE_TYPE_REGULAR && now - modified > staleAgeInSeconds)
+                g_remove(path.c_str());
+        }
+    }
+    catch (const Glib::Error&) {
+        // Whatever was removed so far is still a win
+    }
+}
 }
@@ -18,10 +18,44 @@
 #define TEMPFILE_HPP
 
 #include <giomm/file.h>
+#include <cstddef>
+#include <functional>
 
 namespace Slicer::TempFile {
 
+// In the directory of this instance, see instanceDirPath()
 Glib::RefPtr<Gio::File> generate();
+
+// A hidden file name in the same directory as file, so that it can replace
+// file with a rename instead of a copy
+Glib::RefPtr<Gio::File> generateNextTo(const Glib::RefPtr<Gio::File>& file);
+
+// A private copy of the source that later changes to the source can't touch.
+// Where the filesystem supports it, the copy is a reflink, which shares the
+// blocks with the source until one of them is written; otherwise it's a full copy.
+Glib::RefPtr<Gio::File> snapshot(const Glib::RefPtr<Gio::File>& sourceFile);
+// Like snapshot(), into destination, which mustn't exist
+void snapshotTo(const Glib::RefPtr<Gio::File>& sourceFile, const Glib::RefPtr<Gio::File>& destination);
+
+// Given the bytes of a file in order, a chunk at a time, as they are copied
+using DataSlot = std::function<void(const char* data, std::size_t size)>;
+// Like snapshot(), but a copy that isn't a reflink goes through onData as
+// it's made, so that whatever needs every byte of the file is done in the
+// same pass. Returns whether onData was given the whole file.
+bool snapshotTo(const Glib::RefPtr<Gio::File>& sourceFile,
+                const Glib::RefPtr<Gio::File>& destination,
+                const DataSlot& onData);
+
+// Every running instance keeps its temp files in a directory of its own,
+// inside config::getTempDirPath(), next to a lock file that it holds until
+// it exits. The directory is created on first use, and removed at exit if it's empty.
+std::string instanceDirPath();
+
+// Removes what crashed or killed instances left behind: the directories of
+// instances that no longer hold their lock, and loose files from versions
+// before instance directories, once they are a day old.
+// Takes a while with many files: meant to run in the background.
+void removeStaleFiles();
 }
 
 #endif // TEMPFILE_HPP
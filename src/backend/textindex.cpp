@@ -0,0 +1,355 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "textindex.hpp"
+#include <glib.h>
+#include <glibmm/miscutils.h>
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <limits>
+
+namespace Slicer {
+
+namespace {
+    // Changes whenever the layout below does, so old indexes just miss
+    constexpr std::uint32_t magic = 0x58545350; // "PSTX"
+    constexpr std::uint32_t version = 1;
+
+    void appendVarint(std::string& data, std::uint64_t value)
+    {
+        while (value >= 0x80) {
+            data.push_back(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+
+        data.push_back(static_cast<char>(value));
+    }
+
+    // Advances position past the varint, or leaves it at the end if it's cut
+    std::optional<std::uint64_t> readVarint(const std::string& data, std::size_t& position)
+    {
+        std::uint64_t value = 0;
+
+        for (unsigned int shift = 0; shift < 64 && position < data.size(); shift += 7) {
+            const auto byte = static_cast<std::uint8_t>(data[position++]);
+            value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+
+            if ((byte & 0x80) == 0)
+                return value;
+        }
+
+        position = data.size();
+        return std::nullopt;
+    }
+
+    void appendUint32(std::string& data, std::uint32_t value)
+    {
+        for (int i = 0; i < 4; ++i)
+            data.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+    }
+
+    std::optional<std::uint32_t> readUint32(const std::string& data, std::size_t& position)
+    {
+        if (data.size() - position < 4)
+            return std::nullopt;
+
+        std::uint32_t value = 0;
+        for (int i = 0; i < 4; ++i)
+            value |= static_cast<std::uint32_t>(static_cast<std::uint8_t>(data[position++])) << (8 * i);
+
+        return value;
+    }
+
+    std::string pathFor(const std::string& directoryPath, const std::string& fileHash)
+    {
+        return Glib::build_filename(directoryPath, fileHash + ".text");
+    }
+}
+
+std::vector<std::string> TextIndex::wordsOf(const std::string& text)
+{
+    std::vector<std::string> words;
+    std::string word;
+
+    const char* current = text.c_str();
+    const char* end = current + text.size(); //NOLINT
+
+    while (current < end) {
+        const gunichar character = g_utf8_get_char_validated(current, end - current);
+        // Invalid bytes are skipped one at a time, and end a word like any other separator
+        const bool isValid = character != static_cast<gunichar>(-1) && character != static_cast<gunichar>(-2);
+        current = isValid ? g_utf8_next_char(current) : current + 1; //NOLINT
+
+        if (isValid && g_unichar_isalnum(character)) {
+            std::array<gchar, 6> encoded{};
+            const gint length = g_unichar_to_utf8(g_unichar_tolower(character), encoded.data());
+            word.append(encoded.data(), static_cast<std::size_t>(length));
+        }
+        else if (!word.empty()) {
+            words.push_back(std::move(word));
+            word.clear();
+        }
+    }
+
+    if (!word.empty())
+        words.push_back(std::move(word));
+
+    return words;
+}
+
+void TextIndex::addPage(unsigned int page, const std::string& text)
+{
+    const std::vector<std::string> words = wordsOf(text);
+    std::unordered_map<std::string, std::vector<Occurrence>> occurrences;
+
+    for (std::size_t position = 0; position < words.size(); ++position)
+        occurrences[words[position]].push_back((static_cast<Occurrence>(page) << 32) | position);
+
+    for (const auto& [word, wordOccurrences] : occurrences)
+        insertOccurrences(word, wordOccurrences);
+
+    markIndexed(page);
+}
+
+void TextIndex::merge(const TextIndex& other)
+{
+    for (const auto& [word, occurrences] : other.m_occurrences)
+        insertOccurrences(word, occurrences);
+
+    for (std::size_t page = 0; page < other.m_indexedPages.size(); ++page)
+        if (other.m_indexedPages[page])
+            markIndexed(static_cast<unsigned int>(page));
+}
+
+void TextIndex::insertOccurrences(const std::string& word, const std::vector<Occurrence>& occurrences)
+{
+    std::vector<Occurrence>& existing = m_occurrences[word];
+    const auto middle = static_cast<std::ptrdiff_t>(existing.size());
+    existing.insert(existing.end(), occurrences.begin(), occurrences.end());
+
+    // Batches mostly come in order, which leaves nothing to merge
+    if (middle > 0 && existing.at(static_cast<std::size_t>(middle) - 1) > existing.at(static_cast<std::size_t>(middle)))
+        std::inplace_merge(existing.begin(), existing.begin() + middle, existing.end());
+}
+
+void TextIndex::markIndexed(unsigned int page)
+{
+    if (page >= m_indexedPages.size())
+        m_indexedPages.resize(page + 1, false);
+
+    if (!m_indexedPages[page]) {
+        m_indexedPages[page] = true;
+        ++m_numberOfIndexedPages;
+    }
+}
+
+bool TextIndex::isIndexed(unsigned int page) const
+{
+    return page < m_indexedPages.size() && m_indexedPages[page];
+}
+
+std::vector<unsigned int> TextIndex::findPages(const std::string& query) const
+{
+    const std::vector<std::string> words = wordsOf(query);
+
+    if (words.empty())
+        return {};
+
+    std::vector<const std::vector<Occurrence>*> wordOccurrences;
+
+    for (const std::string& word : words) {
+        auto it = m_occurrences.find(word);
+
+        if (it == m_occurrences.end())
+            return {};
+
+        wordOccurrences.push_back(&it->second);
+    }
+
+    std::vector<unsigned int> pages;
+
+    for (const Occurrence first : *wordOccurrences.front()) {
+        const auto page = static_cast<unsigned int>(first >> 32);
+
+        if (!pages.empty() && pages.back() == page)
+            continue;
+
+        // Words in a row are in a row on the same page
+        bool isMatch = true;
+        for (std::size_t i = 1; i < wordOccurrences.size() && isMatch; ++i)
+            isMatch = std::binary_search(wordOccurrences[i]->begin(), wordOccurrences[i]->end(), first + i);
+
+        if (isMatch)
+            pages.push_back(page);
+    }
+
+    return pages;
+}
+
+std::string TextIndex::serialize() const
+{
+    std::string data;
+    appendUint32(data, magic);
+    appendUint32(data, version);
+
+    appendVarint(data, m_indexedPages.size());
+    for (std::size_t page = 0; page < m_indexedPages.size(); page += 8) {
+        std::uint8_t byte = 0;
+
+        for (std::size_t bit = 0; bit < 8 && page + bit < m_indexedPages.size(); ++bit)
+            if (m_indexedPages[page + bit])
+                byte |= static_cast<std::uint8_t>(1U << bit);
+
+        data.push_back(static_cast<char>(byte));
+    }
+
+    appendVarint(data, m_occurrences.size());
+    for (const auto& [word, occurrences] : m_occurrences) {
+        appendVarint(data, word.size());
+        data.append(word);
+        appendVarint(data, occurrences.size());
+
+        Occurrence previous = 0;
+        for (const Occurrence occurrence : occurrences) {
+            appendVarint(data, occurrence - previous);
+            previous = occurrence;
+        }
+    }
+
+    return data;
+}
+
+std::optional<TextIndex> TextIndex::deserialize(const std::string& data)
+{
+    std::size_t position = 0;
+
+    if (readUint32(data, position) != magic || readUint32(data, position) != version)
+        return std::nullopt;
+
+    const std::optional<std::uint64_t> numberOfPages = readVarint(data, position);
+    if (!numberOfPages.has_value() || *numberOfPages > std::numeric_limits<unsigned int>::max()
+        || (*numberOfPages + 7) / 8 > data.size() - position)
+        return std::nullopt;
+
+    TextIndex index;
+
+    for (std::uint64_t page = 0; page < *numberOfPages; ++page)
+        if ((static_cast<std::uint8_t>(data[position + page / 8]) & (1U << (page % 8))) != 0)
+            index.markIndexed(static_cast<unsigned int>(page));
+
+    position += (*numberOfPages + 7) / 8;
+
+    const std::optional<std::uint64_t> numberOfWords = readVarint(data, position);
+    if (!numberOfWords.has_value())
+        return std::nullopt;
+
+    for (std::uint64_t i = 0; i < *numberOfWords; ++i) {
+        const std::optional<std::uint64_t> length = readVarint(data, position);
+        if (!length.has_value() || *length > data.size() - position)
+            return std::nullopt;
+
+        std::string word = data.substr(position, *length);
+        position += *length;
+
+        const std::optional<std::uint64_t> count = readVarint(data, position);
+        // Every occurrence takes a byte at least
+        if (!count.has_value() || *count > data.size() - position)
+            return std::nullopt;
+
+        std::vector<Occurrence> occurrences;
+        occurrences.reserve(*count);
+
+        Occurrence previous = 0;
+        for (std::uint64_t j = 0; j < *count; ++j) {
+            const std::optional<std::uint64_t> delta = readVarint(data, position);
+            if (!delta.has_value())
+                return std::nullopt;
+
+            previous += *delta;
+            occurrences.push_back(previous);
+        }
+
+        index.m_occurrences.emplace(std::move(word), std::move(occurrences));
+    }
+
+    if (position != data.size())
+        return std::nullopt;
+
+    return index;
+}
+
+std::optional<TextIndex> TextIndex::load(const PageIndex::Key& key)
+{
+    const std::string directoryPath = PageIndex::directoryPath();
+
+    if (directoryPath.empty() || key.fileHash.empty())
+        return std::nullopt;
+
+    const std::string path = pathFor(directoryPath, key.fileHash);
+    std::ifstream file{path, std::ios::binary};
+    if (!file)
+        return std::nullopt;
+
+    const std::string data{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+    file.close();
+
+    std::size_t position = 0;
+    const std::optional<std::uint64_t> fileSize = readVarint(data, position);
+    const std::optional<std::uint64_t> modificationTime = readVarint(data, position);
+
+    if (fileSize != key.fileSize || modificationTime != key.modificationTime) {
+        std::remove(path.c_str());
+        return std::nullopt;
+    }
+
+    return deserialize(data.substr(position));
+}
+
+void TextIndex::store(const PageIndex::Key& key, const TextIndex& index)
+{
+    const std::string directoryPath = PageIndex::directoryPath();
+
+    if (directoryPath.empty() || key.fileHash.empty() || index.numberOfIndexedPages() == 0)
+        return;
+
+    const std::string path = pathFor(directoryPath, key.fileHash);
+    const std::string partialPath = path + ".part";
+
+    std::string data;
+    appendVarint(data, key.fileSize);
+    appendVarint(data, key.modificationTime);
+    data.append(index.serialize());
+
+    {
+        std::ofstream file{partialPath, std::ios::binary | std::ios::trunc};
+        file.write(data.data(), static_cast<std::streamsize>(data.size()));
+
+        if (!file) {
+            file.close();
+            std::remove(partialPath.c_str());
+            return;
+        }
+    }
+
+    // Readers see either the old index or the whole new one
+    if (std::rename(partialPath.c_str(), path.c_str()) != 0)
+        std::remove(partialPath.c_str());
+}
+
+} // namespace Slicer
@@ -0,0 +1,76 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef TEXTINDEX_HPP
+#define TEXTINDEX_HPP
+
+#include "pageindex.hpp"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Slicer {
+
+// Which words each page of a file has, and where, for finding pages by
+// their text without asking poppler again. Words are runs of letters and
+// digits, lowercased. Pages can be added in any order, a batch at a time
+// from any thread, and merged; every list of occurrences stays sorted, so
+// a query takes a binary search per occurrence of its first word.
+class TextIndex {
+public:
+    // The words of text, in order
+    static std::vector<std::string> wordsOf(const std::string& text);
+
+    // Once per page, with the text poppler gives for it
+    void addPage(unsigned int page, const std::string& text);
+    // Takes the pages of other, which mustn't be in this one already
+    void merge(const TextIndex& other);
+
+    bool isIndexed(unsigned int page) const;
+    unsigned int numberOfIndexedPages() const { return m_numberOfIndexedPages; }
+
+    // Pages that have the words of query one after the other, in order.
+    // No page matches a query without words.
+    std::vector<unsigned int> findPages(const std::string& query) const;
+
+    // Compact, with occurrences delta encoded as varints
+    std::string serialize() const;
+    static std::optional<TextIndex> deserialize(const std::string& data);
+
+    // Kept in the directory of the page index, named after the content
+    // hash of the file, along with the size and modification time of the
+    // key. One stored for another size or time is thrown away, as the file
+    // was rewritten since. Best effort, like PageIndex: errors are misses.
+    static std::optional<TextIndex> load(const PageIndex::Key& key);
+    static void store(const PageIndex::Key& key, const TextIndex& index);
+
+private:
+    // The page in the high half, the position of the word in it in the low one
+    using Occurrence = std::uint64_t;
+
+    std::unordered_map<std::string, std::vector<Occurrence>> m_occurrences;
+    std::vector<bool> m_indexedPages;
+    unsigned int m_numberOfIndexedPages = 0;
+
+    void markIndexed(unsigned int page);
+    void insertOccurrences(const std::string& word, const std::vector<Occurrence>& occurrences);
+};
+
+} // namespace Slicer
+
+#endif // TEXTINDEX_HPP
@@ -0,0 +1,324 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "thumbnailcache.hpp"
+#include "sourcefile.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <iterator>
+#include <optional>
+
+namespace Slicer {
+
+bool ThumbnailCache::Key::operator==(const Key& other) const
+{
+    return fileHash == other.fileHash
+           && indexInFile == other.indexInFile
+           && rotation == other.rotation
+           && targetSize == other.targetSize
+           && fileSize == other.fileSize
+           && modificationTime == other.modificationTime;
+}
+
+std::size_t ThumbnailCache::KeyHash::operator()(const Key& key) const
+{
+    std::size_t result = std::hash<std::string>{}(key.fileHash);
+
+    for (std::size_t value : {static_cast<std::size_t>(key.indexInFile),
+                              static_cast<std::size_t>(key.rotation),
+                              static_cast<std::size_t>(key.targetSize),
+                              static_cast<std::size_t>(key.fileSize),
+                              static_cast<std::size_t>(key.modificationTime)})
+        result ^= value + 0x9e3779b9 + (result << 6) + (result >> 2); //NOLINT
+
+    return result;
+}
+
+Glib::RefPtr<Gdk::Pixbuf> ThumbnailCache::Entry::pixbuf() const
+{
+    return gray.has_value() ? ThumbnailCodec::unpackGray(*gray) : thumbnail;
+}
+
+ThumbnailCache::ThumbnailCache(std::size_t capacityInBytes, std::size_t compressedCapacityInBytes)
+    : m_capacity{capacityInBytes}
+    , m_compressedCapacity{compressedCapacityInBytes}
+{
+}
+
+ThumbnailCache::Key ThumbnailCache::keyFor(const Page& page, int targetSize)
+{
+    const SourceFile::Origin& origin = page.sourceFile().origin();
+
+    return {page.fileHash(), page.indexInFile(), page.currentRotation(), targetSize, origin.size, origin.modificationTime};
+}
+
+Glib::RefPtr<Gdk::Pixbuf> ThumbnailCache::find(const Key& key)
+{
+    auto it = m_index.find(key);
+
+    if (it == m_index.end()) {
+        auto compressed = m_compressedIndex.find(key);
+
+        if (compressed == m_compressedIndex.end())
+            return {};
+
+        Glib::RefPtr<Gdk::Pixbuf> result = ThumbnailCodec::decompress(compressed->second->thumbnail);
+        eraseCompressed(key);
+        insert(key, result);
+
+        return result;
+    }
+
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+
+    return it->second->pixbuf();
+}
+
+Glib::RefPtr<Gdk::Pixbuf> ThumbnailCache::findOrRotate(const Key& key)
+{
+    if (Glib::RefPtr<Gdk::Pixbuf> result = find(key); result)
+        return result;
+
+    for (int clockwiseTurn : {90, 270, 180}) {
+        Key sourceKey = key;
+        sourceKey.rotation = (key.rotation - clockwiseTurn + 360) % 360;
+
+        if (Glib::RefPtr<Gdk::Pixbuf> source = find(sourceKey); source) {
+            // Gdk measures rotations counterclockwise
+            const auto pixbufRotation = static_cast<Gdk::PixbufRotation>((360 - clockwiseTurn) % 360);
+            Glib::RefPtr<Gdk::Pixbuf> result = source->rotate_simple(pixbufRotation);
+            insert(key, result);
+
+            return result;
+        }
+    }
+
+    return {};
+}
+
+Glib::RefPtr<Gdk::Pixbuf> ThumbnailCache::findNearest(const Key& key)
+{
+    const std::vector<int>* sizes = sizesOf(key);
+
+    if (sizes == nullptr)
+        return {};
+
+    const int nearestSize = *std::min_element(sizes->begin(), sizes->end(), [&key](int first, int second) {
+        return std::abs(first - key.targetSize) < std::abs(second - key.targetSize);
+    });
+
+    Key nearestKey = key;
+    nearestKey.targetSize = nearestSize;
+
+    return find(nearestKey);
+}
+
+Glib::RefPtr<Gdk::Pixbuf> ThumbnailCache::findLarger(const Key& key, double maximumFactor)
+{
+    const std::vector<int>* sizes = sizesOf(key);
+
+    if (sizes == nullptr)
+        return {};
+
+    std::optional<int> largerSize;
+
+    for (int size : *sizes) {
+        if (size > key.targetSize && size <= key.targetSize * maximumFactor && (!largerSize.has_value() || size < *largerSize))
+            largerSize = size;
+    }
+
+    if (!largerSize.has_value())
+        return {};
+
+    Key largerKey = key;
+    largerKey.targetSize = *largerSize;
+
+    return find(largerKey);
+}
+
+void ThumbnailCache::insert(const Key& key, const Glib::RefPtr<Gdk::Pixbuf>& thumbnail)
+{
+    if (!thumbnail)
+        return;
+
+    std::optional<ThumbnailCodec::GrayThumbnail> gray = ThumbnailCodec::packGray(thumbnail);
+    const std::size_t size = gray.has_value() ? gray->sizeInBytes() : sizeOf(thumbnail);
+
+    if (auto it = m_index.find(key); it != m_index.end())
+        eraseEntry(it->second);
+
+    eraseCompressed(key);
+
+    // Wouldn't fit even with everything else gone
+    if (size > m_capacity) {
+        updateMemoryCharge();
+        return;
+    }
+
+    if (gray.has_value())
+        m_entries.push_front({key, {}, std::move(gray), size});
+    else
+        m_entries.push_front({key, thumbnail, std::nullopt, size});
+
+    m_index.emplace(key, m_entries.begin());
+    m_sizeInBytes += size;
+
+    Key pageKey = key;
+    pageKey.targetSize = 0;
+    m_sizes[pageKey].push_back(key.targetSize);
+
+    evict();
+    updateMemoryCharge();
+}
+
+void ThumbnailCache::forget(const std::string& fileHash, const std::vector<unsigned int>& indexesInFile)
+{
+    const auto isForgotten = [&fileHash, &indexesInFile](const Key& key) {
+        return key.fileHash == fileHash
+               && std::find(indexesInFile.begin(), indexesInFile.end(), key.indexInFile) != indexesInFile.end();
+    };
+
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        if (!isForgotten(it->key)) {
+            ++it;
+            continue;
+        }
+
+        eraseEntry(it++);
+    }
+
+    for (auto it = m_compressedEntries.begin(); it != m_compressedEntries.end();) {
+        if (!isForgotten(it->key)) {
+            ++it;
+            continue;
+        }
+
+        m_compressedSizeInBytes -= it->thumbnail.sizeInBytes();
+        m_compressedIndex.erase(it->key);
+        it = m_compressedEntries.erase(it);
+    }
+
+    updateMemoryCharge();
+}
+
+void ThumbnailCache::clear()
+{
+    m_index.clear();
+    m_entries.clear();
+    m_sizes.clear();
+    m_sizeInBytes = 0;
+    m_compressedIndex.clear();
+    m_compressedEntries.clear();
+    m_compressedSizeInBytes = 0;
+    updateMemoryCharge();
+}
+
+void ThumbnailCache::setCapacity(std::size_t capacityInBytes)
+{
+    m_capacity = capacityInBytes;
+
+    evict();
+    updateMemoryCharge();
+}
+
+void ThumbnailCache::setCompressedCapacity(std::size_t capacityInBytes)
+{
+    m_compressedCapacity = capacityInBytes;
+
+    evictCompressed();
+    updateMemoryCharge();
+}
+
+void ThumbnailCache::eraseEntry(std::list<Entry>::iterator entry)
+{
+    Key pageKey = entry->key;
+    pageKey.targetSize = 0;
+
+    if (auto sizes = m_sizes.find(pageKey); sizes != m_sizes.end()) {
+        std::vector<int>& values = sizes->second;
+        values.erase(std::remove(values.begin(), values.end(), entry->key.targetSize), values.end());
+
+        if (values.empty())
+            m_sizes.erase(sizes);
+    }
+
+    m_sizeInBytes -= entry->sizeInBytes;
+    m_index.erase(entry->key);
+    m_entries.erase(entry);
+}
+
+const std::vector<int>* ThumbnailCache::sizesOf(const Key& key) const
+{
+    Key pageKey = key;
+    pageKey.targetSize = 0;
+
+    auto it = m_sizes.find(pageKey);
+
+    return it != m_sizes.end() ? &it->second : nullptr;
+}
+
+void ThumbnailCache::evict()
+{
+    while (m_sizeInBytes > m_capacity && !m_entries.empty()) {
+        Entry& last = m_entries.back();
+
+        if (m_compressedCapacity > 0) {
+            ThumbnailCodec::CompressedThumbnail compressed = ThumbnailCodec::compress(last.pixbuf());
+            m_compressedSizeInBytes += compressed.sizeInBytes();
+            m_compressedEntries.push_front({last.key, std::move(compressed)});
+            m_compressedIndex.emplace(last.key, m_compressedEntries.begin());
+        }
+
+        eraseEntry(std::prev(m_entries.end()));
+    }
+
+    evictCompressed();
+}
+
+void ThumbnailCache::evictCompressed()
+{
+    while (m_compressedSizeInBytes > m_compressedCapacity && !m_compressedEntries.empty()) {
+        const CompressedEntry& last = m_compressedEntries.back();
+        m_compressedSizeInBytes -= last.thumbnail.sizeInBytes();
+        m_compressedIndex.erase(last.key);
+        m_compressedEntries.pop_back();
+    }
+}
+
+void ThumbnailCache::eraseCompressed(const Key& key)
+{
+    auto it = m_compressedIndex.find(key);
+
+    if (it == m_compressedIndex.end())
+        return;
+
+    m_compressedSizeInBytes -= it->second->thumbnail.sizeInBytes();
+    m_compressedEntries.erase(it->second);
+    m_compressedIndex.erase(it);
+}
+
+void ThumbnailCache::updateMemoryCharge()
+{
+    m_memoryCharge.set(m_sizeInBytes + m_compressedSizeInBytes);
+}
+
+std::size_t ThumbnailCache::sizeOf(const Glib::RefPtr<Gdk::Pixbuf>& thumbnail)
+{
+    return static_cast<std::size_t>(thumbnail->get_rowstride()) * static_cast<std::size_t>(thumbnail->get_height());
+}
+
+} // namespace Slicer
@@ -0,0 +1,149 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef THUMBNAILCACHE_HPP
+#define THUMBNAILCACHE_HPP
+
+#include "metrics.hpp"
+#include "page.hpp"
+#include "thumbnailcodec.hpp"
+#include <cstdint>
+#include <list>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Slicer {
+
+// Keeps recently rendered thumbnails, so that zooming back and forth
+// or undoing a rotation doesn't go through poppler again.
+// Bounded by the memory taken by the pixels; the least recently used
+// thumbnails are dropped first. Those can move on to a second, compressed
+// tier with its own capacity, to be expanded again when they're found.
+// Opaque gray thumbnails, which most pages of text make, are kept packed
+// at a byte or a bit per pixel, and expanded to RGBA when found; see
+// ThumbnailCodec::packGray().
+// Not thread safe: use it from one thread.
+class ThumbnailCache {
+public:
+    // By the contents of the file rather than its place in a document, so
+    // that a cache can be shared by documents with the same files
+    struct Key {
+        std::string fileHash;
+        unsigned int indexInFile;
+        int rotation;
+        int targetSize;
+        // As in DiskThumbnailCache::Key, so that a file rewritten in place
+        // isn't shown as it was. Zero when the hash is of the whole file.
+        std::uint64_t fileSize;
+        std::uint64_t modificationTime;
+
+        bool operator==(const Key& other) const;
+    };
+
+    struct KeyHash {
+        std::size_t operator()(const Key& key) const;
+    };
+
+    explicit ThumbnailCache(std::size_t capacityInBytes = defaultCapacity,
+                            std::size_t compressedCapacityInBytes = 0);
+
+    ThumbnailCache(const ThumbnailCache&) = delete;
+    ThumbnailCache& operator=(const ThumbnailCache&) = delete;
+    ThumbnailCache(ThumbnailCache&&) = delete;
+    ThumbnailCache& operator=(ThumbnailCache&& src) = delete;
+
+    ~ThumbnailCache() = default;
+
+    static Key keyFor(const Page& page, int targetSize);
+
+    Glib::RefPtr<Gdk::Pixbuf> find(const Key& key);
+    // Like find(), but falls back to turning the thumbnail of the same page
+    // at another rotation, which is much cheaper than rendering it again
+    Glib::RefPtr<Gdk::Pixbuf> findOrRotate(const Key& key);
+    // The thumbnail of the same page and rotation at the size closest to
+    // the key's, as a stand-in while zooming. Looks through the uncompressed
+    // tier only.
+    Glib::RefPtr<Gdk::Pixbuf> findNearest(const Key& key);
+    // The smallest thumbnail of the same page and rotation that's larger
+    // than the key's size, by no more than maximumFactor times: the level
+    // above in the chain of sizes a page is kept at, to be scaled down
+    // rather than rendered again. Uncompressed tier only, like findNearest().
+    Glib::RefPtr<Gdk::Pixbuf> findLarger(const Key& key, double maximumFactor);
+    void insert(const Key& key, const Glib::RefPtr<Gdk::Pixbuf>& thumbnail);
+    // Every thumbnail of those pages, at any rotation and size, in both tiers
+    void forget(const std::string& fileHash, const std::vector<unsigned int>& indexesInFile);
+    void clear();
+
+    void setCapacity(std::size_t capacityInBytes);
+    std::size_t capacity() const { return m_capacity; }
+    std::size_t sizeInBytes() const { return m_sizeInBytes; }
+    std::size_t numberOfEntries() const { return m_entries.size(); }
+
+    void setCompressedCapacity(std::size_t capacityInBytes);
+    std::size_t compressedCapacity() const { return m_compressedCapacity; }
+    std::size_t compressedSizeInBytes() const { return m_compressedSizeInBytes; }
+    std::size_t numberOfCompressedEntries() const { return m_compressedEntries.size(); }
+
+    static constexpr std::size_t defaultCapacity = 128 * 1024 * 1024;
+    static constexpr std::size_t defaultCompressedCapacity = 64 * 1024 * 1024;
+
+private:
+    struct Entry {
+        Key key;
+        // Null when the thumbnail is kept as gray
+        Glib::RefPtr<Gdk::Pixbuf> thumbnail;
+        std::optional<ThumbnailCodec::GrayThumbnail> gray;
+        std::size_t sizeInBytes;
+
+        Glib::RefPtr<Gdk::Pixbuf> pixbuf() const;
+    };
+
+    // Most recently used entries at the front
+    std::list<Entry> m_entries;
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> m_index;
+    std::size_t m_capacity;
+    std::size_t m_sizeInBytes = 0;
+    // The sizes in the tier above of each page and rotation, by their key
+    // with a target size of zero
+    std::unordered_map<Key, std::vector<int>, KeyHash> m_sizes;
+
+    struct CompressedEntry {
+        Key key;
+        ThumbnailCodec::CompressedThumbnail thumbnail;
+    };
+
+    // Entries evicted from the tier above, most recently evicted at the front
+    std::list<CompressedEntry> m_compressedEntries;
+    std::unordered_map<Key, std::list<CompressedEntry>::iterator, KeyHash> m_compressedIndex;
+    std::size_t m_compressedCapacity;
+    std::size_t m_compressedSizeInBytes = 0;
+    Metrics::MemoryCharge m_memoryCharge{Metrics::Memory::Thumbnails};
+
+    void eraseEntry(std::list<Entry>::iterator entry);
+    const std::vector<int>* sizesOf(const Key& key) const;
+    void evict();
+    void evictCompressed();
+    void eraseCompressed(const Key& key);
+    // After every change of size, once it's done
+    void updateMemoryCharge();
+    static std::size_t sizeOf(const Glib::RefPtr<Gdk::Pixbuf>& thumbnail);
+};
+
+} // namespace Slicer
+
+#endif // THUMBNAILCACHE_HPP
@@ -0,0 +1,312 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "thumbnailcodec.hpp"
+#include "pixelconversion.hpp"
+#include <array>
+#include <stdexcept>
+
+namespace Slicer::ThumbnailCodec {
+
+namespace {
+    struct Pixel {
+        std::uint8_t r = 0;
+        std::uint8_t g = 0;
+        std::uint8_t b = 0;
+        std::uint8_t a = 255;
+
+        bool operator==(const Pixel& other) const
+        {
+            return r == other.r && g == other.g && b == other.b && a == other.a;
+        }
+        bool operator!=(const Pixel& other) const { return !(*this == other); }
+    };
+
+    enum Operation : std::uint8_t {
+        opIndex = 0x00,
+        opDiff = 0x40,
+        opLuma = 0x80,
+        opRun = 0xc0,
+        opRgb = 0xfe,
+        opRgba = 0xff,
+    };
+
+    constexpr std::uint8_t operationMask = 0xc0;
+    constexpr int maxRunLength = 62;
+
+    std::size_t indexOf(const Pixel& pixel)
+    {
+        return (pixel.r * 3U + pixel.g * 5U + pixel.b * 7U + pixel.a * 11U) % 64U;
+    }
+
+    // Without branches, so that the compiler can vectorize it: only 0 and
+    // 255 turn into 0 once incremented and stripped of their lowest bit
+    bool isBilevel(const std::uint8_t* levels, std::size_t length)
+    {
+        std::uint8_t others = 0;
+
+        for (std::size_t i = 0; i < length; ++i)
+            others |= static_cast<std::uint8_t>(levels[i] + 1) & 0xfe; //NOLINT
+
+        return others == 0;
+    }
+
+    std::size_t bytesPerBilevelRow(int width)
+    {
+        return (static_cast<std::size_t>(width) + 7) / 8;
+    }
+}
+
+CompressedThumbnail compress(const Glib::RefPtr<Gdk::Pixbuf>& thumbnail)
+{
+    CompressedThumbnail result;
+    result.width = thumbnail->get_width();
+    result.height = thumbnail->get_height();
+    result.hasAlpha = thumbnail->get_has_alpha();
+
+    const int channels = thumbnail->get_n_channels();
+    const int rowstride = thumbnail->get_rowstride();
+    const std::uint8_t* pixels = thumbnail->get_pixels();
+
+    std::array<Pixel, 64> recent{};
+    Pixel previous;
+    int run = 0;
+
+    // Mostly blank pages end up well under a tenth of the raw size
+    result.data.reserve(static_cast<std::size_t>(result.width) * static_cast<std::size_t>(result.height) / 8);
+
+    for (int y = 0; y < result.height; ++y) {
+        const std::uint8_t* row = pixels + static_cast<std::ptrdiff_t>(y) * rowstride; //NOLINT
+
+        for (int x = 0; x < result.width; ++x) {
+            const std::uint8_t* source = row + static_cast<std::ptrdiff_t>(x) * channels; //NOLINT
+            const Pixel pixel{source[0], source[1], source[2], result.hasAlpha ? source[3] : std::uint8_t{255}}; //NOLINT
+
+            if (pixel == previous) {
+                if (++run == maxRunLength) {
+                    result.data.push_back(static_cast<std::uint8_t>(opRun | (run - 1)));
+                    run = 0;
+                }
+                continue;
+            }
+
+            if (run > 0) {
+                result.data.push_back(static_cast<std::uint8_t>(opRun | (run - 1)));
+                run = 0;
+            }
+
+            const std::size_t index = indexOf(pixel);
+
+            if (recent.at(index) == pixel) {
+                result.data.push_back(static_cast<std::uint8_t>(opIndex | index));
+            }
+            else if (pixel.a == previous.a) {
+                recent.at(index) = pixel;
+
+                const auto dr = static_cast<std::int8_t>(pixel.r - previous.r);
+                const auto dg = static_cast<std::int8_t>(pixel.g - previous.g);
+                const auto db = static_cast<std::int8_t>(pixel.b - previous.b);
+                const int drg = dr - dg;
+                const int dbg = db - dg;
+
+                if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                    result.data.push_back(static_cast<std::uint8_t>(opDiff | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+                }
+                else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7) {
+                    result.data.push_back(static_cast<std::uint8_t>(opLuma | (dg + 32)));
+                    result.data.push_back(static_cast<std::uint8_t>((drg + 8) << 4 | (dbg + 8)));
+                }
+                else {
+                    result.data.insert(result.data.end(), {opRgb, pixel.r, pixel.g, pixel.b});
+                }
+            }
+            else {
+                recent.at(index) = pixel;
+                result.data.insert(result.data.end(), {opRgba, pixel.r, pixel.g, pixel.b, pixel.a});
+            }
+
+            previous = pixel;
+        }
+    }
+
+    if (run > 0)
+        result.data.push_back(static_cast<std::uint8_t>(opRun | (run - 1)));
+
+    result.data.shrink_to_fit();
+
+    return result;
+}
+
+Glib::RefPtr<Gdk::Pixbuf> decompress(const CompressedThumbnail& thumbnail)
+{
+    Glib::RefPtr<Gdk::Pixbuf> result = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB,
+                                                           thumbnail.hasAlpha,
+                                                           8,
+                                                           thumbnail.width,
+                                                           thumbnail.height);
+
+    const int channels = result->get_n_channels();
+    const int rowstride = result->get_rowstride();
+    std::uint8_t* pixels = result->get_pixels();
+
+    const std::vector<std::uint8_t>& data = thumbnail.data;
+    std::size_t position = 0;
+    const auto next = [&data, &position]() {
+        if (position >= data.size())
+            throw std::runtime_error("Compressed thumbnail ends too early");
+
+        return data[position++];
+    };
+
+    std::array<Pixel, 64> recent{};
+    Pixel pixel;
+    int run = 0;
+
+    for (int y = 0; y < thumbnail.height; ++y) {
+        std::uint8_t* row = pixels + static_cast<std::ptrdiff_t>(y) * rowstride; //NOLINT
+
+        for (int x = 0; x < thumbnail.width; ++x) {
+            if (run > 0) {
+                --run;
+            }
+            else {
+                const std::uint8_t byte = next();
+
+                if (byte == opRgb) {
+                    pixel.r = next();
+                    pixel.g = next();
+                    pixel.b = next();
+                }
+                else if (byte == opRgba) {
+                    pixel.r = next();
+                    pixel.g = next();
+                    pixel.b = next();
+                    pixel.a = next();
+                }
+                else if ((byte & operationMask) == opIndex) {
+                    pixel = recent.at(byte);
+                }
+                else if ((byte & operationMask) == opDiff) {
+                    pixel.r += ((byte >> 4) & 0x03) - 2;
+                    pixel.g += ((byte >> 2) & 0x03) - 2;
+                    pixel.b += (byte & 0x03) - 2;
+                }
+                else if ((byte & operationMask) == opLuma) {
+                    const std::uint8_t second = next();
+                    const int dg = (byte & 0x3f) - 32;
+                    pixel.r += dg - 8 + ((second >> 4) & 0x0f);
+                    pixel.g += dg;
+                    pixel.b += dg - 8 + (second & 0x0f);
+                }
+                else {
+                    run = byte & 0x3f;
+                }
+
+                recent.at(indexOf(pixel)) = pixel;
+            }
+
+            std::uint8_t* destination = row + static_cast<std::ptrdiff_t>(x) * channels; //NOLINT
+            destination[0] = pixel.r; //NOLINT
+            destination[1] = pixel.g; //NOLINT
+            destination[2] = pixel.b; //NOLINT
+            if (thumbnail.hasAlpha)
+                destination[3] = pixel.a; //NOLINT
+        }
+    }
+
+    return result;
+}
+
+std::optional<GrayThumbnail> packGray(const Glib::RefPtr<Gdk::Pixbuf>& thumbnail)
+{
+    if (thumbnail->get_n_channels() != 4 || thumbnail->get_bits_per_sample() != 8)
+        return std::nullopt;
+
+    GrayThumbnail result;
+    result.width = thumbnail->get_width();
+    result.height = thumbnail->get_height();
+    result.data.resize(static_cast<std::size_t>(result.width) * static_cast<std::size_t>(result.height));
+
+    if (!PixelConversion::rgbaToOpaqueGray(thumbnail->get_pixels(),
+                                           thumbnail->get_rowstride(),
+                                           result.data.data(),
+                                           result.width,
+                                           result.width,
+                                           result.height))
+        return std::nullopt;
+
+    if (!isBilevel(result.data.data(), result.data.size()))
+        return result;
+
+    const std::size_t rowLength = bytesPerBilevelRow(result.width);
+    std::vector<std::uint8_t> bits(rowLength * static_cast<std::size_t>(result.height));
+
+    for (int y = 0; y < result.height; ++y) {
+        const std::uint8_t* levels = result.data.data() + static_cast<std::ptrdiff_t>(y) * result.width; //NOLINT
+        std::uint8_t* row = bits.data() + static_cast<std::ptrdiff_t>(y) * static_cast<std::ptrdiff_t>(rowLength); //NOLINT
+
+        for (int x = 0; x < result.width; ++x)
+            row[x / 8] |= static_cast<std::uint8_t>((levels[x] & 1) << (x % 8)); //NOLINT
+    }
+
+    result.bitsPerPixel = 1;
+    result.data = std::move(bits);
+
+    return result;
+}
+
+Glib::RefPtr<Gdk::Pixbuf> unpackGray(const GrayThumbnail& thumbnail)
+{
+    Glib::RefPtr<Gdk::Pixbuf> result = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB,
+                                                           true,
+                                                           8,
+                                                           thumbnail.width,
+                                                           thumbnail.height);
+
+    if (thumbnail.bitsPerPixel == 8) {
+        PixelConversion::grayToRgba(thumbnail.data.data(),
+                                    thumbnail.width,
+                                    result->get_pixels(),
+                                    result->get_rowstride(),
+                                    thumbnail.width,
+                                    thumbnail.height);
+
+        return result;
+    }
+
+    // A row at a time, through its levels
+    const std::size_t rowLength = bytesPerBilevelRow(thumbnail.width);
+    std::vector<std::uint8_t> levels(static_cast<std::size_t>(thumbnail.width));
+
+    for (int y = 0; y < thumbnail.height; ++y) {
+        const std::uint8_t* row = thumbnail.data.data() + static_cast<std::ptrdiff_t>(y) * static_cast<std::ptrdiff_t>(rowLength); //NOLINT
+
+        for (int x = 0; x < thumbnail.width; ++x)
+            levels[static_cast<std::size_t>(x)] = ((row[x / 8] >> (x % 8)) & 1) != 0 ? 0xff : 0; //NOLINT
+
+        PixelConversion::grayToRgba(levels.data(),
+                                    thumbnail.width,
+                                    result->get_pixels() + static_cast<std::ptrdiff_t>(y) * result->get_rowstride(), //NOLINT
+                                    result->get_rowstride(),
+                                    thumbnail.width,
+                                    1);
+    }
+
+    return result;
+}
+
+} // namespace Slicer::ThumbnailCodec
@@ -0,0 +1,64 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef THUMBNAILCODEC_HPP
+#define THUMBNAILCODEC_HPP
+
+#include <gdkmm/pixbuf.h>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace Slicer::ThumbnailCodec {
+
+// A thumbnail kept in memory in a compact, lossless form. The encoding
+// follows QOI (runs, a small table of recent colors and small differences
+// to the previous pixel), which shrinks pages of text on a plain
+// background many times over and is fast to read back.
+struct CompressedThumbnail {
+    int width = 0;
+    int height = 0;
+    bool hasAlpha = false;
+    std::vector<std::uint8_t> data;
+
+    std::size_t sizeInBytes() const { return data.size(); }
+};
+
+CompressedThumbnail compress(const Glib::RefPtr<Gdk::Pixbuf>& thumbnail);
+Glib::RefPtr<Gdk::Pixbuf> decompress(const CompressedThumbnail& thumbnail);
+
+// An opaque gray thumbnail, kept at a byte per pixel, or a bit for one of
+// only black and white: a quarter or less of its RGBA size, and no slower
+// to expand back than it is to copy. Most pages are black text on white.
+struct GrayThumbnail {
+    int width = 0;
+    int height = 0;
+    // 8, or 1 with each row padded to a byte and white as a set bit
+    int bitsPerPixel = 8;
+    std::vector<std::uint8_t> data;
+
+    std::size_t sizeInBytes() const { return data.size(); }
+};
+
+// Nothing unless the thumbnail is RGBA and every pixel of it opaque gray
+std::optional<GrayThumbnail> packGray(const Glib::RefPtr<Gdk::Pixbuf>& thumbnail);
+// Back to the RGBA thumbnail it was packed from
+Glib::RefPtr<Gdk::Pixbuf> unpackGray(const GrayThumbnail& thumbnail);
+
+} // namespace Slicer::ThumbnailCodec
+
+#endif // THUMBNAILCODEC_HPP
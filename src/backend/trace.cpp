@@ -0,0 +1,205 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "trace.hpp"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace Slicer::Trace {
+
+namespace {
+    struct Event {
+        const char* name;
+        Clock::time_point begin;
+        Clock::time_point end;
+    };
+
+    // Written by its own thread, read when exporting
+    struct ThreadBuffer {
+        std::mutex mutex;
+        std::vector<Event> events;
+        // Where the next event goes once the buffer is full
+        std::size_t next = 0;
+        std::string threadName;
+        unsigned int threadId = 0;
+    };
+
+    std::atomic<bool> enabled = false;
+    const Clock::time_point startTime = Clock::now();
+
+    // Buffers outlive their threads, so that what a finished thread did is still exported
+    std::mutex buffersMutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+
+    // Short-lived threads, like the ones parsing files for a save, would
+    // otherwise pile up. Their buffer is only held here once they're gone.
+    void dropFinishedThreads(bool evenWithEvents)
+    {
+        const auto isFinished = [evenWithEvents](const std::shared_ptr<ThreadBuffer>& buffer) {
+            if (buffer.use_count() > 1)
+                return false;
+
+            std::lock_guard<std::mutex> lock{buffer->mutex};
+            return evenWithEvents || buffer->events.empty();
+        };
+
+        buffers.erase(std::remove_if(buffers.begin(), buffers.end(), isFinished), buffers.end());
+    }
+
+    ThreadBuffer& bufferForCurrentThread()
+    {
+        thread_local std::shared_ptr<ThreadBuffer> buffer = [] {
+            auto created = std::make_shared<ThreadBuffer>();
+            static unsigned int nextThreadId = 1;
+
+            std::lock_guard<std::mutex> lock{buffersMutex};
+            created->threadId = nextThreadId++;
+            dropFinishedThreads(false);
+            buffers.push_back(created);
+
+            return created;
+        }();
+
+        return *buffer;
+    }
+
+    long long microseconds(Clock::duration duration)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+    }
+
+    void writeJsonString(std::ostream& out, const std::string& text)
+    {
+        out << '"';
+
+        for (char character : text) {
+            if (character == '"' || character == '\\')
+                out << '\\' << character;
+            else if (static_cast<unsigned char>(character) >= 0x20)
+                out << character;
+        }
+
+        out << '"';
+    }
+}
+
+void setEnabled(bool isOn)
+{
+    enabled.store(isOn, std::memory_order_relaxed);
+}
+
+bool isEnabled()
+{
+    return enabled.load(std::memory_order_relaxed);
+}
+
+void setThreadName(const std::string& name)
+{
+    ThreadBuffer& buffer = bufferForCurrentThread();
+    std::lock_guard<std::mutex> lock{buffer.mutex};
+    buffer.threadName = name;
+}
+
+void record(const char* name, Clock::time_point begin, Clock::time_point end)
+{
+    if (!isEnabled())
+        return;
+
+    ThreadBuffer& buffer = bufferForCurrentThread();
+    std::lock_guard<std::mutex> lock{buffer.mutex};
+
+    if (buffer.events.size() < spansPerThread) {
+        buffer.events.push_back({name, begin, end});
+    }
+    else {
+        buffer.events[buffer.next] = {name, begin, end};
+        buffer.next = (buffer.next + 1) % spansPerThread;
+    }
+}
+
+std::string chromeTraceJson()
+{
+    std::vector<std::shared_ptr<ThreadBuffer>> threads;
+
+    {
+        std::lock_guard<std::mutex> lock{buffersMutex};
+        threads = buffers;
+    }
+
+    std::ostringstream out;
+    out << "{\"traceEvents\":[";
+    bool isFirst = true;
+
+    const auto separate = [&out, &isFirst]() {
+        out << (isFirst ? "\n" : ",\n");
+        isFirst = false;
+    };
+
+    for (const std::shared_ptr<ThreadBuffer>& thread : threads) {
+        std::lock_guard<std::mutex> lock{thread->mutex};
+
+        if (!thread->threadName.empty()) {
+            separate();
+            out << R"({"name":"thread_name","ph":"M","pid":1,"tid":)" << thread->threadId << R"(,"args":{"name":)";
+            writeJsonString(out, thread->threadName);
+            out << "}}";
+        }
+
+        for (const Event& event : thread->events) {
+            separate();
+            out << R"({"name":)";
+            writeJsonString(out, event.name);
+            out << R"(,"ph":"X","pid":1,"tid":)" << thread->threadId
+                << R"(,"ts":)" << microseconds(event.begin - startTime)
+                << R"(,"dur":)" << microseconds(event.end - event.begin) << "}";
+        }
+    }
+
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+    return out.str();
+}
+
+bool exportChromeTrace(const std::string& filePath)
+{
+    std::ofstream file{filePath};
+
+    if (!file)
+        return false;
+
+    file << chromeTraceJson();
+
+    return static_cast<bool>(file);
+}
+
+void clear()
+{
+    std::lock_guard<std::mutex> lock{buffersMutex};
+    dropFinishedThreads(true);
+
+    for (const std::shared_ptr<ThreadBuffer>& thread : buffers) {
+        std::lock_guard<std::mutex> threadLock{thread->mutex};
+        thread->events.clear();
+        thread->next = 0;
+    }
+}
+
+} // namespace Slicer::Trace
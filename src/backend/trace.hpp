@@ -0,0 +1,83 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+namespace Slicer::Trace {
+
+// Timing spans around the hot paths, to see where a slow session spent its
+// time. Each thread keeps its last spans in a buffer of its own, so
+// recording takes two clock reads and an uncontended lock, and memory
+// stays bounded however long the session runs. Off until enabled; while
+// off, a span costs a single relaxed load.
+
+using Clock = std::chrono::steady_clock;
+
+void setEnabled(bool enabled);
+bool isEnabled();
+
+// Names the calling thread in the exported trace
+void setThreadName(const std::string& name);
+
+// A span that was measured apart, like the time a task waited in a queue.
+// The name has to outlive the trace: pass a string literal.
+void record(const char* name, Clock::time_point begin, Clock::time_point end);
+
+// Times the scope it lives in. The name has to outlive the trace: pass a string literal.
+class Span {
+public:
+    explicit Span(const char* name)
+        : m_name{isEnabled() ? name : nullptr}
+    {
+        if (m_name != nullptr)
+            m_begin = Clock::now();
+    }
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+    Span(Span&&) = delete;
+    Span& operator=(Span&& src) = delete;
+
+    ~Span()
+    {
+        if (m_name != nullptr)
+            record(m_name, m_begin, Clock::now());
+    }
+
+private:
+    const char* m_name;
+    Clock::time_point m_begin;
+};
+
+// Everything recorded so far, as Chrome trace event JSON, which
+// chrome://tracing and Perfetto's UI both open. Returns false if the file
+// can't be written.
+bool exportChromeTrace(const std::string& filePath);
+std::string chromeTraceJson();
+
+void clear();
+
+// Spans each thread keeps; older ones make room for new ones
+constexpr std::size_t spansPerThread = 16384;
+
+} // namespace Slicer::Trace
+
+#endif // TRACE_HPP
@@ -0,0 +1,110 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "workertuner.hpp"
+#include <algorithm>
+
+namespace Slicer {
+
+WorkerTuner::WorkerTuner(int minimum, int maximum)
+    : m_minimum{std::max(1, minimum)}
+    , m_maximum{std::max(m_minimum, maximum)}
+    , m_workers{m_maximum}
+{
+}
+
+void WorkerTuner::setLimits(int minimum, int maximum)
+{
+    m_minimum = std::max(1, minimum);
+    m_maximum = std::max(m_minimum, maximum);
+    m_workers = std::clamp(m_workers, m_minimum, m_maximum);
+
+    // Measured under other limits, it may be a count that isn't allowed anymore
+    m_previous.reset();
+}
+
+int WorkerTuner::update(double tasksPerSecond, std::chrono::milliseconds meanWait, bool ranOutOfTasks)
+{
+    if (ranOutOfTasks) {
+        m_previous.reset();
+        return m_workers;
+    }
+
+    if (m_intervalsHeld > 0) {
+        --m_intervalsHeld;
+        return m_workers;
+    }
+
+    // Nothing to compare with yet: this count is the reference, the next one is tried
+    if (!m_previous.has_value() || m_previous->numberOfWorkers == m_workers) {
+        m_previous = Sample{m_workers, tasksPerSecond};
+        step(meanWait > targetWait ? 1 : m_direction);
+        return m_workers;
+    }
+
+    const double change = (tasksPerSecond - m_previous->tasksPerSecond)
+                          / std::max(m_previous->tasksPerSecond, 1e-9);
+    const int lastStep = m_workers > m_previous->numberOfWorkers ? 1 : -1;
+
+    if (change > threshold) {
+        // Better: one more step the same way
+        m_previous = Sample{m_workers, tasksPerSecond};
+        step(lastStep);
+    }
+    else if (change < -threshold) {
+        // Worse: back to the count before, and the other way next time
+        m_workers = m_previous->numberOfWorkers;
+        m_direction = -lastStep;
+        hold();
+    }
+    else if (lastStep < 0) {
+        // The same with fewer: they're enough, and leave the rest of the cores
+        // alone. Compared with the best seen, so that small losses don't add up.
+        m_previous = Sample{m_workers, std::max(tasksPerSecond, m_previous->tasksPerSecond)};
+        step(-1);
+    }
+    else {
+        // The same with more: the fewer are enough
+        m_workers = m_previous->numberOfWorkers;
+        m_direction = -1;
+        hold();
+    }
+
+    return m_workers;
+}
+
+void WorkerTuner::step(int direction)
+{
+    if (m_workers + direction < m_minimum || m_workers + direction > m_maximum)
+        direction = -direction;
+
+    if (m_workers + direction < m_minimum || m_workers + direction > m_maximum) {
+        // A single count allowed, there's nothing to try
+        m_previous.reset();
+        return;
+    }
+
+    m_direction = direction;
+    m_workers += direction;
+}
+
+void WorkerTuner::hold()
+{
+    m_previous.reset();
+    m_intervalsHeld = intervalsToHold;
+}
+
+} // namespace Slicer
@@ -0,0 +1,75 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef WORKERTUNER_HPP
+#define WORKERTUNER_HPP
+
+#include <chrono>
+#include <optional>
+
+namespace Slicer {
+
+// Finds how many workers get the most tasks done, which depends on what
+// the tasks are: scans wait on decoding, vectors on the CPU, and past some
+// count they all wait on memory. It hill climbs: a worker more or less at a
+// time, kept going the same way while the throughput grows, and back to
+// the best count when it drops, where it holds for a while before trying
+// again. Not thread safe.
+class WorkerTuner {
+public:
+    WorkerTuner(int minimum, int maximum);
+
+    // Keeps the current count if it's within them
+    void setLimits(int minimum, int maximum);
+    int minimum() const { return m_minimum; }
+    int maximum() const { return m_maximum; }
+
+    int numberOfWorkers() const { return m_workers; }
+
+    // What the current count did over an interval: tasks finished per
+    // second, and how long they waited in the queues on average. While the
+    // workers ran out of tasks, the throughput is what was asked of them,
+    // not what they can do, and nothing is learned from it. Returns the
+    // count to use for the next interval.
+    int update(double tasksPerSecond, std::chrono::milliseconds meanWait, bool ranOutOfTasks);
+
+    // Changes smaller than this fraction of the throughput are noise
+    static constexpr double threshold = 0.05;
+    // Intervals spent at the best count before trying another one
+    static constexpr int intervalsToHold = 8;
+    // Tasks waiting longer than this make the next try one with more workers
+    static constexpr std::chrono::milliseconds targetWait{100};
+
+private:
+    struct Sample {
+        int numberOfWorkers;
+        double tasksPerSecond;
+    };
+
+    int m_minimum;
+    int m_maximum;
+    int m_workers;
+    int m_direction = -1;
+    int m_intervalsHeld = 0;
+    std::optional<Sample> m_previous;
+
+    void step(int direction);
+    void hold();
+};
+
+} // namespace Slicer
+
+#endif // WORKERTUNER_HPP
@@ -0,0 +1,680 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <batchdispatch.hpp>
+#include <batchjob.hpp>
+#include <batchjournal.hpp>
+#include <batchmanifest.hpp>
+#include <config.hpp>
+#include <mappedfile.hpp>
+#include <metrics.hpp>
+#include <tempfile.hpp>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <giomm/init.h>
+#include <gtkmm/main.h>
+#include <glibmm/error.h>
+#include <glibmm/fileutils.h>
+#include <glibmm/miscutils.h>
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+
+using namespace Slicer;
+
+static const char* const usage = R"(Usage: pdfslicer-cli [OPTION...] INPUT...
+       pdfslicer-cli [-j N] --manifest FILE
+       pdfslicer-cli --worker CMD... --manifest FILE
+       pdfslicer-cli [-j N] --info INPUT...
+
+Edits PDF files without a graphical session. Pages are 1-based and can be
+given as lists of ranges, like "1-3,7,10-". Operations run in the order given.
+An INPUT of "-" is read from the standard input.
+
+  -o, --output PATH        File to save the result to. With --each, the
+                           directory the results are saved to. "-" writes
+                           the result to the standard output, as it's made.
+      --remove PAGES       Remove pages
+      --rotate-right PAGES Rotate pages clockwise
+      --rotate-left PAGES  Rotate pages counterclockwise
+      --move PAGES:POS     Move a contiguous range of pages so that the
+                           first one ends up at position POS
+      --split N            Save the result in files of N pages each
+      --split-size MB      Save the result in files of about MB megabytes at most
+      --split-outline      Save the result in a file per top-level bookmark
+      --images FORMAT      Write every page of the result as an image instead:
+                           png, jpg or webp, named like the output with the
+                           page number appended
+      --dpi N              Resolution of the images (default: 150)
+      --quality N          Quality of JPEG and WebP images, from 0 to 100
+                           (default: 90)
+      --each               Process every input on its own instead of merging
+                           them into a single document
+      --low-memory         When merging, open the inputs one at a time while
+                           saving, instead of all at once
+      --no-mmap            Read the inputs as files instead of mapping them
+                           into memory
+      --profile NAME       How to write the output: default, smallest (object
+                           streams, recompressed), fastest (streams kept as
+                           they are) or web (linearized)
+      --resource-cleanup WHEN
+                           When to drop the resources no saved page uses:
+                           auto (when pages were left out), always or never
+      --downsample-images DPI
+                           Scale the images drawn at more than 1.5 times DPI
+                           down to DPI, compressed again as JPEG, for a
+                           smaller output
+      --password-file FILE Encrypt the output with AES-256, to be opened with
+                           the first line of FILE: "-" for the standard
+                           input, or /dev/fd/N for descriptor N. Encrypted
+                           inputs are saved decrypted otherwise
+      --password-env NAME  Like --password-file, with the password in the
+                           environment variable NAME. Passwords aren't taken
+                           on the command line, where other users can read them
+      --slow-pages N       When done, print the N pages that took the longest
+                           for poppler to read or render, by file and page,
+                           and why, to the standard error
+      --info               Print one JSON line per input with its number of
+                           pages, their sizes and rotations, and whether it's
+                           encrypted, read without opening the pages. No
+                           output or operations are needed
+      --estimate-size      Print the size the output would have, in bytes, or
+                           of each file it would be split into, estimated
+                           without writing anything
+      --manifest FILE      Run the jobs listed in FILE ("-" for the standard
+                           input), as JSON Lines or a JSON array, and print
+                           one JSON line per finished job
+      --journal FILE       Append every finished job to FILE, with hashes of
+                           what it wrote, and skip the jobs FILE has as
+                           finished, to carry on with a run that stopped
+      --worker CMD         With --manifest, send the jobs to a worker running
+                           CMD, like "ssh node1 pdfslicer-cli -j 8", with
+                           "--manifest -" appended. Repeat it for every
+                           worker; they must see the files at the same paths
+      --shard-size N       Jobs sent to a worker at a time (default: about
+                           four shards per worker)
+      --retries N          How often a job is sent again when the worker
+                           running it is lost (default: 2)
+  -j, --jobs N             Process up to N inputs at once (default: one per core)
+  -h, --help               Show this help
+      --version            Show the version
+)";
+
+struct Arguments {
+    std::vector<std::string> inputs;
+    std::string output;
+    std::string manifest;
+    std::vector<BatchOperation> operations;
+    unsigned int splitEvery = 0;
+    unsigned int splitMegabytes = 0;
+    bool splitAtOutline = false;
+    unsigned int jobs = 0;
+    bool each = false;
+    bool lowMemory = false;
+    PdfSaver::WriteProfile writeProfile = PdfSaver::WriteProfile::Default;
+    PdfSaver::ResourceCleanup resourceCleanup = PdfSaver::ResourceCleanup::WhenPagesLeftOut;
+    bool exportsImages = false;
+    ImageExport::Options imageExport;
+    std::optional<ImageDownsampling::Options> imageDownsampling;
+    std::optional<PdfSaver::Encryption> encryption;
+    // Read once every argument is parsed, so that a clash over the standard input is found first
+    std::string passwordFile;
+    bool estimateSize = false;
+    bool info = false;
+    unsigned int slowPages = 0;
+    std::string journal;
+    BatchDispatchOptions dispatch;
+};
+
+static unsigned int parseCount(const std::string& option, const std::string& value)
+{
+    if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos)
+        throw std::runtime_error("Option " + option + " expects a number, got '" + value + "'");
+
+    return static_cast<unsigned int>(std::stoul(value));
+}
+
+static BatchOperation parseMove(const std::string& value)
+{
+    const auto colon = value.rfind(':');
+
+    if (colon == std::string::npos)
+        throw std::runtime_error("Option --move expects PAGES:POS, got '" + value + "'");
+
+    return {BatchOperation::Type::Move,
+            value.substr(0, colon),
+            parseCount("--move", value.substr(colon + 1))};
+}
+
+// The first line of path, or of the standard input for "-"
+static std::string readPassword(const std::string& path)
+{
+    std::ifstream file;
+    std::istream& input = path == "-" ? std::cin : file;
+
+    if (path != "-") {
+        file.open(path);
+        if (!file)
+            throw std::runtime_error("Couldn't open the password file " + path);
+    }
+
+    std::string password;
+    if (!std::getline(input, password))
+        throw std::runtime_error("No password in " + (path == "-" ? std::string{"the standard input"} : path));
+
+    if (!password.empty() && password.back() == '\r')
+        password.pop_back();
+
+    return password;
+}
+
+static Arguments parseArguments(int argc, char* argv[])
+{
+    Arguments arguments;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string argument = argv[i];
+
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc)
+                throw std::runtime_error("Option " + argument + " expects a value");
+
+            return argv[++i];
+        };
+
+        if (argument == "-h" || argument == "--help") {
+            std::cout << usage;
+            std::exit(EXIT_SUCCESS);
+        }
+        else if (argument == "--version") {
+            std::cout << config::APPLICATION_NAME << " " << config::VERSION << "\n";
+            std::exit(EXIT_SUCCESS);
+        }
+        else if (argument == "-o" || argument == "--output")
+            arguments.output = value();
+        else if (argument == "--remove")
+            arguments.operations.push_back({BatchOperation::Type::Remove, value()});
+        else if (argument == "--rotate-right")
+            arguments.operations.push_back({BatchOperation::Type::RotateRight, value()});
+        else if (argument == "--rotate-left")
+            arguments.operations.push_back({BatchOperation::Type::RotateLeft, value()});
+        else if (argument == "--move")
+            arguments.operations.push_back(parseMove(value()));
+        else if (argument == "--split")
+            arguments.splitEvery = parseCount(argument, value());
+        else if (argument == "--split-size")
+            arguments.splitMegabytes = parseCount(argument, value());
+        else if (argument == "--split-outline")
+            arguments.splitAtOutline = true;
+        else if (argument == "--images") {
+            const std::string name = value();
+            const auto format = ImageExport::formatFromName(name);
+
+            if (!format.has_value())
+                throw std::runtime_error("Unknown image format: " + name);
+
+            arguments.exportsImages = true;
+            arguments.imageExport.format = format.value();
+        }
+        else if (argument == "--dpi")
+            arguments.imageExport.dpi = parseCount(argument, value());
+        else if (argument == "--quality")
+            arguments.imageExport.quality = static_cast<int>(parseCount(argument, value()));
+        else if (argument == "--each")
+            arguments.each = true;
+        else if (argument == "--low-memory")
+            arguments.lowMemory = true;
+        else if (argument == "--no-mmap")
+            MappedFile::setEnabled(false);
+        else if (argument == "--profile") {
+            const std::string name = value();
+            const auto profile = PdfSaver::writeProfileFromName(name);
+
+            if (!profile.has_value())
+                throw std::runtime_error("Unknown profile: " + name);
+
+            arguments.writeProfile = profile.value();
+        }
+        else if (argument == "--resource-cleanup") {
+            const std::string name = value();
+            const auto cleanup = PdfSaver::resourceCleanupFromName(name);
+
+            if (!cleanup.has_value())
+                throw std::runtime_error("Unknown resource cleanup: " + name);
+
+            arguments.resourceCleanup = cleanup.value();
+        }
+        else if (argument == "--downsample-images") {
+            ImageDownsampling::Options options;
+            options.dpi = std::max(1U, parseCount(argument, value()));
+            arguments.imageDownsampling = options;
+        }
+        else if (argument == "--password")
+            throw std::runtime_error("Passwords on the command line can be read by other users: "
+                                     "use --password-file or --password-env");
+        else if (argument == "--password-file")
+            arguments.passwordFile = value();
+        else if (argument == "--password-env") {
+            const std::string name = value();
+            const char* password = std::getenv(name.c_str());
+
+            if (password == nullptr)
+                throw std::runtime_error("The environment variable " + name + " isn't set");
+
+            arguments.encryption = PdfSaver::Encryption{password, password};
+        }
+        else if (argument == "--estimate-size")
+            arguments.estimateSize = true;
+        else if (argument == "--info")
+            arguments.info = true;
+        else if (argument == "--slow-pages")
+            arguments.slowPages = parseCount(argument, value());
+        else if (argument == "--manifest")
+            arguments.manifest = value();
+        else if (argument == "--journal")
+            arguments.journal = value();
+        else if (argument == "--worker")
+            arguments.dispatch.workers.push_back(value());
+        else if (argument == "--shard-size")
+            arguments.dispatch.shardSize = parseCount(argument, value());
+        else if (argument == "--retries")
+            arguments.dispatch.retries = parseCount(argument, value());
+        else if (argument == "-j" || argument == "--jobs")
+            arguments.jobs = parseCount(argument, value());
+        else if (argument.size() > 1 && argument.front() == '-')
+            throw std::runtime_error("Unknown option: " + argument);
+        else
+            arguments.inputs.push_back(argument);
+    }
+
+    if (!arguments.passwordFile.empty()) {
+        if (arguments.passwordFile == "-"
+            && (arguments.manifest == "-" || std::count(arguments.inputs.begin(), arguments.inputs.end(), "-") > 0))
+            throw std::runtime_error("The standard input can only be read once");
+
+        const std::string password = readPassword(arguments.passwordFile);
+        arguments.encryption = PdfSaver::Encryption{password, password};
+    }
+
+    if (!arguments.manifest.empty()) {
+        if (!arguments.inputs.empty() || !arguments.operations.empty() || !arguments.output.empty())
+            throw std::runtime_error("Inputs, outputs and operations go in the manifest when using --manifest");
+
+        if (arguments.estimateSize)
+            throw std::runtime_error("Sizes are estimated for the inputs given: --estimate-size can't be used with --manifest");
+
+        return arguments;
+    }
+
+    if (!arguments.dispatch.workers.empty())
+        throw std::runtime_error("Workers run the jobs of a manifest: use --worker with --manifest");
+
+    if (arguments.inputs.empty())
+        throw std::runtime_error("No input files given");
+
+    if (arguments.info) {
+        if (!arguments.operations.empty() || !arguments.output.empty())
+            throw std::runtime_error("Inputs are only read with --info: it takes no output or operations");
+
+        return arguments;
+    }
+
+    if (arguments.output.empty())
+        throw std::runtime_error("No output given (use --output)");
+
+    if (std::count(arguments.inputs.begin(), arguments.inputs.end(), "-") > 1)
+        throw std::runtime_error("The standard input can only be read once");
+
+    return arguments;
+}
+
+// Where a piped standard input was read into, removed before exiting
+static Glib::RefPtr<Gio::File> bufferedStandardInput;
+
+// A standard input redirected from a file is read where it is. A pipe is
+// read whole into a temp file first, since PDF files are read from the end.
+static Glib::RefPtr<Gio::File> standardInputFile()
+{
+    struct stat status {};
+    if (fstat(STDIN_FILENO, &status) == 0 && S_ISREG(status.st_mode))
+        return Gio::File::create_for_path("/dev/stdin");
+
+    bufferedStandardInput = TempFile::generate();
+    std::ofstream output{bufferedStandardInput->get_path(), std::ios::binary};
+    std::array<char, 64 * 1024> buffer{};
+
+    for (ssize_t count = 0; (count = read(STDIN_FILENO, buffer.data(), buffer.size())) != 0;) {
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0)
+            throw std::runtime_error("Couldn't read the standard input: " + std::string{std::strerror(errno)});
+
+        output.write(buffer.data(), count);
+    }
+
+    if (!output.flush())
+        throw std::runtime_error("Couldn't buffer the standard input in " + bufferedStandardInput->get_path());
+
+    return bufferedStandardInput;
+}
+
+static void removeBufferedStandardInput()
+{
+    try {
+        if (bufferedStandardInput)
+            bufferedStandardInput->remove();
+    }
+    catch (const Glib::Error&) {
+        // Left for TempFile::removeStaleFiles()
+    }
+}
+
+static Glib::RefPtr<Gio::File> inputFile(const std::string& input)
+{
+    return input == "-" ? standardInputFile() : Gio::File::create_for_commandline_arg(input);
+}
+
+static std::vector<BatchJob> createJobs(const Arguments& arguments)
+{
+    std::vector<BatchJob> jobs;
+    const std::optional<ImageExport::Options> imageExport = arguments.exportsImages
+                                                                ? std::optional{arguments.imageExport}
+                                                                : std::nullopt;
+    const PdfSaver::Mode saveMode = arguments.lowMemory ? PdfSaver::Mode::LowMemory
+                                                        : PdfSaver::Mode::Default;
+
+    if (!arguments.each) {
+        BatchJob job;
+        for (const std::string& input : arguments.inputs)
+            job.inputs.push_back(inputFile(input));
+        job.operations = arguments.operations;
+        if (arguments.output == "-")
+            job.outputDescriptor = STDOUT_FILENO;
+        else
+            job.output = Gio::File::create_for_commandline_arg(arguments.output);
+        job.splitEvery = arguments.splitEvery;
+        job.saveMode = saveMode;
+        job.writeProfile = arguments.writeProfile;
+        job.splitSizeInBytes = std::uint64_t{arguments.splitMegabytes} * 1024 * 1024;
+        job.splitAtOutline = arguments.splitAtOutline;
+        job.resourceCleanup = arguments.resourceCleanup;
+        job.imageExport = imageExport;
+        job.imageDownsampling = arguments.imageDownsampling;
+        job.encryption = arguments.encryption;
+        jobs.push_back(job);
+
+        return jobs;
+    }
+
+    if (!Glib::file_test(arguments.output, Glib::FILE_TEST_IS_DIR))
+        throw std::runtime_error("With --each, the output must be an existing directory");
+
+    for (const std::string& input : arguments.inputs) {
+        const auto file = inputFile(input);
+        const std::string outputPath = Glib::build_filename(arguments.output, input == "-" ? "stdin.pdf" : file->get_basename());
+
+        jobs.push_back(BatchJob{{file},
+                                arguments.operations,
+                                Gio::File::create_for_commandline_arg(outputPath),
+                                arguments.splitEvery,
+                                saveMode,
+                                arguments.writeProfile,
+                                std::uint64_t{arguments.splitMegabytes} * 1024 * 1024,
+                                arguments.splitAtOutline,
+                                arguments.resourceCleanup,
+                                imageExport,
+                                arguments.imageDownsampling,
+                                arguments.encryption});
+    }
+
+    return jobs;
+}
+
+// To tell which pages to send upstream, or to flatten before the next run
+static void printSlowestPages(const Arguments& arguments)
+{
+    if (arguments.slowPages == 0)
+        return;
+
+    const std::string slowestPages = Metrics::describeSlowestPages(arguments.slowPages);
+    std::clog << "pdfslicer-cli: slowest pages:\n" << (slowestPages.empty() ? "none read" : slowestPages) << "\n";
+}
+
+static int runManifest(const Arguments& arguments)
+{
+    std::vector<BatchManifestEntry> entries;
+
+    if (arguments.manifest == "-") {
+        entries = readBatchManifest(std::cin);
+    }
+    else {
+        std::ifstream manifest{arguments.manifest};
+
+        if (!manifest)
+            throw std::runtime_error("Couldn't open the manifest " + arguments.manifest);
+
+        entries = readBatchManifest(manifest);
+    }
+
+    std::optional<BatchJournal> journal;
+    if (!arguments.journal.empty())
+        journal.emplace(arguments.journal);
+
+    int exitCode = EXIT_SUCCESS;
+    std::vector<BatchJob> jobs;
+    std::vector<unsigned int> jobLines;
+
+    for (const BatchManifestEntry& entry : entries) {
+        if (entry.job.has_value() && journal.has_value()) {
+            if (auto outputs = journal->finishedOutputs(entry.job.value())) {
+                std::cout << batchJobResultToJson(entry.line, {true, {}, *outputs, {}, {}}, entry.job->writeProfile)
+                          << std::endl;
+                continue;
+            }
+        }
+
+        if (entry.job.has_value()) {
+            jobs.push_back(entry.job.value());
+            jobLines.push_back(entry.line);
+        }
+        else {
+            std::cout << batchJobResultToJson(entry.line, {false, entry.error, {}, {}, {}}) << std::endl;
+            exitCode = EXIT_FAILURE;
+        }
+    }
+
+    // Results are printed as soon as every job finishes, in whatever order that happens
+    auto onJobFinished = [&](std::size_t jobNumber, const BatchJobResult& result) {
+        if (journal.has_value() && result.succeeded)
+            journal->recordFinished(jobs.at(jobNumber), result.writtenFiles);
+
+        std::cout << batchJobResultToJson(jobLines.at(jobNumber), result, jobs.at(jobNumber).writeProfile)
+                  << std::endl;
+
+        if (!result.succeeded)
+            exitCode = EXIT_FAILURE;
+    };
+
+    if (arguments.dispatch.workers.empty())
+        runBatchJobs(jobs, arguments.jobs, onJobFinished);
+    else
+        dispatchBatchJobs(jobs, arguments.dispatch, onJobFinished);
+
+    return exitCode;
+}
+
+// One line per file a job would write: its size, and the output with the
+// number of the part when split
+static int printEstimates(const std::vector<BatchJob>& jobs)
+{
+    int exitCode = EXIT_SUCCESS;
+
+    for (const BatchJob& job : jobs) {
+        try {
+            const std::vector<std::uint64_t> sizes = estimateBatchJob(job);
+
+            for (std::size_t i = 0; i < sizes.size(); ++i) {
+                std::cout << sizes.at(i) << "\t" << (job.output ? job.output->get_parse_name() : "-");
+                if (sizes.size() > 1)
+                    std::cout << ", part " << i + 1;
+                std::cout << "\n";
+            }
+        }
+        catch (const Glib::Error& e) {
+            std::cerr << "pdfslicer-cli: " << job.inputs.front()->get_parse_name() << ": " << e.what() << "\n";
+            exitCode = EXIT_FAILURE;
+        }
+        catch (const std::exception& e) {
+            std::cerr << "pdfslicer-cli: " << job.inputs.front()->get_parse_name() << ": " << e.what() << "\n";
+            exitCode = EXIT_FAILURE;
+        }
+    }
+
+    return exitCode;
+}
+
+static int printInspections(const Arguments& arguments)
+{
+    std::vector<Glib::RefPtr<Gio::File>> files;
+    for (const std::string& input : arguments.inputs)
+        files.push_back(inputFile(input));
+
+    const std::vector<Inspection::Result> results = Inspection::inspectAll(files, arguments.jobs);
+    int exitCode = EXIT_SUCCESS;
+
+    for (std::size_t i = 0; i < files.size(); ++i) {
+        std::cout << inspectionToJson(files[i], results[i]) << "\n";
+
+        if (!results[i].info.has_value())
+            exitCode = EXIT_FAILURE;
+    }
+
+    return exitCode;
+}
+
+int main(int argc, char* argv[])
+{
+    // Only what the backend needs: no display, no widgets. The wrappers
+    // are for the Gdk::Pixbuf of exported images.
+    Gio::init();
+    Gtk::Main::init_gtkmm_internals();
+    config::createSlicerDirsIfNotExistent();
+
+    // Runs alongside the jobs; every return below waits for it
+    auto staleFilesRemoval = std::async(std::launch::async, &TempFile::removeStaleFiles);
+
+    // And so does the removal of a buffered standard input
+    struct BufferedInputRemoval {
+        ~BufferedInputRemoval() { removeBufferedStandardInput(); }
+    } bufferedInputRemoval;
+
+    Arguments arguments;
+    std::vector<BatchJob> jobs;
+
+    try {
+        arguments = parseArguments(argc, argv);
+
+        if (!arguments.manifest.empty()) {
+            const int exitCode = runManifest(arguments);
+            printSlowestPages(arguments);
+
+            return exitCode;
+        }
+
+        if (arguments.info)
+            return printInspections(arguments);
+
+        jobs = createJobs(arguments);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "pdfslicer-cli: " << e.what() << "\n"
+                  << "Try 'pdfslicer-cli --help' for more information.\n";
+        return EXIT_FAILURE;
+    }
+
+    if (arguments.estimateSize)
+        return printEstimates(jobs);
+
+    // When the next program in the pipe stops reading, writing fails with
+    // an error to report instead of the signal ending the process
+    if (arguments.output == "-")
+        std::signal(SIGPIPE, SIG_IGN);
+
+    std::optional<BatchJournal> journal;
+    std::vector<BatchJobResult> results(jobs.size(), BatchJobResult{false, {}, {}, {}, {}});
+    std::vector<BatchJob> jobsToRun;
+    std::vector<std::size_t> jobNumbers;
+
+    try {
+        if (!arguments.journal.empty())
+            journal.emplace(arguments.journal);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "pdfslicer-cli: " << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    for (std::size_t i = 0; i < jobs.size(); ++i) {
+        if (auto outputs = journal.has_value() ? journal->finishedOutputs(jobs[i]) : std::nullopt) {
+            results[i] = {true, {}, *outputs, {}, {}};
+            continue;
+        }
+
+        jobsToRun.push_back(jobs[i]);
+        jobNumbers.push_back(i);
+    }
+
+    runBatchJobs(jobsToRun, arguments.jobs, [&](std::size_t jobNumber, const BatchJobResult& result) {
+        if (journal.has_value() && result.succeeded)
+            journal->recordFinished(jobsToRun.at(jobNumber), result.writtenFiles);
+
+        results.at(jobNumbers.at(jobNumber)) = result;
+    });
+
+    int exitCode = EXIT_SUCCESS;
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        if (results[i].succeeded) {
+            for (const auto& file : results[i].writtenFiles)
+                std::cout << file->get_path() << "\n";
+
+            if (jobs[i].imageExport.has_value())
+                std::clog << "pdfslicer-cli: written as " << ImageExport::formatName(jobs[i].imageExport->format)
+                          << " images in " << results[i].writeDuration.count() << " s\n";
+            else
+                std::clog << "pdfslicer-cli: written with the "
+                          << PdfSaver::writeProfileName(jobs[i].writeProfile) << " profile in "
+                          << results[i].writeDuration.count() << " s\n";
+        }
+        else {
+            std::cerr << "pdfslicer-cli: " << jobs[i].inputs.front()->get_parse_name()
+                      << ": " << results[i].error << "\n";
+            exitCode = EXIT_FAILURE;
+        }
+    }
+
+    printSlowestPages(arguments);
+
+    return exitCode;
+}
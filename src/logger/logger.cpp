@@ -16,27 +16,110 @@
 
 #include "logger.hpp"
 #include <glibmm/miscutils.h>
+#include <glib/gstdio.h>
+#include <spdlog/async.h>
+#include <spdlog/sinks/base_sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/sinks/rotating_file_sink.h>
 #include <config.hpp>
 #include <iostream>
+#include <mutex>
+#include <optional>
 
 namespace Slicer::Logger {
 
+namespace {
+    // Opens the log file the first time there is something to write, which
+    // happens on the logger's own thread, so startup never waits for the disk
+    class LazyFileSink : public spdlog::sinks::base_sink<std::mutex> {
+    public:
+        LazyFileSink(std::size_t maxSize, std::size_t maxFiles)
+            : m_maxSize{maxSize}
+            , m_maxFiles{maxFiles}
+        {
+        }
+
+    protected:
+        void sink_it_(const spdlog::details::log_msg& msg) override
+        {
+            if (open())
+                m_sink->log(msg);
+        }
+
+        void flush_() override
+        {
+            if (m_sink != nullptr)
+                m_sink->flush();
+        }
+
+    private:
+        std::size_t m_maxSize;
+        std::size_t m_maxFiles;
+        std::unique_ptr<spdlog::sinks::rotating_file_sink_st> m_sink;
+        bool m_hasFailed = false;
+
+        bool open()
+        {
+            if (m_sink != nullptr || m_hasFailed)
+                return !m_hasFailed;
+
+            try {
+                // Startup creates it in the background, maybe not in time
+                g_mkdir_with_parents(config::getConfigDirPath().c_str(), 0700);
+                m_sink = std::make_unique<spdlog::sinks::rotating_file_sink_st>(getPathToLogFile(),
+                                                                                m_maxSize,
+                                                                                m_maxFiles);
+            }
+            catch (const spdlog::spdlog_ex& e) {
+                // Only the console gets messages from now on
+                m_hasFailed = true;
+                std::cerr << "Couldn't open log file with error:" << '\n'
+                          << e.what() << std::endl;
+            }
+
+            return !m_hasFailed;
+        }
+    };
+}
+
+static std::optional<spdlog::level::level_enum> levelFromName(const std::string& name)
+{
+    // spdlog maps unknown names to "off", which would silently hide everything
+    for (int level = spdlog::level::trace; level <= spdlog::level::off; ++level) {
+        const auto levelEnum = static_cast<spdlog::level::level_enum>(level);
+
+        if (name == spdlog::level::to_c_str(levelEnum))
+            return levelEnum;
+    }
+
+    return std::nullopt;
+}
+
 void setupLogger()
 {
     static const int logFileSize = 1024 * 1024 * 2; // 2 MB
     static const int numberOfLogFiles = 3;
+    // Messages waiting for the writer thread. When they come faster than
+    // it writes, the oldest are dropped: a thread that logs never waits for the disk.
+    static const std::size_t queueSize = 8192;
 
     try {
+        spdlog::init_thread_pool(queueSize, 1);
+
         auto consoleSink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
-        auto fileSink = std::make_shared<spdlog::sinks::rotating_file_sink_mt>(getPathToLogFile(),
-                                                                               logFileSize,
-                                                                               numberOfLogFiles);
-        auto logger = std::make_shared<spdlog::logger>("default",
-                                                       spdlog::sinks_init_list{consoleSink, fileSink});
+        auto fileSink = std::make_shared<LazyFileSink>(logFileSize, numberOfLogFiles);
+        auto logger = std::make_shared<spdlog::async_logger>("default",
+                                                             spdlog::sinks_init_list{consoleSink, fileSink},
+                                                             spdlog::thread_pool(),
+                                                             spdlog::async_overflow_policy::overrun_oldest);
 
+        // Errors get to the file right away, in case a crash comes next
+        logger->flush_on(spdlog::level::err);
         spdlog::register_logger(logger);
+
+        // SLICER_LOG_LEVEL=debug, for instance, lets through messages that are off by default
+        if (const std::string levelName = Glib::getenv("SLICER_LOG_LEVEL"); !levelName.empty() && !setLevel(levelName))
+            logWarning("Unknown log level: " + levelName);
     }
     catch (const spdlog::spdlog_ex& e) {
         std::cerr << "Couldn't initialize logger with error:" << '\n'
@@ -44,11 +127,36 @@ void setupLogger()
     }
 }
 
+void shutdownLogger()
+{
+    // Writes whatever is still waiting in the queue
+    spdlog::shutdown();
+}
+
+bool setLevel(const std::string& levelName)
+{
+    const std::optional<spdlog::level::level_enum> level = levelFromName(levelName);
+    auto logger = spdlog::get("default");
+
+    if (!level.has_value() || logger == nullptr)
+        return false;
+
+    logger->set_level(*level);
+
+    return true;
+}
+
 std::string getPathToLogFile()
 {
     return Glib::build_filename(config::getConfigDirPath(), "log.txt");
 }
 
+void logDebug(const std::string& str)
+{
+    if (auto logger = spdlog::get("default"); logger != nullptr)
+        logger->debug(str);
+}
+
 void logInfo(const std::string& str)
 {
     if (auto logger = spdlog::get("default"); logger != nullptr)
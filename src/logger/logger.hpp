@@ -21,7 +21,14 @@
 
 namespace Slicer::Logger {
 
+// Logging goes through a queue to a thread of its own, so it's fine on hot paths
 void setupLogger();
+void shutdownLogger();
+// One of spdlog's level names: trace, debug, info, warning, error, critical or off.
+// Returns false for any other name.
+bool setLevel(const std::string& levelName);
+
+void logDebug(const std::string& str);
 void logInfo(const std::string& str);
 void logWarning(const std::string& str);
 void logError(const std::string& str);
@@ -17,20 +17,57 @@
 #include "application/application.hpp"
 #include <logger.hpp>
 #include <config.hpp>
+#include <tempfile.hpp>
+#include <trace.hpp>
+#include <glibmm/miscutils.h>
 #include <gtkmm/main.h>
+#include <future>
 
 using namespace Slicer;
 
 int main(int num_args, char* args_array[])
 {
-    config::setupLocalization();
-    config::createSlicerDirsIfNotExistent();
-    Logger::setupLogger();
+    const Trace::Clock::time_point launchTime = Trace::Clock::now();
+
+    // SLICER_TRACE=path/to/trace.json records timing spans for the session,
+    // startup included
+    const std::string tracePath = Glib::getenv("SLICER_TRACE");
+    if (!tracePath.empty()) {
+        Trace::setEnabled(true);
+        Trace::setThreadName("Main");
+    }
+
+    {
+        const Trace::Span span{"Startup::localization"};
+        config::setupLocalization();
+    }
+
+    {
+        // The log file itself is opened by the logger's thread
+        const Trace::Span span{"Startup::logger"};
+        Logger::setupLogger();
+    }
 
     Logger::logInfo("Welcome to PDF Slicer");
     Logger::logInfo("Logging to file: " + Logger::getPathToLogFile());
 
-    auto app = Application::create();
+    if (!tracePath.empty())
+        Logger::logInfo("Tracing to file: " + tracePath);
+
+    // Nothing on the way to the first frame needs these dirs to exist: whatever
+    // writes into one creates it if needed. Waited for only on exit.
+    auto staleFilesRemoval = std::async(std::launch::async, []() {
+        config::createSlicerDirsIfNotExistent();
+        TempFile::removeStaleFiles();
+    });
+
+    auto app = Application::create(launchTime);
+    const int status = app->run(num_args, args_array);
+
+    if (!tracePath.empty() && !Trace::exportChromeTrace(tracePath))
+        Logger::logError("Couldn't write trace to file: " + tracePath);
+
+    Logger::shutdownLogger();
 
-    return app->run(num_args, args_array);
+    return status;
 }
@@ -0,0 +1,101 @@
+// PDF Slicer
+// Copyright (C) 2019 Julián Unrrein
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <config.hpp>
+#include <cpuresources.hpp>
+#include <renderdaemon.hpp>
+#include <renderprocesspool.hpp>
+#include <giomm/init.h>
+#include <glibmm/fileutils.h>
+#include <glibmm/miscutils.h>
+#include <gtkmm/main.h>
+#include <algorithm>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+static Slicer::RenderDaemon* runningDaemon = nullptr;
+
+static void stopDaemon(int /*signal*/)
+{
+    if (runningDaemon != nullptr)
+        runningDaemon->stop();
+}
+
+// Serves every instance on the host through the socket, see RenderDaemon
+static int runDaemon(const std::string& socketPath)
+{
+    try {
+        Slicer::RenderDaemon::Options options;
+        options.socketPath = socketPath;
+        options.storePath = Glib::build_filename(Slicer::config::getCacheDirPath(), "render-daemon");
+        options.helperPath = Glib::file_read_link("/proc/self/exe");
+        options.numberOfHelpers = Slicer::CpuResources::availableCores();
+
+        Slicer::RenderDaemon daemon{options};
+        runningDaemon = &daemon;
+        std::signal(SIGTERM, stopDaemon);
+        std::signal(SIGINT, stopDaemon);
+
+        daemon.run();
+        runningDaemon = nullptr;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "pdfslicer-render-helper: " << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+    catch (const Glib::Error& e) {
+        std::cerr << "pdfslicer-render-helper: " << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+// Started by PDF Slicer for every render process, see RenderProcessPool.
+// Takes the socket it's served through, which it inherits.
+// Or, with --daemon and the path of a socket, serves every instance that
+// has it in its render-daemon setting.
+int main(int argc, char* argv[])
+{
+    const bool isDaemon = argc == 3 && std::string{argv[1]} == "--daemon";
+
+    if (argc != 2 && !isDaemon) {
+        std::cerr << "pdfslicer-render-helper: started by PDF Slicer to render pages, or run as\n"
+                  << "    pdfslicer-render-helper --daemon <socket path>\n"
+                  << "to render them for every instance on this host\n";
+        return EXIT_FAILURE;
+    }
+
+    // The same as the command line needs: the wrappers, for the Gdk::Pixbuf of renders
+    Gio::init();
+    Gtk::Main::init_gtkmm_internals();
+
+    if (isDaemon)
+        return runDaemon(argv[2]);
+
+    int socket = -1;
+    try {
+        socket = std::stoi(argv[1]);
+    }
+    catch (const std::exception&) {
+        std::cerr << "pdfslicer-render-helper: not a socket: " << argv[1] << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return Slicer::RenderProcessPool::serve(socket);
+}
@@ -0,0 +1,15 @@
+#ifndef SLICER_ALLOCATIONCOUNTER_HPP
+#define SLICER_ALLOCATIONCOUNTER_HPP
+
+#include <cstdint>
+
+// Every operator new of the test executable goes through a counter, for
+// the performance tests to tell when a scenario starts allocating more
+namespace AllocationCounter {
+
+// Since the executable started, on every thread
+std::uint64_t count();
+
+} // namespace AllocationCounter
+
+#endif // SLICER_ALLOCATIONCOUNTER_HPP
@@ -0,0 +1,67 @@
+#include <catch.hpp>
+#include <batchdispatch.hpp>
+#include <algorithm>
+
+using namespace Slicer;
+
+// Stands in for pdfslicer-cli on a node: succeeds every job it reads
+static const std::string fakeWorker = R"(sh -c 'n=0; while read job; do n=$((n+1)); )"
+                                      R"(echo "{\"line\": $n, \"status\": \"ok\", \"seconds\": 0, \"outputs\": []}"; done' fake)";
+
+static std::vector<BatchJob> createJobs(unsigned int numberOfJobs)
+{
+    std::vector<BatchJob> jobs;
+
+    for (unsigned int i = 0; i < numberOfJobs; ++i) {
+        BatchJob job;
+        job.inputs.push_back(Gio::File::create_for_path("/in-" + std::to_string(i) + ".pdf"));
+        job.output = Gio::File::create_for_path("/out-" + std::to_string(i) + ".pdf");
+        jobs.push_back(job);
+    }
+
+    return jobs;
+}
+
+SCENARIO("Dispatching batch jobs to workers")
+{
+    GIVEN("Jobs, a worker that runs them, and one that's gone")
+    {
+        const std::vector<BatchJob> jobs = createJobs(20);
+        BatchDispatchOptions options;
+        options.workers = {fakeWorker, "false"};
+        options.shardSize = 3;
+
+        WHEN("The jobs are dispatched")
+        {
+            std::vector<unsigned int> numberOfCalls(jobs.size(), 0);
+            const std::vector<BatchJobResult> results = dispatchBatchJobs(jobs, options, [&](std::size_t jobNumber, const BatchJobResult&) {
+                ++numberOfCalls.at(jobNumber);
+            });
+
+            THEN("Every job should succeed, once, on the worker that's there")
+            {
+                REQUIRE(std::all_of(results.begin(), results.end(), [](const BatchJobResult& result) { return result.succeeded; }));
+                REQUIRE(std::all_of(numberOfCalls.begin(), numberOfCalls.end(), [](unsigned int calls) { return calls == 1; }));
+            }
+        }
+    }
+
+    GIVEN("Jobs, and only workers that are gone")
+    {
+        const std::vector<BatchJob> jobs = createJobs(5);
+        BatchDispatchOptions options;
+        options.workers = {"false", "/nonexistent/pdfslicer-cli"};
+
+        WHEN("The jobs are dispatched")
+        {
+            const std::vector<BatchJobResult> results = dispatchBatchJobs(jobs, options);
+
+            THEN("Every job should fail, saying why")
+            {
+                REQUIRE(results.size() == 5);
+                REQUIRE(std::none_of(results.begin(), results.end(), [](const BatchJobResult& result) { return result.succeeded; }));
+                REQUIRE(std::none_of(results.begin(), results.end(), [](const BatchJobResult& result) { return result.error.empty(); }));
+            }
+        }
+    }
+}
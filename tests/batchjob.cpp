@@ -0,0 +1,184 @@
+#include "common.hpp"
+#include <catch.hpp>
+#include <batchjob.hpp>
+#include <document.hpp>
+#include <tempfile.hpp>
+
+using namespace Slicer;
+
+SCENARIO("Parsing page ranges for batch operations")
+{
+    GIVEN("A document with 15 pages")
+    {
+        const unsigned int numberOfPages = 15;
+
+        THEN("Single pages and ranges are turned into sorted 0-based indexes")
+        REQUIRE(parsePageRanges("7, 1-3,2", numberOfPages) == std::vector<unsigned int>{0, 1, 2, 6});
+
+        THEN("An open range goes until the last page")
+        REQUIRE(parsePageRanges("13-", numberOfPages) == std::vector<unsigned int>{12, 13, 14});
+
+        THEN("Pages out of the document are rejected")
+        {
+            REQUIRE_THROWS_AS(parsePageRanges("0", numberOfPages), std::runtime_error);
+            REQUIRE_THROWS_AS(parsePageRanges("10-16", numberOfPages), std::runtime_error);
+        }
+
+        THEN("Malformed ranges are rejected")
+        {
+            REQUIRE_THROWS_AS(parsePageRanges("5-3", numberOfPages), std::runtime_error);
+            REQUIRE_THROWS_AS(parsePageRanges("a", numberOfPages), std::runtime_error);
+            REQUIRE_THROWS_AS(parsePageRanges("", numberOfPages), std::runtime_error);
+        }
+    }
+}
+
+SCENARIO("Running batch jobs without a user interface")
+{
+    GIVEN("A job that removes and moves pages of a 15 pages document")
+    {
+        BatchJob job;
+        job.inputs = {Gio::File::create_for_path(multipage1Path)};
+        job.operations = {{BatchOperation::Type::Remove, "1-5"},
+                          {BatchOperation::Type::Move, "9-10", 1},
+                          {BatchOperation::Type::RotateRight, "1"}};
+        job.output = TempFile::generate();
+
+        WHEN("The job is run")
+        {
+            const auto writtenFiles = runBatchJob(job);
+
+            THEN("A single file with the remaining pages should be written")
+            {
+                REQUIRE(writtenFiles.size() == 1);
+
+                Document result{writtenFiles.front()};
+                REQUIRE(result.numberOfPages() == 10);
+            }
+        }
+
+        WHEN("The job is run splitting the result every 4 pages")
+        {
+            job.splitEvery = 4;
+            const auto writtenFiles = runBatchJob(job);
+
+            THEN("Three files should be written, the last one with the remaining pages")
+            {
+                REQUIRE(writtenFiles.size() == 3);
+                REQUIRE(Document{writtenFiles.at(0)}.numberOfPages() == 4);
+                REQUIRE(Document{writtenFiles.at(2)}.numberOfPages() == 2);
+            }
+        }
+
+        WHEN("The job is run splitting the result in files of a single byte")
+        {
+            job.splitSizeInBytes = 1;
+            const auto writtenFiles = runBatchJob(job);
+
+            THEN("Every page should get a file of its own, as none fits")
+            {
+                REQUIRE(writtenFiles.size() == 10);
+                REQUIRE(Document{writtenFiles.at(9)}.numberOfPages() == 1);
+            }
+        }
+
+        WHEN("The job is run splitting the result in files of 100 MB")
+        {
+            job.splitSizeInBytes = 100 * 1024 * 1024;
+            const auto writtenFiles = runBatchJob(job);
+
+            THEN("A single file with every page should be written")
+            {
+                REQUIRE(writtenFiles.size() == 1);
+                REQUIRE(Document{writtenFiles.front()}.numberOfPages() == 10);
+            }
+        }
+
+        WHEN("The sizes of the files are estimated, splitting the result every 4 pages")
+        {
+            job.splitEvery = 4;
+            const std::vector<std::uint64_t> sizes = estimateBatchJob(job);
+
+            THEN("There should be a size for each of the three files, and nothing written")
+            {
+                REQUIRE(sizes.size() == 3);
+                REQUIRE(sizes.at(0) > 0);
+                REQUIRE(!job.output->query_exists());
+            }
+        }
+
+        WHEN("The job is run splitting the result at the outline of a file without one")
+        {
+            job.splitAtOutline = true;
+            const auto writtenFiles = runBatchJob(job);
+
+            THEN("A single part with every page should be written")
+            {
+                REQUIRE(writtenFiles.size() == 1);
+                REQUIRE(Document{writtenFiles.front()}.numberOfPages() == 10);
+            }
+        }
+    }
+
+    GIVEN("A job that merges three documents")
+    {
+        BatchJob job;
+        job.inputs = {Gio::File::create_for_path(multipage1Path),
+                      Gio::File::create_for_path(multipage2Path),
+                      Gio::File::create_for_path(multipage3Path)};
+        job.operations = {{BatchOperation::Type::Move, "16-20", 1}};
+        job.output = TempFile::generate();
+
+        const unsigned int expectedPages = Document{job.inputs}.numberOfPages();
+
+        WHEN("The job is saved in low memory mode")
+        {
+            job.saveMode = PdfSaver::Mode::LowMemory;
+            const auto writtenFiles = runBatchJob(job);
+
+            THEN("The result should have the pages of every document")
+            REQUIRE(Document{writtenFiles.front()}.numberOfPages() == expectedPages);
+        }
+
+        WHEN("Every page of the second document is removed before saving")
+        {
+            job.operations = {{BatchOperation::Type::Remove, "16-20"}};
+            const auto writtenFiles = runBatchJob(job);
+
+            THEN("The result should have the pages of the other documents")
+            REQUIRE(Document{writtenFiles.front()}.numberOfPages() == expectedPages - 5);
+        }
+    }
+
+    GIVEN("Several independent jobs, one of them invalid")
+    {
+        std::vector<BatchJob> jobs;
+        for (const std::string& path : {multipage1Path, multipage2Path})
+            jobs.push_back(BatchJob{{Gio::File::create_for_path(path)},
+                                    {{BatchOperation::Type::RotateLeft, "1-"}},
+                                    TempFile::generate(),
+                                    0,
+                                    PdfSaver::Mode::Default,
+                                    PdfSaver::WriteProfile::Default});
+        jobs.push_back(BatchJob{{Gio::File::create_for_path(multipage3Path)},
+                                {{BatchOperation::Type::Remove, "1000"}},
+                                TempFile::generate(),
+                                0,
+                                PdfSaver::Mode::Default,
+                                PdfSaver::WriteProfile::Default});
+
+        WHEN("The jobs are run in parallel")
+        {
+            const auto results = runBatchJobs(jobs, 2);
+
+            THEN("The valid jobs should succeed and the invalid one should report its error")
+            {
+                REQUIRE(results.size() == 3);
+                REQUIRE(results.at(0).succeeded);
+                REQUIRE(results.at(1).succeeded);
+                REQUIRE(!results.at(2).succeeded);
+                REQUIRE(!results.at(2).error.empty());
+            }
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#include "common.hpp"
+#include <catch.hpp>
+#include <batchjournal.hpp>
+#include <tempfile.hpp>
+#include <fstream>
+
+using namespace Slicer;
+
+static void writeFile(const Glib::RefPtr<Gio::File>& file, const std::string& contents)
+{
+    std::ofstream{file->get_path(), std::ios::binary} << contents;
+}
+
+SCENARIO("Skipping the batch jobs that finished in an earlier run")
+{
+    GIVEN("A job that wrote a file, recorded in a journal")
+    {
+        const Glib::RefPtr<Gio::File> journalFile = TempFile::generate();
+
+        BatchJob job;
+        job.inputs = {Gio::File::create_for_path(multipage1Path)};
+        job.operations = {{BatchOperation::Type::Remove, "1-5"}};
+        job.output = TempFile::generate();
+        writeFile(job.output, "The saved result");
+
+        BatchJournal{journalFile->get_path()}.recordFinished(job, {job.output});
+
+        WHEN("The journal is read again by a later run")
+        {
+            const BatchJournal journal{journalFile->get_path()};
+
+            THEN("The job should be found finished, with its output")
+            {
+                const auto outputs = journal.finishedOutputs(job);
+                REQUIRE(outputs.has_value());
+                REQUIRE(outputs->size() == 1);
+                REQUIRE(outputs->front()->get_path() == job.output->get_path());
+            }
+
+            THEN("A job with other operations should not be found")
+            {
+                BatchJob otherJob = job;
+                otherJob.operations = {{BatchOperation::Type::Remove, "1-6"}};
+                REQUIRE(!journal.finishedOutputs(otherJob).has_value());
+            }
+        }
+
+        WHEN("The output is changed after the job finished")
+        {
+            writeFile(job.output, "Something else, of another size");
+
+            THEN("The job should be done again")
+            REQUIRE(!BatchJournal{journalFile->get_path()}.finishedOutputs(job).has_value());
+        }
+
+        WHEN("A run was killed while writing the line of another job")
+        {
+            {
+                std::ofstream journal{journalFile->get_path(), std::ios::app};
+                journal << "0123abc\t45";
+            }
+
+            BatchJob otherJob = job;
+            otherJob.output = TempFile::generate();
+            writeFile(otherJob.output, "Another result");
+
+            BatchJournal{journalFile->get_path()}.recordFinished(otherJob, {otherJob.output});
+            const BatchJournal journal{journalFile->get_path()};
+
+            THEN("Both jobs should still be found, and the cut line skipped")
+            {
+                REQUIRE(journal.finishedOutputs(job).has_value());
+                REQUIRE(journal.finishedOutputs(otherJob).has_value());
+                REQUIRE(journal.numberOfFinishedJobs() == 2);
+            }
+        }
+    }
+}
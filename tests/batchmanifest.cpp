@@ -0,0 +1,172 @@
+#include <catch.hpp>
+#include <batchmanifest.hpp>
+#include <sstream>
+#include <stdexcept>
+
+using namespace Slicer;
+
+SCENARIO("Reading job manifests")
+{
+    GIVEN("A JSON Lines manifest with a bad line between two jobs")
+    {
+        std::istringstream manifest{
+            R"({"inputs": ["a.pdf", "b.pdf"], "output": "merged.pdf", "operations": [{"op": "move", "pages": "3-4", "to": 1}]})"
+            "\n\n"
+            "{\"input\": \"c.pdf\", \"output\": \n"
+            R"({"input": "d.pdf", "output": "d-split.pdf", "split": 5, "operations": [{"op": "rotate-left", "pages": "1-"}]})"
+            "\n"};
+
+        WHEN("The manifest is read")
+        {
+            const std::vector<BatchManifestEntry> entries = readBatchManifest(manifest);
+
+            THEN("Every non blank line should give an entry, with its line number")
+            {
+                REQUIRE(entries.size() == 3);
+                REQUIRE(entries.at(0).line == 1);
+                REQUIRE(entries.at(1).line == 3);
+                REQUIRE(entries.at(2).line == 4);
+            }
+
+            THEN("The good lines should be read as jobs")
+            {
+                REQUIRE(entries.at(0).job.has_value());
+                REQUIRE(entries.at(0).job->inputs.size() == 2);
+                REQUIRE(entries.at(0).job->operations.at(0).type == BatchOperation::Type::Move);
+                REQUIRE(entries.at(0).job->operations.at(0).destination == 1);
+
+                REQUIRE(entries.at(2).job.has_value());
+                REQUIRE(entries.at(2).job->splitEvery == 5);
+                REQUIRE(entries.at(2).job->output->get_basename() == "d-split.pdf");
+            }
+
+            THEN("The bad line should report an error")
+            {
+                REQUIRE(!entries.at(1).job.has_value());
+                REQUIRE(!entries.at(1).error.empty());
+            }
+        }
+    }
+
+    GIVEN("A manifest with an array of jobs")
+    {
+        std::istringstream manifest{"[\n"
+                                    "  {\"input\": \"a.pdf\", \"output\": \"a-out.pdf\"},\n"
+                                    "  {\"input\": \"b.pdf\", \"output\": \"b-out.pdf\", \"operations\": [{\"op\": \"fly\", \"pages\": \"1\"}]}\n"
+                                    "]\n"};
+
+        WHEN("The manifest is read")
+        {
+            const std::vector<BatchManifestEntry> entries = readBatchManifest(manifest);
+
+            THEN("Every element should give an entry, and the unknown operation an error")
+            {
+                REQUIRE(entries.size() == 2);
+                REQUIRE(entries.at(0).job.has_value());
+                REQUIRE(entries.at(1).line == 3);
+                REQUIRE(!entries.at(1).job.has_value());
+            }
+        }
+    }
+
+    GIVEN("A manifest with jobs writing images")
+    {
+        std::istringstream manifest{
+            R"({"input": "a.pdf", "output": "a-pages", "images": "jpeg", "dpi": 300, "quality": 75})"
+            "\n"
+            R"({"input": "b.pdf", "output": "b-pages", "images": "bmp"})"
+            "\n"};
+
+        WHEN("The manifest is read")
+        {
+            const std::vector<BatchManifestEntry> entries = readBatchManifest(manifest);
+
+            THEN("The image options should be read")
+            {
+                REQUIRE(entries.at(0).job.has_value());
+                REQUIRE(entries.at(0).job->imageExport.has_value());
+                REQUIRE(entries.at(0).job->imageExport->format == ImageExport::Format::Jpeg);
+                REQUIRE(entries.at(0).job->imageExport->dpi == 300);
+                REQUIRE(entries.at(0).job->imageExport->quality == 75);
+            }
+
+            THEN("An unknown format should report an error")
+            {
+                REQUIRE(!entries.at(1).job.has_value());
+                REQUIRE(!entries.at(1).error.empty());
+            }
+        }
+    }
+
+    GIVEN("Jobs with values a parser could choke on")
+    {
+        const std::string deeplyNested = R"({"input": "a.pdf", "output": "b.pdf", "extra": )"
+                                         + std::string(100000, '[') + std::string(100000, ']') + "}";
+
+        THEN("Values nested too deeply should be an error, not an overflow")
+        REQUIRE_THROWS_AS(parseBatchJob(deeplyNested), std::runtime_error);
+
+        THEN("Counts that aren't whole numbers an unsigned fits should be errors")
+        {
+            REQUIRE_THROWS_AS(parseBatchJob(R"({"input": "a.pdf", "output": "b.pdf", "split": -1})"), std::runtime_error);
+            REQUIRE_THROWS_AS(parseBatchJob(R"({"input": "a.pdf", "output": "b.pdf", "split": 2.5})"), std::runtime_error);
+            REQUIRE_THROWS_AS(parseBatchJob(R"({"input": "a.pdf", "output": "b.pdf", "split": 1e30})"), std::runtime_error);
+        }
+    }
+
+    GIVEN("A job with every option")
+    {
+        const BatchJob job = parseBatchJob(
+            R"({"inputs": ["/a b.pdf", "/c\"d.pdf"], "output": "/out.pdf", "split-size": 20, "low-memory": true,)"
+            R"( "profile": "smallest", "resource-cleanup": "never", "images": "jpg", "dpi": 300, "quality": 60,)"
+            R"( "downsample-images": 120,)"
+            R"( "operations": [{"op": "remove", "pages": "1-3"}, {"op": "move", "pages": "5-6", "to": 2}]})");
+
+        WHEN("It's written as JSON and read back")
+        {
+            const BatchJob readBack = parseBatchJob(batchJobToJson(job));
+
+            THEN("It should be the same job")
+            {
+                REQUIRE(readBack.inputs.size() == 2);
+                REQUIRE(readBack.inputs.at(1)->get_path() == "/c\"d.pdf");
+                REQUIRE(readBack.output->get_path() == "/out.pdf");
+                REQUIRE(readBack.splitSizeInBytes == job.splitSizeInBytes);
+                REQUIRE(readBack.saveMode == PdfSaver::Mode::LowMemory);
+                REQUIRE(readBack.writeProfile == job.writeProfile);
+                REQUIRE(readBack.resourceCleanup == PdfSaver::ResourceCleanup::Never);
+                REQUIRE(readBack.imageExport->format == ImageExport::Format::Jpeg);
+                REQUIRE(readBack.imageExport->dpi == 300);
+                REQUIRE(readBack.imageExport->quality == 60);
+                REQUIRE(readBack.imageDownsampling->dpi == 120);
+                REQUIRE(readBack.operations.size() == 2);
+                REQUIRE(readBack.operations.at(1).type == BatchOperation::Type::Move);
+                REQUIRE(readBack.operations.at(1).pages == "5-6");
+                REQUIRE(readBack.operations.at(1).destination == 2);
+            }
+        }
+    }
+
+    GIVEN("The results of two jobs, one of them failed")
+    {
+        const BatchJobResult succeeded{true, {}, {Gio::File::create_for_path("/out-1.pdf")}, std::chrono::seconds{2}, {}};
+        const BatchJobResult failed{false, "Bad \"page\"", {}, {}, {}};
+
+        WHEN("They're written as JSON and read back")
+        {
+            const auto [succeededLine, succeededReadBack] = parseBatchJobResult(batchJobResultToJson(3, succeeded));
+            const auto [failedLine, failedReadBack] = parseBatchJobResult(batchJobResultToJson(4, failed));
+
+            THEN("They should be the same results, for the same lines")
+            {
+                REQUIRE(succeededLine == 3);
+                REQUIRE(succeededReadBack.succeeded);
+                REQUIRE(succeededReadBack.writtenFiles.at(0)->get_path() == "/out-1.pdf");
+                REQUIRE(succeededReadBack.duration.count() == 2);
+                REQUIRE(failedLine == 4);
+                REQUIRE(!failedReadBack.succeeded);
+                REQUIRE(failedReadBack.error == "Bad \"page\"");
+            }
+        }
+    }
+}
@@ -0,0 +1,106 @@
+#include <catch.hpp>
+#include <blankpages.hpp>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace Slicer;
+
+static Glib::RefPtr<Gdk::Pixbuf> createPage(int width, int height, std::uint8_t paper, int noise)
+{
+    auto page = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, true, 8, width, height);
+    std::mt19937 generator{42}; //NOLINT
+
+    for (int y = 0; y < height; ++y) {
+        std::uint8_t* row = page->get_pixels() + y * page->get_rowstride(); //NOLINT
+
+        for (int x = 0; x < width; ++x) {
+            const int tone = paper + (noise == 0 ? 0 : static_cast<int>(generator() % (2 * noise + 1)) - noise);
+
+            for (int channel = 0; channel < 3; ++channel)
+                row[4 * x + channel] = static_cast<std::uint8_t>(std::clamp(tone, 0, 255)); //NOLINT
+            row[4 * x + 3] = 255; //NOLINT
+        }
+    }
+
+    return page;
+}
+
+// Dark lines across the middle of the page, like a paragraph seen from afar
+static void drawLines(const Glib::RefPtr<Gdk::Pixbuf>& page, int numberOfLines)
+{
+    for (int line = 0; line < numberOfLines; ++line) {
+        const int y = page->get_height() / 3 + 4 * line;
+        std::uint8_t* row = page->get_pixels() + y * page->get_rowstride(); //NOLINT
+
+        for (int x = page->get_width() / 5; x < page->get_width() * 4 / 5; ++x) {
+            for (int channel = 0; channel < 3; ++channel)
+                row[4 * x + channel] = 40; //NOLINT
+        }
+    }
+}
+
+SCENARIO("Measuring the ink of a page")
+{
+    GIVEN("An image with a width that isn't a multiple of the vector size")
+    {
+        const int width = 37;
+        const int height = 5;
+        std::vector<std::uint8_t> pixels(static_cast<std::size_t>(width * height * 4));
+        std::mt19937 generator{7}; //NOLINT
+        for (std::uint8_t& byte : pixels)
+            byte = static_cast<std::uint8_t>(generator() % 256);
+
+        WHEN("It's measured")
+        {
+            const BlankPages::Statistics expected = BlankPages::measureScalar(pixels.data(), width * 4, width, height);
+            const BlankPages::Statistics result = BlankPages::measure(pixels.data(), width * 4, width, height);
+
+            THEN("It gets the same figures as the plain C++ version")
+            {
+                REQUIRE(result.numberOfPixels == width * height);
+                REQUIRE(result.numberOfInkPixels == expected.numberOfInkPixels);
+                REQUIRE(result.sum == expected.sum);
+                REQUIRE(result.sumOfSquares == expected.sumOfSquares);
+            }
+        }
+    }
+}
+
+SCENARIO("Telling blank pages apart")
+{
+    GIVEN("A scanned blank page, with an off-white tone and some noise")
+    {
+        const Glib::RefPtr<Gdk::Pixbuf> page = createPage(150, 200, 235, 4);
+
+        THEN("It's blank")
+        REQUIRE(BlankPages::isBlank(page));
+
+        WHEN("A black outline is drawn around it")
+        {
+            for (int x = 0; x < page->get_width(); ++x) {
+                for (int channel = 0; channel < 3; ++channel)
+                    page->get_pixels()[4 * x + channel] = 0; //NOLINT
+            }
+
+            THEN("It's still blank")
+            REQUIRE(BlankPages::isBlank(page));
+        }
+
+        WHEN("A few lines of text are on it")
+        {
+            drawLines(page, 3);
+
+            THEN("It isn't blank")
+            REQUIRE_FALSE(BlankPages::isBlank(page));
+        }
+    }
+
+    GIVEN("A light gray page, like a photo washed out at a small size")
+    {
+        const Glib::RefPtr<Gdk::Pixbuf> page = createPage(150, 200, 200, 40);
+
+        THEN("It isn't blank")
+        REQUIRE_FALSE(BlankPages::isBlank(page));
+    }
+}
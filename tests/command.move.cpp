@@ -266,3 +266,71 @@ SCENARIO("Moving 2 adjacent pages across different places of a document, using t
         }
     }
 }
+
+SCENARIO("Moving pages that aren't next to each other using the Command abstraction")
+{
+    GIVEN("A multipage PDF document with 15 pages")
+    {
+        auto multipagePdfFile = Gio::File::create_for_path(multipage1Path);
+        Document doc{multipagePdfFile};
+        REQUIRE(doc.numberOfPages() == 15);
+
+        WHEN("The 2nd, 5th and 10th pages are moved to the 6th place")
+        {
+            MovePagesCommand command{doc, {1, 4, 9}, 5};
+            command.execute();
+
+            THEN("They should be together from the 6th place on, in their order")
+            {
+                REQUIRE(doc.getPage(5)->indexInFile() == 1);
+                REQUIRE(doc.getPage(6)->indexInFile() == 4);
+                REQUIRE(doc.getPage(7)->indexInFile() == 9);
+            }
+
+            THEN("The other pages should keep their order")
+            {
+                REQUIRE(doc.getPage(0)->indexInFile() == 0);
+                REQUIRE(doc.getPage(1)->indexInFile() == 2);
+                REQUIRE(doc.getPage(4)->indexInFile() == 6);
+                REQUIRE(doc.getPage(8)->indexInFile() == 7);
+                REQUIRE(doc.getPage(10)->indexInFile() == 10);
+            }
+
+            THEN("Every page should know its new place")
+            {
+                for (unsigned int i = 0; i < doc.numberOfPages(); ++i)
+                    REQUIRE(doc.getPage(i)->getDocumentIndex() == i);
+            }
+
+            WHEN("The command is undone")
+            {
+                command.undo();
+
+                THEN("Indexes should start from 0 and be monotonically increasing")
+                REQUIRE(areIndexesMonoIncreasing(doc));
+            }
+        }
+
+        WHEN("The 1st, 3rd and 4th pages are moved to the end")
+        {
+            MovePagesCommand command{doc, {0, 2, 3}, 12};
+            command.execute();
+
+            THEN("They should be the last ones")
+            {
+                REQUIRE(doc.getPage(12)->indexInFile() == 0);
+                REQUIRE(doc.getPage(13)->indexInFile() == 2);
+                REQUIRE(doc.getPage(14)->indexInFile() == 3);
+                REQUIRE(doc.getPage(0)->indexInFile() == 1);
+            }
+
+            WHEN("The command is undone")
+            {
+                command.undo();
+
+                THEN("Indexes should start from 0 and be monotonically increasing")
+                REQUIRE(areIndexesMonoIncreasing(doc));
+            }
+        }
+    }
+}
@@ -0,0 +1,248 @@
+#include "common.hpp"
+#include <catch.hpp>
+#include <commandmanager.hpp>
+
+using namespace Slicer;
+
+static bool isInFileOrder(const Document& doc)
+{
+    for (unsigned int i = 0; i < doc.numberOfPages(); ++i)
+        if (doc.getPage(i)->indexInFile() != i)
+            return false;
+
+    return true;
+}
+
+SCENARIO("Collapsing consecutive commands into a single undo record")
+{
+    GIVEN("A multipage PDF document with 15 pages and a command manager")
+    {
+        auto multipagePdfFile = Gio::File::create_for_path(multipage1Path);
+        Document doc{multipagePdfFile};
+        CommandManager manager;
+        REQUIRE(doc.numberOfPages() == 15);
+
+        WHEN("The same page is moved forward and back 300 times")
+        {
+            unsigned int position = 0;
+            for (int i = 0; i < 300; ++i) {
+                const unsigned int destination = (i % 20 < 10) ? position + 1 : position - 1;
+                manager.execute(std::make_shared<MovePageCommand>(doc, position, destination));
+                position = destination;
+            }
+
+            manager.undo();
+
+            THEN("A single undo should restore the original order")
+            REQUIRE(isInFileOrder(doc));
+
+            THEN("There should be nothing left to undo")
+            REQUIRE(!manager.canUndo());
+
+            WHEN("The merged command is redone")
+            {
+                manager.redo();
+
+                THEN("The page should be back where the last move put it")
+                REQUIRE(doc.getPage(position)->indexInFile() == 0);
+            }
+        }
+
+        WHEN("A range is moved forward one place at a time")
+        {
+            for (unsigned int i = 0; i < 5; ++i)
+                manager.execute(std::make_shared<MovePageRangeCommand>(doc, i, i + 2, i + 1));
+
+            THEN("The range should have moved 5 places")
+            REQUIRE(doc.getPage(5)->indexInFile() == 0);
+
+            manager.undo();
+
+            THEN("A single undo should restore the original order")
+            REQUIRE(isInFileOrder(doc));
+
+            THEN("There should be nothing left to undo")
+            REQUIRE(!manager.canUndo());
+        }
+
+        WHEN("The same pages are rotated right three times and left once")
+        {
+            const std::vector<unsigned int> pages{1, 3};
+            manager.execute(std::make_shared<RotatePagesRightCommand>(doc, pages));
+            manager.execute(std::make_shared<RotatePagesRightCommand>(doc, pages));
+            manager.execute(std::make_shared<RotatePagesRightCommand>(doc, pages));
+            manager.execute(std::make_shared<RotatePagesLeftCommand>(doc, pages));
+
+            THEN("The pages should be turned by half a turn")
+            REQUIRE(doc.getPage(1)->currentRotation() == 180);
+
+            manager.undo();
+
+            THEN("A single undo should restore the original rotation")
+            REQUIRE(doc.getPage(1)->currentRotation() == 0);
+            REQUIRE(doc.getPage(3)->currentRotation() == 0);
+
+            THEN("There should be nothing left to undo")
+            REQUIRE(!manager.canUndo());
+        }
+
+        WHEN("Different pages are rotated one after the other")
+        {
+            manager.execute(std::make_shared<RotatePagesRightCommand>(doc, std::vector<unsigned int>{1}));
+            manager.execute(std::make_shared<RotatePagesRightCommand>(doc, std::vector<unsigned int>{2}));
+            manager.undo();
+
+            THEN("Only the last rotation should be undone")
+            REQUIRE(doc.getPage(1)->currentRotation() == 90);
+            REQUIRE(doc.getPage(2)->currentRotation() == 0);
+
+            THEN("The first rotation should be left to undo")
+            REQUIRE(manager.canUndo());
+        }
+
+        WHEN("Two different pages are moved one after the other")
+        {
+            manager.execute(std::make_shared<MovePageCommand>(doc, 0, 4));
+            manager.execute(std::make_shared<MovePageCommand>(doc, 10, 12));
+            manager.undo();
+
+            THEN("Only the last move should be undone")
+            REQUIRE(doc.getPage(4)->indexInFile() == 0);
+            REQUIRE(doc.getPage(10)->indexInFile() == 10);
+        }
+    }
+}
+
+SCENARIO("Bounding the undo history")
+{
+    GIVEN("A multipage PDF document with 15 pages and a command manager")
+    {
+        auto multipagePdfFile = Gio::File::create_for_path(multipage1Path);
+        Document doc{multipagePdfFile};
+        CommandManager manager;
+        REQUIRE(doc.numberOfPages() == 15);
+
+        WHEN("Five pages are removed one at a time, with room for three commands")
+        {
+            manager.setHistoryLimits(3, CommandManager::defaultMaxSizeInBytes);
+
+            for (int i = 0; i < 5; ++i)
+                manager.execute(std::make_shared<RemovePageCommand>(doc, 0));
+
+            for (int i = 0; i < 3; ++i)
+                manager.undo();
+
+            THEN("Only the last three removals should be undone")
+            REQUIRE(doc.numberOfPages() == 13);
+            REQUIRE(doc.getPage(0)->indexInFile() == 2);
+
+            THEN("There should be nothing left to undo")
+            REQUIRE(!manager.canUndo());
+        }
+
+        WHEN("Pages are removed with room for no bytes at all")
+        {
+            manager.setHistoryLimits(CommandManager::defaultMaxCommands, 0);
+
+            manager.execute(std::make_shared<RemovePagesCommand>(doc, std::vector<unsigned int>{0, 1}));
+            manager.execute(std::make_shared<RemovePagesCommand>(doc, std::vector<unsigned int>{0, 1}));
+
+            THEN("The last removal should still be undoable")
+            REQUIRE(manager.canUndo());
+
+            manager.undo();
+
+            THEN("The first removal should have been forgotten")
+            REQUIRE(!manager.canUndo());
+            REQUIRE(doc.numberOfPages() == 13);
+        }
+
+        WHEN("Three pages are removed")
+        {
+            manager.execute(std::make_shared<RemovePagesCommand>(doc, std::vector<unsigned int>{0, 1, 2}));
+            const std::size_t sizeWithRemovedPages = manager.historySizeInBytes();
+
+            THEN("The history should account for the removed pages")
+            REQUIRE(sizeWithRemovedPages >= 3 * doc.getPage(3)->sizeInBytes());
+
+            THEN("Resetting the history should release them")
+            {
+                manager.reset();
+                REQUIRE(manager.historySizeInBytes() == 0);
+            }
+        }
+    }
+}
+
+SCENARIO("Grouping a script's commands into a single transaction")
+{
+    GIVEN("A multipage PDF document with 15 pages and a command manager")
+    {
+        auto multipagePdfFile = Gio::File::create_for_path(multipage1Path);
+        Document doc{multipagePdfFile};
+        CommandManager manager;
+        REQUIRE(doc.numberOfPages() == 15);
+
+        unsigned int numberOfChanges = 0;
+        doc.pages()->signal_items_changed().connect([&](guint, guint, guint) {
+            ++numberOfChanges;
+        });
+
+        WHEN("Pages are removed, turned and moved 100 times in a transaction")
+        {
+            manager.beginTransaction(doc);
+
+            for (unsigned int i = 0; i < 100; ++i) {
+                manager.execute(std::make_shared<RotatePagesRightCommand>(doc, std::vector<unsigned int>{i % 15}));
+                manager.execute(std::make_shared<MovePageCommand>(doc, i % 15, (i + 7) % 15));
+            }
+            manager.execute(std::make_shared<RemovePagesCommand>(doc, std::vector<unsigned int>{0, 1}));
+
+            THEN("Nothing should have been notified or become undoable before the commit")
+            {
+                REQUIRE(numberOfChanges == 0);
+                REQUIRE(manager.isInTransaction());
+                REQUIRE(!manager.canUndo());
+            }
+
+            manager.commitTransaction();
+
+            THEN("The commit should notify the views once")
+            REQUIRE(numberOfChanges == 1);
+
+            THEN("A single undo should restore the original document")
+            {
+                manager.undo();
+                REQUIRE(doc.numberOfPages() == 15);
+                REQUIRE(isInFileOrder(doc));
+                REQUIRE(!manager.canUndo());
+                REQUIRE(numberOfChanges == 2);
+            }
+
+            THEN("A redo should bring back the whole script")
+            {
+                manager.undo();
+                manager.redo();
+                REQUIRE(doc.numberOfPages() == 13);
+                REQUIRE(numberOfChanges == 3);
+            }
+        }
+
+        WHEN("A transaction is rolled back")
+        {
+            manager.beginTransaction(doc);
+            manager.execute(std::make_shared<RemovePagesCommand>(doc, std::vector<unsigned int>{3, 4, 5}));
+            manager.execute(std::make_shared<MovePageCommand>(doc, 0, 10));
+            manager.rollbackTransaction();
+
+            THEN("The document should be as it was, with nothing to undo")
+            {
+                REQUIRE(isInFileOrder(doc));
+                REQUIRE(doc.numberOfPages() == 15);
+                REQUIRE(!manager.isInTransaction());
+                REQUIRE(!manager.canUndo());
+                REQUIRE(numberOfChanges == 0);
+            }
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#include <catch.hpp>
+#include <cpuresources.hpp>
+#include <thread>
+
+using namespace Slicer;
+
+SCENARIO("Reading what a container allows the process to run on")
+{
+    GIVEN("The contents of cgroup v2 cpu.max files")
+    {
+        THEN("A quota gives its share of the period, in cores")
+        REQUIRE(CpuResources::coresOfCpuMax("400000 100000\n") == 4.0);
+
+        THEN("A fraction of a core is kept as it is")
+        REQUIRE(CpuResources::coresOfCpuMax("50000 100000") == 0.5);
+
+        THEN("No quota means no limit")
+        REQUIRE(!CpuResources::coresOfCpuMax("max 100000\n").has_value());
+
+        THEN("Something else means no limit either")
+        REQUIRE(!CpuResources::coresOfCpuMax("").has_value());
+    }
+
+    GIVEN("The quota and period of cgroup v1")
+    {
+        THEN("A quota gives its share of the period, in cores")
+        REQUIRE(CpuResources::coresOfCfsQuota(200000, 100000) == 2.0);
+
+        THEN("A quota of -1 means no limit")
+        REQUIRE(!CpuResources::coresOfCfsQuota(-1, 100000).has_value());
+    }
+
+    GIVEN("A list of cores as Linux writes it")
+    {
+        THEN("Ranges and single cores are all listed, in order")
+        REQUIRE(CpuResources::parseCpuList("0-3,8,10-11\n") == std::vector<int>{0, 1, 2, 3, 8, 10, 11});
+
+        THEN("An empty list has no cores")
+        REQUIRE(CpuResources::parseCpuList("\n").empty());
+    }
+
+    GIVEN("The machine the tests run on")
+    {
+        THEN("There should be at least a core, and no more than the hardware has")
+        {
+            REQUIRE(CpuResources::availableCores() >= 1);
+
+            if (std::thread::hardware_concurrency() != 0)
+                REQUIRE(CpuResources::availableCores() <= std::thread::hardware_concurrency());
+        }
+
+        THEN("There should be at least a node, and the calling thread on one of them")
+        {
+            REQUIRE(!CpuResources::nodes().empty());
+            REQUIRE(CpuResources::currentNode() < CpuResources::nodes().size());
+        }
+    }
+}
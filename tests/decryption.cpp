@@ -0,0 +1,86 @@
+#include "common.hpp"
+#include <catch.hpp>
+#include <decryption.hpp>
+#include <document.hpp>
+#include <tempfile.hpp>
+
+using namespace Slicer;
+
+SCENARIO("Opening an encrypted file decrypts it once into the working copy")
+{
+    GIVEN("A copy of a 15 page file encrypted with only an owner password")
+    {
+        const Glib::RefPtr<Gio::File> encryptedFile = TempFile::generate();
+        {
+            const Document source{Gio::File::create_for_path(multipage1Path)};
+            PdfSaver saver{source.getSaveData()};
+            saver.setEncryption(PdfSaver::Encryption{"", "owner"});
+            saver.save(encryptedFile);
+        }
+
+        THEN("Only the encrypted file should look encrypted")
+        {
+            REQUIRE(Decryption::mayBeEncrypted(encryptedFile->get_path()));
+            REQUIRE(!Decryption::mayBeEncrypted(multipage1Path));
+        }
+
+        WHEN("It's decrypted twice")
+        {
+            const Glib::RefPtr<Gio::File> first = TempFile::generate();
+            const Glib::RefPtr<Gio::File> second = TempFile::generate();
+
+            THEN("Both copies should be the same file, without encryption")
+            {
+                REQUIRE(Decryption::decryptTo(encryptedFile->get_path(), first->get_path()));
+                REQUIRE(Decryption::decryptTo(encryptedFile->get_path(), second->get_path()));
+                REQUIRE(!Decryption::mayBeEncrypted(first->get_path()));
+                REQUIRE(Document::contentHashOf(first->get_path()) == Document::contentHashOf(second->get_path()));
+            }
+
+            first->remove();
+            second->remove();
+        }
+
+        WHEN("A file that isn't encrypted is decrypted")
+        {
+            const Glib::RefPtr<Gio::File> destination = TempFile::generate();
+
+            THEN("Nothing should be written")
+            {
+                REQUIRE(!Decryption::decryptTo(multipage1Path, destination->get_path()));
+                REQUIRE(!destination->query_exists());
+            }
+        }
+
+        WHEN("It's opened as a document")
+        {
+            Document doc{encryptedFile};
+
+            THEN("It should have all of its pages, read from a decrypted copy")
+            {
+                REQUIRE(doc.numberOfPages() == 15);
+                REQUIRE(!Decryption::mayBeEncrypted(doc.getSaveData().files.front()->get_path()));
+            }
+
+            THEN("Saving it should only encrypt the result when asked to")
+            {
+                const Glib::RefPtr<Gio::File> plain = TempFile::generate();
+                const Glib::RefPtr<Gio::File> encrypted = TempFile::generate();
+
+                PdfSaver{doc.getSaveData()}.save(plain);
+                PdfSaver saver{doc.getSaveData()};
+                saver.setEncryption(PdfSaver::Encryption{"", "owner"});
+                saver.save(encrypted);
+
+                REQUIRE(!Decryption::mayBeEncrypted(plain->get_path()));
+                REQUIRE(Decryption::mayBeEncrypted(encrypted->get_path()));
+                REQUIRE(Document{encrypted}.numberOfPages() == 15);
+
+                plain->remove();
+                encrypted->remove();
+            }
+        }
+
+        encryptedFile->remove();
+    }
+}
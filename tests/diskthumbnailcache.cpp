@@ -0,0 +1,56 @@
+#include "common.hpp"
+#include <catch.hpp>
+#include <diskthumbnailcache.hpp>
+#include <document.hpp>
+#include <tempfile.hpp>
+#include <glib/gstdio.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <array>
+
+using namespace Slicer;
+
+SCENARIO("Keeping thumbnails on disk for files that may be rewritten in place")
+{
+    GIVEN("A disk thumbnail cache, and the thumbnail of the first page of a file stored in it")
+    {
+        const std::string directory = TempFile::generate()->get_path();
+        DiskThumbnailCache cache{directory, 1024 * 1024};
+
+        const std::string sourcePath = TempFile::generate()->get_path();
+        Gio::File::create_for_path(multipage1Path)->copy(Gio::File::create_for_path(sourcePath));
+
+        DiskThumbnailCache::Key key{};
+        {
+            const Document doc{Gio::File::create_for_path(sourcePath)};
+            key = DiskThumbnailCache::keyFor(*doc.getPage(0).get(), 100);
+        }
+
+        cache.store(key, Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, false, 8, 71, 100));
+
+        THEN("It should be found under the key of the page")
+        REQUIRE(cache.load(key));
+
+        WHEN("The file gets another modification time, with the same size and contents")
+        {
+            struct stat status {};
+            REQUIRE(stat(sourcePath.c_str(), &status) == 0);
+
+            timespec modified = status.st_mtim;
+            modified.tv_sec += 10;
+            const std::array<timespec, 2> times{status.st_atim, modified};
+            REQUIRE(utimensat(AT_FDCWD, sourcePath.c_str(), times.data(), 0) == 0);
+
+            const Document doc{Gio::File::create_for_path(sourcePath)};
+            const DiskThumbnailCache::Key newKey = DiskThumbnailCache::keyFor(*doc.getPage(0).get(), 100);
+
+            THEN("The same content hash should no longer find the thumbnail stored before")
+            {
+                REQUIRE(newKey.fileHash == key.fileHash);
+                REQUIRE(!cache.load(newKey));
+            }
+        }
+
+        g_remove(sourcePath.c_str());
+    }
+}
@@ -109,3 +109,44 @@ SCENARIO("Adding a new file to an existing document")
         }
     }
 }
+
+SCENARIO("Telling whether every page of a document has the same size")
+{
+    GIVEN("A document whose pages are all letter sized")
+    {
+        Document doc{Gio::File::create_for_path(multipage1Path)};
+
+        THEN("It has a uniform page size")
+        REQUIRE(doc.uniformPageSize().has_value());
+
+        WHEN("A file with letter sized pages is added")
+        {
+            doc.addFile(Gio::File::create_for_path(multipage2Path), 0);
+
+            THEN("It keeps a uniform page size")
+            REQUIRE(doc.uniformPageSize().has_value());
+        }
+
+        WHEN("A file with A4 pages is added")
+        {
+            doc.addFile(Gio::File::create_for_path(multipage3Path), 15);
+
+            THEN("It no longer has a uniform page size")
+            REQUIRE(!doc.uniformPageSize().has_value());
+        }
+    }
+}
+
+SCENARIO("Telling what the pages of a file will be cached by without adding it")
+{
+    GIVEN("A document of a file")
+    {
+        const Document doc{Gio::File::create_for_path(multipage1Path)};
+
+        THEN("The hash of the file should be that of its pages")
+        REQUIRE(Document::contentHashOf(multipage1Path) == doc.getPage(0)->fileHash());
+
+        THEN("Another file should have another one")
+        REQUIRE(Document::contentHashOf(multipage2Path) != doc.getPage(0)->fileHash());
+    }
+}
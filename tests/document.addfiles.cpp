@@ -1,6 +1,7 @@
 #include "common.hpp"
 #include <catch.hpp>
 #include <document.hpp>
+#include <tempfile.hpp>
 
 using namespace Slicer;
 
@@ -20,6 +21,15 @@ SCENARIO("Adding 2 new files to an existing document")
         {
             doc.addFiles(filesToAdd, 0);
 
+            THEN("The added files should be numbered in the order they were given")
+            {
+                const PdfSaver::SaveData saveData = doc.getSaveData();
+                REQUIRE(saveData.files.size() == 3);
+                REQUIRE(saveData.pages.at(0).file == 1);
+                REQUIRE(saveData.pages.at(5).file == 2);
+                REQUIRE(saveData.pages.at(20).file == 0);
+            }
+
             THEN("The document should now have 35 pages")
             REQUIRE(doc.numberOfPages() == 35);
 
@@ -155,3 +165,43 @@ SCENARIO("Adding 2 new files to an existing document")
         }
     }
 }
+
+SCENARIO("Adding the same file several times")
+{
+    GIVEN("A document with a 5 pages file")
+    {
+        Document doc{Gio::File::create_for_path(multipage2Path)};
+
+        WHEN("The same file is added twice more, along with another one")
+        {
+            doc.addFiles({Gio::File::create_for_path(multipage2Path),
+                          Gio::File::create_for_path(multipage1Path),
+                          Gio::File::create_for_path(multipage2Path)},
+                         doc.numberOfPages());
+
+            THEN("Its repeated pages should all come from the file already in the document")
+            {
+                const PdfSaver::SaveData saveData = doc.getSaveData();
+                REQUIRE(saveData.files.size() == 2);
+                REQUIRE(doc.numberOfLiveFiles() == 2);
+                REQUIRE(saveData.pages.at(5).file == 0);
+                REQUIRE(saveData.pages.at(10).file == 1);
+                REQUIRE(saveData.pages.at(25).file == 0);
+            }
+
+            THEN("Saving should keep every repeated page, each with its own rotation")
+            {
+                doc.rotatePagesRight({5});
+
+                const Glib::RefPtr<Gio::File> file = TempFile::generate();
+                PdfSaver{doc.getSaveData()}.save(file);
+
+                Document result{file};
+                REQUIRE(result.numberOfPages() == 30);
+                REQUIRE(result.getPage(0)->currentRotation() == 0);
+                REQUIRE(result.getPage(5)->currentRotation() == 90);
+                REQUIRE(result.getPage(25)->currentRotation() == 0);
+            }
+        }
+    }
+}
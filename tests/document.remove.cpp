@@ -369,3 +369,119 @@ SCENARIO("Removing 2 disjoint pages from different places of a document")
         }
     }
 }
+
+SCENARIO("Removing disjoint pages from a document")
+{
+    GIVEN("A multipage document with 15 pages")
+    {
+        auto multipagePdfFile = Gio::File::create_for_path(multipage1Path);
+        Document doc{multipagePdfFile};
+        REQUIRE(doc.numberOfPages() == 15);
+
+        unsigned int itemsChangedCount = 0;
+        doc.pages()->signal_items_changed().connect([&](guint, guint, guint) {
+            ++itemsChangedCount;
+        });
+
+        WHEN("Every odd page is removed")
+        {
+            auto removedPages = doc.removePages({1, 3, 5, 7, 9, 11, 13});
+
+            THEN("The document should have 8 pages")
+            REQUIRE(doc.numberOfPages() == 8);
+
+            THEN("The remaining pages should be the even pages of the file")
+            for (unsigned int i = 0; i < doc.numberOfPages(); ++i)
+                REQUIRE(doc.getPage(i)->indexInFile() == 2 * i);
+
+            THEN("The remaining pages should be renumbered")
+            for (unsigned int i = 0; i < doc.numberOfPages(); ++i)
+                REQUIRE(doc.getPage(i)->getDocumentIndex() == i);
+
+            THEN("The view should be notified only once")
+            REQUIRE(itemsChangedCount == 1);
+
+            WHEN("The removal is undone")
+            {
+                doc.insertPages(removedPages);
+
+                THEN("The document should be back to its original order")
+                for (unsigned int i = 0; i < doc.numberOfPages(); ++i)
+                    REQUIRE(doc.getPage(i)->indexInFile() == i);
+            }
+        }
+    }
+}
+
+SCENARIO("Releasing the files whose pages are all gone")
+{
+    GIVEN("A document made of two files")
+    {
+        Document doc{Gio::File::create_for_path(multipage1Path)};
+        doc.addFile(Gio::File::create_for_path(multipage2Path), doc.numberOfPages());
+        const Glib::RefPtr<Gio::File> secondSnapshot = doc.getSaveData().files.at(1);
+        REQUIRE(doc.numberOfLiveFiles() == 2);
+
+        WHEN("Every page of the second file is removed but still held, as the undo history would")
+        {
+            auto removedPages = doc.removePageRange(15, doc.numberOfPages() - 1);
+
+            THEN("The second file should still be alive")
+            REQUIRE(doc.numberOfLiveFiles() == 2);
+            REQUIRE(secondSnapshot->query_exists());
+
+            WHEN("The removed pages are dropped")
+            {
+                removedPages.clear();
+
+                THEN("The snapshot of the second file should be deleted")
+                REQUIRE(doc.numberOfLiveFiles() == 1);
+                REQUIRE(!secondSnapshot->query_exists());
+            }
+        }
+
+        WHEN("Every page of the first file is removed and dropped")
+        {
+            doc.removePageRange(0, 14);
+            const Glib::RefPtr<Gio::File> firstSnapshot = doc.getSaveData().files.at(0);
+
+            THEN("The first file should be kept, as the shell of the saved file")
+            REQUIRE(doc.numberOfLiveFiles() == 2);
+            REQUIRE(firstSnapshot->query_exists());
+        }
+    }
+}
+
+SCENARIO("Putting back every other page of a document")
+{
+    GIVEN("A multipage PDF document with 15 pages")
+    {
+        Document doc{Gio::File::create_for_path(multipage1Path)};
+
+        WHEN("The even pages are removed and then inserted back")
+        {
+            auto removedPages = doc.removePages({1, 3, 5, 7, 9, 11, 13});
+            REQUIRE(doc.numberOfPages() == 8);
+
+            unsigned int numberOfRenumberings = 0;
+            doc.pagesRenumbered.connect([&numberOfRenumberings](unsigned int) {
+                ++numberOfRenumberings;
+            });
+
+            doc.insertPages(removedPages);
+
+            THEN("Every page should be back in its place, with its index")
+            {
+                REQUIRE(doc.numberOfPages() == 15);
+
+                for (unsigned int i = 0; i < doc.numberOfPages(); ++i) {
+                    REQUIRE(doc.getPage(i)->indexInFile() == i);
+                    REQUIRE(doc.getPage(i)->getDocumentIndex() == i);
+                }
+            }
+
+            THEN("The pages should have been renumbered only once")
+            REQUIRE(numberOfRenumberings == 1);
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#include <catch.hpp>
+#include <frameprofiler.hpp>
+
+using namespace Slicer;
+using namespace std::chrono_literals;
+
+SCENARIO("Telling the frames over budget apart, and what they were spent on")
+{
+    GIVEN("A frame profiler with a budget of 16 ms, recording")
+    {
+        FrameProfiler profiler;
+        profiler.setFrameBudget(16ms);
+        profiler.acquire();
+
+        FrameProfiler::Clock::time_point time{};
+        profiler.recordFrame(time);
+
+        WHEN("Frames come every 16 ms, but one takes 40 ms, most of them completing tasks")
+        {
+            for (int i = 0; i < 9; ++i)
+                profiler.recordFrame(time += 16ms);
+
+            profiler.addWork(FrameProfiler::Work::TaskCompletions, 30ms);
+            profiler.addWork(FrameProfiler::Work::Paint, 5ms);
+            profiler.recordFrame(time += 40ms);
+
+            const FrameProfiler::Summary summary = profiler.summary();
+
+            THEN("That frame should be the only one over budget")
+            {
+                REQUIRE(summary.numberOfFrames == 10);
+                REQUIRE(summary.numberOfFramesOverBudget == 1);
+                REQUIRE(summary.medianFrameTime == 16ms);
+                REQUIRE(summary.worstFrameTime == 40ms);
+            }
+
+            THEN("Its work should be put down to it")
+            {
+                REQUIRE(summary.workOverBudget.at(0) == 30ms);
+                REQUIRE(summary.workOverBudget.at(3) == 5ms);
+                REQUIRE(summary.workOverBudget.at(1) == FrameProfiler::Clock::duration::zero());
+            }
+        }
+
+        WHEN("A frame comes after the grid was idle for a while")
+        {
+            profiler.recordFrame(time += 16ms);
+            profiler.recordFrame(time += 2s);
+
+            THEN("The gap shouldn't count as a frame")
+            REQUIRE(profiler.summary().numberOfFrames == 1);
+        }
+
+        WHEN("Nobody looks anymore")
+        {
+            profiler.release();
+            profiler.recordFrame(time += 16ms);
+
+            THEN("Nothing should be recorded")
+            REQUIRE(profiler.summary().numberOfFrames == 0);
+        }
+    }
+}
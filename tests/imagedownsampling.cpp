@@ -0,0 +1,75 @@
+#include <catch.hpp>
+#include <imagedownsampling.hpp>
+#include <qpdf/QPDFPageDocumentHelper.hh>
+
+using namespace Slicer;
+
+// An uncompressed RGB image of a gradient, on a page of its own, drawn at
+// drawnSize points
+static QPDFObjectHandle addImagePage(QPDF& pdf, int size, int drawnSize)
+{
+    std::string samples;
+    for (int y = 0; y < size; ++y)
+        for (int x = 0; x < size; ++x)
+            samples += {static_cast<char>(x), static_cast<char>(y), static_cast<char>(x + y)};
+
+    QPDFObjectHandle image = QPDFObjectHandle::newStream(&pdf, samples);
+    image.getDict().replaceKey("/Type", QPDFObjectHandle::newName("/XObject"));
+    image.getDict().replaceKey("/Subtype", QPDFObjectHandle::newName("/Image"));
+    image.getDict().replaceKey("/Width", QPDFObjectHandle::newInteger(size));
+    image.getDict().replaceKey("/Height", QPDFObjectHandle::newInteger(size));
+    image.getDict().replaceKey("/ColorSpace", QPDFObjectHandle::newName("/DeviceRGB"));
+    image.getDict().replaceKey("/BitsPerComponent", QPDFObjectHandle::newInteger(8));
+
+    const std::string drawn = std::to_string(drawnSize);
+    QPDFObjectHandle page = QPDFObjectHandle::parse("<< /Type /Page /MediaBox [0 0 612 792] /Resources << /XObject << >> >> >>");
+    page.getKey("/Resources").getKey("/XObject").replaceKey("/Im0", image);
+    page.replaceKey("/Contents", QPDFObjectHandle::newStream(&pdf, "q " + drawn + " 0 0 " + drawn + " 10 10 cm /Im0 Do Q"));
+    QPDFPageDocumentHelper{pdf}.addPage(QPDFPageObjectHelper{pdf.makeIndirectObject(page)}, false);
+
+    return image;
+}
+
+SCENARIO("Scaling down the images drawn at a high resolution")
+{
+    GIVEN("A file with an image drawn at 400 dpi, and one at 100 dpi")
+    {
+        QPDF pdf;
+        pdf.emptyPDF();
+        QPDFObjectHandle sharp = addImagePage(pdf, 400, 72);
+        addImagePage(pdf, 200, 144);
+
+        ImageDownsampling::Options options;
+        options.dpi = 100;
+
+        WHEN("The images to scale down to 100 dpi are looked for")
+        {
+            const std::vector<ImageDownsampling::Candidate> candidates = ImageDownsampling::findCandidates(pdf, options);
+
+            THEN("Only the sharp one is found, with its size at 100 dpi")
+            {
+                REQUIRE(candidates.size() == 1);
+                REQUIRE(candidates.front().image.getObjGen() == sharp.getObjGen());
+                REQUIRE(candidates.front().targetWidth == 100);
+                REQUIRE(candidates.front().targetHeight == 100);
+            }
+
+            AND_WHEN("It's recompressed and replaced")
+            {
+                const std::string data = ImageDownsampling::readData(candidates.front());
+                const std::optional<ImageDownsampling::Recompressed> recompressed = ImageDownsampling::recompress(candidates.front(), data, options);
+                REQUIRE(recompressed.has_value());
+
+                ImageDownsampling::replace(candidates.front(), recompressed.value());
+
+                THEN("The image is a smaller JPEG of that size")
+                {
+                    REQUIRE(sharp.getDict().getKey("/Width").getIntValue() == 100);
+                    REQUIRE(sharp.getDict().getKey("/Height").getIntValue() == 100);
+                    REQUIRE(sharp.getDict().getKey("/Filter").getName() == "/DCTDecode");
+                    REQUIRE(recompressed->jpeg.size() < data.size());
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,88 @@
+#include "common.hpp"
+#include <catch.hpp>
+#include <document.hpp>
+#include <inspection.hpp>
+#include <pageindex.hpp>
+#include <tempfile.hpp>
+
+using namespace Slicer;
+
+SCENARIO("Inspecting files without opening them as documents")
+{
+    GIVEN("A multipage PDF file with 15 pages")
+    {
+        const Glib::RefPtr<Gio::File> file = Gio::File::create_for_path(multipage1Path);
+
+        WHEN("It's inspected")
+        {
+            const Inspection::FileInfo info = Inspection::inspect(file);
+
+            THEN("It should have the pages a document of it has, sized and turned the same")
+            {
+                const Document doc{file};
+                REQUIRE(info.pages.size() == doc.numberOfPages());
+
+                for (unsigned int i = 0; i < doc.numberOfPages(); ++i) {
+                    REQUIRE(info.pages[i].width == doc.getPage(i)->size().width);
+                    REQUIRE(info.pages[i].height == doc.getPage(i)->size().height);
+                    REQUIRE(info.pages[i].rotation == doc.getPage(i)->sourceRotation());
+                }
+            }
+
+            THEN("It shouldn't be encrypted")
+            REQUIRE(!info.isEncrypted);
+        }
+
+        WHEN("It's inspected along with two other files, one of which doesn't exist")
+        {
+            const std::vector<Inspection::Result> results = Inspection::inspectAll(
+                {file, Gio::File::create_for_path(multipage2Path), Gio::File::create_for_path("missing.pdf")}, 2);
+
+            THEN("Every file should have its result, in order")
+            {
+                REQUIRE(results.size() == 3);
+                REQUIRE(results[0].info->pages.size() == 15);
+                REQUIRE(results[1].info.has_value());
+                REQUIRE(!results[2].info.has_value());
+                REQUIRE(!results[2].error.empty());
+            }
+        }
+    }
+}
+
+SCENARIO("Inspecting an encrypted file from the page index")
+{
+    GIVEN("A 15 page file encrypted with only an owner password, opened once with the page index in memory")
+    {
+        PageIndex::setMemoryBudget(1024 * 1024);
+
+        const Glib::RefPtr<Gio::File> encryptedFile = TempFile::generate();
+        {
+            const Document source{Gio::File::create_for_path(multipage1Path)};
+            PdfSaver saver{source.getSaveData()};
+            saver.setEncryption(PdfSaver::Encryption{"", "owner"});
+            saver.save(encryptedFile);
+        }
+
+        {
+            const Document doc{encryptedFile};
+            REQUIRE(doc.numberOfPages() == 15);
+        }
+
+        WHEN("It's inspected")
+        {
+            const Inspection::FileInfo info = Inspection::inspect(encryptedFile);
+
+            THEN("Its pages should come from the index the document stored, and it should be encrypted")
+            {
+                REQUIRE(info.isFromIndex);
+                REQUIRE(info.isEncrypted);
+                REQUIRE(!info.needsPassword);
+                REQUIRE(info.pages.size() == 15);
+            }
+        }
+
+        encryptedFile->remove();
+        PageIndex::setMemoryBudget(0);
+    }
+}
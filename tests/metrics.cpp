@@ -0,0 +1,177 @@
+#include <catch.hpp>
+#include <metrics.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace Slicer;
+
+SCENARIO("Counting what the application does")
+{
+    GIVEN("A snapshot of the counters")
+    {
+        const Metrics::Snapshot before = Metrics::snapshot();
+
+        WHEN("Some counters go up")
+        {
+            Metrics::add(Metrics::Counter::PagesRendered, 3);
+            Metrics::add(Metrics::Counter::ThumbnailCacheHits, 3);
+            Metrics::add(Metrics::Counter::ThumbnailCacheMisses);
+            Metrics::add(Metrics::Counter::FilesSaved);
+            Metrics::add(Metrics::Counter::BytesSaved, 2 * 1024 * 1024);
+            Metrics::add(Metrics::Counter::SaveMilliseconds, 500);
+
+            Metrics::Snapshot after = Metrics::snapshot();
+
+            THEN("A later snapshot should have them")
+            {
+                REQUIRE(after[Metrics::Counter::PagesRendered] - before[Metrics::Counter::PagesRendered] == 3);
+                REQUIRE(after[Metrics::Counter::ThumbnailCacheMisses] - before[Metrics::Counter::ThumbnailCacheMisses] == 1);
+                REQUIRE(after[Metrics::Counter::TasksCanceled] == before[Metrics::Counter::TasksCanceled]);
+            }
+
+            THEN("The description should have the rates between both")
+            {
+                after.time = before.time + std::chrono::seconds{2};
+                const std::string description = Metrics::describe(before, after);
+
+                REQUIRE(description.find("Pages rendered: 3 (1.5/s)") != std::string::npos);
+                REQUIRE(description.find("Thumbnail cache hit rate: 75.0% of 4") != std::string::npos);
+                REQUIRE(description.find("Files saved: 1 (2.0 MB at 4.0 MB/s)") != std::string::npos);
+            }
+        }
+    }
+}
+
+SCENARIO("Measuring how long the user waits")
+{
+    GIVEN("Latencies in a histogram")
+    {
+        WHEN("Values are put in buckets")
+        {
+            THEN("Each one should be within a bucket's width of its own")
+            {
+                for (std::uint64_t value : {0ULL, 1ULL, 31ULL, 32ULL, 33ULL, 1000ULL, 123456ULL, 987654321ULL}) {
+                    const std::size_t bucket = Metrics::Histogram::bucketOf(value);
+                    const std::uint64_t low = Metrics::Histogram::lowestValueOf(bucket);
+                    const std::uint64_t high = Metrics::Histogram::lowestValueOf(bucket + 1);
+
+                    REQUIRE(low <= value);
+                    REQUIRE(value < high);
+                    REQUIRE(static_cast<double>(high - low) <= std::max(1.0, static_cast<double>(value) / 16.0));
+                }
+            }
+        }
+
+        WHEN("Saves taking from 1 to 100 milliseconds are recorded")
+        {
+            const std::uint64_t before = Metrics::histogram(Metrics::Latency::Save).numberOfSamples();
+
+            for (int milliseconds = 1; milliseconds <= 100; ++milliseconds)
+                Metrics::record(Metrics::Latency::Save, std::chrono::milliseconds{milliseconds});
+
+            const Metrics::Histogram histogram = Metrics::histogram(Metrics::Latency::Save);
+
+            // However many times this runs, the values are the same ones
+            THEN("The quantiles should be close to the values")
+            {
+                REQUIRE(histogram.numberOfSamples() == before + 100);
+                REQUIRE(histogram.quantile(0.5) == Approx(50000).epsilon(0.07));
+                REQUIRE(histogram.quantile(0.99) == Approx(99000).epsilon(0.07));
+                REQUIRE(histogram.maximum() == Approx(100000).epsilon(0.07));
+            }
+
+            THEN("The description should have them")
+            REQUIRE(Metrics::describeLatencies().find("Save: ") != std::string::npos);
+        }
+    }
+}
+
+SCENARIO("Accounting for the memory each part holds")
+{
+    GIVEN("What the undo history holds before")
+    {
+        const std::uint64_t before = Metrics::bytesHeld(Metrics::Memory::UndoHistory);
+
+        WHEN("A charge is taken and grows")
+        {
+            auto charge = std::make_unique<Metrics::MemoryCharge>(Metrics::Memory::UndoHistory, 1000);
+            charge->set(3000);
+
+            THEN("It should be held")
+            REQUIRE(Metrics::bytesHeld(Metrics::Memory::UndoHistory) == before + 3000);
+
+            AND_WHEN("It's moved to another one")
+            {
+                Metrics::MemoryCharge moved = std::move(*charge);
+                charge.reset();
+
+                THEN("It should be held only once")
+                REQUIRE(Metrics::bytesHeld(Metrics::Memory::UndoHistory) == before + 3000);
+            }
+
+            AND_WHEN("It goes away")
+            {
+                charge.reset();
+
+                THEN("It should be released")
+                REQUIRE(Metrics::bytesHeld(Metrics::Memory::UndoHistory) == before);
+            }
+        }
+
+        WHEN("A charge is moved onto another one")
+        {
+            Metrics::MemoryCharge first{Metrics::Memory::UndoHistory, 1000};
+            Metrics::MemoryCharge second{Metrics::Memory::UndoHistory, 500};
+            second = std::move(first);
+
+            THEN("What the other one held should be released")
+            REQUIRE(Metrics::bytesHeld(Metrics::Memory::UndoHistory) == before + 1000);
+        }
+
+        THEN("The description should have every part")
+        {
+            const std::string description = Metrics::describeMemory();
+
+            REQUIRE(description.find("Thumbnails: ") != std::string::npos);
+            REQUIRE(description.find("Undo history: ") != std::string::npos);
+        }
+    }
+}
+
+SCENARIO("Finding the pages that make a document slow")
+{
+    GIVEN("Pages of a made up file, one of them far slower than any real one")
+    {
+        const std::string filePath = "/nonexistent/slow-pages.pdf";
+
+        Metrics::recordPageCreation(filePath, 0, std::chrono::milliseconds{1});
+        Metrics::recordPageRender(filePath, 0, std::chrono::milliseconds{2}, 1024);
+        Metrics::recordPageCreation(filePath, 7, std::chrono::seconds{600});
+        Metrics::recordPageRender(filePath, 7, std::chrono::seconds{900}, 4096);
+        Metrics::recordPageRender(filePath, 7, std::chrono::seconds{300}, 2048);
+
+        WHEN("The slowest pages are asked for")
+        {
+            const std::vector<Metrics::PageCost> slowest = Metrics::slowestPages(1);
+
+            THEN("The slow one should come first, with the worst of its renders")
+            {
+                REQUIRE(slowest.size() == 1);
+                REQUIRE(slowest.front().filePath == filePath);
+                REQUIRE(slowest.front().indexInFile == 7);
+                REQUIRE(slowest.front().numberOfRenders == 2);
+                REQUIRE(slowest.front().creation == std::chrono::seconds{600});
+                REQUIRE(slowest.front().render == std::chrono::seconds{900});
+                REQUIRE(slowest.front().outputBytes == 4096);
+            }
+
+            THEN("The report should name it by file and page number")
+            {
+                const std::string report = Metrics::describeSlowestPages(1);
+
+                REQUIRE(report == filePath + ", page 8: 600000.0 ms to create, 900000.0 ms to render (2 times, up to 4.0 KB)");
+            }
+        }
+    }
+}
@@ -0,0 +1,59 @@
+#include <catch.hpp>
+#include <pagedigest.hpp>
+
+using namespace Slicer;
+
+SCENARIO("Comparing the digests of two versions of a file tells which pages changed")
+{
+    GIVEN("The digests of a file with three pages")
+    {
+        const std::vector<std::uint64_t> before{1, 2, 3};
+
+        WHEN("Nothing changed")
+        {
+            const PageDigest::Changes changes = PageDigest::compare(before, before);
+
+            THEN("There are no changes")
+            REQUIRE(changes.isEmpty());
+        }
+
+        WHEN("The second page changed")
+        {
+            const PageDigest::Changes changes = PageDigest::compare(before, {1, 5, 3});
+
+            THEN("Only that page is changed")
+            {
+                REQUIRE(!changes.isEmpty());
+                REQUIRE(changes.changedPages == std::vector<unsigned int>{1});
+                REQUIRE(changes.numberOfAddedPages() == 0);
+                REQUIRE(changes.numberOfRemovedPages() == 0);
+            }
+        }
+
+        WHEN("Two pages were appended")
+        {
+            const PageDigest::Changes changes = PageDigest::compare(before, {1, 2, 3, 4, 5});
+
+            THEN("No page changed, and two were added")
+            {
+                REQUIRE(!changes.isEmpty());
+                REQUIRE(changes.changedPages.empty());
+                REQUIRE(changes.numberOfAddedPages() == 2);
+                REQUIRE(changes.numberOfRemovedPages() == 0);
+            }
+        }
+
+        WHEN("The last page was removed")
+        {
+            const PageDigest::Changes changes = PageDigest::compare(before, {1, 2});
+
+            THEN("No page changed, and one was removed")
+            {
+                REQUIRE(!changes.isEmpty());
+                REQUIRE(changes.changedPages.empty());
+                REQUIRE(changes.numberOfAddedPages() == 0);
+                REQUIRE(changes.numberOfRemovedPages() == 1);
+            }
+        }
+    }
+}
@@ -0,0 +1,75 @@
+#include <catch.hpp>
+#include <pagehash.hpp>
+#include <cmath>
+
+using namespace Slicer;
+
+// A page with a title and a paragraph, starting at indent across, drawn at any size
+static Glib::RefPtr<Gdk::Pixbuf> createPage(int width, int height, double indent)
+{
+    auto page = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, true, 8, width, height);
+
+    for (int y = 0; y < height; ++y) {
+        std::uint8_t* row = page->get_pixels() + y * page->get_rowstride(); //NOLINT
+        const double v = static_cast<double>(y) / height;
+
+        for (int x = 0; x < width; ++x) {
+            const double u = static_cast<double>(x) / width;
+            const bool isTitle = v > 0.1 && v < 0.18 && u > indent + 0.11 && u < 0.7;
+            const bool isText = v > 0.3 && v < 0.9 && u > indent && u < 0.84 && std::fmod(v * 20, 1.0) < 0.5;
+            const std::uint8_t level = isTitle || isText ? 30 : 250;
+
+            for (int channel = 0; channel < 3; ++channel)
+                row[4 * x + channel] = level; //NOLINT
+            row[4 * x + 3] = 255; //NOLINT
+        }
+    }
+
+    return page;
+}
+
+SCENARIO("Hashing what pages look like")
+{
+    GIVEN("Thumbnails of a page at two sizes, and of another page")
+    {
+        const std::optional<std::uint64_t> small = PageHash::differenceHash(createPage(71, 100, 0.16));
+        const std::optional<std::uint64_t> big = PageHash::differenceHash(createPage(283, 400, 0.16));
+        const std::optional<std::uint64_t> other = PageHash::differenceHash(createPage(71, 100, 0.49));
+
+        THEN("The same page hashes close, and the other one far")
+        {
+            REQUIRE(small.has_value());
+            REQUIRE(big.has_value());
+            REQUIRE(other.has_value());
+            REQUIRE(PageHash::distance(*small, *big) <= PageHash::maximumDuplicateDistance);
+            REQUIRE(PageHash::distance(*small, *other) > PageHash::maximumDuplicateDistance);
+        }
+    }
+
+    GIVEN("An image smaller than the grid")
+    {
+        THEN("It has no hash")
+        REQUIRE_FALSE(PageHash::differenceHash(createPage(4, 4, 0.16)).has_value());
+    }
+}
+
+SCENARIO("Finding duplicate pages by their hashes")
+{
+    GIVEN("Hashes with repeats, near repeats and a page without a hash")
+    {
+        const std::vector<std::optional<std::uint64_t>> hashes{0x0123456789abcdef,
+                                                               0xfedcba9876543210,
+                                                               0x0123456789abcdef,
+                                                               std::nullopt,
+                                                               0x0123456789abcdef ^ 0x8000000000000101,
+                                                               0x0123456789abcdef ^ 0x00000000000f0f00};
+
+        WHEN("The duplicates are looked for")
+        {
+            const std::vector<unsigned int> duplicates = PageHash::findDuplicates(hashes);
+
+            THEN("The pages like an earlier one are found, and not those first ones")
+            REQUIRE(duplicates == std::vector<unsigned int>{2, 4});
+        }
+    }
+}
@@ -0,0 +1,88 @@
+#include <catch.hpp>
+#include <glibmm/fileutils.h>
+#include <glibmm/miscutils.h>
+#include <pageindex.hpp>
+#include <cstdio>
+
+using namespace Slicer;
+
+SCENARIO("Remembering the pages of a file in the page index")
+{
+    GIVEN("An enabled page index and the pages of a file")
+    {
+        const std::string directory = Glib::build_filename(Glib::get_tmp_dir(), "pdfslicer-test-page-index");
+        PageIndex::setDirectory(directory);
+
+        const PageIndex::Key key{"0123456789abcdef", 1234, 5678};
+        const std::vector<PageIndex::Entry> entries{{595, 842, 0, 3}, {842, 595, 90, 2048}};
+        PageIndex::store(key, entries);
+
+        WHEN("They are loaded with the same key")
+        {
+            const std::optional<std::vector<PageIndex::Entry>> loaded = PageIndex::load(key);
+
+            THEN("They should be the stored ones")
+            {
+                REQUIRE(loaded.has_value());
+                REQUIRE(loaded->size() == 2);
+                REQUIRE(loaded->at(1).width == 842);
+                REQUIRE(loaded->at(1).height == 595);
+                REQUIRE(loaded->at(1).rotation == 90);
+                REQUIRE(loaded->at(1).renderCost == 2048);
+            }
+        }
+
+        WHEN("The file has been modified since")
+        {
+            const PageIndex::Key modified{key.fileHash, key.fileSize, key.modificationTime + 1};
+
+            THEN("Nothing should be loaded")
+            REQUIRE_FALSE(PageIndex::load(modified).has_value());
+        }
+
+        std::remove(Glib::build_filename(directory, key.fileHash + ".index").c_str());
+        PageIndex::setDirectory({});
+    }
+}
+
+SCENARIO("Keeping page indexes in memory")
+{
+    GIVEN("A page index kept in memory only, and the pages of a file")
+    {
+        PageIndex::setMemoryBudget(1024 * 1024);
+
+        const PageIndex::Key key{"fedcba9876543210", 4321, 8765};
+        const std::vector<PageIndex::Entry> entries{{595, 842, 0, 3}, {842, 595, 90, 2048}};
+        PageIndex::store(key, entries);
+
+        WHEN("They are loaded with the same key")
+        {
+            const std::optional<std::vector<PageIndex::Entry>> loaded = PageIndex::load(key);
+
+            THEN("They should be the stored ones, without a directory")
+            {
+                REQUIRE(loaded.has_value());
+                REQUIRE(loaded->size() == 2);
+                REQUIRE(loaded->at(1).rotation == 90);
+            }
+        }
+
+        WHEN("The file has been modified since")
+        {
+            const PageIndex::Key modified{key.fileHash, key.fileSize, key.modificationTime + 1};
+
+            THEN("Nothing should be loaded")
+            REQUIRE_FALSE(PageIndex::load(modified).has_value());
+        }
+
+        WHEN("The budget goes down to nothing")
+        {
+            PageIndex::setMemoryBudget(0);
+
+            THEN("Nothing should be kept")
+            REQUIRE_FALSE(PageIndex::load(key).has_value());
+        }
+
+        PageIndex::setMemoryBudget(0);
+    }
+}
@@ -0,0 +1,91 @@
+#include "common.hpp"
+#include <catch.hpp>
+#include <command.hpp>
+#include <document.hpp>
+
+using namespace Slicer;
+
+SCENARIO("Making the pages of a document only when they are asked for")
+{
+    GIVEN("A multipage PDF document with 15 pages")
+    {
+        auto multipagePdfFile = Gio::File::create_for_path(multipage1Path);
+        Document doc{multipagePdfFile};
+        REQUIRE(doc.pages()->get_n_items() == 15);
+
+        WHEN("A page is asked for twice while it's held")
+        {
+            const Glib::RefPtr<Page> page = doc.getPage(3);
+
+            THEN("The same page should be handed out")
+            REQUIRE(doc.getPage(3) == page);
+
+            THEN("The page should know where it is")
+            REQUIRE(page->getDocumentIndex() == 3);
+
+            THEN("The page should be the one of its row")
+            REQUIRE(page->listKey() == doc.pages()->rowAt(3).key());
+        }
+
+        WHEN("A page that no one holds is rotated")
+        {
+            doc.rotatePagesRight({5});
+
+            THEN("It should be made rotated")
+            REQUIRE(doc.getPage(5)->currentRotation() == 90);
+
+            THEN("Its row should say so")
+            REQUIRE(doc.pages()->rowAt(5).currentRotation() == 90);
+        }
+
+        WHEN("A held page is rotated")
+        {
+            const Glib::RefPtr<Page> page = doc.getPage(5);
+            doc.rotatePagesLeft({5});
+
+            THEN("The page itself should be rotated")
+            REQUIRE(page->currentRotation() == 270);
+        }
+
+        WHEN("Pages before a held page are removed")
+        {
+            const Glib::RefPtr<Page> page = doc.getPage(10);
+            const std::vector<Glib::RefPtr<Page>> removedPages = doc.removePages({0, 2});
+
+            THEN("The held page should be renumbered")
+            REQUIRE(page->getDocumentIndex() == 8);
+
+            THEN("The held page should still be handed out at its new place")
+            REQUIRE(doc.getPage(8) == page);
+
+            AND_WHEN("The removed ones are inserted back")
+            {
+                doc.insertPages(removedPages);
+
+                THEN("They should be handed out again, not new copies")
+                {
+                    REQUIRE(doc.getPage(0) == removedPages.at(0));
+                    REQUIRE(doc.getPage(2) == removedPages.at(1));
+                    REQUIRE(doc.getPage(10) == page);
+                }
+            }
+        }
+
+        WHEN("A range of pages is moved and the move undone")
+        {
+            const PageListModel::Key firstKey = doc.pages()->rowAt(0).key();
+            MovePageRangeCommand command{doc, 0, 4, 10};
+            command.execute();
+            command.undo();
+
+            THEN("The pages should be back at their rows")
+            {
+                for (unsigned int i = 0; i < doc.numberOfPages(); ++i)
+                    REQUIRE(doc.getPage(i)->indexInFile() == i);
+            }
+
+            THEN("The first row should be the same as before")
+            REQUIRE(doc.pages()->rowAt(0).key() == firstKey);
+        }
+    }
+}
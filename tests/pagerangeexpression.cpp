@@ -0,0 +1,69 @@
+#include <catch.hpp>
+#include <pagerangeexpression.hpp>
+#include <stdexcept>
+
+using namespace Slicer;
+
+SCENARIO("Parsing page range expressions")
+{
+    GIVEN("A document with 20 pages")
+    {
+        const unsigned int numberOfPages = 20;
+
+        THEN("Single pages, ranges and open ranges are understood")
+        {
+            REQUIRE(parsePageSelection("3", numberOfPages).selectedIndexes() == std::vector<unsigned int>{2});
+            REQUIRE(parsePageSelection("1-3, 19-", numberOfPages).selectedIndexes()
+                    == std::vector<unsigned int>{0, 1, 2, 18, 19});
+            REQUIRE(parsePageSelection("18-end", numberOfPages).selectedIndexes()
+                    == std::vector<unsigned int>{17, 18, 19});
+        }
+
+        THEN("Ranges with a step select every nth page from their first one")
+        {
+            REQUIRE(parsePageSelection("2-end/5", numberOfPages).selectedIndexes()
+                    == std::vector<unsigned int>{1, 6, 11, 16});
+            REQUIRE(parsePageSelection("all/10", numberOfPages).selectedIndexes()
+                    == std::vector<unsigned int>{0, 10});
+        }
+
+        THEN("Odd, even and all pages can be named")
+        {
+            REQUIRE(parsePageSelection("odd", numberOfPages).count() == 10);
+            REQUIRE(parsePageSelection("even", numberOfPages).isSelected(1));
+            REQUIRE(parsePageSelection("all", numberOfPages).count() == numberOfPages);
+        }
+
+        THEN("Malformed expressions are rejected")
+        {
+            REQUIRE_THROWS_AS(parsePageSelection("", numberOfPages), std::runtime_error);
+            REQUIRE_THROWS_AS(parsePageSelection("1,,2", numberOfPages), std::runtime_error);
+            REQUIRE_THROWS_AS(parsePageSelection("0", numberOfPages), std::runtime_error);
+            REQUIRE_THROWS_AS(parsePageSelection("5-3", numberOfPages), std::runtime_error);
+            REQUIRE_THROWS_AS(parsePageSelection("1-21", numberOfPages), std::runtime_error);
+            REQUIRE_THROWS_AS(parsePageSelection("1-5/0", numberOfPages), std::runtime_error);
+            REQUIRE_THROWS_AS(parsePageSelection("first", numberOfPages), std::runtime_error);
+        }
+    }
+
+    GIVEN("A document with 100000 pages")
+    {
+        const unsigned int numberOfPages = 100000;
+
+        WHEN("A pattern of ranges spanning many words is selected")
+        {
+            const SelectionModel selection = parsePageSelection("1-100, 250, 400-end/3", numberOfPages);
+
+            THEN("The count and the bounds should match the pattern")
+            {
+                REQUIRE(selection.count() == 100 + 1 + (100000 - 400) / 3 + 1);
+                REQUIRE(selection.first() == 0U);
+                REQUIRE(selection.isSelected(249));
+                REQUIRE(!selection.isSelected(250));
+                REQUIRE(selection.isSelected(399));
+                REQUIRE(selection.isSelected(402));
+                REQUIRE(!selection.isSelected(400));
+            }
+        }
+    }
+}
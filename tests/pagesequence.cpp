@@ -0,0 +1,235 @@
+#include "common.hpp"
+#include <catch.hpp>
+#include <command.hpp>
+#include <thread>
+
+using namespace Slicer;
+
+SCENARIO("Editing a document through a page sequence")
+{
+    GIVEN("A multipage PDF document with 15 pages")
+    {
+        auto multipagePdfFile = Gio::File::create_for_path(multipage1Path);
+        Document doc{multipagePdfFile};
+        REQUIRE(doc.numberOfPages() == 15);
+
+        unsigned int itemsChangedCount = 0;
+        doc.pages()->signal_items_changed().connect([&](guint, guint, guint) {
+            ++itemsChangedCount;
+        });
+
+        WHEN("Odd pages are removed, the rest rotated and a block moved, in one sequence")
+        {
+            PageSequence sequence = doc.pageSequence();
+            sequence.remove({1, 3, 5, 7, 9, 11, 13});
+            sequence.rotate({0, 1, 2, 3, 4, 5, 6, 7}, 1);
+            sequence.moveRange(0, 1, 6);
+            doc.setPageSequence(sequence);
+
+            THEN("The document should have 8 pages")
+            REQUIRE(doc.numberOfPages() == 8);
+
+            THEN("The moved block should be at the end")
+            {
+                REQUIRE(doc.getPage(0)->indexInFile() == 4);
+                REQUIRE(doc.getPage(6)->indexInFile() == 0);
+                REQUIRE(doc.getPage(7)->indexInFile() == 2);
+            }
+
+            THEN("Every page should be rotated")
+            for (unsigned int i = 0; i < doc.numberOfPages(); ++i)
+                REQUIRE(doc.getPage(i)->currentRotation() == 90);
+
+            THEN("The pages should be renumbered")
+            for (unsigned int i = 0; i < doc.numberOfPages(); ++i)
+                REQUIRE(doc.getPage(i)->getDocumentIndex() == i);
+
+            THEN("The view should be notified only once")
+            REQUIRE(itemsChangedCount == 1);
+        }
+
+        WHEN("Only the middle of the document changes")
+        {
+            unsigned int changedPosition = 0;
+            unsigned int changedRemovals = 0;
+            doc.pages()->signal_items_changed().connect([&](guint position, guint removed, guint) {
+                changedPosition = position;
+                changedRemovals = removed;
+            });
+
+            PageSequence sequence = doc.pageSequence();
+            sequence.moveRange(6, 7, 8);
+            doc.setPageSequence(sequence);
+
+            THEN("Only the pages that moved should be replaced")
+            {
+                REQUIRE(changedPosition == 6);
+                REQUIRE(changedRemovals == 4);
+            }
+        }
+
+        WHEN("Pages are only rotated")
+        {
+            std::vector<unsigned int> rotatedPages;
+            doc.pagesRotated.connect([&](const std::vector<unsigned int>& pages) {
+                rotatedPages = pages;
+            });
+
+            PageSequence sequence = doc.pageSequence();
+            sequence.rotate({2, 4}, -1);
+            doc.setPageSequence(sequence);
+
+            THEN("The page list should be left alone")
+            REQUIRE(itemsChangedCount == 0);
+
+            THEN("The rotated pages should be notified")
+            {
+                REQUIRE(rotatedPages == std::vector<unsigned int>{2, 4});
+                REQUIRE(doc.getPage(2)->currentRotation() == 270);
+            }
+        }
+
+        WHEN("The same edits are done with a command, which is then undone")
+        {
+            EditPagesCommand command{doc, [](PageSequence& sequence) {
+                                         sequence.remove({0, 1, 2});
+                                         sequence.rotate({0}, 2);
+                                     }};
+            command.execute();
+            REQUIRE(doc.numberOfPages() == 12);
+
+            command.undo();
+
+            THEN("The document should be back to its original state")
+            {
+                REQUIRE(doc.numberOfPages() == 15);
+
+                for (unsigned int i = 0; i < doc.numberOfPages(); ++i) {
+                    REQUIRE(doc.getPage(i)->indexInFile() == i);
+                    REQUIRE(doc.getPage(i)->getDocumentIndex() == i);
+                    REQUIRE(doc.getPage(i)->currentRotation() == 0);
+                }
+            }
+
+            THEN("The command should account for the pages it keeps alive")
+            REQUIRE(command.sizeInBytes() >= 3 * doc.getPage(0)->sizeInBytes());
+        }
+
+        WHEN("A command is prepared on another thread before each step")
+        {
+            EditPagesCommand command{doc, [](PageSequence& sequence) {
+                                         sequence.remove({0, 1, 2});
+                                         sequence.rotate({0}, 1);
+                                     }};
+            const auto prepareApart = [&command]() {
+                std::thread{[&command]() { command.prepare(); }}.join();
+            };
+
+            prepareApart();
+            command.execute();
+            const unsigned int numberOfPagesExecuted = doc.numberOfPages();
+            prepareApart();
+            command.undo();
+            const unsigned int numberOfPagesUndone = doc.numberOfPages();
+            prepareApart();
+            command.redo();
+
+            THEN("Each step should apply what was prepared")
+            {
+                REQUIRE(numberOfPagesExecuted == 12);
+                REQUIRE(numberOfPagesUndone == 15);
+                REQUIRE(doc.numberOfPages() == 12);
+                REQUIRE(doc.getPage(0)->indexInFile() == 3);
+                REQUIRE(doc.getPage(0)->currentRotation() == 90);
+                REQUIRE(doc.getPage(11)->getDocumentIndex() == 11);
+            }
+        }
+
+        WHEN("The document changes between preparing a command and executing it")
+        {
+            EditPagesCommand command{doc, [](PageSequence& sequence) { sequence.remove({0}); }};
+            command.prepare();
+            doc.rotatePages({5}, 1);
+            command.execute();
+
+            THEN("The edit should be done on the document as it is by then")
+            {
+                REQUIRE(doc.numberOfPages() == 14);
+                REQUIRE(doc.getPage(4)->indexInFile() == 5);
+                REQUIRE(doc.getPage(4)->currentRotation() == 90);
+            }
+        }
+    }
+}
+
+static std::vector<unsigned int> pageOrder(const PageSequence& sequence)
+{
+    std::vector<unsigned int> result;
+
+    for (const PageSequence::Record& record : sequence)
+        result.push_back(record.page->getDocumentIndex());
+
+    return result;
+}
+
+SCENARIO("Page sequences share what didn't change between versions")
+{
+    GIVEN("A document with 75 pages, more than one chunk of a page sequence")
+    {
+        const auto file = Gio::File::create_for_path(multipage1Path);
+        Document doc{std::vector<Glib::RefPtr<Gio::File>>(5, file)};
+        REQUIRE(doc.numberOfPages() == 75);
+        REQUIRE(doc.numberOfPages() > PageSequence::chunkSize);
+
+        const PageSequence before = doc.pageSequence();
+
+        WHEN("A single page is rotated")
+        {
+            PageSequence after = before;
+            after.rotate({0}, 1);
+
+            THEN("Only the chunk of that page should be new")
+            {
+                const std::size_t newBytes = after.sizeInBytesNotSharedWith(before);
+                REQUIRE(newBytes < before.sizeInBytesNotSharedWith(PageSequence{}));
+                REQUIRE(newBytes > after.sizeInBytesNotSharedWith(after));
+            }
+
+            THEN("The original version should be untouched")
+            REQUIRE(before.at(0).rotation == 0);
+        }
+
+        WHEN("The document is asked for its sequence again, without edits in between")
+        {
+            const PageSequence again = doc.pageSequence();
+
+            THEN("Every chunk should be shared")
+            REQUIRE(again.sizeInBytesNotSharedWith(before) == before.sizeInBytesNotSharedWith(before));
+        }
+
+        WHEN("Ranges are moved around many times, fragmenting the chunks")
+        {
+            PageSequence sequence = before;
+            std::vector<unsigned int> expected = pageOrder(before);
+
+            for (unsigned int i = 0; i < 200; ++i) {
+                const unsigned int first = (i * 7) % 70;
+                const unsigned int last = first + i % 5;
+                const unsigned int destination = (i * 13) % (75 - (last - first));
+
+                sequence.moveRange(first, last, destination);
+
+                std::vector<unsigned int> range{expected.begin() + first, expected.begin() + last + 1};
+                expected.erase(expected.begin() + first, expected.begin() + last + 1);
+                expected.insert(expected.begin() + destination, range.begin(), range.end());
+            }
+
+            THEN("The order should match the same moves done on a plain vector")
+            REQUIRE(pageOrder(sequence) == expected);
+
+            THEN("Random access should agree with iteration")
+            for (unsigned int i = 0; i < sequence.size(); ++i)
+                REQUIRE(sequence.at(i).page->getDocumentIndex() == expected.at(i));
+        }
+    }
+}
@@ -0,0 +1,69 @@
+#include "common.hpp"
+#include <catch.hpp>
+#include <document.hpp>
+#include <numeric>
+
+using namespace Slicer;
+
+SCENARIO("Asking about the whole document through its page table")
+{
+    GIVEN("A multipage PDF document with 15 pages")
+    {
+        auto multipagePdfFile = Gio::File::create_for_path(multipage1Path);
+        Document doc{multipagePdfFile};
+        REQUIRE(doc.numberOfPages() == 15);
+
+        const PageTable& table = doc.pageTable();
+
+        THEN("The table should mirror the pages")
+        {
+            REQUIRE(table.size() == 15);
+
+            for (unsigned int i = 0; i < table.size(); ++i) {
+                REQUIRE(table.indexesInFile().at(i) == doc.getPage(i)->indexInFile());
+                REQUIRE(table.widths().at(i) == doc.getPage(i)->size().width);
+                REQUIRE(table.currentRotations().at(i) == doc.getPage(i)->currentRotation());
+            }
+        }
+
+        THEN("Every page should be either portrait or landscape")
+        REQUIRE(table.pagesWithOrientation(PageTable::Orientation::Portrait).size()
+                    + table.pagesWithOrientation(PageTable::Orientation::Landscape).size()
+                == 15);
+
+        THEN("The total area should add up every page")
+        {
+            double area = 0;
+            for (unsigned int i = 0; i < doc.numberOfPages(); ++i)
+                area += static_cast<double>(doc.getPage(i)->size().width) * doc.getPage(i)->size().height;
+
+            REQUIRE(table.totalArea() == Approx(area));
+        }
+
+        WHEN("Every page is turned a quarter")
+        {
+            const std::vector<unsigned int> portraitBefore = doc.pageTable().pagesWithOrientation(PageTable::Orientation::Portrait);
+
+            std::vector<unsigned int> allPages(doc.numberOfPages());
+            std::iota(allPages.begin(), allPages.end(), 0);
+            doc.rotatePages(allPages, 1);
+
+            THEN("The portrait pages should now be the landscape ones")
+            REQUIRE(doc.pageTable().pagesWithOrientation(PageTable::Orientation::Landscape) == portraitBefore);
+
+            THEN("The table should have the new rotations")
+            REQUIRE(doc.pageTable().currentRotations().at(0) == (doc.getPage(0)->sourceRotation() + 90) % 360);
+        }
+
+        WHEN("Pages are removed")
+        {
+            doc.removePageRange(0, 4);
+
+            THEN("The table should be built again")
+            {
+                REQUIRE(doc.pageTable().size() == 10);
+                REQUIRE(doc.pageTable().indexesInFile().at(0) == 5);
+            }
+        }
+    }
+}
@@ -0,0 +1,512 @@
+#include "common.hpp"
+#include <catch.hpp>
+#include <document.hpp>
+#include <glibmm/fileutils.h>
+#include <tempfile.hpp>
+#include <unistd.h>
+#include <array>
+#include <fstream>
+#include <thread>
+
+using namespace Slicer;
+
+SCENARIO("Saving a merged document repeatedly with a parsed file cache")
+{
+    GIVEN("A document made of three files")
+    {
+        Document doc{std::vector<Glib::RefPtr<Gio::File>>{Gio::File::create_for_path(multipage1Path),
+                                                          Gio::File::create_for_path(multipage2Path),
+                                                          Gio::File::create_for_path(multipage3Path)}};
+        REQUIRE(doc.numberOfPages() == 35);
+
+        WHEN("The document is saved, changed and saved again with the same cache")
+        {
+            const Glib::RefPtr<Gio::File> firstSave = TempFile::generate();
+            PdfSaver{doc.getSaveData(), doc.parsedFileCache()}.save(firstSave);
+
+            doc.rotatePagesRight({20});
+            doc.removePageRange(0, 4);
+
+            const Glib::RefPtr<Gio::File> secondSave = TempFile::generate();
+            PdfSaver{doc.getSaveData(), doc.parsedFileCache()}.save(secondSave);
+
+            THEN("Both saves should have the pages the document had at the time")
+            {
+                REQUIRE(Document{firstSave}.numberOfPages() == 35);
+                REQUIRE(Document{secondSave}.numberOfPages() == 30);
+            }
+
+            THEN("A later save should have the rotations the document has at that time")
+            {
+                const Glib::RefPtr<Gio::File> thirdSave = TempFile::generate();
+                doc.rotatePagesLeft({15});
+                PdfSaver{doc.getSaveData(), doc.parsedFileCache()}.save(thirdSave);
+
+                Document result{thirdSave};
+                REQUIRE(result.getPage(15)->currentRotation() == 0);
+            }
+        }
+    }
+}
+
+SCENARIO("Saving after the files were prepared ahead of the save")
+{
+    GIVEN("A document made of two files, prepared in its cache")
+    {
+        Document doc{std::vector<Glib::RefPtr<Gio::File>>{Gio::File::create_for_path(multipage1Path),
+                                                          Gio::File::create_for_path(multipage2Path)}};
+        doc.rotatePagesRight({3});
+        const PdfSaver::SaveData saveData = doc.getSaveData();
+        doc.parsedFileCache()->prepare(saveData);
+
+        REQUIRE(doc.parsedFileCache()->contains(saveData.files.at(0)->get_path()));
+        REQUIRE(doc.parsedFileCache()->contains(saveData.files.at(1)->get_path()));
+
+        WHEN("The document is saved with that cache")
+        {
+            const Glib::RefPtr<Gio::File> file = TempFile::generate();
+            PdfSaver{doc.getSaveData(), doc.parsedFileCache()}.save(file);
+
+            THEN("The result should have the pages and rotations of the document")
+            {
+                Document result{file};
+                REQUIRE(result.numberOfPages() == doc.numberOfPages());
+                REQUIRE(result.getPage(3)->currentRotation() == 90);
+            }
+
+            THEN("The first file should no longer be prepared, but the others should be kept")
+            {
+                REQUIRE_FALSE(doc.parsedFileCache()->contains(saveData.files.at(0)->get_path()));
+                REQUIRE(doc.parsedFileCache()->contains(saveData.files.at(1)->get_path()));
+            }
+        }
+    }
+}
+
+SCENARIO("Saving with the different write profiles")
+{
+    GIVEN("A document made of two files, with some pages removed")
+    {
+        Document doc{std::vector<Glib::RefPtr<Gio::File>>{Gio::File::create_for_path(multipage1Path),
+                                                          Gio::File::create_for_path(multipage2Path)}};
+        doc.removePageRange(2, 6);
+        const unsigned int expectedPages = doc.numberOfPages();
+
+        for (PdfSaver::WriteProfile profile : {PdfSaver::WriteProfile::Default,
+                                               PdfSaver::WriteProfile::Smallest,
+                                               PdfSaver::WriteProfile::Fastest,
+                                               PdfSaver::WriteProfile::FastWebView}) {
+            WHEN("The document is saved with the " + PdfSaver::writeProfileName(profile) + " profile")
+            {
+                const Glib::RefPtr<Gio::File> file = TempFile::generate();
+                PdfSaver saver{doc.getSaveData()};
+                saver.setWriteProfile(profile);
+                saver.save(file);
+
+                THEN("The result should have every page left in the document")
+                REQUIRE(Document{file}.numberOfPages() == expectedPages);
+
+                THEN("The profile should be known by its name")
+                REQUIRE(PdfSaver::writeProfileFromName(PdfSaver::writeProfileName(profile)) == profile);
+            }
+        }
+    }
+}
+
+SCENARIO("Saving a few rotations of a single file as an incremental update")
+{
+    GIVEN("A document made of a single file")
+    {
+        const Glib::RefPtr<Gio::File> source = Gio::File::create_for_path(multipage1Path);
+        const goffset sourceSize = source->query_info(G_FILE_ATTRIBUTE_STANDARD_SIZE)->get_size();
+        Document doc{source};
+
+        WHEN("Two pages are rotated and the document is saved")
+        {
+            doc.rotatePagesRight({1, 4});
+
+            const Glib::RefPtr<Gio::File> file = TempFile::generate();
+            PdfSaver{doc.getSaveData()}.save(file);
+
+            THEN("The result should be the original file plus a small update")
+            {
+                const goffset resultSize = file->query_info(G_FILE_ATTRIBUTE_STANDARD_SIZE)->get_size();
+                REQUIRE(resultSize > sourceSize);
+                REQUIRE(resultSize - sourceSize < 16 * 1024);
+            }
+
+            THEN("The result should have the rotations of the document")
+            {
+                Document result{file};
+                REQUIRE(result.numberOfPages() == doc.numberOfPages());
+
+                for (unsigned int i = 0; i < doc.numberOfPages(); ++i)
+                    REQUIRE(result.getPage(i)->currentRotation() == doc.getPage(i)->currentRotation());
+            }
+        }
+
+        WHEN("A page is removed and the document is saved")
+        {
+            doc.removePage(3);
+
+            const Glib::RefPtr<Gio::File> file = TempFile::generate();
+            PdfSaver{doc.getSaveData()}.save(file);
+
+            THEN("The document should be written in full")
+            REQUIRE(Document{file}.numberOfPages() == 14);
+        }
+    }
+}
+
+SCENARIO("Saving a file that wasn't changed as a copy of it")
+{
+    GIVEN("A document made of a single file")
+    {
+        Document doc{Gio::File::create_for_path(multipage1Path)};
+
+        THEN("Its save data should tell it's unchanged")
+        REQUIRE(doc.getSaveData().isUnchanged);
+
+        WHEN("It's saved as it is")
+        {
+            const Glib::RefPtr<Gio::File> file = TempFile::generate();
+            PdfSaver{doc.getSaveData()}.save(file);
+
+            THEN("The result should be the same file")
+            REQUIRE(Document::contentHashOf(file->get_path()) == Document::contentHashOf(multipage1Path));
+        }
+
+        WHEN("It's saved with the smallest write profile")
+        {
+            const Glib::RefPtr<Gio::File> file = TempFile::generate();
+            PdfSaver saver{doc.getSaveData()};
+            saver.setWriteProfile(PdfSaver::WriteProfile::Smallest);
+            saver.save(file);
+
+            THEN("The result should be written anew, with every page")
+            {
+                REQUIRE(Document::contentHashOf(file->get_path()) != Document::contentHashOf(multipage1Path));
+                REQUIRE(Document{file}.numberOfPages() == 15);
+            }
+        }
+
+        WHEN("A page is rotated")
+        {
+            doc.rotatePagesRight({2});
+
+            THEN("It should have changed")
+            REQUIRE(!doc.getSaveData().isUnchanged);
+
+            THEN("Rotating it back should leave it unchanged again")
+            {
+                doc.rotatePagesLeft({2});
+                REQUIRE(doc.getSaveData().isUnchanged);
+            }
+        }
+
+        WHEN("Two pages swap places")
+        {
+            doc.movePage(0, 1);
+
+            THEN("It should have changed")
+            REQUIRE(!doc.getSaveData().isUnchanged);
+        }
+    }
+}
+
+SCENARIO("Following and canceling a save")
+{
+    GIVEN("A document made of two files")
+    {
+        Document doc{std::vector<Glib::RefPtr<Gio::File>>{Gio::File::create_for_path(multipage1Path),
+                                                          Gio::File::create_for_path(multipage2Path)}};
+
+        WHEN("The document is saved with a monitor")
+        {
+            std::vector<PdfSaver::Progress> reports;
+            PdfSaver::Monitor monitor;
+            monitor.onProgress = [&reports](const PdfSaver::Progress& progress) {
+                reports.push_back(progress);
+            };
+
+            const Glib::RefPtr<Gio::File> file = TempFile::generate();
+            PdfSaver{doc.getSaveData(), PdfSaver::Mode::Default, monitor}.save(file);
+
+            THEN("Progress should go through every stage, always forward, up to the end")
+            {
+                REQUIRE(reports.front().stage == PdfSaver::Progress::Stage::Parsing);
+                REQUIRE(reports.back().stage == PdfSaver::Progress::Stage::Done);
+                REQUIRE(reports.back().fraction == 1.0);
+                REQUIRE(reports.back().bytesWritten == static_cast<std::uint64_t>(file->query_info(G_FILE_ATTRIBUTE_STANDARD_SIZE)->get_size()));
+
+                for (std::size_t i = 1; i < reports.size(); ++i) {
+                    REQUIRE(reports.at(i).fraction >= reports.at(i - 1).fraction);
+                    REQUIRE(reports.at(i).stage >= reports.at(i - 1).stage);
+                }
+            }
+        }
+
+        WHEN("A save is canceled while stitching the pages")
+        {
+            auto canceled = std::make_shared<std::atomic<bool>>(false);
+            PdfSaver::Monitor monitor;
+            monitor.canceled = canceled;
+            monitor.onProgress = [canceled](const PdfSaver::Progress& progress) {
+                if (progress.stage == PdfSaver::Progress::Stage::Stitching)
+                    *canceled = true;
+            };
+
+            const Glib::RefPtr<Gio::File> file = TempFile::generate();
+            PdfSaver saver{doc.getSaveData(), PdfSaver::Mode::Default, monitor};
+
+            THEN("The save should stop without leaving anything behind")
+            {
+                REQUIRE_THROWS_AS(saver.save(file), PdfSaver::Canceled);
+                REQUIRE(!file->query_exists());
+
+                // The partial file goes next to the destination
+                const std::string partialPrefix = "." + file->get_basename();
+                for (const std::string& name : Glib::Dir{file->get_parent()->get_path()})
+                    REQUIRE(name.rfind(partialPrefix, 0) == std::string::npos);
+            }
+        }
+
+        WHEN("A save is canceled before it starts")
+        {
+            auto canceled = std::make_shared<std::atomic<bool>>(true);
+            PdfSaver::Monitor monitor;
+            monitor.canceled = canceled;
+
+            THEN("Parsing shouldn't even happen")
+            REQUIRE_THROWS_AS((PdfSaver{doc.getSaveData(), PdfSaver::Mode::Default, monitor}), PdfSaver::Canceled);
+        }
+    }
+}
+
+// Saves into a pipe, and what comes out of the other end into a file
+static Glib::RefPtr<Gio::File> saveThroughPipe(PdfSaver& saver)
+{
+    std::array<int, 2> pipeEnds{};
+    REQUIRE(pipe(pipeEnds.data()) == 0);
+
+    const Glib::RefPtr<Gio::File> received = TempFile::generate();
+    std::thread reader{[&pipeEnds, &received]() {
+        std::ofstream output{received->get_path(), std::ios::binary};
+        std::array<char, 4096> buffer{};
+
+        for (ssize_t count = 0; (count = read(pipeEnds[0], buffer.data(), buffer.size())) > 0;)
+            output.write(buffer.data(), count);
+    }};
+
+    try {
+        saver.saveToDescriptor(pipeEnds[1]);
+    }
+    catch (...) {
+        close(pipeEnds[1]);
+        reader.join();
+        close(pipeEnds[0]);
+        throw;
+    }
+
+    close(pipeEnds[1]);
+    reader.join();
+    close(pipeEnds[0]);
+
+    return received;
+}
+
+SCENARIO("Saving to a pipe, which can't seek")
+{
+    GIVEN("A document made of two files, with some pages removed")
+    {
+        Document doc{std::vector<Glib::RefPtr<Gio::File>>{Gio::File::create_for_path(multipage1Path),
+                                                          Gio::File::create_for_path(multipage2Path)}};
+        doc.removePageRange(0, 2);
+        const unsigned int expectedPages = doc.numberOfPages();
+
+        for (PdfSaver::WriteProfile profile : {PdfSaver::WriteProfile::Default, PdfSaver::WriteProfile::FastWebView}) {
+            WHEN("The document is saved to a pipe with the " + PdfSaver::writeProfileName(profile) + " profile")
+            {
+                PdfSaver saver{doc.getSaveData()};
+                saver.setWriteProfile(profile);
+                const Glib::RefPtr<Gio::File> received = saveThroughPipe(saver);
+
+                THEN("What came out of the pipe should be the whole result")
+                REQUIRE(Document{received}.numberOfPages() == expectedPages);
+            }
+        }
+    }
+}
+
+SCENARIO("Saving parts of a merged document out of a single parse")
+{
+    GIVEN("A document made of two files, with a page rotated")
+    {
+        Document doc{std::vector<Glib::RefPtr<Gio::File>>{Gio::File::create_for_path(multipage1Path),
+                                                          Gio::File::create_for_path(multipage2Path)}};
+        doc.rotatePagesRight({12});
+        const unsigned int numberOfPages = doc.numberOfPages();
+
+        WHEN("The document is saved in two parts, split at the 12th page")
+        {
+            const std::vector<PdfSaver::Part> parts = {{0, 12, TempFile::generate()},
+                                                       {12, numberOfPages, TempFile::generate()}};
+            PdfSaver{doc.getSaveData()}.saveParts(parts);
+
+            THEN("Each part should have its own pages")
+            {
+                REQUIRE(Document{parts.at(0).destinationFile}.numberOfPages() == 12);
+                REQUIRE(Document{parts.at(1).destinationFile}.numberOfPages() == numberOfPages - 12);
+            }
+
+            THEN("The rotated page should open the second part, still rotated")
+            REQUIRE(Document{parts.at(1).destinationFile}.getPage(0)->currentRotation() == 90);
+        }
+    }
+}
+
+SCENARIO("Estimating the size of a save without writing it")
+{
+    GIVEN("The pages of two copies of the same file, whose objects have the same numbers")
+    {
+        const Glib::RefPtr<Gio::File> original = Gio::File::create_for_path(multipage1Path);
+        const Glib::RefPtr<Gio::File> copy = TempFile::generate();
+        original->copy(copy, Gio::FILE_COPY_OVERWRITE);
+
+        PdfSaver::SaveData onlyOriginal{{original}, {}};
+        PdfSaver::SaveData both{{original, copy}, {}};
+        for (unsigned int page = 0; page < 15; ++page) {
+            onlyOriginal.pages.push_back({0, page, 0});
+            both.pages.push_back({0, page, 0});
+            both.pages.push_back({1, page, 0});
+        }
+
+        WHEN("The size of saving both is estimated, and then they are saved")
+        {
+            PdfSaver saver{both};
+            const std::uint64_t estimate = saver.estimatedSize();
+
+            const Glib::RefPtr<Gio::File> file = TempFile::generate();
+            saver.save(file);
+            const auto size = static_cast<std::uint64_t>(file->query_info(G_FILE_ATTRIBUTE_STANDARD_SIZE)->get_size());
+
+            THEN("The estimate should be close to the size of the result")
+            {
+                REQUIRE(estimate > size / 2);
+                REQUIRE(estimate < size * 2);
+            }
+
+            THEN("The objects of the copy should count too")
+            REQUIRE(estimate > PdfSaver{onlyOriginal}.estimatedSize() * 3 / 2);
+        }
+
+        WHEN("Parts of a single byte are estimated")
+        {
+            const std::vector<PdfSaver::PartEstimate> parts = PdfSaver{both}.partsOfSize(1);
+
+            THEN("Every page should get a part of its own, as none fits")
+            {
+                REQUIRE(parts.size() == 30);
+                REQUIRE(parts.back().firstPage == 29);
+                REQUIRE(parts.back().endPage == 30);
+            }
+        }
+    }
+}
+
+SCENARIO("Merging the streams that are the same in every file")
+{
+    GIVEN("The pages of two copies of the same file, bypassing the document, which would merge them itself")
+    {
+        const Glib::RefPtr<Gio::File> original = Gio::File::create_for_path(multipage1Path);
+        const Glib::RefPtr<Gio::File> copy = TempFile::generate();
+        original->copy(copy, Gio::FILE_COPY_OVERWRITE);
+
+        PdfSaver::SaveData saveData{{original, copy}, {}};
+        for (unsigned int file : {0U, 1U})
+            for (unsigned int page = 0; page < 15; ++page)
+                saveData.pages.push_back({file, page, 0});
+
+        WHEN("They are saved with and without merging streams")
+        {
+            const Glib::RefPtr<Gio::File> plain = TempFile::generate();
+            PdfSaver{saveData}.save(plain);
+
+            const Glib::RefPtr<Gio::File> deduplicated = TempFile::generate();
+            PdfSaver saver{saveData};
+            saver.setDeduplicateStreams(true);
+            saver.save(deduplicated);
+
+            const auto sizeOf = [](const Glib::RefPtr<Gio::File>& file) {
+                return file->query_info(G_FILE_ATTRIBUTE_STANDARD_SIZE)->get_size();
+            };
+
+            THEN("Both should have every page")
+            {
+                REQUIRE(Document{plain}.numberOfPages() == 30);
+                REQUIRE(Document{deduplicated}.numberOfPages() == 30);
+            }
+
+            THEN("The merged one should be smaller")
+            REQUIRE(sizeOf(deduplicated) < sizeOf(plain));
+        }
+    }
+}
+
+SCENARIO("Choosing when unused resources are dropped")
+{
+    GIVEN("A document with some pages removed")
+    {
+        Document doc{Gio::File::create_for_path(multipage1Path)};
+        doc.removePageRange(3, 9);
+        const unsigned int expectedPages = doc.numberOfPages();
+
+        for (PdfSaver::ResourceCleanup cleanup : {PdfSaver::ResourceCleanup::WhenPagesLeftOut,
+                                                  PdfSaver::ResourceCleanup::Always,
+                                                  PdfSaver::ResourceCleanup::Never}) {
+            WHEN("The document is saved with the " + PdfSaver::resourceCleanupName(cleanup) + " cleanup")
+            {
+                const Glib::RefPtr<Gio::File> file = TempFile::generate();
+                PdfSaver saver{doc.getSaveData()};
+                saver.setIncrementalUpdates(false);
+                saver.setResourceCleanup(cleanup);
+                saver.save(file);
+
+                THEN("The result should have every page left in the document")
+                REQUIRE(Document{file}.numberOfPages() == expectedPages);
+
+                THEN("The cleanup should be known by its name")
+                REQUIRE(PdfSaver::resourceCleanupFromName(PdfSaver::resourceCleanupName(cleanup)) == cleanup);
+            }
+        }
+    }
+}
+
+SCENARIO("Saving a single file with pages removed and rotated, in their order")
+{
+    GIVEN("A document made of a single file, with pages removed and rotated")
+    {
+        Document doc{Gio::File::create_for_path(multipage1Path)};
+        doc.removePageRange(0, 1);
+        doc.removePage(10);
+        doc.rotatePagesRight({0, 5});
+
+        WHEN("It's saved as a new file")
+        {
+            const Glib::RefPtr<Gio::File> file = TempFile::generate();
+            PdfSaver saver{doc.getSaveData()};
+            saver.setIncrementalUpdates(false);
+            saver.save(file);
+
+            THEN("The result should have the remaining pages, rotated as in the document")
+            {
+                Document result{file};
+                REQUIRE(result.numberOfPages() == 12);
+                REQUIRE(result.getPage(0)->currentRotation() == 90);
+                REQUIRE(result.getPage(1)->currentRotation() == 0);
+                REQUIRE(result.getPage(5)->currentRotation() == 90);
+                REQUIRE(result.getPage(0)->size().width == doc.getPage(0)->size().width);
+            }
+        }
+    }
+}
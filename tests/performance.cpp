@@ -0,0 +1,265 @@
+#include "allocationcounter.hpp"
+#include "common.hpp"
+#include <catch.hpp>
+#include <command.hpp>
+#include <pagerenderer.hpp>
+#include <pdfsaver.hpp>
+#include <tempfile.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace Slicer;
+
+// Fixed scenarios measured against the numbers in performance.baselines,
+// hidden from the default run since they take a while and need a quiet machine
+
+namespace {
+
+struct Measurement {
+    double milliseconds;
+    std::uint64_t allocations;
+};
+
+constexpr double timeTolerance = 1.5;
+constexpr double allocationTolerance = 1.1;
+
+class Baselines {
+public:
+    Baselines()
+    {
+        std::ifstream file{SLICER_PERFORMANCE_BASELINES};
+
+        for (std::string line; std::getline(file, line);) {
+            if (line.empty() || line.front() == '#') {
+                m_comments.push_back(line);
+                continue;
+            }
+
+            std::istringstream fields{line};
+            std::string name;
+            Measurement baseline{};
+
+            if (!(fields >> name))
+                continue;
+
+            if (fields >> baseline.milliseconds >> baseline.allocations)
+                m_baselines[name] = baseline;
+            else
+                m_baselines[name] = std::nullopt;
+        }
+    }
+
+    // Null for scenarios without a line; empty for those whose numbers aren't recorded yet
+    const std::optional<Measurement>* find(const std::string& name) const
+    {
+        const auto it = m_baselines.find(name);
+
+        return it == m_baselines.end() ? nullptr : &it->second;
+    }
+
+    void update(const std::string& name, const Measurement& measurement)
+    {
+        m_baselines[name] = measurement;
+
+        std::ofstream file{SLICER_PERFORMANCE_BASELINES, std::ios::trunc};
+        for (const std::string& comment : m_comments)
+            file << comment << "\n";
+
+        for (const auto& [baselineName, baseline] : m_baselines) {
+            file << baselineName;
+            if (baseline.has_value())
+                file << " " << std::fixed << std::setprecision(2) << baseline->milliseconds << " " << baseline->allocations;
+            file << "\n";
+        }
+    }
+
+private:
+    std::vector<std::string> m_comments;
+    std::map<std::string, std::optional<Measurement>> m_baselines;
+};
+
+Baselines& baselines()
+{
+    static Baselines loaded;
+
+    return loaded;
+}
+
+double timeScale()
+{
+    const char* scale = std::getenv("SLICER_PERFORMANCE_SCALE");
+
+    return scale == nullptr ? 1.0 : std::max(1.0, std::atof(scale));
+}
+
+// The median time of the runs, and the fewest allocations any of them made
+template<typename Function>
+Measurement measure(int iterations, Function&& function)
+{
+    std::vector<double> milliseconds;
+    std::uint64_t allocations = std::numeric_limits<std::uint64_t>::max();
+
+    for (int i = 0; i < iterations; ++i) {
+        const std::uint64_t allocationsBefore = AllocationCounter::count();
+        const auto start = std::chrono::steady_clock::now();
+        function();
+        const auto end = std::chrono::steady_clock::now();
+
+        milliseconds.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+        allocations = std::min(allocations, AllocationCounter::count() - allocationsBefore);
+    }
+
+    std::sort(milliseconds.begin(), milliseconds.end());
+
+    return {milliseconds.at(milliseconds.size() / 2), allocations};
+}
+
+void checkAgainstBaseline(const std::string& name, const Measurement& measurement)
+{
+    if (std::getenv("SLICER_UPDATE_BASELINES") != nullptr) {
+        baselines().update(name, measurement);
+        return;
+    }
+
+    const std::optional<Measurement>* found = baselines().find(name);
+    INFO(name << ": " << measurement.milliseconds << " ms, " << measurement.allocations << " allocations");
+
+    // A scenario that can't fail isn't a regression test
+    if (found == nullptr)
+        FAIL(name << " has no line in performance.baselines");
+    if (!found->has_value())
+        FAIL(name << " has no baseline recorded yet: run it with SLICER_UPDATE_BASELINES=1");
+
+    const Measurement& baseline = found->value();
+    INFO("Baseline: " << baseline.milliseconds << " ms, " << baseline.allocations << " allocations");
+    CHECK(measurement.milliseconds <= baseline.milliseconds * timeTolerance * timeScale());
+    CHECK(static_cast<double>(measurement.allocations) <= static_cast<double>(baseline.allocations) * allocationTolerance);
+}
+
+// The pages of the file, over and over, without opening it more than once
+std::unique_ptr<Document> createLargeDocument(const std::string& filePath, unsigned int numberOfPages)
+{
+    auto document = std::make_unique<Document>();
+    const Document::FileLoader loader{Gio::File::create_for_path(filePath)};
+    const unsigned int fileNumber = document->addLoadedFile(loader);
+
+    std::vector<Glib::RefPtr<Page>> pages;
+    while (pages.size() < numberOfPages) {
+        const auto count = std::min(loader.numberOfPages(), numberOfPages - static_cast<unsigned int>(pages.size()));
+
+        for (const Glib::RefPtr<Page>& page : loader.loadPages(0, count, fileNumber))
+            pages.push_back(page);
+    }
+
+    document->appendPages(pages);
+
+    return document;
+}
+
+} // namespace
+
+SCENARIO("Opening a document stays as fast as its baseline", "[.][performance]")
+{
+    unsigned int numberOfPages = 0;
+
+    const Measurement measurement = measure(5, [&numberOfPages]() {
+        const Document document{Gio::File::create_for_path(multipage1Path)};
+        numberOfPages = document.numberOfPages();
+    });
+
+    REQUIRE(numberOfPages == 15);
+    checkAgainstBaseline("open", measurement);
+}
+
+SCENARIO("Rendering thumbnails stays as fast as its baseline", "[.][performance]")
+{
+    const Document document{Gio::File::create_for_path(multipage1Path)};
+
+    unsigned int numberOfThumbnails = 0;
+
+    const Measurement measurement = measure(5, [&document, &numberOfThumbnails]() {
+        numberOfThumbnails = 0;
+
+        for (unsigned int i = 0; i < document.numberOfPages(); ++i) {
+            if (PageRenderer{document.getPage(i)}.render(200))
+                ++numberOfThumbnails;
+        }
+    });
+
+    REQUIRE(numberOfThumbnails == document.numberOfPages());
+    checkAgainstBaseline("render-thumbnails", measurement);
+}
+
+SCENARIO("Removing every other page and undoing it stays as fast as its baseline", "[.][performance]")
+{
+    const unsigned int numberOfPages = 10000;
+    const std::unique_ptr<Document> document = createLargeDocument(multipage1Path, numberOfPages);
+
+    std::vector<unsigned int> everyOtherPage;
+    for (unsigned int i = 0; i < numberOfPages; i += 2)
+        everyOtherPage.push_back(i);
+
+    const Measurement measurement = measure(10, [&]() {
+        RemovePagesCommand command{*document, everyOtherPage};
+        command.execute();
+        command.undo();
+    });
+
+    REQUIRE(document->numberOfPages() == numberOfPages);
+    checkAgainstBaseline("remove-every-other-page-and-undo", measurement);
+}
+
+SCENARIO("Editing the page sequence of a large document and undoing it stays as fast as its baseline", "[.][performance]")
+{
+    const unsigned int numberOfPages = 10000;
+    const std::unique_ptr<Document> document = createLargeDocument(multipage1Path, numberOfPages);
+
+    std::vector<unsigned int> everyOtherPage;
+    for (unsigned int i = 0; i < numberOfPages; i += 2)
+        everyOtherPage.push_back(i);
+
+    const Measurement measurement = measure(10, [&]() {
+        EditPagesCommand command{*document, [&everyOtherPage](PageSequence& sequence) {
+                                     sequence.remove(everyOtherPage);
+                                 }};
+        command.execute();
+        command.undo();
+    });
+
+    REQUIRE(document->numberOfPages() == numberOfPages);
+    checkAgainstBaseline("edit-sequence-and-undo", measurement);
+}
+
+SCENARIO("Saving a merge stays as fast as its baseline", "[.][performance]")
+{
+    PdfSaver::SaveData saveData;
+
+    for (const std::string& filePath : {multipage1Path, multipage2Path, multipage3Path}) {
+        const auto file = static_cast<unsigned int>(saveData.files.size());
+        const Document document{Gio::File::create_for_path(filePath)};
+        saveData.files.push_back(Gio::File::create_for_path(filePath));
+
+        for (unsigned int page = 0; page < document.numberOfPages(); ++page)
+            saveData.pages.push_back({file, page, 0});
+    }
+
+    const Glib::RefPtr<Gio::File> destination = TempFile::generate();
+
+    const Measurement measurement = measure(3, [&]() {
+        PdfSaver saver{saveData};
+        saver.save(destination);
+    });
+
+    destination->remove();
+    checkAgainstBaseline("save-merge", measurement);
+}
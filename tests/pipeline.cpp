@@ -0,0 +1,133 @@
+#include <catch.hpp>
+#include <glibmm/main.h>
+#include <pipeline.hpp>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace Slicer;
+
+using Clock = std::chrono::steady_clock;
+
+struct Trail {
+    std::vector<int> stages;
+    std::vector<bool> onMainThread;
+};
+
+// Runs the main loop, where the main thread stages run, until done() or the timeout
+template<typename Predicate>
+static bool iterateMainLoopUntil(Predicate done, std::chrono::seconds timeout)
+{
+    const Clock::time_point deadline = Clock::now() + timeout;
+
+    while (!done()) {
+        if (Clock::now() > deadline)
+            return false;
+
+        if (!Glib::MainContext::get_default()->iteration(false))
+            std::this_thread::sleep_for(std::chrono::microseconds{100});
+    }
+
+    return true;
+}
+
+// Gives the workers and the main loop a while to deliver what they shouldn't
+static void iterateMainLoopFor(std::chrono::milliseconds duration)
+{
+    iterateMainLoopUntil([end = Clock::now() + duration]() { return Clock::now() > end; },
+                         std::chrono::seconds{5});
+}
+
+SCENARIO("A pipeline runs its stages in order, each on its own side")
+{
+    GIVEN("A pipeline that goes back and forth between the workers and the main thread")
+    {
+        TaskRunner taskRunner{2};
+        const std::thread::id mainThread = std::this_thread::get_id();
+        auto trail = std::make_shared<Trail>();
+        bool isDone = false;
+
+        const auto stage = [mainThread](int number) {
+            return [mainThread, number](Trail& state) {
+                state.stages.push_back(number);
+                state.onMainThread.push_back(std::this_thread::get_id() == mainThread);
+            };
+        };
+
+        Pipeline<Trail> pipeline{taskRunner, TaskRunner::Priority::Interactive};
+        pipeline.onMainThread(stage(0))
+            .onWorker(stage(1))
+            .onWorker(stage(2))
+            .onMainThread(stage(3))
+            .onMainThread([&isDone, trail](Trail& state) {
+                *trail = state;
+                isDone = true;
+            });
+
+        WHEN("It's started")
+        {
+            pipeline.start();
+
+            THEN("The first main thread stage runs right away, and the rest in order, where they belong")
+            {
+                REQUIRE(iterateMainLoopUntil([&isDone]() { return isDone; }, std::chrono::seconds{10}));
+                REQUIRE(trail->stages == std::vector<int>{0, 1, 2, 3});
+                REQUIRE(trail->onMainThread == std::vector<bool>{true, false, false, true});
+            }
+        }
+    }
+}
+
+SCENARIO("A pipeline stops where a stage tells it to, or where it's canceled")
+{
+    GIVEN("A task runner and a generation")
+    {
+        TaskRunner taskRunner{2};
+        auto generation = std::make_shared<std::atomic_uint>(0);
+        std::atomic<int> numberOfStagesRun = 0;
+        bool isDone = false;
+
+        WHEN("A stage returns false")
+        {
+            Pipeline<int>{taskRunner, TaskRunner::Priority::Interactive}
+                .onWorker([&numberOfStagesRun](int&) {
+                    ++numberOfStagesRun;
+                    return false;
+                })
+                .onMainThread([&isDone](int&) { isDone = true; })
+                .start();
+
+            iterateMainLoopFor(std::chrono::milliseconds{200});
+
+            THEN("The stages after it don't run")
+            {
+                REQUIRE(numberOfStagesRun == 1);
+                REQUIRE(!isDone);
+            }
+        }
+
+        WHEN("The generation is moved on before the workers are done")
+        {
+            Pipeline<int>{taskRunner, TaskRunner::Priority::Interactive, generation}
+                .onWorker([&numberOfStagesRun](int&) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds{50});
+                    ++numberOfStagesRun;
+                })
+                .onMainThread([&isDone](int&) { isDone = true; })
+                .onWorker([&numberOfStagesRun](int&) { ++numberOfStagesRun; })
+                .start();
+
+            ++*generation;
+            taskRunner.dropCanceledTasks();
+            iterateMainLoopFor(std::chrono::milliseconds{200});
+
+            THEN("No stage after the one on its way runs")
+            {
+                REQUIRE(numberOfStagesRun <= 1);
+                REQUIRE(!isDone);
+            }
+        }
+    }
+}
@@ -0,0 +1,266 @@
+#include <catch.hpp>
+#include <pixelconversion.hpp>
+#include <array>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace Slicer;
+
+static std::vector<std::uint8_t> createArgbImage(int width, int height, bool onlyOpaque)
+{
+    std::vector<std::uint8_t> result(static_cast<std::size_t>(width * height * 4));
+    std::mt19937 generator{42}; //NOLINT
+
+    for (int i = 0; i < width * height; ++i) {
+        const auto alpha = static_cast<std::uint32_t>(onlyOpaque || generator() % 4 != 0 ? 255 : generator() % 256);
+        std::uint32_t pixel = alpha << 24;
+
+        for (int shift : {16, 8, 0})
+            pixel |= (alpha == 0 ? 0 : generator() % (alpha + 1)) << shift;
+
+        std::memcpy(result.data() + 4 * i, &pixel, 4);
+    }
+
+    return result;
+}
+
+SCENARIO("Converting ARGB32 pixels to RGBA")
+{
+    GIVEN("A single translucent, premultiplied pixel")
+    {
+        const std::uint32_t pixel = 0x80402010; // alpha 128, premultiplied red 64, green 32, blue 16
+        std::uint8_t source[4];
+        std::memcpy(source, &pixel, 4);
+        std::uint8_t destination[4] = {};
+
+        WHEN("It's converted")
+        {
+            PixelConversion::argb32ToRgba(source, 4, destination, 4, 1, 1);
+
+            THEN("The color is unpremultiplied and the channels are reordered")
+            {
+                REQUIRE(destination[0] == 128);
+                REQUIRE(destination[1] == 64);
+                REQUIRE(destination[2] == 32);
+                REQUIRE(destination[3] == 128);
+            }
+        }
+    }
+
+    GIVEN("Images with widths that aren't multiples of the vector size")
+    {
+        const int width = 37;
+        const int height = 5;
+        const int stride = width * 4;
+
+        for (bool onlyOpaque : {true, false}) {
+            const std::vector<std::uint8_t> source = createArgbImage(width, height, onlyOpaque);
+            std::vector<std::uint8_t> expected(source.size());
+            std::vector<std::uint8_t> result(source.size());
+
+            PixelConversion::argb32ToRgbaScalar(source.data(), stride, expected.data(), stride, width, height);
+            PixelConversion::argb32ToRgba(source.data(), stride, result.data(), stride, width, height);
+
+            THEN("The vectorized conversion matches the scalar one")
+            REQUIRE(result == expected);
+        }
+    }
+}
+
+SCENARIO("Converting RGBA pixels to gray levels")
+{
+    GIVEN("An image with a width that isn't a multiple of the vector size")
+    {
+        const int width = 37;
+        const int height = 5;
+        const std::vector<std::uint8_t> source = createArgbImage(width, height, true);
+        std::vector<std::uint8_t> expected(static_cast<std::size_t>(width * height));
+        std::vector<std::uint8_t> result(expected.size());
+
+        WHEN("It's converted")
+        {
+            PixelConversion::rgbaToGrayScalar(source.data(), width * 4, expected.data(), width, width, height);
+            PixelConversion::rgbaToGray(source.data(), width * 4, result.data(), width, width, height);
+
+            THEN("The vectorized conversion matches the scalar one")
+            REQUIRE(result == expected);
+        }
+    }
+
+    GIVEN("A white and a black pixel")
+    {
+        const std::uint8_t source[8] = {255, 255, 255, 255, 0, 0, 0, 255};
+        std::uint8_t destination[2] = {};
+
+        WHEN("They're converted")
+        {
+            PixelConversion::rgbaToGray(source, 8, destination, 2, 2, 1);
+
+            THEN("They keep their level")
+            {
+                REQUIRE(destination[0] == 255);
+                REQUIRE(destination[1] == 0);
+            }
+        }
+    }
+}
+
+SCENARIO("Finding opaque gray pixels and expanding them back")
+{
+    GIVEN("A gray image with a width that isn't a multiple of the vector size")
+    {
+        const int width = 37;
+        const int height = 5;
+        std::vector<std::uint8_t> source(static_cast<std::size_t>(width * height * 4));
+
+        for (std::size_t i = 0; i < source.size(); i += 4) {
+            const auto level = static_cast<std::uint8_t>(i * 7);
+            source[i] = source[i + 1] = source[i + 2] = level;
+            source[i + 3] = 255;
+        }
+
+        std::vector<std::uint8_t> expected(static_cast<std::size_t>(width * height));
+        std::vector<std::uint8_t> result(expected.size());
+
+        WHEN("Its gray levels are taken")
+        {
+            const bool isGray = PixelConversion::rgbaToOpaqueGray(source.data(), width * 4, result.data(), width, width, height);
+            PixelConversion::rgbaToOpaqueGrayScalar(source.data(), width * 4, expected.data(), width, width, height);
+
+            THEN("It's found to be gray, and the vectorized levels match the scalar ones")
+            {
+                REQUIRE(isGray);
+                REQUIRE(result == expected);
+            }
+
+            THEN("Expanding them gives the image back, vectorized or not")
+            {
+                std::vector<std::uint8_t> expanded(source.size());
+                std::vector<std::uint8_t> expandedScalar(source.size());
+                PixelConversion::grayToRgba(result.data(), width, expanded.data(), width * 4, width, height);
+                PixelConversion::grayToRgbaScalar(result.data(), width, expandedScalar.data(), width * 4, width, height);
+
+                REQUIRE(expanded == source);
+                REQUIRE(expandedScalar == source);
+            }
+        }
+
+        WHEN("A single pixel is colored or translucent")
+        {
+            for (std::size_t byte : {std::size_t{4 * 20 + 1}, std::size_t{4 * 36 + 2}, std::size_t{4 * 3 + 3}}) {
+                std::vector<std::uint8_t> changed = source;
+                changed[byte] ^= 1;
+
+                THEN("It's not found to be gray")
+                {
+                    REQUIRE(!PixelConversion::rgbaToOpaqueGray(changed.data(), width * 4, result.data(), width, width, height));
+                    REQUIRE(!PixelConversion::rgbaToOpaqueGrayScalar(changed.data(), width * 4, result.data(), width, width, height));
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("Scaling images down")
+{
+    GIVEN("Images of 3 and 4 bytes per pixel, scaled down by odd ratios")
+    {
+        const int width = 97;
+        const int height = 61;
+        const std::vector<std::uint8_t> source = createArgbImage(width, height, false);
+
+        for (int bytesPerPixel : {3, 4}) {
+            const int sourceStride = width * 4;
+            const int destinationWidth = 70;
+            const int destinationHeight = 23;
+            const int destinationStride = destinationWidth * bytesPerPixel + 3;
+            std::vector<std::uint8_t> expected(static_cast<std::size_t>(destinationStride * destinationHeight));
+            std::vector<std::uint8_t> result(expected.size());
+
+            WHEN("They're scaled down")
+            {
+                PixelConversion::downscaleScalar(source.data(), sourceStride, width, height,
+                                                 expected.data(), destinationStride, destinationWidth, destinationHeight,
+                                                 bytesPerPixel);
+                PixelConversion::downscale(source.data(), sourceStride, width, height,
+                                           result.data(), destinationStride, destinationWidth, destinationHeight,
+                                           bytesPerPixel);
+
+                THEN("The vectorized scaling matches the scalar one")
+                REQUIRE(result == expected);
+            }
+        }
+    }
+
+    GIVEN("An image of a single color")
+    {
+        const int width = 700;
+        const int height = 990;
+        std::vector<std::uint8_t> source(static_cast<std::size_t>(width * height * 4));
+        for (std::size_t i = 0; i < source.size(); ++i)
+            source[i] = static_cast<std::uint8_t>(std::array<int, 4>{200, 100, 37, 255}.at(i % 4));
+
+        WHEN("It's scaled down to the next zoom level")
+        {
+            const int destinationWidth = 550;
+            const int destinationHeight = 778;
+            std::vector<std::uint8_t> result(static_cast<std::size_t>(destinationWidth * destinationHeight * 4));
+            PixelConversion::downscale(source.data(), width * 4, width, height,
+                                       result.data(), destinationWidth * 4, destinationWidth, destinationHeight, 4);
+
+            std::size_t numberOfChanged = 0;
+            for (std::size_t i = 0; i < result.size(); ++i)
+                numberOfChanged += result[i] != source[i % 4] ? 1 : 0;
+
+            THEN("Every pixel keeps the color")
+            REQUIRE(numberOfChanged == 0);
+        }
+    }
+
+    GIVEN("Alternating black and white pixels")
+    {
+        const std::uint8_t source[12] = {0, 0, 0, 255, 255, 255, 0, 0, 0, 255, 255, 255};
+        std::uint8_t destination[3] = {};
+
+        WHEN("Each pair is averaged")
+        {
+            PixelConversion::downscale(source, 6, 2, 2, destination, 3, 1, 1, 3);
+
+            THEN("They come out mid gray")
+            REQUIRE(destination[0] == 128);
+        }
+    }
+
+    GIVEN("An image scaled up")
+    {
+        std::uint8_t pixels[12] = {};
+
+        THEN("It's refused")
+        REQUIRE_THROWS_AS(PixelConversion::downscale(pixels, 3, 1, 1, pixels, 6, 2, 2, 3), std::invalid_argument);
+    }
+}
+
+SCENARIO("Drawing an outline on an RGBA image")
+{
+    GIVEN("A white 4x3 image")
+    {
+        const int width = 4;
+        const int height = 3;
+        std::vector<std::uint8_t> pixels(width * height * 4, 255);
+
+        WHEN("The outline is drawn")
+        {
+            PixelConversion::drawRgbaOutline(pixels.data(), width * 4, width, height);
+
+            THEN("The border is black and the inside is untouched")
+            {
+                REQUIRE(pixels[0] == 0);
+                REQUIRE(pixels[(2 * width + 3) * 4] == 0);
+                REQUIRE(pixels[(1 * width + 1) * 4] == 255);
+                REQUIRE(pixels[(1 * width + 1) * 4 + 3] == 255);
+            }
+        }
+    }
+}
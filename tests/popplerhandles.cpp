@@ -0,0 +1,85 @@
+#include "common.hpp"
+#include <catch.hpp>
+#include <mappedfile.hpp>
+#include <popplerhandles.hpp>
+#include <thread>
+
+using namespace Slicer;
+
+SCENARIO("Getting poppler handles from several threads")
+{
+    GIVEN("A file")
+    {
+        WHEN("The same thread asks twice for a handle to it")
+        {
+            poppler::document* first = PopplerHandles::forCurrentThread(multipage1Path);
+            poppler::document* second = PopplerHandles::forCurrentThread(multipage1Path);
+
+            THEN("It should get the same handle")
+            REQUIRE(first == second);
+        }
+
+        WHEN("Another thread asks for a handle to it")
+        {
+            poppler::document* mine = PopplerHandles::forCurrentThread(multipage1Path);
+            poppler::document* theirs = nullptr;
+            int theirPages = 0;
+
+            std::thread{[&theirs, &theirPages]() {
+                theirs = PopplerHandles::forCurrentThread(multipage1Path);
+                theirPages = theirs->pages();
+            }}.join();
+
+            THEN("It should get its own handle")
+            {
+                REQUIRE(theirs != mine);
+                REQUIRE(theirPages == mine->pages());
+            }
+        }
+
+        WHEN("The file is released")
+        {
+            PopplerHandles::forCurrentThread(multipage2Path);
+            PopplerHandles::release(multipage2Path);
+
+            THEN("Asking again should still give a working handle")
+            REQUIRE(PopplerHandles::createPage(multipage2Path, 0) != nullptr);
+        }
+    }
+}
+
+SCENARIO("Loading documents from memory mappings")
+{
+    GIVEN("A file on a local filesystem")
+    {
+        REQUIRE(MappedFile::isUsableFor(multipage1Path));
+
+        WHEN("It's mapped into memory")
+        {
+            const MappedFile mapping{multipage1Path};
+
+            THEN("The mapping should hold the file")
+            REQUIRE(std::string{mapping.data(), 5} == "%PDF-");
+        }
+
+        WHEN("It's loaded with and without mappings")
+        {
+            std::shared_ptr<poppler::document> mapped = PopplerHandles::load(multipage1Path);
+
+            MappedFile::setEnabled(false);
+            const bool isUsableWhenDisabled = MappedFile::isUsableFor(multipage1Path);
+            std::shared_ptr<poppler::document> read = PopplerHandles::load(multipage1Path);
+            MappedFile::setEnabled(true);
+
+            THEN("Both documents should have the same pages")
+            {
+                REQUIRE(mapped != nullptr);
+                REQUIRE(read != nullptr);
+                REQUIRE(mapped->pages() == read->pages());
+            }
+
+            THEN("Mappings shouldn't be used while disabled")
+            REQUIRE(!isUsableWhenDisabled);
+        }
+    }
+}
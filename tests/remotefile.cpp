@@ -0,0 +1,88 @@
+#include <catch.hpp>
+#include <remotefile.hpp>
+#include <tempfile.hpp>
+#include <string>
+
+using namespace Slicer;
+
+SCENARIO("Reading the linearization dictionary at the start of a file")
+{
+    GIVEN("The head of a linearized file")
+    {
+        const std::string head = "%PDF-1.5\n%\xbf\xf7\xa2\xfe\n"
+                                 "1 0 obj\n"
+                                 "<< /Linearized 1 /L 483920 /H [ 1078 212 ] /O 5 /E 31464 /N 12 /T 482871 >>\n"
+                                 "endobj\n";
+
+        WHEN("It's read")
+        {
+            const std::optional<RemoteFile::Linearization> linearization = RemoteFile::readLinearization(head);
+
+            THEN("Every parameter should be found")
+            {
+                REQUIRE(linearization.has_value());
+                REQUIRE(linearization->fileLength == 483920);
+                REQUIRE(linearization->firstPageEnd == 31464);
+                REQUIRE(linearization->mainXRefOffset == 482871);
+                REQUIRE(linearization->numberOfPages == 12);
+                REQUIRE(linearization->hintStreamOffset == 1078);
+                REQUIRE(linearization->hintStreamLength == 212);
+            }
+        }
+    }
+
+    GIVEN("The head of a file that isn't linearized")
+    {
+        const std::string head = "%PDF-1.4\n1 0 obj\n<< /Type /Catalog /Pages 2 0 R >>\nendobj\n";
+
+        THEN("Nothing should be found")
+        REQUIRE(!RemoteFile::readLinearization(head).has_value());
+    }
+
+    GIVEN("A linearization dictionary missing the page count")
+    {
+        const std::string head = "%PDF-1.5\n1 0 obj\n<< /Linearized 1 /L 4000 /H [ 500 100 ] /O 5 /E 3000 /T 3900 >>\n";
+
+        THEN("Nothing should be found")
+        REQUIRE(!RemoteFile::readLinearization(head).has_value());
+    }
+}
+
+SCENARIO("Fetching a file into its snapshot")
+{
+    GIVEN("A file bigger than a few chunks")
+    {
+        std::string contents(static_cast<std::size_t>(RemoteFile::chunkSize * 3 + 1234), 'a');
+        for (std::size_t i = 0; i < contents.size(); ++i)
+            contents[i] = static_cast<char>('a' + i % 26);
+
+        Glib::RefPtr<Gio::File> source = TempFile::generate();
+        std::string etag;
+        source->replace_contents(contents, "", etag);
+
+        WHEN("It's fetched")
+        {
+            Glib::RefPtr<Gio::File> snapshot = TempFile::generate();
+            const std::shared_ptr<RemoteFile> file = RemoteFile::start(source, snapshot);
+            file->fetch(RemoteFile::chunkSize * 2, 10);
+            file->waitUntilComplete();
+
+            THEN("The snapshot should have the same contents")
+            {
+                char* snapshotContents = nullptr;
+                gsize length = 0;
+                snapshot->load_contents(snapshotContents, length);
+
+                REQUIRE(std::string{snapshotContents, length} == contents);
+                g_free(snapshotContents);
+            }
+
+            THEN("Readers of the snapshot should know it's complete")
+            REQUIRE(RemoteFile::isComplete(snapshot->get_path()));
+
+            snapshot->remove();
+        }
+
+        source->remove();
+    }
+}
@@ -0,0 +1,88 @@
+#include <catch.hpp>
+#include <renderbufferpool.hpp>
+
+using namespace Slicer;
+
+SCENARIO("The render buffer pool reuses the buffers of destroyed Pixbufs")
+{
+    GIVEN("A new pool")
+    {
+        auto pool = std::make_shared<RenderBufferPool>();
+
+        WHEN("A Pixbuf is created")
+        {
+            Glib::RefPtr<Gdk::Pixbuf> pixbuf = pool->createPixbuf(200, 300);
+
+            THEN("It has the requested size and an alpha channel")
+            {
+                REQUIRE(pixbuf->get_width() == 200);
+                REQUIRE(pixbuf->get_height() == 300);
+                REQUIRE(pixbuf->get_has_alpha());
+            }
+
+            THEN("Nothing is retained while it's alive")
+            REQUIRE(pool->retainedBytes() == 0);
+        }
+
+        WHEN("A Pixbuf is destroyed and one of a similar size is created")
+        {
+            pool->createPixbuf(200, 300).reset();
+            const std::size_t retained = pool->retainedBytes();
+            Glib::RefPtr<Gdk::Pixbuf> pixbuf = pool->createPixbuf(201, 299);
+
+            THEN("The buffer is reused instead of allocating a new one")
+            {
+                REQUIRE(retained > 0);
+                REQUIRE(pool->retainedBytes() == 0);
+                REQUIRE(pool->numberOfAllocations() == 1);
+            }
+        }
+    }
+
+    GIVEN("A pool that can't retain anything")
+    {
+        auto pool = std::make_shared<RenderBufferPool>(0);
+
+        WHEN("A Pixbuf is destroyed")
+        {
+            pool->createPixbuf(200, 300).reset();
+
+            THEN("Its buffer is freed")
+            REQUIRE(pool->retainedBytes() == 0);
+        }
+    }
+}
+
+SCENARIO("The render buffer pool can keep an exact size class")
+{
+    GIVEN("A pool with an exact size class for 200x300 Pixbufs")
+    {
+        auto pool = std::make_shared<RenderBufferPool>();
+        pool->setExactSizeClass(200 * 4 * 300);
+
+        WHEN("A Pixbuf of that size is destroyed")
+        {
+            pool->createPixbuf(200, 300).reset();
+
+            THEN("Exactly its size is retained, rather than a power of two")
+            REQUIRE(pool->retainedBytes() == 200 * 4 * 300);
+
+            THEN("A turned Pixbuf of the same size reuses it")
+            {
+                Glib::RefPtr<Gdk::Pixbuf> pixbuf = pool->createPixbuf(300, 200);
+
+                REQUIRE(pool->retainedBytes() == 0);
+                REQUIRE(pool->numberOfAllocations() == 1);
+            }
+        }
+
+        WHEN("The exact size class is changed")
+        {
+            pool->createPixbuf(200, 300).reset();
+            pool->setExactSizeClass(0);
+
+            THEN("The buffers of the old one are freed")
+            REQUIRE(pool->retainedBytes() == 0);
+        }
+    }
+}
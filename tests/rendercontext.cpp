@@ -0,0 +1,58 @@
+#include <catch.hpp>
+#include <rendercontext.hpp>
+#include <thread>
+
+using namespace Slicer;
+
+SCENARIO("Getting renderers from several threads")
+{
+    GIVEN("Some render settings")
+    {
+        RenderSettings settings;
+        settings.antialiasing = true;
+        settings.textAntialiasing = true;
+        settings.paperColor = 0xff808080;
+
+        WHEN("The same thread asks twice for a renderer")
+        {
+            poppler::page_renderer* first = &RenderContext::forCurrentThread(settings);
+            poppler::page_renderer* second = &RenderContext::forCurrentThread(settings);
+
+            THEN("It should get the same one")
+            REQUIRE(first == second);
+
+            THEN("It should be set up with the settings")
+            {
+                REQUIRE((first->render_hints() & poppler::page_renderer::antialiasing) != 0);
+                REQUIRE((first->render_hints() & poppler::page_renderer::text_antialiasing) != 0);
+                REQUIRE((first->render_hints() & poppler::page_renderer::text_hinting) == 0);
+                REQUIRE(first->paper_color() == 0xff808080);
+            }
+        }
+
+        WHEN("The same thread asks again with other settings")
+        {
+            RenderContext::forCurrentThread(settings);
+
+            RenderSettings other = settings;
+            other.antialiasing = false;
+            poppler::page_renderer& renderer = RenderContext::forCurrentThread(other);
+
+            THEN("The renderer should be set up again")
+            REQUIRE((renderer.render_hints() & poppler::page_renderer::antialiasing) == 0);
+        }
+
+        WHEN("Another thread asks for a renderer")
+        {
+            poppler::page_renderer* mine = &RenderContext::forCurrentThread(settings);
+            poppler::page_renderer* theirs = nullptr;
+
+            std::thread{[&theirs, settings]() {
+                theirs = &RenderContext::forCurrentThread(settings);
+            }}.join();
+
+            THEN("It should get its own")
+            REQUIRE(theirs != mine);
+        }
+    }
+}
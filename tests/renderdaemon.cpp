@@ -0,0 +1,122 @@
+#include "common.hpp"
+#include <catch.hpp>
+#include <document.hpp>
+#include <renderdaemon.hpp>
+#include <glibmm/fileutils.h>
+#include <glibmm/miscutils.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+using namespace Slicer;
+
+static bool isSame(const Glib::RefPtr<Gdk::Pixbuf>& thumbnail, const Glib::RefPtr<Gdk::Pixbuf>& expected)
+{
+    return thumbnail->get_width() == expected->get_width()
+           && thumbnail->get_height() == expected->get_height()
+           && thumbnail->get_rowstride() == expected->get_rowstride()
+           && std::equal(thumbnail->get_pixels(), thumbnail->get_pixels() + thumbnail->get_byte_length(), expected->get_pixels());
+}
+
+static std::uint64_t sizeOf(const std::string& path)
+{
+    struct stat status {};
+    return ::stat(path.c_str(), &status) == 0 ? static_cast<std::uint64_t>(status.st_size) : 0;
+}
+
+static std::uint64_t sizeOfDirectory(const std::string& path)
+{
+    std::uint64_t size = 0;
+    for (const std::string& name : Glib::Dir{path})
+        size += sizeOf(Glib::build_filename(path, name));
+
+    return size;
+}
+
+SCENARIO("Rendering pages through the render daemon")
+{
+    GIVEN("A document, and a daemon")
+    {
+        Document doc{Gio::File::create_for_path(multipage1Path)};
+        const Glib::RefPtr<const Page> page = doc.getPage(2);
+        const std::string directory = Glib::build_filename(Glib::get_tmp_dir(),
+                                                           "pdfslicer-render-daemon-" + std::to_string(::getpid()));
+
+        RenderDaemon::Options options;
+        options.socketPath = directory + ".socket";
+        options.storePath = directory;
+        options.helperPath = SLICER_RENDER_HELPER_PATH;
+        options.diskCacheCapacity = 0;
+
+        auto daemon = std::make_unique<RenderDaemon>(options);
+        std::thread serving{[&daemon]() { daemon->run(); }};
+
+        WHEN("A page is rendered through it, twice, by several connections")
+        {
+            RenderProcessPool pool{RenderProcessPool::Target::Daemon, options.socketPath, 2};
+            const Glib::RefPtr<Gdk::Pixbuf> first = pool.render(*page.get(), 200, PageRenderer::Quality::Full);
+            const Glib::RefPtr<Gdk::Pixbuf> second = pool.render(*page.get(), 200, PageRenderer::Quality::Full);
+            const Glib::RefPtr<Gdk::Pixbuf> expected = PageRenderer{page}.render(200);
+
+            THEN("Both should be the same as the one rendered here")
+            {
+                REQUIRE(isSame(first, expected));
+                REQUIRE(isSame(second, expected));
+            }
+        }
+
+        daemon->stop();
+        serving.join();
+        daemon.reset();
+    }
+
+    GIVEN("Several documents, and a daemon whose store has room for one of them")
+    {
+        const std::vector<std::string> paths{multipage1Path, multipage2Path, multipage3Path};
+        const std::string directory = Glib::build_filename(Glib::get_tmp_dir(),
+                                                           "pdfslicer-render-daemon-" + std::to_string(::getpid()));
+
+        RenderDaemon::Options options;
+        options.socketPath = directory + ".socket";
+        options.storePath = directory;
+        options.helperPath = SLICER_RENDER_HELPER_PATH;
+        options.diskCacheCapacity = 0;
+        options.fileStoreCapacity = 0;
+        for (const std::string& path : paths)
+            options.fileStoreCapacity = std::max(options.fileStoreCapacity, sizeOf(path));
+
+        auto daemon = std::make_unique<RenderDaemon>(options);
+        std::thread serving{[&daemon]() { daemon->run(); }};
+
+        WHEN("A page of each is rendered through it, one after the other")
+        {
+            RenderProcessPool pool{RenderProcessPool::Target::Daemon, options.socketPath, 1};
+            std::uint64_t largestStoreSize = 0;
+
+            for (const std::string& path : paths) {
+                Document doc{Gio::File::create_for_path(path)};
+                pool.render(*doc.getPage(0).get(), 100, PageRenderer::Quality::Full);
+                largestStoreSize = std::max(largestStoreSize, sizeOfDirectory(Glib::build_filename(directory, "files")));
+            }
+
+            THEN("The files stored should never have gone over the store's capacity")
+            REQUIRE(largestStoreSize <= options.fileStoreCapacity);
+        }
+
+        daemon->stop();
+        serving.join();
+        daemon.reset();
+    }
+
+    GIVEN("A document, and no daemon")
+    {
+        Document doc{Gio::File::create_for_path(multipage1Path)};
+        const Glib::RefPtr<const Page> page = doc.getPage(2);
+        RenderProcessPool pool{RenderProcessPool::Target::Daemon, "/nonexistent/pdfslicer-render-daemon.socket", 1};
+
+        THEN("Renders should fail as unreachable, so that they can be done here instead")
+        REQUIRE_THROWS_AS(pool.render(*page.get(), 200, PageRenderer::Quality::Full), RenderProcessPool::Unreachable);
+    }
+}
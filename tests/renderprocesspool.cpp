@@ -0,0 +1,45 @@
+#include "common.hpp"
+#include <catch.hpp>
+#include <document.hpp>
+#include <renderprocesspool.hpp>
+#include <algorithm>
+
+using namespace Slicer;
+
+SCENARIO("Rendering pages in helper processes")
+{
+    GIVEN("A document")
+    {
+        Document doc{Gio::File::create_for_path(multipage1Path)};
+        const Glib::RefPtr<const Page> page = doc.getPage(2);
+
+        WHEN("A page is rendered by a helper")
+        {
+            RenderProcessPool pool{SLICER_RENDER_HELPER_PATH, 2};
+            const Glib::RefPtr<Gdk::Pixbuf> thumbnail = pool.render(*page.get(), 200, PageRenderer::Quality::Full);
+            const Glib::RefPtr<Gdk::Pixbuf> expected = PageRenderer{page}.render(200);
+
+            THEN("It should be the same as the one rendered here")
+            {
+                REQUIRE(thumbnail->get_width() == expected->get_width());
+                REQUIRE(thumbnail->get_height() == expected->get_height());
+                REQUIRE(thumbnail->get_rowstride() == expected->get_rowstride());
+                REQUIRE(std::equal(thumbnail->get_pixels(),
+                                   thumbnail->get_pixels() + thumbnail->get_byte_length(),
+                                   expected->get_pixels()));
+            }
+        }
+
+        WHEN("The helper can't be started")
+        {
+            RenderProcessPool pool{"/nonexistent/pdfslicer-render-helper", 1};
+
+            THEN("The render should fail, and the page shouldn't be sent to a helper again")
+            {
+                REQUIRE_THROWS_AS(pool.render(*page.get(), 200, PageRenderer::Quality::Full), RenderProcessPool::RenderFailed);
+                REQUIRE_THROWS_WITH(pool.render(*page.get(), 200, PageRenderer::Quality::Full),
+                                    "The page took down a render helper before");
+            }
+        }
+    }
+}
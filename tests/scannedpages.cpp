@@ -0,0 +1,100 @@
+#include "common.hpp"
+#include <catch.hpp>
+#include <gdkmm/pixbuf.h>
+#include <glibmm/miscutils.h>
+#include <qpdf/QPDF.hh>
+#include <qpdf/QPDFPageDocumentHelper.hh>
+#include <qpdf/QPDFWriter.hh>
+#include <scannedpages.hpp>
+#include <cstdio>
+
+using namespace Slicer;
+
+static std::string encodeJpeg()
+{
+    auto pixbuf = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, false, 8, 60, 80);
+    pixbuf->fill(0x336699ff);
+
+    gchar* buffer = nullptr;
+    gsize size = 0;
+    pixbuf->save_to_buffer(buffer, size, "jpeg");
+    std::string jpeg{buffer, size};
+    g_free(buffer);
+
+    return jpeg;
+}
+
+// A page for each of contents, all of them drawing the same JPEG as /Im0
+static void writeImagePages(const std::string& path, const std::vector<std::string>& contents)
+{
+    QPDF pdf;
+    pdf.emptyPDF();
+
+    QPDFObjectHandle image = QPDFObjectHandle::newStream(&pdf);
+    image.replaceDict(QPDFObjectHandle::parse("<< /Type /XObject /Subtype /Image /Width 60 /Height 80"
+                                              " /ColorSpace /DeviceRGB /BitsPerComponent 8 >>"));
+    image.replaceStreamData(encodeJpeg(), QPDFObjectHandle::newName("/DCTDecode"), QPDFObjectHandle::newNull());
+
+    QPDFPageDocumentHelper pages{pdf};
+
+    for (const std::string& pageContents : contents) {
+        QPDFObjectHandle page = QPDFObjectHandle::parse("<< /Type /Page /MediaBox [0 0 612 792] >>");
+        QPDFObjectHandle resources = QPDFObjectHandle::parse("<< /XObject << >> >>");
+        resources.getKey("/XObject").replaceKey("/Im0", image);
+        page.replaceKey("/Resources", resources);
+        page.replaceKey("/Contents", QPDFObjectHandle::newStream(&pdf, pageContents));
+        pages.addPage(QPDFPageObjectHelper{pdf.makeIndirectObject(page)}, false);
+    }
+
+    QPDFWriter writer{pdf, path.c_str()};
+    writer.write();
+}
+
+SCENARIO("Finding the JPEG a scanned page is made of")
+{
+    GIVEN("A file with pages that draw a JPEG in different ways")
+    {
+        const std::string path = Glib::build_filename(Glib::get_tmp_dir(), "pdfslicer-test-scanned-pages.pdf");
+        writeImagePages(path,
+                        {"q 612 0 0 792 0 0 cm /Im0 Do Q",
+                         "q 306 0 0 396 0 0 cm /Im0 Do Q",
+                         "q 612 0 0 792 0 0 cm /Im0 Do Q BT ET"});
+
+        WHEN("The page is only the image, over all of it")
+        {
+            const std::optional<std::string> jpeg = ScannedPages::fullPageJpeg(path, 0);
+
+            THEN("The JPEG should be found as the file has it")
+            {
+                REQUIRE(jpeg.has_value());
+                REQUIRE(*jpeg == encodeJpeg());
+            }
+        }
+
+        WHEN("The image only covers part of the page")
+        {
+            THEN("It shouldn't be taken as a scan")
+            REQUIRE_FALSE(ScannedPages::fullPageJpeg(path, 1).has_value());
+        }
+
+        WHEN("The page draws something else too")
+        {
+            THEN("It shouldn't be taken as a scan")
+            REQUIRE_FALSE(ScannedPages::fullPageJpeg(path, 2).has_value());
+        }
+
+        WHEN("The page doesn't exist")
+        {
+            THEN("Nothing should be found")
+            REQUIRE_FALSE(ScannedPages::fullPageJpeg(path, 3).has_value());
+        }
+
+        std::remove(path.c_str());
+    }
+
+    GIVEN("A file of text pages")
+    {
+        THEN("Its pages shouldn't be taken as scans")
+        REQUIRE_FALSE(ScannedPages::fullPageJpeg(multipage1Path, 0).has_value());
+    }
+}
@@ -0,0 +1,103 @@
+#include <catch.hpp>
+#include <scrollpredictor.hpp>
+
+using namespace Slicer;
+
+using namespace std::chrono_literals;
+
+SCENARIO("Predicting where to render ahead from the scrolling")
+{
+    GIVEN("A viewport 1000 tall, with a margin of 1000, in content 100000 tall")
+    {
+        constexpr double pageSize = 1000;
+        constexpr double upper = 100000;
+        constexpr double margin = 1000;
+        ScrollPredictor predictor;
+        const ScrollPredictor::Clock::time_point start{};
+
+        WHEN("It hasn't moved")
+        {
+            predictor.addSample(50000, start);
+            const auto spans = predictor.spans(start, 50000, pageSize, upper, margin);
+
+            THEN("The margin should be on both sides")
+            {
+                REQUIRE(spans.size() == 1);
+                REQUIRE(spans.at(0).top == Approx(49000));
+                REQUIRE(spans.at(0).bottom == Approx(52000));
+            }
+        }
+
+        WHEN("It's scrolled down slowly, a viewport each second")
+        {
+            for (int i = 0; i <= 10; ++i)
+                predictor.addSample(50000 + i * 100, start + i * 100ms);
+
+            const auto now = start + 1000ms;
+            const auto spans = predictor.spans(now, 51000, pageSize, upper, margin);
+
+            THEN("The next screen down should be rendered ahead, and little above")
+            {
+                REQUIRE(predictor.velocity(now) == Approx(1000));
+                REQUIRE(spans.size() == 1);
+                REQUIRE(spans.at(0).top == Approx(50750));
+                REQUIRE(spans.at(0).bottom == Approx(53000));
+            }
+        }
+
+        WHEN("It's flicked down, at ten viewports a second")
+        {
+            for (int i = 0; i <= 10; ++i)
+                predictor.addSample(50000 + i * 160, start + i * 16ms);
+
+            const auto now = start + 160ms;
+            const auto spans = predictor.spans(now, 51600, pageSize, upper, margin);
+
+            THEN("What's on screen and where it'll come to rest should be, and nothing in between")
+            {
+                REQUIRE(spans.size() == 2);
+                REQUIRE(spans.at(0).top == Approx(51600));
+                REQUIRE(spans.at(0).bottom == Approx(52600));
+                REQUIRE(spans.at(1).top == Approx(51600 + 10000 / 4 - 500));
+                REQUIRE(spans.at(1).bottom == Approx(51600 + 10000 / 4 + 1500));
+            }
+        }
+
+        WHEN("It turns around, after scrolling down")
+        {
+            for (int i = 0; i <= 10; ++i)
+                predictor.addSample(50000 + i * 100, start + i * 100ms);
+
+            predictor.addSample(50900, start + 1100ms);
+            const auto spans = predictor.spans(start + 1100ms, 50900, pageSize, upper, margin);
+
+            THEN("Only what's above should be rendered ahead")
+            {
+                REQUIRE(predictor.velocity(start + 1100ms) == Approx(-1000));
+                REQUIRE(spans.size() == 1);
+                REQUIRE(spans.at(0).top == Approx(49900));
+                REQUIRE(spans.at(0).bottom == Approx(52150));
+            }
+        }
+
+        WHEN("It stops for a while")
+        {
+            for (int i = 0; i <= 10; ++i)
+                predictor.addSample(50000 + i * 100, start + i * 100ms);
+
+            const auto now = start + 1000ms + ScrollPredictor::idleTime + 1ms;
+
+            THEN("It should be standing still again")
+            REQUIRE(predictor.velocity(now) == 0);
+        }
+
+        WHEN("It jumps after a pause")
+        {
+            predictor.addSample(0, start);
+            predictor.addSample(90000, start + 1s);
+
+            THEN("The jump shouldn't be taken for a flick")
+            REQUIRE(predictor.velocity(start + 1s) == 0);
+        }
+    }
+}
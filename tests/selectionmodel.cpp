@@ -0,0 +1,153 @@
+#include <catch.hpp>
+#include <selectionmodel.hpp>
+
+using namespace Slicer;
+
+SCENARIO("The selection model keeps its count and bounds up to date")
+{
+    GIVEN("A selection of 200 pages, none of them selected")
+    {
+        SelectionModel selection{200};
+
+        THEN("Nothing should be selected")
+        {
+            REQUIRE(selection.count() == 0);
+            REQUIRE(!selection.first().has_value());
+            REQUIRE(!selection.last().has_value());
+        }
+
+        WHEN("Pages in different words are selected")
+        {
+            selection.set(70, true);
+            selection.set(3, true);
+            selection.set(150, true);
+
+            THEN("The count and bounds should match")
+            {
+                REQUIRE(selection.count() == 3);
+                REQUIRE(selection.first() == 3U);
+                REQUIRE(selection.last() == 150U);
+                REQUIRE(selection.selectedIndexes() == std::vector<unsigned int>{3, 70, 150});
+                REQUIRE(!selection.isContiguous());
+            }
+
+            WHEN("The first and last pages are unselected")
+            {
+                selection.set(3, false);
+                selection.set(150, false);
+
+                THEN("The bounds should move to the remaining page")
+                {
+                    REQUIRE(selection.count() == 1);
+                    REQUIRE(selection.first() == 70U);
+                    REQUIRE(selection.last() == 70U);
+                }
+            }
+
+            WHEN("The selection is inverted")
+            {
+                selection.invert();
+
+                THEN("Every other page should be selected")
+                {
+                    REQUIRE(selection.count() == 197);
+                    REQUIRE(selection.first() == 0U);
+                    REQUIRE(selection.last() == 199U);
+                    REQUIRE(selection.unselectedIndexes() == std::vector<unsigned int>{3, 70, 150});
+                }
+            }
+        }
+
+        WHEN("A range spanning several words is selected")
+        {
+            selection.selectOnly(60, 130);
+
+            THEN("Only the pages in the range should be selected")
+            {
+                REQUIRE(selection.count() == 71);
+                REQUIRE(selection.first() == 60U);
+                REQUIRE(selection.last() == 130U);
+                REQUIRE(!selection.isSelected(59));
+                REQUIRE(!selection.isSelected(131));
+                REQUIRE(selection.isContiguous());
+            }
+        }
+
+        WHEN("Every other page is selected")
+        {
+            selection.selectEveryOther(1);
+
+            THEN("The odd indexes should be selected")
+            {
+                REQUIRE(selection.count() == 100);
+                REQUIRE(selection.first() == 1U);
+                REQUIRE(selection.last() == 199U);
+            }
+        }
+
+        WHEN("All pages are selected and then cleared")
+        {
+            selection.selectAll();
+            REQUIRE(selection.count() == 200);
+
+            selection.clear();
+
+            THEN("Nothing should be selected")
+            REQUIRE(selection.empty());
+        }
+    }
+}
+
+SCENARIO("The selection model follows changes of the list of pages")
+{
+    GIVEN("A selection of 100 pages with pages 10 and 90 selected")
+    {
+        SelectionModel selection{100};
+        selection.set(10, true);
+        selection.set(90, true);
+
+        WHEN("Pages 20 to 29 are removed")
+        {
+            selection.replace(20, 10, {});
+
+            THEN("The selected pages after them should shift")
+            {
+                REQUIRE(selection.size() == 90);
+                REQUIRE(selection.selectedIndexes() == std::vector<unsigned int>{10, 80});
+            }
+        }
+
+        WHEN("Two pages are inserted at the start, one of them selected")
+        {
+            selection.replace(0, 0, {true, false});
+
+            THEN("The selected pages should shift")
+            {
+                REQUIRE(selection.size() == 102);
+                REQUIRE(selection.selectedIndexes() == std::vector<unsigned int>{0, 12, 92});
+            }
+        }
+    }
+}
+
+SCENARIO("Selecting only a given set of pages")
+{
+    GIVEN("A selection of 130 pages with the first half selected")
+    {
+        SelectionModel selection{130};
+        selection.selectOnly(0, 64);
+
+        WHEN("Only pages 3, 64 and 129 are selected")
+        {
+            selection.selectOnly(std::vector<unsigned int>{3, 64, 129});
+
+            THEN("Those should be the only selected pages")
+            {
+                REQUIRE(selection.count() == 3);
+                REQUIRE(selection.selectedIndexes() == std::vector<unsigned int>{3, 64, 129});
+                REQUIRE(selection.first() == 3U);
+                REQUIRE(selection.last() == 129U);
+            }
+        }
+    }
+}
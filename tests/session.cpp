@@ -0,0 +1,58 @@
+#include "common.hpp"
+#include <catch.hpp>
+#include <glibmm/fileutils.h>
+#include <glibmm/miscutils.h>
+#include <session.hpp>
+#include <cstdio>
+
+using namespace Slicer;
+
+SCENARIO("Storing the documents of a session to restore them later")
+{
+    GIVEN("An enabled session and a document with two pages of a file")
+    {
+        const std::string directory = Glib::build_filename(Glib::get_tmp_dir(), "pdfslicer-test-session");
+        Session::setDirectory(directory);
+
+        Session::DocumentState document;
+        document.files.push_back({"file:///home/user/multipage-1.pdf", "0123456789abcdef", multipage1Path});
+        document.pages.push_back({0, 2, 595, 842, 0, 90});
+        document.pages.push_back({0, 0, 595, 842, 0, 0});
+
+        Session::store({document});
+        const std::string keptCopyPath = Glib::build_filename(directory, "0123456789abcdef.pdf");
+
+        WHEN("The session is loaded")
+        {
+            const std::vector<Session::DocumentState> loaded = Session::load();
+
+            THEN("The document should be the stored one, read from a kept copy of its file")
+            {
+                REQUIRE(loaded.size() == 1);
+                REQUIRE(loaded.at(0).files.size() == 1);
+                REQUIRE(loaded.at(0).files.at(0).originalUri == "file:///home/user/multipage-1.pdf");
+                REQUIRE(loaded.at(0).files.at(0).snapshotPath == keptCopyPath);
+                REQUIRE(Session::isKeptCopy(keptCopyPath));
+                REQUIRE(loaded.at(0).pages.size() == 2);
+                REQUIRE(loaded.at(0).pages.at(0).indexInFile == 2);
+                REQUIRE(loaded.at(0).pages.at(0).rotation == 90);
+                REQUIRE(loaded.at(0).pages.at(1).indexInFile == 0);
+            }
+        }
+
+        WHEN("A session without the document is stored")
+        {
+            Session::store({});
+
+            THEN("Nothing should be loaded, and the kept copy should be gone")
+            {
+                REQUIRE(Session::load().empty());
+                REQUIRE_FALSE(Glib::file_test(keptCopyPath, Glib::FILE_TEST_EXISTS));
+            }
+        }
+
+        Session::store({});
+        std::remove(Glib::build_filename(directory, "documents").c_str());
+        Session::setDirectory({});
+    }
+}
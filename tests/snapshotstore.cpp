@@ -0,0 +1,118 @@
+#include "common.hpp"
+#include <catch.hpp>
+#include <document.hpp>
+#include <snapshotstore.hpp>
+#include <tempfile.hpp>
+#include <glibmm/fileutils.h>
+#include <glib/gstdio.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <array>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+using namespace Slicer;
+
+static std::string snapshotPathOf(const Document& document)
+{
+    return document.getSaveData().files.front()->get_path();
+}
+
+SCENARIO("Sharing the snapshots of the same file through the store")
+{
+    GIVEN("A snapshot store in a directory of its own")
+    {
+        const std::string directory = TempFile::generate()->get_path();
+        SnapshotStore::setDirectory(directory);
+
+        WHEN("The same file is opened in two documents")
+        {
+            std::string firstPath;
+            std::string secondPath;
+            {
+                const Document first{Gio::File::create_for_path(multipage1Path)};
+                const Document second{Gio::File::create_for_path(multipage1Path)};
+                firstPath = snapshotPathOf(first);
+                secondPath = snapshotPathOf(second);
+            }
+
+            THEN("Both should read from the one snapshot in the store")
+            {
+                REQUIRE(firstPath == secondPath);
+                REQUIRE(Glib::path_get_dirname(firstPath) == directory);
+            }
+
+            THEN("The snapshot should stay once both are gone, for the next time the file is opened")
+            {
+                REQUIRE(Glib::file_test(firstPath, Glib::FILE_TEST_IS_REGULAR));
+
+                const Document again{Gio::File::create_for_path(multipage1Path)};
+                REQUIRE(snapshotPathOf(again) == firstPath);
+                REQUIRE(again.numberOfPages() == 15);
+            }
+        }
+
+        WHEN("The store can't hold anything, and two files are opened one after the other")
+        {
+            SnapshotStore::setSizeLimit(0);
+
+            std::string firstPath;
+            {
+                const Document first{Gio::File::create_for_path(multipage1Path)};
+                firstPath = snapshotPathOf(first);
+            }
+
+            const Document second{Gio::File::create_for_path(multipage2Path)};
+
+            THEN("The snapshot no one uses anymore should be removed, but not the one in use")
+            {
+                REQUIRE(!Glib::file_test(firstPath, Glib::FILE_TEST_EXISTS));
+                REQUIRE(Glib::file_test(snapshotPathOf(second), Glib::FILE_TEST_IS_REGULAR));
+            }
+
+            SnapshotStore::setSizeLimit(SnapshotStore::defaultSizeLimit);
+        }
+
+        WHEN("A file is opened, then rewritten in place with the same contents and modification time")
+        {
+            const std::string sourcePath = TempFile::generate()->get_path();
+            Gio::File::create_for_path(multipage1Path)->copy(Gio::File::create_for_path(sourcePath));
+
+            std::string firstPath;
+            {
+                const Document first{Gio::File::create_for_path(sourcePath)};
+                firstPath = snapshotPathOf(first);
+            }
+
+            struct stat status {};
+            REQUIRE(stat(sourcePath.c_str(), &status) == 0);
+
+            std::string contents;
+            {
+                std::ifstream file{sourcePath, std::ios::binary};
+                contents.assign(std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{});
+            }
+            {
+                std::ofstream file{sourcePath, std::ios::binary | std::ios::trunc};
+                file << contents;
+            }
+
+            // As cp -p, rsync -t or tar leave it
+            const std::array<timespec, 2> times{status.st_atim, status.st_mtim};
+            REQUIRE(utimensat(AT_FDCWD, sourcePath.c_str(), times.data(), 0) == 0);
+
+            const Document again{Gio::File::create_for_path(sourcePath)};
+
+            THEN("It should get a snapshot of its own, instead of the one taken before")
+            {
+                REQUIRE(snapshotPathOf(again) != firstPath);
+                REQUIRE(again.numberOfPages() == 15);
+            }
+
+            g_remove(sourcePath.c_str());
+        }
+
+        SnapshotStore::setDirectory({});
+    }
+}
@@ -0,0 +1,124 @@
+#include <catch.hpp>
+#include <streamcompression.hpp>
+#include <qpdf/Buffer.hh>
+#include <qpdf/Pl_Buffer.hh>
+#include <qpdf/Pl_Flate.hh>
+#include <qpdf/QUtil.hh>
+#include <algorithm>
+#include <memory>
+
+using namespace Slicer;
+
+// Contents that compress well, like those of a page of text
+static std::string pageContents()
+{
+    std::string contents;
+    for (int line = 0; line < 200; ++line)
+        contents += "BT /F1 12 Tf 72 " + std::to_string(720 - line * 3) + " Td (A line of text) Tj ET\n";
+
+    return contents;
+}
+
+static std::string deflate(const std::string& data)
+{
+    Pl_Buffer buffer{"test"};
+    Pl_Flate flate{"test", &buffer, Pl_Flate::a_deflate};
+    flate.write(QUtil::unsigned_char_pointer(data), data.size());
+    flate.finish();
+
+    const std::unique_ptr<Buffer> compressed{buffer.getBuffer()};
+
+    return std::string{reinterpret_cast<const char*>(compressed->getBuffer()), compressed->getSize()}; //NOLINT
+}
+
+static bool contains(const std::vector<StreamCompression::Candidate>& candidates, QPDFObjectHandle stream)
+{
+    return std::any_of(candidates.begin(), candidates.end(), [&stream](const StreamCompression::Candidate& candidate) {
+        return candidate.stream.getObjGen() == stream.getObjGen();
+    });
+}
+
+SCENARIO("Compressing streams ahead of the writer")
+{
+    GIVEN("A file with an uncompressed stream, a Flate one and a metadata one")
+    {
+        QPDF pdf;
+        pdf.emptyPDF();
+
+        QPDFObjectHandle raw = QPDFObjectHandle::newStream(&pdf, pageContents());
+
+        QPDFObjectHandle flate = QPDFObjectHandle::newStream(&pdf);
+        flate.replaceStreamData(deflate(pageContents()), QPDFObjectHandle::newName("/FlateDecode"), QPDFObjectHandle::newNull());
+
+        QPDFObjectHandle metadata = QPDFObjectHandle::newStream(&pdf, "<x:xmpmeta/>");
+        metadata.getDict().replaceKey("/Type", QPDFObjectHandle::newName("/Metadata"));
+
+        WHEN("The streams to compress are looked for")
+        {
+            const std::vector<StreamCompression::Candidate> candidates = StreamCompression::findCandidates(pdf, false);
+
+            THEN("Only the uncompressed one is found")
+            {
+                REQUIRE(contains(candidates, raw));
+                REQUIRE(!contains(candidates, flate));
+                REQUIRE(!contains(candidates, metadata));
+            }
+
+            AND_WHEN("It's compressed and replaced")
+            {
+                const auto candidate = std::find_if(candidates.begin(), candidates.end(), [&raw](const StreamCompression::Candidate& other) {
+                    return other.stream.getObjGen() == raw.getObjGen();
+                });
+
+                const std::optional<std::string> data = StreamCompression::readData(*candidate);
+                REQUIRE(data.has_value());
+
+                const std::optional<std::string> compressed = StreamCompression::compress(*candidate, *data);
+                REQUIRE(compressed.has_value());
+
+                StreamCompression::replace(*candidate, *compressed);
+
+                THEN("The stream is Flate data that decodes to the same contents")
+                {
+                    REQUIRE(raw.getDict().getKey("/Filter").getName() == "/FlateDecode");
+                    REQUIRE(compressed->size() < data->size());
+
+                    const auto decoded = raw.getStreamData(qpdf_dl_generalized);
+                    REQUIRE(std::string{reinterpret_cast<const char*>(decoded->getBuffer()), decoded->getSize()} == pageContents()); //NOLINT
+                }
+            }
+        }
+
+        WHEN("The streams to recompress are looked for too")
+        {
+            const std::vector<StreamCompression::Candidate> candidates = StreamCompression::findCandidates(pdf, true);
+
+            THEN("The Flate one is found as well, to inflate before deflating")
+            {
+                REQUIRE(contains(candidates, raw));
+                REQUIRE(contains(candidates, flate));
+                REQUIRE(!contains(candidates, metadata));
+
+                for (const StreamCompression::Candidate& candidate : candidates)
+                    if (candidate.stream.getObjGen() == flate.getObjGen())
+                        REQUIRE(candidate.source == StreamCompression::Source::Flate);
+            }
+        }
+    }
+
+    GIVEN("A stream of damaged Flate data")
+    {
+        QPDF pdf;
+        pdf.emptyPDF();
+
+        const StreamCompression::Candidate candidate{QPDFObjectHandle::newStream(&pdf), StreamCompression::Source::Flate};
+
+        WHEN("It's recompressed")
+        {
+            const std::optional<std::string> compressed = StreamCompression::compress(candidate, "not Flate data");
+
+            THEN("It's left to the writer")
+            REQUIRE(!compressed.has_value());
+        }
+    }
+}
@@ -0,0 +1,443 @@
+#include <catch.hpp>
+#include <glibmm/main.h>
+#include <taskrunner.hpp>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Slicer;
+
+using Clock = std::chrono::steady_clock;
+
+// Runs the main loop, where results are delivered, until done() or the timeout
+template<typename Predicate>
+static bool iterateMainLoopUntil(Predicate done, std::chrono::seconds timeout)
+{
+    const Clock::time_point deadline = Clock::now() + timeout;
+
+    while (!done()) {
+        if (Clock::now() > deadline)
+            return false;
+
+        if (!Glib::MainContext::get_default()->iteration(false))
+            std::this_thread::sleep_for(std::chrono::microseconds{100});
+    }
+
+    return true;
+}
+
+static double percentile(std::vector<double> values, double fraction)
+{
+    if (values.empty())
+        return 0;
+
+    const auto index = static_cast<std::size_t>(fraction * static_cast<double>(values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(index), values.end());
+
+    return values.at(index);
+}
+
+SCENARIO("The task runner runs every task on a worker and delivers it on the main thread")
+{
+    GIVEN("A task runner and tasks of every priority")
+    {
+        TaskRunner taskRunner{2};
+        const std::thread::id mainThread = std::this_thread::get_id();
+        const std::vector<TaskRunner::Priority> priorities{TaskRunner::Priority::Interactive,
+                                                           TaskRunner::Priority::Visible,
+                                                           TaskRunner::Priority::Prefetch,
+                                                           TaskRunner::Priority::Background,
+                                                           TaskRunner::Priority::Idle};
+        std::atomic<unsigned int> numberOfExecuted = 0;
+        std::atomic<unsigned int> numberOfExecutedOnMainThread = 0;
+        unsigned int numberOfDelivered = 0;
+        unsigned int numberOfDeliveredOffMainThread = 0;
+
+        WHEN("They are queued")
+        {
+            for (unsigned int i = 0; i < 100; ++i) {
+                auto task = std::make_shared<Task>(
+                    [&]() {
+                        ++numberOfExecuted;
+                        if (std::this_thread::get_id() == mainThread)
+                            ++numberOfExecutedOnMainThread;
+                    },
+                    [&]() {
+                        ++numberOfDelivered;
+                        if (std::this_thread::get_id() != mainThread)
+                            ++numberOfDeliveredOffMainThread;
+                    });
+
+                taskRunner.queue(task, priorities.at(i % priorities.size()), i % 3);
+            }
+
+            THEN("Every one is executed off the main thread, and delivered on it")
+            {
+                REQUIRE(iterateMainLoopUntil([&]() { return numberOfDelivered == 100; }, std::chrono::seconds{10}));
+                REQUIRE(numberOfExecuted == 100);
+                REQUIRE(numberOfExecutedOnMainThread == 0);
+                REQUIRE(numberOfDeliveredOffMainThread == 0);
+            }
+        }
+
+        WHEN("Some are canceled before they're delivered")
+        {
+            std::vector<std::shared_ptr<Task>> tasks;
+            for (unsigned int i = 0; i < 100; ++i)
+                tasks.push_back(std::make_shared<Task>([&]() { ++numberOfExecuted; }, [&]() { ++numberOfDelivered; }));
+
+            for (unsigned int i = 0; i < 100; i += 2)
+                tasks.at(i)->cancel();
+
+            for (const std::shared_ptr<Task>& task : tasks)
+                taskRunner.queue(task, TaskRunner::Priority::Visible);
+
+            taskRunner.dropCanceledTasks();
+
+            THEN("Only the others are delivered")
+            {
+                REQUIRE(iterateMainLoopUntil([&]() { return numberOfDelivered == 50; }, std::chrono::seconds{10}));
+                REQUIRE(taskRunner.numberOfPendingTasks() == 0);
+                REQUIRE(numberOfExecuted == 50);
+            }
+        }
+    }
+}
+
+SCENARIO("The task runner keeps slow tasks from holding up the others")
+{
+    GIVEN("A task runner with a single worker, busy with a slow task")
+    {
+        TaskRunner taskRunner{1};
+        std::atomic_bool isSlowTaskReleased = false;
+        bool isSlowTaskDelivered = false;
+        unsigned int numberOfDelivered = 0;
+
+        taskRunner.queueSlow(std::make_shared<Task>(
+            [&]() {
+                while (!isSlowTaskReleased)
+                    std::this_thread::sleep_for(std::chrono::milliseconds{1});
+            },
+            [&]() { isSlowTaskDelivered = true; }));
+
+        WHEN("Other tasks are queued")
+        {
+            for (unsigned int i = 0; i < 10; ++i)
+                taskRunner.queue(std::make_shared<Task>([]() {}, [&]() { ++numberOfDelivered; }),
+                                 TaskRunner::Priority::Visible);
+
+            const bool areOthersDelivered = iterateMainLoopUntil([&]() { return numberOfDelivered == 10; }, std::chrono::seconds{10});
+            isSlowTaskReleased = true;
+
+            THEN("They should be delivered while the slow one still runs, and it after them")
+            {
+                REQUIRE(areOthersDelivered);
+                REQUIRE(iterateMainLoopUntil([&]() { return isSlowTaskDelivered; }, std::chrono::seconds{10}));
+            }
+        }
+    }
+}
+
+SCENARIO("The task runner runs light tasks before the heavy ones queued ahead of them")
+{
+    GIVEN("A task runner with a single worker, busy with another task")
+    {
+        TaskRunner taskRunner{1};
+        std::atomic_bool isBusy = false;
+        std::atomic_bool isReleased = false;
+        std::vector<std::string> deliveryOrder;
+
+        taskRunner.queue(std::make_shared<Task>(
+                             [&]() {
+                                 isBusy = true;
+                                 while (!isReleased)
+                                     std::this_thread::sleep_for(std::chrono::milliseconds{1});
+                             },
+                             []() {}),
+                         TaskRunner::Priority::Visible);
+
+        while (!isBusy)
+            std::this_thread::sleep_for(std::chrono::milliseconds{1});
+
+        WHEN("Heavy tasks are queued, and then light ones")
+        {
+            for (const std::string name : {"heavy 1", "heavy 2", "light 1", "light 2"}) {
+                auto task = std::make_shared<Task>([]() {}, [&deliveryOrder, name]() { deliveryOrder.push_back(name); });
+                task->setHeavy(name.find("heavy") == 0);
+                taskRunner.queue(task, TaskRunner::Priority::Visible);
+            }
+
+            isReleased = true;
+
+            THEN("The light ones should be delivered first, each kind in the order queued")
+            {
+                REQUIRE(iterateMainLoopUntil([&]() { return deliveryOrder.size() == 4; }, std::chrono::seconds{10}));
+                REQUIRE(deliveryOrder == std::vector<std::string>{"light 1", "light 2", "heavy 1", "heavy 2"});
+            }
+        }
+    }
+}
+
+// Hammers the runner from several threads at once, the way windows do: tasks
+// are queued from everywhere, canceled from anywhere, and the widgets waiting
+// for them go away on the main thread, like in View::clearState(). Build with
+// -DSLICER_SANITIZER=thread or address to run it under each sanitizer.
+// Reports the throughput, and how long tasks took from queued to delivered.
+SCENARIO("The task runner keeps up with tasks queued, canceled and abandoned from every thread")
+{
+    GIVEN("A task runner, and tasks for widgets that go away while they run")
+    {
+        constexpr unsigned int numberOfProducers = 4;
+        constexpr unsigned int tasksPerProducer = 5000;
+        constexpr unsigned int numberOfTasks = numberOfProducers * tasksPerProducer;
+        constexpr unsigned int tasksPerWidget = 50;
+
+        TaskRunner taskRunner{4};
+        const std::thread::id mainThread = std::this_thread::get_id();
+
+        // Stands in for the widget showing the result
+        struct Widget {
+            unsigned int numberOfResults = 0;
+        };
+        std::vector<std::shared_ptr<Widget>> widgets;
+        for (unsigned int i = 0; i < numberOfTasks / tasksPerWidget; ++i)
+            widgets.push_back(std::make_shared<Widget>());
+
+        struct Outcome {
+            bool isDelivered = false;
+            unsigned int numberOfDeliveries = 0;
+            bool isDeliveredOffMainThread = false;
+            bool hasLostWidget = false;
+            double latencyMilliseconds = 0;
+        };
+        std::vector<Outcome> outcomes(numberOfTasks);
+        std::vector<Clock::time_point> queuedTimes(numberOfTasks);
+        std::vector<std::shared_ptr<Task>> tasks;
+
+        for (unsigned int i = 0; i < numberOfTasks; ++i) {
+            std::weak_ptr<Widget> widget = widgets.at(i / tasksPerWidget);
+
+            tasks.push_back(std::make_shared<Task>(
+                [i]() {
+                    // A little work, so that the queues fill up
+                    volatile unsigned int sum = 0;
+                    for (unsigned int j = 0; j < 200 + i % 800; ++j)
+                        sum = sum + j;
+                },
+                [&outcomes, &queuedTimes, widget, mainThread, i]() {
+                    Outcome& outcome = outcomes.at(i);
+                    outcome.isDelivered = true;
+                    ++outcome.numberOfDeliveries;
+                    outcome.isDeliveredOffMainThread = std::this_thread::get_id() != mainThread;
+                    outcome.latencyMilliseconds = std::chrono::duration<double, std::milli>(Clock::now() - queuedTimes.at(i)).count();
+
+                    if (auto shown = widget.lock())
+                        ++shown->numberOfResults;
+                    else
+                        outcome.hasLostWidget = true;
+                }));
+        }
+
+        WHEN("They're queued from several threads, while others cancel them and widgets go away")
+        {
+            std::atomic<unsigned int> numberOfProducersDone = 0;
+            std::atomic_bool isCanceling = true;
+            std::vector<std::thread> threads;
+            const Clock::time_point start = Clock::now();
+
+            for (unsigned int producer = 0; producer < numberOfProducers; ++producer) {
+                threads.emplace_back([&, producer]() {
+                    for (unsigned int j = 0; j < tasksPerProducer; ++j) {
+                        const unsigned int i = producer * tasksPerProducer + j;
+                        const auto priority = static_cast<TaskRunner::Priority>(i % 5);
+                        const TaskRunner::Affinity affinity = i % 4 == 0 ? TaskRunner::noAffinity : i % 7;
+
+                        queuedTimes.at(i) = Clock::now();
+                        taskRunner.queue(tasks.at(i), priority, affinity);
+
+                        if (j % 500 == 0)
+                            std::this_thread::yield();
+                    }
+
+                    ++numberOfProducersDone;
+                });
+            }
+
+            // Cancels tasks at random, queued or not, running or done
+            threads.emplace_back([&]() {
+                std::minstd_rand random{42};
+                std::uniform_int_distribution<unsigned int> anyTask{0, numberOfTasks - 1};
+
+                while (isCanceling) {
+                    tasks.at(anyTask(random))->cancel();
+                    std::this_thread::sleep_for(std::chrono::microseconds{20});
+                }
+            });
+
+            // Meanwhile, the main thread delivers, and clears widgets as View::clearState() does:
+            // their tasks are canceled and dropped first, then the widgets go away
+            std::size_t nextClearedWidget = 0;
+
+            const bool isDone = iterateMainLoopUntil([&]() {
+                if (nextClearedWidget < widgets.size() && Clock::now() - start > std::chrono::milliseconds{nextClearedWidget}) {
+                    for (unsigned int i = 0; i < tasksPerWidget; ++i)
+                        tasks.at(nextClearedWidget * tasksPerWidget + i)->cancel();
+
+                    taskRunner.dropCanceledTasks();
+                    widgets.at(nextClearedWidget).reset();
+                    nextClearedWidget += 7;
+                }
+
+                if (numberOfProducersDone < numberOfProducers)
+                    return false;
+
+                return std::all_of(outcomes.begin(), outcomes.end(), [&tasks, &outcomes](const Outcome& outcome) {
+                    const auto i = static_cast<std::size_t>(&outcome - outcomes.data());
+                    return outcome.isDelivered || tasks.at(i)->isCanceled();
+                });
+            },
+                                                       std::chrono::seconds{120});
+
+            const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            isCanceling = false;
+            for (std::thread& thread : threads)
+                thread.join();
+
+            // What was already delivering when the others were canceled
+            iterateMainLoopUntil([&]() { return taskRunner.numberOfPendingTasks() == 0; }, std::chrono::seconds{10});
+
+            std::vector<double> latencies;
+            for (const Outcome& outcome : outcomes) {
+                if (outcome.isDelivered)
+                    latencies.push_back(outcome.latencyMilliseconds);
+            }
+
+            std::cout << "TaskRunner stress: " << latencies.size() << " of " << numberOfTasks << " tasks delivered in "
+                      << seconds << " s, " << static_cast<double>(latencies.size()) / seconds << " tasks/s; "
+                      << "latency p50 " << percentile(latencies, 0.5) << " ms, "
+                      << "p99 " << percentile(latencies, 0.99) << " ms, "
+                      << "p99.9 " << percentile(latencies, 0.999) << " ms, "
+                      << "max " << percentile(latencies, 1.0) << " ms" << std::endl;
+
+            THEN("Every task is canceled, or delivered once, on the main thread, to a widget still there")
+            {
+                REQUIRE(isDone);
+                REQUIRE(taskRunner.numberOfPendingTasks() == 0);
+
+                for (const Outcome& outcome : outcomes) {
+                    REQUIRE(outcome.numberOfDeliveries <= 1);
+                    REQUIRE_FALSE(outcome.isDeliveredOffMainThread);
+                    REQUIRE_FALSE(outcome.hasLostWidget);
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("The pending task count never goes over what was queued")
+{
+    GIVEN("A task runner with idle workers")
+    {
+        TaskRunner taskRunner{4};
+
+        WHEN("Tasks of every kind are queued while the workers take them as they come")
+        {
+            const std::size_t numberOfTasks = 3000;
+            std::size_t highestCount = 0;
+            unsigned int numberOfDelivered = 0;
+
+            for (std::size_t i = 0; i < numberOfTasks; ++i) {
+                auto task = std::make_shared<Task>([]() {}, [&numberOfDelivered]() { ++numberOfDelivered; });
+
+                if (i % 3 == 0)
+                    taskRunner.queue(task, TaskRunner::Priority::Interactive);
+                else if (i % 3 == 1)
+                    taskRunner.queue(task, TaskRunner::Priority::Visible);
+                else
+                    taskRunner.queueSlow(task);
+
+                highestCount = std::max(highestCount, taskRunner.numberOfPendingTasks());
+            }
+
+            iterateMainLoopUntil([&]() { return numberOfDelivered == numberOfTasks; }, std::chrono::seconds{30});
+
+            THEN("The count stays within the queued tasks, and gets back to zero")
+            {
+                REQUIRE(highestCount <= numberOfTasks);
+                REQUIRE(numberOfDelivered == numberOfTasks);
+                REQUIRE(taskRunner.numberOfPendingTasks() == 0);
+            }
+        }
+    }
+}
+
+SCENARIO("The task runner tunes how many workers take tasks to their throughput")
+{
+    GIVEN("A task runner tuning its workers, and tasks that can only run one at a time")
+    {
+        TaskRunner taskRunner{8};
+        taskRunner.setTuning(true, 2);
+        std::mutex onlyOneAtATime;
+        unsigned int numberOfDelivered = 0;
+
+        const auto queueTask = [&]() {
+            taskRunner.queue(std::make_shared<Task>(
+                                 [&]() {
+                                     std::lock_guard<std::mutex> lock{onlyOneAtATime};
+                                     std::this_thread::sleep_for(std::chrono::microseconds{500});
+                                 },
+                                 [&]() { ++numberOfDelivered; }),
+                             TaskRunner::Priority::Visible);
+        };
+
+        THEN("It starts with all of them")
+        REQUIRE(taskRunner.numberOfActiveWorkers() == 8);
+
+        WHEN("They keep coming for a while")
+        {
+            std::vector<int> counts;
+            const Clock::time_point end = Clock::now() + std::chrono::seconds{3};
+
+            iterateMainLoopUntil([&]() {
+                while (taskRunner.numberOfPendingTasks() < 64)
+                    queueTask();
+
+                counts.push_back(taskRunner.numberOfActiveWorkers());
+                return Clock::now() > end;
+            },
+                                 std::chrono::seconds{10});
+
+            THEN("Fewer workers take them, as more wouldn't finish them any sooner, but never fewer than the minimum")
+            {
+                REQUIRE(taskRunner.numberOfActiveWorkers() < 8);
+                REQUIRE(*std::min_element(counts.begin(), counts.end()) >= 2);
+                REQUIRE(numberOfDelivered > 0);
+            }
+        }
+
+        WHEN("The maximum is lowered")
+        {
+            taskRunner.setActiveWorkers(3);
+
+            THEN("The tuned count stays under it")
+            {
+                REQUIRE(taskRunner.maximumActiveWorkers() == 3);
+                REQUIRE(taskRunner.numberOfActiveWorkers() <= 3);
+            }
+        }
+
+        WHEN("The tuning is turned off")
+        {
+            taskRunner.setActiveWorkers(6);
+            taskRunner.setTuning(false);
+
+            THEN("As many as the maximum take tasks")
+            REQUIRE(taskRunner.numberOfActiveWorkers() == 6);
+        }
+    }
+}
@@ -21,10 +21,117 @@ SCENARIO("Generated temporary files should be unique and isolated from the syste
                 REQUIRE_NOTHROW(uuids::uuid::from_string(tempFile->get_basename()));
             }
 
-            THEN("The parent directory should be our application's ID")
+            THEN("It should be in the directory of this instance, inside our application's ID")
             {
-                REQUIRE(tempFile->get_parent()->get_basename() == config::APPLICATION_ID);
+                REQUIRE(tempFile->get_parent()->get_path() == TempFile::instanceDirPath());
+                REQUIRE(tempFile->get_parent()->get_parent()->get_basename() == config::APPLICATION_ID);
             }
         }
     }
 }
+
+SCENARIO("Snapshots of source files are independent copies")
+{
+    GIVEN("A source file")
+    {
+        Glib::RefPtr<Gio::File> sourceFile = TempFile::generate();
+        std::string etag;
+        sourceFile->replace_contents("original contents", "", etag);
+
+        WHEN("A snapshot is taken and the source is then modified")
+        {
+            Glib::RefPtr<Gio::File> snapshot = TempFile::snapshot(sourceFile);
+            sourceFile->replace_contents("modified contents", "", etag);
+
+            THEN("The snapshot keeps the original contents")
+            {
+                char* contents = nullptr;
+                gsize length = 0;
+                snapshot->load_contents(contents, length);
+                REQUIRE(std::string(contents, length) == "original contents");
+                g_free(contents);
+            }
+
+            THEN("The snapshot lives in our temporary directory")
+            REQUIRE(snapshot->get_parent()->get_path() == TempFile::instanceDirPath());
+        }
+
+        WHEN("A snapshot is taken while looking at what's copied")
+        {
+            const Glib::RefPtr<Gio::File> snapshot = TempFile::generate();
+            std::string copied;
+            const bool isCopied = TempFile::snapshotTo(sourceFile, snapshot, [&copied](const char* data, std::size_t size) {
+                copied.append(data, size);
+            });
+
+            THEN("What was looked at should be the whole file, unless it was a reflink")
+            REQUIRE(copied == (isCopied ? "original contents" : ""));
+        }
+    }
+}
+
+SCENARIO("Temporary files for replacing a file are created next to it")
+{
+    GIVEN("A destination file")
+    {
+        Gtk::Main::init_gtkmm_internals();
+        const Glib::RefPtr<Gio::File> destination = TempFile::generate();
+
+        WHEN("A temporary file is generated next to it")
+        {
+            const Glib::RefPtr<Gio::File> tempFile = TempFile::generateNextTo(destination);
+
+            THEN("It should be in the same directory")
+            REQUIRE(tempFile->get_parent()->equal(destination->get_parent()));
+
+            THEN("It should be hidden and named after the destination")
+            {
+                REQUIRE(tempFile->get_basename().front() == '.');
+                REQUIRE(tempFile->get_basename().find(destination->get_basename()) == 1);
+            }
+        }
+    }
+}
+
+SCENARIO("Removing the temporary files that crashed instances left behind")
+{
+    GIVEN("Our own temporary file, and the directory of an instance that died")
+    {
+        Gtk::Main::init_gtkmm_internals();
+        config::createSlicerDirsIfNotExistent();
+
+        const Glib::RefPtr<Gio::File> ownFile = TempFile::generate();
+        std::string etag;
+        ownFile->replace_contents("in use", "", etag);
+
+        const std::string deadInstancePath = Glib::build_filename(config::getTempDirPath(), "instance-dead");
+        const Glib::RefPtr<Gio::File> deadInstanceDir = Gio::File::create_for_path(deadInstancePath);
+        deadInstanceDir->make_directory_with_parents();
+        deadInstanceDir->get_child("leftover")->replace_contents("leftover", "", etag);
+        Gio::File::create_for_path(deadInstancePath + ".lock")->replace_contents("", "", etag);
+
+        const Glib::RefPtr<Gio::File> recentLooseFile = Gio::File::create_for_path(
+            Glib::build_filename(config::getTempDirPath(), uuids::to_string(uuids::uuid_system_generator{}())));
+        recentLooseFile->replace_contents("recent", "", etag);
+
+        WHEN("Stale files are removed")
+        {
+            TempFile::removeStaleFiles();
+
+            THEN("Our own file should be kept")
+            REQUIRE(ownFile->query_exists());
+
+            THEN("The dead instance should be gone, along with its lock")
+            {
+                REQUIRE(!deadInstanceDir->query_exists());
+                REQUIRE(!Gio::File::create_for_path(deadInstancePath + ".lock")->query_exists());
+            }
+
+            THEN("Loose files younger than a day should be kept")
+            REQUIRE(recentLooseFile->query_exists());
+
+            ownFile->remove();
+            recentLooseFile->remove();
+        }
+    }
+}
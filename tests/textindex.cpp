@@ -0,0 +1,105 @@
+#include <catch.hpp>
+#include <glibmm/miscutils.h>
+#include <textindex.hpp>
+#include <cstdio>
+
+using namespace Slicer;
+
+SCENARIO("Finding the pages with some words in the text index")
+{
+    GIVEN("An index with the text of three pages")
+    {
+        TextIndex index;
+        index.addPage(0, "The quick brown fox");
+        index.addPage(1, "jumps over the lazy dog.");
+        index.addPage(2, "A brown, quick fox!");
+
+        WHEN("The words are looked for one after the other")
+        {
+            const std::vector<unsigned int> pages = index.findPages("quick brown");
+
+            THEN("Only the page with that phrase should be found")
+            REQUIRE(pages == std::vector<unsigned int>{0});
+        }
+
+        WHEN("A single word is looked for, in other case")
+        {
+            const std::vector<unsigned int> pages = index.findPages("FOX");
+
+            THEN("Every page with the word should be found")
+            REQUIRE(pages == std::vector<unsigned int>{0, 2});
+        }
+
+        WHEN("Another index is merged into it")
+        {
+            TextIndex other;
+            other.addPage(3, "Another quick brown fox");
+            index.merge(other);
+
+            THEN("The pages of both should be found")
+            {
+                REQUIRE(index.numberOfIndexedPages() == 4);
+                REQUIRE(index.findPages("quick brown") == std::vector<unsigned int>{0, 3});
+            }
+        }
+
+        WHEN("It is serialized and read back")
+        {
+            const std::optional<TextIndex> read = TextIndex::deserialize(index.serialize());
+
+            THEN("It should find the same pages")
+            {
+                REQUIRE(read.has_value());
+                REQUIRE(read->isIndexed(2));
+                REQUIRE(read->findPages("lazy dog") == std::vector<unsigned int>{1});
+            }
+        }
+
+        WHEN("A truncated copy is read back")
+        {
+            const std::string data = index.serialize();
+
+            THEN("Nothing should be read")
+            REQUIRE_FALSE(TextIndex::deserialize(data.substr(0, data.size() / 2)).has_value());
+        }
+    }
+}
+
+SCENARIO("Keeping the text index of a file next to the page index")
+{
+    GIVEN("An enabled page index, and the stored text index of a file")
+    {
+        const std::string directory = Glib::build_filename(Glib::get_tmp_dir(), "pdfslicer-test-text-index");
+        PageIndex::setDirectory(directory);
+
+        const PageIndex::Key key{"0123456789abcdef", 1234, 5678};
+        TextIndex index;
+        index.addPage(0, "The quick brown fox");
+        TextIndex::store(key, index);
+
+        WHEN("It is loaded with the same key")
+        {
+            const std::optional<TextIndex> loaded = TextIndex::load(key);
+
+            THEN("It should find the same pages")
+            {
+                REQUIRE(loaded.has_value());
+                REQUIRE(loaded->findPages("brown fox") == std::vector<unsigned int>{0});
+            }
+        }
+
+        WHEN("The file has been rewritten in place since, keeping its content hash")
+        {
+            const PageIndex::Key rewritten{key.fileHash, key.fileSize, key.modificationTime + 1};
+
+            THEN("Nothing should be loaded, then or later")
+            {
+                REQUIRE_FALSE(TextIndex::load(rewritten).has_value());
+                REQUIRE_FALSE(TextIndex::load(key).has_value());
+            }
+        }
+
+        std::remove(Glib::build_filename(directory, key.fileHash + ".text").c_str());
+        PageIndex::setDirectory({});
+    }
+}
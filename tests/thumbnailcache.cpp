@@ -0,0 +1,337 @@
+#include <catch.hpp>
+#include <thumbnailcache.hpp>
+
+using namespace Slicer;
+
+// In color, since gray thumbnails are kept in less memory
+static Glib::RefPtr<Gdk::Pixbuf> createThumbnail(int size)
+{
+    Glib::RefPtr<Gdk::Pixbuf> thumbnail = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, true, 8, size, size);
+    thumbnail->fill(0x336699ff);
+
+    return thumbnail;
+}
+
+SCENARIO("The thumbnail cache keeps the most recently used thumbnails within its capacity")
+{
+    GIVEN("A cache with room for two 10x10 thumbnails")
+    {
+        const Glib::RefPtr<Gdk::Pixbuf> thumbnail = createThumbnail(10);
+        const std::size_t thumbnailSize = static_cast<std::size_t>(thumbnail->get_rowstride()) * 10;
+        ThumbnailCache cache{2 * thumbnailSize};
+
+        const ThumbnailCache::Key first{"0123456789abcdef", 0, 0, 200, 0, 0};
+        const ThumbnailCache::Key second{"0123456789abcdef", 1, 0, 200, 0, 0};
+        const ThumbnailCache::Key third{"0123456789abcdef", 2, 0, 200, 0, 0};
+
+        WHEN("A thumbnail is inserted")
+        {
+            cache.insert(first, thumbnail);
+
+            THEN("It can be found with the same key")
+            REQUIRE(cache.find(first) == thumbnail);
+
+            THEN("It can't be found with a different rotation or size")
+            {
+                REQUIRE(!cache.find({0, 0, 90, 200}));
+                REQUIRE(!cache.find({0, 0, 0, 300}));
+            }
+
+            THEN("It can't be found for a file rewritten in place, with the same hash")
+            REQUIRE(!cache.find({first.fileHash, 0, 0, 200, 1234, 5678}));
+        }
+
+        WHEN("A third thumbnail is inserted")
+        {
+            const std::uint64_t heldBefore = Metrics::bytesHeld(Metrics::Memory::Thumbnails);
+
+            cache.insert(first, createThumbnail(10));
+            cache.insert(second, createThumbnail(10));
+            cache.insert(third, createThumbnail(10));
+
+            THEN("The least recently used one is evicted")
+            {
+                REQUIRE(!cache.find(first));
+                REQUIRE(cache.find(second));
+                REQUIRE(cache.find(third));
+                REQUIRE(cache.sizeInBytes() == 2 * thumbnailSize);
+            }
+
+            THEN("Only what's kept is accounted for")
+            REQUIRE(Metrics::bytesHeld(Metrics::Memory::Thumbnails) == heldBefore + 2 * thumbnailSize);
+        }
+
+        WHEN("The oldest thumbnail is used before inserting a third one")
+        {
+            cache.insert(first, createThumbnail(10));
+            cache.insert(second, createThumbnail(10));
+            cache.find(first);
+            cache.insert(third, createThumbnail(10));
+
+            THEN("The second one is evicted instead")
+            {
+                REQUIRE(cache.find(first));
+                REQUIRE(!cache.find(second));
+            }
+        }
+
+        WHEN("A thumbnail larger than the capacity is inserted")
+        {
+            cache.insert(first, createThumbnail(100));
+
+            THEN("It isn't stored")
+            {
+                REQUIRE(cache.numberOfEntries() == 0);
+                REQUIRE(cache.sizeInBytes() == 0);
+            }
+        }
+
+        WHEN("The capacity is reduced")
+        {
+            cache.insert(first, createThumbnail(10));
+            cache.insert(second, createThumbnail(10));
+            cache.setCapacity(thumbnailSize);
+
+            THEN("Entries are evicted until it fits")
+            {
+                REQUIRE(cache.numberOfEntries() == 1);
+                REQUIRE(cache.find(second));
+            }
+        }
+    }
+}
+
+SCENARIO("The thumbnail cache can turn a thumbnail instead of rendering it again")
+{
+    GIVEN("A cache with a 10x20 thumbnail of a page at 0 degrees")
+    {
+        ThumbnailCache cache;
+        cache.insert({0, 0, 0, 200}, Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, true, 8, 10, 20));
+
+        WHEN("The same page is requested at 90 degrees")
+        {
+            const Glib::RefPtr<Gdk::Pixbuf> rotated = cache.findOrRotate({0, 0, 90, 200});
+
+            THEN("A 20x10 thumbnail is returned")
+            {
+                REQUIRE(rotated);
+                REQUIRE(rotated->get_width() == 20);
+                REQUIRE(rotated->get_height() == 10);
+            }
+
+            THEN("The turned thumbnail is cached too")
+            REQUIRE(cache.find({0, 0, 90, 200}) == rotated);
+        }
+
+        WHEN("The same page is requested at another size")
+        {
+            THEN("Nothing is returned")
+            REQUIRE(!cache.findOrRotate({0, 0, 90, 300}));
+        }
+    }
+}
+
+SCENARIO("The thumbnail cache can stand in a thumbnail of another size while zooming")
+{
+    GIVEN("A cache with thumbnails of a page at two sizes, and of another page")
+    {
+        ThumbnailCache cache;
+        const Glib::RefPtr<Gdk::Pixbuf> small = createThumbnail(10);
+        const Glib::RefPtr<Gdk::Pixbuf> large = createThumbnail(30);
+        cache.insert({0, 0, 0, 200}, small);
+        cache.insert({0, 0, 0, 600}, large);
+        cache.insert({0, 1, 0, 450}, createThumbnail(20));
+
+        WHEN("The page is requested at a size in between")
+        {
+            THEN("The thumbnail of the closest size is returned")
+            {
+                REQUIRE(cache.findNearest({0, 0, 0, 300}) == small);
+                REQUIRE(cache.findNearest({0, 0, 0, 450}) == large);
+            }
+        }
+
+        WHEN("The page is requested at another rotation")
+        {
+            THEN("Nothing is returned")
+            REQUIRE(!cache.findNearest({0, 0, 90, 300}));
+        }
+    }
+}
+
+SCENARIO("The thumbnail cache finds the next larger size of a page to scale down")
+{
+    GIVEN("A cache with thumbnails of a page at three sizes")
+    {
+        ThumbnailCache cache;
+        const std::string fileHash = "0123456789abcdef";
+        const Glib::RefPtr<Gdk::Pixbuf> medium = createThumbnail(20);
+        const Glib::RefPtr<Gdk::Pixbuf> large = createThumbnail(30);
+        cache.insert({fileHash, 0, 0, 200}, createThumbnail(10));
+        cache.insert({fileHash, 0, 0, 400}, medium);
+        cache.insert({fileHash, 0, 0, 700}, large);
+
+        WHEN("Smaller sizes are asked for")
+        {
+            THEN("The smallest larger one is found, within the factor")
+            {
+                REQUIRE(cache.findLarger({fileHash, 0, 0, 300}, 4) == medium);
+                REQUIRE(cache.findLarger({fileHash, 0, 0, 550}, 4) == large);
+                REQUIRE(!cache.findLarger({fileHash, 0, 0, 150}, 2));
+            }
+        }
+
+        WHEN("A size goes away")
+        {
+            cache.forget(fileHash, {0});
+            cache.insert({fileHash, 0, 0, 700}, large);
+
+            THEN("It's not found anymore")
+            REQUIRE(cache.findLarger({fileHash, 0, 0, 300}, 4) == large);
+        }
+    }
+}
+
+SCENARIO("The thumbnail cache compresses the thumbnails it evicts")
+{
+    GIVEN("A cache with room for one 100x100 thumbnail, and a compressed tier")
+    {
+        const Glib::RefPtr<Gdk::Pixbuf> thumbnail = createThumbnail(100);
+        const std::size_t thumbnailSize = static_cast<std::size_t>(thumbnail->get_rowstride()) * 100;
+        ThumbnailCache cache{thumbnailSize, thumbnailSize};
+
+        const ThumbnailCache::Key first{"0123456789abcdef", 0, 0, 200, 0, 0};
+        const ThumbnailCache::Key second{"0123456789abcdef", 1, 0, 200, 0, 0};
+
+        thumbnail->fill(0xffeeddff);
+        cache.insert(first, thumbnail);
+
+        const Glib::RefPtr<Gdk::Pixbuf> other = createThumbnail(100);
+        other->fill(0x102030ff);
+
+        WHEN("A second thumbnail pushes the first one out")
+        {
+            cache.insert(second, other);
+
+            THEN("The first one is kept compressed, in much less memory")
+            {
+                REQUIRE(cache.numberOfEntries() == 1);
+                REQUIRE(cache.numberOfCompressedEntries() == 1);
+                REQUIRE(cache.compressedSizeInBytes() < thumbnailSize / 20);
+            }
+
+            THEN("Finding it brings back the same pixels")
+            {
+                const Glib::RefPtr<Gdk::Pixbuf> found = cache.find(first);
+
+                REQUIRE(found);
+                REQUIRE(found->get_width() == 100);
+                REQUIRE(found->get_pixels()[0] == 0xff);
+                REQUIRE(cache.numberOfCompressedEntries() == 1);
+                REQUIRE(cache.find(second));
+            }
+        }
+
+        WHEN("The compressed tier has no capacity")
+        {
+            cache.setCompressedCapacity(0);
+            cache.insert(second, other);
+
+            THEN("Evicted thumbnails are gone")
+            REQUIRE(!cache.find(first));
+        }
+    }
+}
+
+SCENARIO("The thumbnail cache keeps gray thumbnails packed")
+{
+    GIVEN("A cache with room for one 100x100 color thumbnail")
+    {
+        const Glib::RefPtr<Gdk::Pixbuf> color = createThumbnail(100);
+        const std::size_t thumbnailSize = static_cast<std::size_t>(color->get_rowstride()) * 100;
+        ThumbnailCache cache{thumbnailSize};
+
+        const ThumbnailCache::Key first{"0123456789abcdef", 0, 0, 200, 0, 0};
+        const ThumbnailCache::Key second{"0123456789abcdef", 1, 0, 200, 0, 0};
+
+        Glib::RefPtr<Gdk::Pixbuf> gray = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, true, 8, 100, 100);
+        gray->fill(0x808080ff);
+
+        Glib::RefPtr<Gdk::Pixbuf> blackAndWhite = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, true, 8, 100, 100);
+        blackAndWhite->fill(0xffffffff);
+        blackAndWhite->get_pixels()[0] = 0;
+        blackAndWhite->get_pixels()[1] = 0;
+        blackAndWhite->get_pixels()[2] = 0;
+
+        WHEN("A gray and a black and white thumbnail are inserted")
+        {
+            cache.insert(first, gray);
+            cache.insert(second, blackAndWhite);
+
+            THEN("Both fit, at a byte and a bit per pixel")
+            {
+                REQUIRE(cache.numberOfEntries() == 2);
+                REQUIRE(cache.sizeInBytes() == 100 * 100 + 13 * 100);
+            }
+
+            THEN("They're found with the same pixels")
+            {
+                const Glib::RefPtr<Gdk::Pixbuf> foundGray = cache.find(first);
+                const Glib::RefPtr<Gdk::Pixbuf> foundBlackAndWhite = cache.find(second);
+
+                REQUIRE(foundGray->get_has_alpha());
+                REQUIRE(foundGray->get_pixels()[1] == 0x80);
+                REQUIRE(foundGray->get_pixels()[3] == 0xff);
+                REQUIRE(foundBlackAndWhite->get_pixels()[0] == 0);
+                REQUIRE(foundBlackAndWhite->get_pixels()[4] == 0xff);
+            }
+        }
+
+        WHEN("A color thumbnail is inserted")
+        {
+            cache.insert(first, color);
+
+            THEN("It's kept as it is")
+            REQUIRE(cache.find(first) == color);
+        }
+    }
+}
+
+SCENARIO("The thumbnail cache forgets the thumbnails of pages that changed")
+{
+    GIVEN("A cache with thumbnails of two pages, at two sizes, with one compressed")
+    {
+        const Glib::RefPtr<Gdk::Pixbuf> thumbnail = createThumbnail(10);
+        const std::size_t thumbnailSize = static_cast<std::size_t>(thumbnail->get_rowstride()) * 10;
+        ThumbnailCache cache{3 * thumbnailSize, 3 * thumbnailSize};
+
+        const ThumbnailCache::Key small{"0123456789abcdef", 0, 0, 200, 0, 0};
+        const ThumbnailCache::Key large{"0123456789abcdef", 0, 90, 400, 0, 0};
+        const ThumbnailCache::Key other{"0123456789abcdef", 1, 0, 200, 0, 0};
+        const ThumbnailCache::Key otherFile{"fedcba9876543210", 0, 0, 200, 0, 0};
+
+        cache.insert(small, createThumbnail(10));
+        cache.insert(large, createThumbnail(10));
+        cache.insert(other, createThumbnail(10));
+        cache.insert(otherFile, createThumbnail(10));
+
+        WHEN("The first page is forgotten")
+        {
+            cache.forget("0123456789abcdef", {0});
+
+            THEN("Its thumbnails are gone from both tiers")
+            {
+                REQUIRE(!cache.find(small));
+                REQUIRE(!cache.find(large));
+                REQUIRE(cache.numberOfCompressedEntries() == 0);
+            }
+
+            THEN("The other pages keep theirs")
+            {
+                REQUIRE(cache.find(other));
+                REQUIRE(cache.find(otherFile));
+                REQUIRE(cache.sizeInBytes() == 2 * thumbnailSize);
+            }
+        }
+    }
+}
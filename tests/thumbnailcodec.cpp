@@ -0,0 +1,130 @@
+#include <catch.hpp>
+#include <thumbnailcodec.hpp>
+#include <cstring>
+
+using namespace Slicer;
+
+static bool haveSamePixels(const Glib::RefPtr<Gdk::Pixbuf>& a, const Glib::RefPtr<Gdk::Pixbuf>& b)
+{
+    if (a->get_width() != b->get_width() || a->get_height() != b->get_height()
+        || a->get_n_channels() != b->get_n_channels())
+        return false;
+
+    const auto rowSize = static_cast<std::size_t>(a->get_width() * a->get_n_channels());
+
+    for (int y = 0; y < a->get_height(); ++y) {
+        if (std::memcmp(a->get_pixels() + y * a->get_rowstride(), b->get_pixels() + y * b->get_rowstride(), rowSize) != 0)
+            return false;
+    }
+
+    return true;
+}
+
+SCENARIO("Compressing and expanding thumbnails")
+{
+    GIVEN("A thumbnail of black lines on white, with an alpha channel")
+    {
+        Glib::RefPtr<Gdk::Pixbuf> thumbnail = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, true, 8, 201, 150);
+        thumbnail->fill(0xffffffff);
+
+        for (int y = 10; y < 150; y += 12)
+            thumbnail->get_pixels()[y * thumbnail->get_rowstride() + 40] = 0;
+
+        WHEN("It's compressed and expanded again")
+        {
+            const ThumbnailCodec::CompressedThumbnail compressed = ThumbnailCodec::compress(thumbnail);
+            const Glib::RefPtr<Gdk::Pixbuf> expanded = ThumbnailCodec::decompress(compressed);
+
+            THEN("The pixels are the same")
+            REQUIRE(haveSamePixels(thumbnail, expanded));
+
+            THEN("It took a small fraction of the memory")
+            REQUIRE(compressed.sizeInBytes() * 20 < static_cast<std::size_t>(thumbnail->get_rowstride() * 150));
+        }
+    }
+
+    GIVEN("A thumbnail without alpha and with a gradient")
+    {
+        Glib::RefPtr<Gdk::Pixbuf> thumbnail = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, false, 8, 63, 47);
+
+        for (int y = 0; y < 47; ++y)
+            for (int x = 0; x < 63 * 3; ++x)
+                thumbnail->get_pixels()[y * thumbnail->get_rowstride() + x] = static_cast<guint8>(x * 7 + y * 13);
+
+        WHEN("It's compressed and expanded again")
+        {
+            const Glib::RefPtr<Gdk::Pixbuf> expanded = ThumbnailCodec::decompress(ThumbnailCodec::compress(thumbnail));
+
+            THEN("The pixels are the same")
+            {
+                REQUIRE(!expanded->get_has_alpha());
+                REQUIRE(haveSamePixels(thumbnail, expanded));
+            }
+        }
+    }
+}
+
+SCENARIO("Packing gray thumbnails")
+{
+    GIVEN("A thumbnail of antialiased gray text on white")
+    {
+        Glib::RefPtr<Gdk::Pixbuf> thumbnail = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, true, 8, 75, 40);
+        thumbnail->fill(0xffffffff);
+
+        for (int x = 0; x < 75; ++x)
+            for (int channel = 0; channel < 3; ++channel)
+                thumbnail->get_pixels()[20 * thumbnail->get_rowstride() + x * 4 + channel] = static_cast<guint8>(x * 3);
+
+        WHEN("It's packed and unpacked again")
+        {
+            const std::optional<ThumbnailCodec::GrayThumbnail> gray = ThumbnailCodec::packGray(thumbnail);
+
+            THEN("It takes a byte per pixel, and the pixels are the same")
+            {
+                REQUIRE(gray.has_value());
+                REQUIRE(gray->bitsPerPixel == 8);
+                REQUIRE(gray->sizeInBytes() == 75 * 40);
+                REQUIRE(haveSamePixels(thumbnail, ThumbnailCodec::unpackGray(*gray)));
+            }
+        }
+    }
+
+    GIVEN("A thumbnail of only black and white")
+    {
+        Glib::RefPtr<Gdk::Pixbuf> thumbnail = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, true, 8, 75, 40);
+        thumbnail->fill(0xffffffff);
+
+        for (int y = 0; y < 40; y += 3)
+            for (int channel = 0; channel < 3; ++channel)
+                thumbnail->get_pixels()[y * thumbnail->get_rowstride() + y * 4 + channel] = 0;
+
+        WHEN("It's packed and unpacked again")
+        {
+            const std::optional<ThumbnailCodec::GrayThumbnail> gray = ThumbnailCodec::packGray(thumbnail);
+
+            THEN("It takes a bit per pixel, and the pixels are the same")
+            {
+                REQUIRE(gray.has_value());
+                REQUIRE(gray->bitsPerPixel == 1);
+                REQUIRE(gray->sizeInBytes() == 10 * 40);
+                REQUIRE(haveSamePixels(thumbnail, ThumbnailCodec::unpackGray(*gray)));
+            }
+        }
+    }
+
+    GIVEN("A thumbnail with a colored or translucent pixel")
+    {
+        Glib::RefPtr<Gdk::Pixbuf> colored = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, true, 8, 75, 40);
+        colored->fill(0xffffffff);
+        colored->get_pixels()[39 * colored->get_rowstride() + 74 * 4] = 0;
+
+        Glib::RefPtr<Gdk::Pixbuf> translucent = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, true, 8, 75, 40);
+        translucent->fill(0xffffff80);
+
+        THEN("It isn't packed")
+        {
+            REQUIRE(!ThumbnailCodec::packGray(colored).has_value());
+            REQUIRE(!ThumbnailCodec::packGray(translucent).has_value());
+        }
+    }
+}
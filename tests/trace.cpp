@@ -0,0 +1,78 @@
+#include <catch.hpp>
+#include <trace.hpp>
+#include <string>
+#include <thread>
+
+using namespace Slicer;
+
+static std::size_t countOf(const std::string& text, const std::string& pattern)
+{
+    std::size_t count = 0;
+
+    for (auto position = text.find(pattern); position != std::string::npos; position = text.find(pattern, position + 1))
+        ++count;
+
+    return count;
+}
+
+SCENARIO("Recording timing spans")
+{
+    Trace::clear();
+
+    GIVEN("Tracing turned off")
+    {
+        Trace::setEnabled(false);
+
+        WHEN("A span goes by")
+        {
+            {
+                const Trace::Span span{"test span while off"};
+            }
+
+            THEN("It shouldn't be recorded")
+            REQUIRE(countOf(Trace::chromeTraceJson(), "test span while off") == 0);
+        }
+    }
+
+    GIVEN("Tracing turned on")
+    {
+        Trace::setEnabled(true);
+
+        WHEN("Spans go by in two threads")
+        {
+            {
+                const Trace::Span span{"test span on main"};
+            }
+
+            std::thread thread{[]() {
+                Trace::setThreadName("Test thread");
+                const Trace::Span span{"test span on thread"};
+            }};
+            thread.join();
+
+            const std::string json = Trace::chromeTraceJson();
+
+            THEN("Both should be exported as complete events")
+            {
+                REQUIRE(countOf(json, R"({"name":"test span on main","ph":"X")") == 1);
+                REQUIRE(countOf(json, R"({"name":"test span on thread","ph":"X")") == 1);
+            }
+
+            THEN("The thread's name should be exported")
+            REQUIRE(countOf(json, R"("args":{"name":"Test thread"})") == 1);
+        }
+
+        WHEN("A thread records more spans than it keeps")
+        {
+            for (std::size_t i = 0; i < Trace::spansPerThread + 10; ++i)
+                Trace::record("test span over and over", Trace::Clock::now(), Trace::Clock::now());
+
+            THEN("Only the last ones should be exported")
+            REQUIRE(countOf(Trace::chromeTraceJson(), "test span over and over") == Trace::spansPerThread);
+        }
+
+        Trace::setEnabled(false);
+    }
+
+    Trace::clear();
+}
@@ -0,0 +1,105 @@
+#include <catch.hpp>
+#include <workertuner.hpp>
+#include <algorithm>
+#include <functional>
+
+using namespace Slicer;
+
+using namespace std::chrono_literals;
+
+// Intervals at the count the tuner asks for, with the throughput each count gets
+static std::vector<int> tune(WorkerTuner& tuner,
+                             const std::function<double(int)>& throughputOf,
+                             int numberOfIntervals,
+                             std::chrono::milliseconds meanWait = 10ms)
+{
+    std::vector<int> counts;
+
+    for (int i = 0; i < numberOfIntervals; ++i)
+        counts.push_back(tuner.update(throughputOf(tuner.numberOfWorkers()), meanWait, false));
+
+    return counts;
+}
+
+SCENARIO("Tuning the number of workers to the throughput")
+{
+    GIVEN("Tasks that go faster with more workers up to 5, and slower past it, with 16 allowed")
+    {
+        WorkerTuner tuner{1, 16};
+        const auto throughputOf = [](int workers) {
+            return workers <= 5 ? 100.0 * workers : 500.0 - 30.0 * (workers - 5);
+        };
+
+        THEN("It starts with all of them")
+        REQUIRE(tuner.numberOfWorkers() == 16);
+
+        WHEN("It's tuned for a while")
+        {
+            tune(tuner, throughputOf, 40);
+            const std::vector<int> counts = tune(tuner, throughputOf, 100);
+
+            THEN("It stays around the peak, and at it most of the time")
+            {
+                REQUIRE(*std::min_element(counts.begin(), counts.end()) >= 4);
+                REQUIRE(*std::max_element(counts.begin(), counts.end()) <= 6);
+                REQUIRE(std::count(counts.begin(), counts.end(), 5) > 80);
+            }
+        }
+    }
+
+    GIVEN("Tasks that go as fast with 2 workers as with any more")
+    {
+        WorkerTuner tuner{1, 8};
+        const auto throughputOf = [](int workers) { return workers < 2 ? 50.0 : 100.0; };
+
+        WHEN("It's tuned for a while")
+        {
+            tune(tuner, throughputOf, 60);
+            const std::vector<int> counts = tune(tuner, throughputOf, 50);
+
+            THEN("It keeps close to the fewest that do it")
+            REQUIRE(*std::max_element(counts.begin(), counts.end()) <= 3);
+        }
+    }
+
+    GIVEN("A tuner that has found its count")
+    {
+        WorkerTuner tuner{2, 16};
+        const auto throughputOf = [](int workers) { return workers <= 3 ? 100.0 * workers : 300.0; };
+        tune(tuner, throughputOf, 60);
+        const int found = tuner.numberOfWorkers();
+
+        WHEN("The workers run out of tasks")
+        {
+            for (int i = 0; i < 20; ++i)
+                tuner.update(1.0, 0ms, true);
+
+            THEN("The count is left as it was")
+            REQUIRE(tuner.numberOfWorkers() == found);
+        }
+
+        WHEN("The throughput keeps changing, up and down")
+        {
+            std::vector<int> counts;
+            for (int i = 0; i < 200; ++i)
+                counts.push_back(tuner.update(i % 2 == 0 ? 1000.0 : 10.0, 10ms, false));
+
+            THEN("It never goes past the limits")
+            {
+                REQUIRE(*std::min_element(counts.begin(), counts.end()) >= 2);
+                REQUIRE(*std::max_element(counts.begin(), counts.end()) <= 16);
+            }
+        }
+
+        WHEN("The limits change to leave it out")
+        {
+            tuner.setLimits(1, 1);
+
+            THEN("It goes to within them, and stays")
+            {
+                REQUIRE(tuner.numberOfWorkers() == 1);
+                REQUIRE(tune(tuner, throughputOf, 20) == std::vector<int>(20, 1));
+            }
+        }
+    }
+}